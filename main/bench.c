@@ -0,0 +1,451 @@
+/*
+ * Loopback soak test of the RTU slave, see bench.h
+ */
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_rom_gpio.h"
+#include "soc/gpio_periph.h"
+#include "soc/uart_periph.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "mbcontroller.h"
+#include "bench.h"
+
+#if CONFIG_APP_BENCH_LOOPBACK
+
+#define BENCH_TASK_STACK        (4096)
+#define BENCH_TASK_PRIO         (4)     // Below the Modbus tasks, above the idle work of the app
+#define BENCH_SYNC_RETRY_MS     (100)
+#define BENCH_SYNC_RETRIES      (50)    // Attempts per request of the sync, 5 s without a response
+
+// Latency histogram with 8 buckets per power of two: below 8 us one bucket per
+// microsecond, above the bucket width is 1/8 of the octave (12.5 % resolution)
+#define BENCH_HIST_SUB_BITS     (3)
+#define BENCH_HIST_SUB          (1 << BENCH_HIST_SUB_BITS)
+#define BENCH_HIST_MAX_BIT      (24)    // Latencies above 33.5 s go to the last bucket
+#define BENCH_HIST_BUCKETS      ((BENCH_HIST_MAX_BIT - BENCH_HIST_SUB_BITS + 2) * BENCH_HIST_SUB)
+
+// Function codes of the bench traffic
+#define BENCH_FC_READ_COILS         (0x01)
+#define BENCH_FC_READ_HOLDING       (0x03)
+#define BENCH_FC_WRITE_REGISTER     (0x06)
+#define BENCH_FC_WRITE_COILS        (0x0F)
+#define BENCH_FC_WRITE_REGISTERS    (0x10)
+
+// Share of the functions in the traffic, in 1/16
+static const struct {
+    uint8_t func;
+    uint8_t weight;
+} bench_mix[] = {
+    { BENCH_FC_READ_COILS, 3 },
+    { BENCH_FC_READ_HOLDING, 5 },
+    { BENCH_FC_WRITE_REGISTER, 3 },
+    { BENCH_FC_WRITE_COILS, 2 },
+    { BENCH_FC_WRITE_REGISTERS, 3 },
+};
+
+static const char *TAG = "BENCH";
+
+static bench_config_t bench_config;
+static SemaphoreHandle_t bench_lock = NULL;
+static bench_stats_t bench_stats = { 0 };                   // Counters, protected by the lock
+static uint32_t bench_hist[BENCH_HIST_BUCKETS];             // Latency histogram, protected by the lock
+static int64_t bench_start_us = 0;
+static int64_t bench_second_us = 0;                         // Start of the current second
+static uint32_t bench_second_count = 0;                     // Requests in the current second
+
+// Shadow of the scratch areas of the slave, used by the bench task only
+static uint16_t bench_regs[BENCH_REG_COUNT];
+static uint8_t bench_coils[BENCH_COIL_COUNT / 8];
+
+static size_t bench_hist_index(uint32_t us)
+{
+    if (us < BENCH_HIST_SUB) {
+        return us;
+    }
+    int msb = 31 - __builtin_clz(us);
+    if (msb > BENCH_HIST_MAX_BIT) {
+        return BENCH_HIST_BUCKETS - 1;
+    }
+    return ((msb - BENCH_HIST_SUB_BITS + 1) << BENCH_HIST_SUB_BITS)
+           | ((us >> (msb - BENCH_HIST_SUB_BITS)) & (BENCH_HIST_SUB - 1));
+}
+
+// Highest latency of a bucket
+static uint32_t bench_hist_upper(size_t index)
+{
+    if (index < BENCH_HIST_SUB) {
+        return index;
+    }
+    int shift = (int)(index >> BENCH_HIST_SUB_BITS) - 1;
+    uint32_t sub = (index & (BENCH_HIST_SUB - 1)) | BENCH_HIST_SUB;
+    return ((sub + 1) << shift) - 1;
+}
+
+// Upper bound of the bucket which holds the requested percentile (in permille)
+static uint32_t bench_percentile(uint32_t total, uint32_t permille)
+{
+    uint32_t target = (uint32_t)(((uint64_t)total * permille + 999) / 1000);
+    uint32_t sum = 0;
+    for (size_t i = 0; i < BENCH_HIST_BUCKETS; i++) {
+        sum += bench_hist[i];
+        if ((sum >= target) && (sum > 0)) {
+            uint32_t upper = bench_hist_upper(i);
+            return (upper < bench_stats.max_us) ? upper : bench_stats.max_us;
+        }
+    }
+    return bench_stats.max_us;
+}
+
+static bool bench_get_bit(const uint8_t *bits, uint16_t index)
+{
+    return (bits[index >> 3] >> (index & 7)) & 1;
+}
+
+static void bench_set_bit(uint8_t *bits, uint16_t index, bool value)
+{
+    if (value) {
+        bits[index >> 3] |= (uint8_t)(1 << (index & 7));
+    } else {
+        bits[index >> 3] &= (uint8_t)~(1 << (index & 7));
+    }
+}
+
+// Clear the counters, called with the lock taken
+static void bench_clear(void)
+{
+    bool running = bench_stats.running;
+    memset(&bench_stats, 0, sizeof(bench_stats));
+    memset(bench_hist, 0, sizeof(bench_hist));
+    bench_stats.running = running;
+    bench_stats.rate_min = UINT32_MAX;
+    bench_stats.heap_start = esp_get_free_heap_size();
+    bench_stats.heap_min = bench_stats.heap_start;
+    bench_start_us = esp_timer_get_time();
+    bench_second_us = bench_start_us;
+    bench_second_count = 0;
+}
+
+// Send the request of the sync, retried a bounded number of times
+static esp_err_t bench_sync_request(mb_param_request_t *request, void *data)
+{
+    esp_err_t err = ESP_FAIL;
+    for (int i = 0; (i < BENCH_SYNC_RETRIES) && (err != ESP_OK); i++) {
+        if (i > 0) {
+            vTaskDelay(pdMS_TO_TICKS(BENCH_SYNC_RETRY_MS));
+        }
+        err = mbc_master_send_request(request, data);
+    }
+    return err;
+}
+
+// Write the shadow to the whole scratch area, the slave holds the known data afterwards.
+// The registers are written in chunks of the largest FC16 request.
+static esp_err_t bench_sync(void)
+{
+    uint8_t bits[BENCH_COIL_COUNT / 8];
+    uint16_t regs[BENCH_WRITE_REG_MAX];
+    memcpy(bits, bench_coils, sizeof(bits));
+    mb_param_request_t coils = {
+        .slave_addr = bench_config.slave_addr,
+        .command = BENCH_FC_WRITE_COILS,
+        .reg_start = bench_config.coil_start,
+        .reg_size = BENCH_COIL_COUNT,
+    };
+    esp_err_t err = bench_sync_request(&coils, bits);
+    for (uint16_t offset = 0; (offset < BENCH_REG_COUNT) && (err == ESP_OK); offset += BENCH_WRITE_REG_MAX) {
+        uint16_t count = ((BENCH_REG_COUNT - offset) < BENCH_WRITE_REG_MAX) ? (BENCH_REG_COUNT - offset) : BENCH_WRITE_REG_MAX;
+        memcpy(regs, &bench_regs[offset], count * sizeof(uint16_t));
+        mb_param_request_t request = {
+            .slave_addr = bench_config.slave_addr,
+            .command = BENCH_FC_WRITE_REGISTERS,
+            .reg_start = (uint16_t)(bench_config.reg_start + offset),
+            .reg_size = count,
+        };
+        err = bench_sync_request(&request, regs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Scratch areas not written (%s)", esp_err_to_name(err));
+    }
+    return err;
+}
+
+static uint8_t bench_pick_func(uint32_t rnd)
+{
+    uint32_t slot = rnd & 0x0F;
+    for (size_t i = 0; i < sizeof(bench_mix) / sizeof(bench_mix[0]); i++) {
+        if (slot < bench_mix[i].weight) {
+            return bench_mix[i].func;
+        }
+        slot -= bench_mix[i].weight;
+    }
+    return BENCH_FC_READ_HOLDING;
+}
+
+static size_t bench_func_index(uint8_t func)
+{
+    switch (func) {
+    case BENCH_FC_READ_COILS:
+        return 0;
+    case BENCH_FC_READ_HOLDING:
+        return 1;
+    case BENCH_FC_WRITE_REGISTER:
+        return 2;
+    case BENCH_FC_WRITE_COILS:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+// Count the completed request and roll the rate and heap samples over each full second
+static void bench_account(uint8_t func, esp_err_t err, bool mismatch, uint32_t latency_us)
+{
+    mb_trans_info_t info = { 0 };
+    if (err == ESP_ERR_INVALID_RESPONSE) {
+        (void)mbc_master_get_transaction_info(&info);
+    }
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(bench_lock, portMAX_DELAY);
+    bench_stats.requests++;
+    bench_stats.func_requests[bench_func_index(func)]++;
+    if (err != ESP_OK) {
+        bench_stats.errors++;
+        if (err == ESP_ERR_TIMEOUT) {
+            bench_stats.timeouts++;
+        } else if ((err == ESP_ERR_INVALID_RESPONSE) && (info.exception != 0)) {
+            bench_stats.exceptions++;
+        } else if (err == ESP_ERR_INVALID_RESPONSE) {
+            // Received frame with bad CRC, length or content
+            bench_stats.crc_errors++;
+        }
+    } else {
+        bench_stats.mismatches += mismatch ? 1 : 0;
+        bench_hist[bench_hist_index(latency_us)]++;
+        if (latency_us > bench_stats.max_us) {
+            bench_stats.max_us = latency_us;
+        }
+    }
+    bench_second_count++;
+    if ((now - bench_second_us) >= 1000000) {
+        bench_stats.rate = bench_second_count;
+        bench_stats.rate_min = (bench_second_count < bench_stats.rate_min) ? bench_second_count : bench_stats.rate_min;
+        bench_stats.rate_max = (bench_second_count > bench_stats.rate_max) ? bench_second_count : bench_stats.rate_max;
+        bench_second_count = 0;
+        bench_second_us += 1000000;
+        if ((now - bench_second_us) >= 1000000) {
+            // The request took longer than a second, restart the second grid
+            bench_second_us = now;
+        }
+        uint32_t heap = esp_get_free_heap_size();
+        bench_stats.heap_drift = (int32_t)(heap - bench_stats.heap_start);
+        bench_stats.heap_min = (heap < bench_stats.heap_min) ? heap : bench_stats.heap_min;
+    }
+    xSemaphoreGive(bench_lock);
+}
+
+static void bench_task(void *arg)
+{
+    uint16_t regs[BENCH_REG_COUNT];
+    uint8_t bits[BENCH_COIL_COUNT / 8];
+
+    for (size_t i = 0; i < BENCH_REG_COUNT; i++) {
+        bench_regs[i] = (uint16_t)esp_random();
+    }
+    esp_fill_random(bench_coils, sizeof(bench_coils));
+    if (bench_sync() != ESP_OK) {
+        // No slave answers on the bench UART, the run does not start
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_LOGI(TAG, "Scratch areas written, bench traffic started");
+
+    xSemaphoreTake(bench_lock, portMAX_DELAY);
+    bench_stats.running = true;
+    bench_clear();
+    xSemaphoreGive(bench_lock);
+
+    while (1) {
+        uint32_t rnd = esp_random();
+        uint8_t func = bench_pick_func(rnd);
+        bool regs_func = (func != BENCH_FC_READ_COILS) && (func != BENCH_FC_WRITE_COILS);
+        uint16_t area = regs_func ? BENCH_REG_COUNT : BENCH_COIL_COUNT;
+        uint16_t count_max = (func == BENCH_FC_WRITE_REGISTERS) ? BENCH_WRITE_REG_MAX : area;
+        uint16_t count = (func == BENCH_FC_WRITE_REGISTER) ? 1 : (uint16_t)(1 + ((rnd >> 4) % count_max));
+        uint16_t offset = (uint16_t)(esp_random() % (area - count + 1));
+
+        mb_param_request_t request = {
+            .slave_addr = bench_config.slave_addr,
+            .command = func,
+            .reg_start = (uint16_t)(offset + (regs_func ? bench_config.reg_start : bench_config.coil_start)),
+            .reg_size = count,
+        };
+        if ((func == BENCH_FC_WRITE_REGISTER) || (func == BENCH_FC_WRITE_REGISTERS)) {
+            for (uint16_t i = 0; i < count; i++) {
+                regs[i] = (uint16_t)esp_random();
+            }
+        } else if (func == BENCH_FC_WRITE_COILS) {
+            esp_fill_random(bits, (count + 7) / 8);
+        }
+
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = mbc_master_send_request(&request, regs_func ? (void *)regs : (void *)bits);
+        uint32_t latency_us = (uint32_t)(esp_timer_get_time() - start);
+
+        bool mismatch = false;
+        bool written = (func == BENCH_FC_WRITE_REGISTER) || (func == BENCH_FC_WRITE_REGISTERS)
+                       || (func == BENCH_FC_WRITE_COILS);
+        if (err == ESP_OK) {
+            if (func == BENCH_FC_READ_HOLDING) {
+                mismatch = (memcmp(regs, &bench_regs[offset], count * sizeof(uint16_t)) != 0);
+            } else if (func == BENCH_FC_READ_COILS) {
+                for (uint16_t i = 0; (i < count) && !mismatch; i++) {
+                    mismatch = (bench_get_bit(bits, i) != bench_get_bit(bench_coils, offset + i));
+                }
+            } else if (regs_func) {
+                memcpy(&bench_regs[offset], regs, count * sizeof(uint16_t));
+            } else {
+                for (uint16_t i = 0; i < count; i++) {
+                    bench_set_bit(bench_coils, offset + i, bench_get_bit(bits, i));
+                }
+            }
+        }
+        bench_account(func, err, mismatch, latency_us);
+
+        if ((written && (err != ESP_OK)) || mismatch) {
+            // The slave may or may not hold the data of the failed write, restore the known state.
+            // A failed sync shows up as mismatches of the next reads, which sync again.
+            (void)bench_sync();
+        }
+    }
+}
+
+// Route the bench TX pad to the slave RX and the slave TX pad to the bench RX
+static void bench_loop_pins(const bench_config_t *config)
+{
+    PIN_INPUT_ENABLE(GPIO_PIN_MUX_REG[config->txd_pin]);
+    PIN_INPUT_ENABLE(GPIO_PIN_MUX_REG[config->loop_slave_txd_pin]);
+    esp_rom_gpio_connect_in_signal(config->txd_pin,
+                                   UART_PERIPH_SIGNAL(config->loop_slave_port, SOC_UART_RX_PIN_IDX), false);
+    esp_rom_gpio_connect_in_signal(config->loop_slave_txd_pin,
+                                   UART_PERIPH_SIGNAL(config->uart_port, SOC_UART_RX_PIN_IDX), false);
+}
+
+esp_err_t bench_start(const bench_config_t *config)
+{
+    void *master_handler = NULL;
+
+    if (config->uart_port == CONFIG_MB_UART_PORT_NUM) {
+        ESP_LOGE(TAG, "Bench UART %d is used by the slave", config->uart_port);
+        return ESP_ERR_INVALID_ARG;
+    }
+    bench_config = *config;
+#ifdef CONFIG_APP_STATIC_ALLOCATION
+    static StaticSemaphore_t bench_lock_buf;
+    bench_lock = xSemaphoreCreateMutexStatic(&bench_lock_buf);
+#else
+    bench_lock = xSemaphoreCreateMutex();
+#endif
+    if (bench_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    bench_clear();
+
+    esp_err_t err = mbc_master_init(MB_PORT_SERIAL_MASTER, &master_handler);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Master init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    mb_communication_info_t comm_info = { 0 };
+    comm_info.port = config->uart_port;
+    comm_info.mode = MB_MODE_RTU;
+    comm_info.baudrate = config->baudrate;
+    comm_info.parity = config->parity;
+    err = mbc_master_setup(&comm_info);
+    if (err == ESP_OK) {
+        err = mbc_master_start();
+    }
+    if (err == ESP_OK) {
+        err = uart_set_stop_bits(config->uart_port, config->stop_bits);
+    }
+    if ((err == ESP_OK) && (config->loop_slave_port >= 0)) {
+        err = uart_set_pin(config->uart_port, config->txd_pin, UART_PIN_NO_CHANGE,
+                           UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+        if (err == ESP_OK) {
+            bench_loop_pins(config);
+        }
+    } else if (err == ESP_OK) {
+        err = uart_set_pin(config->uart_port, config->txd_pin, config->rxd_pin,
+                           (config->rts_pin >= 0) ? config->rts_pin : UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+        if (err == ESP_OK) {
+            err = uart_set_mode(config->uart_port, (config->rts_pin >= 0) ? UART_MODE_RS485_HALF_DUPLEX
+                                                                         : UART_MODE_RS485_COLLISION_DETECT);
+        }
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Master start failed: %s", esp_err_to_name(err));
+        mbc_master_destroy();
+        return err;
+    }
+
+#ifdef CONFIG_APP_STATIC_ALLOCATION
+    static StaticTask_t bench_task_buf;
+    static StackType_t bench_task_stack[BENCH_TASK_STACK];
+    TaskHandle_t task = xTaskCreateStaticPinnedToCore(bench_task, "mb_bench", BENCH_TASK_STACK, NULL,
+                                                      BENCH_TASK_PRIO, bench_task_stack, &bench_task_buf,
+                                                      config->core);
+#else
+    TaskHandle_t task = NULL;
+    (void)xTaskCreatePinnedToCore(bench_task, "mb_bench", BENCH_TASK_STACK, NULL, BENCH_TASK_PRIO,
+                                  &task, config->core);
+#endif
+    if (task == NULL) {
+        mbc_master_destroy();
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Bench master on UART%d (%lu baud, %s loop) to slave %u", config->uart_port,
+             config->baudrate, (config->loop_slave_port >= 0) ? "internal" : "wired", config->slave_addr);
+    return ESP_OK;
+}
+
+void bench_get_stats(bench_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (bench_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(bench_lock, portMAX_DELAY);
+    *stats = bench_stats;
+    uint32_t total = 0;
+    for (size_t i = 0; i < BENCH_HIST_BUCKETS; i++) {
+        total += bench_hist[i];
+    }
+    if (total > 0) {
+        stats->p50_us = bench_percentile(total, 500);
+        stats->p90_us = bench_percentile(total, 900);
+        stats->p99_us = bench_percentile(total, 990);
+        stats->p999_us = bench_percentile(total, 999);
+    }
+    stats->elapsed_s = (uint32_t)((esp_timer_get_time() - bench_start_us) / 1000000);
+    xSemaphoreGive(bench_lock);
+    if (stats->rate_min == UINT32_MAX) {
+        stats->rate_min = 0;
+    }
+}
+
+void bench_reset(void)
+{
+    if (bench_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(bench_lock, portMAX_DELAY);
+    bench_clear();
+    xSemaphoreGive(bench_lock);
+}
+
+#endif
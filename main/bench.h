@@ -0,0 +1,78 @@
+/*
+ * Loopback soak test of the RTU slave
+ *
+ * The serial master of the Modbus component runs on a second UART which is
+ * wired to the slave UART or looped to it inside the chip through the GPIO
+ * matrix. The bench task sends randomized FC01/03/06/15/16 requests to the
+ * scratch coils and holding registers of the slave back to back, checks the
+ * read data against the values written before and keeps the request rate,
+ * the latency histogram, the error counters and the heap drift of the run.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/uart.h"
+
+#define BENCH_REG_COUNT     (125)   // Scratch holding registers, the largest FC03 request
+#define BENCH_WRITE_REG_MAX (120)   // Largest FC16 request accepted by the slave
+#define BENCH_COIL_COUNT    (256)   // Scratch coils
+
+// Settings of the bench master
+typedef struct {
+    int uart_port;              // UART of the bench master, not the UART of the slave
+    uint32_t baudrate;          // Communication settings of the slave
+    uart_parity_t parity;
+    uart_stop_bits_t stop_bits;
+    int txd_pin;
+    int rxd_pin;                // Unused with the internal loop
+    int rts_pin;                // RS485 DE/RE pin, -1 for auto direction transceiver or the internal loop
+    int loop_slave_port;        // Slave UART looped to the bench UART inside the chip, -1 if wired
+    int loop_slave_txd_pin;     // TXD pin of the slave UART for the internal loop
+    uint8_t slave_addr;
+    uint16_t reg_start;         // First of BENCH_REG_COUNT scratch holding registers of the slave
+    uint16_t coil_start;        // First of BENCH_COIL_COUNT scratch coils of the slave
+    int core;                   // Core of the bench task
+} bench_config_t;
+
+// Counters of the run since the start or the last reset
+typedef struct {
+    bool running;
+    uint32_t elapsed_s;
+    uint32_t requests;          // Completed requests
+    uint32_t errors;            // Requests failed for any reason
+    uint32_t timeouts;          // No response from the slave
+    uint32_t crc_errors;        // Response with bad CRC or length
+    uint32_t exceptions;        // Exception response
+    uint32_t mismatches;        // Read data differing from the data written before
+    uint32_t func_requests[5];  // Requests per function: FC01, FC03, FC06, FC15, FC16
+    uint32_t rate;              // Requests in the last full second
+    uint32_t rate_min;          // Lowest and highest rate of the full seconds of the run
+    uint32_t rate_max;
+    uint32_t p50_us;            // Latency percentiles, upper bound of the histogram bucket
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t p999_us;
+    uint32_t max_us;
+    uint32_t heap_start;        // Free heap at the start of the run
+    int32_t heap_drift;         // Free heap now minus heap_start
+    uint32_t heap_min;          // Lowest free heap sampled during the run
+} bench_stats_t;
+
+/**
+ * @brief Start the serial master on the bench UART and the bench task
+ *
+ * The slave has to be started and its scratch areas registered before.
+ */
+esp_err_t bench_start(const bench_config_t *config);
+
+/**
+ * @brief Get the counters of the run
+ */
+void bench_get_stats(bench_stats_t *stats);
+
+/**
+ * @brief Restart the run: clear the counters and the histogram, sample the heap again
+ */
+void bench_reset(void);
@@ -0,0 +1,89 @@
+/*
+ * Environmental sampling on the ULP-RISC-V coprocessor, see envsense.h
+ */
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "envsense.h"
+
+#if CONFIG_APP_ULP_SAMPLING
+#include "ulp_riscv.h"
+#include "hal/temperature_sensor_ll.h"
+#if CONFIG_APP_ULP_ADC_CHANNEL >= 0
+#include "ulp_adc.h"
+#endif
+#if CONFIG_APP_LIGHT_SLEEP
+#include "esp_sleep.h"
+#endif
+#include "ulp_envsense.h"
+
+extern const uint8_t ulp_envsense_bin_start[] asm("_binary_ulp_envsense_bin_start");
+extern const uint8_t ulp_envsense_bin_end[] asm("_binary_ulp_envsense_bin_end");
+
+static const char *TAG = "ENVSENSE";
+
+esp_err_t envsense_start(temperature_sensor_handle_t tsens)
+{
+    // One point calibration: the slope of the sensor is fixed, the offset includes the
+    // measurement range and the eFuse calibration applied by the driver
+    float celsius = 0;
+    esp_err_t err = temperature_sensor_get_celsius(tsens, &celsius);
+    if (err != ESP_OK) {
+        return err;
+    }
+    int32_t slope = (int32_t)(TEMPERATURE_SENSOR_LL_ADC_FACTOR * 10000);
+    int32_t raw = (int32_t)temperature_sensor_ll_get_raw_value();
+
+#if CONFIG_APP_ULP_ADC_CHANNEL >= 0
+    const ulp_adc_cfg_t adc_cfg = {
+        .adc_n = ADC_UNIT_1,
+        .channel = CONFIG_APP_ULP_ADC_CHANNEL,
+        .width = ADC_BITWIDTH_DEFAULT,
+        .atten = ADC_ATTEN_DB_12,
+        .ulp_mode = ADC_ULP_MODE_RISCV,
+    };
+    err = ulp_adc_init(&adc_cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ULP ADC init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+#endif
+
+    err = ulp_riscv_load_binary(ulp_envsense_bin_start, ulp_envsense_bin_end - ulp_envsense_bin_start);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ULP program load failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    ulp_tsens_slope = slope;
+    ulp_tsens_offset = (int32_t)(celsius * 10000) - raw * slope;
+    // The registers hold the calibration reading until the first wakeup of the ULP
+    volatile uint16_t *regs = envsense_regs();
+    uint16_t temp_x10 = (uint16_t)(int16_t)(celsius * 10);
+    regs[ENVSENSE_REG_TEMP] = temp_x10;
+    regs[ENVSENSE_REG_TEMP_RAW] = temp_x10;
+    regs[ENVSENSE_REG_TEMP_MIN] = temp_x10;
+    regs[ENVSENSE_REG_TEMP_MAX] = temp_x10;
+#if CONFIG_APP_LIGHT_SLEEP
+    // The sensor and the ULP keep running while the HP cores are in light sleep
+    (void)esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+#endif
+    err = ulp_set_wakeup_period(0, CONFIG_APP_ULP_PERIOD_MS * 1000);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ULP wakeup period %d ms rejected: %s", CONFIG_APP_ULP_PERIOD_MS, esp_err_to_name(err));
+        return err;
+    }
+    err = ulp_riscv_run();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ULP program start failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "ULP sampling every %d ms, filter 1/%d, ADC1 channel %d", CONFIG_APP_ULP_PERIOD_MS,
+             1 << CONFIG_APP_ULP_FILTER_SHIFT, CONFIG_APP_ULP_ADC_CHANNEL);
+    return ESP_OK;
+}
+
+volatile uint16_t *envsense_regs(void)
+{
+    return (volatile uint16_t *)&ulp_env_regs;
+}
+
+#endif
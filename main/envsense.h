@@ -0,0 +1,29 @@
+/*
+ * Environmental sampling on the ULP-RISC-V coprocessor
+ *
+ * The ULP program samples the chip temperature sensor (and an optional ADC1
+ * channel) every CONFIG_APP_ULP_PERIOD_MS, filters the samples and writes
+ * the input register block in RTC memory (ulp/envsense_regs.h). The block
+ * is registered as an input register area without lock, so the Modbus reads
+ * get the current filtered values without a task copying them and without
+ * waking the HP cores.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/temperature_sensor.h"
+#include "ulp/envsense_regs.h"
+
+/**
+ * @brief Load and start the ULP program
+ *
+ * @param tsens enabled temperature sensor, its reading calibrates the conversion of the raw
+ *              samples of the ULP. The HP cores must not read the sensor afterwards.
+ */
+esp_err_t envsense_start(temperature_sensor_handle_t tsens);
+
+/**
+ * @brief Get the input register block in RTC memory, ENVSENSE_REG_COUNT registers
+ */
+volatile uint16_t *envsense_regs(void);
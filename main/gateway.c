@@ -0,0 +1,475 @@
+/*
+ * Modbus TCP to RTU gateway, see gateway.h
+ */
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mbcontroller.h"
+#include "gateway.h"
+
+#if CONFIG_APP_MODBUS_GATEWAY
+
+#define GATEWAY_SLOTS           (CONFIG_APP_GATEWAY_SLOTS)  // Requests in flight and cached read results
+#define GATEWAY_WAITERS_MAX     (8)     // TCP requests answered by one bus request
+#define GATEWAY_DATA_MAX        (250)   // Data of the largest read: 125 registers or 2000 bits
+#define GATEWAY_PDU_MAX         (253)
+#define GATEWAY_DEADLINE_MS     (1000)  // Requests which wait longer in the master queue fail
+#define GATEWAY_UNIT_MAX        (247)   // Highest RTU slave address
+
+// Function codes forwarded to the RTU bus
+#define GATEWAY_FC_READ_COILS       (0x01)
+#define GATEWAY_FC_READ_DISCRETE    (0x02)
+#define GATEWAY_FC_READ_HOLDING     (0x03)
+#define GATEWAY_FC_READ_INPUT       (0x04)
+#define GATEWAY_FC_WRITE_COIL       (0x05)
+#define GATEWAY_FC_WRITE_REGISTER   (0x06)
+#define GATEWAY_FC_WRITE_COILS      (0x0F)
+#define GATEWAY_FC_WRITE_REGISTERS  (0x10)
+#define GATEWAY_FC_ERROR            (0x80)
+
+// Exception codes of the gateway responses
+#define GATEWAY_EX_ILLEGAL_FUNCTION (0x01)
+#define GATEWAY_EX_ILLEGAL_VALUE    (0x03)
+#define GATEWAY_EX_DEVICE_FAILURE   (0x04)
+#define GATEWAY_EX_BUSY             (0x06)
+#define GATEWAY_EX_PATH_FAILED      (0x0A)
+#define GATEWAY_EX_TARGET_FAILED    (0x0B)
+
+#define GATEWAY_GET_U16(buf)        ((uint16_t)(((buf)[0] << 8) | (buf)[1]))
+
+typedef enum {
+    GATEWAY_SLOT_FREE = 0,
+    GATEWAY_SLOT_PENDING,       // Queued or executed by the master
+    GATEWAY_SLOT_CACHED,        // Completed read, valid until expire_us
+} gateway_slot_state_t;
+
+// TCP request answered by the slot, the range is within the range of the slot
+typedef struct {
+    uint32_t tag;
+    uint16_t start;
+    uint16_t count;
+} gateway_waiter_t;
+
+typedef struct {
+    gateway_slot_state_t state;
+    bool stale;                 // The range was written meanwhile, the result is not cached
+    uint8_t unit_id;
+    uint8_t func;
+    uint16_t start;
+    uint16_t count;
+    int64_t expire_us;
+    size_t waiter_count;
+    gateway_waiter_t waiters[GATEWAY_WAITERS_MAX];
+    uint8_t data[GATEWAY_DATA_MAX]; // Registers in host byte order or packed bits, as the master API uses them
+} gateway_slot_t;
+
+static const char *TAG = "GATEWAY";
+
+static gateway_slot_t slots[GATEWAY_SLOTS];
+static SemaphoreHandle_t gateway_lock = NULL;
+static uint32_t gateway_ttl_us = 0;
+static gateway_stats_t gateway_stats = { 0 };
+static uint8_t gateway_pdu[GATEWAY_PDU_MAX];    // Response under construction, protected by the lock
+
+static bool gateway_is_read(uint8_t func)
+{
+    return (func >= GATEWAY_FC_READ_COILS) && (func <= GATEWAY_FC_READ_INPUT);
+}
+
+static bool gateway_is_bits(uint8_t func)
+{
+    return (func == GATEWAY_FC_READ_COILS) || (func == GATEWAY_FC_READ_DISCRETE)
+           || (func == GATEWAY_FC_WRITE_COIL) || (func == GATEWAY_FC_WRITE_COILS);
+}
+
+// Read function code of the table which is changed by the write
+static uint8_t gateway_read_func(uint8_t func)
+{
+    return gateway_is_bits(func) ? GATEWAY_FC_READ_COILS : GATEWAY_FC_READ_HOLDING;
+}
+
+static bool gateway_covers(const gateway_slot_t *slot, uint16_t start, uint16_t count)
+{
+    return (start >= slot->start) && ((uint32_t)start + count <= (uint32_t)slot->start + slot->count);
+}
+
+static bool gateway_overlaps(const gateway_slot_t *slot, uint16_t start, uint16_t count)
+{
+    return ((uint32_t)start < (uint32_t)slot->start + slot->count)
+           && ((uint32_t)slot->start < (uint32_t)start + count);
+}
+
+static void gateway_send(uint32_t tag, uint8_t unit_id, const uint8_t *pdu, uint16_t len)
+{
+    if (mbc_slave_tcp_forward_done(tag, unit_id, pdu, len) != ESP_OK) {
+        ESP_LOGD(TAG, "Response to unit %u is not delivered, client disconnected", unit_id);
+    }
+}
+
+static void gateway_send_exception(uint32_t tag, uint8_t unit_id, uint8_t func, uint8_t code)
+{
+    uint8_t pdu[2] = { (uint8_t)(func | GATEWAY_FC_ERROR), code };
+    gateway_stats.exceptions++;
+    gateway_send(tag, unit_id, pdu, sizeof(pdu));
+}
+
+// Build the response of the waiter from the slot data into gateway_pdu, returns the length
+static uint16_t gateway_build_response(const gateway_slot_t *slot, const gateway_waiter_t *waiter)
+{
+    uint16_t len = 0;
+    gateway_pdu[len++] = slot->func;
+    switch (slot->func) {
+    case GATEWAY_FC_READ_COILS:
+    case GATEWAY_FC_READ_DISCRETE: {
+        uint16_t bytes = (waiter->count + 7) / 8;
+        uint16_t offset = waiter->start - slot->start;
+        gateway_pdu[len++] = (uint8_t)bytes;
+        memset(&gateway_pdu[len], 0, bytes);
+        for (uint16_t i = 0; i < waiter->count; i++) {
+            uint16_t bit = offset + i;
+            if (slot->data[bit / 8] & (1U << (bit % 8))) {
+                gateway_pdu[len + i / 8] |= (uint8_t)(1U << (i % 8));
+            }
+        }
+        len += bytes;
+        break;
+    }
+    case GATEWAY_FC_READ_HOLDING:
+    case GATEWAY_FC_READ_INPUT: {
+        const uint16_t *regs = (const uint16_t *)slot->data + (waiter->start - slot->start);
+        gateway_pdu[len++] = (uint8_t)(waiter->count * 2);
+        for (uint16_t i = 0; i < waiter->count; i++) {
+            gateway_pdu[len++] = (uint8_t)(regs[i] >> 8);
+            gateway_pdu[len++] = (uint8_t)(regs[i] & 0xFF);
+        }
+        break;
+    }
+    case GATEWAY_FC_WRITE_COIL:
+    case GATEWAY_FC_WRITE_REGISTER: {
+        // The response echoes the request
+        uint16_t value = *(const uint16_t *)slot->data;
+        gateway_pdu[len++] = (uint8_t)(slot->start >> 8);
+        gateway_pdu[len++] = (uint8_t)(slot->start & 0xFF);
+        gateway_pdu[len++] = (uint8_t)(value >> 8);
+        gateway_pdu[len++] = (uint8_t)(value & 0xFF);
+        break;
+    }
+    default:
+        // Multiple coils or registers written
+        gateway_pdu[len++] = (uint8_t)(slot->start >> 8);
+        gateway_pdu[len++] = (uint8_t)(slot->start & 0xFF);
+        gateway_pdu[len++] = (uint8_t)(slot->count >> 8);
+        gateway_pdu[len++] = (uint8_t)(slot->count & 0xFF);
+        break;
+    }
+    return len;
+}
+
+// Exception of the failed bus request, the master API does not report the exception code of the slave
+static uint8_t gateway_exception(esp_err_t err)
+{
+    switch (err) {
+    case ESP_ERR_TIMEOUT:
+        return GATEWAY_EX_TARGET_FAILED;
+    case ESP_ERR_NOT_SUPPORTED:
+        return GATEWAY_EX_ILLEGAL_FUNCTION;
+    case ESP_ERR_INVALID_STATE:
+    case ESP_ERR_NO_MEM:
+        return GATEWAY_EX_BUSY;
+    default:
+        return GATEWAY_EX_DEVICE_FAILURE;
+    }
+}
+
+// Completion of the bus request, runs in the worker task of the master
+static void gateway_bus_done(const mb_master_async_result_t *result)
+{
+    gateway_slot_t *slot = (gateway_slot_t *)result->arg;
+
+    xSemaphoreTake(gateway_lock, portMAX_DELAY);
+    for (size_t i = 0; i < slot->waiter_count; i++) {
+        if (result->error == ESP_OK) {
+            gateway_send(slot->waiters[i].tag, slot->unit_id, gateway_pdu,
+                         gateway_build_response(slot, &slot->waiters[i]));
+        } else {
+            gateway_send_exception(slot->waiters[i].tag, slot->unit_id, slot->func, gateway_exception(result->error));
+        }
+    }
+    slot->waiter_count = 0;
+    if ((result->error == ESP_OK) && gateway_is_read(slot->func) && !slot->stale && (gateway_ttl_us != 0)) {
+        slot->state = GATEWAY_SLOT_CACHED;
+        slot->expire_us = esp_timer_get_time() + gateway_ttl_us;
+    } else {
+        slot->state = GATEWAY_SLOT_FREE;
+    }
+    xSemaphoreGive(gateway_lock);
+}
+
+// Take a free slot or the cached slot which expires first
+static gateway_slot_t *gateway_alloc_slot(void)
+{
+    gateway_slot_t *victim = NULL;
+    for (size_t i = 0; i < GATEWAY_SLOTS; i++) {
+        gateway_slot_t *slot = &slots[i];
+        if (slot->state == GATEWAY_SLOT_FREE) {
+            return slot;
+        }
+        if ((slot->state == GATEWAY_SLOT_CACHED) && ((victim == NULL) || (slot->expire_us < victim->expire_us))) {
+            victim = slot;
+        }
+    }
+    return victim;
+}
+
+// Find the slot which answers the read: valid cached data or a read in flight
+static gateway_slot_t *gateway_find_read(uint8_t unit_id, uint8_t func, uint16_t start, uint16_t count, int64_t now)
+{
+    for (size_t i = 0; i < GATEWAY_SLOTS; i++) {
+        gateway_slot_t *slot = &slots[i];
+        if ((slot->state == GATEWAY_SLOT_FREE) || (slot->unit_id != unit_id) || (slot->func != func)
+            || !gateway_covers(slot, start, count)) {
+            continue;
+        }
+        if ((slot->state == GATEWAY_SLOT_CACHED) && (now < slot->expire_us)) {
+            return slot;
+        }
+        if ((slot->state == GATEWAY_SLOT_PENDING) && !slot->stale && (slot->waiter_count < GATEWAY_WAITERS_MAX)) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+// Drop the cached reads of the written range and do not cache the reads in flight
+static void gateway_invalidate(uint8_t unit_id, uint8_t write_func, uint16_t start, uint16_t count)
+{
+    uint8_t func = gateway_read_func(write_func);
+    for (size_t i = 0; i < GATEWAY_SLOTS; i++) {
+        gateway_slot_t *slot = &slots[i];
+        // Input registers and discrete inputs may map the written data, they are dropped as well
+        bool same_table = (slot->func == func) || ((func == GATEWAY_FC_READ_HOLDING) && (slot->func == GATEWAY_FC_READ_INPUT))
+                          || ((func == GATEWAY_FC_READ_COILS) && (slot->func == GATEWAY_FC_READ_DISCRETE));
+        if ((slot->state == GATEWAY_SLOT_FREE) || (slot->unit_id != unit_id) || !same_table
+            || !gateway_overlaps(slot, start, count)) {
+            continue;
+        }
+        if (slot->state == GATEWAY_SLOT_CACHED) {
+            slot->state = GATEWAY_SLOT_FREE;
+        } else {
+            slot->stale = true;
+        }
+    }
+}
+
+// Decode the request into the slot fields, returns the exception code or 0
+static uint8_t gateway_decode(gateway_slot_t *req, const uint8_t *pdu, uint16_t len)
+{
+    if (len < 5) {
+        return GATEWAY_EX_ILLEGAL_VALUE;
+    }
+    req->start = GATEWAY_GET_U16(&pdu[1]);
+    req->count = GATEWAY_GET_U16(&pdu[3]);
+    switch (req->func) {
+    case GATEWAY_FC_READ_COILS:
+    case GATEWAY_FC_READ_DISCRETE:
+        return ((req->count >= 1) && (req->count <= 2000)) ? 0 : GATEWAY_EX_ILLEGAL_VALUE;
+    case GATEWAY_FC_READ_HOLDING:
+    case GATEWAY_FC_READ_INPUT:
+        return ((req->count >= 1) && (req->count <= 125)) ? 0 : GATEWAY_EX_ILLEGAL_VALUE;
+    case GATEWAY_FC_WRITE_COIL:
+    case GATEWAY_FC_WRITE_REGISTER: {
+        uint16_t value = req->count;
+        if ((req->func == GATEWAY_FC_WRITE_COIL) && (value != 0xFF00) && (value != 0x0000)) {
+            return GATEWAY_EX_ILLEGAL_VALUE;
+        }
+        memcpy(req->data, &value, sizeof(value));
+        req->count = 1;
+        return 0;
+    }
+    case GATEWAY_FC_WRITE_COILS: {
+        uint16_t bytes = (req->count + 7) / 8;
+        if ((req->count < 1) || (req->count > 1968) || (len < 6) || (pdu[5] != bytes) || (len < 6 + bytes)) {
+            return GATEWAY_EX_ILLEGAL_VALUE;
+        }
+        memcpy(req->data, &pdu[6], bytes);
+        return 0;
+    }
+    case GATEWAY_FC_WRITE_REGISTERS: {
+        uint16_t *regs = (uint16_t *)req->data;
+        if ((req->count < 1) || (req->count > 123) || (len < 6) || (pdu[5] != req->count * 2)
+            || (len < 6 + req->count * 2)) {
+            return GATEWAY_EX_ILLEGAL_VALUE;
+        }
+        for (uint16_t i = 0; i < req->count; i++) {
+            regs[i] = GATEWAY_GET_U16(&pdu[6 + i * 2]);
+        }
+        return 0;
+    }
+    default:
+        return GATEWAY_EX_ILLEGAL_FUNCTION;
+    }
+}
+
+// Answer the request from the cache, join it to a read in flight or queue it to the master
+static void gateway_process(uint32_t tag, uint8_t unit_id, const uint8_t *pdu, uint16_t len)
+{
+    static gateway_slot_t req;      // Decoded request, used by the TCP port task only
+    uint8_t func = pdu[0];
+
+    if ((unit_id > GATEWAY_UNIT_MAX) || ((unit_id == 0) && gateway_is_read(func))) {
+        // No such RTU slave, a broadcast can not be read
+        gateway_send_exception(tag, unit_id, func, GATEWAY_EX_PATH_FAILED);
+        return;
+    }
+    req.func = func;
+    uint8_t ex = gateway_decode(&req, pdu, len);
+    if (ex != 0) {
+        gateway_send_exception(tag, unit_id, func, ex);
+        return;
+    }
+
+    gateway_slot_t *slot = NULL;
+    if (gateway_is_read(func)) {
+        slot = gateway_find_read(unit_id, func, req.start, req.count, esp_timer_get_time());
+        if (slot != NULL) {
+            gateway_waiter_t waiter = { .tag = tag, .start = req.start, .count = req.count };
+            if (slot->state == GATEWAY_SLOT_CACHED) {
+                gateway_stats.cache_hits++;
+                gateway_send(tag, unit_id, gateway_pdu, gateway_build_response(slot, &waiter));
+            } else {
+                // Answered on completion of the identical or wider read
+                slot->waiters[slot->waiter_count++] = waiter;
+                gateway_stats.joined++;
+            }
+            return;
+        }
+    } else {
+        gateway_invalidate(unit_id, func, req.start, req.count);
+    }
+
+    slot = gateway_alloc_slot();
+    if (slot == NULL) {
+        gateway_send_exception(tag, unit_id, func, GATEWAY_EX_BUSY);
+        return;
+    }
+    memcpy(slot->data, req.data, sizeof(slot->data));
+    slot->stale = false;
+    slot->unit_id = unit_id;
+    slot->func = func;
+    slot->start = req.start;
+    slot->count = req.count;
+    slot->waiters[0].tag = tag;
+    slot->waiters[0].start = req.start;
+    slot->waiters[0].count = req.count;
+
+    mb_param_request_t request = {
+        .slave_addr = unit_id,
+        .command = func,
+        .reg_start = req.start,
+        .reg_size = req.count,
+    };
+    mb_master_async_opts_t opts = {
+        .priority = 0,
+        .deadline_ms = GATEWAY_DEADLINE_MS,
+        .callback = gateway_bus_done,
+        .queue = NULL,
+        .arg = slot,
+    };
+    // The completion takes the lock, it can not run before the slot is set up
+    if (mbc_master_send_request_async(&request, slot->data, &opts, NULL) != ESP_OK) {
+        slot->state = GATEWAY_SLOT_FREE;
+        gateway_send_exception(tag, unit_id, func, GATEWAY_EX_BUSY);
+        return;
+    }
+    slot->state = GATEWAY_SLOT_PENDING;
+    slot->waiter_count = 1;
+    gateway_stats.bus_requests++;
+}
+
+// Forward handler of the TCP slave, runs in the TCP port task
+static bool gateway_forward(uint32_t tag, uint8_t unit_id, const uint8_t *pdu, uint16_t len, void *arg)
+{
+    xSemaphoreTake(gateway_lock, portMAX_DELAY);
+    gateway_stats.requests++;
+    gateway_process(tag, unit_id, pdu, len);
+    xSemaphoreGive(gateway_lock);
+    return true;
+}
+
+esp_err_t gateway_start(const gateway_config_t *config)
+{
+    void *master_handler = NULL;
+
+    if (config->uart_port == CONFIG_MB_UART_PORT_NUM) {
+        ESP_LOGE(TAG, "Gateway UART %d is used by the slave", config->uart_port);
+        return ESP_ERR_INVALID_ARG;
+    }
+#ifdef CONFIG_APP_STATIC_ALLOCATION
+    static StaticSemaphore_t gateway_lock_buf;
+    gateway_lock = xSemaphoreCreateMutexStatic(&gateway_lock_buf);
+#else
+    gateway_lock = xSemaphoreCreateMutex();
+#endif
+    if (gateway_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    gateway_ttl_us = config->cache_ttl_ms * 1000;
+
+    esp_err_t err = mbc_master_init(MB_PORT_SERIAL_MASTER, &master_handler);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Master init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    mb_communication_info_t comm_info = { 0 };
+    comm_info.port = config->uart_port;
+    comm_info.mode = MB_MODE_RTU;
+    comm_info.baudrate = config->baudrate;
+    comm_info.parity = config->parity;
+    err = mbc_master_setup(&comm_info);
+    if (err == ESP_OK) {
+        err = mbc_master_start();
+    }
+    if (err == ESP_OK) {
+        err = uart_set_pin(config->uart_port, config->txd_pin, config->rxd_pin,
+                           (config->rts_pin >= 0) ? config->rts_pin : UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    }
+    if (err == ESP_OK) {
+        err = uart_set_mode(config->uart_port, (config->rts_pin >= 0) ? UART_MODE_RS485_HALF_DUPLEX
+                                                                     : UART_MODE_RS485_COLLISION_DETECT);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Master start failed: %s", esp_err_to_name(err));
+        mbc_master_destroy();
+        return err;
+    }
+
+    err = mbc_slave_set_tcp_forward(gateway_forward, NULL);
+    if (err != ESP_OK) {
+        mbc_master_destroy();
+        return err;
+    }
+    ESP_LOGI(TAG, "Gateway to RTU bus on UART%d (%lu baud), cache TTL %lu ms",
+             config->uart_port, config->baudrate, config->cache_ttl_ms);
+    return ESP_OK;
+}
+
+void gateway_get_stats(gateway_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (gateway_lock == NULL) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(gateway_lock, portMAX_DELAY);
+    *stats = gateway_stats;
+    for (size_t i = 0; i < GATEWAY_SLOTS; i++) {
+        if ((slots[i].state == GATEWAY_SLOT_CACHED) && (now < slots[i].expire_us)) {
+            stats->cached++;
+        }
+    }
+    xSemaphoreGive(gateway_lock);
+}
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * Modbus TCP to RTU gateway
+ *
+ * The TCP requests whose unit identifier is not the unit identifier of this
+ * slave are forwarded to the RTU slave with the same address on the gateway
+ * UART, the box is the RTU master of that bus. The requests of all TCP
+ * clients share the bus through one request queue:
+ * - a read which is covered by an identical or wider read in flight waits for
+ *   that read instead of being sent again
+ * - a read which is covered by a read completed within the cache TTL is
+ *   answered from the cached data without bus access
+ * - a write invalidates the cached and in-flight reads of the same unit and
+ *   address range
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/uart.h"
+
+// Settings of the RTU bus behind the gateway
+typedef struct {
+    int uart_port;              // UART of the RTU bus, not the UART of the slave
+    uint32_t baudrate;
+    uart_parity_t parity;
+    int txd_pin;
+    int rxd_pin;
+    int rts_pin;                // RS485 DE/RE pin, -1 for auto direction transceiver
+    uint32_t cache_ttl_ms;      // Validity of the read results, 0 disables the cache
+} gateway_config_t;
+
+// Request counters of the gateway
+typedef struct {
+    uint32_t requests;          // Forwarded TCP requests
+    uint32_t cache_hits;        // Reads answered from the cache
+    uint32_t joined;            // Reads joined to a read in flight
+    uint32_t bus_requests;      // Requests sent to the RTU bus
+    uint32_t exceptions;        // Requests answered with an exception response
+    uint32_t cached;            // Number of the valid cache entries
+} gateway_stats_t;
+
+/**
+ * @brief Start the RTU master on the gateway UART and take the forwarded TCP requests
+ *
+ * The serial slave and its TCP transport have to be initialized before.
+ */
+esp_err_t gateway_start(const gateway_config_t *config);
+
+/**
+ * @brief Get the request counters
+ */
+void gateway_get_stats(gateway_stats_t *stats);
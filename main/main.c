@@ -5,6 +5,7 @@
  * - Register 0: Sequential counter (increments on each access)
  * - Register 1: Random number (updated every 5 seconds)
  * - Register 2: System uptime in seconds (low 16-bit)
+ *   Registers 2-8 are computed when read and cached for a short time
  * - Register 3-4: Free heap memory in KB (32-bit value)
  * - Register 5: Minimum free heap since boot (KB)
  * - Register 6: CPU frequency (MHz)
@@ -14,18 +15,69 @@
  * - Register 10: WiFi AP enabled (1=active, 0=disabled)
  * - Register 11: Number of connected WiFi clients
  *
+ * Holding registers 100+ (CONFIG_APP_RETAIN_REG_COUNT) are retained setpoints,
+ * the values written by the master are committed to NVS after a quiet period.
+ *
+ * With CONFIG_FMB_SLAVE_LATENCY_STATS the input registers 0-13 hold the request
+ * turnaround latency summary, the full histograms are available at /api/latency.
+ *
  * Features:
- * - WiFi AP active for 20 minutes after boot for configuration
- * - Web interface to configure slave ID and view statistics
+ * - WiFi AP active for 20 minutes after boot for configuration, then WiFi, the AP
+ *   netif, the event loop and the web server are released; writing 1 to coil 1000 or
+ *   the wake button (CONFIG_APP_WIFI_WAKE_GPIO) starts them again, the input registers
+ *   260-266 report the state and the heap reclaimed by the last stop
+ * - Web interface to configure slave ID and view statistics, with
+ *   CONFIG_APP_LIVE_WS the changes are pushed to the page over a WebSocket
+ * - With CONFIG_APP_RT_CORE_PROFILE the Modbus stack runs on core 1 and
+ *   WiFi, httpd and the application on core 0
+ * - With CONFIG_APP_MODBUS_TCP the same registers are served to Modbus TCP
+ *   clients on the WiFi AP next to the RTU slave, over UDP with CONFIG_APP_MODBUS_UDP
+ * - With CONFIG_APP_MODBUS_GATEWAY the TCP requests for other unit IDs are
+ *   bridged to the RTU slaves on a second UART
+ * - With CONFIG_FMB_SLAVE_CHANGE_TRACKING the holding registers 0-11 report their
+ *   changes beyond the deadbands over the change query function code and /api/changes
+ * - With CONFIG_APP_HISTORY_REG_COUNT the input registers 1000+ hold the chip
+ *   temperature history, large maps are placed in PSRAM
+ * - With CONFIG_APP_METRICS_RECORDS the input registers 22000+ hold a ring of periodic
+ *   records of uptime, heap, temperature, request and error rate and CPU load
+ * - With CONFIG_APP_FLASH_REGMAP the read-only maps of the regmap partition (nameplate
+ *   at holding registers 5000+, lookup tables at input registers 23000+) are served
+ *   straight from the memory mapped flash
+ * - With CONFIG_APP_METRICS_ENDPOINT /metrics serves the Modbus, UART, latency, TCP
+ *   client, bus analyzer, heap and task counters in the Prometheus text format
+ * - With CONFIG_FMB_SLAVE_BUS_ANALYZER the slave also analyzes the traffic of the other
+ *   slaves on the RTU bus: utilization, inter-frame gaps and per-slave response times in
+ *   the input registers 100+ and at /api/bus, optionally in listen-only mode
+ * - With CONFIG_FMB_FRAME_TRACE the received and sent RTU and TCP frames are
+ *   kept in a RAM ring and exported as a pcap file at /api/frames.pcap
+ * - With CONFIG_FMB_CONTROLLER_FILE_RECORD_SUPPORT the temperature history, metrics ring,
+ *   serial configuration and frame trace ring are read as files 1-4 with function code 20
+ * - Function code 8 (Diagnostics) and /api/stats report the serial line counters:
+ *   CRC errors, UART overruns, parity and framing errors, frames for other slaves
+ * - With CONFIG_APP_TASK_STATS the input registers 500+ and /api/tasks hold the CPU
+ *   load, stack high-water mark, core and priority of each task
+ * - With CONFIG_APP_HEAP_STATS the input registers 400-420 and /api/heap hold the free
+ *   bytes and largest free block per capability and the allocations per second
+ * - With CONFIG_APP_STATIC_ALLOCATION the Modbus and application RTOS objects are
+ *   placed in static buffers instead of the heap
+ * - With CONFIG_APP_RTU_BUS2 a second RS485 segment is served on another UART by
+ *   its own port task, in parallel with the main bus
+ * - With CONFIG_APP_ULP_SAMPLING the ULP coprocessor samples and filters the chip
+ *   temperature, the input registers 300-306 are read from its RTC memory
  */
 
 #include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_random.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_http_server.h"
@@ -35,17 +87,35 @@
 #include "driver/uart.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "freertos/timers.h"
 #include "esp_heap_caps.h"
+#include "esp_heap_trace.h"
+#include "esp_attr.h"
+#include "esp_memory_utils.h"
 #include "esp_chip_info.h"
 #include "driver/temperature_sensor.h"
 #include "esp_private/esp_clk.h"
+#include "esp_rom_crc.h"
+#if CONFIG_APP_LIGHT_SLEEP
+#include "esp_pm.h"
+#endif
+#if CONFIG_APP_WIFI_WAKE_GPIO >= 0
+#include "driver/gpio.h"
+#endif
+#include "persist.h"
+#include "gateway.h"
+#include "bench.h"
+#include "envsense.h"
+#include "regmap.h"
 
-#define MB_PORT_NUM     (1)         // UART port number for Modbus
-#define MB_SLAVE_ADDR   (1)         // Modbus slave address
-#define MB_DEV_SPEED    (9600)      // Modbus communication speed (9600 for RS485)
-#define MB_UART_TXD     (18)        // TX pin for HW-519 TXD
-#define MB_UART_RXD     (16)        // RX pin for HW-519 RXD
+#define MB_PORT_NUM     (CONFIG_MB_UART_PORT_NUM)   // UART port number for Modbus
+#define MB_SLAVE_ADDR   (1)                         // Modbus slave address
+#define MB_DEV_SPEED    (CONFIG_MB_UART_BAUD_RATE)  // Modbus communication speed (9600 for RS485)
+#define MB_UART_TXD     (CONFIG_MB_UART_TXD)        // TX pin for HW-519 TXD
+#define MB_UART_RXD     (CONFIG_MB_UART_RXD)        // RX pin for HW-519 RXD
+#define MB_UART_RTS     (CONFIG_MB_UART_RTS)        // RS485 DE/RE pin, -1 for auto direction transceiver
+#define MB_UART_STOP_BITS (CONFIG_MB_UART_STOP_BITS)  // Stop bits until set through /api/config
 
 // WiFi AP Configuration
 #define WIFI_AP_SSID        "ESP32-Modbus-Config"
@@ -57,57 +127,602 @@
 
 // Modbus register definitions
 #define MB_REG_HOLDING_START    (0)
-#define MB_REG_HOLDING_SIZE     (12)  // 12 holding registers
+#define MB_REG_INPUT_START      (0)   // Turnaround latency summary (CONFIG_FMB_SLAVE_LATENCY_STATS)
+#define MB_REG_RETAIN_START     (100) // Retained holding registers (setpoints), kept in NVS
+#define MB_REG_RETAIN_COUNT     (CONFIG_APP_RETAIN_REG_COUNT)
+#define MB_REG_HISTORY_START    (1000) // Temperature history (CONFIG_APP_HISTORY_REG_COUNT)
+#define MB_REG_HISTORY_COUNT    (CONFIG_APP_HISTORY_REG_COUNT)
+#define MB_REG_METRICS_START    (22000) // Metrics history ring (CONFIG_APP_METRICS_RECORDS)
+#define MB_REG_METRICS_RECORDS  (CONFIG_APP_METRICS_RECORDS)
+#define MB_REG_TASK_START       (500)  // Task CPU load and stack usage (CONFIG_APP_TASK_STATS)
+#define MB_REG_HEAP_START       (400)  // Heap fragmentation and allocation rates (CONFIG_APP_HEAP_STATS)
+#define MB_REG_BUS_START        (100)  // Bus analyzer summary and slave table (CONFIG_FMB_SLAVE_BUS_ANALYZER)
+#define MB_REG_ULP_START        (300)  // Filtered samples of the ULP coprocessor (CONFIG_APP_ULP_SAMPLING)
+#define MB_REG_BENCH_START      (3000) // Scratch holding registers of the loopback test (CONFIG_APP_BENCH_LOOPBACK)
+#define MB_COIL_BENCH_START     (0)    // Scratch coils of the loopback test
+#define MB_REG_WIFI_START       (260)  // WiFi lifecycle state and the reclaimed heap
+#define MB_COIL_WIFI            (1000) // WiFi AP enable: write 1 to start the AP, 0 to release it
+
+#define APP_NVS_NAMESPACE       "storage"
+
+#define MB_PAR_INFO_BATCH_SIZE  (8)  // Number of parameter info entries processed per wakeup
+
+#define APP_TRACE_RING_SIZE     (CONFIG_APP_TRACE_RING_SIZE)
+
+// Core assignment of the real-time core profile
+#ifdef CONFIG_APP_RT_CORE_PROFILE
+#define APP_MODBUS_CORE         (1)                 // Modbus UART ISR, port and controller tasks
+#define APP_NET_CORE            (0)                 // WiFi, httpd and the application tasks
+#else
+#define APP_MODBUS_CORE         (tskNO_AFFINITY)
+#define APP_NET_CORE            (tskNO_AFFINITY)
+#endif
+
+// The web server and its worker run on the core without the Modbus port task, the other tasks of
+// the network side float unless the real-time core profile pins them
+#if defined(CONFIG_APP_RT_CORE_PROFILE)
+#define APP_HTTPD_CORE          (APP_NET_CORE)
+#elif !CONFIG_FREERTOS_UNICORE && ((CONFIG_FMB_PORT_TASK_AFFINITY == 0) || (CONFIG_FMB_PORT_TASK_AFFINITY == 1))
+#define APP_HTTPD_CORE          (1 - CONFIG_FMB_PORT_TASK_AFFINITY)
+#else
+#define APP_HTTPD_CORE          (tskNO_AFFINITY)
+#endif
+#define APP_HTTPD_PRIO          (CONFIG_APP_HTTPD_TASK_PRIO)
+#define APP_HTTPD_STACK_SIZE    (CONFIG_APP_HTTPD_STACK_SIZE)
+
+// The HTTP tasks never preempt the Modbus controller task (FMB_PORT_TASK_PRIO - 1)
+_Static_assert(APP_HTTPD_PRIO < CONFIG_FMB_PORT_TASK_PRIO - 1, "HTTP tasks must run below the Modbus tasks");
 
-#define MB_PAR_INFO_GET_TOUT    (10) // Timeout for get parameter info
+// Create a pinned task without handle, with static buffers if CONFIG_APP_STATIC_ALLOCATION is set.
+// The buffers belong to the call site, so each site may only have one instance of the task at a time
+#ifdef CONFIG_APP_STATIC_ALLOCATION
+#define APP_TASK_CREATE(func, name, stack_size, arg, prio, core) ({ \
+        static StaticTask_t func##_tcb; \
+        static StackType_t func##_stack[(stack_size) / sizeof(StackType_t)]; \
+        (xTaskCreateStaticPinnedToCore(func, name, stack_size, arg, prio, func##_stack, &func##_tcb, core) \
+            != NULL) ? pdPASS : pdFAIL; \
+    })
+#else
+#define APP_TASK_CREATE(func, name, stack_size, arg, prio, core) \
+        xTaskCreatePinnedToCore(func, name, stack_size, arg, prio, NULL, core)
+#endif
 
 #define MB_READ_MASK            (MB_EVENT_HOLDING_REG_RD)
 #define MB_WRITE_MASK           (MB_EVENT_HOLDING_REG_WR)
-#define MB_READ_WRITE_MASK      (MB_READ_MASK | MB_WRITE_MASK)
 
 static const char *TAG = "MB_SLAVE";
 
 // Statistics
-static struct {
+typedef struct {
     uint32_t total_requests;
     uint32_t read_requests;
     uint32_t write_requests;
     uint32_t errors;
     uint32_t uptime_seconds;
-} modbus_stats = {0};
+} modbus_stats_t;
+
+// Request counters are kept per core and updated atomically, readers sum them up
+static struct {
+    uint32_t total_requests;
+    uint32_t read_requests;
+    uint32_t write_requests;
+    uint32_t errors;
+} __attribute__((aligned(16))) modbus_core_stats[portNUM_PROCESSORS] = {0};
+
+#define STATS_INC(field) \
+    __atomic_fetch_add(&modbus_core_stats[xPortGetCoreID()].field, 1, __ATOMIC_RELAXED)
+
+// Per-core load in percent over the last sampling period, 0xFF if not available
+static volatile uint8_t cpu_load_percent[portNUM_PROCESSORS];
+
+// Request trace ring, written only by the app task
+typedef struct {
+    uint32_t time_stamp;    // Controller time stamp (us, low 32 bits)
+    uint16_t mb_offset;     // Register offset
+    uint16_t size;          // Number of registers
+    uint8_t type;           // mb_event_group_t of the access
+} trace_record_t;
+
+static trace_record_t trace_ring[APP_TRACE_RING_SIZE];
+static volatile uint32_t trace_head = 0;
+
+// Per-request logging, disabled in production mode and switchable at runtime
+#ifdef CONFIG_APP_PRODUCTION_MODE
+static volatile bool verbose_log = false;
+#else
+static volatile bool verbose_log = true;
+#endif
 
 // Configuration stored in NVS
-static uint8_t configured_slave_addr = MB_SLAVE_ADDR;
+typedef struct {
+    uint32_t baudrate;
+    uint8_t slave_addr;
+    uint8_t parity;               // uart_parity_t
+    uint8_t stop_bits;            // 1 or 2, 0 in the records of the previous firmware means 1
+    uint8_t autobaud;             // auto-baud search enabled
+} app_config_t;
+
+static app_config_t app_config = {
+    .baudrate = MB_DEV_SPEED,
+    .slave_addr = MB_SLAVE_ADDR,
+    .parity = MB_PARITY_NONE,
+    .stop_bits = MB_UART_STOP_BITS,
+#if CONFIG_APP_AUTOBAUD
+    .autobaud = 1,
+#endif
+};
+static mb_seqlock_t app_config_lock = MB_SEQLOCK_INIT();
+static int app_config_record = PERSIST_RECORD_NONE;
+// Serializes the changes of the serial settings by the configuration API and auto-baud
+static StaticSemaphore_t app_config_mutex_buf;
+static SemaphoreHandle_t app_config_mutex = NULL;
 
 // WiFi state
 static httpd_handle_t server = NULL;
+static esp_netif_t *ap_netif = NULL;
+#if CONFIG_APP_RTU_BUS2
+static int rtu_bus2_port = -1;      // Index of the port of the second RTU bus, -1 if not started
+#endif
 static bool ap_active = false;
 static TimerHandle_t ap_timer = NULL;
 static uint8_t wifi_connected_clients = 0;
-static volatile bool ap_shutdown_requested = false;
+static esp_event_handler_instance_t wifi_event_instance = NULL;
+static TaskHandle_t wifi_ctl_task = NULL;       // Boot services task, runs the WiFi lifecycle after the boot
+static uint8_t wifi_coils[1] = { 0 };           // Coil 1000: WiFi AP enable, reads back the state
+
+// Input registers: WiFi lifecycle, updated by the lifecycle manager on each start and stop
+#pragma pack(push, 1)
+typedef struct {
+    uint16_t state;               // Register 260: 1 = AP and web server running, 0 = released
+    uint16_t starts;              // Register 261: AP starts since boot
+    uint16_t stops;               // Register 262: AP stops since boot
+    uint16_t reclaimed_low;       // Register 263: Heap returned by the last stop in bytes (low word)
+    uint16_t reclaimed_high;      // Register 264: Heap returned by the last stop in bytes (high word)
+    uint16_t cost_low;            // Register 265: Heap taken by the last start in bytes (low word)
+    uint16_t cost_high;           // Register 266: Heap taken by the last start in bytes (high word)
+} wifi_reg_params_t;
+#pragma pack(pop)
+
+static wifi_reg_params_t wifi_reg_params = { 0 };
+static mb_seqlock_t wifi_reg_lock = MB_SEQLOCK_INIT();
+
+// Holding register schema, one line per register in address order:
+// X(field, writable, deadband, description)
+// The deadband is the change reporting deadband (CONFIG_FMB_SLAVE_CHANGE_TRACKING),
+// 0 reports any change. The register struct, the boot log, /api/registers and the
+// register table of the web UI are generated from it.
+#define HOLDING_REG_SCHEMA(X) \
+    X(sequential_counter, true,  0,  "Sequential Counter") \
+    X(random_number,      false, 0,  "Random Number") \
+    X(uptime_seconds,     false, 59, "Uptime (seconds, low 16-bit)")     /* Once a minute */ \
+    X(free_heap_kb_low,   false, 3,  "Free Heap KB (low word)") \
+    X(free_heap_kb_high,  false, 0,  "Free Heap KB (high word)") \
+    X(min_heap_kb,        false, 3,  "Minimum Free Heap KB") \
+    X(cpu_freq_mhz,       false, 0,  "CPU Frequency (MHz)") \
+    X(task_count,         false, 0,  "Task Count") \
+    X(temperature_x10,    false, 4,  "Temperature (×10, e.g. 235=23.5°C)") /* 0.5 degree */ \
+    X(chip_cores,         false, 0,  "CPU Cores") \
+    X(wifi_enabled,       false, 0,  "WiFi AP Enabled (1=active, 0=disabled)") \
+    X(wifi_clients,       false, 0,  "WiFi Connected Clients")
+
+#define HOLDING_REG_X_FIELD(field, writable, deadband, descr)    uint16_t field;
+#define HOLDING_REG_X_INFO(field, writable, deadband, descr)     { descr, writable },
+#define HOLDING_REG_X_DEADBAND(field, writable, deadband, descr) deadband,
+#define HOLDING_REG_X_DESCR(field, writable, deadband, descr)    descr
 
 // Holding registers storage
 #pragma pack(push, 1)
 typedef struct {
-    uint16_t sequential_counter;  // Register 0: Sequential counter
-    uint16_t random_number;       // Register 1: Random number
-    uint16_t uptime_seconds;      // Register 2: Uptime in seconds (low word)
-    uint16_t free_heap_kb_low;    // Register 3: Free heap in KB (low word)
-    uint16_t free_heap_kb_high;   // Register 4: Free heap in KB (high word)
-    uint16_t min_heap_kb;         // Register 5: Minimum free heap since boot in KB
-    uint16_t cpu_freq_mhz;        // Register 6: CPU frequency in MHz
-    uint16_t task_count;          // Register 7: Number of FreeRTOS tasks
-    uint16_t temperature_x10;     // Register 8: Chip temperature × 10 (e.g., 235 = 23.5°C)
-    uint16_t chip_cores;          // Register 9: Number of CPU cores
-    uint16_t wifi_enabled;        // Register 10: WiFi AP enabled (1 = active, 0 = disabled)
-    uint16_t wifi_clients;        // Register 11: Number of connected WiFi clients
+    HOLDING_REG_SCHEMA(HOLDING_REG_X_FIELD)
 } holding_reg_params_t;
 #pragma pack(pop)
 
 holding_reg_params_t holding_reg_params = { 0 };
 
-// Temperature sensor handle
+// Sequence lock of the register image, shared with the Modbus stack (see mbc_slave_set_descriptor_lock)
+static mb_seqlock_t holding_reg_lock = MB_SEQLOCK_INIT();
+
+#define HOLDING_REG_COUNT   (sizeof(holding_reg_params_t) / sizeof(uint16_t))
+
+typedef struct {
+    const char *descr;
+    bool writable;
+} holding_reg_info_t;
+
+static const holding_reg_info_t holding_reg_info[HOLDING_REG_COUNT] = {
+    HOLDING_REG_SCHEMA(HOLDING_REG_X_INFO)
+};
+
+// Access rules built from the schema, the stack answers the writes of the read only
+// registers with an exception before the image is touched (see mbc_slave_set_descriptor_access)
+static mb_reg_access_t holding_reg_access[HOLDING_REG_COUNT];
+
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
+// Change reporting deadbands
+static const uint16_t holding_reg_deadband[HOLDING_REG_COUNT] = {
+    HOLDING_REG_SCHEMA(HOLDING_REG_X_DEADBAND)
+};
+
+// The changed registers are compared with the reported values when the changes are queried
+#define HOLDING_REG_MARK() \
+        (void)mbc_slave_mark_changed(MB_PARAM_HOLDING, MB_REG_HOLDING_START, HOLDING_REG_COUNT)
+#else
+#define HOLDING_REG_MARK()
+#endif
+
+#define HOLDING_REG_UPDATE(stmt) do { \
+        mb_seqlock_write_begin(&holding_reg_lock); \
+        stmt; \
+        mb_seqlock_write_end(&holding_reg_lock); \
+        HOLDING_REG_MARK(); \
+    } while (0)
+
+// Get a consistent copy of the register image
+static void holding_reg_snapshot(holding_reg_params_t *regs)
+{
+    uint32_t seq;
+    do {
+        seq = mb_seqlock_read_begin(&holding_reg_lock);
+        memcpy(regs, &holding_reg_params, sizeof(*regs));
+    } while (mb_seqlock_read_retry(&holding_reg_lock, seq));
+}
+
+// Get the sum of per-core request counters
+static void stats_snapshot(modbus_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < portNUM_PROCESSORS; i++) {
+        stats->total_requests += __atomic_load_n(&modbus_core_stats[i].total_requests, __ATOMIC_RELAXED);
+        stats->read_requests += __atomic_load_n(&modbus_core_stats[i].read_requests, __ATOMIC_RELAXED);
+        stats->write_requests += __atomic_load_n(&modbus_core_stats[i].write_requests, __ATOMIC_RELAXED);
+        stats->errors += __atomic_load_n(&modbus_core_stats[i].errors, __ATOMIC_RELAXED);
+    }
+    stats->uptime_seconds = (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+// Input registers: turnaround latency summary of all function codes
+#pragma pack(push, 1)
+typedef struct {
+    uint16_t count_low;           // Register 0: Number of responses (low word)
+    uint16_t count_high;          // Register 1: Number of responses (high word)
+    struct {
+        uint16_t p50_us;          // Median latency upper bound (us)
+        uint16_t p99_us;          // 99th percentile latency upper bound (us)
+        uint16_t max_us;          // Maximum latency (us)
+    } stage[MB_LATENCY_STAGE_COUNT]; // Registers 2-13: dispatch, handler, TX, total
+} input_reg_params_t;
+#pragma pack(pop)
+
+static input_reg_params_t input_reg_params = { 0 };
+static mb_seqlock_t input_reg_lock = MB_SEQLOCK_INIT();
+
+static const char *latency_stage_names[MB_LATENCY_STAGE_COUNT] = { "dispatch", "handler", "tx", "total" };
+#endif
+
+#if MB_REG_HISTORY_COUNT > 0
+// Input registers: chip temperature history, register 0 of the area holds the number of samples
+// and the sample n is kept in register 1 + (n % MB_REG_HISTORY_COUNT)
+static uint16_t *history_regs = NULL;
+static uint32_t history_samples = 0;
+static mb_seqlock_t history_reg_lock = MB_SEQLOCK_INIT();
+#endif
+
+#if MB_REG_METRICS_RECORDS > 0
+// Input registers: metrics history ring, a header followed by the records, the record n is
+// kept at METRICS_HEADER_REGS + (n % MB_REG_METRICS_RECORDS) * METRICS_RECORD_REGS
+#pragma pack(push, 1)
+typedef struct {
+    uint16_t head;                // Register 0: Number of records written modulo METRICS_HEAD_WRAP
+    uint16_t capacity;            // Register 1: Number of records in the ring
+    uint16_t record_regs;         // Register 2: Registers per record
+    uint16_t period_s;            // Register 3: Recording period (s)
+} metrics_header_t;
+
+typedef struct {
+    uint16_t uptime_low;          // Uptime at the recording (s)
+    uint16_t uptime_high;
+    uint16_t free_heap_kb;
+    uint16_t min_heap_kb;
+    uint16_t temperature_x10;
+    uint16_t requests_per_min;    // RTU and TCP requests
+    uint16_t errors_per_min;      // Exception responses and CRC errors
+    uint16_t cpu_load;            // Load of the busiest core (%)
+} metrics_record_t;
+#pragma pack(pop)
+
+#define METRICS_HEADER_REGS     (sizeof(metrics_header_t) / sizeof(uint16_t))
+#define METRICS_RECORD_REGS     (sizeof(metrics_record_t) / sizeof(uint16_t))
+#define METRICS_AREA_SIZE       (sizeof(metrics_header_t) + MB_REG_METRICS_RECORDS * sizeof(metrics_record_t))
+// The head wraps at a multiple of the capacity, so head % capacity stays the next record index
+#define METRICS_HEAD_WRAP       ((0x10000 / MB_REG_METRICS_RECORDS) * MB_REG_METRICS_RECORDS)
+
+static uint16_t *metrics_regs = NULL;
+static uint32_t metrics_records = 0;
+static mb_seqlock_t metrics_reg_lock = MB_SEQLOCK_INIT();
+#endif
+
+#if CONFIG_APP_TASK_STATS
+// Input registers: per-task CPU load and stack usage, sampled every second
+#define TASK_STATS_MAX          (CONFIG_APP_TASK_STATS_MAX)
+#define TASK_STATS_NAME_REGS    (4)
+#define TASK_CORE_NONE          (0xFFFF)
+
+#pragma pack(push, 1)
+typedef struct {
+    uint16_t count;               // Register 500: Number of tasks in the table, 0 if there are too many
+    uint16_t total;               // Register 501: Number of tasks in the system
+    struct {
+        uint16_t name[TASK_STATS_NAME_REGS]; // Task name, 8 characters, the first in the high byte
+        uint16_t cpu_permille;    // Run time in the last period, 0.1 % of one core
+        uint16_t stack_free;      // Stack high-water mark (bytes)
+        uint16_t core;            // Core affinity, 0xFFFF if not pinned
+        uint16_t priority;        // Current priority
+    } task[TASK_STATS_MAX];       // Registers 502+: 8 registers per task
+} task_reg_params_t;
+#pragma pack(pop)
+
+// The full entry for /api/tasks, written together with the registers
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint16_t cpu_permille;
+    uint16_t stack_free;
+    uint16_t core;
+    uint8_t priority;
+    uint8_t base_priority;
+    uint8_t state;                // eTaskState
+} task_stat_t;
+
+static task_reg_params_t task_reg_params = { 0 };
+static task_stat_t task_stats[TASK_STATS_MAX];
+static mb_seqlock_t task_reg_lock = MB_SEQLOCK_INIT();
+#endif
+
+#if CONFIG_APP_HEAP_STATS
+// Input registers: heap fragmentation per capability and allocator churn, sampled every second
+#define HEAP_CAPS_COUNT         (3)
+
+#pragma pack(push, 1)
+typedef struct {
+    struct {
+        uint16_t free_low;        // Free bytes (low word)
+        uint16_t free_high;       // Free bytes (high word)
+        uint16_t largest_low;     // Largest free block in bytes (low word)
+        uint16_t largest_high;    // Largest free block in bytes (high word)
+        uint16_t min_free_kb;     // Minimum free since boot (KB)
+        uint16_t frag_percent;    // 100 - largest free block * 100 / free bytes
+    } caps[HEAP_CAPS_COUNT];      // Registers 400-417: internal, DMA, SPIRAM
+    uint16_t allocs_per_s;        // Register 418: Allocations in the last second (CONFIG_HEAP_USE_HOOKS)
+    uint16_t frees_per_s;         // Register 419: Frees in the last second (CONFIG_HEAP_USE_HOOKS)
+    uint16_t failed;              // Register 420: Failed allocations since boot (low word)
+} heap_reg_params_t;
+#pragma pack(pop)
+
+static const uint32_t heap_caps[HEAP_CAPS_COUNT] = { MALLOC_CAP_INTERNAL, MALLOC_CAP_DMA, MALLOC_CAP_SPIRAM };
+static const char *heap_caps_names[HEAP_CAPS_COUNT] = { "internal", "dma", "spiram" };
+
+static heap_reg_params_t heap_reg_params = { 0 };
+static mb_seqlock_t heap_reg_lock = MB_SEQLOCK_INIT();
+
+// Allocator counters, updated from any task or ISR
+static uint32_t heap_alloc_count = 0;
+static uint32_t heap_free_count = 0;
+static uint32_t heap_failed_count = 0;
+#endif
+
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+// Input registers: traffic of the RTU bus seen by the bus analyzer, sampled every second
+#define BUS_REG_SLAVES          ((CONFIG_FMB_SLAVE_BUS_ANALYZER_SLAVES < 16) ? CONFIG_FMB_SLAVE_BUS_ANALYZER_SLAVES : 16)
+#define BUS_STATE_RUNNING       (0x0001)
+#define BUS_STATE_LISTEN_ONLY   (0x0002)
+#if CONFIG_APP_BUS_ANALYZER_LISTEN_ONLY
+#define BUS_LISTEN_ONLY         (true)
+#else
+#define BUS_LISTEN_ONLY         (false)
+#endif
+
+#pragma pack(push, 1)
+typedef struct {
+    uint16_t state;               // Register 100: BUS_STATE_* flags
+    uint16_t util_last;           // Register 101: Bus utilization in the last second, 0.01 %
+    uint16_t util_total;          // Register 102: Bus utilization since start, 0.01 %
+    uint16_t frames_per_s;        // Register 103: Frames in the last second
+    uint16_t bad_frames;          // Register 104: Frames with length or CRC error (low word)
+    uint16_t gap_min_us;          // Register 105: Minimum inter-frame gap (us, saturated)
+    uint16_t gap_avg_us;          // Register 106: Mean inter-frame gap (us, saturated)
+    uint16_t gap_max_us;          // Register 107: Maximum inter-frame gap (us, saturated)
+    uint16_t slaves;              // Register 108: Number of the tracked slaves
+    uint16_t unmatched;           // Register 109: Frames seen as response without a request (low word)
+    uint16_t untracked;           // Register 110: Requests for the slaves beyond the table (low word)
+    uint16_t reserved[5];         // Registers 111-115
+    struct {
+        uint16_t addr;            // Slave address
+        uint16_t resp_last;       // Last response time, 0.1 ms
+        uint16_t resp_avg;        // Mean response time, 0.1 ms
+        uint16_t resp_max;        // Maximum response time, 0.1 ms
+        uint16_t requests;        // Requests (low word)
+        uint16_t timeouts;        // Requests without response (low word)
+        uint16_t exceptions;      // Exception responses (low word)
+        uint16_t bad_responses;   // Damaged responses (low word)
+    } slave[BUS_REG_SLAVES];      // Registers 116+: 8 registers per slave
+} bus_reg_params_t;
+#pragma pack(pop)
+
+static bus_reg_params_t bus_reg_params = { 0 };
+static mb_seqlock_t bus_reg_lock = MB_SEQLOCK_INIT();
+#endif
+
+#if CONFIG_APP_HEAP_STATS
+#if CONFIG_HEAP_USE_HOOKS
+// Heap hooks, called for each allocation and free
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    (void)ptr;
+    (void)size;
+    (void)caps;
+    __atomic_fetch_add(&heap_alloc_count, 1, __ATOMIC_RELAXED);
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr)
+{
+    (void)ptr;
+    __atomic_fetch_add(&heap_free_count, 1, __ATOMIC_RELAXED);
+}
+#endif
+
+static void heap_alloc_failed(size_t size, uint32_t caps, const char *function_name)
+{
+    (void)size;
+    (void)caps;
+    (void)function_name;
+    __atomic_fetch_add(&heap_failed_count, 1, __ATOMIC_RELAXED);
+}
+
+#if CONFIG_APP_HEAP_TRACE
+// Opt-in heap trace window, started over /api/heap?trace=<ms> and stopped by a one-shot timer
+static heap_trace_record_t heap_trace_records[CONFIG_APP_HEAP_TRACE_RECORDS];
+static esp_timer_handle_t heap_trace_timer = NULL;
+static bool heap_trace_running = false;
+
+static void heap_trace_window_end(void *arg)
+{
+    (void)arg;
+    heap_trace_stop();
+    __atomic_store_n(&heap_trace_running, false, __ATOMIC_RELAXED);
+}
+
+static esp_err_t heap_trace_window_init(void)
+{
+    esp_err_t err = heap_trace_init_standalone(heap_trace_records, CONFIG_APP_HEAP_TRACE_RECORDS);
+    if (err != ESP_OK) {
+        return err;
+    }
+    const esp_timer_create_args_t timer_args = {
+        .callback = heap_trace_window_end,
+        .name = "heap_trace"
+    };
+    return esp_timer_create(&timer_args, &heap_trace_timer);
+}
+
+// Start a trace of all allocations and frees for the window, the previous records are dropped
+static esp_err_t heap_trace_window_start(uint32_t window_ms)
+{
+    if ((heap_trace_timer == NULL) || __atomic_load_n(&heap_trace_running, __ATOMIC_RELAXED)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = heap_trace_start(HEAP_TRACE_ALL);
+    if (err != ESP_OK) {
+        return err;
+    }
+    __atomic_store_n(&heap_trace_running, true, __ATOMIC_RELAXED);
+    err = esp_timer_start_once(heap_trace_timer, (uint64_t)window_ms * 1000);
+    if (err != ESP_OK) {
+        heap_trace_window_end(NULL);
+    }
+    return err;
+}
+#endif
+#endif
+
+#if MB_REG_RETAIN_COUNT > 0
+// Retained holding registers, written by the master and restored from NVS at boot
+static uint16_t retain_reg_params[MB_REG_RETAIN_COUNT] = { 0 };
+static mb_seqlock_t retain_reg_lock = MB_SEQLOCK_INIT();
+static int retain_reg_record = PERSIST_RECORD_NONE;
+#endif
+
+#if CONFIG_APP_BENCH_LOOPBACK
+// Scratch areas written and read back by the loopback test master
+static uint16_t bench_holding_regs[BENCH_REG_COUNT] = { 0 };
+static uint8_t bench_coils[BENCH_COIL_COUNT / 8] = { 0 };
+#endif
+
+// Temperature sensor handle, set by the boot services task once the sensor is enabled
 static temperature_sensor_handle_t temp_sensor = NULL;
+#if CONFIG_APP_ULP_SAMPLING
+static bool ulp_sampling = false;   // The ULP samples the sensor, the HP cores do not read it
+#endif
+
+// Boot phases, time since startup when each phase completed
+typedef enum {
+    BOOT_PHASE_NVS = 0,       // NVS initialized and configuration loaded
+    BOOT_PHASE_MODBUS,        // Modbus stack started and UART configured
+    BOOT_PHASE_FIRST_REQUEST, // First register access by the master
+    BOOT_PHASE_SENSORS,       // Temperature sensor initialized
+    BOOT_PHASE_WIFI,          // WiFi AP and web server started
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+static const char *boot_phase_names[BOOT_PHASE_COUNT] = { "nvs", "modbus", "first_request", "sensors", "wifi" };
+static int64_t boot_phase_us[BOOT_PHASE_COUNT] = { 0 };
+
+#define BOOT_PHASE_DONE(phase) __atomic_store_n(&boot_phase_us[phase], esp_timer_get_time(), __ATOMIC_RELAXED)
+#define BOOT_PHASE_MS(phase) ((long)(__atomic_load_n(&boot_phase_us[phase], __ATOMIC_RELAXED) / 1000))
+
+// Diagnostic registers computed on read by the Modbus stack
+#define HOLDING_REG_INDEX(field) ((uint16_t)(offsetof(holding_reg_params_t, field) / sizeof(uint16_t)))
+
+static void get_uptime_reg(uint16_t *values, uint16_t count, void *arg)
+{
+    values[0] = (uint16_t)((esp_timer_get_time() / 1000000) & 0xFFFF);
+}
+
+static void get_free_heap_regs(uint16_t *values, uint16_t count, void *arg)
+{
+    uint32_t free_heap_kb = esp_get_free_heap_size() / 1024;
+    values[0] = (uint16_t)(free_heap_kb & 0xFFFF);
+    values[1] = (uint16_t)((free_heap_kb >> 16) & 0xFFFF);
+}
+
+static void get_min_heap_reg(uint16_t *values, uint16_t count, void *arg)
+{
+    values[0] = (uint16_t)(esp_get_minimum_free_heap_size() / 1024);
+}
+
+static void get_cpu_freq_reg(uint16_t *values, uint16_t count, void *arg)
+{
+    values[0] = (uint16_t)(esp_clk_cpu_freq() / 1000000);
+}
+
+static void get_task_count_reg(uint16_t *values, uint16_t count, void *arg)
+{
+    values[0] = (uint16_t)uxTaskGetNumberOfTasks();
+}
+
+static void get_temperature_reg(uint16_t *values, uint16_t count, void *arg)
+{
+    float tsens_value = 0;
+    values[0] = holding_reg_params.temperature_x10;
+#if CONFIG_APP_ULP_SAMPLING
+    if (__atomic_load_n(&ulp_sampling, __ATOMIC_ACQUIRE)) {
+        values[0] = envsense_regs()[ENVSENSE_REG_TEMP];
+        return;
+    }
+#endif
+    temperature_sensor_handle_t handle = __atomic_load_n(&temp_sensor, __ATOMIC_ACQUIRE);
+    if ((handle != NULL) && (temperature_sensor_get_celsius(handle, &tsens_value) == ESP_OK)) {
+        values[0] = (uint16_t)(tsens_value * 10);
+    }
+}
+
+static mb_computed_reg_t computed_regs[] = {
+    { .reg_offset = HOLDING_REG_INDEX(uptime_seconds), .reg_count = 1, .getter = get_uptime_reg, .ttl_ms = 1000 },
+    { .reg_offset = HOLDING_REG_INDEX(free_heap_kb_low), .reg_count = 2, .getter = get_free_heap_regs, .ttl_ms = 1000 },
+    { .reg_offset = HOLDING_REG_INDEX(min_heap_kb), .reg_count = 1, .getter = get_min_heap_reg, .ttl_ms = 1000 },
+    { .reg_offset = HOLDING_REG_INDEX(cpu_freq_mhz), .reg_count = 1, .getter = get_cpu_freq_reg, .ttl_ms = 10000 },
+    { .reg_offset = HOLDING_REG_INDEX(task_count), .reg_count = 1, .getter = get_task_count_reg, .ttl_ms = 1000 },
+    { .reg_offset = HOLDING_REG_INDEX(temperature_x10), .reg_count = 1, .getter = get_temperature_reg, .ttl_ms = 2000 },
+};
+
+#define COMPUTED_REG_COUNT  (sizeof(computed_regs) / sizeof(computed_regs[0]))
+
+// Registers read by the Modbus stack directly from the application variables
+static const mb_reg_binding_t holding_reg_bindings[] = {
+    MB_REG_BIND(HOLDING_REG_INDEX(wifi_enabled), ap_active),
+    MB_REG_BIND(HOLDING_REG_INDEX(wifi_clients), wifi_connected_clients),
+};
+
+#define HOLDING_REG_BINDING_COUNT  (sizeof(holding_reg_bindings) / sizeof(holding_reg_bindings[0]))
 
 // Initialize register data
 static void setup_reg_data(void)
@@ -138,267 +753,2278 @@ static void setup_reg_data(void)
     holding_reg_params.wifi_enabled = 0;
     holding_reg_params.wifi_clients = 0;
 
-    // Initialize temperature sensor
+    // The temperature is set once the sensor is initialized by the boot services task
+    holding_reg_params.temperature_x10 = 0;
+
+    ESP_LOGI(TAG, "Holding registers initialized:");
+    const uint16_t *values = (const uint16_t *)&holding_reg_params;
+    for (int i = 0; i < HOLDING_REG_COUNT; i++) {
+        ESP_LOGI(TAG, "  Register %d (%s): %u", MB_REG_HOLDING_START + i, holding_reg_info[i].descr, values[i]);
+    }
+}
+
+// Initialize the temperature sensor, runs while the Modbus stack is already serving requests
+static void setup_temp_sensor(void)
+{
+    temperature_sensor_handle_t handle = NULL;
     temperature_sensor_config_t temp_sensor_config = TEMPERATURE_SENSOR_CONFIG_DEFAULT(-10, 80);
-    esp_err_t err = temperature_sensor_install(&temp_sensor_config, &temp_sensor);
+    esp_err_t err = temperature_sensor_install(&temp_sensor_config, &handle);
     if (err == ESP_OK) {
-        temperature_sensor_enable(temp_sensor);
+        temperature_sensor_enable(handle);
         float tsens_value = 0;
-        if (temperature_sensor_get_celsius(temp_sensor, &tsens_value) == ESP_OK) {
-            holding_reg_params.temperature_x10 = (uint16_t)(tsens_value * 10);
+        if (temperature_sensor_get_celsius(handle, &tsens_value) == ESP_OK) {
+            HOLDING_REG_UPDATE(holding_reg_params.temperature_x10 = (uint16_t)(tsens_value * 10));
+        }
+#if CONFIG_APP_ULP_SAMPLING
+        err = envsense_start(handle);
+        if (err == ESP_OK) {
+            __atomic_store_n(&ulp_sampling, true, __ATOMIC_RELEASE);
+            // Input registers written by the ULP program in RTC memory, described only when the
+            // program runs. The area has no lock, the registers are single words, and the
+            // response cache does not keep reads of it
+            mb_register_area_descriptor_t reg_area = {
+                .type = MB_PARAM_INPUT,
+                .start_offset = MB_REG_ULP_START,
+                .address = (void*)envsense_regs(),
+                .size = ENVSENSE_REG_COUNT * sizeof(uint16_t),
+            };
+            err = mbc_slave_set_descriptor(reg_area);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "ULP input registers not served: %s", esp_err_to_name(err));
+            }
+            ESP_LOGI(TAG, "Temperature sensor initialized, sampled by the ULP");
+            return;
         }
+        ESP_LOGW(TAG, "ULP sampling start failed, the sensor is read on request: %s", esp_err_to_name(err));
+#endif
+        __atomic_store_n(&temp_sensor, handle, __ATOMIC_RELEASE);
         ESP_LOGI(TAG, "Temperature sensor initialized");
     } else {
         ESP_LOGW(TAG, "Temperature sensor initialization failed: %s", esp_err_to_name(err));
-        holding_reg_params.temperature_x10 = 0;
     }
-
-    ESP_LOGI(TAG, "Holding registers initialized:");
-    ESP_LOGI(TAG, "  Register 0 (Sequential Counter): %u", holding_reg_params.sequential_counter);
-    ESP_LOGI(TAG, "  Register 1 (Random Number): %u", holding_reg_params.random_number);
-    ESP_LOGI(TAG, "  Register 2 (Uptime): %u seconds", holding_reg_params.uptime_seconds);
-    ESP_LOGI(TAG, "  Register 3-4 (Free Heap): %lu KB", (uint32_t)holding_reg_params.free_heap_kb_low | ((uint32_t)holding_reg_params.free_heap_kb_high << 16));
-    ESP_LOGI(TAG, "  Register 5 (Min Heap): %u KB", holding_reg_params.min_heap_kb);
-    ESP_LOGI(TAG, "  Register 6 (CPU Freq): %u MHz", holding_reg_params.cpu_freq_mhz);
-    ESP_LOGI(TAG, "  Register 7 (Tasks): %u", holding_reg_params.task_count);
-    ESP_LOGI(TAG, "  Register 8 (Temperature): %.1f°C", holding_reg_params.temperature_x10 / 10.0);
-    ESP_LOGI(TAG, "  Register 9 (CPU Cores): %u", holding_reg_params.chip_cores);
-    ESP_LOGI(TAG, "  Register 10 (WiFi Enabled): %u", holding_reg_params.wifi_enabled);
-    ESP_LOGI(TAG, "  Register 11 (WiFi Clients): %u", holding_reg_params.wifi_clients);
 }
 
 // Load configuration from NVS
 static void load_config(void)
 {
+    app_config_mutex = xSemaphoreCreateMutexStatic(&app_config_mutex_buf);
+    if (persist_register("app_config", &app_config, sizeof(app_config),
+                         &app_config_lock, &app_config_record) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded config from NVS: address %d, baudrate %lu, parity %d",
+                 app_config.slave_addr, app_config.baudrate, app_config.parity);
+        return;
+    }
+    // Configuration saved by the previous firmware in separate keys, moved to the record
     nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("storage", NVS_READONLY, &nvs_handle);
+    esp_err_t err = nvs_open(APP_NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if ((err == ESP_OK) && (nvs_get_u8(nvs_handle, "slave_addr", &app_config.slave_addr) == ESP_OK)) {
+        nvs_get_u32(nvs_handle, "baudrate", &app_config.baudrate);
+        nvs_get_u8(nvs_handle, "parity", &app_config.parity);
+        persist_mark_dirty(app_config_record, 0, sizeof(app_config));
+        ESP_LOGI(TAG, "Loaded legacy config from NVS: address %d, baudrate %lu, parity %d",
+                 app_config.slave_addr, app_config.baudrate, app_config.parity);
+    } else {
+        ESP_LOGI(TAG, "Using default slave address: %d", app_config.slave_addr);
+    }
     if (err == ESP_OK) {
-        uint8_t addr = MB_SLAVE_ADDR;
-        nvs_get_u8(nvs_handle, "slave_addr", &addr);
-        configured_slave_addr = addr;
         nvs_close(nvs_handle);
-        ESP_LOGI(TAG, "Loaded slave address from NVS: %d", configured_slave_addr);
-    } else {
-        configured_slave_addr = MB_SLAVE_ADDR;
-        ESP_LOGI(TAG, "Using default slave address: %d", configured_slave_addr);
     }
 }
 
-// Save configuration to NVS
-static esp_err_t save_config(uint8_t slave_addr)
+static const char *parity_name(uart_parity_t parity)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) return err;
-    
-    err = nvs_set_u8(nvs_handle, "slave_addr", slave_addr);
+    return (parity == UART_PARITY_EVEN) ? "even" : (parity == UART_PARITY_ODD) ? "odd" : "none";
+}
+
+typedef enum {
+    AUTOBAUD_OFF = 0,           // Disabled or not started
+    AUTOBAUD_SEARCH,            // Trying the candidate settings
+    AUTOBAUD_LOCKED,            // Valid frames are received with the current settings
+} autobaud_state_t;
+
+static volatile autobaud_state_t autobaud_state = AUTOBAUD_OFF;
+
+static const char *autobaud_name(void)
+{
+    return (autobaud_state == AUTOBAUD_LOCKED) ? "locked" : (autobaud_state == AUTOBAUD_SEARCH) ? "search" : "off";
+}
+
+static uart_stop_bits_t config_stop_bits(const app_config_t *cfg)
+{
+    return (cfg->stop_bits == 2) ? UART_STOP_BITS_2 : UART_STOP_BITS_1;
+}
+
+static app_config_t config_current(void)
+{
+    app_config_t cfg;
+    uint32_t seq;
+    do {
+        seq = mb_seqlock_read_begin(&app_config_lock);
+        cfg = app_config;
+    } while (mb_seqlock_read_retry(&app_config_lock, seq));
+    return cfg;
+}
+
+// Apply the configuration to the running Modbus stack between requests and keep it in RAM,
+// with persist set it is also committed to NVS by the persistence task.
+// Returns the error of the stack setup, *saved tells if the commit is queued.
+static esp_err_t apply_config(const app_config_t *cfg, bool persist, bool *saved)
+{
+    mb_communication_info_t comm_info = { 0 };
+    comm_info.port = MB_PORT_NUM;
+    comm_info.mode = MB_MODE_RTU;
+    comm_info.baudrate = cfg->baudrate;
+    comm_info.parity = cfg->parity;
+    comm_info.slave_addr = cfg->slave_addr;
+
+    xSemaphoreTake(app_config_mutex, portMAX_DELAY);
+    esp_err_t err = mbc_slave_setup(&comm_info);
     if (err == ESP_OK) {
-        err = nvs_commit(nvs_handle);
-        if (err == ESP_OK) {
-            configured_slave_addr = slave_addr;
-            ESP_LOGI(TAG, "Saved slave address to NVS: %d", slave_addr);
+        err = uart_set_stop_bits(MB_PORT_NUM, config_stop_bits(cfg));
+    }
+    if (err == ESP_OK) {
+        mb_seqlock_write_begin(&app_config_lock);
+        app_config = *cfg;
+        mb_seqlock_write_end(&app_config_lock);
+        persist = persist && (app_config_record != PERSIST_RECORD_NONE);
+        if (persist) {
+            persist_mark_dirty(app_config_record, 0, sizeof(app_config));
+            persist_flush();
+            ESP_LOGI(TAG, "Saved config: address %d, baudrate %lu, parity %s, stop bits %d, auto-baud %s",
+                     cfg->slave_addr, cfg->baudrate, parity_name(cfg->parity), (cfg->stop_bits == 2) ? 2 : 1,
+                     cfg->autobaud ? "on" : "off");
+        }
+        if (saved != NULL) {
+            *saved = persist;
         }
     }
-    nvs_close(nvs_handle);
+    xSemaphoreGive(app_config_mutex);
     return err;
 }
 
+// Web UI, gzip-compressed at build time from www/index.html
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_index_html_gz_end");
+
 // HTTP handler for root page
 static esp_err_t root_handler(httpd_req_t *req)
 {
-    // Send HTML in chunks to avoid stack overflow
+    // Strong ETag from the compressed page, changes with every page update
+    static char etag[12];
+    size_t len = index_html_gz_end - index_html_gz_start;
+    if (!etag[0]) {
+        snprintf(etag, sizeof(etag), "\"%08" PRIx32 "\"",
+                 esp_rom_crc32_le(0, index_html_gz_start, len));
+    }
+
+    // The browser revalidates on every load, an unchanged page costs a 304 only
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    char match[64];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", match, sizeof(match)) == ESP_OK &&
+        strstr(match, etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
     httpd_resp_set_type(req, "text/html");
-    
-    httpd_resp_sendstr_chunk(req, "<!DOCTYPE html><html><head>");
-    httpd_resp_sendstr_chunk(req, "<meta name='viewport' content='width=device-width,initial-scale=1'>");
-    httpd_resp_sendstr_chunk(req, "<title>Modbus Config</title><style>");
-    httpd_resp_sendstr_chunk(req, "body{font-family:Arial;margin:20px;background:#f0f0f0}");
-    httpd_resp_sendstr_chunk(req, ".container{max-width:600px;margin:auto;background:white;padding:20px;border-radius:8px;box-shadow:0 2px 4px rgba(0,0,0,0.1)}");
-    httpd_resp_sendstr_chunk(req, "h1{color:#333;border-bottom:2px solid #4CAF50;padding-bottom:10px}");
-    httpd_resp_sendstr_chunk(req, ".stat{display:flex;justify-content:space-between;padding:10px;margin:5px 0;background:#f9f9f9;border-radius:4px}");
-    httpd_resp_sendstr_chunk(req, ".label{font-weight:bold;color:#555}");
-    httpd_resp_sendstr_chunk(req, ".value{color:#4CAF50;font-weight:bold}");
-    httpd_resp_sendstr_chunk(req, "input[type=number]{width:100%;padding:8px;margin:8px 0;border:1px solid #ddd;border-radius:4px}");
-    httpd_resp_sendstr_chunk(req, "button{background:#4CAF50;color:white;padding:10px 20px;border:none;border-radius:4px;cursor:pointer;width:100%;font-size:16px}");
-    httpd_resp_sendstr_chunk(req, "button:hover{background:#45a049}");
-    httpd_resp_sendstr_chunk(req, ".info{background:#e7f3fe;border-left:4px solid #2196F3;padding:10px;margin:10px 0}");
-    httpd_resp_sendstr_chunk(req, ".tabs{display:flex;border-bottom:2px solid #4CAF50;margin:20px 0}");
-    httpd_resp_sendstr_chunk(req, ".tab{padding:10px 20px;cursor:pointer;background:#f0f0f0;border:none;margin-right:2px}");
-    httpd_resp_sendstr_chunk(req, ".tab.active{background:#4CAF50;color:white}");
-    httpd_resp_sendstr_chunk(req, ".tab-content{display:none}");
-    httpd_resp_sendstr_chunk(req, ".tab-content.active{display:block}");
-    httpd_resp_sendstr_chunk(req, ".reg-table{width:100%;border-collapse:collapse;margin:10px 0}");
-    httpd_resp_sendstr_chunk(req, ".reg-table th,.reg-table td{padding:8px;border:1px solid #ddd;text-align:left}");
-    httpd_resp_sendstr_chunk(req, ".reg-table th{background:#4CAF50;color:white}");
-    httpd_resp_sendstr_chunk(req, ".auto-update{margin:15px 0;padding:10px;background:#f9f9f9;border-radius:4px}");
-    httpd_resp_sendstr_chunk(req, ".auto-update label{display:flex;align-items:center;cursor:pointer}");
-    httpd_resp_sendstr_chunk(req, ".auto-update input[type=checkbox]{margin-right:10px;width:auto;cursor:pointer}");
-    httpd_resp_sendstr_chunk(req, "</style></head><body><div class='container'>");
-    httpd_resp_sendstr_chunk(req, "<h1>ESP32 Modbus RTU Slave</h1>");
-    httpd_resp_sendstr_chunk(req, "<div class='info'>WiFi AP will turn off in 20 minutes after boot</div>");
-    httpd_resp_sendstr_chunk(req, "<div class='auto-update'>");
-    httpd_resp_sendstr_chunk(req, "<label><input type='checkbox' id='autoUpdate' checked> Auto-update every 2 seconds</label>");
-    httpd_resp_sendstr_chunk(req, "</div>");
-    httpd_resp_sendstr_chunk(req, "<div class='tabs'>");
-    httpd_resp_sendstr_chunk(req, "<button class='tab active' onclick='showTab(0)'>Statistics</button>");
-    httpd_resp_sendstr_chunk(req, "<button class='tab' onclick='showTab(1)'>Registers</button>");
-    httpd_resp_sendstr_chunk(req, "<button class='tab' onclick='showTab(2)'>Configuration</button>");
-    httpd_resp_sendstr_chunk(req, "</div>");
-    httpd_resp_sendstr_chunk(req, "<div class='tab-content active' id='tab0'>");
-    httpd_resp_sendstr_chunk(req, "<h2>Statistics</h2>");
-    httpd_resp_sendstr_chunk(req, "<div class='stat'><span class='label'>Total Requests:</span><span class='value' id='total'>-</span></div>");
-    httpd_resp_sendstr_chunk(req, "<div class='stat'><span class='label'>Read Requests:</span><span class='value' id='reads'>-</span></div>");
-    httpd_resp_sendstr_chunk(req, "<div class='stat'><span class='label'>Write Requests:</span><span class='value' id='writes'>-</span></div>");
-    httpd_resp_sendstr_chunk(req, "<div class='stat'><span class='label'>Errors:</span><span class='value' id='errors'>-</span></div>");
-    httpd_resp_sendstr_chunk(req, "<div class='stat'><span class='label'>Uptime:</span><span class='value' id='uptime'>-</span></div>");
-    httpd_resp_sendstr_chunk(req, "<div class='stat'><span class='label'>Current Slave ID:</span><span class='value' id='current_id'>-</span></div>");
-    httpd_resp_sendstr_chunk(req, "</div>");
-    httpd_resp_sendstr_chunk(req, "<div class='tab-content' id='tab1'>");
-    httpd_resp_sendstr_chunk(req, "<h2>Holding Registers (0-11)</h2>");
-    httpd_resp_sendstr_chunk(req, "<table class='reg-table'>");
-    httpd_resp_sendstr_chunk(req, "<tr><th>Address</th><th>Value (Decimal)</th><th>Value (Hex)</th><th>Description</th></tr>");
-    httpd_resp_sendstr_chunk(req, "<tr><td>0</td><td id='reg0'>-</td><td id='reg0h'>-</td><td>Sequential Counter</td></tr>");
-    httpd_resp_sendstr_chunk(req, "<tr><td>1</td><td id='reg1'>-</td><td id='reg1h'>-</td><td>Random Number</td></tr>");
-    httpd_resp_sendstr_chunk(req, "<tr><td>2</td><td id='reg2'>-</td><td id='reg2h'>-</td><td>Uptime (seconds, low 16-bit)</td></tr>");
-    httpd_resp_sendstr_chunk(req, "<tr><td>3</td><td id='reg3'>-</td><td id='reg3h'>-</td><td>Free Heap KB (low word)</td></tr>");
-    httpd_resp_sendstr_chunk(req, "<tr><td>4</td><td id='reg4'>-</td><td id='reg4h'>-</td><td>Free Heap KB (high word)</td></tr>");
-    httpd_resp_sendstr_chunk(req, "<tr><td>5</td><td id='reg5'>-</td><td id='reg5h'>-</td><td>Minimum Free Heap KB</td></tr>");
-    httpd_resp_sendstr_chunk(req, "<tr><td>6</td><td id='reg6'>-</td><td id='reg6h'>-</td><td>CPU Frequency (MHz)</td></tr>");
-    httpd_resp_sendstr_chunk(req, "<tr><td>7</td><td id='reg7'>-</td><td id='reg7h'>-</td><td>Task Count</td></tr>");
-    httpd_resp_sendstr_chunk(req, "<tr><td>8</td><td id='reg8'>-</td><td id='reg8h'>-</td><td>Temperature (×10, e.g. 235=23.5°C)</td></tr>");
-    httpd_resp_sendstr_chunk(req, "<tr><td>9</td><td id='reg9'>-</td><td id='reg9h'>-</td><td>CPU Cores</td></tr>");
-    httpd_resp_sendstr_chunk(req, "<tr><td>10</td><td id='reg10'>-</td><td id='reg10h'>-</td><td>WiFi AP Enabled (1=active, 0=disabled)</td></tr>");
-    httpd_resp_sendstr_chunk(req, "<tr><td>11</td><td id='reg11'>-</td><td id='reg11h'>-</td><td>WiFi Connected Clients</td></tr>");
-    httpd_resp_sendstr_chunk(req, "</table></div>");
-    httpd_resp_sendstr_chunk(req, "<div class='tab-content' id='tab2'>");
-    httpd_resp_sendstr_chunk(req, "<h2>Configuration</h2><form id='configForm'>");
-    httpd_resp_sendstr_chunk(req, "<label>Modbus Slave ID (1-247):</label>");
-    httpd_resp_sendstr_chunk(req, "<input type='number' id='slave_id' name='slave_id' min='1' max='247' required>");
-    httpd_resp_sendstr_chunk(req, "<button type='submit'>Save & Apply</button></form></div>");
-    httpd_resp_sendstr_chunk(req, "<script>");
-    httpd_resp_sendstr_chunk(req, "function showTab(n){");
-    httpd_resp_sendstr_chunk(req, "document.querySelectorAll('.tab').forEach((t,i)=>t.classList.toggle('active',i===n));");
-    httpd_resp_sendstr_chunk(req, "document.querySelectorAll('.tab-content').forEach((t,i)=>t.classList.toggle('active',i===n));");
-    httpd_resp_sendstr_chunk(req, "}");
-    httpd_resp_sendstr_chunk(req, "function updateStats(){");
-    httpd_resp_sendstr_chunk(req, "fetch('/api/stats').then(r=>r.json()).then(d=>{");
-    httpd_resp_sendstr_chunk(req, "document.getElementById('total').textContent=d.total;");
-    httpd_resp_sendstr_chunk(req, "document.getElementById('reads').textContent=d.reads;");
-    httpd_resp_sendstr_chunk(req, "document.getElementById('writes').textContent=d.writes;");
-    httpd_resp_sendstr_chunk(req, "document.getElementById('errors').textContent=d.errors;");
-    httpd_resp_sendstr_chunk(req, "document.getElementById('uptime').textContent=d.uptime+'s';");
-    httpd_resp_sendstr_chunk(req, "document.getElementById('current_id').textContent=d.slave_id;");
-    httpd_resp_sendstr_chunk(req, "document.getElementById('slave_id').value=d.slave_id;");
-    httpd_resp_sendstr_chunk(req, "});}");
-    httpd_resp_sendstr_chunk(req, "function updateRegisters(){");
-    httpd_resp_sendstr_chunk(req, "fetch('/api/registers').then(r=>r.json()).then(d=>{");
-    httpd_resp_sendstr_chunk(req, "d.registers.forEach((v,i)=>{");
-    httpd_resp_sendstr_chunk(req, "document.getElementById('reg'+i).textContent=v;");
-    httpd_resp_sendstr_chunk(req, "document.getElementById('reg'+i+'h').textContent='0x'+v.toString(16).toUpperCase().padStart(4,'0');");
-    httpd_resp_sendstr_chunk(req, "});});}");
-    httpd_resp_sendstr_chunk(req, "updateStats();updateRegisters();");
-    httpd_resp_sendstr_chunk(req, "let updateInterval=setInterval(()=>{if(document.getElementById('autoUpdate').checked){updateStats();updateRegisters();}},2000);");
-    httpd_resp_sendstr_chunk(req, "document.getElementById('configForm').addEventListener('submit',function(e){");
-    httpd_resp_sendstr_chunk(req, "e.preventDefault();");
-    httpd_resp_sendstr_chunk(req, "const id=document.getElementById('slave_id').value;");
-    httpd_resp_sendstr_chunk(req, "fetch('/api/config?slave_id='+id,{method:'POST'})");
-    httpd_resp_sendstr_chunk(req, ".then(r=>r.json())");
-    httpd_resp_sendstr_chunk(req, ".then(d=>{alert(d.message);if(d.success)updateStats();});");;
-    httpd_resp_sendstr_chunk(req, "});");
-    httpd_resp_sendstr_chunk(req, "</script></div></body></html>");
-    
-    httpd_resp_sendstr_chunk(req, NULL);  // End chunked response
-    return ESP_OK;
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)index_html_gz_start, len);
+}
+
+// Chunked writer of the JSON responses: each piece is formatted into the buffer, which is
+// sent as a chunk when the next piece does not fit. A piece larger than the buffer is dropped.
+typedef struct {
+    httpd_req_t *req;
+    char *buf;
+    size_t size;
+    size_t len;
+    esp_err_t err;
+} json_stream_t;
+
+static void json_stream_flush(json_stream_t *js)
+{
+    if ((js->err == ESP_OK) && (js->len > 0)) {
+        js->err = httpd_resp_send_chunk(js->req, js->buf, js->len);
+    }
+    js->len = 0;
+}
+
+static void __attribute__((format(printf, 2, 3))) json_stream_printf(json_stream_t *js, const char *fmt, ...)
+{
+    if (js->err != ESP_OK) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(js->buf + js->len, js->size - js->len, fmt, args);
+    va_end(args);
+    if ((n >= 0) && ((size_t)n >= js->size - js->len) && (js->len > 0)) {
+        json_stream_flush(js);
+        va_start(args, fmt);
+        n = vsnprintf(js->buf, js->size, fmt, args);
+        va_end(args);
+    }
+    if ((n < 0) || ((size_t)n >= js->size - js->len)) {
+        ESP_LOGE(TAG, "JSON piece of %d bytes dropped", n);
+        js->err = ESP_ERR_INVALID_SIZE;
+        return;
+    }
+    js->len += n;
+}
+
+// Send the rest of the response and terminate it
+static esp_err_t json_stream_end(json_stream_t *js)
+{
+    json_stream_flush(js);
+    if (js->err == ESP_OK) {
+        js->err = httpd_resp_send_chunk(js->req, NULL, 0);
+    }
+    return js->err;
 }
 
 // HTTP handler for statistics API
 static esp_err_t stats_handler(httpd_req_t *req)
 {
-    char json[256];
-    snprintf(json, sizeof(json),
-        "{\"total\":%lu,\"reads\":%lu,\"writes\":%lu,\"errors\":%lu,\"uptime\":%lu,\"slave_id\":%d}",
-        modbus_stats.total_requests,
-        modbus_stats.read_requests,
-        modbus_stats.write_requests,
-        modbus_stats.errors,
-        modbus_stats.uptime_seconds,
-        configured_slave_addr);
-    
+    static char json[1024];     // Used only in the httpd task
+    json_stream_t js = { .req = req, .buf = json, .size = sizeof(json) };
+    modbus_stats_t stats;
+    uint32_t func_hits[MB_FUNC_CODE_COUNT];
+    stats_snapshot(&stats);
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+    json_stream_printf(&js,
+        "{\"total\":%lu,\"reads\":%lu,\"writes\":%lu,\"errors\":%lu,\"uptime\":%lu,\"slave_id\":%d,"
+        "\"baud\":%lu,\"parity\":\"%s\",\"stop_bits\":%d,\"autobaud\":\"%s\",\"cpu_load\":[",
+        stats.total_requests,
+        stats.read_requests,
+        stats.write_requests,
+        stats.errors,
+        stats.uptime_seconds,
+        app_config.slave_addr,
+        app_config.baudrate,
+        parity_name(app_config.parity),
+        (app_config.stop_bits == 2) ? 2 : 1,
+        autobaud_name());
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        json_stream_printf(&js, "%s%d", core ? "," : "",
+                           (cpu_load_percent[core] == 0xFF) ? -1 : cpu_load_percent[core]);
+    }
+    json_stream_printf(&js, "],\"boot_ms\":{");
+    for (int phase = 0; phase < BOOT_PHASE_COUNT; phase++) {
+        json_stream_printf(&js, "%s\"%s\":%ld", phase ? "," : "",
+                           boot_phase_names[phase], BOOT_PHASE_MS(phase));
+    }
+    persist_stats_t nvs_writes;
+    persist_get_stats(&nvs_writes);
+    json_stream_printf(&js,
+        "},\"nvs\":{\"marks\":%lu,\"commits\":%lu,\"blobs\":%lu,\"bytes\":%lu,"
+        "\"skipped\":%lu,\"failures\":%lu,\"pending\":%lu}",
+        nvs_writes.marks, nvs_writes.commits, nvs_writes.blob_writes, nvs_writes.bytes,
+        nvs_writes.skipped, nvs_writes.failures, nvs_writes.pending);
+    mb_slave_addr_stats_t rtu_stats = { 0 };
+    mbc_slave_get_addr_stats(0, &rtu_stats);
+    mb_slave_diag_counters_t diag = { 0 };
+    mbc_slave_get_diag_counters(&diag);
+    json_stream_printf(&js,
+        ",\"rtu\":{\"requests\":%lu,\"exceptions\":%lu,\"bus_messages\":%lu,\"crc_errors\":%lu,"
+        "\"exceptions_sent\":%lu,\"server_messages\":%lu,\"no_response\":%lu,\"not_addressed\":%lu,"
+        "\"broadcasts\":%lu,\"fifo_overflows\":%lu,\"buffer_full\":%lu,\"parity_errors\":%lu,"
+        "\"frame_errors\":%lu,\"filtered\":%lu,\"cached\":%lu}",
+        rtu_stats.requests, rtu_stats.exceptions, diag.bus_messages, diag.bus_comm_errors,
+        diag.exceptions, diag.server_messages, diag.no_response, diag.not_addressed,
+        diag.broadcasts, diag.fifo_overflows, diag.buffer_full, diag.parity_errors,
+        diag.frame_errors, diag.filtered, diag.cached);
+    mb_slave_tcp_stats_t tcp_stats;
+    if (mbc_slave_get_tcp_stats(&tcp_stats) == ESP_OK) {
+        json_stream_printf(&js,
+            ",\"tcp\":{\"requests\":%lu,\"exceptions\":%lu,\"errors\":%lu,\"connects\":%lu,\"clients\":%u,"
+            "\"forwarded\":%lu,\"evictions\":%lu,\"throttled\":%lu,\"worker_reads\":%lu,\"sessions\":[",
+            tcp_stats.requests, tcp_stats.exceptions, tcp_stats.errors, tcp_stats.connects,
+            (unsigned)tcp_stats.clients, tcp_stats.forwarded, tcp_stats.evictions, tcp_stats.throttled,
+            tcp_stats.worker_reads);
+        // Idle and last request timers of the connected clients, -1 if no request yet
+        static mb_slave_tcp_client_t tcp_clients[CONFIG_FMB_TCP_PORT_MAX_CONN];
+        size_t client_count = 0;
+        mbc_slave_get_tcp_clients(tcp_clients, CONFIG_FMB_TCP_PORT_MAX_CONN, &client_count);
+        for (size_t i = 0; i < client_count; i++) {
+            json_stream_printf(&js,
+                "%s{\"ip\":\"%s\",\"connected_ms\":%lu,\"idle_ms\":%lu,\"last_request_ms\":%ld,\"requests\":%lu,"
+                "\"throttled\":%lu}",
+                i ? "," : "", tcp_clients[i].ip_addr, tcp_clients[i].connected_ms, tcp_clients[i].idle_ms,
+                (tcp_clients[i].last_request_ms == UINT32_MAX) ? -1L : (long)tcp_clients[i].last_request_ms,
+                tcp_clients[i].requests, tcp_clients[i].throttled);
+        }
+        json_stream_printf(&js, "]}");
+    }
+#if CONFIG_APP_RTU_BUS2
+    mb_slave_rtu_stats_t rtu2_stats;
+    if ((rtu_bus2_port >= 0) && (mbc_slave_get_rtu_stats(rtu_bus2_port, &rtu2_stats) == ESP_OK)) {
+        json_stream_printf(&js,
+            ",\"rtu2\":{\"requests\":%lu,\"exceptions\":%lu,\"crc_errors\":%lu,\"not_addressed\":%lu,"
+            "\"uart_errors\":%lu}",
+            rtu2_stats.requests, rtu2_stats.exceptions, rtu2_stats.crc_errors, rtu2_stats.not_addressed,
+            rtu2_stats.uart_errors);
+    }
+#endif
+#if CONFIG_APP_MODBUS_GATEWAY
+    gateway_stats_t gw_stats;
+    gateway_get_stats(&gw_stats);
+    json_stream_printf(&js,
+        ",\"gateway\":{\"requests\":%lu,\"cache_hits\":%lu,\"joined\":%lu,\"bus_requests\":%lu,"
+        "\"exceptions\":%lu,\"cached\":%lu}",
+        gw_stats.requests, gw_stats.cache_hits, gw_stats.joined, gw_stats.bus_requests,
+        gw_stats.exceptions, gw_stats.cached);
+#endif
+#if CONFIG_FMB_SLAVE_AREA_CACHE && (MB_REG_HISTORY_COUNT > 0)
+    // The hottest history blocks show which part of the ring the masters poll
+    mb_area_cache_stats_t area_stats;
+    size_t heat_max = (MB_REG_HISTORY_COUNT + 1 + 7) / 8; // Blocks of the smallest block size
+    uint32_t *heat = calloc(heat_max, sizeof(uint32_t));
+    if ((heat != NULL) && (mbc_slave_get_area_stats(MB_PARAM_INPUT, MB_REG_HISTORY_START, &area_stats,
+                                                    heat, heat_max) == ESP_OK)) {
+        json_stream_printf(&js,
+            ",\"history\":{\"psram\":%s,\"blocks\":%u,\"cached\":%u,\"hits\":%lu,\"misses\":%lu,"
+            "\"evictions\":%lu,\"hot\":[",
+            area_stats.psram ? "true" : "false", area_stats.blocks, area_stats.cached,
+            area_stats.hits, area_stats.misses, area_stats.evictions);
+        for (int i = 0; i < 4; i++) {
+            int hottest = 0;
+            for (int block = 1; block < area_stats.blocks; block++) {
+                if (heat[block] > heat[hottest]) {
+                    hottest = block;
+                }
+            }
+            if (heat[hottest] == 0) {
+                break;
+            }
+            json_stream_printf(&js, "%s[%u,%lu]", i ? "," : "",
+                               MB_REG_HISTORY_START + hottest * area_stats.block_regs, heat[hottest]);
+            heat[hottest] = 0;
+        }
+        json_stream_printf(&js, "]}");
+    }
+    free(heat);
+#endif
+#if CONFIG_FMB_SERIAL_PM_LOCK
+    // The awake share shows the saving, the wakeup latency has to stay below the master timeout
+    mb_serial_pm_stats_t pm_stats;
+    if (mbc_slave_get_pm_stats(&pm_stats) == ESP_OK) {
+        json_stream_printf(&js,
+            ",\"power\":{\"awake\":%s,\"awake_permille\":%lu,\"wakeups\":%lu,\"responses\":%lu,"
+            "\"wake_to_tx_us\":{\"last\":%lu,\"avg\":%lu,\"max\":%lu}}",
+            pm_stats.lock_held ? "true" : "false",
+            pm_stats.uptime_us ? (unsigned long)((pm_stats.awake_us * 1000) / pm_stats.uptime_us) : 0UL,
+            pm_stats.wakeups, pm_stats.responses, pm_stats.wake_to_tx_last_us,
+            pm_stats.responses ? (unsigned long)(pm_stats.wake_to_tx_total_us / pm_stats.responses) : 0UL,
+            pm_stats.wake_to_tx_max_us);
+    }
+#endif
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+    // Timing of the register 0 hooks in the Modbus task
+    mb_area_hook_stats_t hook_stats[2];
+    if (mbc_slave_get_hook_stats(MB_PARAM_HOLDING, MB_REG_HOLDING_START, &hook_stats[0], &hook_stats[1]) == ESP_OK) {
+        json_stream_printf(&js, ",\"hooks\":{");
+        for (int i = 0; i < 2; i++) {
+            json_stream_printf(&js,
+                "%s\"%s\":{\"calls\":%lu,\"avg_us\":%lu,\"max_us\":%lu,\"overruns\":%lu,\"suspended\":%s}",
+                i ? "," : "", i ? "post_write" : "pre_read", hook_stats[i].calls,
+                hook_stats[i].calls ? (unsigned long)(hook_stats[i].total_us / hook_stats[i].calls) : 0UL,
+                hook_stats[i].max_us, hook_stats[i].overruns, hook_stats[i].suspended ? "true" : "false");
+        }
+        json_stream_printf(&js, "}");
+    }
+#endif
+    json_stream_printf(&js, ",\"functions\":{");
+    // Request counters of the function codes which were received
+    if (mbc_slave_get_func_hits(func_hits, MB_FUNC_CODE_COUNT) == ESP_OK) {
+        bool first = true;
+        for (int fc = 0; fc < MB_FUNC_CODE_COUNT; fc++) {
+            if (func_hits[fc] != 0) {
+                json_stream_printf(&js, "%s\"%d\":%lu",
+                                   first ? "" : ",", fc, func_hits[fc]);
+                first = false;
+            }
+        }
+    }
+    json_stream_printf(&js, "}}");
+    return json_stream_end(&js);
+}
+
+// Snapshot of the holding registers with the actual values of the computed registers
+static void holding_reg_current(holding_reg_params_t *regs)
+{
+    holding_reg_snapshot(regs);
+    // The computed registers are cached only when read over Modbus, get the actual values
+    for (size_t i = 0; i < COMPUTED_REG_COUNT; i++) {
+        computed_regs[i].getter((uint16_t *)regs + computed_regs[i].reg_offset,
+                                computed_regs[i].reg_count, computed_regs[i].arg);
+    }
+    mbc_slave_get_bound_regs(holding_reg_bindings, HOLDING_REG_BINDING_COUNT, (uint16_t *)regs);
+}
+
+// Largest /api/registers response: up to 5 digits and a comma per value, the quoted
+// descriptions with the schema
+#define REGISTERS_JSON_SIZE (48 + HOLDING_REG_COUNT * 9 + sizeof(HOLDING_REG_SCHEMA(HOLDING_REG_X_DESCR)))
+
+// Append a register value in decimal
+static char *json_put_u16(char *p, uint16_t value)
+{
+    char digits[5];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value != 0);
+    while (n > 0) {
+        *p++ = digits[--n];
+    }
+    return p;
 }
 
-// HTTP handler for registers API
+// HTTP handler for registers API, with ?schema=1 the register descriptions are included
 static esp_err_t registers_handler(httpd_req_t *req)
 {
-    char json[512];
-    snprintf(json, sizeof(json),
-        "{\"registers\":[%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u]}",
-        holding_reg_params.sequential_counter,
-        holding_reg_params.random_number,
-        holding_reg_params.uptime_seconds,
-        holding_reg_params.free_heap_kb_low,
-        holding_reg_params.free_heap_kb_high,
-        holding_reg_params.min_heap_kb,
-        holding_reg_params.cpu_freq_mhz,
-        holding_reg_params.task_count,
-        holding_reg_params.temperature_x10,
-        holding_reg_params.chip_cores,
-        holding_reg_params.wifi_enabled,
-        holding_reg_params.wifi_clients);
+    // Only the httpd task uses the buffer
+    static char json[REGISTERS_JSON_SIZE];
+    holding_reg_params_t regs;
+    holding_reg_current(&regs);
+
+    char query[16];
+    char value[4];
+    bool schema = (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) &&
+                  (httpd_query_key_value(query, "schema", value, sizeof(value)) == ESP_OK) &&
+                  (value[0] == '1');
+
+    const uint16_t *values = (const uint16_t *)&regs;
+    char *p = json;
+    memcpy(p, "{\"registers\":[", 14);
+    p += 14;
+    for (int i = 0; i < HOLDING_REG_COUNT; i++) {
+        if (i) {
+            *p++ = ',';
+        }
+        p = json_put_u16(p, values[i]);
+    }
+    *p++ = ']';
+    if (schema) {
+        memcpy(p, ",\"start\":", 9);
+        p = json_put_u16(p + 9, MB_REG_HOLDING_START);
+        memcpy(p, ",\"names\":[", 10);
+        p += 10;
+        for (int i = 0; i < HOLDING_REG_COUNT; i++) {
+            size_t len = strlen(holding_reg_info[i].descr);
+            if (i) {
+                *p++ = ',';
+            }
+            *p++ = '"';
+            memcpy(p, holding_reg_info[i].descr, len);
+            p += len;
+            *p++ = '"';
+        }
+        *p++ = ']';
+    }
+    *p++ = '}';
 
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
+    httpd_resp_send(req, json, p - json);
     return ESP_OK;
 }
 
-// HTTP handler for configuration API
-static esp_err_t config_handler(httpd_req_t *req)
+// HTTP handler for request trace API
+static esp_err_t trace_handler(httpd_req_t *req)
 {
-    char buf[100];
-    int ret = httpd_req_get_url_query_str(req, buf, sizeof(buf));
-    
-    if (ret == ESP_OK) {
-        char param[32];
-        if (httpd_query_key_value(buf, "slave_id", param, sizeof(param)) == ESP_OK) {
-            int slave_id = atoi(param);
-            if (slave_id >= 1 && slave_id <= 247) {
-                esp_err_t err = save_config((uint8_t)slave_id);
-                if (err == ESP_OK) {
-                    ESP_LOGI(TAG, "Configuration saved. configured_slave_addr is now: %d", configured_slave_addr);
-                    ESP_LOGI(TAG, "Requesting ESP32 restart to apply new slave address...");
-                    
-                    httpd_resp_set_type(req, "application/json");
-                    httpd_resp_sendstr(req, "{\"success\":true,\"message\":\"Slave ID saved. ESP32 will restart in 2 seconds...\"}");
-                    
-                    // Restart after a delay to allow response to be sent
-                    vTaskDelay(pdMS_TO_TICKS(2000));
-                    esp_restart();
-                    
-                    return ESP_OK;
-                } else {
-                    httpd_resp_set_type(req, "application/json");
-                    httpd_resp_sendstr(req, "{\"success\":false,\"message\":\"Failed to save configuration\"}");
-                    return ESP_OK;
-                }
-            }
+    char buf[64];
+    if (httpd_req_get_url_query_str(req, buf, sizeof(buf)) == ESP_OK) {
+        char param[4];
+        if (httpd_query_key_value(buf, "verbose", param, sizeof(param)) == ESP_OK) {
+            verbose_log = (atoi(param) != 0);
+            ESP_LOGI(TAG, "Per-request logging %s", verbose_log ? "enabled" : "disabled");
         }
     }
-    
+
+    uint32_t head = trace_head;
+    uint32_t count = (head < APP_TRACE_RING_SIZE) ? head : APP_TRACE_RING_SIZE;
+
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_sendstr(req, "{\"success\":false,\"message\":\"Invalid slave ID\"}");
+    snprintf(buf, sizeof(buf), "{\"verbose\":%s,\"total\":%lu,\"records\":[",
+             verbose_log ? "true" : "false", head);
+    httpd_resp_sendstr_chunk(req, buf);
+    for (uint32_t i = head - count; i != head; i++) {
+        trace_record_t rec = trace_ring[i % APP_TRACE_RING_SIZE];
+        snprintf(buf, sizeof(buf), "%s{\"ts\":%lu,\"type\":%u,\"addr\":%u,\"size\":%u}",
+                 (i == head - count) ? "" : ",",
+                 rec.time_stamp, rec.type, rec.mb_offset, rec.size);
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    httpd_resp_sendstr_chunk(req, NULL);
     return ESP_OK;
 }
 
-// Start web server
-static httpd_handle_t start_webserver(void)
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+// HTTP handler for turnaround latency API, ?reset=1 clears the histograms
+static esp_err_t latency_handler(httpd_req_t *req)
 {
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.lru_purge_enable = true;
+    char buf[64];
+    if (httpd_req_get_url_query_str(req, buf, sizeof(buf)) == ESP_OK) {
+        char param[4];
+        if ((httpd_query_key_value(buf, "reset", param, sizeof(param)) == ESP_OK) && atoi(param)) {
+            mbc_slave_reset_latency();
+        }
+    }
+
+    mb_latency_hist_t *hist = calloc(MB_LATENCY_FUNC_MAX, sizeof(mb_latency_hist_t));
+    if (hist == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    size_t count = 0;
+    mbc_slave_get_latency(hist, MB_LATENCY_FUNC_MAX, &count);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, "{\"bucket_us\":\"log2\",\"functions\":[");
+    for (size_t i = 0; i < count; i++) {
+        snprintf(buf, sizeof(buf), "%s{\"fc\":%u,\"count\":%lu",
+                 i ? "," : "", hist[i].func_code, hist[i].count);
+        httpd_resp_sendstr_chunk(req, buf);
+        for (int stage = 0; stage < MB_LATENCY_STAGE_COUNT; stage++) {
+            snprintf(buf, sizeof(buf), ",\"%s\":{\"max\":%lu,\"buckets\":[",
+                     latency_stage_names[stage], hist[i].max_us[stage]);
+            httpd_resp_sendstr_chunk(req, buf);
+            for (int b = 0; b < MB_LATENCY_BUCKETS; b++) {
+                snprintf(buf, sizeof(buf), "%s%lu", b ? "," : "", hist[i].buckets[stage][b]);
+                httpd_resp_sendstr_chunk(req, buf);
+            }
+            httpd_resp_sendstr_chunk(req, "]}");
+        }
+        httpd_resp_sendstr_chunk(req, "}");
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    free(hist);
+    return ESP_OK;
+}
+#endif
+
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+// HTTP handler for bus analyzer API, ?run=0|1 stops or starts, ?listen=0|1 sets the listen-only mode,
+// ?reset=1 clears the counters
+static esp_err_t bus_handler(httpd_req_t *req)
+{
+    char buf[192];
+    mb_bus_stats_t stats;
+    mbc_slave_get_bus_stats(&stats, NULL, 0, NULL);
+    if (httpd_req_get_url_query_str(req, buf, sizeof(buf)) == ESP_OK) {
+        char param[4];
+        bool run = stats.running;
+        bool listen = stats.listen_only;
+        if (httpd_query_key_value(buf, "run", param, sizeof(param)) == ESP_OK) {
+            run = (atoi(param) != 0);
+        }
+        if (httpd_query_key_value(buf, "listen", param, sizeof(param)) == ESP_OK) {
+            listen = (atoi(param) != 0);
+        }
+        if ((httpd_query_key_value(buf, "reset", param, sizeof(param)) == ESP_OK) && atoi(param)) {
+            mbc_slave_reset_bus_stats();
+        }
+        mbc_slave_set_bus_analyzer(run, listen);
+    }
+
+    mb_bus_slave_stats_t *slaves = malloc(CONFIG_FMB_SLAVE_BUS_ANALYZER_SLAVES * sizeof(mb_bus_slave_stats_t));
+    if (slaves == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    size_t count = 0;
+    mbc_slave_get_bus_stats(&stats, slaves, CONFIG_FMB_SLAVE_BUS_ANALYZER_SLAVES, &count);
+
+    httpd_resp_set_type(req, "application/json");
+    snprintf(buf, sizeof(buf),
+             "{\"running\":%s,\"listen_only\":%s,\"elapsed_ms\":%llu,\"utilization\":%.2f,\"frames\":%lu,"
+             "\"bytes\":%lu,\"bad_frames\":%lu,",
+             stats.running ? "true" : "false", stats.listen_only ? "true" : "false",
+             (unsigned long long)(stats.elapsed_us / 1000),
+             stats.elapsed_us ? (100.0 * (double)stats.busy_us / (double)stats.elapsed_us) : 0.0,
+             stats.frames, stats.bytes, stats.bad_frames);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             "\"broadcasts\":%lu,\"unmatched\":%lu,\"untracked\":%lu,"
+             "\"gap_us\":{\"min\":%lu,\"avg\":%llu,\"max\":%lu},\"slaves\":[",
+             stats.broadcasts, stats.unmatched, stats.untracked, stats.gap_min_us,
+             (unsigned long long)(stats.gaps ? (stats.gap_total_us / stats.gaps) : 0), stats.gap_max_us);
+    httpd_resp_sendstr_chunk(req, buf);
+    for (size_t i = 0; i < count; i++) {
+        const mb_bus_slave_stats_t *slave = &slaves[i];
+        uint32_t answered = slave->responses + slave->exceptions;
+        uint32_t failed = slave->timeouts + slave->bad_responses;
+        snprintf(buf, sizeof(buf),
+                 "%s{\"addr\":%u,\"last_fc\":%u,\"requests\":%lu,\"responses\":%lu,\"exceptions\":%lu,"
+                 "\"timeouts\":%lu,\"bad_responses\":%lu,",
+                 i ? "," : "", slave->addr, slave->last_func, slave->requests, slave->responses,
+                 slave->exceptions, slave->timeouts, slave->bad_responses);
+        httpd_resp_sendstr_chunk(req, buf);
+        snprintf(buf, sizeof(buf),
+                 "\"error_rate\":%.2f,\"resp_us\":{\"last\":%lu,\"min\":%lu,\"avg\":%llu,\"max\":%lu}}",
+                 slave->requests ? (100.0 * (double)failed / (double)slave->requests) : 0.0,
+                 slave->resp_last_us, slave->resp_min_us,
+                 (unsigned long long)(answered ? (slave->resp_total_us / answered) : 0), slave->resp_max_us);
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    free(slaves);
+    return ESP_OK;
+}
+#endif
+
+#if CONFIG_APP_TASK_STATS
+static const char *task_state_name(uint8_t state)
+{
+    switch (state) {
+    case eRunning:
+        return "running";
+    case eReady:
+        return "ready";
+    case eBlocked:
+        return "blocked";
+    case eSuspended:
+        return "suspended";
+    case eDeleted:
+        return "deleted";
+    default:
+        return "invalid";
+    }
+}
+
+// HTTP handler for task stats API, the tasks are sorted by CPU load
+static esp_err_t tasks_handler(httpd_req_t *req)
+{
+    task_stat_t *stats = malloc(sizeof(task_stats));
+    if (stats == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    uint16_t count;
+    uint16_t total;
+    uint32_t seq;
+    do {
+        seq = mb_seqlock_read_begin(&task_reg_lock);
+        count = task_reg_params.count;
+        total = task_reg_params.total;
+        memcpy(stats, task_stats, count * sizeof(task_stat_t));
+    } while (mb_seqlock_read_retry(&task_reg_lock, seq));
+
+    for (int i = 1; i < count; i++) {
+        task_stat_t stat = stats[i];
+        int j = i;
+        for (; (j > 0) && (stats[j - 1].cpu_permille < stat.cpu_permille); j--) {
+            stats[j] = stats[j - 1];
+        }
+        stats[j] = stat;
+    }
+
+    char buf[160];
+    httpd_resp_set_type(req, "application/json");
+    snprintf(buf, sizeof(buf), "{\"total\":%u,\"truncated\":%s,\"tasks\":[",
+             total, ((count == 0) && (total != 0)) ? "true" : "false");
+    httpd_resp_sendstr_chunk(req, buf);
+    for (int i = 0; i < count; i++) {
+        const task_stat_t *stat = &stats[i];
+        snprintf(buf, sizeof(buf),
+                 "%s{\"name\":\"%s\",\"core\":%d,\"prio\":%u,\"base_prio\":%u,\"state\":\"%s\","
+                 "\"cpu\":%u.%u,\"stack_free\":%u}",
+                 i ? "," : "", stat->name, (stat->core == TASK_CORE_NONE) ? -1 : stat->core,
+                 stat->priority, stat->base_priority, task_state_name(stat->state),
+                 stat->cpu_permille / 10, stat->cpu_permille % 10, stat->stack_free);
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    free(stats);
+    return ESP_OK;
+}
+#endif
+
+#if CONFIG_APP_HEAP_STATS
+// HTTP handler for heap telemetry API. With CONFIG_APP_HEAP_TRACE ?trace=<ms> starts a window
+// tracing all allocations and frees, ?records=1 lists the records of the last window
+static esp_err_t heap_handler(httpd_req_t *req)
+{
+    char buf[160];
+#if CONFIG_APP_HEAP_TRACE
+    bool records = false;
+    esp_err_t trace_err = ESP_OK;
+    if (httpd_req_get_url_query_str(req, buf, sizeof(buf)) == ESP_OK) {
+        char param[12];
+        if (httpd_query_key_value(buf, "trace", param, sizeof(param)) == ESP_OK) {
+            uint32_t window_ms = (uint32_t)strtoul(param, NULL, 10);
+            window_ms = (window_ms < 100) ? 100 : ((window_ms > 60000) ? 60000 : window_ms);
+            trace_err = heap_trace_window_start(window_ms);
+        }
+        if (httpd_query_key_value(buf, "records", param, sizeof(param)) == ESP_OK) {
+            records = (atoi(param) != 0);
+        }
+    }
+#endif
+
+    heap_reg_params_t regs;
+    uint32_t seq;
+    do {
+        seq = mb_seqlock_read_begin(&heap_reg_lock);
+        memcpy(&regs, &heap_reg_params, sizeof(regs));
+    } while (mb_seqlock_read_retry(&heap_reg_lock, seq));
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, "{\"caps\":{");
+    for (int i = 0; i < HEAP_CAPS_COUNT; i++) {
+        snprintf(buf, sizeof(buf), "%s\"%s\":{\"free\":%lu,\"largest\":%lu,\"min_free_kb\":%u,\"frag\":%u}",
+                 i ? "," : "", heap_caps_names[i],
+                 ((uint32_t)regs.caps[i].free_high << 16) | regs.caps[i].free_low,
+                 ((uint32_t)regs.caps[i].largest_high << 16) | regs.caps[i].largest_low,
+                 regs.caps[i].min_free_kb, regs.caps[i].frag_percent);
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    snprintf(buf, sizeof(buf), "},\"allocs_per_s\":%u,\"frees_per_s\":%u,\"allocs\":%lu,\"frees\":%lu,\"failed\":%lu",
+             regs.allocs_per_s, regs.frees_per_s,
+             __atomic_load_n(&heap_alloc_count, __ATOMIC_RELAXED),
+             __atomic_load_n(&heap_free_count, __ATOMIC_RELAXED),
+             __atomic_load_n(&heap_failed_count, __ATOMIC_RELAXED));
+    httpd_resp_sendstr_chunk(req, buf);
+
+#if CONFIG_APP_HEAP_TRACE
+    heap_trace_summary_t summary = { 0 };
+    heap_trace_summary(&summary);
+    snprintf(buf, sizeof(buf),
+             ",\"trace\":{\"running\":%s,\"error\":\"%s\",\"count\":%u,\"capacity\":%u,\"allocs\":%u,"
+             "\"frees\":%u,\"overflowed\":%s",
+             __atomic_load_n(&heap_trace_running, __ATOMIC_RELAXED) ? "true" : "false",
+             (trace_err == ESP_OK) ? "" : esp_err_to_name(trace_err),
+             (unsigned)summary.count, (unsigned)summary.capacity, (unsigned)summary.total_allocations,
+             (unsigned)summary.total_frees, summary.has_overflowed ? "true" : "false");
+    httpd_resp_sendstr_chunk(req, buf);
+    if (records) {
+        httpd_resp_sendstr_chunk(req, ",\"records\":[");
+        size_t count = heap_trace_get_count();
+        for (size_t i = 0; i < count; i++) {
+            heap_trace_record_t rec;
+            if (heap_trace_get(i, &rec) != ESP_OK) {
+                break;
+            }
+#if CONFIG_HEAP_TRACING_STACK_DEPTH > 0
+            void *caller = rec.alloced_by[0];
+            bool freed = (rec.freed_by[0] != NULL);
+#else
+            void *caller = NULL;
+            bool freed = false;
+#endif
+            snprintf(buf, sizeof(buf), "%s{\"addr\":\"%p\",\"size\":%u,\"caller\":\"%p\",\"freed\":%s}",
+                     i ? "," : "", rec.address, (unsigned)rec.size, caller, freed ? "true" : "false");
+            httpd_resp_sendstr_chunk(req, buf);
+        }
+        httpd_resp_sendstr_chunk(req, "]");
+    }
+    httpd_resp_sendstr_chunk(req, "}");
+#endif
+    httpd_resp_sendstr_chunk(req, "}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+#endif
+
+#if CONFIG_FMB_FRAME_TRACE
+// pcap export of the frame trace ring, the link type DLT_USER0 carries one pseudo header
+// byte with the MB_FRAME_* flags before the frame bytes (RTU ADU or MBAP frame)
+#define PCAP_MAGIC              (0xa1b2c3d4U)
+#define PCAP_LINKTYPE_USER0     (147)
+#define FRAMES_BATCH            (8)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+} pcap_file_header_t;
+
+typedef struct {
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+} pcap_record_header_t;
+
+typedef struct {
+    mb_frame_record_t records[FRAMES_BATCH];
+    uint8_t out[FRAMES_BATCH * (sizeof(pcap_record_header_t) + 1 + MB_FRAME_TRACE_DATA_MAX)];
+} frames_batch_t;
+
+// HTTP handler for frame trace API, returns the frames in the ring as a pcap file,
+// ?transport=rtu|tcp selects one transport, ?enable=0|1 pauses or resumes the recording.
+// Runs in the HTTP worker task
+static esp_err_t frames_handler(httpd_req_t *req)
+{
+    char buf[64];
+    int transport = -1;         // -1 all, 0 RTU, MB_FRAME_TCP
+    if (httpd_req_get_url_query_str(req, buf, sizeof(buf)) == ESP_OK) {
+        char param[12];
+        if (httpd_query_key_value(buf, "enable", param, sizeof(param)) == ESP_OK) {
+            mbc_slave_set_frame_trace(atoi(param) != 0);
+        }
+        if (httpd_query_key_value(buf, "transport", param, sizeof(param)) == ESP_OK) {
+            transport = (strcmp(param, "tcp") == 0) ? MB_FRAME_TCP : 0;
+        }
+    }
+
+    frames_batch_t *batch = malloc(sizeof(frames_batch_t));
+    if (batch == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    // The ring holds the time since boot, shift it to the wall clock if that is set
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t offset_us = ((int64_t)tv.tv_sec * 1000000 + tv.tv_usec) - esp_timer_get_time();
+
+    size_t count = 0;
+    uint32_t seq = 0;
+    esp_err_t err = mbc_slave_get_frames(0, batch->records, FRAMES_BATCH, &count, &seq);
+    if (err != ESP_OK) {
+        free(batch);
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Frame trace not available");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/vnd.tcpdump.pcap");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"frames.pcap\"");
+    const pcap_file_header_t file_header = {
+        .magic = PCAP_MAGIC,
+        .version_major = 2,
+        .version_minor = 4,
+        .snaplen = CONFIG_FMB_FRAME_TRACE_BYTES + 1,
+        .linktype = PCAP_LINKTYPE_USER0
+    };
+    err = httpd_resp_send_chunk(req, (const char *)&file_header, sizeof(file_header));
+
+    // The frames recorded meanwhile are appended up to one ring of records in total
+    size_t total = 0;
+    while ((err == ESP_OK) && (count > 0)) {
+        size_t len = 0;
+        for (size_t i = 0; i < count; i++) {
+            const mb_frame_record_t *rec = &batch->records[i];
+            if ((transport >= 0) && ((rec->flags & MB_FRAME_TCP) != transport)) {
+                continue;
+            }
+            int64_t ts_us = rec->timestamp_us + offset_us;
+            pcap_record_header_t header = {
+                .ts_sec = (uint32_t)(ts_us / 1000000),
+                .ts_usec = (uint32_t)(ts_us % 1000000),
+                .incl_len = rec->captured + 1U,
+                .orig_len = rec->length + 1U
+            };
+            memcpy(&batch->out[len], &header, sizeof(header));
+            len += sizeof(header);
+            batch->out[len++] = rec->flags;
+            memcpy(&batch->out[len], rec->data, rec->captured);
+            len += rec->captured;
+        }
+        if (len > 0) {
+            err = httpd_resp_send_chunk(req, (const char *)batch->out, len);
+        }
+        total += count;
+        if ((count < FRAMES_BATCH) || (total >= CONFIG_FMB_FRAME_TRACE_RING_SIZE)) {
+            break;
+        }
+        if (mbc_slave_get_frames(seq, batch->records, FRAMES_BATCH, &count, &seq) != ESP_OK) {
+            break;
+        }
+    }
+    free(batch);
+    if (err != ESP_OK) {
+        return err;
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+#endif
+
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
+// HTTP handler for register change API, ?since=N returns the holding registers changed after
+// the sequence N, the client polls with the returned sequence
+static esp_err_t changes_handler(httpd_req_t *req)
+{
+    char buf[64];
+    uint32_t since = 0;
+    if (httpd_req_get_url_query_str(req, buf, sizeof(buf)) == ESP_OK) {
+        char param[12];
+        if (httpd_query_key_value(buf, "since", param, sizeof(param)) == ESP_OK) {
+            since = strtoul(param, NULL, 10);
+        }
+    }
+
+    mb_reg_change_t changes[HOLDING_REG_COUNT];
+    size_t count = 0;
+    uint32_t seq = since;
+    if (mbc_slave_get_changes(MB_PARAM_HOLDING, since, changes, HOLDING_REG_COUNT, &count, &seq) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    snprintf(buf, sizeof(buf), "{\"seq\":%lu,\"changes\":[", seq);
+    httpd_resp_sendstr_chunk(req, buf);
+    for (size_t i = 0; i < count; i++) {
+        snprintf(buf, sizeof(buf), "%s[%u,%u]", i ? "," : "", changes[i].address, changes[i].value);
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+#endif
+
+#if CONFIG_APP_BENCH_LOOPBACK
+// HTTP handler for the loopback test results, ?reset=1 restarts the run
+static esp_err_t bench_handler(httpd_req_t *req)
+{
+    char buf[224];
+    if (httpd_req_get_url_query_str(req, buf, sizeof(buf)) == ESP_OK) {
+        char param[4];
+        if ((httpd_query_key_value(buf, "reset", param, sizeof(param)) == ESP_OK) && atoi(param)) {
+            bench_reset();
+        }
+    }
+
+    bench_stats_t stats;
+    bench_get_stats(&stats);
+    httpd_resp_set_type(req, "application/json");
+    snprintf(buf, sizeof(buf),
+             "{\"running\":%s,\"elapsed_s\":%lu,\"requests\":%lu,\"avg_rate\":%lu,\"rate\":%lu,"
+             "\"rate_min\":%lu,\"rate_max\":%lu,",
+             stats.running ? "true" : "false", stats.elapsed_s, stats.requests,
+             stats.elapsed_s ? (stats.requests / stats.elapsed_s) : 0, stats.rate, stats.rate_min, stats.rate_max);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             "\"functions\":{\"1\":%lu,\"3\":%lu,\"6\":%lu,\"15\":%lu,\"16\":%lu},",
+             stats.func_requests[0], stats.func_requests[1], stats.func_requests[2],
+             stats.func_requests[3], stats.func_requests[4]);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             "\"latency_us\":{\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"p999\":%lu,\"max\":%lu},",
+             stats.p50_us, stats.p90_us, stats.p99_us, stats.p999_us, stats.max_us);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             "\"errors\":{\"total\":%lu,\"timeout\":%lu,\"crc\":%lu,\"exception\":%lu,\"mismatch\":%lu},"
+             "\"heap\":{\"start\":%lu,\"drift\":%ld,\"min\":%lu}}",
+             stats.errors, stats.timeouts, stats.crc_errors, stats.exceptions, stats.mismatches,
+             stats.heap_start, stats.heap_drift, stats.heap_min);
+    httpd_resp_sendstr_chunk(req, buf);
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+#endif
+
+// Binary snapshot of the registers and counters at /api/snapshot.bin, all fields little-endian
+// header:  u32 magic "MBSN", u16 version, u16 header size, u32 seq, u16 flags, u16 number of sections
+// section: u16 type, u16 id, u32 payload size, payload
+// - SNAPSHOT_REGS:      id = Modbus table (3 input, 4 holding), u16 start, u16 count, u16 values[count]
+// - SNAPSHOT_CHANGES:   id = Modbus table, u16 count, count x (u16 address, u16 value)
+// - SNAPSHOT_COUNTERS:  id = counter group, u32 values[], new counters are appended to the group
+// - SNAPSHOT_FUNC_HITS: count x (u8 function code, u32 requests) of the received function codes
+// - SNAPSHOT_LATENCY:   per function code u8 function code, u8 stages, u8 buckets, u8 reserved,
+//                       u32 responses, u32 max_us[stages], u32 buckets[stages][buckets]
+// With since=<seq> the holding registers 0-11 are sent as the changes after seq (SNAPSHOT_FLAG_DELTA),
+// the header seq is the since value of the next request. With history=<samples> only the temperature
+// history registers written after that sample count are sent, without it the history is sent with
+// the full snapshot only.
+#define SNAPSHOT_MAGIC          (0x4E53424DUL)  // "MBSN"
+#define SNAPSHOT_VERSION        (1)
+#define SNAPSHOT_HEADER_SIZE    (16)
+#define SNAPSHOT_FLAG_DELTA     (0x0001)
+#define SNAPSHOT_TABLE_INPUT    (3)
+#define SNAPSHOT_TABLE_HOLDING  (4)
+
+typedef enum {
+    SNAPSHOT_REGS = 1,
+    SNAPSHOT_CHANGES,
+    SNAPSHOT_COUNTERS,
+    SNAPSHOT_FUNC_HITS,
+    SNAPSHOT_LATENCY
+} snapshot_section_t;
+
+typedef enum {
+    SNAPSHOT_GROUP_APP = 1,     // total, reads, writes, errors, uptime s, slave id, baudrate, parity
+    SNAPSHOT_GROUP_RTU,         // requests, exceptions, serial line diagnostic counters
+                                // (mb_slave_diag_counters_t order)
+    SNAPSHOT_GROUP_TCP,         // requests, exceptions, errors, connects, forwarded, clients
+    SNAPSHOT_GROUP_NVS,         // marks, commits, blobs, bytes, skipped, failures, pending
+    SNAPSHOT_GROUP_CPU,         // load % per core, 0xFFFFFFFF if not available
+    SNAPSHOT_GROUP_GATEWAY,     // requests, cache hits, joined, bus requests, exceptions, cached
+    SNAPSHOT_GROUP_HISTORY      // samples taken, history registers
+} snapshot_group_t;
+
+// Buffers the response into chunks
+typedef struct {
+    httpd_req_t *req;
+    esp_err_t err;
+    size_t len;
+    uint8_t buf[256];
+} snapshot_writer_t;
+
+static void snapshot_put(snapshot_writer_t *w, const uint8_t *data, size_t size)
+{
+    while ((size > 0) && (w->err == ESP_OK)) {
+        size_t n = sizeof(w->buf) - w->len;
+        n = (size < n) ? size : n;
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        data += n;
+        size -= n;
+        if (w->len == sizeof(w->buf)) {
+            w->err = httpd_resp_send_chunk(w->req, (const char *)w->buf, w->len);
+            w->len = 0;
+        }
+    }
+}
+
+static void snapshot_put_u16(snapshot_writer_t *w, uint16_t value)
+{
+    uint8_t le[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    snapshot_put(w, le, sizeof(le));
+}
+
+static void snapshot_put_u32(snapshot_writer_t *w, uint32_t value)
+{
+    uint8_t le[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    snapshot_put(w, le, sizeof(le));
+}
+
+static void snapshot_section(snapshot_writer_t *w, uint16_t type, uint16_t id, uint32_t size)
+{
+    snapshot_put_u16(w, type);
+    snapshot_put_u16(w, id);
+    snapshot_put_u32(w, size);
+}
+
+static void snapshot_regs(snapshot_writer_t *w, uint16_t table, uint16_t start, const uint16_t *values, uint16_t count)
+{
+    snapshot_section(w, SNAPSHOT_REGS, table, 4 + count * 2);
+    snapshot_put_u16(w, start);
+    snapshot_put_u16(w, count);
+    for (uint16_t i = 0; i < count; i++) {
+        snapshot_put_u16(w, values[i]);
+    }
+}
+
+static void snapshot_counters(snapshot_writer_t *w, uint16_t group, const uint32_t *values, size_t count)
+{
+    snapshot_section(w, SNAPSHOT_COUNTERS, group, count * 4);
+    for (size_t i = 0; i < count; i++) {
+        snapshot_put_u32(w, values[i]);
+    }
+}
+
+#if MB_REG_HISTORY_COUNT > 0
+// History registers [first, first + count) of the storage, copied in consistent pieces
+static void snapshot_history(snapshot_writer_t *w, uint16_t first, uint16_t count)
+{
+    uint16_t piece[64];
+    snapshot_section(w, SNAPSHOT_REGS, SNAPSHOT_TABLE_INPUT, 4 + count * 2);
+    snapshot_put_u16(w, MB_REG_HISTORY_START + first);
+    snapshot_put_u16(w, count);
+    while ((count > 0) && (w->err == ESP_OK)) {
+        uint16_t n = (count < 64) ? count : 64;
+        uint32_t seq;
+        do {
+            seq = mb_seqlock_read_begin(&history_reg_lock);
+            memcpy(piece, history_regs + first, n * sizeof(uint16_t));
+        } while (mb_seqlock_read_retry(&history_reg_lock, seq));
+        for (uint16_t i = 0; i < n; i++) {
+            snapshot_put_u16(w, piece[i]);
+        }
+        first += n;
+        count -= n;
+    }
+}
+#endif
+
+// HTTP handler for the binary snapshot API, runs in the HTTP worker task
+static esp_err_t snapshot_handler(httpd_req_t *req)
+{
+    char query[64];
+    char param[12];
+    bool delta = false;
+    uint32_t since = 0;
+    bool history_delta = false;
+    uint32_t history_since = 0;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "since", param, sizeof(param)) == ESP_OK) {
+            since = strtoul(param, NULL, 10);
+            delta = true;
+        }
+        if (httpd_query_key_value(query, "history", param, sizeof(param)) == ESP_OK) {
+            history_since = strtoul(param, NULL, 10);
+            history_delta = true;
+        }
+    }
+#if MB_REG_HISTORY_COUNT == 0
+    (void)history_delta;
+    (void)history_since;
+#endif
+
+    // The cursor is taken before the values, a later change is reported by the next delta
+    mb_reg_change_t changes[HOLDING_REG_COUNT];
+    size_t change_count = 0;
+    uint32_t seq = since;
+    if (mbc_slave_get_changes(MB_PARAM_HOLDING, delta ? since : 0, changes, HOLDING_REG_COUNT,
+                              &change_count, &seq) != ESP_OK) {
+        // Without change tracking every snapshot is a full one
+        delta = false;
+        seq = 0;
+    }
+    holding_reg_params_t regs;
+    holding_reg_current(&regs);
+
+    modbus_stats_t stats;
+    stats_snapshot(&stats);
+    app_config_t cfg;
+    uint32_t cfg_seq;
+    do {
+        cfg_seq = mb_seqlock_read_begin(&app_config_lock);
+        cfg = app_config;
+    } while (mb_seqlock_read_retry(&app_config_lock, cfg_seq));
+    const uint32_t app_counters[] = {
+        stats.total_requests, stats.read_requests, stats.write_requests, stats.errors,
+        stats.uptime_seconds, cfg.slave_addr, cfg.baudrate, cfg.parity
+    };
+    mb_slave_addr_stats_t rtu_stats = { 0 };
+    mbc_slave_get_addr_stats(0, &rtu_stats);
+    mb_slave_diag_counters_t diag = { 0 };
+    mbc_slave_get_diag_counters(&diag);
+    const uint32_t rtu_counters[] = {
+        rtu_stats.requests, rtu_stats.exceptions, diag.bus_messages, diag.bus_comm_errors,
+        diag.exceptions, diag.server_messages, diag.no_response, diag.not_addressed,
+        diag.broadcasts, diag.fifo_overflows, diag.buffer_full, diag.parity_errors, diag.frame_errors
+    };
+    persist_stats_t nvs_stats;
+    persist_get_stats(&nvs_stats);
+    const uint32_t nvs_counters[] = {
+        nvs_stats.marks, nvs_stats.commits, nvs_stats.blob_writes, nvs_stats.bytes,
+        nvs_stats.skipped, nvs_stats.failures, nvs_stats.pending
+    };
+    uint32_t cpu_counters[portNUM_PROCESSORS];
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        cpu_counters[core] = (cpu_load_percent[core] == 0xFF) ? UINT32_MAX : cpu_load_percent[core];
+    }
+    mb_slave_tcp_stats_t tcp_stats = { 0 };
+    bool tcp = (mbc_slave_get_tcp_stats(&tcp_stats) == ESP_OK);
+    const uint32_t tcp_counters[] = {
+        tcp_stats.requests, tcp_stats.exceptions, tcp_stats.errors, tcp_stats.connects,
+        tcp_stats.forwarded, tcp_stats.clients
+    };
+    uint32_t func_hits[MB_FUNC_CODE_COUNT];
+    size_t func_count = 0;
+    bool funcs = (mbc_slave_get_func_hits(func_hits, MB_FUNC_CODE_COUNT) == ESP_OK);
+    for (int fc = 0; funcs && (fc < MB_FUNC_CODE_COUNT); fc++) {
+        func_count += (func_hits[fc] != 0);
+    }
+
+    int sections = 5 + (tcp ? 1 : 0) + (funcs ? 1 : 0);
+#if CONFIG_APP_MODBUS_GATEWAY
+    gateway_stats_t gw_stats;
+    gateway_get_stats(&gw_stats);
+    const uint32_t gw_counters[] = {
+        gw_stats.requests, gw_stats.cache_hits, gw_stats.joined, gw_stats.bus_requests,
+        gw_stats.exceptions, gw_stats.cached
+    };
+    sections++;
+#endif
+#if MB_REG_RETAIN_COUNT > 0
+    uint16_t retain_regs[MB_REG_RETAIN_COUNT];
+    uint32_t retain_seq;
+    do {
+        retain_seq = mb_seqlock_read_begin(&retain_reg_lock);
+        memcpy(retain_regs, retain_reg_params, sizeof(retain_regs));
+    } while (mb_seqlock_read_retry(&retain_reg_lock, retain_seq));
+    sections++;
+#endif
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+    input_reg_params_t input_regs;
+    uint32_t input_seq;
+    do {
+        input_seq = mb_seqlock_read_begin(&input_reg_lock);
+        memcpy(&input_regs, &input_reg_params, sizeof(input_regs));
+    } while (mb_seqlock_read_retry(&input_reg_lock, input_seq));
+    size_t hist_count = 0;
+    mb_latency_hist_t *hist = calloc(MB_LATENCY_FUNC_MAX, sizeof(mb_latency_hist_t));
+    bool latency = (hist != NULL) && (mbc_slave_get_latency(hist, MB_LATENCY_FUNC_MAX, &hist_count) == ESP_OK);
+    sections += latency ? 2 : 1;
+#endif
+#if CONFIG_APP_TASK_STATS
+    static task_reg_params_t task_regs;    // Used only in the HTTP worker task
+    uint32_t task_seq;
+    do {
+        task_seq = mb_seqlock_read_begin(&task_reg_lock);
+        memcpy(&task_regs, &task_reg_params, sizeof(task_regs));
+    } while (mb_seqlock_read_retry(&task_reg_lock, task_seq));
+    sections++;
+#endif
+#if CONFIG_APP_HEAP_STATS
+    heap_reg_params_t heap_regs;
+    uint32_t heap_seq;
+    do {
+        heap_seq = mb_seqlock_read_begin(&heap_reg_lock);
+        memcpy(&heap_regs, &heap_reg_params, sizeof(heap_regs));
+    } while (mb_seqlock_read_retry(&heap_reg_lock, heap_seq));
+    sections++;
+#endif
+#if MB_REG_HISTORY_COUNT > 0
+    // Ranges of the history storage: [0] holds the sample count, the ring follows
+    uint16_t history_first[3];
+    uint16_t history_count[3];
+    int history_ranges = 0;
+    uint32_t samples = 0;
+    if (history_regs != NULL) {
+        uint32_t history_seq;
+        do {
+            history_seq = mb_seqlock_read_begin(&history_reg_lock);
+            samples = history_samples;
+        } while (mb_seqlock_read_retry(&history_reg_lock, history_seq));
+        if (!history_delta && !delta) {
+            history_first[0] = 0;
+            history_count[0] = MB_REG_HISTORY_COUNT + 1;
+            history_ranges = 1;
+        } else if (history_delta) {
+            // A collector ahead of the device has missed a restart, it gets the whole ring
+            uint32_t fresh = (history_since > samples) ? MB_REG_HISTORY_COUNT : (samples - history_since);
+            fresh = (fresh > MB_REG_HISTORY_COUNT) ? MB_REG_HISTORY_COUNT : fresh;
+            fresh = (fresh > samples) ? samples : fresh;
+            history_first[0] = 0;
+            history_count[0] = 1;
+            history_ranges = 1;
+            uint16_t first = (uint16_t)((samples - fresh) % MB_REG_HISTORY_COUNT);
+            while (fresh > 0) {
+                uint16_t run = MB_REG_HISTORY_COUNT - first;
+                run = (fresh < run) ? (uint16_t)fresh : run;
+                history_first[history_ranges] = 1 + first;
+                history_count[history_ranges] = run;
+                history_ranges++;
+                fresh -= run;
+                first = 0;
+            }
+        }
+        sections += 1 + history_ranges;
+    }
+    const uint32_t history_counters[] = { samples, MB_REG_HISTORY_COUNT };
+#endif
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    snapshot_writer_t writer = { .req = req, .err = ESP_OK, .len = 0 };
+    snapshot_writer_t *w = &writer;
+    snapshot_put_u32(w, SNAPSHOT_MAGIC);
+    snapshot_put_u16(w, SNAPSHOT_VERSION);
+    snapshot_put_u16(w, SNAPSHOT_HEADER_SIZE);
+    snapshot_put_u32(w, seq);
+    snapshot_put_u16(w, delta ? SNAPSHOT_FLAG_DELTA : 0);
+    snapshot_put_u16(w, (uint16_t)sections);
+
+    if (delta) {
+        snapshot_section(w, SNAPSHOT_CHANGES, SNAPSHOT_TABLE_HOLDING, 2 + change_count * 4);
+        snapshot_put_u16(w, (uint16_t)change_count);
+        for (size_t i = 0; i < change_count; i++) {
+            snapshot_put_u16(w, changes[i].address);
+            snapshot_put_u16(w, changes[i].value);
+        }
+    } else {
+        snapshot_regs(w, SNAPSHOT_TABLE_HOLDING, MB_REG_HOLDING_START, (const uint16_t *)&regs, HOLDING_REG_COUNT);
+    }
+#if MB_REG_RETAIN_COUNT > 0
+    snapshot_regs(w, SNAPSHOT_TABLE_HOLDING, MB_REG_RETAIN_START, retain_regs, MB_REG_RETAIN_COUNT);
+#endif
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+    snapshot_regs(w, SNAPSHOT_TABLE_INPUT, MB_REG_INPUT_START, (const uint16_t *)&input_regs,
+                  sizeof(input_regs) / sizeof(uint16_t));
+#endif
+#if CONFIG_APP_HEAP_STATS
+    snapshot_regs(w, SNAPSHOT_TABLE_INPUT, MB_REG_HEAP_START, (const uint16_t *)&heap_regs,
+                  sizeof(heap_regs) / sizeof(uint16_t));
+#endif
+#if CONFIG_APP_TASK_STATS
+    // Only the used entries of the task table
+    snapshot_regs(w, SNAPSHOT_TABLE_INPUT, MB_REG_TASK_START, (const uint16_t *)&task_regs,
+                  2 + task_regs.count * (sizeof(task_regs.task[0]) / sizeof(uint16_t)));
+#endif
+#if MB_REG_HISTORY_COUNT > 0
+    for (int i = 0; i < history_ranges; i++) {
+        snapshot_history(w, history_first[i], history_count[i]);
+    }
+    if (history_regs != NULL) {
+        snapshot_counters(w, SNAPSHOT_GROUP_HISTORY, history_counters, 2);
+    }
+#endif
+
+    snapshot_counters(w, SNAPSHOT_GROUP_APP, app_counters, sizeof(app_counters) / sizeof(app_counters[0]));
+    snapshot_counters(w, SNAPSHOT_GROUP_RTU, rtu_counters, sizeof(rtu_counters) / sizeof(rtu_counters[0]));
+    snapshot_counters(w, SNAPSHOT_GROUP_NVS, nvs_counters, sizeof(nvs_counters) / sizeof(nvs_counters[0]));
+    snapshot_counters(w, SNAPSHOT_GROUP_CPU, cpu_counters, portNUM_PROCESSORS);
+    if (tcp) {
+        snapshot_counters(w, SNAPSHOT_GROUP_TCP, tcp_counters, sizeof(tcp_counters) / sizeof(tcp_counters[0]));
+    }
+#if CONFIG_APP_MODBUS_GATEWAY
+    snapshot_counters(w, SNAPSHOT_GROUP_GATEWAY, gw_counters, sizeof(gw_counters) / sizeof(gw_counters[0]));
+#endif
+
+    if (funcs) {
+        snapshot_section(w, SNAPSHOT_FUNC_HITS, 0, func_count * 5);
+        for (int fc = 0; fc < MB_FUNC_CODE_COUNT; fc++) {
+            if (func_hits[fc] != 0) {
+                uint8_t code = (uint8_t)fc;
+                snapshot_put(w, &code, 1);
+                snapshot_put_u32(w, func_hits[fc]);
+            }
+        }
+    }
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+    if (latency) {
+        const uint8_t shape[3] = { MB_LATENCY_STAGE_COUNT, MB_LATENCY_BUCKETS, 0 };
+        snapshot_section(w, SNAPSHOT_LATENCY, 0,
+                         hist_count * (8 + MB_LATENCY_STAGE_COUNT * (1 + MB_LATENCY_BUCKETS) * 4));
+        for (size_t i = 0; i < hist_count; i++) {
+            snapshot_put(w, &hist[i].func_code, 1);
+            snapshot_put(w, shape, sizeof(shape));
+            snapshot_put_u32(w, hist[i].count);
+            for (int stage = 0; stage < MB_LATENCY_STAGE_COUNT; stage++) {
+                snapshot_put_u32(w, hist[i].max_us[stage]);
+            }
+            for (int stage = 0; stage < MB_LATENCY_STAGE_COUNT; stage++) {
+                for (int b = 0; b < MB_LATENCY_BUCKETS; b++) {
+                    snapshot_put_u32(w, hist[i].buckets[stage][b]);
+                }
+            }
+        }
+    }
+    free(hist);
+#endif
+
+    if ((w->err == ESP_OK) && (w->len > 0)) {
+        w->err = httpd_resp_send_chunk(req, (const char *)w->buf, w->len);
+    }
+    if (w->err != ESP_OK) {
+        return w->err;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+#if CONFIG_APP_LIVE_WS
+// Live telemetry: the web UI clients on /ws get a frame with the fields which
+// changed since their previous frame, at most one frame per client interval
+#define LIVE_CLIENT_MAX     (WIFI_AP_MAX_CONN)
+#define LIVE_TICK_MS        (CONFIG_APP_LIVE_INTERVAL_MS)
+
+typedef enum {
+    LIVE_STAT_TOTAL = 0,
+    LIVE_STAT_READS,
+    LIVE_STAT_WRITES,
+    LIVE_STAT_ERRORS,
+    LIVE_STAT_UPTIME,
+    LIVE_STAT_SLAVE_ID,
+    LIVE_STAT_BAUD,
+    LIVE_STAT_PARITY,
+    LIVE_STAT_COUNT
+} live_stat_t;
+
+// Same keys as /api/stats
+static const char *live_stat_names[LIVE_STAT_COUNT] = {
+    "total", "reads", "writes", "errors", "uptime", "slave_id", "baud", "parity"
+};
+
+typedef struct {
+    uint16_t regs[HOLDING_REG_COUNT];
+    uint32_t stats[LIVE_STAT_COUNT];
+} live_state_t;
+
+typedef struct {
+    int fd;                     // Socket of the client, -1 for a free entry
+    bool synced;                // The client got the full state once
+    uint32_t interval_ms;       // Minimum time between two frames
+    int64_t last_us;            // Time of the last frame
+    live_state_t state;         // State sent with the last frame
+} live_client_t;
+
+// Client table, used only in the httpd task
+static live_client_t live_clients[LIVE_CLIENT_MAX] = {
+    [0 ... LIVE_CLIENT_MAX - 1] = { .fd = -1 }
+};
+static uint32_t live_client_count = 0;
+static bool live_push_queued = false;
+
+static void live_snapshot(live_state_t *state)
+{
+    holding_reg_params_t regs;
+    modbus_stats_t stats;
+    app_config_t cfg;
+    uint32_t seq;
+    holding_reg_current(&regs);
+    memcpy(state->regs, &regs, sizeof(state->regs));
+    stats_snapshot(&stats);
+    do {
+        seq = mb_seqlock_read_begin(&app_config_lock);
+        cfg = app_config;
+    } while (mb_seqlock_read_retry(&app_config_lock, seq));
+    state->stats[LIVE_STAT_TOTAL] = stats.total_requests;
+    state->stats[LIVE_STAT_READS] = stats.read_requests;
+    state->stats[LIVE_STAT_WRITES] = stats.write_requests;
+    state->stats[LIVE_STAT_ERRORS] = stats.errors;
+    state->stats[LIVE_STAT_UPTIME] = stats.uptime_seconds;
+    state->stats[LIVE_STAT_SLAVE_ID] = cfg.slave_addr;
+    state->stats[LIVE_STAT_BAUD] = cfg.baudrate;
+    state->stats[LIVE_STAT_PARITY] = cfg.parity;
+}
+
+// Format the fields which differ from the previous state, all fields without
+// previous state, returns 0 if nothing changed
+static int live_format_delta(char *frame, size_t size, const live_state_t *prev, const live_state_t *state)
+{
+    int len = 1;
+    bool regs = false;
+    frame[0] = '{';
+    for (int i = 0; i < LIVE_STAT_COUNT; i++) {
+        if (prev && (prev->stats[i] == state->stats[i])) {
+            continue;
+        }
+        if (i == LIVE_STAT_PARITY) {
+            len += snprintf(frame + len, size - len, "%s\"%s\":\"%s\"", (len > 1) ? "," : "",
+                            live_stat_names[i], parity_name((uart_parity_t)state->stats[i]));
+        } else {
+            len += snprintf(frame + len, size - len, "%s\"%s\":%lu", (len > 1) ? "," : "",
+                            live_stat_names[i], state->stats[i]);
+        }
+    }
+    for (int i = 0; i < HOLDING_REG_COUNT; i++) {
+        if (prev && (prev->regs[i] == state->regs[i])) {
+            continue;
+        }
+        len += snprintf(frame + len, size - len, "%s\"%d\":%u",
+                        regs ? "," : ((len > 1) ? ",\"reg\":{" : "\"reg\":{"), i, state->regs[i]);
+        regs = true;
+    }
+    if (len == 1) {
+        return 0;
+    }
+    len += snprintf(frame + len, size - len, regs ? "}}" : "}");
+    return len;
+}
+
+// Send the changes to the clients whose interval has elapsed, runs in the httpd task
+static void live_push_work(void *arg)
+{
+    httpd_handle_t hd = (httpd_handle_t)arg;
+    live_state_t state;
+    char frame[384];
+    __atomic_store_n(&live_push_queued, false, __ATOMIC_RELAXED);
+    live_snapshot(&state);
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < LIVE_CLIENT_MAX; i++) {
+        live_client_t *client = &live_clients[i];
+        if (client->fd < 0) {
+            continue;
+        }
+        if (httpd_ws_get_fd_info(hd, client->fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+            // Closed by the client or purged by httpd
+            client->fd = -1;
+            __atomic_fetch_sub(&live_client_count, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        // Half a tick of slack, the sampler does not run exactly on time
+        if ((now - client->last_us) + (LIVE_TICK_MS * 1000 / 2) < (int64_t)client->interval_ms * 1000) {
+            continue;
+        }
+        int len = live_format_delta(frame, sizeof(frame), client->synced ? &client->state : NULL, &state);
+        if (len == 0) {
+            continue;
+        }
+        httpd_ws_frame_t ws_frame = {
+            .final = true,
+            .type = HTTPD_WS_TYPE_TEXT,
+            .payload = (uint8_t *)frame,
+            .len = (size_t)len
+        };
+        if (httpd_ws_send_frame_async(hd, client->fd, &ws_frame) != ESP_OK) {
+            httpd_sess_trigger_close(hd, client->fd);
+            client->fd = -1;
+            __atomic_fetch_sub(&live_client_count, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        memcpy(&client->state, &state, sizeof(state));
+        client->synced = true;
+        client->last_us = now;
+    }
+}
+
+// WebSocket handler of /ws, the optional query interval=<ms> sets a longer frame interval
+static esp_err_t live_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET) {
+        // Handshake done, register the client
+        int fd = httpd_req_to_sockfd(req);
+        live_client_t *client = NULL;
+        for (int i = 0; i < LIVE_CLIENT_MAX; i++) {
+            if (live_clients[i].fd == fd) {
+                client = &live_clients[i];
+                break;
+            }
+            if ((client == NULL) && (live_clients[i].fd < 0)) {
+                client = &live_clients[i];
+            }
+        }
+        if (client == NULL) {
+            ESP_LOGW(TAG, "Live telemetry: no free client entry for socket %d", fd);
+            return ESP_FAIL;
+        }
+        uint32_t interval_ms = CONFIG_APP_LIVE_INTERVAL_MS;
+        char query[32];
+        char value[12];
+        if ((httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) &&
+            (httpd_query_key_value(query, "interval", value, sizeof(value)) == ESP_OK)) {
+            uint32_t requested = (uint32_t)strtoul(value, NULL, 10);
+            if (requested > interval_ms) {
+                interval_ms = (requested > 60000) ? 60000 : requested;
+            }
+        }
+        if (client->fd != fd) {
+            __atomic_fetch_add(&live_client_count, 1, __ATOMIC_RELAXED);
+        }
+        client->fd = fd;
+        client->synced = false;
+        client->interval_ms = interval_ms;
+        client->last_us = 0;
+        // The full state goes out with the next tick
+        return ESP_OK;
+    }
+
+    // The page does not send data frames, drop them
+    uint8_t buf[16];
+    httpd_ws_frame_t ws_frame = { 0 };
+    esp_err_t err = httpd_ws_recv_frame(req, &ws_frame, 0);
+    if ((err != ESP_OK) || (ws_frame.len == 0)) {
+        return err;
+    }
+    if (ws_frame.len > sizeof(buf)) {
+        return ESP_FAIL;
+    }
+    ws_frame.payload = buf;
+    return httpd_ws_recv_frame(req, &ws_frame, sizeof(buf));
+}
+#endif
+
+#if CONFIG_APP_METRICS_ENDPOINT
+// Prometheus text exposition at /metrics. The page is rendered into one static chunk buffer
+// which is sent whenever it fills, the numbers are formatted by hand: no heap, no snprintf and
+// a small stack, so a scrape costs the httpd task little more than the socket writes.
+#define PROM_CHUNK_SIZE         (1024)
+
+typedef struct {
+    httpd_req_t *req;
+    size_t len;
+    esp_err_t err;              // First send error, the rest of the page is dropped
+    bool labels;                // The sample being written has labels
+} prom_writer_t;
+
+// Used only in the httpd task, the snapshots of the stack tables are taken one after another
+static char prom_chunk[PROM_CHUNK_SIZE];
+static union {
+    uint32_t func_hits[MB_FUNC_CODE_COUNT];
+    mb_slave_tcp_client_t tcp_clients[CONFIG_FMB_TCP_PORT_MAX_CONN];
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+    mb_latency_hist_t latency[MB_LATENCY_FUNC_MAX];
+#endif
+#if CONFIG_APP_TASK_STATS
+    task_stat_t tasks[TASK_STATS_MAX];
+#endif
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+    mb_bus_slave_stats_t bus_slaves[CONFIG_FMB_SLAVE_BUS_ANALYZER_SLAVES];
+#endif
+} prom_scratch;
+
+// Counters of the serial line diagnostics, one metric each
+static const struct {
+    const char *name;
+    const char *help;
+    size_t offset;
+} prom_diag_counters[] = {
+    { "modbus_rtu_bus_messages_total", "Frames received on the RTU line, including bad ones",
+      offsetof(mb_slave_diag_counters_t, bus_messages) },
+    { "modbus_rtu_crc_errors_total", "Frames dropped for the length or CRC check",
+      offsetof(mb_slave_diag_counters_t, bus_comm_errors) },
+    { "modbus_rtu_exceptions_sent_total", "Exception responses sent on the RTU line",
+      offsetof(mb_slave_diag_counters_t, exceptions) },
+    { "modbus_rtu_server_messages_total", "Frames addressed to the slave, including broadcasts",
+      offsetof(mb_slave_diag_counters_t, server_messages) },
+    { "modbus_rtu_no_response_total", "Executed requests without a response",
+      offsetof(mb_slave_diag_counters_t, no_response) },
+    { "modbus_rtu_not_addressed_total", "Valid frames for other slaves",
+      offsetof(mb_slave_diag_counters_t, not_addressed) },
+    { "modbus_rtu_broadcasts_total", "Broadcast frames received",
+      offsetof(mb_slave_diag_counters_t, broadcasts) },
+    { "modbus_rtu_filtered_total", "Frames for other slaves dropped by the address filter",
+      offsetof(mb_slave_diag_counters_t, filtered) },
+    { "modbus_rtu_cached_responses_total", "Read requests answered with the stored response frame",
+      offsetof(mb_slave_diag_counters_t, cached) },
+};
+
+static const struct {
+    const char *type;
+    size_t offset;
+} prom_uart_errors[] = {
+    { "fifo_overflow", offsetof(mb_slave_diag_counters_t, fifo_overflows) },
+    { "buffer_full", offsetof(mb_slave_diag_counters_t, buffer_full) },
+    { "parity", offsetof(mb_slave_diag_counters_t, parity_errors) },
+    { "frame", offsetof(mb_slave_diag_counters_t, frame_errors) },
+};
+
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+// Counters of the slaves seen by the bus analyzer, one family each with the address label
+static const struct {
+    const char *name;
+    const char *type;
+    const char *help;
+    size_t offset;
+} prom_bus_slave_counters[] = {
+    { "modbus_bus_slave_requests_total", "counter", "Requests of the master for the slave",
+      offsetof(mb_bus_slave_stats_t, requests) },
+    { "modbus_bus_slave_responses_total", "counter", "Normal responses of the slave",
+      offsetof(mb_bus_slave_stats_t, responses) },
+    { "modbus_bus_slave_exceptions_total", "counter", "Exception responses of the slave",
+      offsetof(mb_bus_slave_stats_t, exceptions) },
+    { "modbus_bus_slave_timeouts_total", "counter", "Requests the slave did not answer",
+      offsetof(mb_bus_slave_stats_t, timeouts) },
+    { "modbus_bus_slave_bad_responses_total", "counter", "Damaged frames received as the response",
+      offsetof(mb_bus_slave_stats_t, bad_responses) },
+    { "modbus_bus_slave_response_max_microseconds", "gauge", "Longest response time of the slave",
+      offsetof(mb_bus_slave_stats_t, resp_max_us) },
+};
+#endif
+
+static void prom_flush(prom_writer_t *w)
+{
+    if ((w->len > 0) && (w->err == ESP_OK)) {
+        w->err = httpd_resp_send_chunk(w->req, prom_chunk, w->len);
+    }
+    w->len = 0;
+}
+
+static void prom_putc(prom_writer_t *w, char c)
+{
+    if (w->len == sizeof(prom_chunk)) {
+        prom_flush(w);
+    }
+    prom_chunk[w->len++] = c;
+}
+
+static void prom_puts(prom_writer_t *w, const char *s)
+{
+    while (*s != '\0') {
+        prom_putc(w, *s++);
+    }
+}
+
+static void prom_put_u64(prom_writer_t *w, uint64_t value)
+{
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value != 0);
+    while (n > 0) {
+        prom_putc(w, digits[--n]);
+    }
+}
+
+// Microseconds as seconds with six decimals
+static void prom_put_us(prom_writer_t *w, uint64_t us)
+{
+    prom_put_u64(w, us / 1000000);
+    prom_putc(w, '.');
+    uint32_t frac = (uint32_t)(us % 1000000);
+    for (uint32_t div = 100000; div > 0; div /= 10) {
+        prom_putc(w, (char)('0' + (frac / div) % 10));
+    }
+}
+
+// # HELP and # TYPE lines of a metric family
+static void prom_family(prom_writer_t *w, const char *name, const char *type, const char *help)
+{
+    prom_puts(w, "# HELP ");
+    prom_puts(w, name);
+    prom_putc(w, ' ');
+    prom_puts(w, help);
+    prom_puts(w, "\n# TYPE ");
+    prom_puts(w, name);
+    prom_putc(w, ' ');
+    prom_puts(w, type);
+    prom_putc(w, '\n');
+}
+
+// The sample is written as prom_name(), prom_label() for each label, prom_value()
+static void prom_name(prom_writer_t *w, const char *name)
+{
+    prom_puts(w, name);
+    w->labels = false;
+}
+
+static void prom_label_key(prom_writer_t *w, const char *key)
+{
+    prom_putc(w, w->labels ? ',' : '{');
+    prom_puts(w, key);
+    prom_puts(w, "=\"");
+    w->labels = true;
+}
+
+static void prom_label(prom_writer_t *w, const char *key, const char *value)
+{
+    prom_label_key(w, key);
+    for (; *value != '\0'; value++) {
+        if ((*value == '\\') || (*value == '"')) {
+            prom_putc(w, '\\');
+            prom_putc(w, *value);
+        } else if (*value == '\n') {
+            prom_puts(w, "\\n");
+        } else {
+            prom_putc(w, *value);
+        }
+    }
+    prom_putc(w, '"');
+}
+
+static void prom_label_u(prom_writer_t *w, const char *key, uint32_t value)
+{
+    prom_label_key(w, key);
+    prom_put_u64(w, value);
+    prom_putc(w, '"');
+}
+
+static void prom_value(prom_writer_t *w, uint64_t value)
+{
+    if (w->labels) {
+        prom_putc(w, '}');
+    }
+    prom_putc(w, ' ');
+    prom_put_u64(w, value);
+    prom_putc(w, '\n');
+}
+
+static void prom_metric(prom_writer_t *w, const char *name, const char *type, const char *help, uint64_t value)
+{
+    prom_family(w, name, type, help);
+    prom_name(w, name);
+    prom_value(w, value);
+}
+
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+// The log2 buckets as a cumulative histogram: bucket n >= 1 holds 2^(n-1) .. 2^n - 1 us,
+// the last bucket is open. No sum is kept by the stack, the maximum is a separate gauge.
+static void prom_latency(prom_writer_t *w, const mb_latency_hist_t *hist, size_t count)
+{
+    prom_family(w, "modbus_rtu_latency_seconds", "histogram",
+                "Serial slave request turnaround per function code and stage");
+    for (size_t i = 0; i < count; i++) {
+        for (int stage = 0; stage < MB_LATENCY_STAGE_COUNT; stage++) {
+            uint64_t cumulative = 0;
+            for (int b = 0; b < MB_LATENCY_BUCKETS; b++) {
+                cumulative += hist[i].buckets[stage][b];
+                prom_name(w, "modbus_rtu_latency_seconds_bucket");
+                prom_label_u(w, "fc", hist[i].func_code);
+                prom_label(w, "stage", latency_stage_names[stage]);
+                prom_label_key(w, "le");
+                if (b == MB_LATENCY_BUCKETS - 1) {
+                    prom_puts(w, "+Inf");
+                } else {
+                    prom_put_us(w, (1ULL << b) - 1);
+                }
+                prom_putc(w, '"');
+                prom_value(w, cumulative);
+            }
+            prom_name(w, "modbus_rtu_latency_seconds_count");
+            prom_label_u(w, "fc", hist[i].func_code);
+            prom_label(w, "stage", latency_stage_names[stage]);
+            prom_value(w, cumulative);
+        }
+    }
+    prom_family(w, "modbus_rtu_latency_max_microseconds", "gauge",
+                "Longest serial slave request turnaround per function code and stage");
+    for (size_t i = 0; i < count; i++) {
+        for (int stage = 0; stage < MB_LATENCY_STAGE_COUNT; stage++) {
+            prom_name(w, "modbus_rtu_latency_max_microseconds");
+            prom_label_u(w, "fc", hist[i].func_code);
+            prom_label(w, "stage", latency_stage_names[stage]);
+            prom_value(w, hist[i].max_us[stage]);
+        }
+    }
+}
+#endif
+
+// HTTP handler for the Prometheus metrics endpoint
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    prom_writer_t w = { .req = req, .len = 0, .err = ESP_OK, .labels = false };
+    httpd_resp_set_type(req, "text/plain; version=0.0.4; charset=utf-8");
+
+    prom_metric(&w, "esp_uptime_seconds", "gauge", "Time since boot",
+                (uint64_t)esp_timer_get_time() / 1000000);
+    prom_family(&w, "esp_cpu_load_percent", "gauge", "Load of the core over the last sampling period");
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        if (cpu_load_percent[core] != 0xFF) {
+            prom_name(&w, "esp_cpu_load_percent");
+            prom_label_u(&w, "core", core);
+            prom_value(&w, cpu_load_percent[core]);
+        }
+    }
+    prom_metric(&w, "esp_heap_free_bytes", "gauge", "Free heap", esp_get_free_heap_size());
+    prom_metric(&w, "esp_heap_min_free_bytes", "gauge", "Minimum free heap since boot",
+                esp_get_minimum_free_heap_size());
+
+    wifi_reg_params_t wifi_regs;
+    uint32_t wifi_seq;
+    do {
+        wifi_seq = mb_seqlock_read_begin(&wifi_reg_lock);
+        memcpy(&wifi_regs, &wifi_reg_params, sizeof(wifi_regs));
+    } while (mb_seqlock_read_retry(&wifi_reg_lock, wifi_seq));
+    prom_metric(&w, "esp_wifi_starts_total", "counter", "Starts of the WiFi AP since boot", wifi_regs.starts);
+    prom_metric(&w, "esp_wifi_start_heap_bytes", "gauge", "Heap taken by the last start of the WiFi AP and web server",
+                ((uint32_t)wifi_regs.cost_high << 16) | wifi_regs.cost_low);
+    prom_metric(&w, "esp_wifi_reclaimed_heap_bytes", "gauge", "Heap returned by the last stop of the WiFi AP",
+                ((uint32_t)wifi_regs.reclaimed_high << 16) | wifi_regs.reclaimed_low);
+
+    modbus_stats_t stats;
+    stats_snapshot(&stats);
+    prom_metric(&w, "modbus_register_reads_total", "counter", "Holding register reads notified to the application",
+                stats.read_requests);
+    prom_metric(&w, "modbus_register_writes_total", "counter", "Holding register writes notified to the application",
+                stats.write_requests);
+    prom_metric(&w, "modbus_app_errors_total", "counter", "Errors of the application request processing",
+                stats.errors);
+
+    // Requests per transport, the RTU counters are those of the slave address
+    mb_slave_addr_stats_t rtu_stats = { 0 };
+    mbc_slave_get_addr_stats(0, &rtu_stats);
+    mb_slave_tcp_stats_t tcp_stats;
+    bool tcp = (mbc_slave_get_tcp_stats(&tcp_stats) == ESP_OK);
+#if CONFIG_APP_RTU_BUS2
+    mb_slave_rtu_stats_t rtu2_stats;
+    bool rtu2 = (rtu_bus2_port >= 0) && (mbc_slave_get_rtu_stats(rtu_bus2_port, &rtu2_stats) == ESP_OK);
+#endif
+    prom_family(&w, "modbus_requests_total", "counter", "Executed requests per transport");
+    prom_name(&w, "modbus_requests_total");
+    prom_label(&w, "transport", "rtu");
+    prom_value(&w, rtu_stats.requests);
+    if (tcp) {
+        prom_name(&w, "modbus_requests_total");
+        prom_label(&w, "transport", "tcp");
+        prom_value(&w, tcp_stats.requests);
+    }
+#if CONFIG_APP_RTU_BUS2
+    if (rtu2) {
+        prom_name(&w, "modbus_requests_total");
+        prom_label(&w, "transport", "rtu2");
+        prom_value(&w, rtu2_stats.requests);
+    }
+#endif
+    prom_family(&w, "modbus_exceptions_total", "counter", "Exception responses per transport");
+    prom_name(&w, "modbus_exceptions_total");
+    prom_label(&w, "transport", "rtu");
+    prom_value(&w, rtu_stats.exceptions);
+    if (tcp) {
+        prom_name(&w, "modbus_exceptions_total");
+        prom_label(&w, "transport", "tcp");
+        prom_value(&w, tcp_stats.exceptions);
+    }
+#if CONFIG_APP_RTU_BUS2
+    if (rtu2) {
+        prom_name(&w, "modbus_exceptions_total");
+        prom_label(&w, "transport", "rtu2");
+        prom_value(&w, rtu2_stats.exceptions);
+    }
+#endif
+
+    if (mbc_slave_get_func_hits(prom_scratch.func_hits, MB_FUNC_CODE_COUNT) == ESP_OK) {
+        prom_family(&w, "modbus_function_requests_total", "counter", "Received requests per function code");
+        for (int fc = 0; fc < MB_FUNC_CODE_COUNT; fc++) {
+            if (prom_scratch.func_hits[fc] != 0) {
+                prom_name(&w, "modbus_function_requests_total");
+                prom_label_u(&w, "fc", fc);
+                prom_value(&w, prom_scratch.func_hits[fc]);
+            }
+        }
+    }
+
+    mb_slave_diag_counters_t diag = { 0 };
+    mbc_slave_get_diag_counters(&diag);
+    for (size_t i = 0; i < sizeof(prom_diag_counters) / sizeof(prom_diag_counters[0]); i++) {
+        prom_metric(&w, prom_diag_counters[i].name, "counter", prom_diag_counters[i].help,
+                    *(const uint32_t *)((const uint8_t *)&diag + prom_diag_counters[i].offset));
+    }
+    prom_family(&w, "modbus_rtu_uart_errors_total", "counter", "UART receive errors of the RTU line");
+    for (size_t i = 0; i < sizeof(prom_uart_errors) / sizeof(prom_uart_errors[0]); i++) {
+        prom_name(&w, "modbus_rtu_uart_errors_total");
+        prom_label(&w, "type", prom_uart_errors[i].type);
+        prom_value(&w, *(const uint32_t *)((const uint8_t *)&diag + prom_uart_errors[i].offset));
+    }
+#if CONFIG_APP_RTU_BUS2
+    if (rtu2) {
+        prom_metric(&w, "modbus_rtu2_crc_errors_total", "counter", "Bad frames on the second RTU bus",
+                    rtu2_stats.crc_errors);
+        prom_metric(&w, "modbus_rtu2_not_addressed_total", "counter", "Frames for other slaves on the second RTU bus",
+                    rtu2_stats.not_addressed);
+        prom_metric(&w, "modbus_rtu2_uart_errors_total", "counter", "UART errors of the second RTU bus",
+                    rtu2_stats.uart_errors);
+    }
+#endif
+
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+    mb_bus_stats_t bus;
+    size_t bus_count = 0;
+    mbc_slave_get_bus_stats(&bus, prom_scratch.bus_slaves, CONFIG_FMB_SLAVE_BUS_ANALYZER_SLAVES, &bus_count);
+    prom_metric(&w, "modbus_bus_frames_total", "counter", "Frames seen on the RTU bus by the analyzer",
+                bus.frames);
+    prom_metric(&w, "modbus_bus_bad_frames_total", "counter", "Frames with length or CRC error on the RTU bus",
+                bus.bad_frames);
+    prom_metric(&w, "modbus_bus_busy_microseconds_total", "counter",
+                "Wire time of the frames, the rate over 1e6 is the bus utilization", bus.busy_us);
+    for (size_t i = 0; i < sizeof(prom_bus_slave_counters) / sizeof(prom_bus_slave_counters[0]); i++) {
+        prom_family(&w, prom_bus_slave_counters[i].name, prom_bus_slave_counters[i].type,
+                    prom_bus_slave_counters[i].help);
+        for (size_t n = 0; n < bus_count; n++) {
+            prom_name(&w, prom_bus_slave_counters[i].name);
+            prom_label_u(&w, "addr", prom_scratch.bus_slaves[n].addr);
+            prom_value(&w, *(const uint32_t *)((const uint8_t *)&prom_scratch.bus_slaves[n]
+                                               + prom_bus_slave_counters[i].offset));
+        }
+    }
+    prom_family(&w, "modbus_bus_slave_response_microseconds", "summary",
+                "Time from the end of the request to the start of the response");
+    for (size_t n = 0; n < bus_count; n++) {
+        const mb_bus_slave_stats_t *slave = &prom_scratch.bus_slaves[n];
+        prom_name(&w, "modbus_bus_slave_response_microseconds_sum");
+        prom_label_u(&w, "addr", slave->addr);
+        prom_value(&w, slave->resp_total_us);
+        prom_name(&w, "modbus_bus_slave_response_microseconds_count");
+        prom_label_u(&w, "addr", slave->addr);
+        prom_value(&w, slave->responses + slave->exceptions);
+    }
+#endif
+
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+    size_t hist_count = 0;
+    if (mbc_slave_get_latency(prom_scratch.latency, MB_LATENCY_FUNC_MAX, &hist_count) == ESP_OK) {
+        prom_latency(&w, prom_scratch.latency, hist_count);
+    }
+#endif
+
+    if (tcp) {
+        prom_metric(&w, "modbus_tcp_errors_total", "counter", "Ignored TCP requests and send failures",
+                    tcp_stats.errors);
+        prom_metric(&w, "modbus_tcp_connects_total", "counter", "Accepted TCP connections", tcp_stats.connects);
+        prom_metric(&w, "modbus_tcp_forwarded_total", "counter", "TCP requests passed to the forward handler",
+                    tcp_stats.forwarded);
+        prom_metric(&w, "modbus_tcp_evictions_total", "counter", "Idle TCP clients disconnected for a new connection",
+                    tcp_stats.evictions);
+        prom_metric(&w, "modbus_tcp_throttled_total", "counter", "TCP requests rejected by the rate limits",
+                    tcp_stats.throttled);
+        prom_metric(&w, "modbus_tcp_worker_reads_total", "counter", "TCP reads executed by the read workers",
+                    tcp_stats.worker_reads);
+        prom_metric(&w, "modbus_tcp_clients", "gauge", "Connected TCP clients", tcp_stats.clients);
+        size_t client_count = 0;
+        mbc_slave_get_tcp_clients(prom_scratch.tcp_clients, CONFIG_FMB_TCP_PORT_MAX_CONN, &client_count);
+        prom_family(&w, "modbus_tcp_client_requests_total", "counter", "Requests of the connected TCP client");
+        for (size_t i = 0; i < client_count; i++) {
+            prom_name(&w, "modbus_tcp_client_requests_total");
+            prom_label(&w, "ip", prom_scratch.tcp_clients[i].ip_addr);
+            prom_value(&w, prom_scratch.tcp_clients[i].requests);
+        }
+        prom_family(&w, "modbus_tcp_client_throttled_total", "counter",
+                    "Requests of the connected TCP client rejected by the rate limit");
+        for (size_t i = 0; i < client_count; i++) {
+            prom_name(&w, "modbus_tcp_client_throttled_total");
+            prom_label(&w, "ip", prom_scratch.tcp_clients[i].ip_addr);
+            prom_value(&w, prom_scratch.tcp_clients[i].throttled);
+        }
+        prom_family(&w, "modbus_tcp_client_connected_seconds", "gauge", "Time since the TCP client connected");
+        for (size_t i = 0; i < client_count; i++) {
+            prom_name(&w, "modbus_tcp_client_connected_seconds");
+            prom_label(&w, "ip", prom_scratch.tcp_clients[i].ip_addr);
+            prom_value(&w, prom_scratch.tcp_clients[i].connected_ms / 1000);
+        }
+        prom_family(&w, "modbus_tcp_client_idle_seconds", "gauge", "Time since the last data of the TCP client");
+        for (size_t i = 0; i < client_count; i++) {
+            prom_name(&w, "modbus_tcp_client_idle_seconds");
+            prom_label(&w, "ip", prom_scratch.tcp_clients[i].ip_addr);
+            prom_value(&w, prom_scratch.tcp_clients[i].idle_ms / 1000);
+        }
+    }
+
+#if CONFIG_APP_MODBUS_GATEWAY
+    gateway_stats_t gw_stats;
+    gateway_get_stats(&gw_stats);
+    prom_metric(&w, "modbus_gateway_requests_total", "counter", "TCP requests bridged to the RTU bus", gw_stats.requests);
+    prom_metric(&w, "modbus_gateway_cache_hits_total", "counter", "Bridged requests answered from the cache",
+                gw_stats.cache_hits);
+    prom_metric(&w, "modbus_gateway_bus_requests_total", "counter", "Requests sent on the downstream RTU bus",
+                gw_stats.bus_requests);
+    prom_metric(&w, "modbus_gateway_exceptions_total", "counter", "Bridged requests answered with an exception",
+                gw_stats.exceptions);
+#endif
+
+#if CONFIG_APP_HEAP_STATS
+    heap_reg_params_t heap_regs;
+    uint32_t seq;
+    do {
+        seq = mb_seqlock_read_begin(&heap_reg_lock);
+        memcpy(&heap_regs, &heap_reg_params, sizeof(heap_regs));
+    } while (mb_seqlock_read_retry(&heap_reg_lock, seq));
+    prom_family(&w, "esp_heap_caps_free_bytes", "gauge", "Free bytes per heap capability");
+    for (int i = 0; i < HEAP_CAPS_COUNT; i++) {
+        prom_name(&w, "esp_heap_caps_free_bytes");
+        prom_label(&w, "caps", heap_caps_names[i]);
+        prom_value(&w, ((uint32_t)heap_regs.caps[i].free_high << 16) | heap_regs.caps[i].free_low);
+    }
+    prom_family(&w, "esp_heap_caps_largest_free_block_bytes", "gauge", "Largest free block per heap capability");
+    for (int i = 0; i < HEAP_CAPS_COUNT; i++) {
+        prom_name(&w, "esp_heap_caps_largest_free_block_bytes");
+        prom_label(&w, "caps", heap_caps_names[i]);
+        prom_value(&w, ((uint32_t)heap_regs.caps[i].largest_high << 16) | heap_regs.caps[i].largest_low);
+    }
+    prom_family(&w, "esp_heap_caps_fragmentation_percent", "gauge",
+                "100 - largest free block * 100 / free bytes per heap capability");
+    for (int i = 0; i < HEAP_CAPS_COUNT; i++) {
+        prom_name(&w, "esp_heap_caps_fragmentation_percent");
+        prom_label(&w, "caps", heap_caps_names[i]);
+        prom_value(&w, heap_regs.caps[i].frag_percent);
+    }
+    prom_metric(&w, "esp_heap_allocs_total", "counter", "Heap allocations",
+                __atomic_load_n(&heap_alloc_count, __ATOMIC_RELAXED));
+    prom_metric(&w, "esp_heap_frees_total", "counter", "Heap frees",
+                __atomic_load_n(&heap_free_count, __ATOMIC_RELAXED));
+    prom_metric(&w, "esp_heap_failed_allocs_total", "counter", "Failed heap allocations",
+                __atomic_load_n(&heap_failed_count, __ATOMIC_RELAXED));
+#endif
+
+#if CONFIG_APP_TASK_STATS
+    uint16_t task_count;
+    uint32_t task_seq;
+    do {
+        task_seq = mb_seqlock_read_begin(&task_reg_lock);
+        task_count = task_reg_params.count;
+        memcpy(prom_scratch.tasks, task_stats, task_count * sizeof(task_stat_t));
+    } while (mb_seqlock_read_retry(&task_reg_lock, task_seq));
+    prom_family(&w, "esp_task_cpu_permille", "gauge", "Run time of the task in the last period, 0.1 % of one core");
+    for (int i = 0; i < task_count; i++) {
+        prom_name(&w, "esp_task_cpu_permille");
+        prom_label(&w, "task", prom_scratch.tasks[i].name);
+        prom_value(&w, prom_scratch.tasks[i].cpu_permille);
+    }
+    prom_family(&w, "esp_task_stack_free_bytes", "gauge", "Stack high-water mark of the task");
+    for (int i = 0; i < task_count; i++) {
+        prom_name(&w, "esp_task_stack_free_bytes");
+        prom_label(&w, "task", prom_scratch.tasks[i].name);
+        prom_value(&w, prom_scratch.tasks[i].stack_free);
+    }
+#endif
+
+    persist_stats_t nvs_stats;
+    persist_get_stats(&nvs_stats);
+    prom_metric(&w, "esp_nvs_commits_total", "counter", "NVS commits of the application data", nvs_stats.commits);
+    prom_metric(&w, "esp_nvs_written_bytes_total", "counter", "Bytes of the application data written to NVS",
+                nvs_stats.bytes);
+    prom_metric(&w, "esp_nvs_write_failures_total", "counter", "Failed NVS writes", nvs_stats.failures);
+
+    prom_flush(&w);
+    if (w.err == ESP_OK) {
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return w.err;
+}
+#endif
+
+// HTTP handler for configuration API, runs in the HTTP worker task
+// The new settings are applied to the running Modbus stack between requests,
+// the master has to use them for the next request after the response.
+static esp_err_t config_handler(httpd_req_t *req)
+{
+    char buf[100];
+    int ret = httpd_req_get_url_query_str(req, buf, sizeof(buf));
+    
+    httpd_resp_set_type(req, "application/json");
+    if (ret == ESP_OK) {
+        char param[32];
+        app_config_t cfg = config_current();
+        int slave_id = cfg.slave_addr;
+        bool valid = true;
+        if (httpd_query_key_value(buf, "slave_id", param, sizeof(param)) == ESP_OK) {
+            slave_id = atoi(param);
+        }
+        if (httpd_query_key_value(buf, "baud", param, sizeof(param)) == ESP_OK) {
+            cfg.baudrate = strtoul(param, NULL, 10);
+            cfg.autobaud = 0;
+        }
+        if (httpd_query_key_value(buf, "parity", param, sizeof(param)) == ESP_OK) {
+            if (strcmp(param, "even") == 0) {
+                cfg.parity = UART_PARITY_EVEN;
+            } else if (strcmp(param, "odd") == 0) {
+                cfg.parity = UART_PARITY_ODD;
+            } else if (strcmp(param, "none") == 0) {
+                cfg.parity = UART_PARITY_DISABLE;
+            } else {
+                valid = false;
+            }
+            cfg.autobaud = 0;
+        }
+        if (httpd_query_key_value(buf, "stop_bits", param, sizeof(param)) == ESP_OK) {
+            cfg.stop_bits = (uint8_t)atoi(param);
+            valid = valid && ((cfg.stop_bits == 1) || (cfg.stop_bits == 2));
+        }
+        // An explicit baud rate or parity switches auto-baud off unless it is requested as well
+        if (httpd_query_key_value(buf, "autobaud", param, sizeof(param)) == ESP_OK) {
+            cfg.autobaud = (strcmp(param, "1") == 0);
+        }
+#if !CONFIG_APP_AUTOBAUD
+        cfg.autobaud = 0;
+#endif
+        if (valid && slave_id >= 1 && slave_id <= 247 && cfg.baudrate >= 1200 && cfg.baudrate <= 1000000) {
+            bool saved = false;
+            cfg.slave_addr = (uint8_t)slave_id;
+            if (apply_config(&cfg, true, &saved) != ESP_OK) {
+                httpd_resp_sendstr(req, "{\"success\":false,\"message\":\"Failed to apply configuration\"}");
+                return ESP_OK;
+            }
+            // Auto-baud restarts from the new settings
+            autobaud_state = AUTOBAUD_OFF;
+            if (saved) {
+                ESP_LOGI(TAG, "Configuration applied: address %d, baudrate %lu, parity %s",
+                         cfg.slave_addr, cfg.baudrate, parity_name(cfg.parity));
+                httpd_resp_sendstr(req, "{\"success\":true,\"message\":\"Configuration saved and applied.\"}");
+            } else {
+                httpd_resp_sendstr(req, "{\"success\":false,\"message\":\"Configuration applied but not saved\"}");
+            }
+            return ESP_OK;
+        }
+    }
     
+    httpd_resp_sendstr(req, "{\"success\":false,\"message\":\"Invalid configuration\"}");
+    return ESP_OK;
+}
+
+// HTTP worker: the slow handlers (reconfiguration with the NVS save, snapshot and pcap
+// generation) run in their own task at the httpd priority, the httpd task keeps serving the
+// other clients meanwhile. The worker runs one request at a time, so the static buffers of the
+// deferred handlers need no lock. A full queue is answered with 503.
+#define HTTPD_ASYNC_QUEUE_LEN   (4)
+
+typedef esp_err_t (*httpd_async_fn_t)(httpd_req_t *req);
+
+typedef struct {
+    httpd_req_t *req;           // Copy of the request made by httpd_req_async_handler_begin()
+    httpd_async_fn_t handler;
+} httpd_async_item_t;
+
+static StaticQueue_t httpd_async_queue_buf;
+static uint8_t httpd_async_queue_storage[HTTPD_ASYNC_QUEUE_LEN * sizeof(httpd_async_item_t)];
+static QueueHandle_t httpd_async_queue = NULL;
+// Held by the worker while it runs a request, the server is not stopped meanwhile
+static StaticSemaphore_t httpd_async_mutex_buf;
+static SemaphoreHandle_t httpd_async_mutex = NULL;
+static StaticSemaphore_t httpd_async_closed_buf;
+static SemaphoreHandle_t httpd_async_closed = NULL;
+static bool httpd_async_open = false;      // Changed in the httpd task only while the server runs
+
+static void httpd_async_task(void *arg)
+{
+    httpd_async_item_t item;
+    while (1) {
+        // Wait without the mutex, the item may be dropped by the close meanwhile
+        if (xQueuePeek(httpd_async_queue, &item, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        xSemaphoreTake(httpd_async_mutex, portMAX_DELAY);
+        if (xQueueReceive(httpd_async_queue, &item, 0) == pdTRUE) {
+            item.handler(item.req);
+            httpd_req_async_handler_complete(item.req);
+        }
+        xSemaphoreGive(httpd_async_mutex);
+    }
+}
+
+static void httpd_async_init(void)
+{
+    if (httpd_async_queue != NULL) {
+        return;
+    }
+    httpd_async_queue = xQueueCreateStatic(HTTPD_ASYNC_QUEUE_LEN, sizeof(httpd_async_item_t),
+                                           httpd_async_queue_storage, &httpd_async_queue_buf);
+    httpd_async_mutex = xSemaphoreCreateMutexStatic(&httpd_async_mutex_buf);
+    httpd_async_closed = xSemaphoreCreateBinaryStatic(&httpd_async_closed_buf);
+    if (APP_TASK_CREATE(httpd_async_task, "httpd_async", APP_HTTPD_STACK_SIZE, NULL,
+                        APP_HTTPD_PRIO, APP_HTTPD_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "HTTP worker task creation failed");
+    }
+}
+
+// Registered handler of the deferred URIs, user_ctx is the handler run by the worker
+static esp_err_t httpd_async_handler(httpd_req_t *req)
+{
+    httpd_async_item_t item = { .req = NULL, .handler = (httpd_async_fn_t)req->user_ctx };
+    if (__atomic_load_n(&httpd_async_open, __ATOMIC_ACQUIRE)
+        && (httpd_req_async_handler_begin(req, &item.req) == ESP_OK)) {
+        if (xQueueSend(httpd_async_queue, &item, 0) == pdTRUE) {
+            return ESP_OK;
+        }
+        httpd_req_async_handler_complete(item.req);
+    }
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    return httpd_resp_sendstr(req, "Busy, try again");
+}
+
+// Runs in the httpd task, no handler queues a request meanwhile
+static void httpd_async_close_work(void *arg)
+{
+    httpd_async_item_t item;
+    xSemaphoreTake(httpd_async_mutex, portMAX_DELAY);
+    __atomic_store_n(&httpd_async_open, false, __ATOMIC_RELEASE);
+    // The queued requests are dropped, httpd_stop() closes their sockets
+    while (xQueueReceive(httpd_async_queue, &item, 0) == pdTRUE) {
+        httpd_req_async_handler_complete(item.req);
+    }
+    xSemaphoreGive(httpd_async_mutex);
+    xSemaphoreGive(httpd_async_closed);
+}
+
+// Finish the running request and drop the queued ones before the server is stopped
+static void httpd_async_close(httpd_handle_t hd)
+{
+    if (httpd_queue_work(hd, httpd_async_close_work, NULL) == ESP_OK) {
+        xSemaphoreTake(httpd_async_closed, portMAX_DELAY);
+    }
+}
+
+// Start web server
+static httpd_handle_t start_webserver(void)
+{
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.lru_purge_enable = true;
+    config.core_id = APP_HTTPD_CORE;
+    config.task_priority = APP_HTTPD_PRIO;
+    config.stack_size = APP_HTTPD_STACK_SIZE;
+    config.max_open_sockets = CONFIG_APP_HTTPD_MAX_SOCKETS;
+    config.max_uri_handlers = 15;
+
+    httpd_async_init();
     ESP_LOGI(TAG, "Starting web server on port: %d", config.server_port);
     if (httpd_start(&server, &config) == ESP_OK) {
+        __atomic_store_n(&httpd_async_open, true, __ATOMIC_RELEASE);
         httpd_uri_t root_uri = {
             .uri = "/",
             .method = HTTP_GET,
@@ -426,169 +3052,1300 @@ static httpd_handle_t start_webserver(void)
         httpd_uri_t config_uri = {
             .uri = "/api/config",
             .method = HTTP_POST,
-            .handler = config_handler,
-            .user_ctx = NULL
+            .handler = httpd_async_handler,
+            .user_ctx = (void *)config_handler
         };
         httpd_register_uri_handler(server, &config_uri);
+
+        httpd_uri_t trace_uri = {
+            .uri = "/api/trace",
+            .method = HTTP_GET,
+            .handler = trace_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &trace_uri);
+
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+        httpd_uri_t latency_uri = {
+            .uri = "/api/latency",
+            .method = HTTP_GET,
+            .handler = latency_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &latency_uri);
+#endif
+
+#if CONFIG_APP_TASK_STATS
+        httpd_uri_t tasks_uri = {
+            .uri = "/api/tasks",
+            .method = HTTP_GET,
+            .handler = tasks_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &tasks_uri);
+#endif
+
+#if CONFIG_APP_HEAP_STATS
+        httpd_uri_t heap_uri = {
+            .uri = "/api/heap",
+            .method = HTTP_GET,
+            .handler = heap_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &heap_uri);
+#endif
+
+#if CONFIG_FMB_FRAME_TRACE
+        httpd_uri_t frames_uri = {
+            .uri = "/api/frames.pcap",
+            .method = HTTP_GET,
+            .handler = httpd_async_handler,
+            .user_ctx = (void *)frames_handler
+        };
+        httpd_register_uri_handler(server, &frames_uri);
+#endif
+
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
+        httpd_uri_t changes_uri = {
+            .uri = "/api/changes",
+            .method = HTTP_GET,
+            .handler = changes_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &changes_uri);
+#endif
+
+#if CONFIG_APP_BENCH_LOOPBACK
+        httpd_uri_t bench_uri = {
+            .uri = "/api/bench",
+            .method = HTTP_GET,
+            .handler = bench_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &bench_uri);
+#endif
+
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+        httpd_uri_t bus_uri = {
+            .uri = "/api/bus",
+            .method = HTTP_GET,
+            .handler = bus_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &bus_uri);
+#endif
+
+#if CONFIG_APP_METRICS_ENDPOINT
+        httpd_uri_t metrics_uri = {
+            .uri = "/metrics",
+            .method = HTTP_GET,
+            .handler = metrics_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server, &metrics_uri);
+#endif
+
+        httpd_uri_t snapshot_uri = {
+            .uri = "/api/snapshot.bin",
+            .method = HTTP_GET,
+            .handler = httpd_async_handler,
+            .user_ctx = (void *)snapshot_handler
+        };
+        httpd_register_uri_handler(server, &snapshot_uri);
+
+#if CONFIG_APP_LIVE_WS
+        httpd_uri_t live_uri = {
+            .uri = "/ws",
+            .method = HTTP_GET,
+            .handler = live_handler,
+            .user_ctx = NULL,
+            .is_websocket = true
+        };
+        httpd_register_uri_handler(server, &live_uri);
+#endif
         
         return server;
     }
-    
-    ESP_LOGE(TAG, "Error starting web server!");
-    return NULL;
+    
+    ESP_LOGE(TAG, "Error starting web server!");
+    return NULL;
+}
+
+// Stop web server
+static void stop_webserver(httpd_handle_t server)
+{
+    if (server) {
+        httpd_async_close(server);
+        httpd_stop(server);
+    }
+}
+
+// WiFi event handler
+static void wifi_event_handler(void* arg, esp_event_base_t event_base,
+                                int32_t event_id, void* event_data)
+{
+    if (event_id == WIFI_EVENT_AP_STACONNECTED) {
+        wifi_event_ap_staconnected_t* event = (wifi_event_ap_staconnected_t*) event_data;
+        wifi_connected_clients++;
+        ESP_LOGI(TAG, "Station " MACSTR " joined, AID=%d (Total clients: %u)",
+                 MAC2STR(event->mac), event->aid, wifi_connected_clients);
+    } else if (event_id == WIFI_EVENT_AP_STADISCONNECTED) {
+        wifi_event_ap_stadisconnected_t* event = (wifi_event_ap_stadisconnected_t*) event_data;
+        if (wifi_connected_clients > 0) {
+            wifi_connected_clients--;
+        }
+        ESP_LOGI(TAG, "Station " MACSTR " left, AID=%d (Total clients: %u)",
+                 MAC2STR(event->mac), event->aid, wifi_connected_clients);
+    }
+}
+
+// WiFi lifecycle: the AP, its netif, the default event loop and the web server exist only
+// while the configuration access is needed. The boot services task stays as the lifecycle
+// manager, the AP timer, the WiFi coil and the wake button send it the requests.
+#define WIFI_CTL_START          (1)
+#define WIFI_CTL_STOP           (2)
+#define WIFI_RECLAIM_DELAY_MS   (100)   // The idle task frees the stacks of the deleted tasks
+
+// The last request wins, a start restarts the AP timeout if the AP is already running
+static void wifi_request(uint32_t request)
+{
+    TaskHandle_t task = __atomic_load_n(&wifi_ctl_task, __ATOMIC_ACQUIRE);
+    if (task != NULL) {
+        xTaskNotify(task, request, eSetValueWithOverwrite);
+    }
+}
+
+// Timer callback to stop AP - the main loop blocks on Modbus notifications,
+// so the shutdown is done by the lifecycle manager
+// NOTE: Must be minimal - timer service task has small stack
+static void ap_timer_callback(TimerHandle_t xTimer)
+{
+    if (ap_active) {
+        wifi_request(WIFI_CTL_STOP);
+    }
+}
+
+#if CONFIG_APP_WIFI_WAKE_GPIO >= 0
+static void wifi_wake_isr(void *arg)
+{
+    TaskHandle_t task = __atomic_load_n(&wifi_ctl_task, __ATOMIC_ACQUIRE);
+    BaseType_t woken = pdFALSE;
+    if (task != NULL) {
+        xTaskNotifyFromISR(task, WIFI_CTL_START, eSetValueWithOverwrite, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+#endif
+
+// Start the AP and the web server, returns the heap taken by them
+static esp_err_t wifi_start(uint32_t *cost)
+{
+    uint32_t free_before = esp_get_free_heap_size();
+    wifi_config_t wifi_config = {
+        .ap = {
+            .ssid = WIFI_AP_SSID,
+            .ssid_len = strlen(WIFI_AP_SSID),
+            .channel = WIFI_AP_CHANNEL,
+            .password = WIFI_AP_PASSWORD,
+            .max_connection = WIFI_AP_MAX_CONN,
+            .authmode = WIFI_AUTH_WPA2_PSK,
+            .pmf_cfg = {
+                .required = false,
+            },
+        },
+    };
+
+    esp_err_t err = esp_event_loop_create_default();
+    if (err == ESP_OK) {
+        ap_netif = esp_netif_create_default_wifi_ap();
+        wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+        err = esp_wifi_init(&cfg);
+    }
+    if (err == ESP_OK) {
+        err = esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler,
+                                                  NULL, &wifi_event_instance);
+    }
+    if (err == ESP_OK) {
+        err = esp_wifi_set_mode(WIFI_MODE_AP);
+    }
+    if (err == ESP_OK) {
+        err = esp_wifi_set_config(WIFI_IF_AP, &wifi_config);
+    }
+    if (err == ESP_OK) {
+        err = esp_wifi_start();
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    ESP_LOGI(TAG, "WiFi AP started. SSID:%s Password:%s Channel:%d",
+             WIFI_AP_SSID, WIFI_AP_PASSWORD, WIFI_AP_CHANNEL);
+    ESP_LOGI(TAG, "Connect to http://192.168.4.1 to configure");
+    ESP_LOGI(TAG, "AP will automatically turn off in %d minutes", AP_TIMEOUT_MINUTES);
+
+    // Start web server
+    server = start_webserver();
+    ap_active = true;
+
+    uint32_t free_after = esp_get_free_heap_size();
+    *cost = (free_before > free_after) ? free_before - free_after : 0;
+    return ESP_OK;
+}
+
+// Release the web server, WiFi, the AP netif and the default event loop, also after a failed
+// start. Returns the heap given back. The Modbus TCP slave keeps its listening socket, it
+// accepts the clients again once the AP is back.
+static uint32_t wifi_stop(void)
+{
+    uint32_t free_before = esp_get_free_heap_size();
+
+    // Clear the handle first, the live telemetry sampler must not queue work to a stopped server
+    httpd_handle_t hd = __atomic_exchange_n(&server, NULL, __ATOMIC_SEQ_CST);
+    if (hd) {
+        stop_webserver(hd);
+    }
+    if (wifi_event_instance != NULL) {
+        esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_instance);
+        wifi_event_instance = NULL;
+    }
+    esp_wifi_stop();
+    esp_wifi_deinit();
+    if (ap_netif != NULL) {
+        esp_netif_destroy_default_wifi(ap_netif);
+        ap_netif = NULL;
+    }
+    esp_event_loop_delete_default();
+    // The WiFi status registers are bound to these variables
+    ap_active = false;
+    wifi_connected_clients = 0;
+
+    vTaskDelay(pdMS_TO_TICKS(WIFI_RECLAIM_DELAY_MS));
+    uint32_t free_after = esp_get_free_heap_size();
+    return (free_after > free_before) ? free_after - free_before : 0;
+}
+
+// Publish the state to the input registers 260-266 and the WiFi coil
+static void wifi_publish(bool started, uint32_t heap_bytes)
+{
+    mb_seqlock_write_begin(&wifi_reg_lock);
+    wifi_reg_params.state = ap_active ? 1 : 0;
+    if (started) {
+        wifi_reg_params.starts++;
+        wifi_reg_params.cost_low = (uint16_t)(heap_bytes & 0xFFFF);
+        wifi_reg_params.cost_high = (uint16_t)(heap_bytes >> 16);
+    } else {
+        wifi_reg_params.stops++;
+        wifi_reg_params.reclaimed_low = (uint16_t)(heap_bytes & 0xFFFF);
+        wifi_reg_params.reclaimed_high = (uint16_t)(heap_bytes >> 16);
+    }
+    mb_seqlock_write_end(&wifi_reg_lock);
+    // A write of the master is overwritten with the state once it is handled
+    wifi_coils[0] = ap_active ? 1 : 0;
+}
+
+static void wifi_handle_start(void)
+{
+    if (!ap_active) {
+        uint32_t cost = 0;
+        esp_err_t err = wifi_start(&cost);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "WiFi AP start failed: %s", esp_err_to_name(err));
+            (void)wifi_stop();
+            wifi_coils[0] = 0;
+            return;
+        }
+        wifi_publish(true, cost);
+        ESP_LOGI(TAG, "WiFi AP and web server use %lu bytes of heap", (unsigned long)cost);
+    }
+    xTimerReset(ap_timer, portMAX_DELAY);
+}
+
+static void wifi_handle_stop(void)
+{
+    if (ap_active) {
+        ESP_LOGI(TAG, "Processing WiFi AP shutdown...");
+        xTimerStop(ap_timer, portMAX_DELAY);
+        uint32_t reclaimed = wifi_stop();
+        wifi_publish(false, reclaimed);
+        ESP_LOGI(TAG, "WiFi AP stopped - device now running in Modbus-only mode");
+        ESP_LOGI(TAG, "Reclaimed %lu bytes of heap, %lu bytes free", (unsigned long)reclaimed,
+                 (unsigned long)esp_get_free_heap_size());
+        ESP_LOGI(TAG, "Write coil %d or press the wake button to start the AP again", MB_COIL_WIFI);
+    }
+    wifi_coils[0] = 0;
+}
+
+// Initialize the network stack once and start the AP, the timer stops it after the timeout
+static void wifi_init_softap(void)
+{
+    __atomic_store_n(&wifi_ctl_task, xTaskGetCurrentTaskHandle(), __ATOMIC_RELEASE);
+    ESP_ERROR_CHECK(esp_netif_init());
+
+    // Create the timer, it is restarted by each start request
+#ifdef CONFIG_APP_STATIC_ALLOCATION
+    static StaticTimer_t ap_timer_buf;
+    ap_timer = xTimerCreateStatic("ap_timer", pdMS_TO_TICKS(AP_TIMEOUT_MS), pdFALSE, NULL, ap_timer_callback,
+                                  &ap_timer_buf);
+#else
+    ap_timer = xTimerCreate("ap_timer", pdMS_TO_TICKS(AP_TIMEOUT_MS), pdFALSE, NULL, ap_timer_callback);
+#endif
+    configASSERT(ap_timer != NULL);
+
+#if CONFIG_APP_WIFI_WAKE_GPIO >= 0
+    // Wake button to ground, e.g. the BOOT button on GPIO0
+    const gpio_config_t wake_conf = {
+        .pin_bit_mask = 1ULL << CONFIG_APP_WIFI_WAKE_GPIO,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&wake_conf));
+    esp_err_t err = gpio_install_isr_service(0);
+    if ((err == ESP_OK) || (err == ESP_ERR_INVALID_STATE)) {
+        err = gpio_isr_handler_add(CONFIG_APP_WIFI_WAKE_GPIO, wifi_wake_isr, NULL);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "WiFi wake button not available: %s", esp_err_to_name(err));
+    }
+#endif
+
+    wifi_handle_start();
+}
+
+// Serve the start and stop requests for the rest of the run
+static void wifi_lifecycle_run(void)
+{
+    while (1) {
+        uint32_t request = 0;
+        if (xTaskNotifyWait(0, UINT32_MAX, &request, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (request == WIFI_CTL_START) {
+            wifi_handle_start();
+        } else if (request == WIFI_CTL_STOP) {
+            wifi_handle_stop();
+        }
+    }
+}
+
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+// Execution time budget of the register hooks, they run in the Modbus task
+#define HOLDING_REG_HOOK_BUDGET_US  50
+
+// Increment the sequential counter on each access to register 0 before the response is sent,
+// so the master reads the incremented value (runs in the Modbus task)
+static void holding_reg_access_hook(mb_param_type_t type, uint16_t reg_offset, uint16_t reg_count, void *arg)
+{
+    if (reg_offset == 0) {
+        HOLDING_REG_UPDATE(holding_reg_params.sequential_counter++);
+    }
+}
+
+static const mb_area_hooks_t holding_reg_hooks = {
+    .pre_read = holding_reg_access_hook,
+    .post_write = holding_reg_access_hook,
+    .arg = NULL,
+    .budget_us = HOLDING_REG_HOOK_BUDGET_US
+};
+#endif
+
+// Handle one parameter access notification from the Modbus controller
+// NOTE: Runs for every request - keep it short, never touch the Modbus UART here
+static void process_param_info(const mb_param_info_t *reg_info)
+{
+    if (boot_phase_us[BOOT_PHASE_FIRST_REQUEST] == 0) {
+        BOOT_PHASE_DONE(BOOT_PHASE_FIRST_REQUEST);
+    }
+    if (reg_info->type & (MB_EVENT_HOLDING_REG_WR | MB_EVENT_HOLDING_REG_RD)) {
+        // Update statistics
+        STATS_INC(total_requests);
+        if (reg_info->type & MB_READ_MASK) {
+            STATS_INC(read_requests);
+        } else {
+            STATS_INC(write_requests);
+        }
+
+#if !CONFIG_FMB_SLAVE_AREA_HOOKS
+        // Increment sequential counter on each access to register 0
+        if (reg_info->mb_offset == 0) {
+            HOLDING_REG_UPDATE(holding_reg_params.sequential_counter++);
+        }
+#endif
+#if MB_REG_RETAIN_COUNT > 0
+        // Writes of the retained registers are committed to NVS after the quiet period
+        if ((reg_info->type & MB_WRITE_MASK) && (reg_info->slave_addr == 0)
+            && (reg_info->mb_offset >= MB_REG_RETAIN_START)
+            && (reg_info->mb_offset < MB_REG_RETAIN_START + MB_REG_RETAIN_COUNT)) {
+            persist_mark_dirty(retain_reg_record, (reg_info->mb_offset - MB_REG_RETAIN_START) * sizeof(uint16_t),
+                               reg_info->size * sizeof(uint16_t));
+        }
+#endif
+    }
+
+    // The WiFi coil is the first coil of its area, the lifecycle manager sets it back to the state
+    if ((reg_info->type & MB_EVENT_COILS_WR) && (reg_info->slave_addr == 0)
+        && (reg_info->mb_offset == MB_COIL_WIFI)) {
+        wifi_request((wifi_coils[0] & 1) ? WIFI_CTL_START : WIFI_CTL_STOP);
+    }
+
+    // Record the request into the trace ring
+    trace_record_t *rec = &trace_ring[trace_head % APP_TRACE_RING_SIZE];
+    rec->time_stamp = reg_info->time_stamp;
+    rec->mb_offset = reg_info->mb_offset;
+    rec->size = (uint16_t)reg_info->size;
+    rec->type = (uint8_t)reg_info->type;
+    trace_head++;
+
+    if (verbose_log) {
+        ESP_LOGI(TAG, "HOLDING %s: Addr=%u, Size=%u, Event=0x%02x, Counter=%u",
+                 (reg_info->type & MB_READ_MASK) ? "READ" : "WRITE",
+                 (unsigned)reg_info->mb_offset,
+                 (unsigned)reg_info->size,
+                 (unsigned)reg_info->type,
+                 holding_reg_params.sequential_counter);
+    }
+}
+
+// Sampler: one esp_timer drives all periodic register updates
+typedef struct {
+    uint32_t period_ms;                 // Sampling period
+    void (*sample)(void);               // Sampling function, runs in esp_timer task
+    int64_t next_us;                    // Deadline of the next run
+} sampler_entry_t;
+
+static esp_timer_handle_t sampler_timer = NULL;
+
+// Update random number
+static void sample_random(void)
+{
+    uint16_t random_number = (uint16_t)(esp_random() % 65536);
+    HOLDING_REG_UPDATE(holding_reg_params.random_number = random_number);
+
+    ESP_LOGI(TAG, "Random number updated: %u", random_number);
+}
+
+// Periodic status output
+static void sample_status(void)
+{
+    modbus_stats_t stats;
+    stats_snapshot(&stats);
+    ESP_LOGI(TAG, "Alive - Requests: %lu, Reads: %lu, Writes: %lu",
+             stats.total_requests,
+             stats.read_requests,
+             stats.write_requests);
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        if (cpu_load_percent[core] != 0xFF) {
+            ESP_LOGI(TAG, "CPU%d load: %u%%", core, cpu_load_percent[core]);
+        }
+    }
+}
+
+// Per-core load from the run time of the idle tasks
+static void sample_cpu_load(void)
+{
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    static configRUN_TIME_COUNTER_TYPE last_idle[portNUM_PROCESSORS];
+    static int64_t last_us = 0;
+    int64_t now = esp_timer_get_time();
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        TaskStatus_t status;
+        vTaskGetInfo(xTaskGetIdleTaskHandleForCore(core), &status, pdFALSE, eRunning);
+        // The run time counter is clocked by esp_timer (us)
+        uint64_t idle = (uint64_t)(status.ulRunTimeCounter - last_idle[core]);
+        uint64_t period = (uint64_t)(now - last_us);
+        last_idle[core] = status.ulRunTimeCounter;
+        if ((last_us != 0) && (period != 0)) {
+            cpu_load_percent[core] = (idle >= period) ? 0 : (uint8_t)(100 - (idle * 100) / period);
+        }
+    }
+    last_us = now;
+#else
+    memset((void *)cpu_load_percent, 0xFF, sizeof(cpu_load_percent));
+#endif
 }
 
-// Stop web server
-static void stop_webserver(httpd_handle_t server)
+#if CONFIG_APP_TASK_STATS
+// Per-task run time since the previous sample and stack high-water marks
+static void sample_tasks(void)
 {
-    if (server) {
-        httpd_stop(server);
+    static TaskStatus_t status[TASK_STATS_MAX];
+    static struct {
+        TaskHandle_t handle;
+        configRUN_TIME_COUNTER_TYPE run_time;
+    } last[TASK_STATS_MAX];
+    static UBaseType_t last_count = 0;
+    static int64_t last_us = 0;
+    static bool warned = false;
+
+    int64_t now = esp_timer_get_time();
+    UBaseType_t total = uxTaskGetNumberOfTasks();
+    UBaseType_t count = uxTaskGetSystemState(status, TASK_STATS_MAX, NULL);
+    if ((count == 0) && !warned) {
+        ESP_LOGW(TAG, "Task stats: %u tasks, the table holds %d", (unsigned)total, TASK_STATS_MAX);
+        warned = true;
+    }
+    uint64_t period = (uint64_t)(now - last_us);
+
+    // Built aside and copied under the lock, the readers see only complete tables
+    static task_reg_params_t regs;
+    static task_stat_t stats[TASK_STATS_MAX];
+    memset(&regs, 0, sizeof(regs));
+    regs.count = (uint16_t)count;
+    regs.total = (uint16_t)total;
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *task = &status[i];
+        task_stat_t *stat = &stats[i];
+        // The tasks come in any order, the previous run time is looked up by the handle
+        uint64_t run = 0;
+        for (UBaseType_t j = 0; j < last_count; j++) {
+            if (last[j].handle == task->xHandle) {
+                run = (uint64_t)(task->ulRunTimeCounter - last[j].run_time);
+                break;
+            }
+        }
+        uint32_t permille = ((last_us != 0) && (period != 0)) ? (uint32_t)((run * 1000) / period) : 0;
+        snprintf(stat->name, sizeof(stat->name), "%s", task->pcTaskName);
+        stat->cpu_permille = (uint16_t)((permille > 1000) ? 1000 : permille);
+        stat->stack_free = (uint16_t)((task->usStackHighWaterMark > UINT16_MAX) ? UINT16_MAX
+                                                                                 : task->usStackHighWaterMark);
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        stat->core = (task->xCoreID == tskNO_AFFINITY) ? TASK_CORE_NONE : (uint16_t)task->xCoreID;
+#else
+        stat->core = TASK_CORE_NONE;
+#endif
+        stat->priority = (uint8_t)task->uxCurrentPriority;
+        stat->base_priority = (uint8_t)task->uxBasePriority;
+        stat->state = (uint8_t)task->eCurrentState;
+
+        for (int r = 0; r < TASK_STATS_NAME_REGS; r++) {
+            uint8_t hi = (uint8_t)stat->name[2 * r];
+            uint8_t lo = hi ? (uint8_t)stat->name[2 * r + 1] : 0;
+            regs.task[i].name[r] = (uint16_t)((hi << 8) | lo);
+            if (lo == 0) {
+                break;
+            }
+        }
+        regs.task[i].cpu_permille = stat->cpu_permille;
+        regs.task[i].stack_free = stat->stack_free;
+        regs.task[i].core = stat->core;
+        regs.task[i].priority = stat->priority;
+
+        last[i].handle = task->xHandle;
+        last[i].run_time = task->ulRunTimeCounter;
     }
+    last_count = count;
+    last_us = now;
+
+    mb_seqlock_write_begin(&task_reg_lock);
+    memcpy(&task_reg_params, &regs, sizeof(regs));
+    memcpy(task_stats, stats, count * sizeof(task_stat_t));
+    mb_seqlock_write_end(&task_reg_lock);
 }
+#endif
 
-// WiFi event handler
-static void wifi_event_handler(void* arg, esp_event_base_t event_base,
-                                int32_t event_id, void* event_data)
+#if CONFIG_APP_HEAP_STATS
+// Free bytes and largest free block per capability, allocations and frees per second
+static void sample_heap(void)
 {
-    if (event_id == WIFI_EVENT_AP_STACONNECTED) {
-        wifi_event_ap_staconnected_t* event = (wifi_event_ap_staconnected_t*) event_data;
-        wifi_connected_clients++;
-        holding_reg_params.wifi_clients = wifi_connected_clients;
-        ESP_LOGI(TAG, "Station " MACSTR " joined, AID=%d (Total clients: %u)",
-                 MAC2STR(event->mac), event->aid, wifi_connected_clients);
-    } else if (event_id == WIFI_EVENT_AP_STADISCONNECTED) {
-        wifi_event_ap_stadisconnected_t* event = (wifi_event_ap_stadisconnected_t*) event_data;
-        if (wifi_connected_clients > 0) {
-            wifi_connected_clients--;
+    static uint32_t last_allocs = 0;
+    static uint32_t last_frees = 0;
+    heap_reg_params_t regs;
+    for (int i = 0; i < HEAP_CAPS_COUNT; i++) {
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, heap_caps[i]);
+        regs.caps[i].free_low = (uint16_t)(info.total_free_bytes & 0xFFFF);
+        regs.caps[i].free_high = (uint16_t)(info.total_free_bytes >> 16);
+        regs.caps[i].largest_low = (uint16_t)(info.largest_free_block & 0xFFFF);
+        regs.caps[i].largest_high = (uint16_t)(info.largest_free_block >> 16);
+        regs.caps[i].min_free_kb = (uint16_t)(info.minimum_free_bytes / 1024);
+        regs.caps[i].frag_percent = (info.total_free_bytes == 0) ? 0 :
+            (uint16_t)(100 - (uint64_t)info.largest_free_block * 100 / info.total_free_bytes);
+    }
+    // The sampler period is one second
+    uint32_t allocs = __atomic_load_n(&heap_alloc_count, __ATOMIC_RELAXED);
+    uint32_t frees = __atomic_load_n(&heap_free_count, __ATOMIC_RELAXED);
+    regs.allocs_per_s = (uint16_t)(((allocs - last_allocs) > UINT16_MAX) ? UINT16_MAX : (allocs - last_allocs));
+    regs.frees_per_s = (uint16_t)(((frees - last_frees) > UINT16_MAX) ? UINT16_MAX : (frees - last_frees));
+    regs.failed = (uint16_t)__atomic_load_n(&heap_failed_count, __ATOMIC_RELAXED);
+    last_allocs = allocs;
+    last_frees = frees;
+
+    mb_seqlock_write_begin(&heap_reg_lock);
+    memcpy(&heap_reg_params, &regs, sizeof(regs));
+    mb_seqlock_write_end(&heap_reg_lock);
+}
+#endif
+
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+// Upper bound of the log2 bucket which holds the requested percentile
+static uint16_t latency_percentile(const uint32_t *buckets, uint32_t total, uint32_t percent, uint32_t max_us)
+{
+    uint32_t target = (uint32_t)(((uint64_t)total * percent + 99) / 100);
+    uint32_t sum = 0;
+    uint32_t upper = max_us;
+    for (int b = 0; b < MB_LATENCY_BUCKETS - 1; b++) {
+        sum += buckets[b];
+        if (sum >= target) {
+            upper = (b == 0) ? 0 : ((1UL << b) - 1);
+            break;
         }
-        holding_reg_params.wifi_clients = wifi_connected_clients;
-        ESP_LOGI(TAG, "Station " MACSTR " left, AID=%d (Total clients: %u)",
-                 MAC2STR(event->mac), event->aid, wifi_connected_clients);
     }
+    if (upper > max_us) {
+        upper = max_us;
+    }
+    return (uint16_t)((upper > UINT16_MAX) ? UINT16_MAX : upper);
 }
 
-// Timer callback to stop AP - just sets flag, actual shutdown done in main loop
-// NOTE: Must be minimal - timer service task has small stack
-static void ap_timer_callback(TimerHandle_t xTimer)
+// Summarize latency histograms of all function codes into input registers
+static void sample_latency(void)
 {
-    ap_shutdown_requested = true;
+    static mb_latency_hist_t hist[MB_LATENCY_FUNC_MAX];
+    static mb_latency_hist_t sum;
+    size_t count = 0;
+    if (mbc_slave_get_latency(hist, MB_LATENCY_FUNC_MAX, &count) != ESP_OK) {
+        return;
+    }
+    memset(&sum, 0, sizeof(sum));
+    for (size_t i = 0; i < count; i++) {
+        sum.count += hist[i].count;
+        for (int stage = 0; stage < MB_LATENCY_STAGE_COUNT; stage++) {
+            if (hist[i].max_us[stage] > sum.max_us[stage]) {
+                sum.max_us[stage] = hist[i].max_us[stage];
+            }
+            for (int b = 0; b < MB_LATENCY_BUCKETS; b++) {
+                sum.buckets[stage][b] += hist[i].buckets[stage][b];
+            }
+        }
+    }
+
+    input_reg_params_t regs;
+    regs.count_low = (uint16_t)(sum.count & 0xFFFF);
+    regs.count_high = (uint16_t)(sum.count >> 16);
+    for (int stage = 0; stage < MB_LATENCY_STAGE_COUNT; stage++) {
+        uint32_t max_us = sum.max_us[stage];
+        regs.stage[stage].p50_us = latency_percentile(sum.buckets[stage], sum.count, 50, max_us);
+        regs.stage[stage].p99_us = latency_percentile(sum.buckets[stage], sum.count, 99, max_us);
+        regs.stage[stage].max_us = (uint16_t)((max_us > UINT16_MAX) ? UINT16_MAX : max_us);
+    }
+    mb_seqlock_write_begin(&input_reg_lock);
+    memcpy(&input_reg_params, &regs, sizeof(regs));
+    mb_seqlock_write_end(&input_reg_lock);
 }
+#endif
 
-// Initialize and start WiFi AP
-static void wifi_init_softap(void)
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+static uint16_t bus_sat16(uint64_t value)
 {
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_ap();
+    return (uint16_t)((value > UINT16_MAX) ? UINT16_MAX : value);
+}
 
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+// Bus utilization and the response times of the slaves, the short term values from the deltas
+static void sample_bus(void)
+{
+    static mb_bus_slave_stats_t slaves[BUS_REG_SLAVES];
+    static uint64_t last_busy_us = 0;
+    static uint64_t last_elapsed_us = 0;
+    static uint32_t last_frames = 0;
+    mb_bus_stats_t stats;
+    size_t count = 0;
+    if (mbc_slave_get_bus_stats(&stats, slaves, BUS_REG_SLAVES, &count) != ESP_OK) {
+        return;
+    }
+    if ((stats.elapsed_us < last_elapsed_us) || (stats.busy_us < last_busy_us) || (stats.frames < last_frames)) {
+        // Restarted or reset since the last sample
+        last_busy_us = 0;
+        last_elapsed_us = 0;
+        last_frames = 0;
+    }
 
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        ESP_EVENT_ANY_ID,
-                                                        &wifi_event_handler,
-                                                        NULL,
-                                                        NULL));
+    bus_reg_params_t regs = { 0 };
+    uint64_t elapsed = stats.elapsed_us - last_elapsed_us;
+    regs.state = (stats.running ? BUS_STATE_RUNNING : 0) | (stats.listen_only ? BUS_STATE_LISTEN_ONLY : 0);
+    regs.util_last = elapsed ? bus_sat16((stats.busy_us - last_busy_us) * 10000 / elapsed) : 0;
+    regs.util_total = stats.elapsed_us ? bus_sat16(stats.busy_us * 10000 / stats.elapsed_us) : 0;
+    regs.frames_per_s = bus_sat16(stats.frames - last_frames);
+    regs.bad_frames = (uint16_t)stats.bad_frames;
+    regs.gap_min_us = bus_sat16(stats.gap_min_us);
+    regs.gap_avg_us = bus_sat16(stats.gaps ? (stats.gap_total_us / stats.gaps) : 0);
+    regs.gap_max_us = bus_sat16(stats.gap_max_us);
+    regs.slaves = stats.slaves;
+    regs.unmatched = (uint16_t)stats.unmatched;
+    regs.untracked = (uint16_t)stats.untracked;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t answered = slaves[i].responses + slaves[i].exceptions;
+        regs.slave[i].addr = slaves[i].addr;
+        regs.slave[i].resp_last = bus_sat16(slaves[i].resp_last_us / 100);
+        regs.slave[i].resp_avg = bus_sat16(answered ? (slaves[i].resp_total_us / answered / 100) : 0);
+        regs.slave[i].resp_max = bus_sat16(slaves[i].resp_max_us / 100);
+        regs.slave[i].requests = (uint16_t)slaves[i].requests;
+        regs.slave[i].timeouts = (uint16_t)slaves[i].timeouts;
+        regs.slave[i].exceptions = (uint16_t)slaves[i].exceptions;
+        regs.slave[i].bad_responses = (uint16_t)slaves[i].bad_responses;
+    }
+    last_busy_us = stats.busy_us;
+    last_elapsed_us = stats.elapsed_us;
+    last_frames = stats.frames;
 
-    wifi_config_t wifi_config = {
-        .ap = {
-            .ssid = WIFI_AP_SSID,
-            .ssid_len = strlen(WIFI_AP_SSID),
-            .channel = WIFI_AP_CHANNEL,
-            .password = WIFI_AP_PASSWORD,
-            .max_connection = WIFI_AP_MAX_CONN,
-            .authmode = WIFI_AUTH_WPA2_PSK,
-            .pmf_cfg = {
-                .required = false,
-            },
-        },
-    };
+    mb_seqlock_write_begin(&bus_reg_lock);
+    memcpy(&bus_reg_params, &regs, sizeof(regs));
+    mb_seqlock_write_end(&bus_reg_lock);
+}
+#endif
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
+#if MB_REG_HISTORY_COUNT > 0
+// Append the chip temperature to the history ring
+static void sample_history(void)
+{
+    if (history_regs == NULL) {
+        return;
+    }
+    uint16_t temperature;
+    get_temperature_reg(&temperature, 1, NULL);
+    mb_seqlock_write_begin(&history_reg_lock);
+    history_regs[1 + (history_samples % MB_REG_HISTORY_COUNT)] = temperature;
+    history_samples++;
+    history_regs[0] = (uint16_t)history_samples;
+    mb_seqlock_write_end(&history_reg_lock);
+}
+#endif
 
-    ESP_LOGI(TAG, "WiFi AP started. SSID:%s Password:%s Channel:%d",
-             WIFI_AP_SSID, WIFI_AP_PASSWORD, WIFI_AP_CHANNEL);
-    ESP_LOGI(TAG, "Connect to http://192.168.4.1 to configure");
-    ESP_LOGI(TAG, "AP will automatically turn off in %d minutes", AP_TIMEOUT_MINUTES);
+#if MB_REG_METRICS_RECORDS > 0
+// Saturate a count per interval to a 16-bit rate per minute
+static uint16_t metrics_per_min(uint32_t count, int64_t elapsed_us)
+{
+    uint64_t rate = (elapsed_us > 0) ? ((uint64_t)count * 60000000ULL / (uint64_t)elapsed_us) : 0;
+    return (uint16_t)((rate > UINT16_MAX) ? UINT16_MAX : rate);
+}
 
-    // Start web server
-    server = start_webserver();
-    ap_active = true;
+// Append a record to the metrics history ring
+static void sample_metrics(void)
+{
+    static int64_t last_us = 0;
+    static uint32_t last_requests = 0;
+    static uint32_t last_errors = 0;
+    if (metrics_regs == NULL) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    mb_slave_addr_stats_t rtu_stats = { 0 };
+    mbc_slave_get_addr_stats(0, &rtu_stats);
+    mb_slave_diag_counters_t diag = { 0 };
+    mbc_slave_get_diag_counters(&diag);
+    uint32_t requests = rtu_stats.requests;
+    uint32_t errors = rtu_stats.exceptions + diag.bus_comm_errors;
+    mb_slave_tcp_stats_t tcp_stats;
+    if (mbc_slave_get_tcp_stats(&tcp_stats) == ESP_OK) {
+        requests += tcp_stats.requests;
+        errors += tcp_stats.exceptions;
+    }
 
-    // Update WiFi status registers
-    holding_reg_params.wifi_enabled = 1;
-    holding_reg_params.wifi_clients = 0;
+    metrics_record_t rec;
+    uint32_t uptime = (uint32_t)(now / 1000000);
+    uint32_t free_heap_kb = esp_get_free_heap_size() / 1024;
+    rec.uptime_low = (uint16_t)(uptime & 0xFFFF);
+    rec.uptime_high = (uint16_t)(uptime >> 16);
+    rec.free_heap_kb = (uint16_t)((free_heap_kb > UINT16_MAX) ? UINT16_MAX : free_heap_kb);
+    rec.min_heap_kb = (uint16_t)(esp_get_minimum_free_heap_size() / 1024);
+    get_temperature_reg(&rec.temperature_x10, 1, NULL);
+    rec.requests_per_min = metrics_per_min(requests - last_requests, now - last_us);
+    rec.errors_per_min = metrics_per_min(errors - last_errors, now - last_us);
+    rec.cpu_load = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        if ((cpu_load_percent[core] != 0xFF) && (cpu_load_percent[core] > rec.cpu_load)) {
+            rec.cpu_load = cpu_load_percent[core];
+        }
+    }
+    last_us = now;
+    last_requests = requests;
+    last_errors = errors;
 
-    // Create and start timer
-    ap_timer = xTimerCreate("ap_timer", pdMS_TO_TICKS(AP_TIMEOUT_MS), pdFALSE, NULL, ap_timer_callback);
-    if (ap_timer != NULL) {
-        xTimerStart(ap_timer, 0);
+    mb_seqlock_write_begin(&metrics_reg_lock);
+    memcpy(metrics_regs + METRICS_HEADER_REGS + (metrics_records % MB_REG_METRICS_RECORDS) * METRICS_RECORD_REGS,
+           &rec, sizeof(rec));
+    metrics_records++;
+    metrics_regs[0] = (uint16_t)(metrics_records % METRICS_HEAD_WRAP);
+    mb_seqlock_write_end(&metrics_reg_lock);
+}
+#endif
+
+#if CONFIG_APP_LIVE_WS
+// Queue the live telemetry push to the httpd task while clients are connected
+static void sample_live(void)
+{
+    httpd_handle_t hd = __atomic_load_n(&server, __ATOMIC_SEQ_CST);
+    if ((hd == NULL) || (__atomic_load_n(&live_client_count, __ATOMIC_RELAXED) == 0) ||
+        __atomic_exchange_n(&live_push_queued, true, __ATOMIC_RELAXED)) {
+        return;
     }
+    if (httpd_queue_work(hd, live_push_work, hd) != ESP_OK) {
+        __atomic_store_n(&live_push_queued, false, __ATOMIC_RELAXED);
+    }
+}
+#endif
+
+#if CONFIG_APP_AUTOBAUD
+// Candidates of the auto-baud search, every rate is tried with the stored parity first
+static const uint32_t autobaud_rates[] = {
+    9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600, 4800, 2400, 1200
+};
+static const uint8_t autobaud_parities[] = { UART_PARITY_DISABLE, UART_PARITY_EVEN, UART_PARITY_ODD };
+
+#define AUTOBAUD_RATE_COUNT     (sizeof(autobaud_rates) / sizeof(autobaud_rates[0]))
+#define AUTOBAUD_PARITY_COUNT   (sizeof(autobaud_parities) / sizeof(autobaud_parities[0]))
+#define AUTOBAUD_CANDIDATES     (AUTOBAUD_RATE_COUNT * AUTOBAUD_PARITY_COUNT)
+
+static struct {
+    uint32_t valid_frames;      // Bus messages without the CRC and length errors
+    uint32_t errors;            // CRC, length, parity and framing errors
+    uint16_t candidate;         // Position in the rate x parity search
+    uint8_t parity_base;        // Index of the parity tried first
+} autobaud;
+
+static void autobaud_counters(uint32_t *valid_frames, uint32_t *errors)
+{
+    mb_slave_diag_counters_t diag = { 0 };
+    mbc_slave_get_diag_counters(&diag);
+    *valid_frames = diag.bus_messages - diag.bus_comm_errors;
+    *errors = diag.bus_comm_errors + diag.parity_errors + diag.frame_errors;
 }
 
-// Task to update random number periodically
-static void update_random_task(void *arg)
+// Compare the valid frames and the errors of the last window, step to the next
+// candidate settings on errors without any valid frame, keep them on a silent line
+static void sample_autobaud(void)
 {
-    while (1) {
-        vTaskDelay(pdMS_TO_TICKS(5000)); // Update every 5 seconds
-        
-        // Update the random number directly (no lock needed for simple assignment)
-        holding_reg_params.random_number = (uint16_t)(esp_random() % 65536);
-        
-        ESP_LOGI(TAG, "Random number updated: %u", holding_reg_params.random_number);
+    uint32_t valid_frames, errors;
+    autobaud_counters(&valid_frames, &errors);
+    uint32_t new_valid = valid_frames - autobaud.valid_frames;
+    uint32_t new_errors = errors - autobaud.errors;
+    autobaud.valid_frames = valid_frames;
+    autobaud.errors = errors;
+
+    app_config_t cfg = config_current();
+#if CONFIG_FMB_SERIAL_ADDR_FILTER
+    // The search needs the CRC errors of all frames, the filter drops the foreign ones unchecked
+    (void)mbc_slave_set_addr_filter(!cfg.autobaud);
+#endif
+    if (!cfg.autobaud) {
+        autobaud_state = AUTOBAUD_OFF;
+        return;
+    }
+    if (autobaud_state == AUTOBAUD_OFF) {
+        // Start from the stored settings, this window is only the baseline of the counters
+        autobaud.candidate = AUTOBAUD_CANDIDATES - 1;
+        autobaud.parity_base = 0;
+        for (size_t i = 0; i < AUTOBAUD_PARITY_COUNT; i++) {
+            if (autobaud_parities[i] == cfg.parity) {
+                autobaud.parity_base = (uint8_t)i;
+            }
+        }
+        for (size_t i = 0; i < AUTOBAUD_RATE_COUNT; i++) {
+            if (autobaud_rates[i] == cfg.baudrate) {
+                autobaud.candidate = (uint16_t)i;
+            }
+        }
+        autobaud_state = AUTOBAUD_SEARCH;
+        return;
+    }
+    if ((new_valid > 0) && (new_valid >= new_errors)) {
+        if (autobaud_state != AUTOBAUD_LOCKED) {
+            autobaud_state = AUTOBAUD_LOCKED;
+            ESP_LOGI(TAG, "Auto-baud locked: %lu baud, parity %s, %lu valid frames",
+                     cfg.baudrate, parity_name(cfg.parity), new_valid);
+            (void)apply_config(&cfg, true, NULL);
+        }
+        return;
+    }
+    if (new_errors == 0) {
+        return;
     }
+    autobaud_state = AUTOBAUD_SEARCH;
+    autobaud.candidate = (autobaud.candidate + 1) % AUTOBAUD_CANDIDATES;
+    cfg.baudrate = autobaud_rates[autobaud.candidate % AUTOBAUD_RATE_COUNT];
+    cfg.parity = autobaud_parities[(autobaud.parity_base + autobaud.candidate / AUTOBAUD_RATE_COUNT)
+                                   % AUTOBAUD_PARITY_COUNT];
+    ESP_LOGI(TAG, "Auto-baud: %lu errors without a valid frame, trying %lu baud, parity %s",
+             new_errors, cfg.baudrate, parity_name(cfg.parity));
+    if (apply_config(&cfg, false, NULL) != ESP_OK) {
+        ESP_LOGW(TAG, "Auto-baud: failed to apply %lu baud", cfg.baudrate);
+    }
+    // The characters broken by the switch are not counted in the next window
+    autobaud_counters(&autobaud.valid_frames, &autobaud.errors);
 }
+#endif
+
+static sampler_entry_t samplers[] = {
+    { .period_ms = 5000, .sample = sample_random },     // Register 1
+    { .period_ms = 5000, .sample = sample_status },     // Status log
+    { .period_ms = 1000, .sample = sample_cpu_load },   // Per-core load
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+    { .period_ms = 1000, .sample = sample_latency },    // Input registers 0-13
+#endif
+#if CONFIG_APP_TASK_STATS
+    { .period_ms = 1000, .sample = sample_tasks },      // Input registers 500+
+#endif
+#if CONFIG_APP_HEAP_STATS
+    { .period_ms = 1000, .sample = sample_heap },       // Input registers 400-420
+#endif
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+    { .period_ms = 1000, .sample = sample_bus },        // Input registers 100+
+#endif
+#if MB_REG_HISTORY_COUNT > 0
+    { .period_ms = CONFIG_APP_HISTORY_PERIOD_MS, .sample = sample_history }, // Input registers 1000+
+#endif
+#if MB_REG_METRICS_RECORDS > 0
+    { .period_ms = CONFIG_APP_METRICS_PERIOD_MS, .sample = sample_metrics }, // Input registers 22000+
+#endif
+#if CONFIG_APP_LIVE_WS
+    { .period_ms = LIVE_TICK_MS, .sample = sample_live },  // Web UI live telemetry
+#endif
+#if CONFIG_APP_AUTOBAUD
+    { .period_ms = CONFIG_APP_AUTOBAUD_WINDOW_MS, .sample = sample_autobaud },  // Serial settings search
+#endif
+};
 
-// Task to update uptime statistics
-static void uptime_task(void *arg)
+#define SAMPLER_COUNT   (sizeof(samplers) / sizeof(samplers[0]))
+
+// Run the samplers which are due and re-arm the timer for the nearest deadline
+static void sampler_timer_cb(void *arg)
 {
-    while (1) {
-        vTaskDelay(pdMS_TO_TICKS(1000)); // Update every second
-        modbus_stats.uptime_seconds++;
+    int64_t now = esp_timer_get_time();
+    int64_t next = INT64_MAX;
+    for (size_t i = 0; i < SAMPLER_COUNT; i++) {
+        sampler_entry_t *entry = &samplers[i];
+        if (entry->next_us <= now) {
+            entry->sample();
+            entry->next_us += (int64_t)entry->period_ms * 1000;
+            if (entry->next_us <= now) {
+                // Skip the missed periods rather than run back to back
+                entry->next_us = now + (int64_t)entry->period_ms * 1000;
+            }
+        }
+        if (entry->next_us < next) {
+            next = entry->next_us;
+        }
+    }
+    // No abort from the timer task, the samplers stop and the stack keeps serving the registers
+    esp_err_t err = esp_timer_start_once(sampler_timer, (uint64_t)(next - now));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Sampler timer re-arm failed, sampling stopped: %s", esp_err_to_name(err));
     }
 }
 
-// Task to update ESP32 metrics
-static void metrics_update_task(void *arg)
+static void sampler_start(void)
 {
-    while (1) {
-        vTaskDelay(pdMS_TO_TICKS(2000)); // Update every 2 seconds
+    const esp_timer_create_args_t timer_args = {
+        .callback = sampler_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "sampler",
+        .skip_unhandled_events = true
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &sampler_timer));
+
+    int64_t now = esp_timer_get_time();
+    for (size_t i = 0; i < SAMPLER_COUNT; i++) {
+        samplers[i].next_us = now + (int64_t)samplers[i].period_ms * 1000;
+    }
+    sampler_timer_cb(NULL);
+}
+
+#if CONFIG_FMB_CONTROLLER_FILE_RECORD_SUPPORT
+// File records (FC20/FC21): the history, metrics, configuration and frame trace blobs are read
+// by file and record number, a sub-request carries up to 121 records
+#define MB_FILE_HISTORY         (1) // Temperature history, the registers of input register 1000+
+#define MB_FILE_METRICS         (2) // Metrics history ring, the registers of input register 22000+
+#define MB_FILE_CONFIG          (3) // Serial configuration: baud rate (2), address, parity, stop bits, auto-baud
+#define MB_FILE_TRACE           (4) // Frame trace ring, FILE_TRACE_SLOT_REGS records per slot
+
+#define FILE_CONFIG_RECORDS     (6)
+#define FILE_RECORDS_MAX        (10000)
+
+// Area of registers served as a file under the lock of the area
+typedef struct {
+    const uint16_t *regs;
+    mb_seqlock_t *lock;
+} file_area_t;
 
-        // Update uptime (from modbus_stats)
-        holding_reg_params.uptime_seconds = (uint16_t)(modbus_stats.uptime_seconds & 0xFFFF);
+static void file_put_regs(const uint16_t *regs, uint16_t count, uint8_t *data)
+{
+    for (uint16_t i = 0; i < count; i++) {
+        data[2 * i] = (uint8_t)(regs[i] >> 8);
+        data[2 * i + 1] = (uint8_t)(regs[i] & 0xFF);
+    }
+}
 
-        // Update heap information
-        uint32_t free_heap = esp_get_free_heap_size();
-        uint32_t free_heap_kb = free_heap / 1024;
-        holding_reg_params.free_heap_kb_low = (uint16_t)(free_heap_kb & 0xFFFF);
-        holding_reg_params.free_heap_kb_high = (uint16_t)((free_heap_kb >> 16) & 0xFFFF);
+static esp_err_t file_read_area(uint16_t record, uint16_t count, uint8_t *data, void *arg)
+{
+    const file_area_t *area = (const file_area_t *)arg;
+    uint32_t seq;
+    do {
+        seq = mb_seqlock_read_begin(area->lock);
+        file_put_regs(area->regs + record, count, data);
+    } while (mb_seqlock_read_retry(area->lock, seq));
+    return ESP_OK;
+}
 
-        uint32_t min_heap = esp_get_minimum_free_heap_size();
-        holding_reg_params.min_heap_kb = (uint16_t)(min_heap / 1024);
+static esp_err_t file_read_config(uint16_t record, uint16_t count, uint8_t *data, void *arg)
+{
+    app_config_t cfg = config_current();
+    const uint16_t regs[FILE_CONFIG_RECORDS] = {
+        (uint16_t)(cfg.baudrate >> 16), (uint16_t)(cfg.baudrate & 0xFFFF), cfg.slave_addr, cfg.parity,
+        cfg.stop_bits ? cfg.stop_bits : 1, cfg.autobaud
+    };
+    file_put_regs(&regs[record], count, data);
+    return ESP_OK;
+}
 
-        // Update task count
-        holding_reg_params.task_count = (uint16_t)uxTaskGetNumberOfTasks();
+#if CONFIG_FMB_FRAME_TRACE
+// Slot of the trace ring: sequence number (2), time since boot in us (4), frame length,
+// flags in the high and captured bytes in the low byte, then the captured bytes. Empty slots read as 0.
+#define FILE_TRACE_HEADER_REGS  (8)
+#define FILE_TRACE_SLOT_REGS    (FILE_TRACE_HEADER_REGS + (CONFIG_FMB_FRAME_TRACE_BYTES + 1) / 2)
+#define FILE_TRACE_SLOTS        ((CONFIG_FMB_FRAME_TRACE_RING_SIZE * FILE_TRACE_SLOT_REGS <= FILE_RECORDS_MAX) \
+                                    ? CONFIG_FMB_FRAME_TRACE_RING_SIZE : (FILE_RECORDS_MAX / FILE_TRACE_SLOT_REGS))
 
-        // Update temperature
-        if (temp_sensor != NULL) {
-            float tsens_value = 0;
-            if (temperature_sensor_get_celsius(temp_sensor, &tsens_value) == ESP_OK) {
-                holding_reg_params.temperature_x10 = (uint16_t)(tsens_value * 10);
+static esp_err_t file_read_trace(uint16_t record, uint16_t count, uint8_t *data, void *arg)
+{
+    while (count > 0) {
+        uint16_t slot = record / FILE_TRACE_SLOT_REGS;
+        uint16_t first = record % FILE_TRACE_SLOT_REGS;
+        uint16_t n = FILE_TRACE_SLOT_REGS - first;
+        if (n > count) {
+            n = count;
+        }
+        uint16_t regs[FILE_TRACE_SLOT_REGS] = { 0 };
+        mb_frame_record_t rec;
+        if (mbc_slave_get_frame_slot(slot, &rec) == ESP_OK) {
+            uint64_t ts = (uint64_t)rec.timestamp_us;
+            regs[0] = (uint16_t)(rec.seq >> 16);
+            regs[1] = (uint16_t)(rec.seq & 0xFFFF);
+            regs[2] = (uint16_t)(ts >> 48);
+            regs[3] = (uint16_t)(ts >> 32);
+            regs[4] = (uint16_t)(ts >> 16);
+            regs[5] = (uint16_t)ts;
+            regs[6] = rec.length;
+            regs[7] = (uint16_t)((rec.flags << 8) | rec.captured);
+            for (uint16_t i = 0; i < rec.captured; i++) {
+                regs[FILE_TRACE_HEADER_REGS + i / 2] |= (i & 1) ? rec.data[i] : (uint16_t)(rec.data[i] << 8);
             }
         }
+        file_put_regs(&regs[first], n, data);
+        data += n * 2;
+        record += n;
+        count -= n;
+    }
+    return ESP_OK;
+}
+#endif
+
+// Register the files of the areas which could be allocated, the files are read only
+static void files_register(void)
+{
+#if MB_REG_HISTORY_COUNT > 0
+    static file_area_t history_file;
+    if (history_regs != NULL) {
+        history_file = (file_area_t){ .regs = history_regs, .lock = &history_reg_lock };
+        const mb_file_descriptor_t file = {
+            .records = MB_REG_HISTORY_COUNT + 1, .read = file_read_area, .arg = &history_file
+        };
+        ESP_ERROR_CHECK(mbc_slave_set_file(MB_FILE_HISTORY, &file));
+    }
+#endif
+#if MB_REG_METRICS_RECORDS > 0
+    static file_area_t metrics_file;
+    if (metrics_regs != NULL) {
+        metrics_file = (file_area_t){ .regs = metrics_regs, .lock = &metrics_reg_lock };
+        const mb_file_descriptor_t file = {
+            .records = METRICS_AREA_SIZE / sizeof(uint16_t), .read = file_read_area, .arg = &metrics_file
+        };
+        ESP_ERROR_CHECK(mbc_slave_set_file(MB_FILE_METRICS, &file));
+    }
+#endif
+    const mb_file_descriptor_t config_file = { .records = FILE_CONFIG_RECORDS, .read = file_read_config };
+    ESP_ERROR_CHECK(mbc_slave_set_file(MB_FILE_CONFIG, &config_file));
+#if CONFIG_FMB_FRAME_TRACE
+    const mb_file_descriptor_t trace_file = { .records = FILE_TRACE_SLOTS * FILE_TRACE_SLOT_REGS,
+                                              .read = file_read_trace };
+    ESP_ERROR_CHECK(mbc_slave_set_file(MB_FILE_TRACE, &trace_file));
+#endif
+}
+#endif
+
+#ifdef CONFIG_APP_RT_CORE_PROFILE
+// Start the Modbus stack on the Modbus core and notify the caller
+static void modbus_start_task(void *arg)
+{
+    ESP_ERROR_CHECK(mbc_slave_start());
+    xTaskNotifyGive((TaskHandle_t)arg);
+    vTaskDelete(NULL);
+}
+#endif
+
+// Bring up the services which are not needed to serve Modbus requests
+#if CONFIG_APP_MODBUS_TCP
+#if CONFIG_APP_MODBUS_RTU_ENCAP && CONFIG_APP_MODBUS_UDP
+#define MODBUS_TCP_MODE         MB_MODE_RTU_OVER_UDP
+#define MODBUS_TCP_MODE_NAME    "RTU over UDP"
+#elif CONFIG_APP_MODBUS_RTU_ENCAP
+#define MODBUS_TCP_MODE         MB_MODE_RTU_OVER_TCP
+#define MODBUS_TCP_MODE_NAME    "RTU over TCP"
+#elif CONFIG_APP_MODBUS_UDP
+#define MODBUS_TCP_MODE         MB_MODE_UDP
+#define MODBUS_TCP_MODE_NAME    "UDP"
+#else
+#define MODBUS_TCP_MODE         MB_MODE_TCP
+#define MODBUS_TCP_MODE_NAME    "TCP"
+#endif
+
+// Serve the register map to Modbus TCP clients on the AP interface
+static void start_modbus_tcp(void)
+{
+    mb_communication_info_t tcp_info = {
+        .ip_mode = MODBUS_TCP_MODE,
+        .ip_port = CONFIG_FMB_TCP_PORT_DEFAULT,
+        .ip_addr_type = MB_IPV4,
+        .ip_addr = NULL,
+        .ip_netif_ptr = (void *)ap_netif,
+        .slave_uid = app_config.slave_addr,
+    };
+    esp_err_t err = mbc_slave_start_tcp(&tcp_info);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Modbus %s slave started on port %d",
+                 MODBUS_TCP_MODE_NAME, CONFIG_FMB_TCP_PORT_DEFAULT);
+    } else {
+        ESP_LOGW(TAG, "Modbus TCP slave start failed: %s", esp_err_to_name(err));
+    }
+}
+#endif
+
+#if CONFIG_APP_MODBUS_GATEWAY
+// Bridge the TCP requests for other unit IDs to the RTU bus on the gateway UART
+static void start_gateway(void)
+{
+    const gateway_config_t gw_config = {
+        .uart_port = CONFIG_APP_GATEWAY_UART_PORT_NUM,
+        .baudrate = CONFIG_APP_GATEWAY_UART_BAUD_RATE,
+        .parity = UART_PARITY_DISABLE,
+        .txd_pin = CONFIG_APP_GATEWAY_UART_TXD,
+        .rxd_pin = CONFIG_APP_GATEWAY_UART_RXD,
+        .rts_pin = CONFIG_APP_GATEWAY_UART_RTS,
+        .cache_ttl_ms = CONFIG_APP_GATEWAY_CACHE_TTL_MS,
+    };
+    esp_err_t err = gateway_start(&gw_config);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Modbus gateway start failed: %s", esp_err_to_name(err));
+    }
+}
+#endif
 
-        // CPU frequency shouldn't change, but update just in case
-        holding_reg_params.cpu_freq_mhz = (uint16_t)(esp_clk_cpu_freq() / 1000000);
+#if CONFIG_APP_BENCH_LOOPBACK
+// Drive the slave from the serial master on the bench UART, wired or looped inside the chip
+static void start_bench(void)
+{
+    app_config_t config = config_current();
+    const bench_config_t bench_config = {
+        .uart_port = CONFIG_APP_BENCH_UART_PORT_NUM,
+        .baudrate = config.baudrate,
+        .parity = config.parity,
+        .stop_bits = config_stop_bits(&config),
+        .txd_pin = CONFIG_APP_BENCH_UART_TXD,
+#if CONFIG_APP_BENCH_INTERNAL_LOOP
+        .rxd_pin = -1,
+        .rts_pin = -1,
+        .loop_slave_port = MB_PORT_NUM,
+        .loop_slave_txd_pin = MB_UART_TXD,
+#else
+        .rxd_pin = CONFIG_APP_BENCH_UART_RXD,
+        .rts_pin = CONFIG_APP_BENCH_UART_RTS,
+        .loop_slave_port = -1,
+        .loop_slave_txd_pin = -1,
+#endif
+        .slave_addr = config.slave_addr,
+        .reg_start = MB_REG_BENCH_START,
+        .coil_start = MB_COIL_BENCH_START,
+        .core = APP_NET_CORE,
+    };
+    esp_err_t err = bench_start(&bench_config);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Loopback test start failed: %s", esp_err_to_name(err));
+    }
+}
+#endif
+
+#if CONFIG_APP_RTU_BUS2
+// Serve the second RS485 segment from its own port task, on the network core in the
+// real-time core profile so the two buses do not share a core
+static void start_rtu_bus2(void)
+{
+    mb_communication_info_t rtu_info = {
+        .mode = MB_MODE_RTU,
+        .slave_addr = CONFIG_APP_RTU_BUS2_SLAVE_ADDR,
+        .port = CONFIG_APP_RTU_BUS2_UART_PORT_NUM,
+        .baudrate = CONFIG_APP_RTU_BUS2_BAUD_RATE,
+        .parity = UART_PARITY_DISABLE,
+    };
+    uint8_t port_index = 0;
+    esp_err_t err = mbc_slave_start_rtu(&rtu_info, APP_NET_CORE, &port_index);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Second RTU bus start failed: %s", esp_err_to_name(err));
+        return;
     }
+    ESP_ERROR_CHECK(uart_set_pin(CONFIG_APP_RTU_BUS2_UART_PORT_NUM, CONFIG_APP_RTU_BUS2_TXD,
+                                 CONFIG_APP_RTU_BUS2_RXD,
+                                 (CONFIG_APP_RTU_BUS2_RTS >= 0) ? CONFIG_APP_RTU_BUS2_RTS : UART_PIN_NO_CHANGE,
+                                 UART_PIN_NO_CHANGE));
+    ESP_ERROR_CHECK(uart_set_mode(CONFIG_APP_RTU_BUS2_UART_PORT_NUM,
+                                  (CONFIG_APP_RTU_BUS2_RTS >= 0) ? UART_MODE_RS485_HALF_DUPLEX
+                                                                 : UART_MODE_RS485_COLLISION_DETECT));
+    rtu_bus2_port = port_index;
+    ESP_LOGI(TAG, "Second RTU bus on UART%d, slave address %d", CONFIG_APP_RTU_BUS2_UART_PORT_NUM,
+             CONFIG_APP_RTU_BUS2_SLAVE_ADDR);
+}
+#endif
+
+static void boot_services_task(void *arg)
+{
+    setup_temp_sensor();
+    BOOT_PHASE_DONE(BOOT_PHASE_SENSORS);
+
+    ESP_LOGI(TAG, "Starting WiFi AP for configuration...");
+    wifi_init_softap();
+    BOOT_PHASE_DONE(BOOT_PHASE_WIFI);
+
+#if CONFIG_APP_MODBUS_GATEWAY
+    start_gateway();
+#endif
+#if CONFIG_APP_BENCH_LOOPBACK
+    start_bench();
+#endif
+#if CONFIG_APP_MODBUS_TCP
+    start_modbus_tcp();
+#endif
+
+    ESP_LOGI(TAG, "Boot timings (ms): nvs %ld, modbus %ld, sensors %ld, wifi %ld",
+             BOOT_PHASE_MS(BOOT_PHASE_NVS), BOOT_PHASE_MS(BOOT_PHASE_MODBUS),
+             BOOT_PHASE_MS(BOOT_PHASE_SENSORS), BOOT_PHASE_MS(BOOT_PHASE_WIFI));
+
+    // The task stays as the WiFi lifecycle manager
+    wifi_lifecycle_run();
 }
 
 void app_main(void)
 {
-    mb_param_info_t reg_info;
+    mb_param_info_t reg_info[MB_PAR_INFO_BATCH_SIZE];
     mb_register_area_descriptor_t reg_area;
     
+#if CONFIG_APP_HEAP_STATS
+    // Count the failed allocations from the start
+    heap_caps_register_failed_alloc_callback(heap_alloc_failed);
+#if CONFIG_APP_HEAP_TRACE
+    if (heap_trace_window_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Heap trace window not available");
+    }
+#endif
+#endif
+
     // Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -597,8 +4354,20 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
     
-    // Load configuration
+#if CONFIG_APP_LIGHT_SLEEP
+    // Sleep whenever no task runs and the Modbus port does not hold its lock
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_APP_PM_MIN_FREQ_MHZ,
+        .light_sleep_enable = true
+    };
+    ESP_ERROR_CHECK(esp_pm_configure(&pm_config));
+#endif
+
+    // Start the deferred NVS persistence and load configuration
+    ESP_ERROR_CHECK(persist_init(APP_NVS_NAMESPACE, CONFIG_APP_PERSIST_QUIET_MS, APP_NET_CORE));
     load_config();
+    BOOT_PHASE_DONE(BOOT_PHASE_NVS);
     
     // Set log level
     esp_log_level_set(TAG, ESP_LOG_INFO);
@@ -606,8 +4375,9 @@ void app_main(void)
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "ESP32-S3 Modbus RTU Slave with HW-519");
     ESP_LOGI(TAG, "========================================");
-    ESP_LOGI(TAG, "Slave Address: %d", configured_slave_addr);
-    ESP_LOGI(TAG, "Baudrate: %d", MB_DEV_SPEED);
+    ESP_LOGI(TAG, "Slave Address: %d", app_config.slave_addr);
+    ESP_LOGI(TAG, "Baudrate: %lu, parity: %s, stop bits: %d, auto-baud: %s", app_config.baudrate,
+             parity_name(app_config.parity), (app_config.stop_bits == 2) ? 2 : 1, app_config.autobaud ? "on" : "off");
     ESP_LOGI(TAG, "UART Port: %d", MB_PORT_NUM);
     ESP_LOGI(TAG, "TX Pin: GPIO%d (HW-519 TXD)", MB_UART_TXD);
     ESP_LOGI(TAG, "RX Pin: GPIO%d (HW-519 RXD)", MB_UART_RXD);
@@ -621,9 +4391,9 @@ void app_main(void)
     mb_communication_info_t comm_info = { 0 };
     comm_info.port = MB_PORT_NUM;
     comm_info.mode = MB_MODE_RTU;
-    comm_info.baudrate = MB_DEV_SPEED;
-    comm_info.parity = MB_PARITY_NONE;
-    comm_info.slave_addr = configured_slave_addr;  // Use configured slave address
+    comm_info.baudrate = app_config.baudrate;
+    comm_info.parity = app_config.parity;
+    comm_info.slave_addr = app_config.slave_addr;  // Use configured slave address
 
     ESP_ERROR_CHECK(mbc_slave_setup(&comm_info));
 
@@ -634,26 +4404,216 @@ void app_main(void)
     reg_area.address = (void*)&holding_reg_params;
     reg_area.size = sizeof(holding_reg_params);
     ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor_lock(MB_PARAM_HOLDING, MB_REG_HOLDING_START, &holding_reg_lock));
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor_computed(MB_PARAM_HOLDING, MB_REG_HOLDING_START,
+                                                      computed_regs, COMPUTED_REG_COUNT));
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor_binding(MB_PARAM_HOLDING, MB_REG_HOLDING_START,
+                                                     holding_reg_bindings, HOLDING_REG_BINDING_COUNT));
+    size_t access_count = 0;
+    for (uint16_t i = 0; i < HOLDING_REG_COUNT; i++) {
+        if (holding_reg_info[i].writable) {
+            continue;
+        }
+        // Contiguous read only registers share one rule
+        mb_reg_access_t *last = (access_count > 0) ? &holding_reg_access[access_count - 1] : NULL;
+        if ((last != NULL) && ((last->reg_offset + last->reg_count) == i)) {
+            last->reg_count++;
+        } else {
+            holding_reg_access[access_count++] = (mb_reg_access_t){
+                .reg_offset = i, .reg_count = 1, .access = MB_ACCESS_READ
+            };
+        }
+    }
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor_access(MB_PARAM_HOLDING, MB_REG_HOLDING_START,
+                                                    holding_reg_access, access_count));
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor_hooks(MB_PARAM_HOLDING, MB_REG_HOLDING_START, &holding_reg_hooks));
+#endif
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor_tracking(MB_PARAM_HOLDING, MB_REG_HOLDING_START,
+                                                      holding_reg_deadband));
+#endif
+
+#if MB_REG_RETAIN_COUNT > 0
+    // Retained holding registers, the values are restored from NVS before the stack starts
+    if (persist_register("retain_regs", retain_reg_params, sizeof(retain_reg_params),
+                         &retain_reg_lock, &retain_reg_record) == ESP_OK) {
+        ESP_LOGI(TAG, "Restored %d retained registers from NVS", MB_REG_RETAIN_COUNT);
+    }
+    reg_area.type = MB_PARAM_HOLDING;
+    reg_area.start_offset = MB_REG_RETAIN_START;
+    reg_area.address = (void*)retain_reg_params;
+    reg_area.size = sizeof(retain_reg_params);
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor_lock(MB_PARAM_HOLDING, MB_REG_RETAIN_START, &retain_reg_lock));
+#endif
+
+    // WiFi AP enable coil and the lifecycle registers
+    reg_area.type = MB_PARAM_COIL;
+    reg_area.start_offset = MB_COIL_WIFI;
+    reg_area.address = (void*)wifi_coils;
+    reg_area.size = sizeof(wifi_coils);
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+    reg_area.type = MB_PARAM_INPUT;
+    reg_area.start_offset = MB_REG_WIFI_START;
+    reg_area.address = (void*)&wifi_reg_params;
+    reg_area.size = sizeof(wifi_reg_params);
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor_lock(MB_PARAM_INPUT, MB_REG_WIFI_START, &wifi_reg_lock));
+
+#if CONFIG_APP_BENCH_LOOPBACK
+    // Scratch holding registers and coils of the loopback test
+    reg_area.type = MB_PARAM_HOLDING;
+    reg_area.start_offset = MB_REG_BENCH_START;
+    reg_area.address = (void*)bench_holding_regs;
+    reg_area.size = sizeof(bench_holding_regs);
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+    reg_area.type = MB_PARAM_COIL;
+    reg_area.start_offset = MB_COIL_BENCH_START;
+    reg_area.address = (void*)bench_coils;
+    reg_area.size = sizeof(bench_coils);
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+#endif
+
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+    // Input registers with the turnaround latency summary
+    reg_area.type = MB_PARAM_INPUT;
+    reg_area.start_offset = MB_REG_INPUT_START;
+    reg_area.address = (void*)&input_reg_params;
+    reg_area.size = sizeof(input_reg_params);
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor_lock(MB_PARAM_INPUT, MB_REG_INPUT_START, &input_reg_lock));
+#endif
+
+#if CONFIG_APP_HEAP_STATS
+    // Input registers with the heap telemetry
+    reg_area.type = MB_PARAM_INPUT;
+    reg_area.start_offset = MB_REG_HEAP_START;
+    reg_area.address = (void*)&heap_reg_params;
+    reg_area.size = sizeof(heap_reg_params);
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor_lock(MB_PARAM_INPUT, MB_REG_HEAP_START, &heap_reg_lock));
+#endif
+
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+    // Input registers with the bus analyzer summary and the slave table
+    reg_area.type = MB_PARAM_INPUT;
+    reg_area.start_offset = MB_REG_BUS_START;
+    reg_area.address = (void*)&bus_reg_params;
+    reg_area.size = sizeof(bus_reg_params);
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor_lock(MB_PARAM_INPUT, MB_REG_BUS_START, &bus_reg_lock));
+#endif
+
+#if CONFIG_APP_TASK_STATS
+    // Input registers with the task table
+    reg_area.type = MB_PARAM_INPUT;
+    reg_area.start_offset = MB_REG_TASK_START;
+    reg_area.address = (void*)&task_reg_params;
+    reg_area.size = sizeof(task_reg_params);
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+    ESP_ERROR_CHECK(mbc_slave_set_descriptor_lock(MB_PARAM_INPUT, MB_REG_TASK_START, &task_reg_lock));
+#endif
+
+#if MB_REG_HISTORY_COUNT > 0
+    // Temperature history, the large maps go to PSRAM and the most read blocks are cached
+    history_regs = mbc_slave_alloc_area((MB_REG_HISTORY_COUNT + 1) * sizeof(uint16_t), MB_AREA_PLACE_AUTO);
+    if (history_regs != NULL) {
+        reg_area.type = MB_PARAM_INPUT;
+        reg_area.start_offset = MB_REG_HISTORY_START;
+        reg_area.address = (void*)history_regs;
+        reg_area.size = (MB_REG_HISTORY_COUNT + 1) * sizeof(uint16_t);
+        ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+        ESP_ERROR_CHECK(mbc_slave_set_descriptor_lock(MB_PARAM_INPUT, MB_REG_HISTORY_START, &history_reg_lock));
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+        ESP_ERROR_CHECK(mbc_slave_set_descriptor_cache(MB_PARAM_INPUT, MB_REG_HISTORY_START,
+                                                       CONFIG_APP_HISTORY_CACHE_SLOTS));
+#endif
+        ESP_LOGI(TAG, "Temperature history: %d registers in %s", MB_REG_HISTORY_COUNT,
+                 esp_ptr_external_ram(history_regs) ? "PSRAM" : "internal RAM");
+    } else {
+        ESP_LOGE(TAG, "No memory for %d history registers", MB_REG_HISTORY_COUNT);
+    }
+#endif
+
+#if MB_REG_METRICS_RECORDS > 0
+    // Metrics history ring, a master fetches the records in a few FC04 reads instead of polling
+    metrics_regs = mbc_slave_alloc_area(METRICS_AREA_SIZE, MB_AREA_PLACE_AUTO);
+    if (metrics_regs != NULL) {
+        const metrics_header_t header = {
+            .head = 0,
+            .capacity = MB_REG_METRICS_RECORDS,
+            .record_regs = METRICS_RECORD_REGS,
+            .period_s = CONFIG_APP_METRICS_PERIOD_MS / 1000,
+        };
+        memcpy(metrics_regs, &header, sizeof(header));
+        reg_area.type = MB_PARAM_INPUT;
+        reg_area.start_offset = MB_REG_METRICS_START;
+        reg_area.address = (void*)metrics_regs;
+        reg_area.size = METRICS_AREA_SIZE;
+        ESP_ERROR_CHECK(mbc_slave_set_descriptor(reg_area));
+        ESP_ERROR_CHECK(mbc_slave_set_descriptor_lock(MB_PARAM_INPUT, MB_REG_METRICS_START, &metrics_reg_lock));
+    } else {
+        ESP_LOGE(TAG, "No memory for %d metrics records", MB_REG_METRICS_RECORDS);
+    }
+#endif
+
+#if CONFIG_FMB_CONTROLLER_FILE_RECORD_SUPPORT
+    // The blobs above are also served as files for the bulk reads of FC20
+    files_register();
+#endif
+
+#if CONFIG_APP_FLASH_REGMAP
+    // Constant maps are read from the flash cache, the areas are described by the partition image
+    esp_err_t regmap_err = regmap_register("regmap");
+    if (regmap_err != ESP_OK) {
+        ESP_LOGW(TAG, "No register maps from flash (%s)", esp_err_to_name(regmap_err));
+    }
+#endif
+
+#if CONFIG_APP_BUS_ANALYZER
+    // Passive probe of the bus, the frames of all the slaves are analyzed from the first one
+    ESP_ERROR_CHECK(mbc_slave_set_bus_analyzer(true, BUS_LISTEN_ONLY));
+    ESP_LOGI(TAG, "Bus analyzer started%s", BUS_LISTEN_ONLY ? " in listen-only mode" : "");
+#endif
 
     // Initialize register values
     setup_reg_data();
 
-    // Start WiFi AP for configuration (after register initialization)
-    ESP_LOGI(TAG, "Starting WiFi AP for configuration...");
-    wifi_init_softap();
-    
-    // Start Modbus stack (this initializes UART)
+    // Start Modbus stack first, WiFi and sensors are started by the boot services task (this initializes UART)
+#ifdef CONFIG_APP_RT_CORE_PROFILE
+    // The UART interrupt is allocated on the core which installs the driver
+    APP_TASK_CREATE(modbus_start_task, "mb_start", 4096, xTaskGetCurrentTaskHandle(),
+                    uxTaskPriorityGet(NULL), APP_MODBUS_CORE);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    ESP_LOGI(TAG, "Modbus stack started on core %d, network on core %d", APP_MODBUS_CORE, APP_NET_CORE);
+#else
     ESP_ERROR_CHECK(mbc_slave_start());
+#endif
     
     // Set UART pin numbers (must be done after mbc_slave_start)
-    ESP_ERROR_CHECK(uart_set_pin(MB_PORT_NUM, MB_UART_TXD, MB_UART_RXD, 
-                                  UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
-    
-    // Use RS485 half-duplex mode with collision detection
-    // This mode adds timing that might help with automatic switching
-    ESP_ERROR_CHECK(uart_set_mode(MB_PORT_NUM, UART_MODE_RS485_COLLISION_DETECT));
-    
-    ESP_LOGI(TAG, "UART RS485 collision detect mode configured");
+    ESP_ERROR_CHECK(uart_set_pin(MB_PORT_NUM, MB_UART_TXD, MB_UART_RXD,
+                                  (MB_UART_RTS >= 0) ? MB_UART_RTS : UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+
+    if (MB_UART_RTS >= 0) {
+        // The UART drives RTS (DE/RE) around the transmission in hardware
+        ESP_ERROR_CHECK(uart_set_mode(MB_PORT_NUM, UART_MODE_RS485_HALF_DUPLEX));
+        ESP_LOGI(TAG, "UART RS485 half duplex mode configured, DE/RE on GPIO%d", MB_UART_RTS);
+    } else {
+        // Use RS485 half-duplex mode with collision detection
+        // This mode adds timing that might help with automatic switching
+        ESP_ERROR_CHECK(uart_set_mode(MB_PORT_NUM, UART_MODE_RS485_COLLISION_DETECT));
+        ESP_LOGI(TAG, "UART RS485 collision detect mode configured");
+    }
+    ESP_ERROR_CHECK(uart_set_stop_bits(MB_PORT_NUM, config_stop_bits(&app_config)));
+#if CONFIG_APP_RTU_BUS2
+    start_rtu_bus2();
+#endif
+    BOOT_PHASE_DONE(BOOT_PHASE_MODBUS);
+
+    // Temperature sensor, WiFi AP and web server are initialized in background
+    APP_TASK_CREATE(boot_services_task, "boot_svc", 6144, NULL,
+                    uxTaskPriorityGet(NULL), APP_NET_CORE);
     
     // Verify UART configuration
     ESP_LOGI(TAG, "Verifying UART configuration...");
@@ -668,143 +4628,32 @@ void app_main(void)
     
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "Modbus slave stack initialized successfully");
-    ESP_LOGI(TAG, "RESPONDING ONLY TO SLAVE ADDRESS: %d", configured_slave_addr);
+    ESP_LOGI(TAG, "Per-request logging: %s (trace at /api/trace)", verbose_log ? "on" : "off");
+    ESP_LOGI(TAG, "RESPONDING ONLY TO SLAVE ADDRESS: %d", app_config.slave_addr);
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "Modbus registers:");
-    ESP_LOGI(TAG, "  Address 0: Sequential Counter (Read/Write)");
-    ESP_LOGI(TAG, "  Address 1: Random Number (Read Only)");
-    ESP_LOGI(TAG, "  Address 2: Uptime Seconds (Read Only)");
-    ESP_LOGI(TAG, "  Address 3-4: Free Heap KB (Read Only, 32-bit)");
-    ESP_LOGI(TAG, "  Address 5: Min Free Heap KB (Read Only)");
-    ESP_LOGI(TAG, "  Address 6: CPU Frequency MHz (Read Only)");
-    ESP_LOGI(TAG, "  Address 7: Task Count (Read Only)");
-    ESP_LOGI(TAG, "  Address 8: Temperature x10 (Read Only)");
-    ESP_LOGI(TAG, "  Address 9: CPU Cores (Read Only)");
-    ESP_LOGI(TAG, "  Address 10: WiFi AP Enabled (Read Only)");
-    ESP_LOGI(TAG, "  Address 11: WiFi Connected Clients (Read Only)");
+    for (int i = 0; i < HOLDING_REG_COUNT; i++) {
+        ESP_LOGI(TAG, "  Address %d: %s (%s)", MB_REG_HOLDING_START + i, holding_reg_info[i].descr,
+                 holding_reg_info[i].writable ? "Read/Write" : "Read Only");
+    }
     ESP_LOGI(TAG, "Waiting for Modbus master requests...");
     
-    // Create task to update random number
-    xTaskCreate(update_random_task, "update_random", 2048, NULL, 5, NULL);
-
-    // Create task to update uptime
-    xTaskCreate(uptime_task, "uptime", 2048, NULL, 5, NULL);
-
-    // Create task to update ESP32 metrics
-    xTaskCreate(metrics_update_task, "metrics_update", 4096, NULL, 5, NULL);
-    
-    // Check UART buffer to see if data is arriving
-    size_t uart_buf_len;
-    uart_get_buffered_data_len(MB_PORT_NUM, &uart_buf_len);
-    ESP_LOGI(TAG, "UART buffer at startup: %d bytes", uart_buf_len);
+    // Start periodic register updates
+    sampler_start();
     
-    // Main event loop
-    ESP_LOGI(TAG, "Entering main Modbus polling loop...");
-    uint32_t poll_count = 0;
-    uint32_t last_uart_check = 0;
-    uint32_t last_status_log = 0;
-    
-    while (1) {
-        // Check UART buffer every 2 seconds to see if data is arriving
-        if (poll_count - last_uart_check > 200) {
-            uart_get_buffered_data_len(MB_PORT_NUM, &uart_buf_len);
-            if (uart_buf_len > 0) {
-                ESP_LOGW(TAG, "!!! UART has %d bytes in buffer - data is arriving !!!", uart_buf_len);
-                // Try to peek at the raw data
-                uint8_t peek_buf[32];
-                size_t read_len = (uart_buf_len < sizeof(peek_buf)) ? uart_buf_len : sizeof(peek_buf);
-                int peek_len = uart_read_bytes(MB_PORT_NUM, peek_buf, read_len, 0);
-                if (peek_len > 0) {
-                    ESP_LOGW(TAG, "Raw UART data received:");
-                    ESP_LOG_BUFFER_HEX_LEVEL(TAG, peek_buf, peek_len, ESP_LOG_WARN);
-                }
-            }
-            last_uart_check = poll_count;
-        }
-        
-        // Periodic status output every 5 seconds
-        if (poll_count - last_status_log > 500) {
-            ESP_LOGI(TAG, "Alive - Requests: %lu, Reads: %lu, Writes: %lu", 
-                     modbus_stats.total_requests, 
-                     modbus_stats.read_requests, 
-                     modbus_stats.write_requests);
-            last_status_log = poll_count;
-        }
-        
-        poll_count++;
-
-        // Check if WiFi AP shutdown was requested by timer
-        if (ap_shutdown_requested && ap_active) {
-            ESP_LOGI(TAG, "Processing WiFi AP shutdown...");
-
-            if (server) {
-                stop_webserver(server);
-                server = NULL;
-            }
-
-            esp_wifi_stop();
-            esp_wifi_deinit();
-            ap_active = false;
-            wifi_connected_clients = 0;
-            ap_shutdown_requested = false;
+    // Main event loop: block until the Modbus controller reports parameter access
+    // and process all queued notifications per wakeup
+    ESP_LOGI(TAG, "Entering main Modbus event loop...");
 
-            // Update WiFi status registers
-            holding_reg_params.wifi_enabled = 0;
-            holding_reg_params.wifi_clients = 0;
-
-            ESP_LOGI(TAG, "WiFi AP stopped - device now running in Modbus-only mode");
-            ESP_LOGI(TAG, "Register 10 (WiFi Enabled) set to: %u", holding_reg_params.wifi_enabled);
-            ESP_LOGI(TAG, "Register 11 (WiFi Clients) set to: %u", holding_reg_params.wifi_clients);
+    while (1) {
+        size_t count = 0;
+        if (mbc_slave_get_param_info_batch(reg_info, MB_PAR_INFO_BATCH_SIZE, &count,
+                                            MB_PAR_INFO_WAIT_FOREVER) != ESP_OK) {
+            continue;
         }
-
-        // Check for Modbus events
-        mb_event_group_t event = mbc_slave_check_event(MB_READ_WRITE_MASK);
-        
-        if (event != MB_EVENT_NO_EVENTS) {
-            ESP_LOGI(TAG, "=== Modbus Event Detected! Event: 0x%02x ===", (unsigned)event);
-            ESP_LOGI(TAG, "Current configured slave address: %d", configured_slave_addr);
-            // Get parameter information
-            ESP_ERROR_CHECK_WITHOUT_ABORT(mbc_slave_get_param_info(&reg_info, MB_PAR_INFO_GET_TOUT));
-            
-            const char* rw_str = (reg_info.type & MB_READ_MASK) ? "READ" : "WRITE";
-            
-            if (reg_info.type & (MB_EVENT_HOLDING_REG_WR | MB_EVENT_HOLDING_REG_RD)) {
-                // Update statistics
-                modbus_stats.total_requests++;
-                if (reg_info.type & MB_READ_MASK) {
-                    modbus_stats.read_requests++;
-                } else {
-                    modbus_stats.write_requests++;
-                }
-                
-                // Increment sequential counter on each access to register 0
-                if (reg_info.mb_offset == 0) {
-                    holding_reg_params.sequential_counter++;
-                    ESP_LOGI(TAG, "Sequential counter incremented to: %u", 
-                             holding_reg_params.sequential_counter);
-                }
-                
-                ESP_LOGI(TAG, "HOLDING %s: Addr=%u, Size=%u, Value[0]=%u, Value[1]=%u",
-                         rw_str,
-                         (unsigned)reg_info.mb_offset,
-                         (unsigned)reg_info.size,
-                         holding_reg_params.sequential_counter,
-                         holding_reg_params.random_number);
-                
-                // Check if response was actually sent
-                ESP_LOGI(TAG, "Response should have been sent on GPIO17 (TX)");
-                
-                // Read a few bytes from UART to see if there's raw data we can log
-                uint8_t peek_buf[32];
-                int peek_len = uart_read_bytes(MB_PORT_NUM, peek_buf, sizeof(peek_buf), 0);
-                if (peek_len > 0) {
-                    ESP_LOG_BUFFER_HEX(TAG, peek_buf, peek_len);
-                }
-            }
+        for (size_t i = 0; i < count; i++) {
+            process_param_info(&reg_info[i]);
         }
-        
-        // Small delay to prevent task watchdog
-        vTaskDelay(pdMS_TO_TICKS(10));
     }
     
     // Cleanup (never reached in this example)
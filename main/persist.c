@@ -0,0 +1,277 @@
+/*
+ * Deferred NVS persistence of the application data, see persist.h
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "persist.h"
+
+#define PERSIST_TASK_STACK_SIZE     (4096)
+#define PERSIST_TASK_PRIORITY       (2)
+#define PERSIST_DELAY_MAX_FACTOR    (10)    // Commit after quiet period * factor even if the writes continue
+
+typedef struct {
+    const char *key;        // NVS key
+    void *data;             // Live data
+    uint8_t *shadow;        // Last committed content
+    uint8_t *scratch;       // Consistent copy of the data for the commit
+    size_t size;            // Size of the data
+    mb_seqlock_t *lock;     // Sequence lock of the data, NULL if not shared
+    size_t dirty_start;     // Dirty byte range, empty if dirty_start >= dirty_end
+    size_t dirty_end;
+} persist_record_t;
+
+static const char *TAG = "PERSIST";
+
+static persist_record_t records[PERSIST_RECORDS_MAX];
+static size_t record_count = 0;
+static nvs_handle_t persist_nvs = 0;
+static uint32_t persist_quiet_ms = 0;
+static TaskHandle_t persist_task_handle = NULL;
+static SemaphoreHandle_t persist_commit_lock = NULL;
+static volatile bool persist_flush_request = false;
+static persist_stats_t persist_stats = { 0 };
+static portMUX_TYPE persist_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Get a consistent copy of the record data
+static void persist_snapshot(persist_record_t *rec)
+{
+    if (rec->lock == NULL) {
+        memcpy(rec->scratch, rec->data, rec->size);
+        return;
+    }
+    uint32_t seq;
+    do {
+        seq = mb_seqlock_read_begin(rec->lock);
+        memcpy(rec->scratch, rec->data, rec->size);
+    } while (mb_seqlock_read_retry(rec->lock, seq));
+}
+
+// Increment a write counter, the counters are read by persist_get_stats() from other tasks
+static void persist_count(uint32_t *counter)
+{
+    portENTER_CRITICAL(&persist_mux);
+    (*counter)++;
+    portEXIT_CRITICAL(&persist_mux);
+}
+
+// Add the byte range to the dirty range of the record and wake up the task
+static void persist_set_dirty(persist_record_t *rec, size_t start, size_t end, bool mark)
+{
+    portENTER_CRITICAL(&persist_mux);
+    if (start < rec->dirty_start) {
+        rec->dirty_start = start;
+    }
+    if (end > rec->dirty_end) {
+        rec->dirty_end = end;
+    }
+    if (mark) {
+        persist_stats.marks++;
+    }
+    portEXIT_CRITICAL(&persist_mux);
+    xTaskNotifyGive(persist_task_handle);
+}
+
+// Write the changed records to NVS with one commit
+static void persist_commit(void)
+{
+    bool written[PERSIST_RECORDS_MAX] = { false };
+    bool any_written = false;
+
+    xSemaphoreTake(persist_commit_lock, portMAX_DELAY);
+    for (size_t i = 0; i < record_count; i++) {
+        persist_record_t *rec = &records[i];
+        portENTER_CRITICAL(&persist_mux);
+        size_t start = rec->dirty_start;
+        size_t end = rec->dirty_end;
+        rec->dirty_start = rec->size;
+        rec->dirty_end = 0;
+        portEXIT_CRITICAL(&persist_mux);
+        if (start >= end) {
+            continue;
+        }
+        // The whole record is compared, the write notifications could be lost
+        persist_snapshot(rec);
+        if (memcmp(rec->scratch, rec->shadow, rec->size) == 0) {
+            persist_count(&persist_stats.skipped);
+            continue;
+        }
+        ESP_LOGD(TAG, "%s: commit, dirty bytes %u-%u", rec->key, (unsigned)start, (unsigned)(end - 1));
+        esp_err_t err = nvs_set_blob(persist_nvs, rec->key, rec->scratch, rec->size);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "%s: blob write failed: %s", rec->key, esp_err_to_name(err));
+            persist_count(&persist_stats.failures);
+            // Retried with the next commit, the failure is not a write of the application
+            persist_set_dirty(rec, start, end, false);
+            continue;
+        }
+        written[i] = true;
+        any_written = true;
+    }
+    if (any_written) {
+        esp_err_t err = nvs_commit(persist_nvs);
+        for (size_t i = 0; i < record_count; i++) {
+            if (!written[i]) {
+                continue;
+            }
+            if (err == ESP_OK) {
+                memcpy(records[i].shadow, records[i].scratch, records[i].size);
+                portENTER_CRITICAL(&persist_mux);
+                persist_stats.blob_writes++;
+                persist_stats.bytes += records[i].size;
+                portEXIT_CRITICAL(&persist_mux);
+            } else {
+                persist_set_dirty(&records[i], 0, records[i].size, false);
+            }
+        }
+        if (err == ESP_OK) {
+            persist_count(&persist_stats.commits);
+        } else {
+            ESP_LOGW(TAG, "NVS commit failed: %s", esp_err_to_name(err));
+            persist_count(&persist_stats.failures);
+        }
+    }
+    xSemaphoreGive(persist_commit_lock);
+}
+
+// Wait for the quiet period after the first write and commit
+static void persist_task(void *arg)
+{
+    const TickType_t quiet_ticks = pdMS_TO_TICKS(persist_quiet_ms) ? pdMS_TO_TICKS(persist_quiet_ms) : 1;
+    const int64_t delay_max_us = (int64_t)persist_quiet_ms * 1000 * PERSIST_DELAY_MAX_FACTOR;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t first_us = esp_timer_get_time();
+        while (!persist_flush_request && (ulTaskNotifyTake(pdTRUE, quiet_ticks) != 0)) {
+            if ((esp_timer_get_time() - first_us) >= delay_max_us) {
+                break;
+            }
+        }
+        persist_flush_request = false;
+        persist_commit();
+    }
+}
+
+// Commit the pending changes before the restart
+static void persist_shutdown(void)
+{
+    if (persist_commit_lock != NULL) {
+        persist_commit();
+    }
+}
+
+esp_err_t persist_init(const char *nvs_namespace, uint32_t quiet_ms, int core_id)
+{
+    esp_err_t err = nvs_open(nvs_namespace, NVS_READWRITE, &persist_nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS open failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    persist_quiet_ms = quiet_ms;
+#ifdef CONFIG_APP_STATIC_ALLOCATION
+    static StaticSemaphore_t persist_commit_lock_buf;
+    persist_commit_lock = xSemaphoreCreateMutexStatic(&persist_commit_lock_buf);
+#else
+    persist_commit_lock = xSemaphoreCreateMutex();
+#endif
+    if (persist_commit_lock == NULL) {
+        nvs_close(persist_nvs);
+        return ESP_ERR_NO_MEM;
+    }
+#ifdef CONFIG_APP_STATIC_ALLOCATION
+    static StaticTask_t persist_task_buf;
+    static StackType_t persist_task_stack[PERSIST_TASK_STACK_SIZE / sizeof(StackType_t)];
+    persist_task_handle = xTaskCreateStaticPinnedToCore(persist_task, "persist", PERSIST_TASK_STACK_SIZE, NULL,
+                                                        PERSIST_TASK_PRIORITY, persist_task_stack,
+                                                        &persist_task_buf, core_id);
+    if (persist_task_handle == NULL) {
+#else
+    if (xTaskCreatePinnedToCore(persist_task, "persist", PERSIST_TASK_STACK_SIZE, NULL,
+                                PERSIST_TASK_PRIORITY, &persist_task_handle, core_id) != pdPASS) {
+#endif
+        vSemaphoreDelete(persist_commit_lock);
+        persist_commit_lock = NULL;
+        nvs_close(persist_nvs);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_register_shutdown_handler(persist_shutdown);
+    return ESP_OK;
+}
+
+esp_err_t persist_register(const char *key, void *data, size_t size, mb_seqlock_t *lock, int *id)
+{
+    *id = PERSIST_RECORD_NONE;
+    if ((persist_commit_lock == NULL) || (record_count >= PERSIST_RECORDS_MAX) || (size == 0)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint8_t *buf = malloc(size * 2);
+    if (buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    size_t stored_size = 0;
+    esp_err_t err = nvs_get_blob(persist_nvs, key, NULL, &stored_size);
+    if ((err == ESP_OK) && (stored_size == size)) {
+        err = nvs_get_blob(persist_nvs, key, data, &stored_size);
+    } else if (err == ESP_OK) {
+        // The layout of the record has been changed, start with the defaults
+        ESP_LOGW(TAG, "%s: stored size %u, expected %u, ignored", key, (unsigned)stored_size, (unsigned)size);
+        err = ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (err != ESP_OK) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    persist_record_t *rec = &records[record_count];
+    rec->key = key;
+    rec->data = data;
+    rec->shadow = buf;
+    rec->scratch = buf + size;
+    rec->size = size;
+    rec->lock = lock;
+    rec->dirty_start = size;
+    rec->dirty_end = 0;
+    memcpy(rec->shadow, data, size);
+    *id = (int)record_count++;
+    return err;
+}
+
+void persist_mark_dirty(int id, size_t offset, size_t len)
+{
+    if ((id < 0) || (id >= (int)record_count) || (len == 0)) {
+        return;
+    }
+    persist_record_t *rec = &records[id];
+    if (offset >= rec->size) {
+        return;
+    }
+    size_t end = ((len > rec->size - offset) ? rec->size : (offset + len));
+    persist_set_dirty(rec, offset, end, true);
+}
+
+void persist_flush(void)
+{
+    if (persist_task_handle != NULL) {
+        persist_flush_request = true;
+        xTaskNotifyGive(persist_task_handle);
+    }
+}
+
+void persist_get_stats(persist_stats_t *stats)
+{
+    portENTER_CRITICAL(&persist_mux);
+    *stats = persist_stats;
+    stats->pending = 0;
+    for (size_t i = 0; i < record_count; i++) {
+        if (records[i].dirty_start < records[i].dirty_end) {
+            stats->pending++;
+        }
+    }
+    portEXIT_CRITICAL(&persist_mux);
+}
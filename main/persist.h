@@ -0,0 +1,72 @@
+/*
+ * Deferred NVS persistence of the application data
+ *
+ * The data is registered as records, each record is stored as one NVS blob.
+ * The writers only mark the changed byte range dirty, the persistence task
+ * coalesces the changes and commits them when there were no writes for the
+ * quiet period (or during a longer burst of writes after the maximum delay).
+ * The record is written to flash only if its content differs from the last
+ * committed copy.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "mbcontroller.h"
+
+#define PERSIST_RECORDS_MAX     (4)     // Maximum number of the records
+#define PERSIST_RECORD_NONE     (-1)    // Identifier of the record which is not registered
+
+// Write counters for the flash wear monitoring
+typedef struct {
+    uint32_t marks;         // Number of dirty marks (writes of the application data)
+    uint32_t commits;       // Number of NVS commits
+    uint32_t blob_writes;   // Number of record blobs written to NVS
+    uint32_t bytes;         // Number of bytes written to NVS
+    uint32_t skipped;       // Flushes of the records which were not changed, no flash write
+    uint32_t failures;      // Failed NVS writes
+    uint32_t pending;       // Number of the records waiting for commit
+} persist_stats_t;
+
+/**
+ * @brief Open the NVS namespace and start the persistence task
+ *
+ * @param nvs_namespace NVS namespace of the records
+ * @param quiet_ms      Time without writes before the commit
+ * @param core_id       Core of the persistence task or tskNO_AFFINITY
+ */
+esp_err_t persist_init(const char *nvs_namespace, uint32_t quiet_ms, int core_id);
+
+/**
+ * @brief Register the record and load its stored content into the data
+ *
+ * Has to be called before the data is shared with the other tasks.
+ *
+ * @param key   NVS key of the record (up to 15 characters)
+ * @param data  Data of the record, kept unchanged if the record is not stored
+ * @param size  Size of the data
+ * @param lock  Sequence lock of the data or NULL if the data is written only by the caller of persist_mark_dirty()
+ * @param[out] id Identifier of the record
+ *
+ * @return
+ *     - ESP_OK: The record is registered and the data is loaded
+ *     - ESP_ERR_NVS_NOT_FOUND: The record is registered, no stored content with the same size
+ *     - ESP_ERR_NO_MEM, ESP_ERR_INVALID_STATE: The record is not registered
+ */
+esp_err_t persist_register(const char *key, void *data, size_t size, mb_seqlock_t *lock, int *id);
+
+/**
+ * @brief Mark the byte range of the record changed (any task, cheap, does not access flash)
+ */
+void persist_mark_dirty(int id, size_t offset, size_t len);
+
+/**
+ * @brief Request the commit of the dirty records without waiting for the quiet period
+ */
+void persist_flush(void);
+
+/**
+ * @brief Get the write counters
+ */
+void persist_get_stats(persist_stats_t *stats);
@@ -0,0 +1,104 @@
+/*
+ * Read-only register maps served from a flash data partition, see regmap.h
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "sdkconfig.h"
+#include "mbcontroller.h"
+#include "regmap.h"
+
+#if CONFIG_APP_FLASH_REGMAP
+
+static const char *TAG = "REGMAP";
+
+// One read-only rule per holding area, the table has to stay valid while the area is used
+static mb_reg_access_t regmap_rules[REGMAP_AREAS_MAX];
+static esp_partition_mmap_handle_t regmap_handle;
+
+// Check the header and the bounds of the areas before anything is registered
+static bool regmap_check_image(const uint8_t *image, size_t part_size)
+{
+    const regmap_header_t *header = (const regmap_header_t *)image;
+    if ((header->magic != REGMAP_MAGIC) || (header->version != REGMAP_VERSION)
+        || (header->area_count == 0) || (header->area_count > REGMAP_AREAS_MAX)) {
+        return false;
+    }
+    size_t table_end = sizeof(regmap_header_t) + header->area_count * sizeof(regmap_area_t);
+    if ((header->size < table_end) || (header->size > part_size)) {
+        return false;
+    }
+    const regmap_area_t *areas = (const regmap_area_t *)(image + sizeof(regmap_header_t));
+    for (int i = 0; i < header->area_count; i++) {
+        const regmap_area_t *area = &areas[i];
+        if (((area->table != REGMAP_TABLE_HOLDING) && (area->table != REGMAP_TABLE_INPUT))
+            || (area->count == 0) || ((uint32_t)area->start + area->count > 0x10000)
+            || (area->offset & 1) || (area->offset < table_end)
+            || ((uint64_t)area->offset + area->count * sizeof(uint16_t) > header->size)) {
+            return false;
+        }
+    }
+    uint32_t crc = esp_rom_crc32_le(0, image + sizeof(regmap_header_t), header->size - sizeof(regmap_header_t));
+    return (crc == header->crc32);
+}
+
+esp_err_t regmap_register(const char *label)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY, label);
+    if (part == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    const void *mapped = NULL;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &mapped, &regmap_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    const uint8_t *image = (const uint8_t *)mapped;
+    if (!regmap_check_image(image, part->size)) {
+        esp_partition_munmap(regmap_handle);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    const regmap_header_t *header = (const regmap_header_t *)image;
+    const regmap_area_t *areas = (const regmap_area_t *)(image + sizeof(regmap_header_t));
+    int registered = 0;
+    uint32_t regs = 0;
+    for (int i = 0; i < header->area_count; i++) {
+        const regmap_area_t *area = &areas[i];
+        mb_param_type_t type = (area->table == REGMAP_TABLE_HOLDING) ? MB_PARAM_HOLDING : MB_PARAM_INPUT;
+        mb_register_area_descriptor_t reg_area = {
+            .type = type,
+            .start_offset = area->start,
+            .address = (void *)(image + area->offset),    // Never written, the writes are denied below
+            .size = area->count * sizeof(uint16_t),
+        };
+        // The data is stored in Modbus byte order and copied to the response as is
+        err = mbc_slave_set_descriptor_order(reg_area, MB_DESCR_ORDER_WIRE);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "%s registers %u-%u skipped (%s)", (type == MB_PARAM_HOLDING) ? "Holding" : "Input",
+                     area->start, area->start + area->count - 1, esp_err_to_name(err));
+            continue;
+        }
+        if (type == MB_PARAM_HOLDING) {
+            regmap_rules[i] = (mb_reg_access_t){ .reg_offset = 0, .reg_count = area->count, .access = MB_ACCESS_READ };
+            err = mbc_slave_set_descriptor_access(MB_PARAM_HOLDING, area->start, &regmap_rules[i], 1);
+            if (err != ESP_OK) {
+                // Not served without the read-only rule, the flash mapping can't be written
+                ESP_LOGW(TAG, "Holding registers %u-%u skipped, no read-only rule (%s)",
+                         area->start, area->start + area->count - 1, esp_err_to_name(err));
+                (void)mbc_slave_remove_descriptor(MB_PARAM_HOLDING, area->start);
+                continue;
+            }
+        }
+        registered++;
+        regs += area->count;
+    }
+    ESP_LOGI(TAG, "Partition %s: %d of %u areas, %lu registers mapped from flash at 0x%lx",
+             label, registered, header->area_count, (unsigned long)regs, (unsigned long)part->address);
+    return ESP_OK;
+}
+
+#endif
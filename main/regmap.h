@@ -0,0 +1,56 @@
+/*
+ * Read-only register maps served from a flash data partition
+ *
+ * Large constant maps (device nameplate, lookup tables, factory calibration)
+ * are generated at build time from main/regmap/regmap.csv by regmap_gen.py
+ * and written to their own data partition. At boot the partition is mapped
+ * into the data address space with esp_partition_mmap() and each area of the
+ * image is registered as a holding or input register area in wire order, so
+ * FC03/FC04 reads are copied straight from the flash cache and no RAM copy of
+ * the map is made. The holding areas get a read-only access rule.
+ *
+ * Image layout: regmap_header_t, area_count x regmap_area_t, register data.
+ * The header fields are little endian, the register data is big endian.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define REGMAP_MAGIC            (0x4D52424D)    // "MBRM"
+#define REGMAP_VERSION          (1)
+#define REGMAP_AREAS_MAX        (16)            // Maximum number of areas of the image
+#define REGMAP_TABLE_HOLDING    (3)             // Area table: holding registers (FC03)
+#define REGMAP_TABLE_INPUT      (4)             // Area table: input registers (FC04)
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;         // REGMAP_MAGIC
+    uint16_t version;       // REGMAP_VERSION
+    uint16_t area_count;    // Number of the area entries following the header
+    uint32_t size;          // Size of the image including the header
+    uint32_t crc32;         // CRC32 (zlib) of the image after the header
+} regmap_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t table;          // REGMAP_TABLE_HOLDING or REGMAP_TABLE_INPUT
+    uint8_t reserved;
+    uint16_t start;         // Modbus address of the first register
+    uint16_t count;         // Number of the registers
+    uint16_t reserved2;
+    uint32_t offset;        // Offset of the register data from the start of the image, even
+} regmap_area_t;
+
+/**
+ * @brief Map the register map partition and register its areas
+ *
+ * Has to be called after mbc_slave_setup() and before mbc_slave_start(). The partition stays
+ * mapped while the slave runs. An area which overlaps an area registered before is skipped.
+ *
+ * @param label Label of the data partition
+ *
+ * @return
+ *     - ESP_OK: The areas are registered
+ *     - ESP_ERR_NOT_FOUND: No partition with the label
+ *     - ESP_ERR_INVALID_VERSION: The partition holds no valid image (not flashed or damaged)
+ */
+esp_err_t regmap_register(const char *label);
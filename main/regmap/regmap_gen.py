@@ -0,0 +1,94 @@
+#!/usr/bin/env python
+# Generate the register map partition image (main/regmap.h) from the CSV schema.
+#
+# Columns: table,address,type,value
+#   table   holding or input
+#   address Modbus address of the first register of the value
+#   type    u16, i16, u32, i32, f32 (two registers, high word first),
+#           str:N (N registers, two ASCII characters per register, zero padded),
+#           or one of the numeric types with [] and space separated values (a table)
+# The header row, lines starting with # and empty lines are skipped. Contiguous registers of
+# the same table form one area, a gap starts the next area.
+import csv
+import struct
+import sys
+import zlib
+
+MAGIC = 0x4D52424D
+VERSION = 1
+AREAS_MAX = 16
+TABLES = {'holding': 3, 'input': 4}
+FORMATS = {'u16': '>H', 'i16': '>h', 'u32': '>I', 'i32': '>i', 'f32': '>f'}
+HEADER = struct.Struct('<IHHII')
+AREA = struct.Struct('<BBHHHI')
+
+
+def encode(kind, value, where):
+    if kind.startswith('str:'):
+        regs = int(kind[4:])
+        data = value.encode('ascii')
+        if len(data) > regs * 2:
+            sys.exit('%s: string longer than %d registers' % (where, regs))
+        return data.ljust(regs * 2, b'\0')
+    array = kind.endswith('[]')
+    fmt = FORMATS.get(kind[:-2] if array else kind)
+    if fmt is None:
+        sys.exit('%s: unknown type %s' % (where, kind))
+    values = value.split() if array else [value]
+    conv = float if fmt == '>f' else (lambda v: int(v, 0))
+    try:
+        return b''.join(struct.pack(fmt, conv(v)) for v in values)
+    except (ValueError, struct.error) as e:
+        sys.exit('%s: bad value %s (%s)' % (where, value, e))
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        sys.exit('usage: regmap_gen.py <schema.csv> <output.bin> [partition size]')
+    regs = {table: {} for table in TABLES.values()}
+    with open(sys.argv[1], newline='') as f:
+        rows = csv.reader(line for line in f if line.strip() and not line.lstrip().startswith('#'))
+        for num, row in enumerate(rows, 1):
+            where = '%s row %d' % (sys.argv[1], num)
+            if len(row) != 4:
+                sys.exit('%s: expected table,address,type,value' % where)
+            table, address, kind, value = (col.strip() for col in row)
+            if table == 'table':
+                continue
+            if table not in TABLES:
+                sys.exit('%s: unknown table %s' % (where, table))
+            data = encode(kind, value, where)
+            start = int(address, 0)
+            for i in range(len(data) // 2):
+                reg = start + i
+                if reg > 0xFFFF or reg in regs[TABLES[table]]:
+                    sys.exit('%s: register %d out of range or defined twice' % (where, reg))
+                regs[TABLES[table]][reg] = data[i * 2:i * 2 + 2]
+
+    # Contiguous runs of registers become the areas
+    areas = []
+    for table, table_regs in sorted(regs.items()):
+        for reg in sorted(table_regs):
+            if areas and areas[-1][0] == table and areas[-1][1] + len(areas[-1][2]) == reg:
+                areas[-1][2].append(table_regs[reg])
+            else:
+                areas.append((table, reg, [table_regs[reg]]))
+    if not areas or len(areas) > AREAS_MAX:
+        sys.exit('%s: %d areas, 1 to %d are supported' % (sys.argv[1], len(areas), AREAS_MAX))
+
+    offset = HEADER.size + AREA.size * len(areas)
+    table_data = b''
+    reg_data = b''
+    for table, start, data in areas:
+        table_data += AREA.pack(table, 0, start, len(data), 0, offset + len(reg_data))
+        reg_data += b''.join(data)
+    body = table_data + reg_data
+    image = HEADER.pack(MAGIC, VERSION, len(areas), HEADER.size + len(body), zlib.crc32(body)) + body
+    if len(sys.argv) == 4 and len(image) > int(sys.argv[3], 0):
+        sys.exit('%s: image of %d bytes does not fit the partition' % (sys.argv[1], len(image)))
+    with open(sys.argv[2], 'wb') as f:
+        f.write(image)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,15 @@
+/*
+ * Input register block written by the ULP sampling program, shared by the
+ * ULP-RISC-V program and the HP cores. All registers are 16-bit, so the
+ * Modbus stack never reads a half written value.
+ */
+#pragma once
+
+#define ENVSENSE_REG_TEMP           (0)     // Filtered chip temperature ×10, signed
+#define ENVSENSE_REG_TEMP_RAW       (1)     // Last chip temperature sample ×10, signed
+#define ENVSENSE_REG_TEMP_MIN       (2)     // Lowest and highest sample since the start ×10, signed
+#define ENVSENSE_REG_TEMP_MAX       (3)
+#define ENVSENSE_REG_ADC            (4)     // Filtered ADC1 reading (raw), 0 without ADC channel
+#define ENVSENSE_REG_ADC_RAW        (5)     // Last ADC1 reading (raw)
+#define ENVSENSE_REG_SAMPLES        (6)     // Number of the sampling runs (low word)
+#define ENVSENSE_REG_COUNT          (7)
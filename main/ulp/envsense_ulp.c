@@ -0,0 +1,80 @@
+/*
+ * ULP-RISC-V sampling program, see envsense.h
+ *
+ * Runs once per ULP timer wakeup: reads the temperature sensor and the
+ * optional ADC1 channel, filters the samples with an exponential moving
+ * average and writes the input register block. The HP cores are not woken up.
+ */
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "ulp_riscv_utils.h"
+#include "ulp_riscv_register_ops.h"
+#include "soc/sens_reg.h"
+#if CONFIG_APP_ULP_ADC_CHANNEL >= 0
+#include "ulp_riscv_adc_ulp_core.h"
+#endif
+#include "envsense_regs.h"
+
+#define FILTER_SHIFT    (CONFIG_APP_ULP_FILTER_SHIFT)   // Filter weight of a new sample 1 / 2^FILTER_SHIFT
+
+// Calibration set by the HP core before the start: temperature ×10 = (raw * slope + offset) / 1000
+int32_t tsens_slope = 0;
+int32_t tsens_offset = 0;
+
+// Input register block, served by the Modbus stack from RTC memory
+volatile uint16_t env_regs[ENVSENSE_REG_COUNT];
+
+// Filter states (value << FILTER_SHIFT) and counters, kept in RTC memory between the wakeups
+static int32_t temp_state;
+static int32_t adc_state;
+static int32_t temp_min;
+static int32_t temp_max;
+static uint32_t samples;
+
+static uint32_t tsens_read_raw(void)
+{
+    REG_SET_BIT(SENS_SAR_TSENS_CTRL_REG, SENS_TSENS_DUMP_OUT);
+    while (!REG_GET_FIELD(SENS_SAR_TSENS_CTRL_REG, SENS_TSENS_READY)) {
+    }
+    uint32_t raw = REG_GET_FIELD(SENS_SAR_TSENS_CTRL_REG, SENS_TSENS_OUT);
+    REG_CLR_BIT(SENS_SAR_TSENS_CTRL_REG, SENS_TSENS_DUMP_OUT);
+    return raw;
+}
+
+static int32_t filter(int32_t *state, int32_t sample)
+{
+    if (samples == 0) {
+        *state = sample * (1 << FILTER_SHIFT);
+    } else {
+        *state += sample - (*state >> FILTER_SHIFT);
+    }
+    return *state >> FILTER_SHIFT;
+}
+
+int main(void)
+{
+    int32_t temp = ((int32_t)tsens_read_raw() * tsens_slope + tsens_offset) / 1000;
+    if ((samples == 0) || (temp < temp_min)) {
+        temp_min = temp;
+    }
+    if ((samples == 0) || (temp > temp_max)) {
+        temp_max = temp;
+    }
+    env_regs[ENVSENSE_REG_TEMP] = (uint16_t)filter(&temp_state, temp);
+    env_regs[ENVSENSE_REG_TEMP_RAW] = (uint16_t)temp;
+    env_regs[ENVSENSE_REG_TEMP_MIN] = (uint16_t)temp_min;
+    env_regs[ENVSENSE_REG_TEMP_MAX] = (uint16_t)temp_max;
+#if CONFIG_APP_ULP_ADC_CHANNEL >= 0
+    int32_t adc = ulp_riscv_adc_read_channel(ADC_UNIT_1, CONFIG_APP_ULP_ADC_CHANNEL);
+    if (adc >= 0) {
+        env_regs[ENVSENSE_REG_ADC] = (uint16_t)filter(&adc_state, adc);
+        env_regs[ENVSENSE_REG_ADC_RAW] = (uint16_t)adc;
+    }
+#else
+    (void)adc_state;
+#endif
+    samples++;
+    env_regs[ENVSENSE_REG_SAMPLES] = (uint16_t)samples;
+    // The program halts and is started again by the ULP timer
+    return 0;
+}
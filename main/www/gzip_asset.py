@@ -0,0 +1,14 @@
+#!/usr/bin/env python
+# Compress a web UI asset for embedding into the firmware.
+# The gzip header carries no file name and no timestamp, so the same input
+# always gives the same output and the same ETag.
+import gzip
+import sys
+
+if len(sys.argv) != 3:
+    sys.exit('usage: gzip_asset.py <input> <output>')
+
+with open(sys.argv[1], 'rb') as f:
+    data = f.read()
+with open(sys.argv[2], 'wb') as f:
+    f.write(gzip.compress(data, compresslevel=9, mtime=0))
@@ -9,6 +9,8 @@
 #include "mbc_master.h"             // for master interface define
 #include "esp_modbus_master.h"      // for public interface defines
 #include "esp_modbus_callbacks.h"   // for callback functions
+#include "mbutils.h"                // for xMBUtilGetBits()
+#include "esp_timer.h"              // for deadlines of the asynchronous requests
 #include "sdkconfig.h"
 
 static const char TAG[] __attribute__((unused)) = "MB_CONTROLLER_MASTER";
@@ -17,9 +19,24 @@ static const char TAG[] __attribute__((unused)) = "MB_CONTROLLER_MASTER";
 // These functions are wrappers for interface functions of the controller
 static mb_master_interface_t* master_interface_ptr = NULL;
 
+#if CONFIG_FMB_MASTER_ASYNC_API
+static esp_err_t mbc_master_async_start(void);
+static void mbc_master_async_stop(void);
+#endif
+#if CONFIG_FMB_MASTER_PARAM_CACHE
+static void mbc_master_param_cache_init(void);
+static void mbc_master_param_cache_free(bool delete_lock);
+static esp_err_t mbc_master_param_cache_lock_idle(void);
+static void mbc_master_param_cache_unlock(bool release);
+static void mbc_master_param_cache_invalidate(uint16_t cid);
+#endif
+
 void mbc_master_init_iface(void* handler)
 {
     master_interface_ptr = (mb_master_interface_t*) handler;
+#if CONFIG_FMB_MASTER_PARAM_CACHE
+    mbc_master_param_cache_init();
+#endif
 }
 
 /**
@@ -34,6 +51,12 @@ esp_err_t mbc_master_destroy(void)
     MB_MASTER_CHECK((master_interface_ptr->destroy != NULL),
                     ESP_ERR_INVALID_STATE,
                     "Master interface is not correctly initialized.");
+#if CONFIG_FMB_MASTER_ASYNC_API
+    mbc_master_async_stop();
+#endif
+#if CONFIG_FMB_MASTER_PARAM_CACHE
+    mbc_master_param_cache_free(true);
+#endif
     error = master_interface_ptr->destroy();
     MB_MASTER_CHECK((error == ESP_OK),
                     error,
@@ -99,6 +122,24 @@ esp_err_t mbc_master_send_request(mb_param_request_t* request, void* data_ptr)
     return ESP_OK;
 }
 
+/**
+ * Send the batch of requests with overlapped transactions to different slaves
+ */
+esp_err_t mbc_master_send_requests(const mb_param_request_t* requests, void* const data_ptrs[],
+                                   esp_err_t* status, size_t count)
+{
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->send_requests != NULL),
+                    ESP_ERR_NOT_SUPPORTED,
+                    "Master interface does not support pipelined requests.");
+    MB_MASTER_CHECK((requests != NULL) && (data_ptrs != NULL) && (count > 0),
+                    ESP_ERR_INVALID_ARG,
+                    "mb incorrect batch of requests.");
+    return master_interface_ptr->send_requests(requests, data_ptrs, status, count);
+}
+
 /**
  * Set Modbus parameter description table
  */
@@ -112,7 +153,17 @@ esp_err_t mbc_master_set_descriptor(const mb_parameter_descriptor_t* descriptor,
     MB_MASTER_CHECK((master_interface_ptr->set_descriptor != NULL),
                     ESP_ERR_INVALID_STATE,
                     "Master interface is not correctly initialized.");
+#if CONFIG_FMB_MASTER_PARAM_CACHE
+    // The cache entries follow the positions in the table, it is replaced only while no cached read runs
+    error = mbc_master_param_cache_lock_idle();
+    MB_MASTER_CHECK((error == ESP_OK),
+                    error,
+                    "Master set descriptor failure, a cached read is in progress.");
+#endif
     error = master_interface_ptr->set_descriptor(descriptor, num_elements);
+#if CONFIG_FMB_MASTER_PARAM_CACHE
+    mbc_master_param_cache_unlock(error == ESP_OK);
+#endif
     MB_MASTER_CHECK((error == ESP_OK),
                     error,
                     "Master set descriptor failure, error=(0x%x) (%s).",
@@ -133,6 +184,10 @@ esp_err_t mbc_master_set_parameter(uint16_t cid, char* name, uint8_t* value, uin
                     ESP_ERR_INVALID_STATE,
                     "Master interface is not correctly initialized.");
     error = master_interface_ptr->set_parameter(cid, name, value, type);
+#if CONFIG_FMB_MASTER_PARAM_CACHE
+    // The written value is read back by the next cached call, also if the write has failed
+    mbc_master_param_cache_invalidate(cid);
+#endif
     MB_MASTER_CHECK((error == ESP_OK),
                     error,
                     "Master set parameter failure, error=(0x%x) (%s).",
@@ -177,7 +232,10 @@ esp_err_t mbc_master_start(void)
                     error,
                     "Master start failure, error=(0x%x) (%s).",
                     (int)error, esp_err_to_name(error));
-    return ESP_OK;
+#if CONFIG_FMB_MASTER_ASYNC_API
+    error = mbc_master_async_start();
+#endif
+    return error;
 }
 
 eMBErrorCode eMBMasterRegDiscreteCB(UCHAR * pucRegBuffer, USHORT usAddress,
@@ -277,6 +335,32 @@ esp_err_t mbc_master_get_transaction_info(mb_trans_info_t *ptinfo)
     return ESP_OK;
 }
 
+/**
+ * Get the response time statistics of the slave
+ */
+esp_err_t mbc_master_get_slave_health(uint8_t slave_addr, mb_slave_health_t* health)
+{
+#if CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT
+    MB_MASTER_CHECK((health != NULL), ESP_ERR_INVALID_ARG, "mb incorrect health argument.");
+    return mb_port_health_get(slave_addr, health);
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Clear the response time statistics of the slaves
+ */
+esp_err_t mbc_master_reset_slave_health(void)
+{
+#if CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT
+    mb_port_health_reset();
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
 // Helper function to set parameter buffer according to its type
 esp_err_t mbc_master_set_param_data(void* dest, void* src, mb_descr_type_t param_type, size_t param_size)
 {
@@ -554,3 +638,967 @@ esp_err_t mbc_master_set_param_data(void* dest, void* src, mb_descr_type_t param
     }
     return err;
 }
+
+/* ----------------------- Parameter cache ------------------------------------------------------*/
+
+#if CONFIG_FMB_MASTER_PARAM_CACHE
+
+#define MB_PARAM_CACHE_WAITERS_MAX      (16)
+#define MB_PARAM_CACHE_WAIT_TICS        (pdMS_TO_TICKS(CONFIG_FMB_MASTER_TIMEOUT_MS_RESPOND * 2))
+
+// The cached value of the characteristic at the same position in the descriptor table
+typedef struct {
+    bool valid;                     // The value is set by a successful read
+    bool reading;                   // A task reads the characteristic from the bus
+    bool stored;                    // The last completed read has stored its value
+    uint8_t type;                   // Parameter type returned by the read
+    uint8_t waiters;                // Tasks waiting for the read in progress
+    uint32_t generation;            // Incremented by each completed read
+    uint32_t writes;                // Incremented by each write of the characteristic
+    uint32_t read_writes;           // Writes at the start of the read in progress
+    esp_err_t error;                // Result of the last completed read
+    int64_t time_stamp;             // Completion time of the last successful read
+    uint8_t* value;                 // Value of the characteristic, param_size bytes
+    SemaphoreHandle_t done;         // Wakes the waiting tasks, created with the first waiter
+} mb_param_cache_entry_t;
+
+static SemaphoreHandle_t param_cache_lock = NULL;
+static mb_param_cache_entry_t* param_cache = NULL;
+static size_t param_cache_size = 0;
+static mb_param_cache_stats_t param_cache_stats = { 0 };
+
+static void mbc_master_param_cache_init(void)
+{
+    if (!param_cache_lock) {
+        param_cache_lock = xSemaphoreCreateMutex();
+        if (!param_cache_lock) {
+            ESP_LOGE(TAG, "mb parameter cache lock create error.");
+        }
+    }
+}
+
+// Release the entries with the lock taken, the cache is allocated again by the next cached call
+static void mbc_master_param_cache_release(void)
+{
+    for (size_t idx = 0; param_cache && (idx < param_cache_size); idx++) {
+        free(param_cache[idx].value);
+        if (param_cache[idx].done) {
+            vSemaphoreDelete(param_cache[idx].done);
+        }
+    }
+    free(param_cache);
+    param_cache = NULL;
+    param_cache_size = 0;
+    memset(&param_cache_stats, 0, sizeof(param_cache_stats));
+}
+
+static void mbc_master_param_cache_free(bool delete_lock)
+{
+    if (!param_cache_lock) {
+        return;
+    }
+    (void)xSemaphoreTake(param_cache_lock, portMAX_DELAY);
+    mbc_master_param_cache_release();
+    (void)xSemaphoreGive(param_cache_lock);
+    if (delete_lock) {
+        vSemaphoreDelete(param_cache_lock);
+        param_cache_lock = NULL;
+    }
+}
+
+// Take the lock if no task reads or waits for an entry, the reading and waiting tasks
+// use their entry without the lock
+static esp_err_t mbc_master_param_cache_lock_idle(void)
+{
+    if (!param_cache_lock) {
+        return ESP_OK;
+    }
+    (void)xSemaphoreTake(param_cache_lock, portMAX_DELAY);
+    for (size_t idx = 0; param_cache && (idx < param_cache_size); idx++) {
+        if (param_cache[idx].reading || param_cache[idx].waiters) {
+            (void)xSemaphoreGive(param_cache_lock);
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    return ESP_OK;
+}
+
+// Give the lock taken by mbc_master_param_cache_lock_idle(), release the entries with the table replaced
+static void mbc_master_param_cache_unlock(bool release)
+{
+    if (!param_cache_lock) {
+        return;
+    }
+    if (release) {
+        mbc_master_param_cache_release();
+    }
+    (void)xSemaphoreGive(param_cache_lock);
+}
+
+// Find the position of the characteristic in the descriptor table
+static int mbc_master_param_cache_index(uint16_t cid)
+{
+    const mb_master_options_t* mbm_opts = &master_interface_ptr->opts;
+    for (size_t idx = 0; mbm_opts->mbm_param_descriptor_table && (idx < mbm_opts->mbm_param_descriptor_size); idx++) {
+        if (mbm_opts->mbm_param_descriptor_table[idx].cid == cid) {
+            return (int)idx;
+        }
+    }
+    return -1;
+}
+
+static void mbc_master_param_cache_invalidate(uint16_t cid)
+{
+    if (!param_cache_lock) {
+        return;
+    }
+    (void)xSemaphoreTake(param_cache_lock, portMAX_DELAY);
+    int idx = mbc_master_param_cache_index(cid);
+    if (param_cache && (idx >= 0) && ((size_t)idx < param_cache_size)) {
+        // A read in progress may return the value before the write, it is not cached
+        param_cache[idx].valid = false;
+        param_cache[idx].writes++;
+    }
+    (void)xSemaphoreGive(param_cache_lock);
+}
+
+// Wait for the read of another task, called and returns with the lock taken. The read
+// has to be done again by the caller if reread is set, the shared one was overtaken by a write.
+static esp_err_t mbc_master_param_cache_wait(mb_param_cache_entry_t* entry, uint8_t* value, uint8_t* type,
+                                                size_t param_size, bool* reread)
+{
+    uint32_t generation = entry->generation;
+    TickType_t start = xTaskGetTickCount();
+
+    entry->waiters++;
+    param_cache_stats.coalesced++;
+    while ((generation == entry->generation) && ((xTaskGetTickCount() - start) < MB_PARAM_CACHE_WAIT_TICS)) {
+        (void)xSemaphoreGive(param_cache_lock);
+        // The wake up of a former read may be left in the semaphore, the generation is checked again
+        (void)xSemaphoreTake(entry->done, MB_PARAM_CACHE_WAIT_TICS);
+        (void)xSemaphoreTake(param_cache_lock, portMAX_DELAY);
+    }
+    entry->waiters--;
+    *reread = false;
+    if (generation == entry->generation) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (entry->error != ESP_OK) {
+        return entry->error;
+    }
+    if (!entry->stored) {
+        *reread = true;
+        return ESP_OK;
+    }
+    memcpy(value, entry->value, param_size);
+    *type = entry->type;
+    return ESP_OK;
+}
+
+/**
+ * Get parameter data for corresponding characteristic from the cache or from the slave
+ */
+esp_err_t mbc_master_get_parameter_cached(uint16_t cid, char* name, uint8_t* value, uint8_t* type,
+                                            uint32_t max_age_ms)
+{
+    MB_MASTER_CHECK((master_interface_ptr != NULL) && (master_interface_ptr->get_parameter != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((param_cache_lock != NULL), ESP_ERR_INVALID_STATE, "mb parameter cache is not initialized.");
+    MB_MASTER_CHECK((name != NULL) && (value != NULL) && (type != NULL),
+                    ESP_ERR_INVALID_ARG, "mb incorrect parameter arguments.");
+    const mb_master_options_t* mbm_opts = &master_interface_ptr->opts;
+    MB_MASTER_CHECK((mbm_opts->mbm_param_descriptor_table != NULL), ESP_ERR_INVALID_STATE,
+                    "mb descriptor table is not set.");
+    esp_err_t error = ESP_OK;
+
+    (void)xSemaphoreTake(param_cache_lock, portMAX_DELAY);
+    int idx = mbc_master_param_cache_index(cid);
+    if (idx < 0) {
+        (void)xSemaphoreGive(param_cache_lock);
+        ESP_LOGE(TAG, "%s: The requested cid(%u) is not found in the data dictionary.", __FUNCTION__, (unsigned)cid);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!param_cache) {
+        param_cache = calloc(mbm_opts->mbm_param_descriptor_size, sizeof(mb_param_cache_entry_t));
+        param_cache_size = param_cache ? mbm_opts->mbm_param_descriptor_size : 0;
+    }
+    if (!param_cache) {
+        (void)xSemaphoreGive(param_cache_lock);
+        ESP_LOGE(TAG, "mb parameter cache allocation failure.");
+        return ESP_ERR_INVALID_STATE;
+    }
+    mb_param_cache_entry_t* entry = &param_cache[idx];
+    size_t param_size = mbm_opts->mbm_param_descriptor_table[idx].param_size;
+
+    if (entry->valid && max_age_ms
+            && ((esp_timer_get_time() - entry->time_stamp) <= ((int64_t)max_age_ms * 1000))) {
+        memcpy(value, entry->value, param_size);
+        *type = entry->type;
+        param_cache_stats.hits++;
+        (void)xSemaphoreGive(param_cache_lock);
+        return ESP_OK;
+    }
+    if (entry->reading && (entry->read_writes == entry->writes)) {
+        if (!entry->done) {
+            entry->done = xSemaphoreCreateCounting(MB_PARAM_CACHE_WAITERS_MAX, 0);
+        }
+        if (entry->done && (entry->waiters < MB_PARAM_CACHE_WAITERS_MAX)) {
+            bool reread = false;
+            error = mbc_master_param_cache_wait(entry, value, type, param_size, &reread);
+            (void)xSemaphoreGive(param_cache_lock);
+            return reread ? master_interface_ptr->get_parameter(cid, name, value, type) : error;
+        }
+        // The read can not be shared, read the value without the cache
+        (void)xSemaphoreGive(param_cache_lock);
+        return master_interface_ptr->get_parameter(cid, name, value, type);
+    }
+    if (entry->reading) {
+        // The read in progress has started before a write, its value may be outdated
+        (void)xSemaphoreGive(param_cache_lock);
+        return master_interface_ptr->get_parameter(cid, name, value, type);
+    }
+    entry->reading = true;
+    entry->read_writes = entry->writes;
+    param_cache_stats.reads++;
+    (void)xSemaphoreGive(param_cache_lock);
+
+    // The value is read into the buffer of the caller, the cached one can be used by other tasks meanwhile
+    error = master_interface_ptr->get_parameter(cid, name, value, type);
+
+    (void)xSemaphoreTake(param_cache_lock, portMAX_DELAY);
+    if ((error == ESP_OK) && !entry->value) {
+        entry->value = malloc(param_size);
+    }
+    // The waiters take the value from the cache, they read again if it is not stored
+    entry->stored = (error == ESP_OK) && entry->value && (entry->read_writes == entry->writes);
+    if (entry->stored) {
+        memcpy(entry->value, value, param_size);
+        entry->type = *type;
+        entry->time_stamp = esp_timer_get_time();
+        entry->valid = true;
+    }
+    entry->error = error;
+    entry->generation++;
+    entry->reading = false;
+    for (uint8_t waiter = 0; entry->done && (waiter < entry->waiters); waiter++) {
+        (void)xSemaphoreGive(entry->done);
+    }
+    (void)xSemaphoreGive(param_cache_lock);
+    return error;
+}
+
+esp_err_t mbc_master_get_param_cache_stats(mb_param_cache_stats_t* stats)
+{
+    MB_MASTER_CHECK((stats != NULL), ESP_ERR_INVALID_ARG, "mb incorrect stats pointer.");
+    MB_MASTER_CHECK((param_cache_lock != NULL), ESP_ERR_INVALID_STATE, "mb parameter cache is not initialized.");
+    (void)xSemaphoreTake(param_cache_lock, portMAX_DELAY);
+    *stats = param_cache_stats;
+    (void)xSemaphoreGive(param_cache_lock);
+    return ESP_OK;
+}
+
+#endif
+
+/* ----------------------- Poll plan ------------------------------------------------------------*/
+
+#define MB_POLL_PLAN_REGS_MAX       (125)   // Register read limit of FC03/FC04
+#define MB_POLL_PLAN_BITS_MAX       (1992)  // Coil and discrete read limit of FC01/FC02
+#define MB_POLL_PLAN_BUF_SIZE       (256)   // Fits the data of any read request of the plan
+
+// One read request of the plan and the characteristics it covers
+typedef struct {
+    uint8_t slave_addr;             // Slave address of the request
+    uint8_t param_type;             // Register area, mb_param_type_t
+    uint16_t reg_start;             // First register (bit) of the request
+    uint16_t reg_size;              // Number of registers (bits) of the request
+    uint16_t first;                 // First entry of the request in the cid list
+    uint16_t count;                 // Number of the characteristics of the request
+} mb_poll_block_t;
+
+struct mb_poll_plan_s {
+    const mb_parameter_descriptor_t* table; // Descriptor table the plan is compiled for
+    uint16_t table_size;                    // Number of the characteristics in the table
+    uint16_t block_count;                   // Number of the requests per cycle
+    uint16_t cid_count;                     // Number of the characteristics read per cycle
+    mb_poll_block_t* blocks;                // Requests in the order of execution
+    uint16_t* cids;                         // Characteristics sorted by slave, area and register
+    uint8_t buffer[MB_POLL_PLAN_BUF_SIZE];  // Data of the current request
+};
+
+static uint8_t mbc_master_poll_plan_command(mb_param_type_t param_type)
+{
+    switch(param_type)
+    {
+        case MB_PARAM_HOLDING:
+            return MB_FUNC_READ_HOLDING_REGISTER;
+        case MB_PARAM_INPUT:
+            return MB_FUNC_READ_INPUT_REGISTER;
+        case MB_PARAM_COIL:
+            return MB_FUNC_READ_COILS;
+        case MB_PARAM_DISCRETE:
+            return MB_FUNC_READ_DISCRETE_INPUTS;
+        default:
+            return 0;
+    }
+}
+
+// The characteristic can be read by the plan
+static bool mbc_master_poll_plan_readable(const mb_parameter_descriptor_t* reg_ptr, uint16_t limit)
+{
+    return (reg_ptr->access & PAR_PERMS_READ) && reg_ptr->mb_slave_addr
+            && mbc_master_poll_plan_command(reg_ptr->mb_param_type)
+            && (reg_ptr->mb_size <= limit);
+}
+
+// Order of the characteristics in the plan: slave address, register area, start register
+static int mbc_master_poll_plan_compare(const mb_parameter_descriptor_t* a, const mb_parameter_descriptor_t* b)
+{
+    if (a->mb_slave_addr != b->mb_slave_addr) {
+        return (int)a->mb_slave_addr - (int)b->mb_slave_addr;
+    }
+    if (a->mb_param_type != b->mb_param_type) {
+        return (int)a->mb_param_type - (int)b->mb_param_type;
+    }
+    return (int)a->mb_reg_start - (int)b->mb_reg_start;
+}
+
+static uint16_t mbc_master_poll_plan_limit(const mb_poll_plan_config_t* config, mb_param_type_t param_type)
+{
+    if ((param_type == MB_PARAM_COIL) || (param_type == MB_PARAM_DISCRETE)) {
+        return MB_POLL_PLAN_BITS_MAX;
+    }
+    return (config->max_regs && (config->max_regs < MB_POLL_PLAN_REGS_MAX)) ?
+                config->max_regs : MB_POLL_PLAN_REGS_MAX;
+}
+
+// Compile the poll plan of the listed characteristics, or of the whole table if the list is NULL
+static esp_err_t mbc_master_poll_plan_compile(const mb_poll_plan_config_t* config, const uint16_t* cid_list,
+                                                uint16_t cid_list_size, struct mb_poll_plan_s** plan)
+{
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((config != NULL) && (plan != NULL), ESP_ERR_INVALID_ARG, "mb incorrect plan arguments.");
+    const mb_master_options_t* mbm_opts = &master_interface_ptr->opts;
+    const mb_parameter_descriptor_t* table = mbm_opts->mbm_param_descriptor_table;
+    uint16_t table_size = (uint16_t)mbm_opts->mbm_param_descriptor_size;
+    MB_MASTER_CHECK((table != NULL) && table_size, ESP_ERR_INVALID_STATE, "mb descriptor table is not set.");
+    uint16_t list_size = cid_list ? cid_list_size : table_size;
+
+    // The plan, its requests and the sorted cid list are allocated together
+    size_t alloc_size = sizeof(struct mb_poll_plan_s) + list_size * (sizeof(mb_poll_block_t) + sizeof(uint16_t));
+    struct mb_poll_plan_s* new_plan = calloc(1, alloc_size);
+    MB_MASTER_CHECK((new_plan != NULL), ESP_ERR_NO_MEM, "mb poll plan allocation failure.");
+    new_plan->table = table;
+    new_plan->table_size = table_size;
+    new_plan->blocks = (mb_poll_block_t*)(new_plan + 1);
+    new_plan->cids = (uint16_t*)(new_plan->blocks + list_size);
+
+    // Sort the readable characteristics, the table is compiled once so insertion sort is sufficient
+    for (uint16_t list_idx = 0; list_idx < list_size; list_idx++) {
+        uint16_t cid = cid_list ? cid_list[list_idx] : list_idx;
+        if (cid >= table_size) {
+            continue;
+        }
+        const mb_parameter_descriptor_t* reg_ptr = &table[cid];
+        if (!mbc_master_poll_plan_readable(reg_ptr, mbc_master_poll_plan_limit(config, reg_ptr->mb_param_type))) {
+            continue;
+        }
+        uint16_t pos = new_plan->cid_count++;
+        while (pos && (mbc_master_poll_plan_compare(&table[new_plan->cids[pos - 1]], reg_ptr) > 0)) {
+            new_plan->cids[pos] = new_plan->cids[pos - 1];
+            pos--;
+        }
+        new_plan->cids[pos] = cid;
+    }
+    if (!new_plan->cid_count) {
+        free(new_plan);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Merge the neighboring characteristics into maximal read requests
+    mb_poll_block_t* block = NULL;
+    for (uint16_t idx = 0; idx < new_plan->cid_count; idx++) {
+        const mb_parameter_descriptor_t* reg_ptr = &table[new_plan->cids[idx]];
+        uint32_t reg_end = (uint32_t)reg_ptr->mb_reg_start + reg_ptr->mb_size;
+        if (block && (block->slave_addr == reg_ptr->mb_slave_addr)
+                && (block->param_type == reg_ptr->mb_param_type)) {
+            uint32_t block_end = (uint32_t)block->reg_start + block->reg_size;
+            uint32_t new_end = MAX(block_end, reg_end);
+            if (((uint32_t)reg_ptr->mb_reg_start <= (block_end + config->max_gap))
+                    && ((new_end - block->reg_start) <= mbc_master_poll_plan_limit(config, reg_ptr->mb_param_type))) {
+                block->reg_size = (uint16_t)(new_end - block->reg_start);
+                block->count++;
+                continue;
+            }
+        }
+        block = &new_plan->blocks[new_plan->block_count++];
+        block->slave_addr = reg_ptr->mb_slave_addr;
+        block->param_type = (uint8_t)reg_ptr->mb_param_type;
+        block->reg_start = reg_ptr->mb_reg_start;
+        block->reg_size = reg_ptr->mb_size;
+        block->first = idx;
+        block->count = 1;
+    }
+    ESP_LOGD(TAG, "Poll plan: %u characteristics in %u requests.",
+                (unsigned)new_plan->cid_count, (unsigned)new_plan->block_count);
+    *plan = new_plan;
+    return ESP_OK;
+}
+
+/**
+ * Compile the poll plan of the parameter description table
+ */
+esp_err_t mbc_master_poll_plan_create(const mb_poll_plan_config_t* config, mb_poll_plan_handle_t* plan)
+{
+    return mbc_master_poll_plan_compile(config, NULL, 0, plan);
+}
+
+// Copy the bits of the characteristic from the request data into the buffer starting from bit 0
+static void mbc_master_poll_plan_get_bits(uint8_t* dest, const uint8_t* src, uint16_t bit_offset, uint16_t bit_count)
+{
+    for (uint16_t bit = 0; bit < bit_count; bit += 8) {
+        uint8_t bits = (uint8_t)MIN(8, bit_count - bit);
+        dest[bit >> 3] = xMBUtilGetBits((UCHAR*)src, (USHORT)(bit_offset + bit), bits);
+    }
+}
+
+// Scatter the data of the executed request into the parameter storage
+static esp_err_t mbc_master_poll_plan_scatter(struct mb_poll_plan_s* plan, const mb_poll_block_t* block,
+                                                void* const storage[MB_PARAM_COUNT])
+{
+    uint8_t bits[MB_POLL_PLAN_BUF_SIZE];
+    esp_err_t error = ESP_OK;
+    bool is_bits = (block->param_type == MB_PARAM_COIL) || (block->param_type == MB_PARAM_DISCRETE);
+
+    if (storage == NULL) {
+        return ESP_OK;
+    }
+    for (uint16_t idx = block->first; idx < (block->first + block->count); idx++) {
+        const mb_parameter_descriptor_t* reg_ptr = &plan->table[plan->cids[idx]];
+        uint8_t* base = (uint8_t*)storage[reg_ptr->mb_param_type];
+        if (!base || !reg_ptr->param_offset) {
+            continue;
+        }
+        uint16_t offset = reg_ptr->mb_reg_start - block->reg_start;
+        uint8_t* src = &plan->buffer[offset << 1];
+        if (is_bits) {
+            if (reg_ptr->param_size > sizeof(bits)) {
+                error = ESP_ERR_INVALID_ARG; // The value is copied from the bit buffer
+                continue;
+            }
+            memset(bits, 0, sizeof(bits));
+            mbc_master_poll_plan_get_bits(bits, plan->buffer, offset, reg_ptr->mb_size);
+            src = bits;
+        } else if (((size_t)reg_ptr->mb_size << 1) < reg_ptr->param_size) {
+            error = ESP_ERR_INVALID_ARG; // The value does not fit the registers of the characteristic
+            continue;
+        }
+        if (mbc_master_set_param_data((void*)(base + reg_ptr->param_offset - 1), (void*)src,
+                                        reg_ptr->param_type, reg_ptr->param_size) != ESP_OK) {
+            error = ESP_ERR_INVALID_STATE;
+        }
+    }
+    return error;
+}
+
+// Execute one request of the plan and scatter its data
+static esp_err_t mbc_master_poll_plan_exec(struct mb_poll_plan_s* plan, uint16_t idx,
+                                            void* const storage[MB_PARAM_COUNT], esp_err_t* cid_status)
+{
+    const mb_poll_block_t* block = &plan->blocks[idx];
+    mb_param_request_t request = {
+        .slave_addr = block->slave_addr,
+        .command = mbc_master_poll_plan_command((mb_param_type_t)block->param_type),
+        .reg_start = block->reg_start,
+        .reg_size = block->reg_size
+    };
+    memset(plan->buffer, 0, sizeof(plan->buffer));
+    esp_err_t error = master_interface_ptr->send_request(&request, plan->buffer);
+    if (error == ESP_OK) {
+        error = mbc_master_poll_plan_scatter(plan, block, storage);
+    } else {
+        ESP_LOGD(TAG, "Poll plan request slave %u, reg %u(%u) failure (%s).", (unsigned)block->slave_addr,
+                    (unsigned)block->reg_start, (unsigned)block->reg_size, esp_err_to_name(error));
+    }
+    if (cid_status) {
+        for (uint16_t cid_idx = block->first; cid_idx < (block->first + block->count); cid_idx++) {
+            cid_status[plan->cids[cid_idx]] = error;
+        }
+    }
+    return error;
+}
+
+/**
+ * Execute the requests of the poll plan
+ */
+esp_err_t mbc_master_poll_plan_run(mb_poll_plan_handle_t plan, void* const storage[MB_PARAM_COUNT], esp_err_t* cid_status)
+{
+    MB_MASTER_CHECK((plan != NULL), ESP_ERR_INVALID_ARG, "mb incorrect poll plan.");
+    MB_MASTER_CHECK((master_interface_ptr != NULL) && (master_interface_ptr->send_request != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    esp_err_t result = ESP_OK;
+
+    for (uint16_t idx = 0; idx < plan->block_count; idx++) {
+        esp_err_t error = mbc_master_poll_plan_exec(plan, idx, storage, cid_status);
+        if ((error != ESP_OK) && (result == ESP_OK)) {
+            result = error;
+        }
+    }
+    return result;
+}
+
+esp_err_t mbc_master_poll_plan_get_info(mb_poll_plan_handle_t plan, uint16_t* requests, uint16_t* cids)
+{
+    MB_MASTER_CHECK((plan != NULL), ESP_ERR_INVALID_ARG, "mb incorrect poll plan.");
+    if (requests) {
+        *requests = plan->block_count;
+    }
+    if (cids) {
+        *cids = plan->cid_count;
+    }
+    return ESP_OK;
+}
+
+void mbc_master_poll_plan_delete(mb_poll_plan_handle_t plan)
+{
+    free(plan);
+}
+
+/* ----------------------- Poll scheduler -------------------------------------------------------*/
+
+#define MB_POLL_SCHED_PERIOD_MAX_MS (3600000) // Keeps the period in microseconds within 32 bits
+#define MB_POLL_SCHED_EXEC_SHIFT    (3)     // Weight 1/8 of the last execution time in the smoothed one
+
+// The characteristics with the same period and deadline, read by the coalesced requests of one plan
+typedef struct {
+    struct mb_poll_plan_s* plan;    // Coalesced requests of the class
+    uint32_t period_us;             // Release period of the requests
+    uint32_t deadline_us;           // Deadline relative to the release
+} mb_poll_class_t;
+
+// One request of a class, released once per period
+typedef struct {
+    mb_poll_class_t* rate;          // Class of the request
+    uint16_t block;                 // Request in the plan of the class
+    int64_t release;                // Time of the current release
+    uint32_t exec_us;               // Smoothed execution time of the request
+} mb_poll_job_t;
+
+struct mb_poll_sched_s {
+    mb_poll_sched_policy_t policy;  // Selection of the next released request
+    uint16_t class_count;           // Number of the rate classes
+    uint16_t job_count;             // Number of the requests of all the classes
+    mb_poll_class_t* classes;       // Rate classes
+    mb_poll_job_t* jobs;            // Requests of all the classes
+    bool started;                   // The releases are set by the first run
+    mb_poll_sched_stats_t stats;    // Counters since the creation
+    uint64_t busy_us;               // Execution time of all the requests
+    uint64_t elapsed_us;            // Time spent in mbc_master_poll_sched_run()
+};
+
+// The released job a has precedence over the released job b
+static bool mbc_master_poll_sched_before(mb_poll_sched_policy_t policy, const mb_poll_job_t* a, const mb_poll_job_t* b)
+{
+    if ((policy == MB_POLL_SCHED_RM) && (a->rate->period_us != b->rate->period_us)) {
+        return a->rate->period_us < b->rate->period_us;
+    }
+    return (a->release + a->rate->deadline_us) < (b->release + b->rate->deadline_us);
+}
+
+// Utilization required by the periods with the execution times measured so far, per mille
+static uint16_t mbc_master_poll_sched_demand(const struct mb_poll_sched_s* sched)
+{
+    uint64_t demand = 0;
+    for (uint16_t idx = 0; idx < sched->job_count; idx++) {
+        const mb_poll_job_t* job = &sched->jobs[idx];
+        demand += ((uint64_t)job->exec_us * 1000) / job->rate->period_us;
+    }
+    return (uint16_t)MIN(demand, UINT16_MAX);
+}
+
+/**
+ * Compile the coalesced requests of each rate class and the job list of the scheduler
+ */
+esp_err_t mbc_master_poll_sched_create(const mb_poll_sched_config_t* config, const mb_poll_rate_t* rates,
+                                        uint16_t rate_count, mb_poll_sched_handle_t* sched)
+{
+    MB_MASTER_CHECK((config != NULL) && (rates != NULL) && rate_count && (sched != NULL),
+                    ESP_ERR_INVALID_ARG, "mb incorrect scheduler arguments.");
+    MB_MASTER_CHECK((config->policy == MB_POLL_SCHED_EDF) || (config->policy == MB_POLL_SCHED_RM),
+                    ESP_ERR_INVALID_ARG, "mb incorrect scheduler policy.");
+    for (uint16_t idx = 0; idx < rate_count; idx++) {
+        MB_MASTER_CHECK(rates[idx].period_ms && (rates[idx].period_ms <= MB_POLL_SCHED_PERIOD_MAX_MS)
+                        && (rates[idx].deadline_ms <= rates[idx].period_ms),
+                        ESP_ERR_INVALID_ARG, "mb incorrect period or deadline of cid %u.", (unsigned)rates[idx].cid);
+    }
+
+    // The classes, the cids of one class and the used rate entries are sized for one class per entry
+    struct mb_poll_sched_s* new_sched = calloc(1, sizeof(struct mb_poll_sched_s)
+                                                + rate_count * (sizeof(mb_poll_class_t) + sizeof(uint16_t) + 1));
+    MB_MASTER_CHECK((new_sched != NULL), ESP_ERR_NO_MEM, "mb poll scheduler allocation failure.");
+    new_sched->policy = config->policy;
+    new_sched->classes = (mb_poll_class_t*)(new_sched + 1);
+    uint16_t* class_cids = (uint16_t*)(new_sched->classes + rate_count);
+    uint8_t* used = (uint8_t*)(class_cids + rate_count);
+    esp_err_t error = ESP_OK;
+
+    // The characteristics with equal period and deadline are coalesced into the requests of one class
+    for (uint16_t first = 0; (error == ESP_OK) && (first < rate_count); first++) {
+        if (used[first]) {
+            continue;
+        }
+        uint32_t period_ms = rates[first].period_ms;
+        uint32_t deadline_ms = rates[first].deadline_ms ? rates[first].deadline_ms : period_ms;
+        uint16_t class_size = 0;
+        for (uint16_t idx = first; idx < rate_count; idx++) {
+            uint32_t idx_deadline_ms = rates[idx].deadline_ms ? rates[idx].deadline_ms : rates[idx].period_ms;
+            if (!used[idx] && (rates[idx].period_ms == period_ms) && (idx_deadline_ms == deadline_ms)) {
+                class_cids[class_size++] = rates[idx].cid;
+                used[idx] = 1;
+            }
+        }
+        mb_poll_class_t* rate = &new_sched->classes[new_sched->class_count];
+        error = mbc_master_poll_plan_compile(&config->plan, class_cids, class_size, &rate->plan);
+        if (error == ESP_ERR_NOT_FOUND) {
+            ESP_LOGW(TAG, "Poll scheduler: no readable cids with period %u ms.", (unsigned)period_ms);
+            error = ESP_OK;
+        } else if (error == ESP_OK) {
+            rate->period_us = period_ms * 1000;
+            rate->deadline_us = deadline_ms * 1000;
+            new_sched->job_count += rate->plan->block_count;
+            new_sched->class_count++;
+        }
+    }
+    if ((error == ESP_OK) && !new_sched->job_count) {
+        error = ESP_ERR_NOT_FOUND;
+    }
+    if (error == ESP_OK) {
+        new_sched->jobs = calloc(new_sched->job_count, sizeof(mb_poll_job_t));
+        error = new_sched->jobs ? ESP_OK : ESP_ERR_NO_MEM;
+    }
+    if (error != ESP_OK) {
+        mbc_master_poll_sched_delete(new_sched);
+        return error;
+    }
+    mb_poll_job_t* job = new_sched->jobs;
+    for (uint16_t class_idx = 0; class_idx < new_sched->class_count; class_idx++) {
+        mb_poll_class_t* rate = &new_sched->classes[class_idx];
+        for (uint16_t block = 0; block < rate->plan->block_count; block++, job++) {
+            job->rate = rate;
+            job->block = block;
+        }
+    }
+    ESP_LOGD(TAG, "Poll scheduler: %u rate classes in %u requests.",
+                (unsigned)new_sched->class_count, (unsigned)new_sched->job_count);
+    *sched = new_sched;
+    return ESP_OK;
+}
+
+/**
+ * Execute the released requests in the order of the policy during the run time
+ */
+esp_err_t mbc_master_poll_sched_run(mb_poll_sched_handle_t sched, void* const storage[MB_PARAM_COUNT],
+                                    esp_err_t* cid_status, uint32_t run_ms)
+{
+    MB_MASTER_CHECK((sched != NULL), ESP_ERR_INVALID_ARG, "mb incorrect poll scheduler.");
+    MB_MASTER_CHECK((master_interface_ptr != NULL) && (master_interface_ptr->send_request != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    esp_err_t result = ESP_OK;
+    int64_t start = esp_timer_get_time();
+    int64_t end = start + (int64_t)run_ms * 1000;
+    int64_t now = start;
+
+    if (!sched->started) {
+        // All the requests are released at once, the policy orders the first cycle
+        for (uint16_t idx = 0; idx < sched->job_count; idx++) {
+            sched->jobs[idx].release = start;
+        }
+        sched->started = true;
+    }
+    while (now < end) {
+        mb_poll_job_t* next = NULL;
+        int64_t next_release = end;
+        for (uint16_t idx = 0; idx < sched->job_count; idx++) {
+            mb_poll_job_t* job = &sched->jobs[idx];
+            if (job->release > now) {
+                next_release = MIN(next_release, job->release);
+            } else if (!next || mbc_master_poll_sched_before(sched->policy, job, next)) {
+                next = job;
+            }
+        }
+        if (!next) {
+            // The bus is idle until the next release
+            vTaskDelay(MAX(1, pdMS_TO_TICKS((uint32_t)((next_release - now + 999) / 1000))));
+            now = esp_timer_get_time();
+            continue;
+        }
+
+        esp_err_t error = mbc_master_poll_plan_exec(next->rate->plan, next->block, storage, cid_status);
+        if ((error != ESP_OK) && (result == ESP_OK)) {
+            result = error;
+        }
+        int64_t done = esp_timer_get_time();
+        uint32_t exec_us = (uint32_t)(done - now);
+        next->exec_us = next->exec_us ? (next->exec_us - (next->exec_us >> MB_POLL_SCHED_EXEC_SHIFT)
+                                            + (exec_us >> MB_POLL_SCHED_EXEC_SHIFT)) : exec_us;
+        sched->busy_us += exec_us;
+        sched->stats.requests++;
+        sched->stats.errors += (error != ESP_OK);
+        int64_t deadline = next->release + next->rate->deadline_us;
+        if (done > deadline) {
+            sched->stats.misses++;
+            sched->stats.max_lateness_us = MAX(sched->stats.max_lateness_us, (uint32_t)MIN(done - deadline, UINT32_MAX));
+        }
+        // The periods whose deadline has passed before the request could start are skipped
+        next->release += next->rate->period_us;
+        while ((next->release + next->rate->deadline_us) <= done) {
+            next->release += next->rate->period_us;
+            sched->stats.skipped++;
+        }
+        now = done;
+    }
+    sched->elapsed_us += (uint64_t)(now - start);
+    return result;
+}
+
+esp_err_t mbc_master_poll_sched_get_stats(mb_poll_sched_handle_t sched, mb_poll_sched_stats_t* stats)
+{
+    MB_MASTER_CHECK((sched != NULL) && (stats != NULL), ESP_ERR_INVALID_ARG, "mb incorrect poll scheduler.");
+    *stats = sched->stats;
+    stats->utilization = sched->elapsed_us ? (uint16_t)MIN((sched->busy_us * 1000) / sched->elapsed_us, 1000) : 0;
+    stats->demand = mbc_master_poll_sched_demand(sched);
+    stats->classes = sched->class_count;
+    stats->jobs = sched->job_count;
+    return ESP_OK;
+}
+
+void mbc_master_poll_sched_delete(mb_poll_sched_handle_t sched)
+{
+    if (!sched) {
+        return;
+    }
+    for (uint16_t idx = 0; idx < sched->class_count; idx++) {
+        free(sched->classes[idx].plan);
+    }
+    free(sched->jobs);
+    free(sched);
+}
+
+/* ----------------------- Asynchronous requests ------------------------------------------------*/
+
+#if CONFIG_FMB_MASTER_ASYNC_API
+
+#define MB_MASTER_ASYNC_QUEUE_SIZE      (CONFIG_FMB_MASTER_ASYNC_QUEUE_SIZE)
+#define MB_MASTER_ASYNC_TASK_PRIO       (CONFIG_FMB_MASTER_ASYNC_TASK_PRIO)
+#define MB_MASTER_ASYNC_STOP_TICS       (pdMS_TO_TICKS(CONFIG_FMB_MASTER_TIMEOUT_MS_RESPOND * 2))
+
+typedef enum {
+    MB_ASYNC_SLOT_FREE = 0,
+    MB_ASYNC_SLOT_QUEUED,
+    MB_ASYNC_SLOT_RUNNING
+} mb_async_slot_state_t;
+
+// Queued asynchronous request
+typedef struct {
+    mb_async_slot_state_t state;
+    uint8_t priority;                   // Priority of the request, higher first
+    int64_t deadline_us;                // Latest start time of the request, 0 for no deadline
+    mb_master_async_cb_t callback;      // Completion callback
+    QueueHandle_t queue;                // Completion queue
+    mb_master_async_result_t result;    // Request data and result, the id gives the submit order
+} mb_async_slot_t;
+
+static mb_async_slot_t async_slots[MB_MASTER_ASYNC_QUEUE_SIZE];
+static portMUX_TYPE async_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t async_task_handle = NULL;
+static SemaphoreHandle_t async_stop_sema = NULL;
+static volatile bool async_stop = false;
+static uint32_t async_next_id = 1;
+static size_t async_pending_count = 0;
+static uint32_t async_submitters = 0;   // Submits which notify the worker after the lock is released
+
+// The request a has to be executed before the request b
+static bool mbc_master_async_before(const mb_async_slot_t* a, const mb_async_slot_t* b)
+{
+    if (a->priority != b->priority) {
+        return a->priority > b->priority;
+    }
+    if (a->deadline_us != b->deadline_us) {
+        // The requests without deadline go after the ones with deadline
+        return (a->deadline_us && (!b->deadline_us || (a->deadline_us < b->deadline_us)));
+    }
+    return (int32_t)(a->result.id - b->result.id) < 0;
+}
+
+// Take the next queued request for execution
+static mb_async_slot_t* mbc_master_async_take(void)
+{
+    mb_async_slot_t* next = NULL;
+    portENTER_CRITICAL(&async_lock);
+    for (int i = 0; i < MB_MASTER_ASYNC_QUEUE_SIZE; i++) {
+        mb_async_slot_t* slot = &async_slots[i];
+        if ((slot->state == MB_ASYNC_SLOT_QUEUED) && (!next || mbc_master_async_before(slot, next))) {
+            next = slot;
+        }
+    }
+    if (next) {
+        next->state = MB_ASYNC_SLOT_RUNNING;
+    }
+    portEXIT_CRITICAL(&async_lock);
+    return next;
+}
+
+// Free the slot and deliver the result
+static void mbc_master_async_complete(mb_async_slot_t* slot, esp_err_t error)
+{
+    mb_master_async_result_t result = slot->result;
+    mb_master_async_cb_t callback = slot->callback;
+    QueueHandle_t queue = slot->queue;
+
+    result.error = error;
+    portENTER_CRITICAL(&async_lock);
+    slot->state = MB_ASYNC_SLOT_FREE;
+    async_pending_count--;
+    portEXIT_CRITICAL(&async_lock);
+    if (callback) {
+        callback(&result);
+    }
+    if (queue && (xQueueSend(queue, &result, 0) != pdTRUE)) {
+        ESP_LOGW(TAG, "Async request %" PRIu32 ", completion queue is full.", result.id);
+    }
+}
+
+// Worker task which executes the queued requests one by one
+static void mbc_master_async_task(void* arg)
+{
+    while (!async_stop) {
+        mb_async_slot_t* slot = mbc_master_async_take();
+        if (!slot) {
+            (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        esp_err_t error = ESP_ERR_TIMEOUT;
+        if (!slot->deadline_us || (esp_timer_get_time() <= slot->deadline_us)) {
+            error = master_interface_ptr->send_request(&slot->result.request, slot->result.data_ptr);
+        } else {
+            ESP_LOGD(TAG, "Async request %" PRIu32 ", deadline expired in queue.", slot->result.id);
+        }
+        mbc_master_async_complete(slot, error);
+    }
+    xSemaphoreGive(async_stop_sema);
+    vTaskSuspend(NULL);
+}
+
+static esp_err_t mbc_master_async_start(void)
+{
+    if (async_task_handle) {
+        return ESP_OK;
+    }
+    async_stop_sema = xSemaphoreCreateBinary();
+    MB_MASTER_CHECK((async_stop_sema != NULL), ESP_ERR_NO_MEM, "mb async semaphore create error.");
+    async_stop = false;
+    BaseType_t status = xTaskCreatePinnedToCore(mbc_master_async_task, "mb_async",
+                                                MB_CONTROLLER_STACK_SIZE, NULL,
+                                                MB_MASTER_ASYNC_TASK_PRIO,
+                                                &async_task_handle, MB_PORT_TASK_AFFINITY);
+    if (status != pdPASS) {
+        vSemaphoreDelete(async_stop_sema);
+        async_stop_sema = NULL;
+        async_task_handle = NULL;
+        MB_MASTER_CHECK(false, ESP_ERR_NO_MEM, "mb async task creation error.");
+    }
+    return ESP_OK;
+}
+
+// Stop the worker and complete the queued requests with an error
+static void mbc_master_async_stop(void)
+{
+    if (!async_task_handle) {
+        return;
+    }
+    // No request is queued after this point, the submit checks the flag under the same lock
+    portENTER_CRITICAL(&async_lock);
+    async_stop = true;
+    portEXIT_CRITICAL(&async_lock);
+    (void)xTaskNotifyGive(async_task_handle);
+    if (xSemaphoreTake(async_stop_sema, MB_MASTER_ASYNC_STOP_TICS) != pdTRUE) {
+        ESP_LOGE(TAG, "Async worker couldn't exit gracefully within timeout.");
+    }
+    // The submits queued before the stop may still notify the worker
+    bool notifying = true;
+    while (notifying) {
+        portENTER_CRITICAL(&async_lock);
+        notifying = (async_submitters != 0);
+        portEXIT_CRITICAL(&async_lock);
+        if (notifying) {
+            vTaskDelay(1);
+        }
+    }
+    vTaskDelete(async_task_handle);
+    async_task_handle = NULL;
+    vSemaphoreDelete(async_stop_sema);
+    async_stop_sema = NULL;
+    for (int i = 0; i < MB_MASTER_ASYNC_QUEUE_SIZE; i++) {
+        if (async_slots[i].state != MB_ASYNC_SLOT_FREE) {
+            mbc_master_async_complete(&async_slots[i], ESP_ERR_INVALID_STATE);
+        }
+    }
+}
+
+/**
+ * Queue the request for asynchronous execution
+ */
+esp_err_t mbc_master_send_request_async(const mb_param_request_t* request, void* data_ptr,
+                                        const mb_master_async_opts_t* opts, uint32_t* id)
+{
+    MB_MASTER_CHECK((request != NULL) && (data_ptr != NULL) && (opts != NULL),
+                    ESP_ERR_INVALID_ARG, "mb incorrect async request arguments.");
+    int64_t submit_us = esp_timer_get_time();
+    mb_async_slot_t* slot = NULL;
+    TaskHandle_t task = NULL;
+
+    portENTER_CRITICAL(&async_lock);
+    task = async_stop ? NULL : async_task_handle;
+    for (int i = 0; task && (i < MB_MASTER_ASYNC_QUEUE_SIZE); i++) {
+        if (async_slots[i].state == MB_ASYNC_SLOT_FREE) {
+            slot = &async_slots[i];
+            slot->state = MB_ASYNC_SLOT_QUEUED;
+            slot->priority = opts->priority;
+            slot->deadline_us = opts->deadline_ms ? (submit_us + (int64_t)opts->deadline_ms * 1000) : 0;
+            slot->callback = opts->callback;
+            slot->queue = opts->queue;
+            slot->result.id = async_next_id++;
+            slot->result.error = ESP_OK;
+            slot->result.request = *request;
+            slot->result.data_ptr = data_ptr;
+            slot->result.arg = opts->arg;
+            async_pending_count++;
+            async_submitters++;
+            // The slot can be completed and reused as soon as the lock is released
+            if (id) {
+                *id = slot->result.id;
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&async_lock);
+    MB_MASTER_CHECK((task != NULL), ESP_ERR_INVALID_STATE, "mb master is not started.");
+    MB_MASTER_CHECK((slot != NULL), ESP_ERR_NO_MEM, "mb async request queue is full.");
+    // The stop waits for this notification before the worker is deleted
+    (void)xTaskNotifyGive(task);
+    portENTER_CRITICAL(&async_lock);
+    async_submitters--;
+    portEXIT_CRITICAL(&async_lock);
+    return ESP_OK;
+}
+
+size_t mbc_master_async_pending(void)
+{
+    return async_pending_count;
+}
+
+#endif
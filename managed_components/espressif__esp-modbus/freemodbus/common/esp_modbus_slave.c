@@ -6,13 +6,22 @@
 
 #include "esp_err.h"                // for esp_err_t
 #include "esp_timer.h"              // for esp_timer_get_time()
+#include "esp_heap_caps.h"          // for register area placement
+#include "esp_memory_utils.h"       // for esp_ptr_external_ram()
 #include "sdkconfig.h"              // for KConfig defines
 
 #include "mbc_slave.h"              // for slave private type definitions
 #include "mbutils.h"                // for stack bit setting utilities
+#include "mbframe.h"                // for PDU field offsets
 #include "esp_modbus_common.h"      // for common defines
 #include "esp_modbus_slave.h"       // for public slave defines
 #include "esp_modbus_callbacks.h"   // for modbus callbacks function pointers declaration
+#if CONFIG_FMB_SLAVE_DUAL_TCP
+#include "port_tcp_slave.h"         // for TCP port of dual transport mode
+#endif
+#if CONFIG_FMB_SLAVE_RTU_PORTS
+#include "port_rtu_slave.h"         // for additional RTU ports
+#endif
 
 #ifdef CONFIG_FMB_CONTROLLER_SLAVE_ID_SUPPORT
 
@@ -29,204 +38,2175 @@ static uint8_t mb_slave_id[] = { MB_ID_BYTE0(MB_CONTROLLER_SLAVE_ID),
                                 MB_ID_BYTE1(MB_CONTROLLER_SLAVE_ID),
                                 MB_ID_BYTE2(MB_CONTROLLER_SLAVE_ID) };
 
-#endif
+#endif
+
+#define REG_SIZE(type, nregs) ((type == MB_PARAM_INPUT) || (type == MB_PARAM_HOLDING)) ? (nregs >> 1) : (nregs << 3)
+#define MB_WRITE_SCRATCH_REGS (123) // Maximum number of registers written by one request (FC16)
+
+// Common interface pointer for slave port
+static mb_slave_interface_t* slave_interface_ptr = NULL;
+static const char TAG[] __attribute__((unused)) = "MB_CONTROLLER_SLAVE";
+#if CONFIG_FMB_SLAVE_DUAL_TCP
+static bool slave_tcp_started = false;
+#endif
+#if CONFIG_FMB_SLAVE_RTU_PORTS
+static uint32_t slave_rtu_ports = 0; // Bit mask of the started additional RTU ports
+#endif
+
+static esp_err_t mbc_slave_add_descriptor(uint8_t slave_addr, mb_register_area_descriptor_t descr_data,
+                                            mb_descr_order_t order);
+
+#if CONFIG_FMB_CONTROLLER_DESCR_INDEX
+
+// Returns position of the last descriptor with (slave address, start offset) <= (slave_addr, addr)
+// in the sorted index or -1
+static int mbc_slave_search_reg_index(mb_param_type_t type, uint8_t slave_addr, uint32_t addr)
+{
+    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+    mb_descr_entry_t** index = mbs_opts->mbs_descr_index[type];
+    int low = 0;
+    int high = mbs_opts->mbs_descr_count[type];
+    while (low < high) {
+        int mid = (low + high) >> 1;
+        if ((index[mid]->slave_addr < slave_addr)
+                || ((index[mid]->slave_addr == slave_addr) && (index[mid]->start_offset <= addr))) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return (low - 1);
+}
+
+// Searches the register in the area specified by type, returns descriptor if found, else NULL
+// The registers may span several adjacent descriptors, the first one is returned
+static mb_descr_entry_t* mbc_slave_find_reg_descriptor(mb_param_type_t type, uint8_t slave_addr,
+                                                        uint16_t addr, size_t regs)
+{
+    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+    mb_descr_entry_t** index = mbs_opts->mbs_descr_index[type];
+    int pos = mbc_slave_search_reg_index(type, slave_addr, addr);
+    if ((pos < 0) || (regs < 1) || (index[pos]->slave_addr != slave_addr) || (addr >= index[pos]->end_offset)) {
+        return NULL;
+    }
+    // Check that the adjacent areas cover all requested registers
+    uint32_t end = (uint32_t)addr + regs;
+    mb_descr_entry_t* it = index[pos];
+    for (int i = pos; index[i]->end_offset < end; i++) {
+        if (((i + 1) >= mbs_opts->mbs_descr_count[type])
+                || (index[i + 1]->slave_addr != slave_addr)
+                || (index[i + 1]->start_offset != index[i]->end_offset)) {
+            return NULL;
+        }
+    }
+    return it;
+}
+
+// Returns the descriptor adjacent to the current one or NULL
+static mb_descr_entry_t* mbc_slave_next_reg_descriptor(mb_descr_entry_t* it)
+{
+    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+    uint16_t pos = it->index_pos + 1;
+    if (pos >= mbs_opts->mbs_descr_count[it->type]) {
+        return NULL;
+    }
+    mb_descr_entry_t* next = mbs_opts->mbs_descr_index[it->type][pos];
+    return (next->slave_addr == it->slave_addr) ? next : NULL;
+}
+
+// Inserts new descriptor into the sorted index, the areas must not overlap
+static esp_err_t mbc_slave_insert_reg_index(mb_descr_entry_t* new_descr)
+{
+    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+    mb_param_type_t type = new_descr->type;
+    uint16_t count = mbs_opts->mbs_descr_count[type];
+    MB_SLAVE_CHECK((count < UINT16_MAX), ESP_ERR_NO_MEM, "mb descriptor index is full.");
+    int pos = mbc_slave_search_reg_index(type, new_descr->slave_addr, new_descr->start_offset) + 1;
+    mb_descr_entry_t** index = mbs_opts->mbs_descr_index[type];
+    MB_SLAVE_CHECK((((pos == 0) || (index[pos - 1]->slave_addr != new_descr->slave_addr)
+                        || (index[pos - 1]->end_offset <= new_descr->start_offset))
+                    && ((pos == count) || (index[pos]->slave_addr != new_descr->slave_addr)
+                        || (new_descr->end_offset <= index[pos]->start_offset))),
+                    ESP_ERR_INVALID_ARG, "mb incorrect descriptor or already defined.");
+    index = (mb_descr_entry_t**)heap_caps_realloc(index, (count + 1) * sizeof(mb_descr_entry_t*),
+                                                    MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+    MB_SLAVE_CHECK((index != NULL), ESP_ERR_NO_MEM, "mb can not allocate memory for descriptor index.");
+    memmove(&index[pos + 1], &index[pos], (count - pos) * sizeof(mb_descr_entry_t*));
+    index[pos] = new_descr;
+    count++;
+    for (int i = pos; i < count; i++) {
+        index[i]->index_pos = (uint16_t)i;
+    }
+    mbs_opts->mbs_descr_index[type] = index;
+    mbs_opts->mbs_descr_count[type] = count;
+    return ESP_OK;
+}
+
+// Removes the descriptor from the sorted index, the index memory is kept
+static void mbc_slave_remove_reg_index(mb_descr_entry_t* it)
+{
+    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+    mb_descr_entry_t** index = mbs_opts->mbs_descr_index[it->type];
+    uint16_t count = --mbs_opts->mbs_descr_count[it->type];
+    memmove(&index[it->index_pos], &index[it->index_pos + 1], (count - it->index_pos) * sizeof(mb_descr_entry_t*));
+    for (int i = it->index_pos; i < count; i++) {
+        index[i]->index_pos = (uint16_t)i;
+    }
+}
+
+#else
+
+// Searches the register in the area specified by type, returns descriptor if found, else NULL
+static mb_descr_entry_t* mbc_slave_find_reg_descriptor(mb_param_type_t type, uint8_t slave_addr,
+                                                        uint16_t addr, size_t regs)
+{
+    mb_descr_entry_t* it;
+
+    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+
+    if (LIST_EMPTY(&mbs_opts->mbs_area_descriptors[type])) {
+        return NULL;
+    }
+
+    // search for the register in each area
+    for (it = LIST_FIRST(&mbs_opts->mbs_area_descriptors[type]); it != NULL; it = LIST_NEXT(it, entries)) {
+        if ((it->slave_addr == slave_addr)
+            && (addr >= it->start_offset)
+            && (it->p_data)
+            && (regs >= 1)
+            && ((addr + regs) <= it->end_offset)
+            && (it->end_offset > it->start_offset)) {
+            return it;
+        }
+    }
+    return NULL;
+}
+
+// The registers are always in one area when the index is not used
+static mb_descr_entry_t* mbc_slave_next_reg_descriptor(mb_descr_entry_t* it)
+{
+    return NULL;
+}
+
+#endif
+
+// Get the sequence lock of descriptor, the area without the lock of application is
+// protected by the own lock of descriptor against the concurrent readers of the stack
+static inline mb_seqlock_t* mbc_slave_area_lock(const mb_descr_entry_t* it)
+{
+    return it->lock ? it->lock : (mb_seqlock_t*)&it->commit_lock;
+}
+
+// Swaps bytes of each 16 bit register while copying, two registers per 32 bit word.
+// The frame buffer data is usually not aligned (odd offset in the PDU) while the
+// storage area is, so the aligned side is accessed by words and the other by bytes.
+static void mbc_slave_copy_regs_swap(uint8_t* dst, const uint8_t* src, uint16_t regs)
+{
+    if (!((uintptr_t)src & 0x03)) {
+        for (; regs >= 2; regs -= 2, src += 4, dst += 4) {
+            uint32_t word = *(const uint32_t*)src;
+            word = ((word & 0x00FF00FFUL) << 8) | ((word >> 8) & 0x00FF00FFUL);
+            if (!((uintptr_t)dst & 0x03)) {
+                *(uint32_t*)dst = word;
+            } else {
+                dst[0] = (uint8_t)word;
+                dst[1] = (uint8_t)(word >> 8);
+                dst[2] = (uint8_t)(word >> 16);
+                dst[3] = (uint8_t)(word >> 24);
+            }
+        }
+    } else if (!((uintptr_t)dst & 0x03)) {
+        for (; regs >= 2; regs -= 2, src += 4, dst += 4) {
+            *(uint32_t*)dst = ((uint32_t)src[1]) | ((uint32_t)src[0] << 8)
+                                | ((uint32_t)src[3] << 16) | ((uint32_t)src[2] << 24);
+        }
+    }
+    for (; regs > 0; regs--, src += 2, dst += 2) {
+        dst[0] = src[1];
+        dst[1] = src[0];
+    }
+}
+
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+// Drop the cached blocks of descriptor after the write of the stack
+static inline void mbc_slave_cache_invalidate(const mb_descr_entry_t* it)
+{
+    if (it->cache) {
+        __atomic_fetch_add(&it->cache->gen, 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Halve the read counters of all blocks
+static void mbc_slave_cache_age(mb_area_cache_t* cache)
+{
+    for (uint16_t block = 0; block < cache->blocks; block++) {
+        cache->heat[block] >>= 1;
+    }
+    cache->reads = 0;
+}
+
+// Get the block of descriptor with the copy consistent with the lock sequence from the cache,
+// the block is copied into the cache if it is hotter than the coldest cached one.
+// Returns NULL if the block has to be read from the area (called with the cache mutex taken)
+static const uint16_t* mbc_slave_cache_get_block(const mb_descr_entry_t* it, uint16_t block, uint32_t seq)
+{
+    mb_area_cache_t* cache = it->cache;
+    if (++cache->reads >= MB_AREA_CACHE_AGE_PERIOD) {
+        mbc_slave_cache_age(cache);
+    }
+    uint32_t heat = ++cache->heat[block];
+    uint32_t gen = __atomic_load_n(&cache->gen, __ATOMIC_ACQUIRE);
+    mb_area_cache_slot_t* slot = NULL;
+    if (cache->slot_of_block[block]) {
+        slot = &cache->slots[cache->slot_of_block[block] - 1];
+        if ((slot->seq == seq) && (slot->gen == gen)) {
+            cache->hits++;
+            return slot->data;
+        }
+    } else if (cache->cached < cache->slot_count) {
+        slot = &cache->slots[cache->cached++];
+    } else if (cache->slot_count) {
+        // Replace the coldest block if the block is hotter
+        mb_area_cache_slot_t* victim = &cache->slots[0];
+        for (uint16_t i = 1; i < cache->slot_count; i++) {
+            if (cache->heat[cache->slots[i].block] < cache->heat[victim->block]) {
+                victim = &cache->slots[i];
+            }
+        }
+        if (cache->heat[victim->block] < heat) {
+            cache->slot_of_block[victim->block] = 0;
+            cache->evictions++;
+            slot = victim;
+        }
+    }
+    cache->misses++;
+    if (slot == NULL) {
+        return NULL;
+    }
+    uint32_t reg_start = (uint32_t)block << MB_AREA_CACHE_BLOCK_SHIFT;
+    uint32_t regs = (it->size >> 1) - reg_start;
+    memcpy(slot->data, (const uint16_t*)it->p_data + reg_start,
+            ((regs < MB_AREA_CACHE_BLOCK_REGS) ? regs : MB_AREA_CACHE_BLOCK_REGS) << 1);
+    slot->block = block;
+    slot->seq = seq;
+    slot->gen = gen;
+    cache->slot_of_block[block] = (uint8_t)((slot - cache->slots) + 1);
+    return slot->data;
+}
+
+// Copy registers [reg_start, reg_start + regs) of descriptor through the block cache.
+// A copy interrupted by the update of application marks the block copied meanwhile with
+// the old sequence, so the block is never served from the cache again.
+static void mbc_slave_read_regs_cached(const mb_descr_entry_t* it, uint8_t* dst, uint16_t reg_start, uint16_t regs)
+{
+    mb_area_cache_t* cache = it->cache;
+    mb_seqlock_t* lock = mbc_slave_area_lock(it);
+    uint32_t seq;
+    do {
+        seq = mb_seqlock_read_begin(lock);
+        uint8_t* out = dst;
+        uint16_t reg = reg_start;
+        uint16_t left = regs;
+        (void)xSemaphoreTake(cache->mutex, portMAX_DELAY);
+        while (left > 0) {
+            uint16_t block = (uint16_t)(reg >> MB_AREA_CACHE_BLOCK_SHIFT);
+            uint16_t offset = (uint16_t)(reg & (MB_AREA_CACHE_BLOCK_REGS - 1));
+            uint16_t count = (uint16_t)(MB_AREA_CACHE_BLOCK_REGS - offset);
+            count = (left < count) ? left : count;
+            const uint16_t* src = mbc_slave_cache_get_block(it, block, seq);
+            src = (src != NULL) ? (src + offset) : ((const uint16_t*)it->p_data + reg);
+            if (it->wire_order) {
+                memcpy(out, src, (count << 1));
+            } else {
+                mbc_slave_copy_regs_swap(out, (const uint8_t*)src, count);
+            }
+            out += (count << 1);
+            reg += count;
+            left -= count;
+        }
+        (void)xSemaphoreGive(cache->mutex);
+    } while (mb_seqlock_read_retry(lock, seq));
+}
+#endif
+
+// Copy registers from the storage area of descriptor, retry if the area is updated meanwhile
+static void mbc_slave_read_regs(const mb_descr_entry_t* it, uint8_t* dst, const uint8_t* src, uint16_t regs)
+{
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+    if (it->cache) {
+        mbc_slave_read_regs_cached(it, dst, (uint16_t)((src - (const uint8_t*)it->p_data) >> 1), regs);
+        return;
+    }
+#endif
+    mb_seqlock_t* lock = mbc_slave_area_lock(it);
+    uint32_t seq;
+    do {
+        seq = mb_seqlock_read_begin(lock);
+        if (it->wire_order) {
+            memcpy(dst, src, (regs << 1));
+        } else {
+            mbc_slave_copy_regs_swap(dst, src, regs);
+        }
+    } while (mb_seqlock_read_retry(lock, seq));
+}
+
+// Copy registers into the storage area of descriptor. The registers of request are swapped
+// into the scratch buffer first and published with one copy under the lock, so the readers
+// of the area see either none or all registers of the request and never wait for the swap.
+static void mbc_slave_write_regs(const mb_descr_entry_t* it, uint8_t* dst, const uint8_t* src, uint16_t regs)
+{
+    uint32_t scratch[(MB_WRITE_SCRATCH_REGS + 1) >> 1]; // Word aligned for the swap copy
+    mb_seqlock_t* lock = mbc_slave_area_lock(it);
+    bool swap = !it->wire_order;
+    if (swap && (regs <= MB_WRITE_SCRATCH_REGS)) {
+        mbc_slave_copy_regs_swap((uint8_t*)scratch, src, regs);
+        src = (const uint8_t*)scratch;
+        swap = false;
+    }
+    mb_seqlock_write_begin(lock);
+    if (swap) {
+        mbc_slave_copy_regs_swap(dst, src, regs);
+    } else {
+        memcpy(dst, src, (regs << 1));
+    }
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+    mbc_slave_cache_invalidate(it);
+#endif
+    mb_seqlock_write_end(lock);
+}
+
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
+// Serializes the marking and the comparison of the tracked areas, the sequence counter of changes
+static portMUX_TYPE mbc_slave_change_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t mbc_slave_change_seq = 0;
+
+// Mark the registers [reg_start, reg_start + regs) of descriptor for the next comparison
+static void mbc_slave_mark_regs(const mb_descr_entry_t* it, uint16_t reg_start, uint16_t regs)
+{
+    mb_change_tracker_t* tracker = it->tracker;
+    if (tracker == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&mbc_slave_change_mux);
+    for (uint32_t reg = reg_start; reg < ((uint32_t)reg_start + regs); reg++) {
+        tracker->dirty[reg >> 5] |= (1UL << (reg & 0x1F));
+    }
+    portEXIT_CRITICAL(&mbc_slave_change_mux);
+}
+#endif
+
+// Refresh the expired computed registers of descriptor in the range [reg_start, reg_start + regs)
+static void mbc_slave_update_computed(const mb_descr_entry_t* it, uint16_t reg_start, uint16_t regs)
+{
+    int64_t time_now = 0;
+    for (uint16_t i = 0; i < it->computed_count; i++) {
+        mb_computed_reg_t* reg = &it->computed[i];
+        if ((reg->reg_offset >= (reg_start + regs)) || ((reg->reg_offset + reg->reg_count) <= reg_start)) {
+            continue;
+        }
+        if (!time_now) {
+            time_now = esp_timer_get_time();
+        }
+        if (time_now < reg->expires_us) {
+            continue;
+        }
+        uint16_t values[MB_COMPUTED_REGS_MAX];
+        reg->getter(values, reg->reg_count, reg->arg);
+        if (it->wire_order) {
+            for (uint16_t j = 0; j < reg->reg_count; j++) {
+                values[j] = __builtin_bswap16(values[j]);
+            }
+        }
+        mb_seqlock_write_begin(mbc_slave_area_lock(it));
+        memcpy((uint16_t*)it->p_data + reg->reg_offset, values, (reg->reg_count << 1));
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+        mbc_slave_cache_invalidate(it);
+#endif
+        mb_seqlock_write_end(mbc_slave_area_lock(it));
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
+        mbc_slave_mark_regs(it, reg->reg_offset, reg->reg_count);
+#endif
+        reg->expires_us = time_now + ((int64_t)reg->ttl_ms * 1000);
+    }
+}
+
+// Number of registers of the bound variable
+static inline uint16_t mbc_slave_binding_regs(const mb_reg_binding_t* bind)
+{
+    switch (bind->type) {
+        case MB_BIND_U32:
+        case MB_BIND_I32:
+            return 2;
+        case MB_BIND_FLOAT:
+            return (bind->scale != 0.0f) ? 1 : 2;
+        default:
+            return 1;
+    }
+}
+
+static inline bool mbc_slave_binding_signed(const mb_reg_binding_t* bind)
+{
+    return (bind->type == MB_BIND_I16) || (bind->type == MB_BIND_I32) || (bind->type == MB_BIND_FLOAT);
+}
+
+static inline int32_t mbc_slave_round(float value)
+{
+    return (int32_t)(value + ((value < 0.0f) ? -0.5f : 0.5f));
+}
+
+// Convert the bound variable into its registers in host byte order
+static void mbc_slave_binding_get(const mb_reg_binding_t* bind, uint16_t* values)
+{
+    uint32_t raw;
+    switch (bind->type) {
+        case MB_BIND_U8:
+            raw = __atomic_load_n((volatile uint8_t*)bind->ptr, __ATOMIC_RELAXED);
+            break;
+        case MB_BIND_BOOL:
+            raw = (__atomic_load_n((volatile uint8_t*)bind->ptr, __ATOMIC_RELAXED) != 0);
+            break;
+        case MB_BIND_U16:
+            raw = __atomic_load_n((volatile uint16_t*)bind->ptr, __ATOMIC_RELAXED);
+            break;
+        case MB_BIND_I16:
+            raw = (uint32_t)(int32_t)__atomic_load_n((volatile int16_t*)bind->ptr, __ATOMIC_RELAXED);
+            break;
+        default:
+            raw = __atomic_load_n((volatile uint32_t*)bind->ptr, __ATOMIC_RELAXED);
+            break;
+    }
+    if (bind->scale != 0.0f) {
+        float value;
+        if (bind->type == MB_BIND_FLOAT) {
+            memcpy(&value, &raw, sizeof(value));
+        } else {
+            value = mbc_slave_binding_signed(bind) ? (float)(int32_t)raw : (float)raw;
+        }
+        raw = (uint32_t)mbc_slave_round(value * bind->scale);
+    }
+    if (mbc_slave_binding_regs(bind) == 2) {
+        bool low_first = (bind->order & MB_BIND_ORDER_CDAB);
+        values[low_first ? 1 : 0] = (uint16_t)(raw >> 16);
+        values[low_first ? 0 : 1] = (uint16_t)raw;
+    } else {
+        values[0] = (uint16_t)raw;
+    }
+    if (bind->order & MB_BIND_ORDER_BADC) {
+        for (uint16_t i = 0; i < mbc_slave_binding_regs(bind); i++) {
+            values[i] = __builtin_bswap16(values[i]);
+        }
+    }
+}
+
+// Convert the registers in host byte order written by the master into the bound variable
+static void mbc_slave_binding_set(const mb_reg_binding_t* bind, const uint16_t* values)
+{
+    uint16_t regs = mbc_slave_binding_regs(bind);
+    uint16_t v[2] = { values[0], (regs == 2) ? values[1] : 0 };
+    if (bind->order & MB_BIND_ORDER_BADC) {
+        v[0] = __builtin_bswap16(v[0]);
+        v[1] = __builtin_bswap16(v[1]);
+    }
+    uint32_t raw = v[0];
+    if (regs == 2) {
+        raw = (bind->order & MB_BIND_ORDER_CDAB) ? (((uint32_t)v[1] << 16) | v[0]) : (((uint32_t)v[0] << 16) | v[1]);
+    }
+    if (bind->scale != 0.0f) {
+        float reg_value = !mbc_slave_binding_signed(bind) ? (float)raw
+                            : ((regs == 2) ? (float)(int32_t)raw : (float)(int16_t)raw);
+        float value = reg_value / bind->scale;
+        if (bind->type == MB_BIND_FLOAT) {
+            memcpy(&raw, &value, sizeof(raw));
+        } else {
+            raw = (uint32_t)mbc_slave_round(value);
+        }
+    }
+    switch (bind->type) {
+        case MB_BIND_U8:
+            __atomic_store_n((volatile uint8_t*)bind->ptr, (uint8_t)raw, __ATOMIC_RELAXED);
+            break;
+        case MB_BIND_BOOL:
+            __atomic_store_n((volatile uint8_t*)bind->ptr, (uint8_t)(raw != 0), __ATOMIC_RELAXED);
+            break;
+        case MB_BIND_U16:
+        case MB_BIND_I16:
+            __atomic_store_n((volatile uint16_t*)bind->ptr, (uint16_t)raw, __ATOMIC_RELAXED);
+            break;
+        default:
+            __atomic_store_n((volatile uint32_t*)bind->ptr, raw, __ATOMIC_RELAXED);
+            break;
+    }
+}
+
+// Refresh the bound registers of descriptor in the range [reg_start, reg_start + regs) from the variables,
+// only the changed values are stored, so the lock sequence of an unchanged area stays the same
+static void mbc_slave_update_bindings(const mb_descr_entry_t* it, uint16_t reg_start, uint16_t regs)
+{
+    for (uint16_t i = 0; i < it->binding_count; i++) {
+        const mb_reg_binding_t* bind = &it->bindings[i];
+        uint16_t count = mbc_slave_binding_regs(bind);
+        if ((bind->reg_offset >= (reg_start + regs)) || ((bind->reg_offset + count) <= reg_start)) {
+            continue;
+        }
+        uint16_t values[2];
+        mbc_slave_binding_get(bind, values);
+        if (it->wire_order) {
+            for (uint16_t j = 0; j < count; j++) {
+                values[j] = __builtin_bswap16(values[j]);
+            }
+        }
+        uint16_t* dst = (uint16_t*)it->p_data + bind->reg_offset;
+        if (memcmp(dst, values, (count << 1)) == 0) {
+            continue;
+        }
+        mb_seqlock_write_begin(mbc_slave_area_lock(it));
+        memcpy(dst, values, (count << 1));
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+        mbc_slave_cache_invalidate(it);
+#endif
+        mb_seqlock_write_end(mbc_slave_area_lock(it));
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
+        mbc_slave_mark_regs(it, bind->reg_offset, count);
+#endif
+    }
+}
+
+// Convert the registers [reg_start, reg_start + regs) written by the master into the writable bound variables
+static void mbc_slave_store_bindings(const mb_descr_entry_t* it, uint16_t reg_start, uint16_t regs)
+{
+    for (uint16_t i = 0; i < it->binding_count; i++) {
+        const mb_reg_binding_t* bind = &it->bindings[i];
+        uint16_t count = mbc_slave_binding_regs(bind);
+        if (!bind->writable
+            || (bind->reg_offset >= (reg_start + regs)) || ((bind->reg_offset + count) <= reg_start)) {
+            continue;
+        }
+        // The value of the variable split across two writes takes the other register from the area
+        uint16_t values[2];
+        memcpy(values, (const uint16_t*)it->p_data + bind->reg_offset, (count << 1));
+        if (it->wire_order) {
+            for (uint16_t j = 0; j < count; j++) {
+                values[j] = __builtin_bswap16(values[j]);
+            }
+        }
+        mbc_slave_binding_set(bind, values);
+    }
+}
+
+/**
+ * Function to get the actual register values of the bound variables
+ */
+void mbc_slave_get_bound_regs(const mb_reg_binding_t* binds, size_t count, uint16_t* regs)
+{
+    if ((binds == NULL) || (regs == NULL)) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        mbc_slave_binding_get(&binds[i], regs + binds[i].reg_offset);
+    }
+}
+
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+static portMUX_TYPE mbc_slave_hook_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Call the hook of descriptor for the range [reg_start, reg_start + regs) and account its time against the budget
+static void mbc_slave_call_hook(const mb_descr_entry_t* it, mb_area_hook_kind_t kind, uint16_t reg_start, uint16_t regs)
+{
+    mb_area_hook_state_t* state = it->hooks;
+    mb_area_hook_stats_t* stats = &state->stats[kind];
+    // The hooks may be replaced by application meanwhile
+    portENTER_CRITICAL(&mbc_slave_hook_mux);
+    mb_area_hook_t hook = (kind == MB_AREA_HOOK_PRE_READ) ? state->hooks.pre_read : state->hooks.post_write;
+    void* arg = state->hooks.arg;
+    uint32_t budget_us = state->hooks.budget_us;
+    bool suspended = stats->suspended;
+    portEXIT_CRITICAL(&mbc_slave_hook_mux);
+    if ((hook == NULL) || suspended) {
+        return;
+    }
+    int64_t time_start = esp_timer_get_time();
+    hook(it->type, reg_start, regs, arg);
+    uint32_t time_us = (uint32_t)(esp_timer_get_time() - time_start);
+    portENTER_CRITICAL(&mbc_slave_hook_mux);
+    stats->calls++;
+    stats->last_us = time_us;
+    stats->total_us += time_us;
+    stats->max_us = (time_us > stats->max_us) ? time_us : stats->max_us;
+    if (budget_us && (time_us > budget_us)) {
+        stats->overruns++;
+        state->overrun_run[kind]++;
+#if CONFIG_FMB_SLAVE_HOOK_OVERRUN_LIMIT > 0
+        if (state->overrun_run[kind] >= CONFIG_FMB_SLAVE_HOOK_OVERRUN_LIMIT) {
+            stats->suspended = suspended = true;
+        }
+#endif
+    } else {
+        state->overrun_run[kind] = 0;
+    }
+    portEXIT_CRITICAL(&mbc_slave_hook_mux);
+    if (suspended) {
+        ESP_LOGW(TAG, "mb area %u: %s hook suspended, took %u us, budget %u us.",
+                    (unsigned)it->start_offset, (kind == MB_AREA_HOOK_PRE_READ) ? "pre-read" : "post-write",
+                    (unsigned)time_us, (unsigned)budget_us);
+    }
+}
+#endif
+
+// Returns the number of registers (bits) of the request which belong to descriptor
+static inline uint16_t mbc_slave_get_reg_segment(const mb_descr_entry_t* it, uint16_t addr, uint16_t regs)
+{
+    uint32_t avail = it->end_offset - addr;
+    return (regs < avail) ? regs : (uint16_t)avail;
+}
+
+// Frees the descriptor and the memory attached to it, the descriptor is already unlinked
+static void mbc_slave_free_descriptor(mb_descr_entry_t* it)
+{
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+    if (it->cache) {
+        vSemaphoreDelete(it->cache->mutex);
+        free(it->cache);
+    }
+#endif
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
+    free(it->tracker);
+#endif
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+    free(it->hooks);
+#endif
+    free(it);
+}
+
+// Removes the area descriptor of the slave address, the stack must not use the area
+static esp_err_t mbc_slave_delete_descriptor(mb_param_type_t type, uint8_t slave_addr, uint16_t start_offset)
+{
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, slave_addr, start_offset, 1);
+    MB_SLAVE_CHECK(((it != NULL) && (it->start_offset == start_offset)),
+                    ESP_ERR_INVALID_ARG, "mb area with offset %u is not found.", (unsigned)start_offset);
+#if CONFIG_FMB_CONTROLLER_DESCR_INDEX
+    mbc_slave_remove_reg_index(it);
+#endif
+    LIST_REMOVE(it, entries);
+    mbc_slave_free_descriptor(it);
+    vMBRespCacheFlush();
+    return ESP_OK;
+}
+
+static void mbc_slave_free_descriptors(void) {
+
+    mb_descr_entry_t* it;
+    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+
+    for (int descr_type = 0; descr_type < MB_PARAM_COUNT; descr_type++) {
+        while ((it = LIST_FIRST(&mbs_opts->mbs_area_descriptors[descr_type]))) {
+            LIST_REMOVE(it, entries);
+            mbc_slave_free_descriptor(it);
+        }
+#if CONFIG_FMB_CONTROLLER_DESCR_INDEX
+        free(mbs_opts->mbs_descr_index[descr_type]);
+        mbs_opts->mbs_descr_index[descr_type] = NULL;
+        mbs_opts->mbs_descr_count[descr_type] = 0;
+#endif
+    }
+}
+
+void mbc_slave_init_iface(void* handler)
+{
+    slave_interface_ptr = (mb_slave_interface_t*) handler;
+    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+    // Initialize list head for register areas
+    LIST_INIT(&mbs_opts->mbs_area_descriptors[MB_PARAM_INPUT]);
+    LIST_INIT(&mbs_opts->mbs_area_descriptors[MB_PARAM_HOLDING]);
+    LIST_INIT(&mbs_opts->mbs_area_descriptors[MB_PARAM_COIL]);
+    LIST_INIT(&mbs_opts->mbs_area_descriptors[MB_PARAM_DISCRETE]);
+#if CONFIG_FMB_CONTROLLER_DESCR_INDEX
+    for (int descr_type = 0; descr_type < MB_PARAM_COUNT; descr_type++) {
+        mbs_opts->mbs_descr_index[descr_type] = NULL;
+        mbs_opts->mbs_descr_count[descr_type] = 0;
+    }
+#endif
+#if CONFIG_FMB_CONTROLLER_NOTIFY_RING
+    // Initialize parameter notification ring
+    mbs_opts->mbs_notification_ring.head = 0;
+    mbs_opts->mbs_notification_ring.tail = 0;
+    mbs_opts->mbs_notification_ring.ready_sema =
+            xSemaphoreCreateBinaryStatic(&mbs_opts->mbs_notification_ring.ready_sema_buf);
+#if CONFIG_FMB_SLAVE_CONCURRENT_EXEC
+    portMUX_INITIALIZE(&mbs_opts->mbs_notification_ring.producer_mux);
+#endif
+#endif
+    mbs_opts->mbs_notification_overflow = 0;
+}
+
+#if CONFIG_FMB_CONTROLLER_NOTIFY_RING
+// Puts parameter information into the notification ring (Modbus task side), never blocks.
+// When the ring is full the oldest notification is overwritten.
+static bool mbc_slave_notify_ring_push(mb_slave_options_t* mbs_opts, const mb_param_info_t* par_info)
+{
+    mb_notify_ring_t* ring = &mbs_opts->mbs_notification_ring;
+    bool overflow = false;
+#if CONFIG_FMB_SLAVE_CONCURRENT_EXEC
+    // The port tasks act as one producer
+    portENTER_CRITICAL(&ring->producer_mux);
+#endif
+    uint32_t head = ring->head; // the head is updated by producer only
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if ((head - tail) >= MB_CONTROLLER_NOTIFY_RING_MASK) {
+        mbs_opts->mbs_notification_overflow++;
+        overflow = true;
+    }
+    // Make the previous head update visible before the slot is overwritten
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ring->items[head & MB_CONTROLLER_NOTIFY_RING_MASK] = *par_info;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+#if CONFIG_FMB_SLAVE_CONCURRENT_EXEC
+    portEXIT_CRITICAL(&ring->producer_mux);
+#endif
+    (void)xSemaphoreGive(ring->ready_sema);
+    return !overflow;
+}
+
+// Gets the oldest valid notification from the ring (application task side), returns false if ring is empty
+static bool mbc_slave_notify_ring_pop(mb_notify_ring_t* ring, mb_param_info_t* par_info)
+{
+    uint32_t tail = ring->tail; // the tail is updated by consumer only
+    for (;;) {
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            return false;
+        }
+        if ((head - tail) >= MB_CONTROLLER_NOTIFY_RING_SIZE) {
+            // The producer has lapped the consumer, skip the overwritten entries
+            tail = head - MB_CONTROLLER_NOTIFY_RING_MASK;
+        }
+        *par_info = ring->items[tail & MB_CONTROLLER_NOTIFY_RING_MASK];
+        // Check that the slot was not overwritten while it was copied
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        if ((head - tail) < MB_CONTROLLER_NOTIFY_RING_SIZE) {
+            __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+    }
+}
+
+// Waits for notification in the ring during timeout (ms)
+static esp_err_t mbc_slave_notify_ring_get(mb_notify_ring_t* ring, mb_param_info_t* par_info, uint32_t timeout)
+{
+    TickType_t wait_ticks = MB_PAR_INFO_TO_TICKS(timeout);
+    TickType_t start_ticks = xTaskGetTickCount();
+    while (!mbc_slave_notify_ring_pop(ring, par_info)) {
+        TickType_t elapsed = xTaskGetTickCount() - start_ticks;
+        if (wait_ticks == portMAX_DELAY) {
+            elapsed = 0;
+        } else if (elapsed >= wait_ticks) {
+            return ESP_ERR_TIMEOUT;
+        }
+        (void)xSemaphoreTake(ring->ready_sema, (wait_ticks - elapsed));
+    }
+    return ESP_OK;
+}
+#endif
+
+/**
+ * Modbus controller destroy function
+ */
+esp_err_t mbc_slave_destroy(void)
+{
+    esp_err_t error = ESP_OK;
+    // Is initialization done?
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    // Check if interface has been initialized
+    MB_SLAVE_CHECK((slave_interface_ptr->destroy != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+#if CONFIG_FMB_SLAVE_DUAL_TCP
+    if (slave_tcp_started) {
+        vMBTCPPortClose();
+        slave_tcp_started = false;
+    }
+#endif
+#if CONFIG_FMB_SLAVE_RTU_PORTS
+    for (uint8_t port_index = 0; slave_rtu_ports != 0; port_index++) {
+        if (slave_rtu_ports & BIT(port_index)) {
+            (void)xMBRTUPortStop(port_index);
+            slave_rtu_ports &= ~BIT(port_index);
+        }
+    }
+#endif
+    // Call the slave port destroy function
+    error = slave_interface_ptr->destroy();
+    MB_SLAVE_CHECK((error == ESP_OK),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave destroy failure error=(0x%x).",
+                    (int)error);
+    // Destroy all opened descriptors
+    mbc_slave_free_descriptors();
+#if !CONFIG_FMB_STATIC_ALLOCATION
+    free(slave_interface_ptr);
+#endif
+    slave_interface_ptr = NULL;
+    return error;
+}
+
+/**
+ * Setup Modbus controller parameters
+ */
+esp_err_t mbc_slave_setup(void* comm_info)
+{
+    esp_err_t error = ESP_OK;
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK((slave_interface_ptr->setup != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    error = slave_interface_ptr->setup(comm_info);
+    MB_SLAVE_CHECK((error == ESP_OK),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave setup failure error=(0x%x).",
+                    (int)error);
+    return error;
+}
+
+/**
+ * Start Modbus controller start function
+ */
+esp_err_t mbc_slave_start(void)
+{
+    esp_err_t error = ESP_OK;
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK((slave_interface_ptr->start != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+#ifdef CONFIG_FMB_CONTROLLER_SLAVE_ID_SUPPORT
+    // Set the slave ID if the KConfig option is selected
+    eMBErrorCode status = eMBSetSlaveID(MB_SLAVE_ID_SHORT, TRUE, (UCHAR*)mb_slave_id, sizeof(mb_slave_id));
+    MB_SLAVE_CHECK((status == MB_ENOERR), ESP_ERR_INVALID_STATE, "mb stack set slave ID failure.");
+#endif
+    error = slave_interface_ptr->start();
+    MB_SLAVE_CHECK((error == ESP_OK),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave start failure error=(0x%x).",
+                    (int)error);
+    return error;
+}
+
+/**
+ * Blocking function to get event on parameter group change for application task
+ */
+mb_event_group_t mbc_slave_check_event(mb_event_group_t group)
+{
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    MB_EVENT_NO_EVENTS,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK((slave_interface_ptr->check_event != NULL),
+                    MB_EVENT_NO_EVENTS,
+                    "Slave interface is not correctly initialized.");
+    mb_event_group_t event = slave_interface_ptr->check_event(group);
+    return event;
+}
+
+/**
+ * Function to get notification about parameter change from application task
+ */
+esp_err_t mbc_slave_get_param_info(mb_param_info_t* reg_info, uint32_t timeout)
+{
+    esp_err_t error = ESP_OK;
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+#if CONFIG_FMB_CONTROLLER_NOTIFY_RING
+    MB_SLAVE_CHECK((reg_info != NULL), ESP_ERR_INVALID_ARG, "mb register information is invalid.");
+    error = mbc_slave_notify_ring_get(&slave_interface_ptr->opts.mbs_notification_ring, reg_info, timeout);
+#else
+    MB_SLAVE_CHECK((slave_interface_ptr->get_param_info != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    error = slave_interface_ptr->get_param_info(reg_info, timeout);
+#endif
+    MB_SLAVE_CHECK((error == ESP_OK),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave get parameter info failure error=(0x%x).",
+                    (int)error);
+    return error;
+}
+
+/**
+ * Function to get several notifications about parameter change from application task
+ */
+esp_err_t mbc_slave_get_param_info_batch(mb_param_info_t* reg_info, size_t max_count,
+                                            size_t* count, uint32_t timeout)
+{
+    esp_err_t error = ESP_OK;
+    size_t got = 0;
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK(((reg_info != NULL) && (count != NULL) && (max_count > 0)),
+                    ESP_ERR_INVALID_ARG, "mb register information is invalid.");
+#if CONFIG_FMB_CONTROLLER_NOTIFY_RING
+    mb_notify_ring_t* ring = &slave_interface_ptr->opts.mbs_notification_ring;
+    // Wait for the first entry then drain the rest without waiting
+    error = mbc_slave_notify_ring_get(ring, &reg_info[got], timeout);
+    while ((error == ESP_OK) && (++got < max_count)
+            && mbc_slave_notify_ring_pop(ring, &reg_info[got])) {};
+#else
+    MB_SLAVE_CHECK((slave_interface_ptr->get_param_info != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    error = slave_interface_ptr->get_param_info(&reg_info[got], timeout);
+    while ((error == ESP_OK) && (++got < max_count)
+            && (slave_interface_ptr->get_param_info(&reg_info[got], 0) == ESP_OK)) {};
+#endif
+    *count = got;
+    return error;
+}
+
+/**
+ * Function to get the number of lost parameter notifications
+ */
+esp_err_t mbc_slave_get_param_info_overflow(uint32_t* overflow_count)
+{
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK((overflow_count != NULL), ESP_ERR_INVALID_ARG, "mb incorrect argument.");
+    *overflow_count = slave_interface_ptr->opts.mbs_notification_overflow;
+    return ESP_OK;
+}
+
+/**
+ * Function to set area descriptors for modbus parameters
+ */
+esp_err_t mbc_slave_set_descriptor(mb_register_area_descriptor_t descr_data)
+{
+    return mbc_slave_set_descriptor_order(descr_data, MB_DESCR_ORDER_HOST);
+}
+
+/**
+ * Function to set area descriptors with the specified byte order of the storage area
+ */
+esp_err_t mbc_slave_set_descriptor_order(mb_register_area_descriptor_t descr_data, mb_descr_order_t order)
+{
+    return mbc_slave_add_descriptor(0, descr_data, order);
+}
+
+/**
+ * Function to remove the area descriptor of modbus parameters
+ */
+esp_err_t mbc_slave_remove_descriptor(mb_param_type_t type, uint16_t start_offset)
+{
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK((slave_interface_ptr->set_descriptor == NULL),
+                    ESP_ERR_NOT_SUPPORTED, "mb descriptors are kept by the port.");
+    MB_SLAVE_CHECK((type < MB_PARAM_COUNT), ESP_ERR_INVALID_ARG, "mb incorrect descriptor type.");
+    return mbc_slave_delete_descriptor(type, 0, start_offset);
+}
+
+/**
+ * Function to set area descriptors of the virtual slave address
+ */
+esp_err_t mbc_slave_set_addr_descriptor(uint8_t slave_addr, mb_register_area_descriptor_t descr_data)
+{
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK(((slave_addr >= MB_ADDRESS_MIN) && (slave_addr <= MB_ADDRESS_MAX)
+                    && (slave_addr != slave_interface_ptr->opts.mbs_comm.slave_addr)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect virtual slave address %u.", (unsigned)slave_addr);
+    MB_SLAVE_CHECK((slave_interface_ptr->set_descriptor == NULL),
+                    ESP_ERR_NOT_SUPPORTED, "mb virtual slaves are not supported by the port.");
+    esp_err_t error = mbc_slave_add_descriptor(slave_addr, descr_data, MB_DESCR_ORDER_HOST);
+    if (error != ESP_OK) {
+        return error;
+    }
+    // The address is served only once it has the area
+    eMBErrorCode status = eMBSetSlaveAddress(slave_addr, TRUE);
+    if (status != MB_ENOERR) {
+        (void)mbc_slave_delete_descriptor(descr_data.type, slave_addr, descr_data.start_offset);
+    }
+    MB_SLAVE_CHECK((status == MB_ENOERR), ESP_ERR_NO_MEM,
+                    "mb can not serve virtual slave address %u, (%u).", (unsigned)slave_addr, (unsigned)status);
+    return ESP_OK;
+}
+
+/**
+ * Function to start the TCP transport next to the serial slave
+ */
+esp_err_t mbc_slave_start_tcp(void* comm_info)
+{
+#if CONFIG_FMB_SLAVE_DUAL_TCP
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK((slave_interface_ptr->opts.port_type == MB_PORT_SERIAL_SLAVE),
+                    ESP_ERR_INVALID_STATE, "mb TCP transport requires the serial slave.");
+    MB_SLAVE_CHECK((!slave_tcp_started), ESP_ERR_INVALID_STATE, "mb TCP transport is started already.");
+    MB_SLAVE_CHECK((comm_info != NULL), ESP_ERR_INVALID_ARG, "mb wrong communication settings.");
+    const mb_communication_info_t* tcp_info = (const mb_communication_info_t*)comm_info;
+    MB_SLAVE_CHECK((MB_SLAVE_IP_MODE_VALID(tcp_info->ip_mode) && (tcp_info->ip_addr_type <= MB_IPV6)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect TCP options.");
+    eMBPortIpVer ip_ver = (tcp_info->ip_addr_type == MB_IPV4) ? MB_PORT_IPV4 : MB_PORT_IPV6;
+    vMBTCPPortSlaveSetNetOpt(tcp_info->ip_netif_ptr, ip_ver, MB_SLAVE_IP_MODE_PROTO(tcp_info->ip_mode),
+                                (CHAR*)tcp_info->ip_addr);
+#if MB_TCP_RTU_ENCAP_ENABLED
+    vMBTCPPortSlaveSetRtuFraming(MB_SLAVE_IP_MODE_RTU(tcp_info->ip_mode));
+#endif
+    MB_SLAVE_CHECK(xMBTCPPortInitDirect((USHORT)tcp_info->ip_port, (UCHAR)tcp_info->slave_uid),
+                    ESP_ERR_INVALID_STATE, "mb TCP port start failure.");
+    slave_tcp_started = true;
+    return ESP_OK;
+#else
+    (void)comm_info;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to get the counters of the TCP transport
+ */
+esp_err_t mbc_slave_get_tcp_stats(mb_slave_tcp_stats_t* stats)
+{
+#if CONFIG_FMB_SLAVE_DUAL_TCP
+    MB_SLAVE_CHECK((stats != NULL), ESP_ERR_INVALID_ARG, "mb incorrect stats pointer.");
+    MB_SLAVE_CHECK((slave_tcp_started), ESP_ERR_INVALID_STATE, "mb TCP transport is not started.");
+    MbSlavePortStats_t port_stats;
+    vMBTCPPortGetStats(&port_stats);
+    stats->requests = (uint32_t)port_stats.ulRequests;
+    stats->exceptions = (uint32_t)port_stats.ulExceptions;
+    stats->errors = (uint32_t)port_stats.ulErrors;
+    stats->connects = (uint32_t)port_stats.ulConnects;
+    stats->forwarded = (uint32_t)port_stats.ulForwarded;
+    stats->evictions = (uint32_t)port_stats.ulEvictions;
+    stats->throttled = (uint32_t)port_stats.ulThrottled;
+    stats->worker_reads = (uint32_t)port_stats.ulWorkerReads;
+    stats->clients = (uint16_t)port_stats.usClients;
+    return ESP_OK;
+#else
+    (void)stats;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to get the timers of the connected TCP clients
+ */
+esp_err_t mbc_slave_get_tcp_clients(mb_slave_tcp_client_t* clients, size_t max, size_t* count)
+{
+#if CONFIG_FMB_SLAVE_DUAL_TCP
+    MB_SLAVE_CHECK(((clients != NULL) || (max == 0)) && (count != NULL),
+                    ESP_ERR_INVALID_ARG, "mb incorrect clients pointer.");
+    MB_SLAVE_CHECK((slave_tcp_started), ESP_ERR_INVALID_STATE, "mb TCP transport is not started.");
+    _Static_assert(sizeof(clients->ip_addr) == MB_TCP_CLIENT_ADDR_LEN, "The client address size mismatch.");
+    // The clients are taken in small chunks to keep the stack usage of the caller low
+    MbSlavePortClientStats_t port_clients[4];
+    size_t copied = 0;
+    while (copied < max) {
+        size_t chunk = ((max - copied) < 4) ? (max - copied) : 4;
+        USHORT port_count = usMBTCPPortGetClients((USHORT)copied, port_clients, (USHORT)chunk);
+        for (USHORT i = 0; i < port_count; i++, copied++) {
+            memcpy(clients[copied].ip_addr, port_clients[i].cIpAddr, sizeof(clients[copied].ip_addr));
+            clients[copied].connected_ms = (uint32_t)port_clients[i].ulConnectedMs;
+            clients[copied].idle_ms = (uint32_t)port_clients[i].ulIdleMs;
+            clients[copied].last_request_ms = (uint32_t)port_clients[i].ulLastRequestMs;
+            clients[copied].requests = (uint32_t)port_clients[i].ulRequests;
+            clients[copied].throttled = (uint32_t)port_clients[i].ulThrottled;
+        }
+        if (port_count < chunk) {
+            break;
+        }
+    }
+    *count = copied;
+    return ESP_OK;
+#else
+    (void)clients;
+    (void)max;
+    (void)count;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to start an additional RTU port next to the serial slave
+ */
+esp_err_t mbc_slave_start_rtu(void* comm_info, int core_id, uint8_t* port_index)
+{
+#if CONFIG_FMB_SLAVE_RTU_PORTS
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK((slave_interface_ptr->opts.port_type == MB_PORT_SERIAL_SLAVE),
+                    ESP_ERR_INVALID_STATE, "mb RTU port requires the serial slave.");
+    MB_SLAVE_CHECK(((comm_info != NULL) && (port_index != NULL)), ESP_ERR_INVALID_ARG,
+                    "mb wrong communication settings.");
+    const mb_communication_info_t* rtu_info = (const mb_communication_info_t*)comm_info;
+    MB_SLAVE_CHECK(((rtu_info->mode == MB_MODE_RTU)
+                    && (rtu_info->slave_addr >= MB_ADDRESS_MIN) && (rtu_info->slave_addr <= MB_ADDRESS_MAX)
+                    && (rtu_info->port != slave_interface_ptr->opts.mbs_comm.port)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect RTU port options.");
+    UCHAR index = 0;
+    MB_SLAVE_CHECK(xMBRTUPortStart((UCHAR)rtu_info->port, (ULONG)rtu_info->baudrate, rtu_info->parity,
+                                    (UCHAR)rtu_info->slave_addr, (BaseType_t)core_id, &index),
+                    ESP_ERR_INVALID_STATE, "mb RTU port start failure.");
+    slave_rtu_ports |= BIT(index);
+    *port_index = (uint8_t)index;
+    return ESP_OK;
+#else
+    (void)comm_info;
+    (void)core_id;
+    (void)port_index;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to stop an additional RTU port
+ */
+esp_err_t mbc_slave_stop_rtu(uint8_t port_index)
+{
+#if CONFIG_FMB_SLAVE_RTU_PORTS
+    MB_SLAVE_CHECK(((port_index < CONFIG_FMB_SLAVE_RTU_PORTS) && (slave_rtu_ports & BIT(port_index))),
+                    ESP_ERR_INVALID_STATE, "mb RTU port is not started.");
+    (void)xMBRTUPortStop(port_index);
+    slave_rtu_ports &= ~BIT(port_index);
+    return ESP_OK;
+#else
+    (void)port_index;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to get the counters of an additional RTU port
+ */
+esp_err_t mbc_slave_get_rtu_stats(uint8_t port_index, mb_slave_rtu_stats_t* stats)
+{
+#if CONFIG_FMB_SLAVE_RTU_PORTS
+    MB_SLAVE_CHECK((stats != NULL), ESP_ERR_INVALID_ARG, "mb incorrect stats pointer.");
+    MbRTUPortStats_t port_stats;
+    MB_SLAVE_CHECK(xMBRTUPortGetStats(port_index, &port_stats),
+                    ESP_ERR_INVALID_STATE, "mb RTU port is not started.");
+    stats->requests = (uint32_t)port_stats.ulRequests;
+    stats->exceptions = (uint32_t)port_stats.ulExceptions;
+    stats->crc_errors = (uint32_t)port_stats.ulCRCErrors;
+    stats->not_addressed = (uint32_t)port_stats.ulNotAddressed;
+    stats->uart_errors = (uint32_t)port_stats.ulUartErrors;
+    return ESP_OK;
+#else
+    (void)port_index;
+    (void)stats;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+#if CONFIG_FMB_SLAVE_DUAL_TCP_FORWARD
+static mb_slave_tcp_forward_cb_t slave_tcp_forward_cb = NULL;
+
+// Forward handler of the TCP port, calls the handler of the application
+static BOOL mbc_slave_tcp_forward(ULONG tag, UCHAR unit_id, const UCHAR* pdu, USHORT pdu_len, void* arg)
+{
+    return slave_tcp_forward_cb(tag, unit_id, pdu, pdu_len, arg) ? TRUE : FALSE;
+}
+#endif
+
+/**
+ * Function to set the handler of the TCP requests for other unit identifiers
+ */
+esp_err_t mbc_slave_set_tcp_forward(mb_slave_tcp_forward_cb_t cb, void* arg)
+{
+#if CONFIG_FMB_SLAVE_DUAL_TCP_FORWARD
+    vMBTCPPortSetForward(NULL, NULL);
+    slave_tcp_forward_cb = cb;
+    if (cb != NULL) {
+        vMBTCPPortSetForward(mbc_slave_tcp_forward, arg);
+    }
+    return ESP_OK;
+#else
+    (void)cb;
+    (void)arg;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to send the response of the forwarded TCP request
+ */
+esp_err_t mbc_slave_tcp_forward_done(uint32_t tag, uint8_t unit_id, const uint8_t* pdu, uint16_t pdu_len)
+{
+#if CONFIG_FMB_SLAVE_DUAL_TCP_FORWARD
+    MB_SLAVE_CHECK(((pdu != NULL) && (pdu_len > 0) && (pdu_len <= MB_PDU_SIZE_MAX)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect forwarded response.");
+    return xMBTCPPortForwardDone((ULONG)tag, (UCHAR)unit_id, (const UCHAR*)pdu, (USHORT)pdu_len)
+                ? ESP_OK : ESP_ERR_INVALID_STATE;
+#else
+    (void)tag;
+    (void)unit_id;
+    (void)pdu;
+    (void)pdu_len;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to get the request counters of the slave address
+ */
+esp_err_t mbc_slave_get_addr_stats(uint8_t slave_addr, mb_slave_addr_stats_t* stats)
+{
+    MB_SLAVE_CHECK((stats != NULL), ESP_ERR_INVALID_ARG, "mb incorrect stats pointer.");
+    ULONG requests = 0;
+    ULONG exceptions = 0;
+    MB_SLAVE_CHECK(xMBGetSlaveStats(slave_addr, &requests, &exceptions),
+                    ESP_ERR_NOT_FOUND, "mb slave address %u is not served.", (unsigned)slave_addr);
+    stats->requests = (uint32_t)requests;
+    stats->exceptions = (uint32_t)exceptions;
+    return ESP_OK;
+}
+
+// Adds the area descriptor of the slave address (0 for the slave address of the port)
+static esp_err_t mbc_slave_add_descriptor(uint8_t slave_addr, mb_register_area_descriptor_t descr_data,
+                                            mb_descr_order_t order)
+{
+    esp_err_t error = ESP_OK;
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK(((order == MB_DESCR_ORDER_HOST)
+                    || ((order == MB_DESCR_ORDER_WIRE) && (slave_interface_ptr->set_descriptor == NULL)
+                        && ((descr_data.type == MB_PARAM_HOLDING) || (descr_data.type == MB_PARAM_INPUT)))),
+                    ESP_ERR_INVALID_ARG, "mb wire order is supported for register areas only.");
+
+    if (slave_interface_ptr->set_descriptor != NULL) {
+        error = slave_interface_ptr->set_descriptor(descr_data);
+        MB_SLAVE_CHECK((error == ESP_OK),
+                        ESP_ERR_INVALID_STATE,
+                        "Slave set descriptor failure error=(0x%x).",
+                        (int)error);
+    } else {
+        mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+        MB_SLAVE_CHECK((descr_data.type < MB_PARAM_COUNT), ESP_ERR_INVALID_ARG, "mb incorrect descriptor type.");
+#if !CONFIG_FMB_CONTROLLER_DESCR_INDEX
+        // Check if the address is already in the descriptor list
+        mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(descr_data.type, slave_addr, descr_data.start_offset, 1);
+        MB_SLAVE_CHECK((it == NULL), ESP_ERR_INVALID_ARG, "mb incorrect descriptor or already defined.");
+#else
+        MB_SLAVE_CHECK(((descr_data.address != NULL) && (REG_SIZE(descr_data.type, descr_data.size) >= 1)),
+                        ESP_ERR_INVALID_ARG, "mb incorrect descriptor data.");
+#endif
+
+        mb_descr_entry_t* new_descr = (mb_descr_entry_t*) heap_caps_malloc(sizeof(mb_descr_entry_t),
+                                            MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+        MB_SLAVE_CHECK((new_descr != NULL), ESP_ERR_NO_MEM, "mb can not allocate memory for descriptor.");
+        new_descr->slave_addr = slave_addr;
+        new_descr->start_offset = descr_data.start_offset;
+        new_descr->type = descr_data.type;
+        new_descr->p_data = descr_data.address;
+        new_descr->size = descr_data.size;
+        new_descr->end_offset = (uint32_t)descr_data.start_offset + (REG_SIZE(descr_data.type, descr_data.size));
+        new_descr->wire_order = (order == MB_DESCR_ORDER_WIRE);
+        new_descr->lock = NULL;
+        new_descr->commit_lock = (mb_seqlock_t)MB_SEQLOCK_INIT();
+        new_descr->computed = NULL;
+        new_descr->computed_count = 0;
+        new_descr->bindings = NULL;
+        new_descr->binding_count = 0;
+        new_descr->access = NULL;
+        new_descr->access_count = 0;
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+        new_descr->cache = NULL;
+#endif
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
+        new_descr->tracker = NULL;
+#endif
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+        new_descr->hooks = NULL;
+#endif
+#if CONFIG_FMB_CONTROLLER_DESCR_INDEX
+        error = mbc_slave_insert_reg_index(new_descr);
+        if (error != ESP_OK) {
+            free(new_descr);
+            return error;
+        }
+#endif
+        LIST_INSERT_HEAD(&mbs_opts->mbs_area_descriptors[descr_data.type], new_descr, entries);
+        vMBRespCacheFlush(); // the area may cover the registers of the stored responses
+        error = ESP_OK;
+    }
+    return error;
+}
+
+/**
+ * Function to attach the sequence lock to the registers area descriptor
+ */
+esp_err_t mbc_slave_set_descriptor_lock(mb_param_type_t type, uint16_t start_offset, mb_seqlock_t* lock)
+{
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK(((type == MB_PARAM_HOLDING) || (type == MB_PARAM_INPUT)),
+                    ESP_ERR_INVALID_ARG, "mb lock is supported for register areas only.");
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, 0, start_offset, 1);
+    MB_SLAVE_CHECK(((it != NULL) && (it->start_offset == start_offset)),
+                    ESP_ERR_INVALID_ARG, "mb area with offset %u is not found.", (unsigned)start_offset);
+    it->lock = lock;
+    vMBRespCacheFlush();
+    return ESP_OK;
+}
+
+/**
+ * Function to attach the computed registers to the registers area descriptor
+ */
+esp_err_t mbc_slave_set_descriptor_computed(mb_param_type_t type, uint16_t start_offset,
+                                                mb_computed_reg_t* regs, size_t count)
+{
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK(((type == MB_PARAM_HOLDING) || (type == MB_PARAM_INPUT)),
+                    ESP_ERR_INVALID_ARG, "mb computed registers are supported for register areas only.");
+    MB_SLAVE_CHECK(((regs != NULL) || (count == 0)) && (count <= UINT16_MAX),
+                    ESP_ERR_INVALID_ARG, "mb incorrect computed registers table.");
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, 0, start_offset, 1);
+    MB_SLAVE_CHECK(((it != NULL) && (it->start_offset == start_offset)),
+                    ESP_ERR_INVALID_ARG, "mb area with offset %u is not found.", (unsigned)start_offset);
+    for (size_t i = 0; i < count; i++) {
+        MB_SLAVE_CHECK(((regs[i].getter != NULL)
+                        && (regs[i].reg_count >= 1) && (regs[i].reg_count <= MB_COMPUTED_REGS_MAX)
+                        && (((uint32_t)regs[i].reg_offset + regs[i].reg_count) <= (it->size >> 1))),
+                        ESP_ERR_INVALID_ARG, "mb incorrect computed register entry %u.", (unsigned)i);
+        regs[i].expires_us = 0;
+    }
+    it->computed = regs;
+    it->computed_count = (uint16_t)count;
+    vMBRespCacheFlush();
+    return ESP_OK;
+}
+
+/**
+ * Function to bind the application variables to the registers area descriptor
+ */
+esp_err_t mbc_slave_set_descriptor_binding(mb_param_type_t type, uint16_t start_offset,
+                                            const mb_reg_binding_t* binds, size_t count)
+{
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK(((type == MB_PARAM_HOLDING) || (type == MB_PARAM_INPUT)),
+                    ESP_ERR_INVALID_ARG, "mb bindings are supported for register areas only.");
+    MB_SLAVE_CHECK(((binds != NULL) || (count == 0)) && (count <= UINT16_MAX),
+                    ESP_ERR_INVALID_ARG, "mb incorrect bindings table.");
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, 0, start_offset, 1);
+    MB_SLAVE_CHECK(((it != NULL) && (it->start_offset == start_offset)),
+                    ESP_ERR_INVALID_ARG, "mb area with offset %u is not found.", (unsigned)start_offset);
+    for (size_t i = 0; i < count; i++) {
+        static const uint8_t var_size[MB_BIND_TYPE_COUNT] = { 1, 1, 2, 2, 4, 4, 4 };
+        MB_SLAVE_CHECK(((binds[i].type < MB_BIND_TYPE_COUNT) && (binds[i].order <= MB_BIND_ORDER_DCBA)
+                        && (binds[i].ptr != NULL) && !((uintptr_t)binds[i].ptr & (var_size[binds[i].type] - 1))
+                        && (((uint32_t)binds[i].reg_offset + mbc_slave_binding_regs(&binds[i])) <= (it->size >> 1))),
+                        ESP_ERR_INVALID_ARG, "mb incorrect binding entry %u.", (unsigned)i);
+    }
+    it->bindings = binds;
+    it->binding_count = (uint16_t)count;
+    vMBRespCacheFlush();
+    return ESP_OK;
+}
+
+/**
+ * Function to attach the access rules to the registers area descriptor
+ */
+esp_err_t mbc_slave_set_descriptor_access(mb_param_type_t type, uint16_t start_offset,
+                                            const mb_reg_access_t* rules, size_t count)
+{
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK(((type == MB_PARAM_HOLDING) || (type == MB_PARAM_COIL)),
+                    ESP_ERR_INVALID_ARG, "mb access rules are supported for holding and coil areas only.");
+    MB_SLAVE_CHECK(((rules != NULL) || (count == 0)) && (count <= UINT16_MAX),
+                    ESP_ERR_INVALID_ARG, "mb incorrect access rules table.");
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, 0, start_offset, 1);
+    MB_SLAVE_CHECK(((it != NULL) && (it->start_offset == start_offset)),
+                    ESP_ERR_INVALID_ARG, "mb area with offset %u is not found.", (unsigned)start_offset);
+    for (size_t i = 0; i < count; i++) {
+        MB_SLAVE_CHECK(((rules[i].reg_count >= 1)
+                        && (((uint32_t)it->start_offset + rules[i].reg_offset + rules[i].reg_count) <= it->end_offset)
+                        && (!(rules[i].access & MB_ACCESS_RANGE) || (type == MB_PARAM_HOLDING))),
+                        ESP_ERR_INVALID_ARG, "mb incorrect access rule entry %u.", (unsigned)i);
+    }
+    it->access = rules;
+    it->access_count = (uint16_t)count;
+    vMBRespCacheFlush();
+    return ESP_OK;
+}
+
+/**
+ * Function to allocate the storage of register area with the placement hint
+ */
+void* mbc_slave_alloc_area(size_t size, mb_area_place_t place)
+{
+    void* area = NULL;
+    if ((place == MB_AREA_PLACE_PSRAM)
+        || ((place == MB_AREA_PLACE_AUTO) && (size > MB_AREA_INTERNAL_MAX_SIZE))) {
+        area = heap_caps_aligned_calloc(MB_AREA_ALIGN, 1, size, MALLOC_CAP_SPIRAM|MALLOC_CAP_8BIT);
+    }
+    if (area == NULL) {
+        area = heap_caps_aligned_calloc(MB_AREA_ALIGN, 1, size, MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+    }
+    return area;
+}
+
+/**
+ * Function to free the storage of register area
+ */
+void mbc_slave_free_area(void* area)
+{
+    heap_caps_free(area);
+}
+
+/**
+ * Function to attach the synchronous hooks to the registers area descriptor
+ */
+esp_err_t mbc_slave_set_descriptor_hooks(mb_param_type_t type, uint16_t start_offset, const mb_area_hooks_t* hooks)
+{
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK(((type == MB_PARAM_HOLDING) || (type == MB_PARAM_INPUT)),
+                    ESP_ERR_INVALID_ARG, "mb area hooks are supported for register areas only.");
+    MB_SLAVE_CHECK(((hooks == NULL) || (hooks->pre_read != NULL)
+                    || ((hooks->post_write != NULL) && (type == MB_PARAM_HOLDING))),
+                    ESP_ERR_INVALID_ARG, "mb incorrect area hooks.");
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, 0, start_offset, 1);
+    MB_SLAVE_CHECK(((it != NULL) && (it->start_offset == start_offset)),
+                    ESP_ERR_INVALID_ARG, "mb area with offset %u is not found.", (unsigned)start_offset);
+    mb_area_hook_state_t* state = it->hooks;
+    if (state == NULL) {
+        if (hooks == NULL) {
+            return ESP_OK;
+        }
+        // The state is kept until the descriptors are freed, the Modbus task may use it any time
+        state = (mb_area_hook_state_t*) heap_caps_calloc(1, sizeof(mb_area_hook_state_t),
+                                        MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+        MB_SLAVE_CHECK((state != NULL), ESP_ERR_NO_MEM, "mb can not allocate memory for area hooks.");
+        state->hooks = *hooks;
+        it->hooks = state;
+        vMBRespCacheFlush();
+        return ESP_OK;
+    }
+    portENTER_CRITICAL(&mbc_slave_hook_mux);
+    if (hooks != NULL) {
+        state->hooks = *hooks;
+    } else {
+        memset(&state->hooks, 0, sizeof(state->hooks));
+    }
+    memset(state->stats, 0, sizeof(state->stats));
+    memset(state->overrun_run, 0, sizeof(state->overrun_run));
+    portEXIT_CRITICAL(&mbc_slave_hook_mux);
+    return ESP_OK;
+#else
+    (void)type;
+    (void)start_offset;
+    (void)hooks;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to get the timing statistics of the area hooks
+ */
+esp_err_t mbc_slave_get_hook_stats(mb_param_type_t type, uint16_t start_offset,
+                                    mb_area_hook_stats_t* pre_read, mb_area_hook_stats_t* post_write)
+{
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK(((type == MB_PARAM_HOLDING) || (type == MB_PARAM_INPUT)),
+                    ESP_ERR_INVALID_ARG, "mb area hooks are supported for register areas only.");
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, 0, start_offset, 1);
+    MB_SLAVE_CHECK(((it != NULL) && (it->start_offset == start_offset)),
+                    ESP_ERR_INVALID_ARG, "mb area with offset %u is not found.", (unsigned)start_offset);
+    mb_area_hook_state_t* state = it->hooks;
+    if (state == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    portENTER_CRITICAL(&mbc_slave_hook_mux);
+    if (pre_read) {
+        *pre_read = state->stats[MB_AREA_HOOK_PRE_READ];
+    }
+    if (post_write) {
+        *post_write = state->stats[MB_AREA_HOOK_POST_WRITE];
+    }
+    portEXIT_CRITICAL(&mbc_slave_hook_mux);
+    return ESP_OK;
+#else
+    (void)type;
+    (void)start_offset;
+    (void)pre_read;
+    (void)post_write;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to attach the hot block cache to the registers area descriptor
+ */
+esp_err_t mbc_slave_set_descriptor_cache(mb_param_type_t type, uint16_t start_offset, size_t slots)
+{
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK(((type == MB_PARAM_HOLDING) || (type == MB_PARAM_INPUT)) && (slots <= UINT8_MAX),
+                    ESP_ERR_INVALID_ARG, "mb area cache is supported for register areas only.");
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, 0, start_offset, 1);
+    MB_SLAVE_CHECK(((it != NULL) && (it->start_offset == start_offset)),
+                    ESP_ERR_INVALID_ARG, "mb area with offset %u is not found.", (unsigned)start_offset);
+    MB_SLAVE_CHECK((it->cache == NULL),
+                    ESP_ERR_INVALID_STATE, "mb area with offset %u already has a cache.", (unsigned)start_offset);
+    uint16_t blocks = (uint16_t)(((it->size >> 1) + MB_AREA_CACHE_BLOCK_REGS - 1) >> MB_AREA_CACHE_BLOCK_SHIFT);
+    slots = (slots < blocks) ? slots : blocks;
+    mb_area_cache_t* cache = (mb_area_cache_t*) heap_caps_calloc(1, sizeof(mb_area_cache_t)
+                                        + (slots * sizeof(mb_area_cache_slot_t))
+                                        + (blocks * sizeof(uint32_t)) + blocks,
+                                        MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+    MB_SLAVE_CHECK((cache != NULL), ESP_ERR_NO_MEM, "mb can not allocate memory for area cache.");
+    cache->mutex = xSemaphoreCreateMutexStatic(&cache->mutex_buf);
+    cache->blocks = blocks;
+    cache->slot_count = (uint16_t)slots;
+    cache->slots = (mb_area_cache_slot_t*)(cache + 1);
+    cache->heat = (uint32_t*)(cache->slots + slots);
+    cache->slot_of_block = (uint8_t*)(cache->heat + blocks);
+    it->cache = cache;
+    ESP_LOGD(TAG, "mb area %u: %u blocks in %s, %u cached.", (unsigned)start_offset, (unsigned)blocks,
+                esp_ptr_external_ram(it->p_data) ? "PSRAM" : "internal RAM", (unsigned)slots);
+    return ESP_OK;
+#else
+    (void)type;
+    (void)start_offset;
+    (void)slots;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to get the read statistics of the area with the cache
+ */
+esp_err_t mbc_slave_get_area_stats(mb_param_type_t type, uint16_t start_offset, mb_area_cache_stats_t* stats,
+                                        uint32_t* heat, size_t max_heat)
+{
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK(((type == MB_PARAM_HOLDING) || (type == MB_PARAM_INPUT)) && (stats != NULL)
+                    && ((heat != NULL) || (max_heat == 0)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect area statistics arguments.");
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, 0, start_offset, 1);
+    MB_SLAVE_CHECK(((it != NULL) && (it->start_offset == start_offset)),
+                    ESP_ERR_INVALID_ARG, "mb area with offset %u is not found.", (unsigned)start_offset);
+    mb_area_cache_t* cache = it->cache;
+    if (cache == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t count = (max_heat < cache->blocks) ? max_heat : cache->blocks;
+    (void)xSemaphoreTake(cache->mutex, portMAX_DELAY);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->cached = cache->cached;
+    for (size_t i = 0; i < count; i++) {
+        heat[i] = cache->heat[i];
+    }
+    (void)xSemaphoreGive(cache->mutex);
+    stats->block_regs = MB_AREA_CACHE_BLOCK_REGS;
+    stats->blocks = cache->blocks;
+    stats->slots = cache->slot_count;
+    stats->psram = esp_ptr_external_ram(it->p_data);
+    return ESP_OK;
+#else
+    (void)type;
+    (void)start_offset;
+    (void)stats;
+    (void)heat;
+    (void)max_heat;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to get the turnaround latency histograms
+ */
+esp_err_t mbc_slave_get_latency(mb_latency_hist_t* hist, size_t max_count, size_t* count)
+{
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+    MB_SLAVE_CHECK(((hist != NULL) && (count != NULL)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect latency arguments.");
+    *count = mb_port_latency_get(hist, max_count);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to clear the turnaround latency histograms
+ */
+esp_err_t mbc_slave_reset_latency(void)
+{
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+    mb_port_latency_reset();
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to get the power management statistics of the serial port
+ */
+esp_err_t mbc_slave_get_pm_stats(mb_serial_pm_stats_t* stats)
+{
+#if CONFIG_FMB_SERIAL_PM_LOCK
+    MB_SLAVE_CHECK((stats != NULL), ESP_ERR_INVALID_ARG, "mb incorrect statistics pointer.");
+    mb_port_pm_get(stats);
+    return ESP_OK;
+#else
+    (void)stats;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to get the frames of the frame trace ring
+ */
+esp_err_t mbc_slave_get_frames(uint32_t since_seq, mb_frame_record_t* records, size_t max_count,
+                                    size_t* count, uint32_t* last_seq)
+{
+#if CONFIG_FMB_FRAME_TRACE
+    MB_SLAVE_CHECK(((records != NULL) && (count != NULL) && (last_seq != NULL)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect frame trace arguments.");
+    *count = mb_port_trace_get(since_seq, records, max_count, last_seq);
+    return ESP_OK;
+#else
+    (void)since_seq;
+    (void)records;
+    (void)max_count;
+    (void)count;
+    (void)last_seq;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to start or stop the frame recording
+ */
+esp_err_t mbc_slave_set_frame_trace(bool enable)
+{
+#if CONFIG_FMB_FRAME_TRACE
+    mb_port_trace_enable(enable);
+    return ESP_OK;
+#else
+    (void)enable;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to get the record of the frame trace slot
+ */
+esp_err_t mbc_slave_get_frame_slot(uint16_t slot, mb_frame_record_t* record)
+{
+#if CONFIG_FMB_FRAME_TRACE
+    MB_SLAVE_CHECK(((record != NULL) && (slot < CONFIG_FMB_FRAME_TRACE_RING_SIZE)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect frame slot arguments.");
+    return mb_port_trace_get_slot(slot, record) ? ESP_OK : ESP_ERR_NOT_FOUND;
+#else
+    (void)slot;
+    (void)record;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+// Custom function code handlers, called through the stack handler below
+static mb_func_handler_t mbc_slave_func_handlers[MB_FUNC_CODE_COUNT] = { NULL };
+
+static eMBException mbc_slave_custom_handler(UCHAR* frame, USHORT* length)
+{
+    mb_func_handler_t handler = mbc_slave_func_handlers[frame[MB_PDU_FUNC_OFF] & MB_FUNC_CODE_MAX];
+    return (handler != NULL) ? (eMBException)handler(frame, length) : MB_EX_ILLEGAL_FUNCTION;
+}
+
+/**
+ * Function to register the function code handler
+ */
+esp_err_t mbc_slave_set_handler(uint8_t func_code, mb_func_handler_t handler)
+{
+    MB_SLAVE_CHECK(((func_code > 0) && (func_code <= MB_FUNC_CODE_MAX)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect function code %u.", (unsigned)func_code);
+    mbc_slave_func_handlers[func_code] = handler;
+    eMBErrorCode status = eMBRegisterCB(func_code, (handler != NULL) ? mbc_slave_custom_handler : NULL);
+    MB_SLAVE_CHECK((status == MB_ENOERR), ESP_ERR_INVALID_ARG,
+                    "mb function code %u register failure, (%u).", (unsigned)func_code, (unsigned)status);
+    return ESP_OK;
+}
+
+#if CONFIG_FMB_CONTROLLER_FILE_RECORD_SUPPORT
+#define MB_FILE_RECORDS_MAX         (10000) // Record numbers 0 - 9999 of the specification
 
-#define REG_SIZE(type, nregs) ((type == MB_PARAM_INPUT) || (type == MB_PARAM_HOLDING)) ? (nregs >> 1) : (nregs << 3)
+typedef struct {
+    uint16_t number;                        // File number, 0 if the entry is free
+    mb_file_descriptor_t file;
+} mb_file_entry_t;
 
-// Common interface pointer for slave port
-static mb_slave_interface_t* slave_interface_ptr = NULL;
-static const char TAG[] __attribute__((unused)) = "MB_CONTROLLER_SLAVE";
+// The port tasks copy the entry under the lock and call the callbacks outside of it
+static mb_file_entry_t mbc_slave_files[CONFIG_FMB_CONTROLLER_FILES_MAX];
+static portMUX_TYPE mbc_slave_file_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
 
-// Searches the register in the area specified by type, returns descriptor if found, else NULL
-static mb_descr_entry_t* mbc_slave_find_reg_descriptor(mb_param_type_t type, uint16_t addr, size_t regs)
+/**
+ * Function to register the file of the file record functions
+ */
+esp_err_t mbc_slave_set_file(uint16_t file_number, const mb_file_descriptor_t* file)
 {
-    mb_descr_entry_t* it;
-    uint16_t reg_size = 0;
-
-    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
-
-    if (LIST_EMPTY(&mbs_opts->mbs_area_descriptors[type])) {
-        return NULL;
+#if CONFIG_FMB_CONTROLLER_FILE_RECORD_SUPPORT
+    MB_SLAVE_CHECK((file_number != 0), ESP_ERR_INVALID_ARG, "mb incorrect file number.");
+    MB_SLAVE_CHECK(((file == NULL) || ((file->records > 0) && (file->records <= MB_FILE_RECORDS_MAX)
+                    && ((file->read != NULL) || (file->write != NULL)))),
+                    ESP_ERR_INVALID_ARG, "mb incorrect file %u descriptor.", (unsigned)file_number);
+    esp_err_t err = (file == NULL) ? ESP_OK : ESP_ERR_NO_MEM;
+    int free_idx = -1;
+    portENTER_CRITICAL(&mbc_slave_file_lock);
+    for (int i = 0; i < CONFIG_FMB_CONTROLLER_FILES_MAX; i++) {
+        if (mbc_slave_files[i].number == file_number) {
+            free_idx = i;
+            break;
+        }
+        if ((mbc_slave_files[i].number == 0) && (free_idx < 0)) {
+            free_idx = i;
+        }
+    }
+    if (file == NULL) {
+        if ((free_idx >= 0) && (mbc_slave_files[free_idx].number == file_number)) {
+            mbc_slave_files[free_idx].number = 0;
+        }
+    } else if (free_idx >= 0) {
+        mbc_slave_files[free_idx].number = file_number;
+        mbc_slave_files[free_idx].file = *file;
+        err = ESP_OK;
     }
+    portEXIT_CRITICAL(&mbc_slave_file_lock);
+    return err;
+#else
+    (void)file_number;
+    (void)file;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
 
-    // search for the register in each area
-    for (it = LIST_FIRST(&mbs_opts->mbs_area_descriptors[type]); it != NULL; it = LIST_NEXT(it, entries)) {
-        reg_size = REG_SIZE(type, it->size);
-        if ((addr >= it->start_offset)
-            && (it->p_data)
-            && (regs >= 1)
-            && ((addr + regs) <= (it->start_offset + reg_size))
-            && (reg_size >= 1)) {
-            return it;
+#if CONFIG_FMB_CONTROLLER_FILE_RECORD_SUPPORT
+/**
+ * Stack callback of the file record functions
+ */
+eMBErrorCode eMBRegFileCB(UCHAR* pucRecBuffer, USHORT usFile, USHORT usRecord,
+                            USHORT usNRecords, eMBRegisterMode eMode)
+{
+    mb_file_descriptor_t file = { 0 };
+    portENTER_CRITICAL(&mbc_slave_file_lock);
+    for (int i = 0; i < CONFIG_FMB_CONTROLLER_FILES_MAX; i++) {
+        if (mbc_slave_files[i].number == usFile) {
+            file = mbc_slave_files[i].file;
+            break;
         }
     }
-    return NULL;
+    portEXIT_CRITICAL(&mbc_slave_file_lock);
+    if (((uint32_t)usRecord + usNRecords) > file.records) {
+        return MB_ENOREG;
+    }
+    if (pucRecBuffer == NULL) {
+        // Check only, the file has the records and the callback of the mode
+        return (((eMode == MB_REG_READ) ? (file.read != NULL) : (file.write != NULL)) ? MB_ENOERR : MB_ENOREG);
+    }
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if ((eMode == MB_REG_READ) && (file.read != NULL)) {
+        err = file.read(usRecord, usNRecords, pucRecBuffer, file.arg);
+    } else if ((eMode == MB_REG_WRITE) && (file.write != NULL)) {
+        err = file.write(usRecord, usNRecords, pucRecBuffer, file.arg);
+    }
+    switch (err) {
+        case ESP_OK:
+            return MB_ENOERR;
+        case ESP_ERR_TIMEOUT:
+            return MB_ETIMEDOUT;
+        case ESP_ERR_NOT_FOUND:
+        case ESP_ERR_INVALID_ARG:
+            return MB_ENOREG;
+        default:
+            return MB_EIO;
+    }
 }
+#endif
 
-static void mbc_slave_free_descriptors(void) {
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
 
-    mb_descr_entry_t* it;
-    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+#define MB_CHANGES_REQ_LEN          (6) // Function code, table, sequence
+#define MB_CHANGES_RSP_HDR_LEN      (7) // Function code, table, resume sequence, count
+#define MB_CHANGES_TABLE_HOLDING    (3)
+#define MB_CHANGES_TABLE_INPUT      (4)
 
-    for (int descr_type = 0; descr_type < MB_PARAM_COUNT; descr_type++) {
-        while ((it = LIST_FIRST(&mbs_opts->mbs_area_descriptors[descr_type]))) {
-            LIST_REMOVE(it, entries);
-            free(it);
+// Get the register of descriptor in host byte order
+static uint16_t mbc_slave_get_reg_value(const mb_descr_entry_t* it, uint16_t reg)
+{
+    uint16_t value;
+    mb_seqlock_t* lock = mbc_slave_area_lock(it);
+    uint32_t seq;
+    do {
+        seq = mb_seqlock_read_begin(lock);
+        memcpy(&value, (const uint16_t*)it->p_data + reg, sizeof(value));
+    } while (mb_seqlock_read_retry(lock, seq));
+    return it->wire_order ? __builtin_bswap16(value) : value;
+}
+
+// Compare the marked registers of descriptor with the reported values, the registers
+// which moved beyond the deadband get the next sequence number (called in the critical section)
+static void mbc_slave_scan_changes(const mb_descr_entry_t* it)
+{
+    mb_change_tracker_t* tracker = it->tracker;
+    for (uint16_t word = 0; word < ((tracker->regs + 31) >> 5); word++) {
+        uint32_t bits = tracker->dirty[word];
+        tracker->dirty[word] = 0;
+        while (bits) {
+            uint16_t reg = (uint16_t)((word << 5) + __builtin_ctz(bits));
+            bits &= (bits - 1);
+            uint16_t value = mbc_slave_get_reg_value(it, reg);
+            uint16_t shadow = tracker->shadow[reg];
+            uint16_t delta = (value > shadow) ? (value - shadow) : (shadow - value);
+            if (delta > (tracker->deadband ? tracker->deadband[reg] : 0)) {
+                tracker->shadow[reg] = value;
+                tracker->seq[reg] = ++mbc_slave_change_seq;
+            }
         }
     }
 }
 
-void mbc_slave_init_iface(void* handler)
+// Handler of the change query function code
+static uint8_t mbc_slave_change_query_handler(uint8_t* frame, uint16_t* length)
 {
-    slave_interface_ptr = (mb_slave_interface_t*) handler;
-    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
-    // Initialize list head for register areas
-    LIST_INIT(&mbs_opts->mbs_area_descriptors[MB_PARAM_INPUT]);
-    LIST_INIT(&mbs_opts->mbs_area_descriptors[MB_PARAM_HOLDING]);
-    LIST_INIT(&mbs_opts->mbs_area_descriptors[MB_PARAM_COIL]);
-    LIST_INIT(&mbs_opts->mbs_area_descriptors[MB_PARAM_DISCRETE]);
+    if (*length != MB_CHANGES_REQ_LEN) {
+        return MB_EX_ILLEGAL_DATA_VALUE;
+    }
+    uint8_t table = frame[MB_PDU_DATA_OFF];
+    mb_param_type_t type = (table == MB_CHANGES_TABLE_HOLDING) ? MB_PARAM_HOLDING
+                                : (table == MB_CHANGES_TABLE_INPUT) ? MB_PARAM_INPUT : MB_PARAM_COUNT;
+    // The virtual slave addresses have no tracked areas
+    if ((type == MB_PARAM_COUNT) || (ucMBGetRequestAddress() != 0)) {
+        return MB_EX_ILLEGAL_DATA_ADDRESS;
+    }
+    const uint8_t* data = &frame[MB_PDU_DATA_OFF + 1];
+    uint32_t since_seq = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16)
+                            | ((uint32_t)data[2] << 8) | data[3];
+    mb_reg_change_t changes[MB_CHANGES_PDU_MAX];
+    size_t count = 0;
+    uint32_t resume_seq = 0;
+    if (mbc_slave_get_changes(type, since_seq, changes, MB_CHANGES_PDU_MAX, &count, &resume_seq) != ESP_OK) {
+        return MB_EX_ILLEGAL_DATA_ADDRESS;
+    }
+    uint8_t* rsp = &frame[MB_PDU_DATA_OFF + 1];
+    *rsp++ = (uint8_t)(resume_seq >> 24);
+    *rsp++ = (uint8_t)(resume_seq >> 16);
+    *rsp++ = (uint8_t)(resume_seq >> 8);
+    *rsp++ = (uint8_t)resume_seq;
+    *rsp++ = (uint8_t)count;
+    for (size_t i = 0; i < count; i++) {
+        *rsp++ = (uint8_t)(changes[i].address >> 8);
+        *rsp++ = (uint8_t)changes[i].address;
+        *rsp++ = (uint8_t)(changes[i].value >> 8);
+        *rsp++ = (uint8_t)changes[i].value;
+    }
+    *length = (uint16_t)(MB_CHANGES_RSP_HDR_LEN + (count << 2));
+    return MB_EX_NONE;
 }
 
+#endif
+
 /**
- * Modbus controller destroy function
+ * Function to enable the change tracking of the registers area descriptor
  */
-esp_err_t mbc_slave_destroy(void)
+esp_err_t mbc_slave_set_descriptor_tracking(mb_param_type_t type, uint16_t start_offset, const uint16_t* deadband)
 {
-    esp_err_t error = ESP_OK;
-    // Is initialization done?
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
     MB_SLAVE_CHECK((slave_interface_ptr != NULL),
                     ESP_ERR_INVALID_STATE,
                     "Slave interface is not correctly initialized.");
-    // Check if interface has been initialized
-    MB_SLAVE_CHECK((slave_interface_ptr->destroy != NULL),
-                    ESP_ERR_INVALID_STATE,
-                    "Slave interface is not correctly initialized.");
-    // Call the slave port destroy function
-    error = slave_interface_ptr->destroy();
-    MB_SLAVE_CHECK((error == ESP_OK),
-                    ESP_ERR_INVALID_STATE,
-                    "Slave destroy failure error=(0x%x).",
-                    (int)error);
-    // Destroy all opened descriptors
-    mbc_slave_free_descriptors();
-    free(slave_interface_ptr);
-    slave_interface_ptr = NULL;
-    return error;
+    MB_SLAVE_CHECK(((type == MB_PARAM_HOLDING) || (type == MB_PARAM_INPUT)),
+                    ESP_ERR_INVALID_ARG, "mb change tracking is supported for register areas only.");
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, 0, start_offset, 1);
+    MB_SLAVE_CHECK(((it != NULL) && (it->start_offset == start_offset)),
+                    ESP_ERR_INVALID_ARG, "mb area with offset %u is not found.", (unsigned)start_offset);
+    MB_SLAVE_CHECK((it->tracker == NULL),
+                    ESP_ERR_INVALID_STATE, "mb area with offset %u is already tracked.", (unsigned)start_offset);
+    uint16_t regs = (uint16_t)(it->size >> 1);
+    size_t words = (regs + 31) >> 5;
+    mb_change_tracker_t* tracker = (mb_change_tracker_t*) heap_caps_calloc(1, sizeof(mb_change_tracker_t)
+                                        + (words << 2) + (regs << 2) + (regs << 1),
+                                        MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+    MB_SLAVE_CHECK((tracker != NULL), ESP_ERR_NO_MEM, "mb can not allocate memory for change tracking.");
+    tracker->dirty = (uint32_t*)(tracker + 1);
+    tracker->seq = tracker->dirty + words;
+    tracker->shadow = (uint16_t*)(tracker->seq + regs);
+    tracker->deadband = deadband;
+    tracker->regs = regs;
+    esp_err_t error = mbc_slave_set_handler(CONFIG_FMB_SLAVE_CHANGE_FUNC_CODE, mbc_slave_change_query_handler);
+    if (error != ESP_OK) {
+        free(tracker);
+        return error;
+    }
+    // The initial values are reported as changed, so the query from sequence 0 returns the whole area
+    portENTER_CRITICAL(&mbc_slave_change_mux);
+    for (uint16_t reg = 0; reg < regs; reg++) {
+        tracker->shadow[reg] = mbc_slave_get_reg_value(it, reg);
+        tracker->seq[reg] = ++mbc_slave_change_seq;
+    }
+    it->tracker = tracker;
+    portEXIT_CRITICAL(&mbc_slave_change_mux);
+    return ESP_OK;
+#else
+    (void)type;
+    (void)start_offset;
+    (void)deadband;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
 /**
- * Setup Modbus controller parameters
+ * Function to mark the registers updated by application
  */
-esp_err_t mbc_slave_setup(void* comm_info)
+esp_err_t mbc_slave_mark_changed(mb_param_type_t type, uint16_t address, uint16_t count)
 {
-    esp_err_t error = ESP_OK;
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
     MB_SLAVE_CHECK((slave_interface_ptr != NULL),
                     ESP_ERR_INVALID_STATE,
                     "Slave interface is not correctly initialized.");
-    MB_SLAVE_CHECK((slave_interface_ptr->setup != NULL),
-                    ESP_ERR_INVALID_STATE,
-                    "Slave interface is not correctly initialized.");
-    error = slave_interface_ptr->setup(comm_info);
-    MB_SLAVE_CHECK((error == ESP_OK),
-                    ESP_ERR_INVALID_STATE,
-                    "Slave setup failure error=(0x%x).",
-                    (int)error);
-    return error;
+    MB_SLAVE_CHECK((((type == MB_PARAM_HOLDING) || (type == MB_PARAM_INPUT)) && (count > 0)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect registers to mark.");
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, 0, address, count);
+    if (it == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    for (; (it != NULL) && (count > 0); it = mbc_slave_next_reg_descriptor(it)) {
+        uint16_t seg_regs = mbc_slave_get_reg_segment(it, address, count);
+        mbc_slave_mark_regs(it, (uint16_t)(address - it->start_offset), seg_regs);
+        address += seg_regs;
+        count -= seg_regs;
+    }
+    return ESP_OK;
+#else
+    (void)type;
+    (void)address;
+    (void)count;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
 /**
- * Start Modbus controller start function
+ * Function to get the tracked registers changed after the sequence number
  */
-esp_err_t mbc_slave_start(void)
+esp_err_t mbc_slave_get_changes(mb_param_type_t type, uint32_t since_seq, mb_reg_change_t* changes,
+                                    size_t max_count, size_t* count, uint32_t* resume_seq)
 {
-    esp_err_t error = ESP_OK;
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
     MB_SLAVE_CHECK((slave_interface_ptr != NULL),
                     ESP_ERR_INVALID_STATE,
                     "Slave interface is not correctly initialized.");
-    MB_SLAVE_CHECK((slave_interface_ptr->start != NULL),
-                    ESP_ERR_INVALID_STATE,
-                    "Slave interface is not correctly initialized.");
-#ifdef CONFIG_FMB_CONTROLLER_SLAVE_ID_SUPPORT
-    // Set the slave ID if the KConfig option is selected
-    eMBErrorCode status = eMBSetSlaveID(MB_SLAVE_ID_SHORT, TRUE, (UCHAR*)mb_slave_id, sizeof(mb_slave_id));
-    MB_SLAVE_CHECK((status == MB_ENOERR), ESP_ERR_INVALID_STATE, "mb stack set slave ID failure.");
+    MB_SLAVE_CHECK((((type == MB_PARAM_HOLDING) || (type == MB_PARAM_INPUT))
+                    && ((changes != NULL) || (max_count == 0)) && (count != NULL) && (resume_seq != NULL)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect change query arguments.");
+    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+    mb_descr_entry_t* it;
+    bool found = false;
+    // The getters of computed registers can not be called in the critical section
+    LIST_FOREACH(it, &mbs_opts->mbs_area_descriptors[type], entries) {
+        if (it->tracker && it->computed) {
+            mbc_slave_update_computed(it, 0, it->tracker->regs);
+        }
+        if (it->tracker && it->bindings) {
+            mbc_slave_update_bindings(it, 0, it->tracker->regs);
+        }
+    }
+    // The changes are kept sorted by sequence, the oldest ones are reported if not all fit
+    size_t reported = 0;
+    bool truncated = false;
+    portENTER_CRITICAL(&mbc_slave_change_mux);
+    LIST_FOREACH(it, &mbs_opts->mbs_area_descriptors[type], entries) {
+        mb_change_tracker_t* tracker = it->tracker;
+        if (tracker == NULL) {
+            continue;
+        }
+        found = true;
+        mbc_slave_scan_changes(it);
+        for (uint16_t reg = 0; reg < tracker->regs; reg++) {
+            uint32_t seq = tracker->seq[reg];
+            if (seq <= since_seq) {
+                continue;
+            }
+            if (reported == max_count) {
+                truncated = true;
+                if ((max_count == 0) || (seq > changes[reported - 1].seq)) {
+                    continue;
+                }
+                reported--;
+            }
+            size_t pos = reported++;
+            for (; (pos > 0) && (changes[pos - 1].seq > seq); pos--) {
+                changes[pos] = changes[pos - 1];
+            }
+            changes[pos].address = (uint16_t)(it->start_offset + reg);
+            changes[pos].value = tracker->shadow[reg];
+            changes[pos].seq = seq;
+        }
+    }
+    if (!truncated) {
+        *resume_seq = mbc_slave_change_seq;
+    } else {
+        *resume_seq = (reported > 0) ? changes[reported - 1].seq : since_seq;
+    }
+    portEXIT_CRITICAL(&mbc_slave_change_mux);
+    *count = reported;
+    return found ? ESP_OK : ESP_ERR_NOT_FOUND;
+#else
+    (void)type;
+    (void)since_seq;
+    (void)changes;
+    (void)max_count;
+    (void)count;
+    (void)resume_seq;
+    return ESP_ERR_NOT_SUPPORTED;
 #endif
-    error = slave_interface_ptr->start();
-    MB_SLAVE_CHECK((error == ESP_OK),
-                    ESP_ERR_INVALID_STATE,
-                    "Slave start failure error=(0x%x).",
-                    (int)error);
-    return error;
 }
 
 /**
- * Blocking function to get event on parameter group change for application task
+ * Function to get the per function code request counters
  */
-mb_event_group_t mbc_slave_check_event(mb_event_group_t group)
+esp_err_t mbc_slave_get_func_hits(uint32_t* hits, size_t count)
 {
-    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
-                    MB_EVENT_NO_EVENTS,
-                    "Slave interface is not correctly initialized.");
-    MB_SLAVE_CHECK((slave_interface_ptr->check_event != NULL),
-                    MB_EVENT_NO_EVENTS,
-                    "Slave interface is not correctly initialized.");
-    mb_event_group_t event = slave_interface_ptr->check_event(group);
-    return event;
+    MB_SLAVE_CHECK(((hits != NULL) && (count <= MB_FUNC_CODE_COUNT)),
+                    ESP_ERR_INVALID_ARG, "mb incorrect function counters arguments.");
+    for (size_t i = 0; i < count; i++) {
+        hits[i] = (uint32_t)ulMBGetFuncHits((UCHAR)i);
+    }
+    return ESP_OK;
 }
 
 /**
- * Function to get notification about parameter change from application task
+ * Function to clear the per function code request counters
  */
-esp_err_t mbc_slave_get_param_info(mb_param_info_t* reg_info, uint32_t timeout)
+esp_err_t mbc_slave_reset_func_hits(void)
 {
-    esp_err_t error = ESP_OK;
-    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
-                    ESP_ERR_INVALID_STATE,
-                    "Slave interface is not correctly initialized.");
-    MB_SLAVE_CHECK((slave_interface_ptr->get_param_info != NULL),
-                    ESP_ERR_INVALID_STATE,
-                    "Slave interface is not correctly initialized.");
-    error = slave_interface_ptr->get_param_info(reg_info, timeout);
-    MB_SLAVE_CHECK((error == ESP_OK),
-                    ESP_ERR_INVALID_STATE,
-                    "Slave get parameter info failure error=(0x%x).",
-                    (int)error);
-    return error;
+    vMBResetFuncHits();
+    return ESP_OK;
 }
 
 /**
- * Function to set area descriptors for modbus parameters
+ * Function to get the diagnostic counters of the serial line
  */
-esp_err_t mbc_slave_set_descriptor(mb_register_area_descriptor_t descr_data)
+esp_err_t mbc_slave_get_diag_counters(mb_slave_diag_counters_t* counters)
 {
-    esp_err_t error = ESP_OK;
-    MB_SLAVE_CHECK((slave_interface_ptr != NULL),
-                    ESP_ERR_INVALID_STATE,
-                    "Slave interface is not correctly initialized.");
+    MB_SLAVE_CHECK((counters != NULL), ESP_ERR_INVALID_ARG, "mb incorrect counters pointer.");
+    counters->bus_messages = (uint32_t)ulMBGetDiagCounter(MB_DIAG_BUS_MESSAGES);
+    counters->bus_comm_errors = (uint32_t)ulMBGetDiagCounter(MB_DIAG_BUS_COMM_ERRORS);
+    counters->exceptions = (uint32_t)ulMBGetDiagCounter(MB_DIAG_EXCEPTIONS);
+    counters->server_messages = (uint32_t)ulMBGetDiagCounter(MB_DIAG_SERVER_MESSAGES);
+    counters->no_response = (uint32_t)ulMBGetDiagCounter(MB_DIAG_NO_RESPONSE);
+    counters->not_addressed = (uint32_t)ulMBGetDiagCounter(MB_DIAG_NOT_ADDRESSED);
+    counters->broadcasts = (uint32_t)ulMBGetDiagCounter(MB_DIAG_BROADCASTS);
+    counters->fifo_overflows = (uint32_t)ulMBGetDiagCounter(MB_DIAG_FIFO_OVERFLOWS);
+    counters->buffer_full = (uint32_t)ulMBGetDiagCounter(MB_DIAG_BUFFER_FULL);
+    counters->parity_errors = (uint32_t)ulMBGetDiagCounter(MB_DIAG_PARITY_ERRORS);
+    counters->frame_errors = (uint32_t)ulMBGetDiagCounter(MB_DIAG_FRAME_ERRORS);
+    counters->filtered = (uint32_t)ulMBGetDiagCounter(MB_DIAG_FILTERED);
+    counters->cached = (uint32_t)ulMBGetDiagCounter(MB_DIAG_CACHED);
+    return ESP_OK;
+}
 
-    if (slave_interface_ptr->set_descriptor != NULL) {
-        error = slave_interface_ptr->set_descriptor(descr_data);
-        MB_SLAVE_CHECK((error == ESP_OK),
-                        ESP_ERR_INVALID_STATE,
-                        "Slave set descriptor failure error=(0x%x).",
-                        (int)error);
-    } else {
-        mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
-        // Check if the address is already in the descriptor list
-        mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(descr_data.type, descr_data.start_offset, 1);
-        MB_SLAVE_CHECK((it == NULL), ESP_ERR_INVALID_ARG, "mb incorrect descriptor or already defined.");
+/**
+ * Function to clear the diagnostic counters of the serial line
+ */
+esp_err_t mbc_slave_reset_diag_counters(void)
+{
+    vMBResetDiagCounters();
+    return ESP_OK;
+}
 
-        mb_descr_entry_t* new_descr = (mb_descr_entry_t*) heap_caps_malloc(sizeof(mb_descr_entry_t),
-                                            MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
-        MB_SLAVE_CHECK((new_descr != NULL), ESP_ERR_NO_MEM, "mb can not allocate memory for descriptor.");
-        new_descr->start_offset = descr_data.start_offset;
-        new_descr->type = descr_data.type;
-        new_descr->p_data = descr_data.address;
-        new_descr->size = descr_data.size;
-        LIST_INSERT_HEAD(&mbs_opts->mbs_area_descriptors[descr_data.type], new_descr, entries);
-        error = ESP_OK;
+/**
+ * Function to switch the early address filter of the serial slave
+ */
+esp_err_t mbc_slave_set_addr_filter(bool enable)
+{
+#if CONFIG_FMB_SERIAL_ADDR_FILTER
+    vMBSetAddressFilter(enable ? TRUE : FALSE);
+    return ESP_OK;
+#else
+    (void)enable;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to start or stop the bus analyzer
+ */
+esp_err_t mbc_slave_set_bus_analyzer(bool enable, bool listen_only)
+{
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+    mb_port_analyzer_set(enable, listen_only);
+    return ESP_OK;
+#else
+    (void)enable;
+    (void)listen_only;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to get the traffic counters of the bus analyzer
+ */
+esp_err_t mbc_slave_get_bus_stats(mb_bus_stats_t* stats, mb_bus_slave_stats_t* slaves, size_t max_count,
+                                    size_t* count)
+{
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+    MB_SLAVE_CHECK(((stats != NULL) && ((slaves == NULL) || (count != NULL))),
+                    ESP_ERR_INVALID_ARG, "mb incorrect bus analyzer arguments.");
+    size_t copied = mb_port_analyzer_get(stats, slaves, (slaves != NULL) ? max_count : 0);
+    if (count != NULL) {
+        *count = copied;
     }
-    return error;
+    return ESP_OK;
+#else
+    (void)stats;
+    (void)slaves;
+    (void)max_count;
+    (void)count;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Function to clear the traffic counters of the bus analyzer
+ */
+esp_err_t mbc_slave_reset_bus_stats(void)
+{
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+    mb_port_analyzer_reset();
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
 // The helper function to get time stamp in microseconds
@@ -250,17 +2230,85 @@ static esp_err_t mbc_slave_send_param_info(mb_event_group_t par_type, uint16_t m
     par_info.address = par_address;
     par_info.time_stamp = mbc_slave_get_time_stamp();
     par_info.mb_offset = mb_offset;
+    par_info.slave_addr = ucMBGetRequestAddress();
+#if CONFIG_FMB_CONTROLLER_NOTIFY_RING
+    if (mbc_slave_notify_ring_push(mbs_opts, &par_info)) {
+        error = ESP_OK;
+    } else {
+        ESP_LOGD(TAG, "Parameter ring is overflowed, the oldest entry is dropped.");
+    }
+#else
     BaseType_t status = xQueueSend(mbs_opts->mbs_notification_queue_handle, &par_info, MB_PAR_INFO_TOUT);
     if (pdTRUE == status) {
         ESP_LOGD(TAG, "Queue send parameter info (type, address, size): %d, 0x%" PRIx32 ", %u",
                     (int)par_type, (uint32_t)par_address, (unsigned)par_size);
         error = ESP_OK;
     } else if (errQUEUE_FULL == status) {
+        mbs_opts->mbs_notification_overflow++;
         ESP_LOGD(TAG, "Parameter queue is overflowed.");
     }
+#endif
     return error;
 }
 
+// Checks the access rules of the areas for the request, the written register values
+// are in the frame buffer (wire order). Returns MB_ENOREG for the denied access and
+// MB_EILLVALUE for the written value out of range, the areas are not touched.
+static eMBErrorCode mbc_slave_check_access(mb_descr_entry_t* it, uint16_t address, uint16_t count,
+                                            eMBRegisterMode mode, const uint8_t* reg_buffer)
+{
+    uint8_t needed = (mode == MB_REG_READ) ? MB_ACCESS_READ : MB_ACCESS_WRITE;
+    for (; (it != NULL) && (count > 0); it = mbc_slave_next_reg_descriptor(it)) {
+        uint16_t seg = mbc_slave_get_reg_segment(it, address, count);
+        uint32_t first = (uint32_t)address - it->start_offset;
+        uint32_t end = first + seg;
+        for (uint16_t i = 0; i < it->access_count; i++) {
+            const mb_reg_access_t* rule = &it->access[i];
+            uint32_t rule_end = (uint32_t)rule->reg_offset + rule->reg_count;
+            if ((rule->reg_offset >= end) || (rule_end <= first)) {
+                continue;
+            }
+            if (!(rule->access & needed)) {
+                return MB_ENOREG;
+            }
+            if ((mode == MB_REG_WRITE) && (rule->access & MB_ACCESS_RANGE)) {
+                uint32_t from = (rule->reg_offset > first) ? rule->reg_offset : first;
+                uint32_t to = (rule_end < end) ? rule_end : end;
+                for (uint32_t reg = from; reg < to; reg++) {
+                    const uint8_t* pval = reg_buffer + ((reg - first) << 1);
+                    uint16_t value = (uint16_t)((pval[0] << 8) | pval[1]);
+                    bool in_range = (rule->access & MB_ACCESS_SIGNED)
+                                    ? (((int16_t)value >= (int16_t)rule->min) && ((int16_t)value <= (int16_t)rule->max))
+                                    : ((value >= rule->min) && (value <= rule->max));
+                    if (!in_range) {
+                        return MB_EILLVALUE;
+                    }
+                }
+            }
+        }
+        if (reg_buffer != NULL) {
+            reg_buffer += (seg << 1);
+        }
+        address += seg;
+        count -= seg;
+    }
+    return MB_ENOERR;
+}
+
+// Returns true if one of the areas of the request has access rules
+static inline bool mbc_slave_has_access_rules(mb_descr_entry_t* it, uint16_t address, uint16_t count)
+{
+    for (; (it != NULL) && (count > 0); it = mbc_slave_next_reg_descriptor(it)) {
+        if (it->access) {
+            return true;
+        }
+        uint16_t seg = mbc_slave_get_reg_segment(it, address, count);
+        address += seg;
+        count -= seg;
+    }
+    return false;
+}
+
 // Helper function to send notification
 static esp_err_t mbc_slave_send_param_access_notification(mb_event_group_t event)
 {
@@ -289,27 +2337,46 @@ eMBErrorCode mbc_reg_input_slave_cb(UCHAR * reg_buffer, USHORT address, USHORT n
                     MB_EINVAL, "Slave stack call failed.");
     eMBErrorCode status = MB_ENOERR;
     address--; // address of register is already +1
-    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(MB_PARAM_INPUT, address, n_regs);
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(MB_PARAM_INPUT, ucMBGetRequestAddress(), address, n_regs);
     if (it != NULL) {
-        uint16_t input_reg_start = (uint16_t)it->start_offset; // Get Modbus start address
-        uint8_t* input_buffer = (uint8_t*)it->p_data; // Get instance address
-        uint16_t regs = n_regs;
-        uint16_t reg_index;
-        // If input or configuration parameters are incorrect then return an error to stack layer
-        reg_index = (uint16_t)(address - input_reg_start);
-        reg_index <<= 1; // register Address to byte address
-        input_buffer += reg_index;
-        uint8_t* buffer_start = input_buffer;
-        while (regs > 0) {
-            _XFER_2_RD(reg_buffer, input_buffer);
-            reg_index += 2;
-            regs -= 1;
-        }
         // Send access notification
         (void)mbc_slave_send_param_access_notification(MB_EVENT_INPUT_REG_RD);
-        // Send parameter info to application task
-        (void)mbc_slave_send_param_info(MB_EVENT_INPUT_REG_RD, (uint16_t)address,
-                        (uint8_t*)buffer_start, (uint16_t)n_regs);
+        // The registers may be placed in several adjacent areas
+        for (; (it != NULL) && (n_regs > 0); it = mbc_slave_next_reg_descriptor(it)) {
+            uint16_t input_reg_start = (uint16_t)it->start_offset; // Get Modbus start address
+            uint8_t* input_buffer = (uint8_t*)it->p_data; // Get instance address
+            uint16_t seg_regs = mbc_slave_get_reg_segment(it, address, n_regs);
+            uint16_t regs = seg_regs;
+            uint16_t reg_index;
+            // If input or configuration parameters are incorrect then return an error to stack layer
+            reg_index = (uint16_t)(address - input_reg_start);
+            reg_index <<= 1; // register Address to byte address
+            input_buffer += reg_index;
+            uint8_t* buffer_start = input_buffer;
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+            if (it->hooks) {
+                mbc_slave_call_hook(it, MB_AREA_HOOK_PRE_READ, (uint16_t)(address - input_reg_start), regs);
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+                if (it->lock == NULL) {
+                    mbc_slave_cache_invalidate(it); // the update under the lock changes its sequence instead
+                }
+#endif
+            }
+#endif
+            if (it->computed) {
+                mbc_slave_update_computed(it, (uint16_t)(address - input_reg_start), regs);
+            }
+            if (it->bindings) {
+                mbc_slave_update_bindings(it, (uint16_t)(address - input_reg_start), regs);
+            }
+            mbc_slave_read_regs(it, reg_buffer, input_buffer, regs);
+            reg_buffer += (regs << 1);
+            // Send parameter info to application task
+            (void)mbc_slave_send_param_info(MB_EVENT_INPUT_REG_RD, (uint16_t)address,
+                            (uint8_t*)buffer_start, (uint16_t)seg_regs);
+            address += seg_regs;
+            n_regs -= seg_regs;
+        }
     } else {
         status = MB_ENOREG;
     }
@@ -327,41 +2394,73 @@ eMBErrorCode mbc_reg_holding_slave_cb(UCHAR * reg_buffer, USHORT address, USHORT
     eMBErrorCode status = MB_ENOERR;
     uint16_t reg_index;
     address--; // address of register is already +1
-    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(MB_PARAM_HOLDING, address, n_regs);
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(MB_PARAM_HOLDING, ucMBGetRequestAddress(), address, n_regs);
+    if ((it != NULL) && mbc_slave_has_access_rules(it, address, n_regs)) {
+        // The denied request does not touch the area and does not wake up the application
+        status = mbc_slave_check_access(it, address, n_regs, mode, reg_buffer);
+        if (status != MB_ENOERR) {
+            return status;
+        }
+    }
     if (it != NULL) {
-        uint16_t reg_holding_start = (uint16_t)it->start_offset; // Get Modbus start address
-        uint8_t* holding_buffer = (uint8_t*)it->p_data; // Get instance address
-        uint16_t regs = n_regs;
-        reg_index = (uint16_t) (address - reg_holding_start);
-        reg_index <<= 1; // register Address to byte address
-        holding_buffer += reg_index;
-        uint8_t* buffer_start = holding_buffer;
-        switch (mode) {
-            case MB_REG_READ:
-                while (regs > 0) {
-                    _XFER_2_RD(reg_buffer, holding_buffer);
-                    reg_index += 2;
-                    regs -= 1;
-                };
-                // Send access notification
-                (void)mbc_slave_send_param_access_notification(MB_EVENT_HOLDING_REG_RD);
-                // Send parameter info
-                (void)mbc_slave_send_param_info(MB_EVENT_HOLDING_REG_RD, (uint16_t)address,
-                                (uint8_t*)buffer_start, (uint16_t)n_regs);
-                break;
-            case MB_REG_WRITE:
-                while (regs > 0) {
-                    _XFER_2_WR(holding_buffer, reg_buffer);
-                    holding_buffer += 2;
-                    reg_index += 2;
-                    regs -= 1;
-                };
-                // Send access notification
-                (void)mbc_slave_send_param_access_notification(MB_EVENT_HOLDING_REG_WR);
-                // Send parameter info
-                (void)mbc_slave_send_param_info(MB_EVENT_HOLDING_REG_WR, (uint16_t)address,
-                                (uint8_t*)buffer_start, (uint16_t)n_regs);
-                break;
+        // Send access notification
+        (void)mbc_slave_send_param_access_notification((mode == MB_REG_READ) ?
+                                        MB_EVENT_HOLDING_REG_RD : MB_EVENT_HOLDING_REG_WR);
+        // The registers may be placed in several adjacent areas
+        for (; (it != NULL) && (n_regs > 0); it = mbc_slave_next_reg_descriptor(it)) {
+            uint16_t reg_holding_start = (uint16_t)it->start_offset; // Get Modbus start address
+            uint8_t* holding_buffer = (uint8_t*)it->p_data; // Get instance address
+            uint16_t seg_regs = mbc_slave_get_reg_segment(it, address, n_regs);
+            uint16_t regs = seg_regs;
+            reg_index = (uint16_t) (address - reg_holding_start);
+            reg_index <<= 1; // register Address to byte address
+            holding_buffer += reg_index;
+            uint8_t* buffer_start = holding_buffer;
+            switch (mode) {
+                case MB_REG_READ:
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+                    if (it->hooks) {
+                        mbc_slave_call_hook(it, MB_AREA_HOOK_PRE_READ, (uint16_t)(address - reg_holding_start), regs);
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+                        if (it->lock == NULL) {
+                            mbc_slave_cache_invalidate(it);
+                        }
+#endif
+                    }
+#endif
+                    if (it->computed) {
+                        mbc_slave_update_computed(it, (uint16_t)(address - reg_holding_start), regs);
+                    }
+                    if (it->bindings) {
+                        mbc_slave_update_bindings(it, (uint16_t)(address - reg_holding_start), regs);
+                    }
+                    mbc_slave_read_regs(it, reg_buffer, holding_buffer, regs);
+                    reg_buffer += (regs << 1);
+                    // Send parameter info
+                    (void)mbc_slave_send_param_info(MB_EVENT_HOLDING_REG_RD, (uint16_t)address,
+                                    (uint8_t*)buffer_start, (uint16_t)seg_regs);
+                    break;
+                case MB_REG_WRITE:
+                    mbc_slave_write_regs(it, holding_buffer, reg_buffer, regs);
+                    if (it->bindings) {
+                        mbc_slave_store_bindings(it, (uint16_t)(address - reg_holding_start), regs);
+                    }
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
+                    mbc_slave_mark_regs(it, (uint16_t)(address - reg_holding_start), regs);
+#endif
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+                    if (it->hooks) {
+                        mbc_slave_call_hook(it, MB_AREA_HOOK_POST_WRITE, (uint16_t)(address - reg_holding_start), regs);
+                    }
+#endif
+                    reg_buffer += (regs << 1);
+                    // Send parameter info
+                    (void)mbc_slave_send_param_info(MB_EVENT_HOLDING_REG_WR, (uint16_t)address,
+                                    (uint8_t*)buffer_start, (uint16_t)seg_regs);
+                    break;
+            }
+            address += seg_regs;
+            n_regs -= seg_regs;
         }
     } else {
         status = MB_ENOREG;
@@ -378,41 +2477,42 @@ eMBErrorCode mbc_reg_coils_slave_cb(UCHAR* reg_buffer, USHORT address, USHORT n_
                     MB_EINVAL, "Slave stack call failed.");
     eMBErrorCode status = MB_ENOERR;
     uint16_t reg_index;
-    uint16_t coils = n_coils;
+    uint16_t buf_index = 0; // bit index in the frame buffer
     address--; // The address is already +1
-    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(MB_PARAM_COIL, address, n_coils);
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(MB_PARAM_COIL, ucMBGetRequestAddress(), address, n_coils);
+    if ((it != NULL) && mbc_slave_has_access_rules(it, address, n_coils)) {
+        // The coil values are not checked, only the access
+        status = mbc_slave_check_access(it, address, n_coils, mode, NULL);
+        if (status != MB_ENOERR) {
+            return status;
+        }
+    }
     if (it != NULL) {
-        uint16_t reg_coils_start = (uint16_t)it->start_offset; // MB offset of coils
-        uint8_t* reg_coils_buf = (uint8_t*)it->p_data;
-        reg_index = (uint16_t) (address - it->start_offset);
-        CHAR* coils_data_buf = (CHAR*)(reg_coils_buf + (reg_index >> 3));
-        switch (mode) {
-            case MB_REG_READ:
-                while (coils > 0) {
-                    uint8_t result = xMBUtilGetBits((uint8_t*)reg_coils_buf, reg_index, 1);
-                    xMBUtilSetBits(reg_buffer, reg_index - (address - reg_coils_start), 1, result);
-                    reg_index++;
-                    coils--;
-                }
-                // Send an event to notify application task about event
-                (void)mbc_slave_send_param_access_notification(MB_EVENT_COILS_RD);
-                (void)mbc_slave_send_param_info(MB_EVENT_COILS_RD, (uint16_t)address,
-                                (uint8_t*)(coils_data_buf), (uint16_t)n_coils);
-                break;
-            case MB_REG_WRITE:
-                while (coils > 0) {
-                    uint8_t result = xMBUtilGetBits(reg_buffer,
-                            reg_index - (address - reg_coils_start), 1);
-                    xMBUtilSetBits((uint8_t*)reg_coils_buf, reg_index, 1, result);
-                    reg_index++;
-                    coils--;
-                }
-                // Send an event to notify application task about event
-                (void)mbc_slave_send_param_access_notification(MB_EVENT_COILS_WR);
-                (void)mbc_slave_send_param_info(MB_EVENT_COILS_WR, (uint16_t)address,
-                                (uint8_t*)coils_data_buf, (uint16_t)n_coils);
-                break;
-        } // switch ( eMode )
+        // Send an event to notify application task about event
+        (void)mbc_slave_send_param_access_notification((mode == MB_REG_READ) ?
+                                        MB_EVENT_COILS_RD : MB_EVENT_COILS_WR);
+        // The coils may be placed in several adjacent areas
+        for (; (it != NULL) && (n_coils > 0); it = mbc_slave_next_reg_descriptor(it)) {
+            uint8_t* reg_coils_buf = (uint8_t*)it->p_data;
+            uint16_t seg_coils = mbc_slave_get_reg_segment(it, address, n_coils);
+            reg_index = (uint16_t) (address - it->start_offset);
+            CHAR* coils_data_buf = (CHAR*)(reg_coils_buf + (reg_index >> 3));
+            switch (mode) {
+                case MB_REG_READ:
+                    vMBUtilCopyBits(reg_buffer, buf_index, reg_coils_buf, reg_index, seg_coils);
+                    (void)mbc_slave_send_param_info(MB_EVENT_COILS_RD, (uint16_t)address,
+                                    (uint8_t*)(coils_data_buf), (uint16_t)seg_coils);
+                    break;
+                case MB_REG_WRITE:
+                    vMBUtilCopyBits(reg_coils_buf, reg_index, reg_buffer, buf_index, seg_coils);
+                    (void)mbc_slave_send_param_info(MB_EVENT_COILS_WR, (uint16_t)address,
+                                    (uint8_t*)coils_data_buf, (uint16_t)seg_coils);
+                    break;
+            } // switch ( eMode )
+            buf_index += seg_coils;
+            address += seg_coils;
+            n_coils -= seg_coils;
+        }
     } else {
         // If the configuration or input parameters are incorrect then return error to stack
         status = MB_ENOREG;
@@ -430,33 +2530,29 @@ eMBErrorCode mbc_reg_discrete_slave_cb(UCHAR* reg_buffer, USHORT address, USHORT
 
     eMBErrorCode status = MB_ENOERR;
     uint16_t reg_index;
-    uint16_t reg_bit_index;
-    uint16_t n_reg;
+    uint16_t buf_index = 0; // bit index in the frame buffer
     uint8_t* discrete_input_buf;
     // It already plus one in modbus function method.
     address--;
-    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(MB_PARAM_DISCRETE, address, n_discrete);
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(MB_PARAM_DISCRETE, ucMBGetRequestAddress(), address, n_discrete);
     if (it != NULL) {
-        uint16_t reg_discrete_start = (uint16_t)it->start_offset; // MB offset of registers
-        n_reg = (n_discrete >> 3) + 1;
-        discrete_input_buf = (uint8_t*)it->p_data; // the storage address
-        reg_index = (uint16_t) (address - reg_discrete_start) / 8; // Get register index in the buffer for bit number
-        reg_bit_index = (uint16_t)(address - reg_discrete_start) % 8; // Get bit index
-        uint8_t* temp_buf = &discrete_input_buf[reg_index];
-        while (n_reg > 0) {
-            *reg_buffer++ = xMBUtilGetBits(&discrete_input_buf[reg_index++], reg_bit_index, 8);
-            n_reg--;
-        }
-        reg_buffer--;
-        // Last discrete
-        n_discrete = n_discrete % 8;
-        // Filling zero to high bit
-        *reg_buffer = *reg_buffer << (8 - n_discrete);
-        *reg_buffer = *reg_buffer >> (8 - n_discrete);
+        // Filling zero to unused high bits of the last byte
+        memset(reg_buffer, 0, ((n_discrete + 7) >> 3));
         // Send an event to notify application task about event
         (void)mbc_slave_send_param_access_notification(MB_EVENT_DISCRETE_RD);
-        (void)mbc_slave_send_param_info(MB_EVENT_DISCRETE_RD, (uint16_t)address,
-                            (uint8_t*)temp_buf, (uint16_t)n_discrete);
+        // The discrete inputs may be placed in several adjacent areas
+        for (; (it != NULL) && (n_discrete > 0); it = mbc_slave_next_reg_descriptor(it)) {
+            uint16_t seg_discrete = mbc_slave_get_reg_segment(it, address, n_discrete);
+            discrete_input_buf = (uint8_t*)it->p_data; // the storage address
+            reg_index = (uint16_t)(address - it->start_offset); // Get bit index in the storage
+            uint8_t* temp_buf = &discrete_input_buf[reg_index >> 3];
+            vMBUtilCopyBits(reg_buffer, buf_index, discrete_input_buf, reg_index, seg_discrete);
+            buf_index += seg_discrete;
+            (void)mbc_slave_send_param_info(MB_EVENT_DISCRETE_RD, (uint16_t)address,
+                                (uint8_t*)temp_buf, (uint16_t)seg_discrete);
+            address += seg_discrete;
+            n_discrete -= seg_discrete;
+        }
     } else {
         status = MB_ENOREG;
     }
@@ -528,3 +2624,63 @@ eMBErrorCode eMBRegInputCB(UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNReg
     }
     return error;
 }
+
+#if CONFIG_FMB_SLAVE_RESP_CACHE
+// The version of the registers for the response cache of the stack is the sum of
+// the lock sequences of the areas, each update of an area adds two to the sum.
+// The areas without lock and with the values produced on read are not cached.
+ULONG ulMBRegVersionCB(UCHAR ucFunctionCode, USHORT usAddress, USHORT usNRegs)
+{
+    if (slave_interface_ptr == NULL) {
+        return 0;
+    }
+    mb_param_type_t type = (ucFunctionCode == MB_FUNC_READ_HOLDING_REGISTER) ? MB_PARAM_HOLDING : MB_PARAM_INPUT;
+    if (((type == MB_PARAM_HOLDING) && slave_interface_ptr->slave_reg_cb_holding)
+        || ((type == MB_PARAM_INPUT) && slave_interface_ptr->slave_reg_cb_input)) {
+        return 0;
+    }
+    uint16_t address = usAddress - 1;
+    uint32_t version = 1;
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, ucMBGetRequestAddress(), address, usNRegs);
+    for (; (it != NULL) && (usNRegs > 0); it = mbc_slave_next_reg_descriptor(it)) {
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+        if (it->hooks) {
+            return 0;
+        }
+#endif
+        if ((it->lock == NULL) || it->computed || it->bindings) {
+            return 0;
+        }
+        uint32_t seq = __atomic_load_n(&it->lock->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            return 0; // the area is being updated
+        }
+        version += (seq >> 1);
+        uint16_t seg_regs = mbc_slave_get_reg_segment(it, address, usNRegs);
+        address += seg_regs;
+        usNRegs -= seg_regs;
+    }
+    return (usNRegs == 0) ? (ULONG)version : 0;
+}
+
+// Sends the notifications of the read answered from the response cache as the read callbacks do
+void vMBRegCachedReadCB(UCHAR ucFunctionCode, USHORT usAddress, USHORT usNRegs)
+{
+    MB_SLAVE_ASSERT(slave_interface_ptr != NULL);
+    mb_param_type_t type = (ucFunctionCode == MB_FUNC_READ_HOLDING_REGISTER) ? MB_PARAM_HOLDING : MB_PARAM_INPUT;
+    mb_event_group_t event = (type == MB_PARAM_HOLDING) ? MB_EVENT_HOLDING_REG_RD : MB_EVENT_INPUT_REG_RD;
+    uint16_t address = usAddress - 1;
+    mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(type, ucMBGetRequestAddress(), address, usNRegs);
+    if (it == NULL) {
+        return;
+    }
+    (void)mbc_slave_send_param_access_notification(event);
+    for (; (it != NULL) && (usNRegs > 0); it = mbc_slave_next_reg_descriptor(it)) {
+        uint16_t seg_regs = mbc_slave_get_reg_segment(it, address, usNRegs);
+        uint8_t* buffer_start = (uint8_t*)it->p_data + ((address - (uint16_t)it->start_offset) << 1);
+        (void)mbc_slave_send_param_info(event, (uint16_t)address, buffer_start, seg_regs);
+        address += seg_regs;
+        usNRegs -= seg_regs;
+    }
+}
+#endif
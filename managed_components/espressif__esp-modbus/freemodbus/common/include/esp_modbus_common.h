@@ -107,7 +107,9 @@ typedef enum {
     MB_MODE_RTU,                     /*!< RTU transmission mode. */
     MB_MODE_ASCII,                   /*!< ASCII transmission mode. */
     MB_MODE_TCP,                     /*!< TCP communication mode. */
-    MB_MODE_UDP                      /*!< UDP communication mode. */
+    MB_MODE_UDP,                     /*!< UDP communication mode. */
+    MB_MODE_RTU_OVER_TCP,            /*!< RTU frames over TCP, slave only (CONFIG_FMB_TCP_RTU_ENCAP). */
+    MB_MODE_RTU_OVER_UDP             /*!< RTU frames over UDP, slave only (CONFIG_FMB_TCP_RTU_ENCAP). */
 } mb_mode_type_t;
 
 /*!
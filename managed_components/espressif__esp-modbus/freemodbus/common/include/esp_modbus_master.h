@@ -11,6 +11,10 @@
 #include <stddef.h>                 // for NULL and std defines
 #include "esp_bit_defs.h"           // for BITN definitions
 #include "esp_modbus_common.h"      // for common types
+#if CONFIG_FMB_MASTER_ASYNC_API
+#include "freertos/FreeRTOS.h"      // for queue handle type
+#include "freertos/queue.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -161,6 +165,121 @@ typedef struct {
     uint8_t exception;              /*!< Modbus last transaction exception code returned by slave */
 } mb_trans_info_t;
 
+/**
+ * @brief Options of the poll plan compiler
+ */
+typedef struct {
+    uint16_t max_gap;               /*!< Maximum number of unused registers (bits) between two parameters read by one request */
+    uint16_t max_regs;              /*!< Maximum number of registers per read request, 0 for the protocol limit (125) */
+} mb_poll_plan_config_t;
+
+/**
+ * @brief Handle of the compiled poll plan
+ */
+typedef struct mb_poll_plan_s* mb_poll_plan_handle_t;
+
+#if CONFIG_FMB_MASTER_PARAM_CACHE
+/**
+ * @brief Counters of the parameter value cache
+ */
+typedef struct {
+    uint32_t hits;                  /*!< Calls answered from the cache */
+    uint32_t reads;                 /*!< Bus reads of the cache */
+    uint32_t coalesced;             /*!< Calls which shared the bus read of another call */
+} mb_param_cache_stats_t;
+#endif
+
+/**
+ * @brief Order of the released requests of the poll scheduler
+ */
+typedef enum {
+    MB_POLL_SCHED_EDF = 0,          /*!< Earliest deadline first */
+    MB_POLL_SCHED_RM                /*!< Rate monotonic, the shortest period first */
+} mb_poll_sched_policy_t;
+
+/**
+ * @brief Poll period and deadline of one characteristic
+ */
+typedef struct {
+    uint16_t cid;                   /*!< Characteristic cid */
+    uint32_t period_ms;             /*!< Poll period, 1 ms to 1 hour */
+    uint32_t deadline_ms;           /*!< Time from the release to the completion of the read, 0 for the period */
+} mb_poll_rate_t;
+
+/**
+ * @brief Options of the poll scheduler
+ */
+typedef struct {
+    mb_poll_plan_config_t plan;     /*!< Coalescing of the characteristics with the same period and deadline */
+    mb_poll_sched_policy_t policy;  /*!< Order of the released requests */
+} mb_poll_sched_config_t;
+
+/**
+ * @brief Counters of the poll scheduler since its creation
+ */
+typedef struct {
+    uint16_t classes;               /*!< Number of the rate classes (distinct period and deadline) */
+    uint16_t jobs;                  /*!< Number of the coalesced requests of all the classes */
+    uint32_t requests;              /*!< Number of the executed requests */
+    uint32_t errors;                /*!< Number of the failed requests */
+    uint32_t misses;                /*!< Number of the requests completed after their deadline */
+    uint32_t skipped;               /*!< Number of the releases skipped because their deadline had passed */
+    uint32_t max_lateness_us;       /*!< Maximum completion time after the deadline (uS) */
+    uint16_t utilization;           /*!< Measured bus utilization, per mille of the run time */
+    uint16_t demand;                /*!< Sum of the request time / period of all the requests, per mille */
+} mb_poll_sched_stats_t;
+
+/**
+ * @brief Handle of the poll scheduler
+ */
+typedef struct mb_poll_sched_s* mb_poll_sched_handle_t;
+
+/**
+ * @brief Response time and availability of one slave (CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT)
+ */
+typedef struct {
+    uint8_t slave_addr;             /*!< Slave short address */
+    bool quarantined;               /*!< The requests to the slave fail immediately with ESP_ERR_TIMEOUT */
+    uint8_t fails;                  /*!< Number of consecutive respond timeouts */
+    uint32_t srtt_us;               /*!< Smoothed response time (uS), 0 before the first response */
+    uint32_t rttvar_us;             /*!< Response time variance (uS) */
+    uint32_t timeout_us;            /*!< Current respond timeout of the slave (uS) */
+    uint32_t quarantine_left_ms;    /*!< Time to the next probe of the quarantined slave (mS) */
+    uint32_t responses;             /*!< Number of received responses */
+    uint32_t timeouts;              /*!< Number of respond timeouts */
+    uint32_t fast_fails;            /*!< Number of requests failed without bus access due to quarantine */
+} mb_slave_health_t;
+
+#if CONFIG_FMB_MASTER_ASYNC_API
+/**
+ * @brief Completion result of the asynchronous request
+ */
+typedef struct {
+    uint32_t id;                    /*!< Identifier returned by the submit */
+    esp_err_t error;                /*!< Result of the request as returned by mbc_master_send_request() */
+    mb_param_request_t request;     /*!< The executed request */
+    void* data_ptr;                 /*!< Data buffer of the request */
+    void* arg;                      /*!< User argument of the request */
+} mb_master_async_result_t;
+
+/**
+ * @brief Completion callback of the asynchronous request, called from the worker task of the master
+ */
+typedef void (*mb_master_async_cb_t)(const mb_master_async_result_t* result);
+
+/**
+ * @brief Options of the asynchronous request
+ */
+typedef struct {
+    uint8_t priority;               /*!< The queued requests of higher priority are executed first */
+    uint32_t deadline_ms;           /*!< The request is completed with ESP_ERR_TIMEOUT if it is not started in this time
+                                         after the submit, 0 for no deadline */
+    mb_master_async_cb_t callback;  /*!< Completion callback, or NULL */
+    QueueHandle_t queue;            /*!< Queue of mb_master_async_result_t items to post the result to, or NULL */
+    void* arg;                      /*!< User argument passed in the result */
+} mb_master_async_opts_t;
+#endif
+
 /**
  * @brief Initialize Modbus controller and stack for TCP port
  *
@@ -237,6 +356,7 @@ esp_err_t mbc_master_setup(void* comm_info);
  * @return
  *     - esp_err_t ESP_OK - set descriptor successfully
  *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument in function call
+ *     - esp_err_t ESP_ERR_INVALID_STATE - a cached read of the parameter cache is in progress
  */
 esp_err_t mbc_master_set_descriptor(const mb_parameter_descriptor_t* descriptor, const uint16_t num_elements);
 
@@ -258,6 +378,60 @@ esp_err_t mbc_master_set_descriptor(const mb_parameter_descriptor_t* descriptor,
  */
 esp_err_t mbc_master_send_request(mb_param_request_t* request, void* data_ptr);
 
+/**
+ * @brief Send the batch of requests to different slaves with overlapped transactions
+ *        (TCP master with CONFIG_FMB_TCP_MASTER_PIPELINE).
+ *
+ * The port sends the next request of each slave as soon as the previous response of the same slave
+ * is received, so the slaves process their requests at the same time. The requests to the same slave
+ * are executed in the order of the batch. Supported commands are read and write of coils, discrete
+ * inputs, input and holding registers (functions 1 - 6, 15, 16).
+ *
+ * @param[in] requests array of the requests
+ * @param[in] data_ptrs data buffer of each request, the same meaning as in mbc_master_send_request()
+ * @param[out] status result of each request (optional, can be NULL)
+ * @param[in] count number of the requests
+ *
+ * @return
+ *     - esp_err_t ESP_OK - all the requests were successful
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ *     - esp_err_t ESP_ERR_NOT_SUPPORTED - the master does not support pipelined requests
+ *     - esp_err_t ESP_ERR_NO_MEM - no memory for the batch
+ *     - the error of the first failed request otherwise (ESP_ERR_TIMEOUT, ESP_ERR_INVALID_RESPONSE,
+ *       ESP_ERR_NOT_FOUND for unknown slave, ESP_ERR_INVALID_STATE for disconnected slave)
+ */
+esp_err_t mbc_master_send_requests(const mb_param_request_t* requests, void* const data_ptrs[],
+                                   esp_err_t* status, size_t count);
+
+#if CONFIG_FMB_MASTER_ASYNC_API
+/**
+ * @brief Queue the request and return immediately (CONFIG_FMB_MASTER_ASYNC_API).
+ *        The requests are executed one by one by the worker task of the master in the order of
+ *        priority, then deadline, then submit. On completion the callback is called and/or the
+ *        result is posted to the queue of the options (without waiting if the queue is full).
+ *
+ * @param[in] request pointer to request structure of type mb_param_request_t, copied
+ * @param[in] data_ptr data buffer of the request, has to be valid until the completion
+ * @param[in] opts options of the request
+ * @param[out] id identifier of the request, or NULL
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the request is queued
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ *     - esp_err_t ESP_ERR_INVALID_STATE - the master is not initialized
+ *     - esp_err_t ESP_ERR_NO_MEM - the request queue is full or the worker task can not be created
+ */
+esp_err_t mbc_master_send_request_async(const mb_param_request_t* request, void* data_ptr,
+                                        const mb_master_async_opts_t* opts, uint32_t* id);
+
+/**
+ * @brief Get the number of the queued asynchronous requests which are not completed yet
+ *
+ * @return number of the pending requests
+ */
+size_t mbc_master_async_pending(void);
+#endif
+
 /**
  * @brief Get information about supported characteristic defined as cid. Uses parameter description table to get
  *        this information. The function will check if characteristic defined as a cid parameter is supported
@@ -296,6 +470,42 @@ esp_err_t mbc_master_get_cid_info(uint16_t cid, const mb_parameter_descriptor_t*
 */
 esp_err_t mbc_master_get_parameter(uint16_t cid, char* name, uint8_t* value, uint8_t *type);
 
+#if CONFIG_FMB_MASTER_PARAM_CACHE
+/**
+ * @brief Get the value of the characteristic from the cache if it is not older than max_age_ms,
+ *        otherwise read it as mbc_master_get_parameter() does and update the cache.
+ *        The calls of other tasks for the same characteristic during the read wait for it
+ *        and get its result instead of starting their own bus transaction.
+ *
+ * @param[in] cid id of the characteristic for parameter
+ * @param[in] name pointer into string name (key) of parameter (null terminated)
+ * @param[out] value pointer to data buffer of parameter
+ * @param[out] type parameter type associated with the name returned from parameter description table.
+ * @param[in] max_age_ms maximum age of the cached value (mS), 0 reads the parameter from the bus
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the value buffer contains the cached or the just read parameter data
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function or parameter descriptor
+ *     - esp_err_t ESP_ERR_INVALID_STATE - the descriptor table is not set or the cache can not be allocated
+ *     - esp_err_t ESP_ERR_TIMEOUT - no response from slave or the shared read is not completed in time
+ *     - esp_err_t the error of mbc_master_get_parameter() otherwise
+*/
+esp_err_t mbc_master_get_parameter_cached(uint16_t cid, char* name, uint8_t* value, uint8_t* type,
+                                            uint32_t max_age_ms);
+
+/**
+ * @brief Get the counters of the parameter value cache
+ *
+ * @param[out] stats counters of the cache
+ *
+ * @return
+ *     - esp_err_t ESP_OK - success
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ *     - esp_err_t ESP_ERR_INVALID_STATE - the master interface is not initialized
+ */
+esp_err_t mbc_master_get_param_cache_stats(mb_param_cache_stats_t* stats);
+#endif
+
 /**
  * @brief Set characteristic's value defined as a name and cid parameter.
  *        The additional data for cid parameter request is taken from master parameter lookup table.
@@ -344,6 +554,146 @@ esp_err_t mbc_master_set_param_data(void* dest, void* src, mb_descr_type_t param
 */
 esp_err_t mbc_master_get_transaction_info(mb_trans_info_t *ptinfo);
 
+/**
+ * @brief Get the response time statistics and quarantine state of the slave
+ *
+ * @param[in] slave_addr slave short address
+ * @param[out] health the statistics of the slave
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the statistics are saved in the structure
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ *     - esp_err_t ESP_ERR_NOT_FOUND - no request was sent to the slave yet (or the slave table is full)
+ *     - esp_err_t ESP_ERR_NOT_SUPPORTED - CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT is disabled
+ */
+esp_err_t mbc_master_get_slave_health(uint8_t slave_addr, mb_slave_health_t* health);
+
+/**
+ * @brief Forget the response times and release the quarantined slaves
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the statistics are cleared
+ *     - esp_err_t ESP_ERR_NOT_SUPPORTED - CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT is disabled
+ */
+esp_err_t mbc_master_reset_slave_health(void);
+
+/**
+ * @brief Compile the poll plan of the readable characteristics in the parameter description table.
+ *        The characteristics of the same slave and register area which are contiguous or separated
+ *        by up to max_gap unused registers are merged into one read request (FC01/02/03/04).
+ *        The table has to be set with mbc_master_set_descriptor() before and kept unchanged while
+ *        the plan is used.
+ *
+ * @param[in] config options of the compiler
+ * @param[out] plan handle of the compiled plan
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the plan is compiled
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ *     - esp_err_t ESP_ERR_INVALID_STATE - the descriptor table is not set
+ *     - esp_err_t ESP_ERR_NOT_FOUND - there are no readable characteristics in the table
+ *     - esp_err_t ESP_ERR_NO_MEM - the plan can not be allocated
+ */
+esp_err_t mbc_master_poll_plan_create(const mb_poll_plan_config_t* config, mb_poll_plan_handle_t* plan);
+
+/**
+ * @brief Execute all requests of the poll plan back-to-back and scatter the received values into
+ *        the parameter storage. The value of a characteristic is stored at
+ *        storage[mb_param_type] + param_offset - 1 converted according to its param_type,
+ *        the characteristics with param_offset 0 or without storage of their area are only read.
+ *
+ * @param[in] plan handle of the plan
+ * @param[in] storage base addresses of the parameter storage per register area (mb_param_type_t)
+ * @param[out] cid_status status of the last read per cid (table size entries), or NULL
+ *
+ * @return
+ *     - esp_err_t ESP_OK - all requests were successful
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ *     - esp_err_t the error of the first failed request otherwise, the other requests are executed
+ */
+esp_err_t mbc_master_poll_plan_run(mb_poll_plan_handle_t plan, void* const storage[MB_PARAM_COUNT], esp_err_t* cid_status);
+
+/**
+ * @brief Get the size of the poll plan
+ *
+ * @param[in] plan handle of the plan
+ * @param[out] requests number of the requests per cycle, or NULL
+ * @param[out] cids number of the characteristics read per cycle, or NULL
+ *
+ * @return
+ *     - esp_err_t ESP_OK - success
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ */
+esp_err_t mbc_master_poll_plan_get_info(mb_poll_plan_handle_t plan, uint16_t* requests, uint16_t* cids);
+
+/**
+ * @brief Delete the poll plan
+ *
+ * @param[in] plan handle of the plan, NULL is ignored
+ */
+void mbc_master_poll_plan_delete(mb_poll_plan_handle_t plan);
+
+/**
+ * @brief Create the scheduler which polls each characteristic with its own period.
+ *        The characteristics with the same period and deadline are coalesced into read requests
+ *        as by mbc_master_poll_plan_create(). Each request is released once per period, the released
+ *        requests are executed one at a time in the order of the policy.
+ *        The cids which are not listed are not polled, a cid listed with several periods is read
+ *        with each of them. The descriptor table has to be kept unchanged while the scheduler is used.
+ *
+ * @param[in] config options of the scheduler
+ * @param[in] rates period and deadline of each polled characteristic
+ * @param[in] rate_count number of the entries in rates
+ * @param[out] sched handle of the scheduler
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the scheduler is created
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function, period or deadline
+ *     - esp_err_t ESP_ERR_INVALID_STATE - the descriptor table is not set
+ *     - esp_err_t ESP_ERR_NOT_FOUND - there are no readable characteristics in the list
+ *     - esp_err_t ESP_ERR_NO_MEM - the scheduler can not be allocated
+ */
+esp_err_t mbc_master_poll_sched_create(const mb_poll_sched_config_t* config, const mb_poll_rate_t* rates,
+                                        uint16_t rate_count, mb_poll_sched_handle_t* sched);
+
+/**
+ * @brief Execute the released requests of the scheduler during the run time and scatter the
+ *        received values into the parameter storage as mbc_master_poll_plan_run() does.
+ *        The calling task sleeps while no request is released. The first call releases all the
+ *        requests, the next calls continue the same timeline.
+ *
+ * @param[in] sched handle of the scheduler
+ * @param[in] storage base addresses of the parameter storage per register area (mb_param_type_t)
+ * @param[out] cid_status status of the last read per cid (table size entries), or NULL
+ * @param[in] run_ms run time of the call (mS)
+ *
+ * @return
+ *     - esp_err_t ESP_OK - all the executed requests were successful
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ *     - esp_err_t the error of the first failed request otherwise, the other requests are executed
+ */
+esp_err_t mbc_master_poll_sched_run(mb_poll_sched_handle_t sched, void* const storage[MB_PARAM_COUNT],
+                                    esp_err_t* cid_status, uint32_t run_ms);
+
+/**
+ * @brief Get the bus utilization and the deadline misses of the scheduler
+ *
+ * @param[in] sched handle of the scheduler
+ * @param[out] stats counters of the scheduler
+ *
+ * @return
+ *     - esp_err_t ESP_OK - success
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ */
+esp_err_t mbc_master_poll_sched_get_stats(mb_poll_sched_handle_t sched, mb_poll_sched_stats_t* stats);
+
+/**
+ * @brief Delete the poll scheduler
+ *
+ * @param[in] sched handle of the scheduler, NULL is ignored
+ */
+void mbc_master_poll_sched_delete(mb_poll_sched_handle_t sched);
+
 #ifdef __cplusplus
 }
 #endif
@@ -10,6 +10,7 @@
 // Public interface header for slave
 #include <stdint.h>                 // for standard int types definition
 #include <stddef.h>                 // for NULL and std defines
+#include <stdbool.h>                // for bool type
 #include "soc/soc.h"                // for BITN definitions
 #include "freertos/FreeRTOS.h"      // for task creation and queues access
 #include "freertos/event_groups.h"  // for event groups
@@ -25,6 +26,58 @@ extern "C" {
         if (!(con)) { ESP_LOGE(TAG, "assert errno:%u, errno_str: !(%s)", (unsigned)errno, strerror(errno)); assert(0 && #con); } \
     } while (0)
 
+#define MB_PAR_INFO_WAIT_FOREVER (UINT32_MAX) // The timeout value to wait for parameter information without timeout
+
+#define MB_FUNC_CODE_COUNT (128) // Number of function codes (0 - 127) with the request counters
+
+/**
+ * @brief Custom function code handler
+ *
+ * The handler is called from Modbus task. The frame holds the request PDU starting
+ * with the function code and the handler builds the response PDU in place (up to 253 bytes).
+ *
+ * @param[in,out] frame Buffer with the request PDU, the response PDU on return
+ * @param[in,out] length Length of the request PDU, the length of the response PDU on return
+ *
+ * @return Modbus exception code to respond with, 0 to send the response PDU
+ */
+typedef uint8_t (*mb_func_handler_t)(uint8_t* frame, uint16_t* length);
+
+/**
+ * @brief Callback reading the records of the file (<Read File Record>, function code 20)
+ *
+ * Called from Modbus port tasks, must not block. The records of 16 bits are stored
+ * in Modbus byte order (big endian).
+ *
+ * @param record First record number
+ * @param count Number of the records, the range is inside the records of the file
+ * @param[out] data Buffer for count * 2 bytes
+ * @param arg Argument of the file descriptor
+ *
+ * @return ESP_OK, ESP_ERR_TIMEOUT for the SLAVE DEVICE BUSY exception, ESP_ERR_NOT_FOUND
+ *         or ESP_ERR_INVALID_ARG for the ILLEGAL DATA ADDRESS exception, other errors for
+ *         the SLAVE DEVICE FAILURE exception
+ */
+typedef esp_err_t (*mb_file_read_t)(uint16_t record, uint16_t count, uint8_t* data, void* arg);
+
+/**
+ * @brief Callback writing the records of the file (<Write File Record>, function code 21)
+ *
+ * Called as mb_file_read_t with the records written by the master. The files and the record
+ * ranges of all the sub-requests are checked before the first write of the request.
+ */
+typedef esp_err_t (*mb_file_write_t)(uint16_t record, uint16_t count, const uint8_t* data, void* arg);
+
+/**
+ * @brief File served by the file record functions (mbc_slave_set_file())
+ */
+typedef struct {
+    uint16_t records;                       /*!< Number of the records of the file (up to 10000) */
+    mb_file_read_t read;                    /*!< Reads the records, NULL if the file is not readable */
+    mb_file_write_t write;                  /*!< Writes the records, NULL if the file is read only */
+    void* arg;                              /*!< Argument passed to the callbacks */
+} mb_file_descriptor_t;
+
 /**
  * @brief Parameter access event information type
  */
@@ -34,8 +87,82 @@ typedef struct {
     mb_event_group_t type;                  /*!< Modbus event type */
     uint8_t* address;                       /*!< Modbus data storage address */
     size_t size;                            /*!< Modbus event register size (number of registers)*/
+    uint8_t slave_addr;                     /*!< Virtual slave address of the request, 0 for the slave address */
 } mb_param_info_t;
 
+/**
+ * @brief Request counters of the slave address
+ */
+typedef struct {
+    uint32_t requests;                      /*!< Number of executed requests */
+    uint32_t exceptions;                    /*!< Number of exception responses */
+} mb_slave_addr_stats_t;
+
+/**
+ * @brief Diagnostic counters of the serial line
+ */
+typedef struct {
+    uint32_t bus_messages;                  /*!< Frames received on the line, including bad ones */
+    uint32_t bus_comm_errors;               /*!< Frames dropped for the length or CRC check */
+    uint32_t exceptions;                    /*!< Exception responses sent */
+    uint32_t server_messages;               /*!< Frames addressed to the slave, including broadcasts */
+    uint32_t no_response;                   /*!< Executed requests without a response */
+    uint32_t not_addressed;                 /*!< Valid frames for other slaves */
+    uint32_t broadcasts;                    /*!< Broadcast frames received */
+    uint32_t fifo_overflows;                /*!< UART hardware FIFO overflows */
+    uint32_t buffer_full;                   /*!< UART driver ring buffer overflows */
+    uint32_t parity_errors;                 /*!< Characters with parity error */
+    uint32_t frame_errors;                  /*!< Characters with framing error */
+    uint32_t filtered;                      /*!< Frames for other slaves dropped by the address filter */
+    uint32_t cached;                        /*!< Read requests answered with the stored response frame */
+} mb_slave_diag_counters_t;
+
+/**
+ * @brief Counters of the TCP transport in dual transport mode (CONFIG_FMB_SLAVE_DUAL_TCP)
+ */
+typedef struct {
+    uint32_t requests;                      /*!< Number of received requests */
+    uint32_t exceptions;                    /*!< Number of exception responses */
+    uint32_t errors;                        /*!< Number of ignored requests and send failures */
+    uint32_t connects;                      /*!< Number of accepted connections */
+    uint32_t forwarded;                     /*!< Number of requests passed to the forward handler */
+    uint32_t evictions;                     /*!< Number of idle clients disconnected for a new connection */
+    uint32_t throttled;                     /*!< Number of requests rejected by the rate limits */
+    uint32_t worker_reads;                  /*!< Number of read requests executed by the read workers */
+    uint16_t clients;                       /*!< Number of connected clients */
+} mb_slave_tcp_stats_t;
+
+/**
+ * @brief Timers of a connected TCP client in dual transport mode (CONFIG_FMB_SLAVE_DUAL_TCP)
+ */
+typedef struct {
+    char ip_addr[48];                       /*!< IP address of the client */
+    uint32_t connected_ms;                  /*!< Time since the connection is accepted */
+    uint32_t idle_ms;                       /*!< Time since the last data of the client */
+    uint32_t last_request_ms;               /*!< Time since the last request, UINT32_MAX if none */
+    uint32_t requests;                      /*!< Number of requests of the connection */
+    uint32_t throttled;                     /*!< Number of requests rejected by the rate limit */
+} mb_slave_tcp_client_t;
+
+/**
+ * @brief Counters of an additional RTU port (CONFIG_FMB_SLAVE_RTU_PORTS)
+ */
+typedef struct {
+    uint32_t requests;                      /*!< Number of executed requests, broadcasts included */
+    uint32_t exceptions;                    /*!< Number of exception responses */
+    uint32_t crc_errors;                    /*!< Number of frames with CRC error or incomplete frames */
+    uint32_t not_addressed;                 /*!< Number of frames for other slaves */
+    uint32_t uart_errors;                   /*!< Number of UART overruns, parity, framing and send errors */
+} mb_slave_rtu_stats_t;
+
+/**
+ * @brief Handler of the TCP request for another unit identifier (CONFIG_FMB_SLAVE_DUAL_TCP_FORWARD),
+ *        called from the TCP port task. The PDU (function code and data) is valid during the call only.
+ *        Returns true if the request is taken, then the response has to be sent with
+ *        mbc_slave_tcp_forward_done(). Otherwise the client gets the gateway path unavailable exception.
+ */
+typedef bool (*mb_slave_tcp_forward_cb_t)(uint32_t tag, uint8_t unit_id, const uint8_t* pdu, uint16_t pdu_len, void* arg);
+
 /**
  * @brief Parameter storage area descriptor
  */
@@ -46,6 +173,344 @@ typedef struct {
     size_t size;                            /*!< Instance size for area descriptor (bytes) */
 } mb_register_area_descriptor_t;
 
+/**
+ * @brief Byte order of the registers in the storage area
+ */
+typedef enum {
+    MB_DESCR_ORDER_HOST = 0,                /*!< Registers are stored in host (little endian) order, swapped on access */
+    MB_DESCR_ORDER_WIRE                     /*!< Registers are stored in Modbus (big endian) order, copied as is */
+} mb_descr_order_t;
+
+#define MB_LATENCY_BUCKETS (20) // Number of log2 latency buckets: [0] - below 1 us, [n] - 2^(n-1)..2^n-1 us, the last one is open
+#define MB_LATENCY_FUNC_MAX (9) // Number of latency histograms, the last one collects the function codes which do not fit
+
+/**
+ * @brief Stages of the slave request turnaround
+ */
+typedef enum {
+    MB_LATENCY_STAGE_DISPATCH = 0,          /*!< Frame received (T3.5 expired) to function handler dispatch */
+    MB_LATENCY_STAGE_HANDLER,               /*!< Function handler dispatch to handler completion */
+    MB_LATENCY_STAGE_TX,                    /*!< Function handler completion to the response sent */
+    MB_LATENCY_STAGE_TOTAL,                 /*!< Frame received to the response sent */
+    MB_LATENCY_STAGE_COUNT
+} mb_latency_stage_t;
+
+/**
+ * @brief Turnaround latency histogram of one function code
+ */
+typedef struct {
+    uint8_t func_code;                      /*!< Function code, 0 - the function codes which do not fit */
+    uint32_t count;                         /*!< Number of responses */
+    uint32_t max_us[MB_LATENCY_STAGE_COUNT]; /*!< Maximum latency of each stage (uS) */
+    uint32_t buckets[MB_LATENCY_STAGE_COUNT][MB_LATENCY_BUCKETS]; /*!< Log2 histogram of each stage */
+} mb_latency_hist_t;
+
+/**
+ * @brief Power management statistics of the serial slave port (CONFIG_FMB_SERIAL_PM_LOCK)
+ *
+ * The wakeup is the first frame activity after the port released its lock, the latency
+ * is measured from it to the end of the first response transmitted after the wakeup.
+ */
+typedef struct {
+    uint32_t wakeups;                       /*!< Number of the activity periods started after the lock was released */
+    uint32_t responses;                     /*!< Number of the responses sent as the first after a wakeup */
+    uint32_t wake_to_tx_last_us;            /*!< Wakeup to response latency of the last wakeup */
+    uint32_t wake_to_tx_max_us;             /*!< Maximum wakeup to response latency */
+    uint64_t wake_to_tx_total_us;           /*!< Sum of the wakeup to response latencies */
+    uint64_t awake_us;                      /*!< Time the port held the lock (light sleep not allowed) */
+    uint64_t uptime_us;                     /*!< Time since boot, the base of the awake share */
+    bool lock_held;                         /*!< The port holds the lock now */
+} mb_serial_pm_stats_t;
+
+#define MB_FRAME_TRACE_DATA_MAX (64) // Maximum number of the captured bytes of a traced frame
+
+#define MB_FRAME_TX     (0x01) // The frame is sent by the slave, received otherwise
+#define MB_FRAME_TCP    (0x02) // Modbus TCP frame with MBAP header, RTU frame with address and CRC otherwise
+#define MB_FRAME_ERROR  (0x04) // The received frame is dropped, length or CRC error
+
+/**
+ * @brief Frame recorded by the frame trace (CONFIG_FMB_FRAME_TRACE)
+ */
+typedef struct {
+    uint32_t seq;                           /*!< Sequence number of the record, starts with 1 */
+    int64_t timestamp_us;                   /*!< Time of the record (esp_timer) */
+    uint16_t length;                        /*!< Length of the frame */
+    uint8_t flags;                          /*!< MB_FRAME_* flags */
+    uint8_t captured;                       /*!< Number of the captured bytes from the frame start */
+    uint8_t data[MB_FRAME_TRACE_DATA_MAX];  /*!< Captured bytes */
+} mb_frame_record_t;
+
+/**
+ * @brief Traffic counters of one slave on the RTU bus (CONFIG_FMB_SLAVE_BUS_ANALYZER)
+ *
+ * The response time is measured from the end of the request frame to the start of the response
+ * frame on the wire, both estimated from the UART frame end detection and the character time.
+ */
+typedef struct {
+    uint8_t addr;                           /*!< Slave address */
+    uint8_t last_func;                      /*!< Function code of the last request */
+    uint32_t requests;                      /*!< Number of the requests for the slave */
+    uint32_t responses;                     /*!< Number of the normal responses */
+    uint32_t exceptions;                    /*!< Number of the exception responses */
+    uint32_t timeouts;                      /*!< Number of the requests without response */
+    uint32_t bad_responses;                 /*!< Number of the damaged frames received as the response */
+    uint32_t resp_last_us;                  /*!< Response time of the last response */
+    uint32_t resp_min_us;                   /*!< Minimum response time */
+    uint32_t resp_max_us;                   /*!< Maximum response time */
+    uint64_t resp_total_us;                 /*!< Sum of the response times of the responses and exceptions */
+} mb_bus_slave_stats_t;
+
+/**
+ * @brief Traffic counters of the RTU bus (CONFIG_FMB_SLAVE_BUS_ANALYZER)
+ */
+typedef struct {
+    bool running;                           /*!< The analyzer is started */
+    bool listen_only;                       /*!< The slave does not answer while the analyzer runs */
+    uint16_t slaves;                        /*!< Number of the tracked slaves */
+    uint32_t frames;                        /*!< Number of the frames on the bus, damaged ones included */
+    uint32_t bytes;                         /*!< Number of the bytes of the frames */
+    uint32_t bad_frames;                    /*!< Number of the frames with length or CRC error */
+    uint32_t broadcasts;                    /*!< Number of the broadcast requests */
+    uint32_t unmatched;                     /*!< Number of the frames seen as response without a request */
+    uint32_t untracked;                     /*!< Number of the requests for slaves beyond the table */
+    uint32_t gaps;                          /*!< Number of the measured inter-frame gaps */
+    uint32_t gap_min_us;                    /*!< Minimum idle time between two frames */
+    uint32_t gap_max_us;                    /*!< Maximum idle time between two frames, capped at 1 s */
+    uint64_t gap_total_us;                  /*!< Sum of the idle times between two frames */
+    uint64_t busy_us;                       /*!< Wire time of the frames, 11 bits per character */
+    uint64_t elapsed_us;                    /*!< Time since start or reset, busy_us / elapsed_us is the utilization */
+} mb_bus_stats_t;
+
+#define MB_COMPUTED_REGS_MAX (4) // Maximum number of registers produced by one computed register getter
+
+/**
+ * @brief Getter of computed registers, fills the values in host byte order
+ */
+typedef void (*mb_reg_getter_t)(uint16_t* values, uint16_t count, void* arg);
+
+/**
+ * @brief Computed registers range of the storage area
+ *
+ * The values are produced by the getter when the master reads the registers
+ * and are cached in the storage area for the ttl_ms milliseconds.
+ */
+typedef struct {
+    uint16_t reg_offset;                    /*!< Offset of the first register from the start of area */
+    uint16_t reg_count;                     /*!< Number of registers produced by getter (1..MB_COMPUTED_REGS_MAX) */
+    mb_reg_getter_t getter;                 /*!< Getter of the register values */
+    void* arg;                              /*!< Argument passed to getter */
+    uint32_t ttl_ms;                        /*!< Time to keep the cached values, 0 - compute on each read */
+    int64_t expires_us;                     /*!< Expiration time of the cached values (set by stack) */
+} mb_computed_reg_t;
+
+/**
+ * @brief Type of the application variable bound to the registers (mb_reg_binding_t)
+ */
+typedef enum {
+    MB_BIND_U8 = 0,                         /*!< uint8_t, one register */
+    MB_BIND_BOOL,                           /*!< bool, one register (0 or 1) */
+    MB_BIND_U16,                            /*!< uint16_t, one register */
+    MB_BIND_I16,                            /*!< int16_t, one register */
+    MB_BIND_U32,                            /*!< uint32_t, two registers */
+    MB_BIND_I32,                            /*!< int32_t, two registers */
+    MB_BIND_FLOAT,                          /*!< float, two registers (IEEE 754) or one scaled int16 register */
+    MB_BIND_TYPE_COUNT
+} mb_bind_type_t;
+
+/**
+ * @brief Byte order of the bound registers, A is the most significant byte of the value
+ */
+typedef enum {
+    MB_BIND_ORDER_ABCD = 0,                 /*!< Big endian, high word first (Modbus default) */
+    MB_BIND_ORDER_CDAB = 1,                 /*!< Low word first */
+    MB_BIND_ORDER_BADC = 2,                 /*!< High word first, bytes of each register swapped */
+    MB_BIND_ORDER_DCBA = 3                  /*!< Little endian */
+} mb_bind_order_t;
+
+/**
+ * @brief Application variable bound to the registers of the storage area
+ *
+ * The registers are produced from the variable each time the master reads them and
+ * are stored into the area, so the variable is read live and no task has to copy it.
+ * With the scale the register is the rounded value multiplied by the scale, a float
+ * variable then takes one signed register. The master writes of the writable binding
+ * are converted back into the variable.
+ */
+typedef struct {
+    uint16_t reg_offset;                    /*!< Offset of the first register from the start of area */
+    uint8_t type;                           /*!< mb_bind_type_t of the variable */
+    uint8_t order;                          /*!< mb_bind_order_t of the registers */
+    volatile void* ptr;                     /*!< Variable, aligned to its size */
+    float scale;                            /*!< Register = variable * scale, 0 - no scaling */
+    bool writable;                          /*!< Convert the master writes into the variable */
+} mb_reg_binding_t;
+
+#ifndef __cplusplus
+/**
+ * @brief Type of the bound variable from its declaration, does not compile for an unsupported type
+ */
+#define MB_BIND_TYPE_OF(var) _Generic((var), \
+        uint8_t: MB_BIND_U8, bool: MB_BIND_BOOL, uint16_t: MB_BIND_U16, int16_t: MB_BIND_I16, \
+        uint32_t: MB_BIND_U32, int32_t: MB_BIND_I32, float: MB_BIND_FLOAT)
+
+/**
+ * @brief Read only binding of the variable to the registers at the offset, for the initializers of the table
+ */
+#define MB_REG_BIND(offset, var) \
+        { .reg_offset = (offset), .type = MB_BIND_TYPE_OF(var), .order = MB_BIND_ORDER_ABCD, \
+          .ptr = (volatile void*)&(var), .scale = 0, .writable = false }
+#endif
+
+/**
+ * @brief Access flags of the register range (mb_reg_access_t)
+ */
+#define MB_ACCESS_READ      (0x01)          /*!< The registers (coils) may be read */
+#define MB_ACCESS_WRITE     (0x02)          /*!< The registers (coils) may be written */
+#define MB_ACCESS_RANGE     (0x04)          /*!< The written register values are checked against min and max */
+#define MB_ACCESS_SIGNED    (0x08)          /*!< The range check compares the values as int16_t */
+#define MB_ACCESS_RW        (MB_ACCESS_READ | MB_ACCESS_WRITE)
+
+/**
+ * @brief Access rule of the register (coil) range of the storage area
+ *
+ * The rules are checked by the stack before the area is accessed, the request with
+ * a denied register gets the illegal data address exception and the write with a value
+ * out of range the illegal data value exception. The area is not changed then
+ * and the application is not notified. The registers without a rule have full access.
+ */
+typedef struct {
+    uint16_t reg_offset;                    /*!< Offset of the first register (coil) from the start of area */
+    uint16_t reg_count;                     /*!< Number of the registers (coils) of the rule */
+    uint8_t access;                         /*!< MB_ACCESS_* flags */
+    uint16_t min;                           /*!< Minimum written value with MB_ACCESS_RANGE */
+    uint16_t max;                           /*!< Maximum written value with MB_ACCESS_RANGE */
+} mb_reg_access_t;
+
+/**
+ * @brief Synchronous hook of the register area, called from Modbus task
+ *
+ * The range is given by the offset of the first register from the start of the area
+ * and the number of registers of the request which belong to the area.
+ */
+typedef void (*mb_area_hook_t)(mb_param_type_t type, uint16_t reg_offset, uint16_t reg_count, void* arg);
+
+/**
+ * @brief Hooks of the register area (mbc_slave_set_descriptor_hooks())
+ *
+ * The pre-read hook refreshes the registers before they are copied into the response,
+ * the post-write hook applies the registers written by the master before the response
+ * is sent. Each call is timed against the budget, the hook which exceeds it
+ * CONFIG_FMB_SLAVE_HOOK_OVERRUN_LIMIT times in a row is suspended.
+ */
+typedef struct {
+    mb_area_hook_t pre_read;                /*!< Called before the registers are read, NULL if not used */
+    mb_area_hook_t post_write;              /*!< Called after the registers are written, NULL if not used */
+    void* arg;                              /*!< Argument passed to the hooks */
+    uint32_t budget_us;                     /*!< Execution time budget of one call, 0 - not limited */
+} mb_area_hooks_t;
+
+/**
+ * @brief Timing statistics of the area hook
+ */
+typedef struct {
+    uint32_t calls;                         /*!< Number of calls */
+    uint32_t overruns;                      /*!< Number of calls longer than the budget */
+    uint32_t last_us;                       /*!< Execution time of the last call */
+    uint32_t max_us;                        /*!< Longest execution time */
+    uint64_t total_us;                      /*!< Sum of the execution times */
+    bool suspended;                         /*!< The hook is not called after the overruns */
+} mb_area_hook_stats_t;
+
+#define MB_AREA_INTERNAL_MAX_SIZE (4096) // Largest area placed in internal RAM by MB_AREA_PLACE_AUTO (bytes)
+#define MB_AREA_ALIGN (64) // Alignment of the areas allocated by mbc_slave_alloc_area(), data cache line
+
+/**
+ * @brief Placement hint of the register area storage
+ */
+typedef enum {
+    MB_AREA_PLACE_AUTO = 0,                 /*!< Internal RAM for small areas, PSRAM for the larger ones */
+    MB_AREA_PLACE_INTERNAL,                 /*!< Internal RAM only */
+    MB_AREA_PLACE_PSRAM                     /*!< PSRAM, internal RAM if there is no PSRAM */
+} mb_area_place_t;
+
+/**
+ * @brief Read statistics of the register area with the hot block cache
+ */
+typedef struct {
+    uint32_t hits;                          /*!< Block reads served from the cache */
+    uint32_t misses;                        /*!< Block reads served from the area storage */
+    uint32_t evictions;                     /*!< Cached blocks replaced by hotter ones */
+    uint16_t block_regs;                    /*!< Number of registers per block */
+    uint16_t blocks;                        /*!< Number of blocks in the area */
+    uint16_t slots;                         /*!< Number of cache slots */
+    uint16_t cached;                        /*!< Number of cached blocks */
+    bool psram;                             /*!< The area storage is placed in PSRAM */
+} mb_area_cache_stats_t;
+
+#define MB_CHANGES_PDU_MAX (61) // Maximum number of registers in the change query response
+
+/**
+ * @brief Changed register reported by mbc_slave_get_changes()
+ */
+typedef struct {
+    uint16_t address;                       /*!< Modbus address of the register */
+    uint16_t value;                         /*!< Reported value of the register in host byte order */
+    uint32_t seq;                           /*!< Change sequence number of the value */
+} mb_reg_change_t;
+
+/**
+ * @brief Sequence lock for the storage area shared with the application
+ *
+ * Writers are serialized by the spinlock and keep the sequence odd while the area is updated.
+ * Readers never take the spinlock, they copy the area and retry if the sequence has changed.
+ */
+typedef struct {
+    volatile uint32_t seq;                  /*!< Sequence counter, odd while the area is updated */
+    portMUX_TYPE mux;                       /*!< Spinlock to serialize the writers */
+} mb_seqlock_t;
+
+#define MB_SEQLOCK_INIT() { .seq = 0, .mux = portMUX_INITIALIZER_UNLOCKED }
+
+/**
+ * @brief Start update of the area protected by sequence lock (task context only)
+ */
+static inline void mb_seqlock_write_begin(mb_seqlock_t* lock)
+{
+    portENTER_CRITICAL(&lock->mux);
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Finish update of the area protected by sequence lock
+ */
+static inline void mb_seqlock_write_end(mb_seqlock_t* lock)
+{
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELEASE);
+    portEXIT_CRITICAL(&lock->mux);
+}
+
+/**
+ * @brief Start reading of the area protected by sequence lock, waits while the update is in progress
+ */
+static inline uint32_t mb_seqlock_read_begin(const mb_seqlock_t* lock)
+{
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&lock->seq, __ATOMIC_ACQUIRE)) & 1) {
+        ;
+    }
+    return seq;
+}
+
+/**
+ * @brief Check if the area has been changed since mb_seqlock_read_begin() and the copy has to be repeated
+ */
+static inline bool mb_seqlock_read_retry(const mb_seqlock_t* lock, uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (__atomic_load_n(&lock->seq, __ATOMIC_RELAXED) != seq);
+}
+
 /**
  * @brief Initialize Modbus Slave controller and stack for TCP port
  *
@@ -122,7 +587,7 @@ mb_event_group_t mbc_slave_check_event(mb_event_group_t group);
  *
  * @param[out] reg_info parameter info structure
  * @param timeout Timeout in milliseconds to read information from
- *                parameter queue
+ *                parameter queue or MB_PAR_INFO_WAIT_FOREVER
  * @return
  *     - ESP_OK Success
  *     - ESP_ERR_TIMEOUT Can not get data from parameter queue
@@ -130,6 +595,34 @@ mb_event_group_t mbc_slave_check_event(mb_event_group_t group);
  */
 esp_err_t mbc_slave_get_param_info(mb_param_info_t* reg_info, uint32_t timeout);
 
+/**
+ * @brief Get several parameter information entries at once
+ *
+ * Waits up to timeout for the first entry then returns all entries
+ * available at the moment without waiting (up to max_count).
+ *
+ * @param[out] reg_info array of parameter info structures
+ * @param max_count number of elements in the reg_info array
+ * @param[out] count number of entries returned
+ * @param timeout Timeout in milliseconds to wait for the first entry or MB_PAR_INFO_WAIT_FOREVER
+ * @return
+ *     - ESP_OK Success, at least one entry is returned
+ *     - ESP_ERR_TIMEOUT No entries during timeout
+ *     - ESP_ERR_INVALID_ARG Incorrect arguments
+ */
+esp_err_t mbc_slave_get_param_info_batch(mb_param_info_t* reg_info, size_t max_count,
+                                            size_t* count, uint32_t timeout);
+
+/**
+ * @brief Get the number of parameter notifications lost due to overflow
+ *
+ * @param[out] overflow_count number of dropped (queue) or overwritten (ring) notifications
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG Incorrect arguments
+ */
+esp_err_t mbc_slave_get_param_info_overflow(uint32_t* overflow_count);
+
 /**
  * @brief Set Modbus area descriptor
  *
@@ -141,6 +634,663 @@ esp_err_t mbc_slave_get_param_info(mb_param_info_t* reg_info, uint32_t timeout);
  */
 esp_err_t mbc_slave_set_descriptor(mb_register_area_descriptor_t descr_data);
 
+/**
+ * @brief Set Modbus area descriptor with the byte order of storage area
+ *
+ * The areas stored in wire order are transferred with memcpy() without byte swapping,
+ * the application is responsible to keep the values in big endian order.
+ *
+ * @param descr_data Modbus registers area descriptor structure
+ * @param order Byte order of the registers in the storage area (holding and input areas only)
+ *
+ * @return
+ *     - ESP_OK: The appropriate descriptor is set
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ */
+esp_err_t mbc_slave_set_descriptor_order(mb_register_area_descriptor_t descr_data, mb_descr_order_t order);
+
+/**
+ * @brief Remove Modbus area descriptor
+ *
+ * The area is removed together with its lock, access rules and the other attached tables,
+ * for example when the setup of the area fails. The registers of the area are not served
+ * after the call, the area must not be accessed by a request in progress.
+ *
+ * @param type Type of the area
+ * @param start_offset Modbus start address of the area as set by mbc_slave_set_descriptor()
+ *
+ * @return
+ *     - ESP_OK: The descriptor is removed
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect or the area is not found
+ *     - ESP_ERR_INVALID_STATE: The slave interface is not initialized
+ *     - ESP_ERR_NOT_SUPPORTED: The descriptors are kept by the slave port
+ */
+esp_err_t mbc_slave_remove_descriptor(mb_param_type_t type, uint16_t start_offset);
+
+/**
+ * @brief Attach the sequence lock to the registers area descriptor of the slave address
+ *
+ * The stack reads the area as a consistent snapshot and updates it under the lock,
+ * the application updates the area between mb_seqlock_write_begin() and mb_seqlock_write_end().
+ *
+ * @param type Type of the area (holding and input areas only)
+ * @param start_offset Modbus start address of the area as set by mbc_slave_set_descriptor()
+ * @param lock Pointer to the sequence lock, NULL to detach the lock
+ *
+ * @return
+ *     - ESP_OK: The lock is attached to the descriptor
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect or the area is not found
+ *     - ESP_ERR_INVALID_STATE: The slave interface is not initialized
+ */
+esp_err_t mbc_slave_set_descriptor_lock(mb_param_type_t type, uint16_t start_offset, mb_seqlock_t* lock);
+
+/**
+ * @brief Attach the computed registers to the registers area descriptor of the slave address
+ *
+ * The getters are called from Modbus task before the registers are read
+ * and the values are stored into the area, so the getters must be short and non-blocking.
+ * The table must stay valid while the descriptor is used.
+ *
+ * @param type Type of the area (holding and input areas only)
+ * @param start_offset Modbus start address of the area as set by mbc_slave_set_descriptor()
+ * @param regs Table of computed register ranges, NULL to detach
+ * @param count Number of entries in the table
+ *
+ * @return
+ *     - ESP_OK: The table is attached to the descriptor
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect or the area is not found
+ *     - ESP_ERR_INVALID_STATE: The slave interface is not initialized
+ */
+esp_err_t mbc_slave_set_descriptor_computed(mb_param_type_t type, uint16_t start_offset,
+                                                mb_computed_reg_t* regs, size_t count);
+
+/**
+ * @brief Bind the application variables to the registers of the area descriptor of the slave address
+ *
+ * The bound registers are refreshed from the variables by Modbus task before they are read,
+ * a changed value is stored into the area under its sequence lock. The variables are read
+ * with atomic loads and may be updated by any task without a lock. The table must stay
+ * valid while the descriptor is used, it is usually a const table built with MB_REG_BIND().
+ *
+ * @param type Type of the area (holding and input areas only)
+ * @param start_offset Modbus start address of the area as set by mbc_slave_set_descriptor()
+ * @param binds Table of the bindings, NULL to detach
+ * @param count Number of entries in the table
+ *
+ * @return
+ *     - ESP_OK: The table is attached to the descriptor
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect or the area is not found
+ *     - ESP_ERR_INVALID_STATE: The slave interface is not initialized
+ */
+esp_err_t mbc_slave_set_descriptor_binding(mb_param_type_t type, uint16_t start_offset,
+                                            const mb_reg_binding_t* binds, size_t count);
+
+/**
+ * @brief Get the actual register values of the bound variables in host byte order
+ *
+ * Used by the application to fill its own copy of the register image, e.g. for a web page.
+ *
+ * @param binds Table of the bindings
+ * @param count Number of entries in the table
+ * @param[out] regs Register image of the area, the bound registers are written
+ */
+void mbc_slave_get_bound_regs(const mb_reg_binding_t* binds, size_t count, uint16_t* regs);
+
+/**
+ * @brief Attach the access rules to the holding registers or coils area descriptor of the slave address
+ *
+ * The read-only, write-only and value range rules are enforced by the register callbacks
+ * before the data is copied, for all slave ports. The table must stay valid while the
+ * descriptor is used.
+ *
+ * @param type Type of the area (holding and coil areas only)
+ * @param start_offset Modbus start address of the area as set by mbc_slave_set_descriptor()
+ * @param rules Table of access rules, NULL to detach
+ * @param count Number of entries in the table
+ *
+ * @return
+ *     - ESP_OK: The table is attached to the descriptor
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect or the area is not found
+ *     - ESP_ERR_INVALID_STATE: The slave interface is not initialized
+ */
+esp_err_t mbc_slave_set_descriptor_access(mb_param_type_t type, uint16_t start_offset,
+                                            const mb_reg_access_t* rules, size_t count);
+
+/**
+ * @brief Attach the synchronous hooks to the registers area descriptor of the slave address
+ *
+ * The hooks are called from Modbus task in the request processing, so the response carries
+ * the values set by the pre-read hook and the written values are applied once the master
+ * gets the response. The hooks update the area under its sequence lock if the area has one
+ * and must not block. Attaching the hooks again clears the statistics and resumes the
+ * suspended hooks.
+ *
+ * @param type Type of the area (holding and input areas only, input areas use the pre-read hook only)
+ * @param start_offset Modbus start address of the area as set by mbc_slave_set_descriptor()
+ * @param hooks Hooks of the area (copied), NULL to detach
+ *
+ * @return
+ *     - ESP_OK: The hooks are attached to the descriptor
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect or the area is not found
+ *     - ESP_ERR_INVALID_STATE: The slave interface is not initialized
+ *     - ESP_ERR_NO_MEM: There is no memory for the hook state
+ *     - ESP_ERR_NOT_SUPPORTED: The area hooks are disabled by CONFIG_FMB_SLAVE_AREA_HOOKS
+ */
+esp_err_t mbc_slave_set_descriptor_hooks(mb_param_type_t type, uint16_t start_offset, const mb_area_hooks_t* hooks);
+
+/**
+ * @brief Get the timing statistics of the area hooks
+ *
+ * @param type Type of the area
+ * @param start_offset Modbus start address of the area as set by mbc_slave_set_descriptor()
+ * @param[out] pre_read Statistics of the pre-read hook, may be NULL
+ * @param[out] post_write Statistics of the post-write hook, may be NULL
+ *
+ * @return
+ *     - ESP_OK: The statistics are copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect or the area is not found
+ *     - ESP_ERR_NOT_FOUND: The area has no hooks
+ *     - ESP_ERR_NOT_SUPPORTED: The area hooks are disabled by CONFIG_FMB_SLAVE_AREA_HOOKS
+ */
+esp_err_t mbc_slave_get_hook_stats(mb_param_type_t type, uint16_t start_offset,
+                                    mb_area_hook_stats_t* pre_read, mb_area_hook_stats_t* post_write);
+
+/**
+ * @brief Allocate the storage of a register area with the placement hint
+ *
+ * The storage is zeroed and aligned to MB_AREA_ALIGN so the register blocks do not share
+ * the cache lines with other data.
+ *
+ * @param size Size of the area in bytes
+ * @param place Placement hint of the storage
+ *
+ * @return Pointer to the storage or NULL if there is no memory
+ */
+void* mbc_slave_alloc_area(size_t size, mb_area_place_t place);
+
+/**
+ * @brief Free the storage allocated by mbc_slave_alloc_area() after the slave is destroyed
+ */
+void mbc_slave_free_area(void* area);
+
+/**
+ * @brief Attach the hot block cache to the registers area descriptor (CONFIG_FMB_SLAVE_AREA_CACHE)
+ *
+ * The reads are counted per block of CONFIG_FMB_SLAVE_AREA_CACHE_BLOCK_REGS registers and
+ * the most read blocks are copied into internal RAM. The counters are halved after every
+ * 65536 block reads so the cache follows the change of the hot ranges. The cached blocks are
+ * dropped when the master writes the area or the application updates it under the sequence
+ * lock, areas without the lock must be updated by the master only.
+ *
+ * @param type Type of the area (holding and input areas only)
+ * @param start_offset Modbus start address of the area as set by mbc_slave_set_descriptor()
+ * @param slots Number of cached blocks (up to 255), 0 to count the reads only
+ *
+ * @return
+ *     - ESP_OK: The cache is attached to the descriptor
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect or the area is not found
+ *     - ESP_ERR_INVALID_STATE: The slave interface is not initialized or the area already has a cache
+ *     - ESP_ERR_NO_MEM: No internal memory for the cache
+ *     - ESP_ERR_NOT_SUPPORTED: The area cache is not enabled
+ */
+esp_err_t mbc_slave_set_descriptor_cache(mb_param_type_t type, uint16_t start_offset, size_t slots);
+
+/**
+ * @brief Get the read statistics and the per block read counters of the area with the cache
+ *
+ * @param type Type of the area (holding and input areas only)
+ * @param start_offset Modbus start address of the area as set by mbc_slave_set_descriptor()
+ * @param[out] stats Read statistics of the area
+ * @param[out] heat Array for the read counters of the blocks, NULL to skip
+ * @param max_heat Number of entries in the array, the counters of the first blocks are copied
+ *
+ * @return
+ *     - ESP_OK: The statistics are copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect or the area is not found
+ *     - ESP_ERR_NOT_FOUND: The area has no cache
+ *     - ESP_ERR_NOT_SUPPORTED: The area cache is not enabled
+ */
+esp_err_t mbc_slave_get_area_stats(mb_param_type_t type, uint16_t start_offset, mb_area_cache_stats_t* stats,
+                                        uint32_t* heat, size_t max_heat);
+
+/**
+ * @brief Track the changes of the registers area descriptor (CONFIG_FMB_SLAVE_CHANGE_TRACKING)
+ *
+ * A register gets the next change sequence number when its value moves from the last reported
+ * value by more than its deadband. The values are compared when the changes are queried, only for
+ * the registers written by the master, refreshed computed registers and the registers
+ * marked by mbc_slave_mark_changed(). The change query function code is registered on first call.
+ *
+ * @param type Type of the area (holding and input areas only)
+ * @param start_offset Modbus start address of the area as set by mbc_slave_set_descriptor()
+ * @param deadband Table of deadbands, one per register of the area, NULL to report any change.
+ *                 The table must stay valid while the descriptor is used.
+ *
+ * @return
+ *     - ESP_OK: The tracking is enabled for the area
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect or the area is not found
+ *     - ESP_ERR_INVALID_STATE: The slave interface is not initialized or the area is already tracked
+ *     - ESP_ERR_NO_MEM: No memory for the tracking state
+ *     - ESP_ERR_NOT_SUPPORTED: The change tracking is not enabled
+ */
+esp_err_t mbc_slave_set_descriptor_tracking(mb_param_type_t type, uint16_t start_offset, const uint16_t* deadband);
+
+/**
+ * @brief Mark the registers updated by the application for the next change comparison
+ *
+ * The call is cheap and can follow every update, the registers which are not tracked are ignored.
+ *
+ * @param type Type of the area (holding and input areas only)
+ * @param address Modbus address of the first register
+ * @param count Number of registers
+ *
+ * @return
+ *     - ESP_OK: The registers are marked
+ *     - ESP_ERR_NOT_FOUND: The registers do not belong to an area
+ *     - ESP_ERR_NOT_SUPPORTED: The change tracking is not enabled
+ */
+esp_err_t mbc_slave_mark_changed(mb_param_type_t type, uint16_t address, uint16_t count);
+
+/**
+ * @brief Get the tracked registers changed after the sequence number
+ *
+ * The registers are reported in the order of change with the reported value and its sequence.
+ * If not all of them fit, the oldest changes are reported and the resume sequence is the sequence
+ * of the last one, so the query with the resume sequence returns the rest. The expired computed
+ * registers of the areas are refreshed from the calling task before the comparison.
+ *
+ * @param type Type of the areas (holding or input)
+ * @param since_seq Sequence number seen by the caller, 0 to get all registers of the areas
+ * @param[out] changes Array for the changed registers
+ * @param max_count Number of entries in the array
+ * @param[out] count Number of reported registers
+ * @param[out] resume_seq Sequence number to use for the next query
+ *
+ * @return
+ *     - ESP_OK: The changes are reported
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_NOT_FOUND: No tracked area of the type
+ *     - ESP_ERR_NOT_SUPPORTED: The change tracking is not enabled
+ */
+esp_err_t mbc_slave_get_changes(mb_param_type_t type, uint32_t since_seq, mb_reg_change_t* changes,
+                                    size_t max_count, size_t* count, uint32_t* resume_seq);
+
+/**
+ * @brief Set the register area descriptor of the virtual slave address (CONFIG_FMB_CONTROLLER_SLAVE_ADDR_MAX)
+ *
+ * The slave serves the address on the same port in addition to its own address, the requests
+ * to the address access only the areas set for it. The areas set by mbc_slave_set_descriptor()
+ * belong to the slave address of the port. The parameter information of the request
+ * has the virtual address in the slave_addr field.
+ *
+ * @param slave_addr Virtual slave address (1 - 247), must differ from the slave address of the port
+ * @param descr_data Register area descriptor as for mbc_slave_set_descriptor()
+ *
+ * @return
+ *     - ESP_OK: The descriptor is set and the address is served
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect or the area is already defined
+ *     - ESP_ERR_INVALID_STATE: The slave interface is not initialized
+ *     - ESP_ERR_NO_MEM: No free virtual address entry or no memory for the descriptor
+ *     - ESP_ERR_NOT_SUPPORTED: The port uses its own descriptor handling
+ */
+esp_err_t mbc_slave_set_addr_descriptor(uint8_t slave_addr, mb_register_area_descriptor_t descr_data);
+
+/**
+ * @brief Get the request counters of the slave address
+ *
+ * @param slave_addr Virtual slave address or 0 for the slave address of the port
+ * @param[out] stats Request counters of the address
+ *
+ * @return
+ *     - ESP_OK: The counters are copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_NOT_FOUND: The address is not served
+ */
+esp_err_t mbc_slave_get_addr_stats(uint8_t slave_addr, mb_slave_addr_stats_t* stats);
+
+/**
+ * @brief Serve Modbus TCP clients next to the started serial slave (CONFIG_FMB_SLAVE_DUAL_TCP)
+ *
+ * The TCP requests are executed by the TCP port task against the same register area
+ * descriptors as the serial requests, the descriptor locks give each request a consistent
+ * view of the registers. The network interface has to be started before.
+ * With ip_mode MB_MODE_UDP the MBAP frames are served connectionless on one socket, each
+ * datagram is one request and the response is sent to its sender (no forwarding).
+ * MB_MODE_RTU_OVER_TCP and MB_MODE_RTU_OVER_UDP carry the RTU frames with CRC instead
+ * (CONFIG_FMB_TCP_RTU_ENCAP), the RTU address has to match slave_uid or be the broadcast.
+ *
+ * @param comm_info TCP communication options of type mb_communication_info_t: ip_port,
+ *                  ip_mode, ip_addr_type, ip_addr (bind address or NULL), ip_netif_ptr and
+ *                  slave_uid (checked if CONFIG_FMB_TCP_UID_ENABLED)
+ *
+ * @return
+ *     - ESP_OK: The TCP port is started
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_INVALID_STATE: The serial slave is not initialized or the TCP port is started already
+ *     - ESP_ERR_NOT_SUPPORTED: The dual transport mode is disabled in configuration
+ */
+esp_err_t mbc_slave_start_tcp(void* comm_info);
+
+/**
+ * @brief Get the counters of the TCP transport in dual transport mode
+ *
+ * @param[out] stats Counters of the TCP transport
+ *
+ * @return
+ *     - ESP_OK: The counters are copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_INVALID_STATE: The TCP port is not started
+ *     - ESP_ERR_NOT_SUPPORTED: The dual transport mode is disabled in configuration
+ */
+esp_err_t mbc_slave_get_tcp_stats(mb_slave_tcp_stats_t* stats);
+
+/**
+ * @brief Get the idle and last request timers of the connected TCP clients in dual transport mode
+ *
+ * @param[out] clients Array for the clients
+ * @param max Size of the array
+ * @param[out] count Number of the clients copied into the array
+ *
+ * @return
+ *     - ESP_OK: The clients are copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_INVALID_STATE: The TCP port is not started
+ *     - ESP_ERR_NOT_SUPPORTED: The dual transport mode is disabled in configuration
+ */
+esp_err_t mbc_slave_get_tcp_clients(mb_slave_tcp_client_t* clients, size_t max, size_t* count);
+
+/**
+ * @brief Set the handler of the TCP requests whose unit identifier is not the slave unit identifier
+ *        (CONFIG_FMB_SLAVE_DUAL_TCP_FORWARD). Without the handler such requests are ignored.
+ *
+ * @param cb handler of the requests or NULL
+ * @param arg argument of the handler
+ *
+ * @return
+ *     - ESP_OK: The handler is set
+ *     - ESP_ERR_NOT_SUPPORTED: The request forwarding is disabled in configuration
+ */
+esp_err_t mbc_slave_set_tcp_forward(mb_slave_tcp_forward_cb_t cb, void* arg);
+
+/**
+ * @brief Send the response of the forwarded TCP request, can be called from any task
+ *
+ * @param tag tag of the request passed to the handler
+ * @param unit_id unit identifier of the request
+ * @param pdu response PDU (function code and data, exception response included)
+ * @param pdu_len length of the PDU
+ *
+ * @return
+ *     - ESP_OK: The response is sent
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_INVALID_STATE: The client is disconnected or the send failed
+ *     - ESP_ERR_NOT_SUPPORTED: The request forwarding is disabled in configuration
+ */
+esp_err_t mbc_slave_tcp_forward_done(uint32_t tag, uint8_t unit_id, const uint8_t* pdu, uint16_t pdu_len);
+
+/**
+ * @brief Serve an independent RTU bus on another UART next to the serial slave (CONFIG_FMB_SLAVE_RTU_PORTS)
+ *
+ * The port has its own UART, task, frame buffer, slave address and counters. Its task executes the
+ * requests against the register area descriptors of its slave address if the address is a virtual
+ * slave address (see mbc_slave_set_addr_descriptor()), so each bus can get its own register map,
+ * against the descriptors of the serial slave otherwise. The ports do not wait for each other or for
+ * the serial slave. Set the pins and the RS485 mode of the UART after the start.
+ *
+ * @param comm_info serial options of type mb_communication_info_t: mode (MB_MODE_RTU), slave_addr,
+ *                  port (not the UART of the serial slave), baudrate and parity
+ * @param core_id core of the port task or tskNO_AFFINITY
+ * @param[out] port_index index of the started port for the other functions
+ *
+ * @return
+ *     - ESP_OK: The port is started
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_INVALID_STATE: The serial slave is not initialized, the UART is in use or all ports are started
+ *     - ESP_ERR_NOT_SUPPORTED: The additional RTU ports are disabled in configuration
+ */
+esp_err_t mbc_slave_start_rtu(void* comm_info, int core_id, uint8_t* port_index);
+
+/**
+ * @brief Stop the additional RTU port and delete its UART driver, mbc_slave_destroy() stops all ports
+ *
+ * @param port_index index of the port
+ *
+ * @return
+ *     - ESP_OK: The port is stopped
+ *     - ESP_ERR_INVALID_STATE: The port is not started
+ *     - ESP_ERR_NOT_SUPPORTED: The additional RTU ports are disabled in configuration
+ */
+esp_err_t mbc_slave_stop_rtu(uint8_t port_index);
+
+/**
+ * @brief Get the counters of the additional RTU port
+ *
+ * @param port_index index of the port
+ * @param[out] stats Counters of the port
+ *
+ * @return
+ *     - ESP_OK: The counters are copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_INVALID_STATE: The port is not started
+ *     - ESP_ERR_NOT_SUPPORTED: The additional RTU ports are disabled in configuration
+ */
+esp_err_t mbc_slave_get_rtu_stats(uint8_t port_index, mb_slave_rtu_stats_t* stats);
+
+/**
+ * @brief Get the turnaround latency histograms of serial slave (CONFIG_FMB_SLAVE_LATENCY_STATS)
+ *
+ * The histograms are updated by the Modbus task without locking, the copy is not an atomic snapshot.
+ *
+ * @param[out] hist Array to copy the histograms of used function codes into
+ * @param max_count Number of entries in the array
+ * @param[out] count Number of histograms copied
+ *
+ * @return
+ *     - ESP_OK: The histograms are copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_NOT_SUPPORTED: The latency statistics are disabled in configuration
+ */
+esp_err_t mbc_slave_get_latency(mb_latency_hist_t* hist, size_t max_count, size_t* count);
+
+/**
+ * @brief Clear the turnaround latency histograms of serial slave
+ *
+ * @return
+ *     - ESP_OK: The histograms are cleared
+ *     - ESP_ERR_NOT_SUPPORTED: The latency statistics are disabled in configuration
+ */
+esp_err_t mbc_slave_reset_latency(void);
+
+/**
+ * @brief Get the power management statistics of serial slave (CONFIG_FMB_SERIAL_PM_LOCK)
+ *
+ * @param[out] stats Statistics of the wakeups and of the awake time
+ *
+ * @return
+ *     - ESP_OK: The statistics are copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_NOT_SUPPORTED: The serial port power management is disabled in configuration
+ */
+esp_err_t mbc_slave_get_pm_stats(mb_serial_pm_stats_t* stats);
+
+/**
+ * @brief Get the frames recorded by the frame trace ring (CONFIG_FMB_FRAME_TRACE)
+ *
+ * The slave records the frames of the serial (RTU) and TCP transports into a ring without locking,
+ * the records overwritten or written during the copy are skipped. The records are in sequence order.
+ *
+ * @param since_seq Sequence number of the last record seen by the caller, 0 to start with the oldest record
+ * @param[out] records Array for the records
+ * @param max_count Number of entries in the array
+ * @param[out] count Number of copied records
+ * @param[out] last_seq Sequence number to use for the next call
+ *
+ * @return
+ *     - ESP_OK: The records are copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_NOT_SUPPORTED: The frame trace is disabled in configuration
+ */
+esp_err_t mbc_slave_get_frames(uint32_t since_seq, mb_frame_record_t* records, size_t max_count,
+                                    size_t* count, uint32_t* last_seq);
+
+/**
+ * @brief Start or stop the frame recording, the recording is started initially
+ *
+ * @param enable Record the frames if true
+ *
+ * @return
+ *     - ESP_OK: The recording is started or stopped
+ *     - ESP_ERR_NOT_SUPPORTED: The frame trace is disabled in configuration
+ */
+esp_err_t mbc_slave_set_frame_trace(bool enable);
+
+/**
+ * @brief Get the record kept in the slot of the frame trace ring (CONFIG_FMB_FRAME_TRACE)
+ *
+ * The record of the sequence number seq is kept in the slot (seq - 1) % CONFIG_FMB_FRAME_TRACE_RING_SIZE,
+ * so the ring can be read at fixed positions, e.g. as a file.
+ *
+ * @param slot Slot of the ring
+ * @param[out] record Copy of the record
+ *
+ * @return
+ *     - ESP_OK: The record is copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_NOT_FOUND: The slot is empty or being written
+ *     - ESP_ERR_NOT_SUPPORTED: The frame trace is disabled in configuration
+ */
+esp_err_t mbc_slave_get_frame_slot(uint16_t slot, mb_frame_record_t* record);
+
+/**
+ * @brief Register the handler of the function code
+ *
+ * The handler replaces the handler of the function code including the standard ones,
+ * the requests are dispatched by the function code without a search.
+ *
+ * @param func_code Function code in the range 1 - 127
+ * @param handler Handler of the function code, NULL to remove the function code
+ *
+ * @return
+ *     - ESP_OK: The handler is registered
+ *     - ESP_ERR_INVALID_ARG: The function code is incorrect
+ */
+esp_err_t mbc_slave_set_handler(uint8_t func_code, mb_func_handler_t handler);
+
+/**
+ * @brief Register the file of the file record functions (CONFIG_FMB_CONTROLLER_FILE_RECORD_SUPPORT)
+ *
+ * The <Read File Record> and <Write File Record> requests for the file number are passed to
+ * the callbacks of the file, the records out of the file get the ILLEGAL DATA ADDRESS exception.
+ *
+ * @param file_number File number in the range 1 - 65535
+ * @param file Descriptor of the file (copied), NULL to remove the file
+ *
+ * @return
+ *     - ESP_OK: The file is registered or removed
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_NO_MEM: CONFIG_FMB_CONTROLLER_FILES_MAX files are registered already
+ *     - ESP_ERR_NOT_SUPPORTED: The file record functions are disabled in configuration
+ */
+esp_err_t mbc_slave_set_file(uint16_t file_number, const mb_file_descriptor_t* file);
+
+/**
+ * @brief Get the number of requests received per function code
+ *
+ * The requests with function codes above 127 are accounted in the entry 0.
+ *
+ * @param[out] hits Array to copy the counters into, indexed by function code
+ * @param count Number of entries in the array, up to MB_FUNC_CODE_COUNT
+ *
+ * @return
+ *     - ESP_OK: The counters are copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ */
+esp_err_t mbc_slave_get_func_hits(uint32_t* hits, size_t count);
+
+/**
+ * @brief Clear the per function code request counters
+ *
+ * @return
+ *     - ESP_OK: The counters are cleared
+ */
+esp_err_t mbc_slave_reset_func_hits(void);
+
+/**
+ * @brief Get the diagnostic counters of the serial line
+ *
+ * The same counters are returned to the master by the Diagnostics function code (8).
+ *
+ * @param[out] counters Counters since start or the last mbc_slave_reset_diag_counters()
+ *
+ * @return
+ *     - ESP_OK: The counters are copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ */
+esp_err_t mbc_slave_get_diag_counters(mb_slave_diag_counters_t* counters);
+
+/**
+ * @brief Clear the diagnostic counters of the serial line
+ *
+ * @return
+ *     - ESP_OK: The counters are cleared
+ */
+esp_err_t mbc_slave_reset_diag_counters(void);
+
+/**
+ * @brief Switch the early address filter of the serial slave (CONFIG_FMB_SERIAL_ADDR_FILTER)
+ *
+ * The RTU frames for other slaves are dropped by the address byte without the CRC check,
+ * so the line errors of the frames are not counted. The filter is enabled on start.
+ *
+ * @param enable true to drop the frames for other slaves early
+ *
+ * @return
+ *     - ESP_OK: The filter is switched
+ *     - ESP_ERR_NOT_SUPPORTED: The address filter is disabled in configuration
+ */
+esp_err_t mbc_slave_set_addr_filter(bool enable);
+
+/**
+ * @brief Start or stop the bus analyzer of the serial slave (CONFIG_FMB_SLAVE_BUS_ANALYZER)
+ *
+ * While the analyzer runs the RTU receiver takes all the frames on the bus (the early address filter
+ * is bypassed), the requests of the master are paired with the responses of the slaves by the address
+ * and the function code. The counters are kept when the analyzer is stopped and cleared on start.
+ *
+ * @param enable Start the analyzer if true, stop otherwise
+ * @param listen_only Do not answer any request while the analyzer runs, not even for the slave address
+ *
+ * @return
+ *     - ESP_OK: The analyzer is started or stopped
+ *     - ESP_ERR_NOT_SUPPORTED: The bus analyzer is disabled in configuration
+ */
+esp_err_t mbc_slave_set_bus_analyzer(bool enable, bool listen_only);
+
+/**
+ * @brief Get the traffic counters of the bus analyzer
+ *
+ * @param[out] stats Counters of the bus
+ * @param[out] slaves Array for the counters of the slaves in the order of the first request, can be NULL
+ * @param max_count Number of entries in the array
+ * @param[out] count Number of copied entries, can be NULL if slaves is NULL
+ *
+ * @return
+ *     - ESP_OK: The counters are copied
+ *     - ESP_ERR_INVALID_ARG: The argument is incorrect
+ *     - ESP_ERR_NOT_SUPPORTED: The bus analyzer is disabled in configuration
+ */
+esp_err_t mbc_slave_get_bus_stats(mb_bus_stats_t* stats, mb_bus_slave_stats_t* slaves, size_t max_count,
+                                    size_t* count);
+
+/**
+ * @brief Clear the traffic counters of the bus analyzer and the table of the slaves
+ *
+ * @return
+ *     - ESP_OK: The counters are cleared
+ *     - ESP_ERR_NOT_SUPPORTED: The bus analyzer is disabled in configuration
+ */
+esp_err_t mbc_slave_reset_bus_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
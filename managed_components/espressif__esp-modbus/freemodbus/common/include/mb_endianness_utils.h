@@ -7,6 +7,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
 /**
  * @brief Defines the constant values based on native compiler byte ordering.
@@ -39,6 +40,23 @@ typedef uint8_t val_16_arr[2];
 typedef uint8_t val_32_arr[4];
 typedef uint8_t val_64_arr[8];
 
+/**
+ * @brief The byte orders of the array conversion API, the same as the suffixes of the value converters
+ */
+typedef enum {
+    MB_ORDER32_ABCD = 0,
+    MB_ORDER32_BADC,
+    MB_ORDER32_CDAB,
+    MB_ORDER32_DCBA
+} mb_order32_t;
+
+typedef enum {
+    MB_ORDER64_ABCDEFGH = 0,
+    MB_ORDER64_BADCFEHG,
+    MB_ORDER64_GHEFCDAB,
+    MB_ORDER64_HGFEDCBA
+} mb_order64_t;
+
 /**
  * @brief Get int8_t (low byte) value represenatation from register
  *
@@ -551,6 +569,71 @@ uint64_t mb_get_uint64_badcfehg(val_64_arr *pui);
  */
 uint64_t mb_set_uint64_badcfehg(val_64_arr *pui, uint64_t ui);
 
+/**
+ * @brief Get count float values from the registers pointed by psrc with the order endianness
+ *
+ * The array converters give the same values as the value converters with the order suffix
+ * called for each element, the byte or word swap is selected once for the whole array.
+ * The register and value buffers may be the same (conversion in place) but must not overlap
+ * otherwise, any alignment is supported, the aligned buffers are converted word by word.
+ */
+void mb_get_float_array(float *pdest, const val_32_arr *psrc, size_t count, mb_order32_t order);
+
+/**
+ * @brief Set count float values from psrc into the registers pointed by pdest with the order endianness
+ */
+void mb_set_float_array(val_32_arr *pdest, const float *psrc, size_t count, mb_order32_t order);
+
+/**
+ * @brief Get count int32_t values from the registers pointed by psrc with the order endianness
+ */
+void mb_get_int32_array(int32_t *pdest, const val_32_arr *psrc, size_t count, mb_order32_t order);
+
+/**
+ * @brief Set count int32_t values from psrc into the registers pointed by pdest with the order endianness
+ */
+void mb_set_int32_array(val_32_arr *pdest, const int32_t *psrc, size_t count, mb_order32_t order);
+
+/**
+ * @brief Get count uint32_t values from the registers pointed by psrc with the order endianness
+ */
+void mb_get_uint32_array(uint32_t *pdest, const val_32_arr *psrc, size_t count, mb_order32_t order);
+
+/**
+ * @brief Set count uint32_t values from psrc into the registers pointed by pdest with the order endianness
+ */
+void mb_set_uint32_array(val_32_arr *pdest, const uint32_t *psrc, size_t count, mb_order32_t order);
+
+/**
+ * @brief Get count double values from the registers pointed by psrc with the order endianness
+ */
+void mb_get_double_array(double *pdest, const val_64_arr *psrc, size_t count, mb_order64_t order);
+
+/**
+ * @brief Set count double values from psrc into the registers pointed by pdest with the order endianness
+ */
+void mb_set_double_array(val_64_arr *pdest, const double *psrc, size_t count, mb_order64_t order);
+
+/**
+ * @brief Get count int64_t values from the registers pointed by psrc with the order endianness
+ */
+void mb_get_int64_array(int64_t *pdest, const val_64_arr *psrc, size_t count, mb_order64_t order);
+
+/**
+ * @brief Set count int64_t values from psrc into the registers pointed by pdest with the order endianness
+ */
+void mb_set_int64_array(val_64_arr *pdest, const int64_t *psrc, size_t count, mb_order64_t order);
+
+/**
+ * @brief Get count uint64_t values from the registers pointed by psrc with the order endianness
+ */
+void mb_get_uint64_array(uint64_t *pdest, const val_64_arr *psrc, size_t count, mb_order64_t order);
+
+/**
+ * @brief Set count uint64_t values from psrc into the registers pointed by pdest with the order endianness
+ */
+void mb_set_uint64_array(val_64_arr *pdest, const uint64_t *psrc, size_t count, mb_order64_t order);
+
 #ifdef __cplusplus
 }
 #endif
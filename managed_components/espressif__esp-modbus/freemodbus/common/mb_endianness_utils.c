@@ -5,6 +5,7 @@
  */
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "mb_endianness_utils.h"
 
@@ -681,3 +682,134 @@ uint64_t ui;
 {
     return mb_set_uint64_generic(1, 0, 3, 2, 5, 4, 7, 6, pui, ui);
 }
+
+/* The byte permutations of the value converters as word operations on the native
+ * (little endian) load of the register bytes, they are their own inverse so
+ * the same swap converts in both directions.
+ */
+#define MB_SWAP16_IN32(v)   ((((v) & 0x00FF00FFUL) << 8) | (((v) >> 8) & 0x00FF00FFUL))
+#define MB_SWAP16_IN64(v)   ((((v) & 0x00FF00FF00FF00FFULL) << 8) | (((v) >> 8) & 0x00FF00FF00FF00FFULL))
+
+/* Convert count elements of the word type with the swap expression of v, the aligned
+ * buffers are accessed by words, the others by memcpy() of each element.
+ */
+#define MB_ARRAY_CONVERT(word_t, pdest, psrc, count, swap)                          \
+    do {                                                                            \
+        uint8_t *pd = (uint8_t *)(pdest);                                           \
+        const uint8_t *ps = (const uint8_t *)(psrc);                                \
+        if ((((uintptr_t)pd | (uintptr_t)ps) & (sizeof(word_t) - 1)) == 0) {        \
+            word_t *pdw = (word_t *)pd;                                             \
+            const word_t *psw = (const word_t *)ps;                                 \
+            for (size_t i = 0; i < (count); i++) {                                  \
+                word_t v = psw[i];                                                  \
+                pdw[i] = (swap);                                                    \
+            }                                                                       \
+        } else {                                                                    \
+            for (size_t i = 0; i < (count); i++) {                                  \
+                word_t v;                                                           \
+                memcpy(&v, ps + i * sizeof(word_t), sizeof(word_t));                \
+                v = (swap);                                                         \
+                memcpy(pd + i * sizeof(word_t), &v, sizeof(word_t));                \
+            }                                                                       \
+        }                                                                           \
+    } while (0)
+
+static void mb_convert_array32(void *pdest, const void *psrc, size_t count, mb_order32_t order)
+{
+    switch (order) {
+    case MB_ORDER32_ABCD:
+        if (pdest != psrc) {
+            memcpy(pdest, psrc, count * sizeof(uint32_t));
+        }
+        break;
+    case MB_ORDER32_BADC:
+        MB_ARRAY_CONVERT(uint32_t, pdest, psrc, count, MB_SWAP16_IN32(v));
+        break;
+    case MB_ORDER32_CDAB:
+        MB_ARRAY_CONVERT(uint32_t, pdest, psrc, count, (v << 16) | (v >> 16));
+        break;
+    case MB_ORDER32_DCBA:
+        MB_ARRAY_CONVERT(uint32_t, pdest, psrc, count, __builtin_bswap32(v));
+        break;
+    }
+}
+
+static void mb_convert_array64(void *pdest, const void *psrc, size_t count, mb_order64_t order)
+{
+    switch (order) {
+    case MB_ORDER64_ABCDEFGH:
+        if (pdest != psrc) {
+            memcpy(pdest, psrc, count * sizeof(uint64_t));
+        }
+        break;
+    case MB_ORDER64_BADCFEHG:
+        MB_ARRAY_CONVERT(uint64_t, pdest, psrc, count, MB_SWAP16_IN64(v));
+        break;
+    case MB_ORDER64_GHEFCDAB:
+        MB_ARRAY_CONVERT(uint64_t, pdest, psrc, count, MB_SWAP16_IN64(__builtin_bswap64(v)));
+        break;
+    case MB_ORDER64_HGFEDCBA:
+        MB_ARRAY_CONVERT(uint64_t, pdest, psrc, count, __builtin_bswap64(v));
+        break;
+    }
+}
+
+void mb_get_float_array(float *pdest, const val_32_arr *psrc, size_t count, mb_order32_t order)
+{
+    mb_convert_array32(pdest, psrc, count, order);
+}
+
+void mb_set_float_array(val_32_arr *pdest, const float *psrc, size_t count, mb_order32_t order)
+{
+    mb_convert_array32(pdest, psrc, count, order);
+}
+
+void mb_get_int32_array(int32_t *pdest, const val_32_arr *psrc, size_t count, mb_order32_t order)
+{
+    mb_convert_array32(pdest, psrc, count, order);
+}
+
+void mb_set_int32_array(val_32_arr *pdest, const int32_t *psrc, size_t count, mb_order32_t order)
+{
+    mb_convert_array32(pdest, psrc, count, order);
+}
+
+void mb_get_uint32_array(uint32_t *pdest, const val_32_arr *psrc, size_t count, mb_order32_t order)
+{
+    mb_convert_array32(pdest, psrc, count, order);
+}
+
+void mb_set_uint32_array(val_32_arr *pdest, const uint32_t *psrc, size_t count, mb_order32_t order)
+{
+    mb_convert_array32(pdest, psrc, count, order);
+}
+
+void mb_get_double_array(double *pdest, const val_64_arr *psrc, size_t count, mb_order64_t order)
+{
+    mb_convert_array64(pdest, psrc, count, order);
+}
+
+void mb_set_double_array(val_64_arr *pdest, const double *psrc, size_t count, mb_order64_t order)
+{
+    mb_convert_array64(pdest, psrc, count, order);
+}
+
+void mb_get_int64_array(int64_t *pdest, const val_64_arr *psrc, size_t count, mb_order64_t order)
+{
+    mb_convert_array64(pdest, psrc, count, order);
+}
+
+void mb_set_int64_array(val_64_arr *pdest, const int64_t *psrc, size_t count, mb_order64_t order)
+{
+    mb_convert_array64(pdest, psrc, count, order);
+}
+
+void mb_get_uint64_array(uint64_t *pdest, const val_64_arr *psrc, size_t count, mb_order64_t order)
+{
+    mb_convert_array64(pdest, psrc, count, order);
+}
+
+void mb_set_uint64_array(val_64_arr *pdest, const uint64_t *psrc, size_t count, mb_order64_t order)
+{
+    mb_convert_array64(pdest, psrc, count, order);
+}
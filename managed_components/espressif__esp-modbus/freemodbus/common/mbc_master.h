@@ -23,6 +23,12 @@
 
 /* ----------------------- Defines ------------------------------------------*/
 
+#if CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT
+// Slave health access, implemented in port layer (port/porthealth_m.c)
+esp_err_t mb_port_health_get(uint8_t slave_addr, mb_slave_health_t* health);
+void mb_port_health_reset(void);
+#endif
+
 /**
  * @brief Request mode for parameter to use in data dictionary
  */
@@ -79,6 +85,7 @@ typedef esp_err_t (*iface_get_parameter)(uint16_t, char*, uint8_t*, uint8_t*);
 typedef esp_err_t (*iface_send_request)(mb_param_request_t*, void*);                  /*!< Interface send_request method */
 typedef esp_err_t (*iface_set_descriptor)(const mb_parameter_descriptor_t*, const uint16_t); /*!< Interface set_descriptor method */
 typedef esp_err_t (*iface_set_parameter)(uint16_t, char*, uint8_t*, uint8_t*);        /*!< Interface set_parameter method */
+typedef esp_err_t (*iface_send_requests)(const mb_param_request_t*, void* const*, esp_err_t*, size_t); /*!< Interface send_requests method */
 
 /**
  * @brief Modbus controller interface structure
@@ -97,6 +104,7 @@ typedef struct {
     iface_send_request send_request;        /*!< Interface send_request method */
     iface_set_descriptor set_descriptor;    /*!< Interface set_descriptor method */
     iface_set_parameter set_parameter;      /*!< Interface set_parameter method */
+    iface_send_requests send_requests;      /*!< Interface send_requests method, NULL if not supported */
     // Modbus register calback function pointers
     reg_discrete_cb master_reg_cb_discrete; /*!< Stack callback discrete rw method */
     reg_input_cb master_reg_cb_input;       /*!< Stack callback input rw method */
@@ -12,6 +12,7 @@
 #include "sys/queue.h"      // for list
 #include "esp_log.h"        // for log write
 #include "string.h"         // for strerror()
+#include "freertos/semphr.h" // for notification ring semaphore
 
 #include "esp_modbus_slave.h"    // for public type defines
 #include "esp_modbus_callbacks.h"   // for callback functions
@@ -22,6 +23,14 @@
 
 #define MB_CONTROLLER_NOTIFY_QUEUE_SIZE     (CONFIG_FMB_CONTROLLER_NOTIFY_QUEUE_SIZE) // Number of messages in parameter notification queue
 #define MB_CONTROLLER_NOTIFY_TIMEOUT        (pdMS_TO_TICKS(CONFIG_FMB_CONTROLLER_NOTIFY_TIMEOUT)) // notification timeout
+#define MB_PAR_INFO_TO_TICKS(tout)          (((tout) == MB_PAR_INFO_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(tout))
+
+#if CONFIG_FMB_CONTROLLER_NOTIFY_RING
+#define MB_CONTROLLER_NOTIFY_RING_SIZE      (CONFIG_FMB_CONTROLLER_NOTIFY_RING_SIZE) // Number of slots in notification ring
+#define MB_CONTROLLER_NOTIFY_RING_MASK      (MB_CONTROLLER_NOTIFY_RING_SIZE - 1)
+_Static_assert(((MB_CONTROLLER_NOTIFY_RING_SIZE & MB_CONTROLLER_NOTIFY_RING_MASK) == 0),
+                "The notification ring size must be a power of two.");
+#endif
 
 /**
  * @brief Device communication parameters for master
@@ -34,17 +43,152 @@ typedef struct {
     uart_parity_t parity;                   /*!< Modbus UART parity settings */
 } mb_slave_comm_info_t;
 
+#if CONFIG_FMB_SLAVE_LATENCY_STATS
+// Latency histograms access, implemented in port layer (port/portlatency.c)
+size_t mb_port_latency_get(mb_latency_hist_t* hist, size_t max_count);
+void mb_port_latency_reset(void);
+#endif
+
+#if CONFIG_FMB_SERIAL_PM_LOCK
+// Power management statistics of the serial slave port, implemented in port layer (port/portserial.c)
+void mb_port_pm_get(mb_serial_pm_stats_t* stats);
+#endif
+
+#if CONFIG_FMB_FRAME_TRACE
+// Frame trace ring access, implemented in port layer (port/porttrace.c)
+size_t mb_port_trace_get(uint32_t since_seq, mb_frame_record_t* records, size_t max_count, uint32_t* last_seq);
+void mb_port_trace_enable(bool enable);
+bool mb_port_trace_get_slot(uint16_t slot, mb_frame_record_t* record);
+#endif
+
+#if CONFIG_FMB_SLAVE_BUS_ANALYZER
+// Bus analyzer access, implemented in port layer (port/portanalyzer.c)
+void mb_port_analyzer_set(bool enable, bool listen_only);
+size_t mb_port_analyzer_get(mb_bus_stats_t* stats, mb_bus_slave_stats_t* slaves, size_t max_count);
+void mb_port_analyzer_reset(void);
+#endif
+
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+#define MB_AREA_CACHE_BLOCK_REGS            (CONFIG_FMB_SLAVE_AREA_CACHE_BLOCK_REGS) // Registers per cache block
+#define MB_AREA_CACHE_BLOCK_SHIFT           (__builtin_ctz(MB_AREA_CACHE_BLOCK_REGS))
+#define MB_AREA_CACHE_AGE_PERIOD            (65536) // Number of block reads between the halving of counters
+_Static_assert(((MB_AREA_CACHE_BLOCK_REGS & (MB_AREA_CACHE_BLOCK_REGS - 1)) == 0),
+                "The area cache block size must be a power of two.");
+
+/**
+ * @brief Cached block of the register area in storage byte order
+ */
+typedef struct {
+    uint16_t block;                         /*!< Index of the cached block */
+    uint32_t seq;                           /*!< Sequence of the area lock when the block was copied */
+    uint32_t gen;                           /*!< Write generation of the area when the block was copied */
+    uint16_t data[MB_AREA_CACHE_BLOCK_REGS]; /*!< Registers of the block */
+} mb_area_cache_slot_t;
+
+/**
+ * @brief Hot block cache and read counters of the register area
+ */
+typedef struct {
+    SemaphoreHandle_t mutex;                /*!< Serializes the serial and TCP port tasks, the copies
+                                                 from PSRAM are too long for a critical section */
+    StaticSemaphore_t mutex_buf;            /*!< Storage of the mutex */
+    uint32_t gen;                           /*!< Write generation, incremented on writes of the stack */
+    uint32_t reads;                         /*!< Block reads since the last halving of counters */
+    uint16_t blocks;                        /*!< Number of blocks in the area */
+    uint16_t slot_count;                    /*!< Number of cache slots */
+    uint16_t cached;                        /*!< Number of used cache slots */
+    mb_area_cache_slot_t* slots;            /*!< Cache slots */
+    uint32_t* heat;                         /*!< Read counters of the blocks */
+    uint8_t* slot_of_block;                 /*!< Slot number + 1 of each block, 0 if not cached */
+    uint32_t hits;                          /*!< Block reads served from the cache */
+    uint32_t misses;                        /*!< Block reads served from the area */
+    uint32_t evictions;                     /*!< Replaced cached blocks */
+} mb_area_cache_t;
+#endif
+
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
+/**
+ * @brief Change tracking state of the register area
+ */
+typedef struct {
+    uint32_t* dirty;                        /*!< Registers updated since the last comparison, one bit per register */
+    uint16_t* shadow;                       /*!< Last reported values in host byte order */
+    uint32_t* seq;                          /*!< Change sequence numbers of the reported values */
+    const uint16_t* deadband;               /*!< Optional table of deadbands */
+    uint16_t regs;                          /*!< Number of registers in the area */
+} mb_change_tracker_t;
+#endif
+
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+/**
+ * @brief Kind of the area hook, index of its statistics
+ */
+typedef enum {
+    MB_AREA_HOOK_PRE_READ = 0,
+    MB_AREA_HOOK_POST_WRITE,
+    MB_AREA_HOOK_COUNT
+} mb_area_hook_kind_t;
+
+/**
+ * @brief Hooks of the register area and their timing state
+ */
+typedef struct {
+    mb_area_hooks_t hooks;                  /*!< Copy of the hooks set by application */
+    mb_area_hook_stats_t stats[MB_AREA_HOOK_COUNT]; /*!< Timing statistics per hook */
+    uint16_t overrun_run[MB_AREA_HOOK_COUNT]; /*!< Number of the consecutive overruns per hook */
+} mb_area_hook_state_t;
+#endif
+
 /**
  * @brief Modbus area descriptor list item
  */
 typedef struct mb_descr_entry_s{
+    uint8_t slave_addr;                     /*!< Virtual slave address of the area, 0 for the slave address */
     uint16_t start_offset;                  /*!< Modbus start address for area descriptor */
     mb_param_type_t type;                   /*!< Type of storage area descriptor */
     void* p_data;                           /*!< Instance address for storage area descriptor */
     size_t size;                            /*!< Instance size for area descriptor (bytes) */
+    uint32_t end_offset;                    /*!< Modbus end address (exclusive) for area descriptor */
+    bool wire_order;                        /*!< Registers are stored in big endian (wire) byte order */
+    mb_seqlock_t* lock;                     /*!< Optional sequence lock for the area shared with application */
+    mb_seqlock_t commit_lock;               /*!< Own sequence lock of the area published by the stack */
+    mb_computed_reg_t* computed;            /*!< Optional table of computed registers */
+    uint16_t computed_count;                /*!< Number of entries in the table of computed registers */
+    const mb_reg_binding_t* bindings;       /*!< Optional table of the bound application variables */
+    uint16_t binding_count;                 /*!< Number of entries in the table of bindings */
+    const mb_reg_access_t* access;          /*!< Optional table of access rules */
+    uint16_t access_count;                  /*!< Number of entries in the table of access rules */
+#if CONFIG_FMB_SLAVE_AREA_CACHE
+    mb_area_cache_t* cache;                 /*!< Optional hot block cache */
+#endif
+#if CONFIG_FMB_SLAVE_CHANGE_TRACKING
+    mb_change_tracker_t* tracker;           /*!< Optional change tracking state */
+#endif
+#if CONFIG_FMB_SLAVE_AREA_HOOKS
+    mb_area_hook_state_t* hooks;            /*!< Optional synchronous hooks */
+#endif
+#if CONFIG_FMB_CONTROLLER_DESCR_INDEX
+    uint16_t index_pos;                     /*!< Position of descriptor in the sorted index */
+#endif
     LIST_ENTRY(mb_descr_entry_s) entries;    /*!< The Modbus area descriptor entry */
 } mb_descr_entry_t;
 
+#if CONFIG_FMB_CONTROLLER_NOTIFY_RING
+/**
+ * @brief Single producer (Modbus task) single consumer (application task) notification ring
+ */
+typedef struct {
+    mb_param_info_t items[MB_CONTROLLER_NOTIFY_RING_SIZE]; /*!< Ring storage */
+    uint32_t head;                          /*!< Write counter, updated by producer only */
+    uint32_t tail;                          /*!< Read counter, updated by consumer only */
+    SemaphoreHandle_t ready_sema;           /*!< Given by producer to wake up the waiting consumer */
+    StaticSemaphore_t ready_sema_buf;       /*!< Static storage for the semaphore */
+#if CONFIG_FMB_SLAVE_CONCURRENT_EXEC
+    portMUX_TYPE producer_mux;              /*!< Serializes the port tasks as producers */
+#endif
+} mb_notify_ring_t;
+#endif
+
 /**
  * @brief Modbus controller handler structure
  */
@@ -54,7 +198,15 @@ typedef struct {
     TaskHandle_t mbs_task_handle;                       /*!< task handle */
     EventGroupHandle_t mbs_event_group;                 /*!< controller event group */
     QueueHandle_t mbs_notification_queue_handle;        /*!< controller notification queue */
+#if CONFIG_FMB_CONTROLLER_NOTIFY_RING
+    mb_notify_ring_t mbs_notification_ring;             /*!< controller notification ring */
+#endif
+    uint32_t mbs_notification_overflow;                 /*!< number of lost notifications */
     LIST_HEAD(mbs_area_descriptors_, mb_descr_entry_s) mbs_area_descriptors[MB_PARAM_COUNT]; /*!< register area descriptors */
+#if CONFIG_FMB_CONTROLLER_DESCR_INDEX
+    mb_descr_entry_t** mbs_descr_index[MB_PARAM_COUNT]; /*!< register area descriptors sorted by start offset */
+    uint16_t mbs_descr_count[MB_PARAM_COUNT];           /*!< number of descriptors in the index */
+#endif
 } mb_slave_options_t;
 
 typedef mb_event_group_t (*iface_check_event)(mb_event_group_t);          /*!< Interface method check_event */
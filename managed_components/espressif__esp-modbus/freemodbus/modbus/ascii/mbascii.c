@@ -76,6 +76,10 @@ typedef enum
     BYTE_LOW_NIBBLE             /*!< Character for low nibble of byte. */
 } eMBBytePos;
 
+/* ----------------------- Defines ------------------------------------------*/
+/* Characters read from the UART at once by the block receiver. */
+#define MB_ASCII_RX_CHUNK_SIZE      ( 64 )
+
 /* ----------------------- Shared variables ---------------------------------*/
 /* We reuse the Modbus RTU buffer because only one driver is active */
 extern volatile UCHAR ucMbSlaveBuf[];
@@ -102,6 +106,20 @@ static volatile USHORT usSndBufferCount;
 static volatile UCHAR ucLRC;
 static volatile UCHAR ucMBLFCharacter;
 
+/* Binary value of the characters '0' to 'F', 0xFF for the characters between '9' and 'A'. */
+static const UCHAR aucMBChar2Bin[] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+};
+
+static const UCHAR aucMBBin2Char[] = "0123456789ABCDEF";
+
+#if MB_SERIAL_TX_BLOCK_ENABLED
+/* The encoded response: ':', two characters per byte of the frame and LRC, CR and LF. */
+static UCHAR    ucASCIISndBuf[1 + 2 * MB_SER_PDU_SIZE_MAX + 2];
+#endif
+
 /* ----------------------- Start implementation -----------------------------*/
 eMBErrorCode
 eMBASCIIInit( UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
@@ -159,12 +177,15 @@ eMBASCIIReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength )
         return MB_EIO;
     }
 
+    vMBDiagCount( MB_DIAG_BUS_MESSAGES );
     ENTER_CRITICAL_SECTION(  );
     assert( usFrameLength < MB_SER_PDU_SIZE_MAX );
 
-    /* Length and CRC check */
-   if( ( usFrameLength >= MB_ASCII_SER_PDU_SIZE_MIN )
-        && ( prvucMBLRC( ( UCHAR * ) pucMBASCIIFrame, usFrameLength ) == 0 ) )
+    /* Length and LRC check, the LRC of the received frame is summed up
+     * by the receiver unless the port replaced the frame. */
+    if( ( usFrameLength >= MB_ASCII_SER_PDU_SIZE_MIN )
+        && ( ( ( pucMBASCIIFrame == ( UCHAR * ) ucASCIIBuf ) && ( usFrameLength == usRcvBufferPos ) )
+             ? ( ucLRC == 0 ) : ( prvucMBLRC( ( UCHAR * ) pucMBASCIIFrame, usFrameLength ) == 0 ) ) )
     {
         /* Save the address field. All frames are passed to the upper layed
          * and the decision if a frame is used is done there.
@@ -181,9 +202,12 @@ eMBASCIIReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength )
     }
     else
     {
+        vMBDiagCount( MB_DIAG_BUS_COMM_ERRORS );
         eStatus = MB_EIO;
     }
     EXIT_CRITICAL_SECTION(  );
+    vMBPortTraceFrame( ( eStatus == MB_ENOERR ) ? MB_TRACE_RX : ( MB_TRACE_RX | MB_TRACE_ERROR ),
+                       pucMBASCIIFrame, usFrameLength );
     return eStatus;
 }
 
@@ -257,6 +281,7 @@ xMBASCIIReceiveFSM( void )
             /* Empty receive buffer. */
             eBytePos = BYTE_HIGH_NIBBLE;
             usRcvBufferPos = 0;
+            ucLRC = 0;
         }
         else if( ucByte == MB_ASCII_DEFAULT_CR )
         {
@@ -288,6 +313,7 @@ xMBASCIIReceiveFSM( void )
 
             case BYTE_LOW_NIBBLE:
                 ucASCIIBuf[usRcvBufferPos] |= ucResult;
+                ucLRC += ucASCIIBuf[usRcvBufferPos];
                 usRcvBufferPos++;
                 eBytePos = BYTE_HIGH_NIBBLE;
                 break;
@@ -313,6 +339,7 @@ xMBASCIIReceiveFSM( void )
             /* Empty receive buffer and back to receive state. */
             eBytePos = BYTE_HIGH_NIBBLE;
             usRcvBufferPos = 0;
+            ucLRC = 0;
             eRcvState = STATE_RX_RCV;
 
             /* Enable timer for character timeout. */
@@ -333,6 +360,7 @@ xMBASCIIReceiveFSM( void )
             /* Reset the input buffers to store the frame. */
             usRcvBufferPos = 0;
             eBytePos = BYTE_HIGH_NIBBLE;
+            ucLRC = 0;
             eRcvState = STATE_RX_RCV;
         }
         break;
@@ -341,6 +369,139 @@ xMBASCIIReceiveFSM( void )
     return xNeedPoll;
 }
 
+#if MB_SERIAL_RX_BLOCK_ENABLED
+BOOL
+xMBASCIIReceiveBlock( USHORT usLength )
+{
+    UCHAR           aucChunk[MB_ASCII_RX_CHUNK_SIZE];
+    UCHAR          *pucBuf = ( UCHAR * ) ucASCIIBuf;
+    eMBRcvState     eState;
+    eMBBytePos      ePos;
+    USHORT          usPos;
+    UCHAR           ucSum;
+    UCHAR           ucLF;
+
+    if( eSndState != STATE_TX_IDLE )
+    {
+        return FALSE;
+    }
+
+    /* The same states as xMBASCIIReceiveFSM() in local copies. A burst may
+     * hold the frame partly, the receiver then continues with the next
+     * burst or the byte state machine and the character timeout. */
+    ENTER_CRITICAL_SECTION(  );
+    eState = eRcvState;
+    ePos = eBytePos;
+    usPos = usRcvBufferPos;
+    ucSum = ucLRC;
+    ucLF = ucMBLFCharacter;
+    EXIT_CRITICAL_SECTION(  );
+
+    while( usLength > 0 )
+    {
+        USHORT          usChunk = usMBPortSerialGetBlock( aucChunk,
+                                    ( usLength < sizeof( aucChunk ) ) ? usLength : sizeof( aucChunk ) );
+        if( usChunk == 0 )
+        {
+            break;
+        }
+        usLength -= usChunk;
+
+        for( USHORT usIdx = 0; usIdx < usChunk; usIdx++ )
+        {
+            UCHAR           ucByte = aucChunk[usIdx];
+            UCHAR           ucNibble;
+
+            if( ucByte == ':' )
+            {
+                /* Start of a frame in any state. */
+                eState = STATE_RX_RCV;
+                ePos = BYTE_HIGH_NIBBLE;
+                usPos = 0;
+                ucSum = 0;
+                continue;
+            }
+            switch ( eState )
+            {
+            case STATE_RX_RCV:
+                if( ucByte == MB_ASCII_DEFAULT_CR )
+                {
+                    eState = STATE_RX_WAIT_EOF;
+                    break;
+                }
+                ucNibble = prvucMBCHAR2BIN( ucByte );
+                if( ePos == BYTE_HIGH_NIBBLE )
+                {
+                    if( ( ucNibble > 0x0F ) || ( usPos >= MB_SER_PDU_SIZE_MAX ) )
+                    {
+                        /* Not a hex character or buffer overflow, drop the frame. */
+                        eState = STATE_RX_IDLE;
+                        break;
+                    }
+                    pucBuf[usPos] = ( UCHAR )( ucNibble << 4 );
+                    ePos = BYTE_LOW_NIBBLE;
+                }
+                else if( ucNibble <= 0x0F )
+                {
+                    pucBuf[usPos] |= ucNibble;
+                    ucSum += pucBuf[usPos];
+                    usPos++;
+                    ePos = BYTE_HIGH_NIBBLE;
+                }
+                else
+                {
+                    eState = STATE_RX_IDLE;
+                }
+                break;
+
+            case STATE_RX_WAIT_EOF:
+                eState = STATE_RX_IDLE;
+                /* The damaged frame is dropped here without waking up the stack. */
+                if( ( ucByte == ucLF ) && ( usPos >= MB_ASCII_SER_PDU_SIZE_MIN ) && ( ucSum == 0 ) )
+                {
+                    ENTER_CRITICAL_SECTION(  );
+                    usRcvBufferPos = usPos;
+                    ucLRC = ucSum;
+                    eRcvState = STATE_RX_IDLE;
+                    EXIT_CRITICAL_SECTION(  );
+                    ( void )xMBPortEventPost( EV_FRAME_RECEIVED );
+                }
+                else
+                {
+                    /* Counted as eMBASCIIReceive() counts the damaged frames
+                     * of the receiver state machine. */
+                    vMBDiagCount( MB_DIAG_BUS_MESSAGES );
+                    vMBDiagCount( MB_DIAG_BUS_COMM_ERRORS );
+                    vMBPortTraceFrame( MB_TRACE_RX | MB_TRACE_ERROR, pucBuf, usPos );
+                }
+                break;
+
+            case STATE_RX_IDLE:
+                break;
+            }
+        }
+    }
+
+    ENTER_CRITICAL_SECTION(  );
+    eRcvState = eState;
+    eBytePos = ePos;
+    usRcvBufferPos = usPos;
+    ucLRC = ucSum;
+    EXIT_CRITICAL_SECTION(  );
+
+    /* Character timeout only while a frame is incomplete. */
+    if( eState == STATE_RX_IDLE )
+    {
+        vMBPortTimersDisable(  );
+    }
+    else
+    {
+        vMBPortTimersEnable(  );
+    }
+    return TRUE;
+}
+#endif
+
 BOOL
 xMBASCIITransmitFSM( void )
 {
@@ -415,6 +576,42 @@ xMBASCIITransmitFSM( void )
     return xNeedPoll;
 }
 
+#if MB_SERIAL_TX_BLOCK_ENABLED
+BOOL
+xMBASCIITransmitBlock( UCHAR ** ppucFrame, USHORT * pusLength )
+{
+    const UCHAR    *pucSrc = ( const UCHAR * ) pucSndBufferCur;
+    UCHAR          *pucDst = ucASCIISndBuf;
+
+    if( ( eRcvState != STATE_RX_IDLE ) || ( eSndState != STATE_TX_START )
+        || ( usSndBufferCount > MB_SER_PDU_SIZE_MAX ) )
+    {
+        return FALSE;
+    }
+
+    /* Encode the frame including the LRC byte in one pass and give away
+     * the whole response, the transmitter is finished the same way as
+     * xMBASCIITransmitFSM() does in STATE_TX_NOTIFY. */
+    *pucDst++ = ':';
+    for( USHORT usIdx = 0; usIdx < usSndBufferCount; usIdx++ )
+    {
+        *pucDst++ = aucMBBin2Char[pucSrc[usIdx] >> 4];
+        *pucDst++ = aucMBBin2Char[pucSrc[usIdx] & 0x0F];
+    }
+    *pucDst++ = MB_ASCII_DEFAULT_CR;
+    *pucDst++ = ucMBLFCharacter;
+
+    *ppucFrame = ucASCIISndBuf;
+    *pusLength = ( USHORT )( pucDst - ucASCIISndBuf );
+    pucSndBufferCur += usSndBufferCount;
+    usSndBufferCount = 0;
+
+    eSndState = STATE_TX_IDLE;
+    xMBPortEventPost( EV_FRAME_TRANSMIT );
+    return TRUE;
+}
+#endif
+
 BOOL MB_PORT_ISR_ATTR
 xMBASCIITimerT1SExpired( void )
 {
@@ -443,37 +640,17 @@ xMBASCIITimerT1SExpired( void )
 static          UCHAR
 prvucMBCHAR2BIN( UCHAR ucCharacter )
 {
-    if( ( ucCharacter >= '0' ) && ( ucCharacter <= '9' ) )
-    {
-        return ( UCHAR )( ucCharacter - '0' );
-    }
-    else if( ( ucCharacter >= 'A' ) && ( ucCharacter <= 'F' ) )
-    {
-        return ( UCHAR )( ucCharacter - 'A' + 0x0A );
-    }
-    else
-    {
-        return 0xFF;
-    }
+    /* One compare for the characters below '0' and above 'F'. */
+    UCHAR           ucIdx = ( UCHAR )( ucCharacter - '0' );
+
+    return ( ucIdx < sizeof( aucMBChar2Bin ) ) ? aucMBChar2Bin[ucIdx] : 0xFF;
 }
 
 static          UCHAR
 prvucMBBIN2CHAR( UCHAR ucByte )
 {
-    if( ucByte <= 0x09 )
-    {
-        return ( UCHAR )( '0' + ucByte );
-    }
-    else if( ( ucByte >= 0x0A ) && ( ucByte <= 0x0F ) )
-    {
-        return ( UCHAR )( ucByte - 0x0A + 'A' );
-    }
-    else
-    {
-        /* Programming error. */
-        assert( 0 );
-    }
-    return '0';
+    assert( ucByte <= 0x0F );
+    return aucMBBin2Char[ucByte & 0x0F];
 }
 
 
@@ -62,6 +62,12 @@ eMBErrorCode    eMBASCIISend( UCHAR slaveAddress, const UCHAR * pucFrame,
 BOOL            xMBASCIIReceiveFSM( void );
 BOOL            xMBASCIITransmitFSM( void );
 BOOL            xMBASCIITimerT1SExpired( void );
+#if MB_SERIAL_RX_BLOCK_ENABLED
+BOOL            xMBASCIIReceiveBlock( USHORT usLength );
+#endif
+#if MB_SERIAL_TX_BLOCK_ENABLED
+BOOL            xMBASCIITransmitBlock( UCHAR ** ppucFrame, USHORT * pusLength );
+#endif
 #endif
 
 #if MB_MASTER_ASCII_ENABLED > 0
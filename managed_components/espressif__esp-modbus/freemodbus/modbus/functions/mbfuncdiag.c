@@ -34,3 +34,168 @@
  *
  * File: $Id: mbfuncdiag.c,v 1.3 2006/12/07 22:10:34 wolti Exp $
  */
+
+/* ----------------------- System includes ----------------------------------*/
+#include "stdlib.h"
+#include "string.h"
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbframe.h"
+#include "mbproto.h"
+#include "mbconfig.h"
+
+#if MB_FUNC_DIAG_DIAGNOSTIC_ENABLED > 0
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_PDU_FUNC_DIAG_SUB_OFF            ( MB_PDU_DATA_OFF )
+#define MB_PDU_FUNC_DIAG_DATA_OFF           ( MB_PDU_DATA_OFF + 2 )
+#define MB_PDU_FUNC_DIAG_SIZE               ( 4 )
+
+/* Sub-function codes of the Modbus application protocol specification. */
+#define MB_DIAG_SUB_RETURN_QUERY_DATA       ( 0x0000 )
+#define MB_DIAG_SUB_RESTART_COMM            ( 0x0001 )
+#define MB_DIAG_SUB_RETURN_REGISTER         ( 0x0002 )
+#define MB_DIAG_SUB_CLEAR_COUNTERS          ( 0x000A )
+#define MB_DIAG_SUB_BUS_MESSAGE_CNT         ( 0x000B )
+#define MB_DIAG_SUB_BUS_COMM_ERROR_CNT      ( 0x000C )
+#define MB_DIAG_SUB_BUS_EXCEPTION_CNT       ( 0x000D )
+#define MB_DIAG_SUB_SERVER_MESSAGE_CNT      ( 0x000E )
+#define MB_DIAG_SUB_SERVER_NO_RESPONSE_CNT  ( 0x000F )
+#define MB_DIAG_SUB_SERVER_NAK_CNT          ( 0x0010 )
+#define MB_DIAG_SUB_SERVER_BUSY_CNT         ( 0x0011 )
+#define MB_DIAG_SUB_BUS_OVERRUN_CNT         ( 0x0012 )
+#define MB_DIAG_SUB_CLEAR_OVERRUN           ( 0x0014 )
+
+/* Vendor specific sub-functions, outside of the range used by the specification. */
+#define MB_DIAG_SUB_NOT_ADDRESSED_CNT       ( 0x0100 )
+#define MB_DIAG_SUB_BROADCAST_CNT           ( 0x0101 )
+#define MB_DIAG_SUB_PARITY_ERROR_CNT        ( 0x0102 )
+#define MB_DIAG_SUB_FRAME_ERROR_CNT         ( 0x0103 )
+#define MB_DIAG_SUB_FIFO_OVERFLOW_CNT       ( 0x0104 )
+#define MB_DIAG_SUB_BUFFER_FULL_CNT         ( 0x0105 )
+
+/* ----------------------- Start implementation -----------------------------*/
+eMBException
+eMBFuncDiagnostic( UCHAR * pucFrame, USHORT * usLen )
+{
+    USHORT          usSubFunc;
+    USHORT          usData;
+    ULONG           ulValue = 0;
+
+    if( *usLen < ( MB_PDU_FUNC_DIAG_SIZE + MB_PDU_SIZE_MIN ) )
+    {
+        return MB_EX_ILLEGAL_DATA_VALUE;
+    }
+    usSubFunc = ( USHORT )( pucFrame[MB_PDU_FUNC_DIAG_SUB_OFF] << 8 );
+    usSubFunc |= ( USHORT )( pucFrame[MB_PDU_FUNC_DIAG_SUB_OFF + 1] );
+
+    /* The query data is echoed with any length, the response is the request. */
+    if( usSubFunc == MB_DIAG_SUB_RETURN_QUERY_DATA )
+    {
+        return MB_EX_NONE;
+    }
+    if( *usLen != ( MB_PDU_FUNC_DIAG_SIZE + MB_PDU_SIZE_MIN ) )
+    {
+        return MB_EX_ILLEGAL_DATA_VALUE;
+    }
+    usData = ( USHORT )( pucFrame[MB_PDU_FUNC_DIAG_DATA_OFF] << 8 );
+    usData |= ( USHORT )( pucFrame[MB_PDU_FUNC_DIAG_DATA_OFF + 1] );
+
+    switch ( usSubFunc )
+    {
+    case MB_DIAG_SUB_RESTART_COMM:
+        /* 0xFF00 also clears the event log which is not kept, the response echoes the data. */
+        if( ( usData != 0x0000 ) && ( usData != 0xFF00 ) )
+        {
+            return MB_EX_ILLEGAL_DATA_VALUE;
+        }
+        vMBResetDiagCounters(  );
+        return MB_EX_NONE;
+
+    case MB_DIAG_SUB_CLEAR_COUNTERS:
+    case MB_DIAG_SUB_CLEAR_OVERRUN:
+        if( usData != 0x0000 )
+        {
+            return MB_EX_ILLEGAL_DATA_VALUE;
+        }
+        if( usSubFunc == MB_DIAG_SUB_CLEAR_COUNTERS )
+        {
+            vMBResetDiagCounters(  );
+        }
+        else
+        {
+            vMBResetDiagCounter( MB_DIAG_FIFO_OVERFLOWS );
+            vMBResetDiagCounter( MB_DIAG_BUFFER_FULL );
+        }
+        return MB_EX_NONE;
+
+    case MB_DIAG_SUB_RETURN_REGISTER:
+    case MB_DIAG_SUB_SERVER_NAK_CNT:
+    case MB_DIAG_SUB_SERVER_BUSY_CNT:
+        /* No diagnostic register, NAK or busy responses. */
+        break;
+
+    case MB_DIAG_SUB_BUS_MESSAGE_CNT:
+        ulValue = ulMBGetDiagCounter( MB_DIAG_BUS_MESSAGES );
+        break;
+
+    case MB_DIAG_SUB_BUS_COMM_ERROR_CNT:
+        ulValue = ulMBGetDiagCounter( MB_DIAG_BUS_COMM_ERRORS );
+        break;
+
+    case MB_DIAG_SUB_BUS_EXCEPTION_CNT:
+        ulValue = ulMBGetDiagCounter( MB_DIAG_EXCEPTIONS );
+        break;
+
+    case MB_DIAG_SUB_SERVER_MESSAGE_CNT:
+        ulValue = ulMBGetDiagCounter( MB_DIAG_SERVER_MESSAGES );
+        break;
+
+    case MB_DIAG_SUB_SERVER_NO_RESPONSE_CNT:
+        ulValue = ulMBGetDiagCounter( MB_DIAG_NO_RESPONSE );
+        break;
+
+    case MB_DIAG_SUB_BUS_OVERRUN_CNT:
+        ulValue = ulMBGetDiagCounter( MB_DIAG_FIFO_OVERFLOWS ) + ulMBGetDiagCounter( MB_DIAG_BUFFER_FULL );
+        break;
+
+    case MB_DIAG_SUB_NOT_ADDRESSED_CNT:
+        ulValue = ulMBGetDiagCounter( MB_DIAG_NOT_ADDRESSED );
+        break;
+
+    case MB_DIAG_SUB_BROADCAST_CNT:
+        ulValue = ulMBGetDiagCounter( MB_DIAG_BROADCASTS );
+        break;
+
+    case MB_DIAG_SUB_PARITY_ERROR_CNT:
+        ulValue = ulMBGetDiagCounter( MB_DIAG_PARITY_ERRORS );
+        break;
+
+    case MB_DIAG_SUB_FRAME_ERROR_CNT:
+        ulValue = ulMBGetDiagCounter( MB_DIAG_FRAME_ERRORS );
+        break;
+
+    case MB_DIAG_SUB_FIFO_OVERFLOW_CNT:
+        ulValue = ulMBGetDiagCounter( MB_DIAG_FIFO_OVERFLOWS );
+        break;
+
+    case MB_DIAG_SUB_BUFFER_FULL_CNT:
+        ulValue = ulMBGetDiagCounter( MB_DIAG_BUFFER_FULL );
+        break;
+
+    default:
+        return MB_EX_ILLEGAL_FUNCTION;
+    }
+
+    /* The counters are 16 bit wide on the wire and wrap around. The sub-function
+     * code and the length of the request are kept for the response. */
+    pucFrame[MB_PDU_FUNC_DIAG_DATA_OFF] = ( UCHAR )( ( ulValue >> 8 ) & 0xFF );
+    pucFrame[MB_PDU_FUNC_DIAG_DATA_OFF + 1] = ( UCHAR )( ulValue & 0xFF );
+    return MB_EX_NONE;
+}
+
+#endif
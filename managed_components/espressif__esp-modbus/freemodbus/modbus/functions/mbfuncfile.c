@@ -0,0 +1,203 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include "stdlib.h"
+#include "string.h"
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbframe.h"
+#include "mbproto.h"
+#include "mbconfig.h"
+
+#if MB_FUNC_FILE_RECORD_ENABLED > 0
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_PDU_FUNC_FILE_BYTECNT_OFF            ( MB_PDU_DATA_OFF + 0 )
+#define MB_PDU_FUNC_FILE_REQ_OFF                ( MB_PDU_DATA_OFF + 1 )
+#define MB_PDU_FUNC_FILE_SIZE_MIN               ( 1 )
+
+/* Sub-request: reference type, file number, record number and record length */
+#define MB_FILE_SUBREQ_TYPE_OFF                 ( 0 )
+#define MB_FILE_SUBREQ_FILE_OFF                 ( 1 )
+#define MB_FILE_SUBREQ_RECORD_OFF               ( 3 )
+#define MB_FILE_SUBREQ_LEN_OFF                  ( 5 )
+#define MB_FILE_SUBREQ_SIZE                     ( 7 )
+
+#define MB_FILE_REF_TYPE                        ( 6 )
+#define MB_FILE_RECORD_MAX                      ( 0x270F )
+#define MB_FILE_READ_BYTECNT_MIN                ( 0x07 )
+#define MB_FILE_READ_BYTECNT_MAX                ( 0xF5 )
+#define MB_FILE_WRITE_BYTECNT_MIN               ( 0x09 )
+#define MB_FILE_WRITE_BYTECNT_MAX               ( 0xFB )
+#define MB_FILE_READ_SUBREQ_MAX                 ( MB_FILE_READ_BYTECNT_MAX / MB_FILE_SUBREQ_SIZE )
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct
+{
+    USHORT          usFile;
+    USHORT          usRecord;
+    USHORT          usNRecords;
+} xMBFileSubRequest;
+
+/* ----------------------- Static functions ---------------------------------*/
+eMBException    prveMBError2Exception( eMBErrorCode eErrorCode );
+
+static          USHORT
+prvusMBFileGetU16( const UCHAR * pucBuf )
+{
+    return ( USHORT )( ( pucBuf[0] << 8 ) | pucBuf[1] );
+}
+
+/* Decode and check the sub-request header, the records have to be in the
+ * range of the record numbers of the specification. */
+static          eMBException
+prveMBFileGetSubRequest( const UCHAR * pucSubReq, xMBFileSubRequest * pxSubReq )
+{
+    pxSubReq->usFile = prvusMBFileGetU16( &pucSubReq[MB_FILE_SUBREQ_FILE_OFF] );
+    pxSubReq->usRecord = prvusMBFileGetU16( &pucSubReq[MB_FILE_SUBREQ_RECORD_OFF] );
+    pxSubReq->usNRecords = prvusMBFileGetU16( &pucSubReq[MB_FILE_SUBREQ_LEN_OFF] );
+
+    if( pxSubReq->usNRecords == 0 )
+    {
+        return MB_EX_ILLEGAL_DATA_VALUE;
+    }
+    if( ( pucSubReq[MB_FILE_SUBREQ_TYPE_OFF] != MB_FILE_REF_TYPE ) || ( pxSubReq->usFile == 0 )
+        || ( ( ULONG )pxSubReq->usRecord + pxSubReq->usNRecords - 1 > MB_FILE_RECORD_MAX ) )
+    {
+        return MB_EX_ILLEGAL_DATA_ADDRESS;
+    }
+    return MB_EX_NONE;
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+eMBException
+eMBFuncReadFileRecord( UCHAR * pucFrame, USHORT * usLen )
+{
+    xMBFileSubRequest xSubReqs[MB_FILE_READ_SUBREQ_MAX];
+    USHORT          usSubReqs;
+    USHORT          usRespLen;
+    UCHAR           ucByteCount;
+    UCHAR          *pucFrameCur;
+    eMBException    eStatus;
+    eMBErrorCode    eRegStatus;
+
+    if( *usLen < ( MB_PDU_FUNC_FILE_SIZE_MIN + MB_PDU_SIZE_MIN ) )
+    {
+        return MB_EX_ILLEGAL_DATA_VALUE;
+    }
+    ucByteCount = pucFrame[MB_PDU_FUNC_FILE_BYTECNT_OFF];
+    if( ( ucByteCount < MB_FILE_READ_BYTECNT_MIN ) || ( ucByteCount > MB_FILE_READ_BYTECNT_MAX )
+        || ( ( ucByteCount % MB_FILE_SUBREQ_SIZE ) != 0 )
+        || ( *usLen != ( MB_PDU_FUNC_FILE_SIZE_MIN + MB_PDU_SIZE_MIN + ucByteCount ) ) )
+    {
+        return MB_EX_ILLEGAL_DATA_VALUE;
+    }
+
+    /* The responses take the place of the sub-requests, all of them are
+     * decoded and the response length is checked before the first read. */
+    usSubReqs = ucByteCount / MB_FILE_SUBREQ_SIZE;
+    usRespLen = 0;
+    for( USHORT i = 0; i < usSubReqs; i++ )
+    {
+        eStatus = prveMBFileGetSubRequest( &pucFrame[MB_PDU_FUNC_FILE_REQ_OFF + i * MB_FILE_SUBREQ_SIZE],
+                                           &xSubReqs[i] );
+        if( eStatus != MB_EX_NONE )
+        {
+            return eStatus;
+        }
+        /* Record length byte, reference type and the records */
+        usRespLen += 2 + xSubReqs[i].usNRecords * 2;
+        if( usRespLen > MB_FILE_READ_BYTECNT_MAX )
+        {
+            return MB_EX_ILLEGAL_DATA_VALUE;
+        }
+    }
+
+    pucFrameCur = &pucFrame[MB_PDU_FUNC_FILE_REQ_OFF];
+    for( USHORT i = 0; i < usSubReqs; i++ )
+    {
+        *pucFrameCur++ = ( UCHAR )( 1 + xSubReqs[i].usNRecords * 2 );
+        *pucFrameCur++ = MB_FILE_REF_TYPE;
+        eRegStatus = eMBRegFileCB( pucFrameCur, xSubReqs[i].usFile, xSubReqs[i].usRecord,
+                                   xSubReqs[i].usNRecords, MB_REG_READ );
+        if( eRegStatus != MB_ENOERR )
+        {
+            return prveMBError2Exception( eRegStatus );
+        }
+        pucFrameCur += xSubReqs[i].usNRecords * 2;
+    }
+    pucFrame[MB_PDU_FUNC_FILE_BYTECNT_OFF] = ( UCHAR )usRespLen;
+    *usLen = MB_PDU_FUNC_FILE_REQ_OFF + usRespLen;
+    return MB_EX_NONE;
+}
+
+eMBException
+eMBFuncWriteFileRecord( UCHAR * pucFrame, USHORT * usLen )
+{
+    xMBFileSubRequest xSubReq;
+    USHORT          usEnd;
+    USHORT          usOff;
+    UCHAR           ucByteCount;
+    eMBException    eStatus;
+    eMBErrorCode    eRegStatus;
+
+    if( *usLen < ( MB_PDU_FUNC_FILE_SIZE_MIN + MB_PDU_SIZE_MIN ) )
+    {
+        return MB_EX_ILLEGAL_DATA_VALUE;
+    }
+    ucByteCount = pucFrame[MB_PDU_FUNC_FILE_BYTECNT_OFF];
+    if( ( ucByteCount < MB_FILE_WRITE_BYTECNT_MIN ) || ( ucByteCount > MB_FILE_WRITE_BYTECNT_MAX )
+        || ( *usLen != ( MB_PDU_FUNC_FILE_SIZE_MIN + MB_PDU_SIZE_MIN + ucByteCount ) ) )
+    {
+        return MB_EX_ILLEGAL_DATA_VALUE;
+    }
+
+    /* The complete request is checked first, the frame and the records of
+     * the files, so a malformed sub-request does not leave the files
+     * written partially. */
+    usEnd = MB_PDU_FUNC_FILE_REQ_OFF + ucByteCount;
+    for( usOff = MB_PDU_FUNC_FILE_REQ_OFF; usOff < usEnd; usOff += MB_FILE_SUBREQ_SIZE + xSubReq.usNRecords * 2 )
+    {
+        if( ( usEnd - usOff ) < MB_FILE_SUBREQ_SIZE )
+        {
+            return MB_EX_ILLEGAL_DATA_VALUE;
+        }
+        eStatus = prveMBFileGetSubRequest( &pucFrame[usOff], &xSubReq );
+        if( eStatus != MB_EX_NONE )
+        {
+            return eStatus;
+        }
+        if( ( usOff + MB_FILE_SUBREQ_SIZE + xSubReq.usNRecords * 2 ) > usEnd )
+        {
+            return MB_EX_ILLEGAL_DATA_VALUE;
+        }
+        eRegStatus = eMBRegFileCB( NULL, xSubReq.usFile, xSubReq.usRecord, xSubReq.usNRecords, MB_REG_WRITE );
+        if( eRegStatus != MB_ENOERR )
+        {
+            return prveMBError2Exception( eRegStatus );
+        }
+    }
+
+    for( usOff = MB_PDU_FUNC_FILE_REQ_OFF; usOff < usEnd; usOff += MB_FILE_SUBREQ_SIZE + xSubReq.usNRecords * 2 )
+    {
+        ( void )prveMBFileGetSubRequest( &pucFrame[usOff], &xSubReq );
+        eRegStatus = eMBRegFileCB( &pucFrame[usOff + MB_FILE_SUBREQ_SIZE], xSubReq.usFile, xSubReq.usRecord,
+                                   xSubReq.usNRecords, MB_REG_WRITE );
+        if( eRegStatus != MB_ENOERR )
+        {
+            return prveMBError2Exception( eRegStatus );
+        }
+    }
+    /* The response is the echo of the request. */
+    return MB_EX_NONE;
+}
+
+#endif
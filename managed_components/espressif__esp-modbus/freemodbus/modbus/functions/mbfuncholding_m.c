@@ -182,6 +182,7 @@ eMBMasterReqWriteMultipleHoldingRegister( UCHAR ucSndAddr,
     eMBMasterReqErrCode    eErrStatus = MB_MRE_NO_ERR;
 
     if ( ucSndAddr > MB_MASTER_TOTAL_SLAVE_NUM ) eErrStatus = MB_MRE_ILL_ARG;
+    else if ( ( usNRegs == 0 ) || ( usNRegs > MB_PDU_REQ_WRITE_MUL_REGCNT_MAX ) ) eErrStatus = MB_MRE_ILL_ARG;
     else if ( xMBMasterRunResTake( lTimeOut ) == FALSE ) eErrStatus = MB_MRE_MASTER_BUSY;
     else
     {
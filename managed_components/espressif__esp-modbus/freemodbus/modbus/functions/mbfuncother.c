@@ -44,10 +44,12 @@
 
 /* ----------------------- Modbus includes ----------------------------------*/
 #include "mb.h"
-#include "mb_m.h"
 #include "mbframe.h"
 #include "mbproto.h"
 #include "mbconfig.h"
+#if MB_MASTER_RTU_ENABLED || MB_MASTER_ASCII_ENABLED || MB_MASTER_TCP_ENABLED
+#include "mb_m.h"
+#endif
 
 #if MB_SLAVE_RTU_ENABLED || MB_SLAVE_ASCII_ENABLED || MB_TCP_ENABLED
 
@@ -63,6 +65,7 @@ static USHORT   usMBSlaveIDLen;
 /* ----------------------- Start implementation -----------------------------*/
 eMBException    prveMBError2Exception( eMBErrorCode eErrorCode );
 
+#if MB_MASTER_RTU_ENABLED || MB_MASTER_ASCII_ENABLED || MB_MASTER_TCP_ENABLED
 eMBMasterReqErrCode
 eMBMasterReqReportSlaveID( UCHAR ucSndAddr, LONG lTimeOut )
 {
@@ -108,6 +111,7 @@ eMBMasterFuncReportSlaveID( UCHAR * pucFrame, USHORT * usLen )
     }
     return eStatus;
 }
+#endif
 
 eMBErrorCode
 eMBSetSlaveID( UCHAR ucSlaveID, BOOL xIsRunning,
@@ -120,6 +120,189 @@ xMBUtilGetBits( UCHAR * ucByteBuf, USHORT usBitOffset, UCHAR ucNBits )
     return ( UCHAR ) usWordBuf;
 }
 
+/* Get up to 8 bits, only the bytes which hold the bits are read. */
+static inline UCHAR
+prvucMBUtilGetBitsExact( const UCHAR * pucByteBuf, ULONG ulBitOffset, UCHAR ucNBits )
+{
+    const UCHAR    *pucByte = &pucByteBuf[ulBitOffset / BITS_UCHAR];
+    UCHAR           ucShift = ( UCHAR )( ulBitOffset % BITS_UCHAR );
+    USHORT          usValue = ( USHORT )( pucByte[0] >> ucShift );
+
+    if( ( ucShift + ucNBits ) > BITS_UCHAR )
+    {
+        usValue |= ( USHORT )( pucByte[1] << ( BITS_UCHAR - ucShift ) );
+    }
+    return ( UCHAR )( usValue & ( ( 1U << ucNBits ) - 1 ) );
+}
+
+void
+vMBUtilCopyBits( UCHAR * pucDst, USHORT usDstOffset, const UCHAR * pucSrc,
+                 USHORT usSrcOffset, USHORT usNBits )
+{
+    ULONG           ulSrcOffset = usSrcOffset;
+    UCHAR          *pucOut = &pucDst[usDstOffset / BITS_UCHAR];
+    UCHAR           ucShift = ( UCHAR )( usDstOffset % BITS_UCHAR );
+    UCHAR           ucNBits;
+    UCHAR           ucMask;
+
+    /* Leading bits up to the byte boundary of the destination. */
+    if( ( ucShift != 0 ) && ( usNBits > 0 ) )
+    {
+        ucNBits = ( UCHAR )( BITS_UCHAR - ucShift );
+        ucNBits = ( usNBits < ucNBits ) ? ( UCHAR )usNBits : ucNBits;
+        ucMask = ( UCHAR )( ( ( 1U << ucNBits ) - 1 ) << ucShift );
+        *pucOut = ( UCHAR )( ( *pucOut & ~ucMask )
+                             | ( prvucMBUtilGetBitsExact( pucSrc, ulSrcOffset, ucNBits ) << ucShift ) );
+        pucOut++;
+        ulSrcOffset += ucNBits;
+        usNBits -= ucNBits;
+    }
+
+    /* The destination is byte aligned now. */
+    ucShift = ( UCHAR )( ulSrcOffset % BITS_UCHAR );
+    if( ucShift == 0 )
+    {
+        USHORT          usNBytes = usNBits / BITS_UCHAR;
+
+        memcpy( pucOut, &pucSrc[ulSrcOffset / BITS_UCHAR], usNBytes );
+        pucOut += usNBytes;
+        ulSrcOffset += ( ULONG )usNBytes * BITS_UCHAR;
+        usNBits -= usNBytes * BITS_UCHAR;
+    }
+    else
+    {
+        /* Funnel shift of the source, 32 bits per step (little endian host). The five source
+         * bytes hold exactly the 32 bits, so the bytes behind the field are never read. */
+        for( ; usNBits >= 32; usNBits -= 32, ulSrcOffset += 32, pucOut += 4 )
+        {
+            const UCHAR    *pucIn = &pucSrc[ulSrcOffset / BITS_UCHAR];
+            uint32_t        ulWord;
+
+            memcpy( &ulWord, pucIn, sizeof( ulWord ) );
+            ulWord = ( ulWord >> ucShift ) | ( ( uint32_t )pucIn[4] << ( 32 - ucShift ) );
+            memcpy( pucOut, &ulWord, sizeof( ulWord ) );
+        }
+        for( ; usNBits >= BITS_UCHAR; usNBits -= BITS_UCHAR, ulSrcOffset += BITS_UCHAR )
+        {
+            *pucOut++ = prvucMBUtilGetBitsExact( pucSrc, ulSrcOffset, BITS_UCHAR );
+        }
+    }
+
+    /* Trailing bits, the bits of the last destination byte behind the field are kept. */
+    if( usNBits > 0 )
+    {
+        ucMask = ( UCHAR )( ( 1U << usNBits ) - 1 );
+        *pucOut = ( UCHAR )( ( *pucOut & ~ucMask )
+                             | prvucMBUtilGetBitsExact( pucSrc, ulSrcOffset, ( UCHAR )usNBits ) );
+    }
+}
+
+#if CONFIG_FMB_BITCOPY_BENCHMARK
+
+#include "esp_log.h"
+#include "esp_idf_version.h"
+#if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0))
+#include "esp_cpu.h"
+#define MB_BITS_CYCLE_COUNT()   esp_cpu_get_cycle_count()
+#else
+#include "hal/cpu_hal.h"
+#define MB_BITS_CYCLE_COUNT()   cpu_hal_get_cycle_count()
+#endif
+
+#define MB_BITS_BENCH_ROUNDS    ( 16 )
+#define MB_BITS_BENCH_AREA_SIZE ( 256 )
+#define MB_BITS_BENCH_AREA_OFF  ( 3 )       /* Unaligned start of the requested bits in the area */
+#define MB_BITS_BENCH_READ_MAX  ( 0x07D0 )  /* Maximum quantity of FC01 and FC02 */
+#define MB_BITS_BENCH_WRITE_MAX ( 0x07B0 )  /* Maximum quantity of FC15 */
+
+static const char *TAG = "MB_BITS";
+
+/* Copy of the bits as done by the register callbacks before, 8 bits per step. */
+static void
+prvvMBUtilCopyBitsClassic( UCHAR * pucDst, USHORT usDstOffset, UCHAR * pucSrc,
+                           USHORT usSrcOffset, USHORT usNBits )
+{
+    while( usNBits > 0 )
+    {
+        UCHAR           ucNBits = ( usNBits > BITS_UCHAR ) ? BITS_UCHAR : ( UCHAR )usNBits;
+
+        xMBUtilSetBits( pucDst, usDstOffset, ucNBits, xMBUtilGetBits( pucSrc, usSrcOffset, ucNBits ) );
+        usDstOffset += ucNBits;
+        usSrcOffset += ucNBits;
+        usNBits -= ucNBits;
+    }
+}
+
+/* Measure one transfer direction at the maximum quantity, returns cycles of both engines. */
+static BOOL
+prvxMBUtilBenchCopy( BOOL xToFrame, USHORT usNBits, ULONG * pulCycles )
+{
+    static UCHAR    ucArea[2][MB_BITS_BENCH_AREA_SIZE];
+    static UCHAR    ucFrame[2][MB_BITS_BENCH_AREA_SIZE];
+    ULONG           ulStart;
+
+    pulCycles[0] = 0;
+    pulCycles[1] = 0;
+    for( USHORT i = 0; i < MB_BITS_BENCH_AREA_SIZE; i++ )
+    {
+        ucArea[0][i] = ucArea[1][i] = ( UCHAR )( i * 37 + 11 );
+        ucFrame[0][i] = ucFrame[1][i] = ( UCHAR )( i * 13 + 5 );
+    }
+    for( int i = 0; i < MB_BITS_BENCH_ROUNDS; i++ )
+    {
+        ulStart = MB_BITS_CYCLE_COUNT(  );
+        if( xToFrame )
+        {
+            prvvMBUtilCopyBitsClassic( ucFrame[0], 0, ucArea[0], MB_BITS_BENCH_AREA_OFF, usNBits );
+        }
+        else
+        {
+            prvvMBUtilCopyBitsClassic( ucArea[0], MB_BITS_BENCH_AREA_OFF, ucFrame[0], 0, usNBits );
+        }
+        pulCycles[0] += MB_BITS_CYCLE_COUNT(  ) - ulStart;
+        ulStart = MB_BITS_CYCLE_COUNT(  );
+        if( xToFrame )
+        {
+            vMBUtilCopyBits( ucFrame[1], 0, ucArea[1], MB_BITS_BENCH_AREA_OFF, usNBits );
+        }
+        else
+        {
+            vMBUtilCopyBits( ucArea[1], MB_BITS_BENCH_AREA_OFF, ucFrame[1], 0, usNBits );
+        }
+        pulCycles[1] += MB_BITS_CYCLE_COUNT(  ) - ulStart;
+    }
+    pulCycles[0] /= MB_BITS_BENCH_ROUNDS;
+    pulCycles[1] /= MB_BITS_BENCH_ROUNDS;
+    return ( memcmp( ucArea[0], ucArea[1], sizeof( ucArea[0] ) ) == 0 )
+        && ( memcmp( ucFrame[0], ucFrame[1], sizeof( ucFrame[0] ) ) == 0 );
+}
+
+void
+vMBUtilCopyBitsBenchmark( void )
+{
+    static const struct
+    {
+        const char     *pcName;
+        BOOL            xToFrame;
+        USHORT          usNBits;
+    } xCases[] = {
+        { "FC01/FC02 2000 bits", TRUE, MB_BITS_BENCH_READ_MAX },
+        { "FC15 1968 bits", FALSE, MB_BITS_BENCH_WRITE_MAX },
+    };
+    ULONG           ulCycles[2];
+
+    for( size_t i = 0; i < sizeof( xCases ) / sizeof( xCases[0] ); i++ )
+    {
+        BOOL            xMatch = prvxMBUtilBenchCopy( xCases[i].xToFrame, xCases[i].usNBits, ulCycles );
+
+        ESP_LOGI( TAG, "%s: 8 bits per call: %" PRIu32 " cycles, funnel shift: %" PRIu32 " cycles, %s.",
+                  xCases[i].pcName, ( uint32_t )ulCycles[0], ( uint32_t )ulCycles[1],
+                  xMatch ? "match" : "MISMATCH" );
+    }
+}
+
+#endif
+
 eMBException
 prveMBError2Exception( eMBErrorCode eErrorCode )
 {
@@ -139,6 +322,10 @@ prveMBError2Exception( eMBErrorCode eErrorCode )
             eStatus = MB_EX_SLAVE_BUSY;
             break;
 
+        case MB_EILLVALUE:
+            eStatus = MB_EX_ILLEGAL_DATA_VALUE;
+            break;
+
         default:
             eStatus = MB_EX_SLAVE_DEVICE_FAILURE;
             break;
@@ -126,7 +126,8 @@ typedef enum
     MB_ENORES,                  /*!< insufficient resources. */
     MB_EIO,                     /*!< I/O error. */
     MB_EILLSTATE,               /*!< protocol stack in illegal state. */
-    MB_ETIMEDOUT                /*!< timeout error occurred. */
+    MB_ETIMEDOUT,               /*!< timeout error occurred. */
+    MB_EILLVALUE                /*!< illegal register value. */
 } eMBErrorCode;
 
 /* ----------------------- Function prototypes ------------------------------*/
@@ -265,14 +266,190 @@ eMBErrorCode    eMBSetSlaveID( UCHAR ucSlaveID, BOOL xIsRunning,
  *   such a frame is received. If \c NULL a previously registered function handler
  *   for this function code is removed.
  *
- * \return eMBErrorCode::MB_ENOERR if the handler has been installed. If no
- *   more resources are available it returns eMBErrorCode::MB_ENORES. In this
- *   case the values in mbconfig.h should be adjusted. If the argument was not
- *   valid it returns eMBErrorCode::MB_EINVAL.
+ * The handlers are kept in a table indexed by the function code, so any
+ * function code in the range can be registered and a registered handler
+ * replaces the previous handler of this function code.
+ *
+ * \return eMBErrorCode::MB_ENOERR if the handler has been installed. If the
+ *   argument was not valid it returns eMBErrorCode::MB_EINVAL.
  */
 eMBErrorCode    eMBRegisterCB( UCHAR ucFunctionCode,
                                pxMBFunctionHandler pxHandler );
 
+/*! \ingroup modbus
+ * \brief Change the slave address and the serial settings of the running stack.
+ *
+ * The change is applied by the stack task in eMBPoll( ) when no request is in
+ * progress, so the stack does not need to be disabled and initialized again.
+ * The characters which are being received at the moment of the change are
+ * dropped.
+ *
+ * \param ucSlaveAddress The new slave address.
+ * \param ulBaudRate The new baud rate or 0 to keep the serial settings.
+ * \param eParity The new parity, ignored if ulBaudRate is 0.
+ *
+ * \return eMBErrorCode::MB_ENOERR if the change is scheduled,
+ *   eMBErrorCode::MB_EILLSTATE if the stack is not enabled or
+ *   eMBErrorCode::MB_EINVAL if the argument is not valid or the serial
+ *   settings of the transport can not be changed (ASCII, TCP).
+ */
+eMBErrorCode    eMBSetConfig( UCHAR ucSlaveAddress, ULONG ulBaudRate, eMBParity eParity );
+
+/*! \ingroup modbus
+ * \brief Serve the additional (virtual) slave address on the same port.
+ *
+ * The requests to the virtual slave address are executed as the requests to
+ * the slave address and the response is sent with the virtual address. The
+ * register callbacks get the address of the request with ucMBGetRequestAddress( ).
+ *
+ * \param ucAddress The slave address in the range 1 to 247.
+ * \param xEnable TRUE to serve the address, FALSE to stop serving it.
+ *
+ * \return eMBErrorCode::MB_ENOERR on success, eMBErrorCode::MB_ENORES if
+ *   all MB_SLAVE_ADDR_MAX entries are used or eMBErrorCode::MB_EINVAL if the
+ *   address is incorrect.
+ */
+eMBErrorCode    eMBSetSlaveAddress( UCHAR ucAddress, BOOL xEnable );
+
+/*! \ingroup modbus
+ * \brief Switch the early address filter of the RTU receiver (MB_SERIAL_ADDR_FILTER_ENABLED).
+ *
+ * \param xEnable TRUE to drop the frames for other slaves by the address byte.
+ */
+void            vMBSetAddressFilter( BOOL xEnable );
+
+/*! \ingroup modbus
+ * \brief Check the address byte of the received frame against the early address filter.
+ *
+ * Called by the receiver for the first byte of the frame. The slave address,
+ * the virtual slave addresses and the broadcast address are passed.
+ *
+ * \return TRUE if the frame has to be dropped.
+ */
+BOOL            xMBIsAddressFiltered( UCHAR ucAddress );
+
+/*! \ingroup modbus
+ * \brief Drop the response frames stored by the cache of repeated reads
+ *   (MB_SLAVE_RESP_CACHE_ENABLED).
+ *
+ * Has to be called when the register map changes in a way the version
+ * returned by ulMBRegVersionCB( ) does not show, for example a new area or
+ * a changed lock of the area. Can be called from any task.
+ */
+void            vMBRespCacheFlush( void );
+
+/*! \ingroup modbus
+ * \brief Execute the request PDU in the caller task and build the response in place.
+ *
+ * Used by the TCP port task of the dual transport mode. The request is executed
+ * by the registered function handlers, concurrently with the requests of the
+ * stack task, and is not accounted in the function code counters of the stack.
+ *
+ * \param pucMBFrame The PDU, starting with the function code. The buffer must
+ *   hold the maximum PDU size.
+ * \param pusLength The length of the request, replaced by the response length.
+ *
+ * \return The exception code, the exception response is already built if it
+ *   is not eMBException::MB_EX_NONE.
+ */
+eMBException    eMBExecutePDU( UCHAR * pucMBFrame, USHORT * pusLength );
+
+/*! \ingroup modbus
+ * \brief Execute the request PDU of an additional RTU port in the caller task.
+ *
+ * Same as eMBExecutePDU( ), the request is executed against the register areas
+ * of the virtual slave address if it is served, of the slave address otherwise.
+ *
+ * \param ucAddress The slave address of the port.
+ * \param pucMBFrame The PDU, starting with the function code. The buffer must
+ *   hold the maximum PDU size.
+ * \param pusLength The length of the request, replaced by the response length.
+ *
+ * \return The exception code, the exception response is already built if it
+ *   is not eMBException::MB_EX_NONE.
+ */
+eMBException    eMBExecuteAddrPDU( UCHAR ucAddress, UCHAR * pucMBFrame, USHORT * pusLength );
+
+/*! \ingroup modbus
+ * \brief Get the virtual slave address of the request in progress.
+ *
+ * \return The virtual slave address or 0 if the request is for the slave
+ *   address given to eMBInit( ), the broadcast or the TCP pseudo address.
+ */
+UCHAR           ucMBGetRequestAddress( void );
+
+/*! \ingroup modbus
+ * \brief Get the request counters of the slave address.
+ *
+ * \param ucAddress The virtual slave address or 0 for the slave address.
+ * \param pulRequests Number of the executed requests.
+ * \param pulExceptions Number of the exception responses.
+ * \return TRUE if the address is served.
+ */
+BOOL            xMBGetSlaveStats( UCHAR ucAddress, ULONG * pulRequests, ULONG * pulExceptions );
+
+/*! \ingroup modbus
+ * \brief Get the number of requests received with the function code.
+ *
+ * The requests with function codes above 127 are accounted for function code 0.
+ *
+ * \param ucFunctionCode The Modbus function code in the range 0 to 127.
+ * \return The number of requests since start or the last vMBResetFuncHits( ).
+ */
+ULONG           ulMBGetFuncHits( UCHAR ucFunctionCode );
+
+/*! \ingroup modbus
+ * \brief Clear the per function code request counters.
+ */
+void            vMBResetFuncHits( void );
+
+/*! \ingroup modbus
+ * \brief Diagnostic counters of the serial line.
+ *
+ * The counters are returned by the <em>Diagnostics</em> function code and
+ * ulMBGetDiagCounter( ). Each counter has a single writer, either the
+ * Modbus task or the UART event task of the port.
+ */
+typedef enum
+{
+    MB_DIAG_BUS_MESSAGES = 0,           /*!< Frames received on the line, including bad ones. */
+    MB_DIAG_BUS_COMM_ERRORS,            /*!< Frames dropped for the length or CRC check. */
+    MB_DIAG_EXCEPTIONS,                 /*!< Exception responses sent. */
+    MB_DIAG_SERVER_MESSAGES,            /*!< Frames addressed to the slave, including broadcasts. */
+    MB_DIAG_NO_RESPONSE,                /*!< Executed requests without a response. */
+    MB_DIAG_NOT_ADDRESSED,              /*!< Valid frames for other slaves. */
+    MB_DIAG_BROADCASTS,                 /*!< Broadcast frames received. */
+    MB_DIAG_FIFO_OVERFLOWS,             /*!< UART hardware FIFO overflows. */
+    MB_DIAG_BUFFER_FULL,                /*!< UART driver ring buffer overflows. */
+    MB_DIAG_PARITY_ERRORS,              /*!< Characters with parity error. */
+    MB_DIAG_FRAME_ERRORS,               /*!< Characters with framing (stop bit) error. */
+    MB_DIAG_FILTERED,                   /*!< Frames for other slaves dropped by the address filter. */
+    MB_DIAG_CACHED,                     /*!< Read requests answered with the stored response frame. */
+    MB_DIAG_COUNTER_COUNT
+} eMBDiagCounter;
+
+/*! \ingroup modbus
+ * \brief Increment the diagnostic counter.
+ */
+void            vMBDiagCount( eMBDiagCounter eCounter );
+
+/*! \ingroup modbus
+ * \brief Get the diagnostic counter.
+ *
+ * \return The counter value since start or the last vMBResetDiagCounters( ).
+ */
+ULONG           ulMBGetDiagCounter( eMBDiagCounter eCounter );
+
+/*! \ingroup modbus
+ * \brief Clear the diagnostic counter.
+ */
+void            vMBResetDiagCounter( eMBDiagCounter eCounter );
+
+/*! \ingroup modbus
+ * \brief Clear the diagnostic counters.
+ */
+void            vMBResetDiagCounters( void );
+
 /* ----------------------- Callback -----------------------------------------*/
 
 /*! \defgroup modbus_registers Modbus Registers
@@ -355,6 +532,34 @@ eMBErrorCode    eMBRegInputCB( UCHAR * pucRegBuffer, USHORT usAddress,
 eMBErrorCode    eMBRegHoldingCB( UCHAR * pucRegBuffer, USHORT usAddress,
                                  USHORT usNRegs, eMBRegisterMode eMode );
 
+/*! \ingroup modbus_registers
+ * \brief Callback function used by the cache of repeated reads
+ *   (MB_SLAVE_RESP_CACHE_ENABLED) to get the version of the registers
+ *   read by the request.
+ *
+ * \param ucFunctionCode MB_FUNC_READ_HOLDING_REGISTER or
+ *   MB_FUNC_READ_INPUT_REGISTER.
+ * \param usAddress The starting address of the register as given to
+ *   eMBRegHoldingCB( ) and eMBRegInputCB( ).
+ * \param usNRegs Number of registers to read.
+ *
+ * \return A value which changes with each update of the registers, the
+ *   response is sent from the cache while it is the same. Zero if the
+ *   response must not be cached, for example if the values are produced
+ *   on read or their updates are not versioned.
+ */
+ULONG           ulMBRegVersionCB( UCHAR ucFunctionCode, USHORT usAddress,
+                                  USHORT usNRegs );
+
+/*! \ingroup modbus_registers
+ * \brief Callback function called instead of eMBRegHoldingCB( ) or
+ *   eMBRegInputCB( ) if the response is sent from the cache of repeated
+ *   reads (MB_SLAVE_RESP_CACHE_ENABLED), so the application still sees
+ *   the access. The arguments are as for ulMBRegVersionCB( ).
+ */
+void            vMBRegCachedReadCB( UCHAR ucFunctionCode, USHORT usAddress,
+                                    USHORT usNRegs );
+
 /*! \ingroup modbus_registers
  * \brief Callback function used if a <em>Coil Register</em> value is
  *   read or written by the protocol stack. If you are going to use
@@ -419,6 +624,34 @@ eMBErrorCode    eMBRegCoilsCB( UCHAR * pucRegBuffer, USHORT usAddress,
 eMBErrorCode    eMBRegDiscreteCB( UCHAR * pucRegBuffer, USHORT usAddress,
                                   USHORT usNDiscrete );
 
+/*! \ingroup modbus_registers
+ * \brief Callback function used if the records of a file are read or
+ *   written by the <em>Read File Record</em> and <em>Write File Record</em>
+ *   functions (MB_FUNC_FILE_RECORD_ENABLED).
+ *
+ * \param pucRecBuffer The records of 16 bits in Modbus byte order (big
+ *   endian), filled by the callback for eMBRegisterMode::MB_REG_READ. If
+ *   NULL the records are only checked, the write function checks all the
+ *   sub-requests before the first one is written.
+ * \param usFile The file number (1 - 65535).
+ * \param usRecord The first record number of the file (0 - 9999).
+ * \param usNRecords Number of records.
+ * \param eMode If eMBRegisterMode::MB_REG_WRITE the records of the file
+ *   should be updated from the buffer.
+ *
+ * \return The function must return one of the following error codes:
+ *   - eMBErrorCode::MB_ENOERR If no error occurred.
+ *   - eMBErrorCode::MB_ENOREG If the file or the records do not exist or
+ *       can not be accessed in this mode. In this case a
+ *       <b>ILLEGAL DATA ADDRESS</b> exception frame is sent as a response.
+ *   - eMBErrorCode::MB_ETIMEDOUT If the file is currently not available.
+ *       In this case a <b>SLAVE DEVICE BUSY</b> exception is sent.
+ *   - eMBErrorCode::MB_EIO If an unrecoverable error occurred. In this case
+ *       a <b>SLAVE DEVICE FAILURE</b> exception is sent as a response.
+ */
+eMBErrorCode    eMBRegFileCB( UCHAR * pucRecBuffer, USHORT usFile, USHORT usRecord,
+                              USHORT usNRecords, eMBRegisterMode eMode );
+
 #ifdef __cplusplus
 PR_END_EXTERN_C
 #endif
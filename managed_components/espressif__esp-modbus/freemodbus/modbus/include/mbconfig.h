@@ -91,6 +91,16 @@ PR_BEGIN_EXTERN_C
  */
 #define MB_TCP_UID_ENABLED                      (  CONFIG_FMB_TCP_UID_ENABLED )
 
+/*! \brief If the TCP slave port can carry raw RTU frames instead of MBAP frames
+ * (ip_mode MB_MODE_RTU_OVER_TCP and MB_MODE_RTU_OVER_UDP).
+ */
+#define MB_TCP_RTU_ENCAP_ENABLED                (  CONFIG_FMB_TCP_RTU_ENCAP )
+
+/*! \brief If the TCP master keeps one outstanding transaction per slave connection
+ * for the batch of requests (see mbc_master_send_requests()).
+ */
+#define MB_MASTER_TCP_PIPELINE_ENABLED          (  CONFIG_FMB_TCP_MASTER_PIPELINE )
+
 /*! \brief This option defines the number of data bits per ASCII character.
  *
  * A parity bit is added before the stop bit which keeps the actual byte size at 10 bits.
@@ -133,6 +143,8 @@ PR_BEGIN_EXTERN_C
  * The maximum number of supported Modbus functions must be greater than
  * the sum of all enabled functions in this file and custom function
  * handlers. If set to small adding more functions will fail.
+ * Used by the master only, the slave keeps the handlers in a table indexed
+ * by the function code.
  */
 #define MB_FUNC_HANDLERS_MAX                    ( 16 )
 
@@ -176,9 +188,129 @@ PR_BEGIN_EXTERN_C
 /*! \brief If the <em>Read/Write Multiple Registers</em> function should be enabled. */
 #define MB_FUNC_READWRITE_HOLDING_ENABLED       (  1 )
 
+/*! \brief If the <em>Diagnostics</em> function should be enabled. */
+#define MB_FUNC_DIAG_DIAGNOSTIC_ENABLED         (  CONFIG_FMB_CONTROLLER_DIAG_SUPPORT )
+
+/*! \brief If the <em>Read File Record</em> and <em>Write File Record</em> functions should be enabled. */
+#define MB_FUNC_FILE_RECORD_ENABLED             (  CONFIG_FMB_CONTROLLER_FILE_RECORD_SUPPORT )
+
+/*! \brief If the slave RTU receiver reads the complete frame at once. */
+#define MB_SERIAL_RX_BLOCK_ENABLED              (  CONFIG_FMB_SERIAL_RX_BLOCK_MODE )
+
+/*! \brief If the slave RTU transmitter writes the complete frame at once. */
+#define MB_SERIAL_TX_BLOCK_ENABLED              (  CONFIG_FMB_SERIAL_TX_BLOCK_MODE )
+
+/*! \brief If the serial slave frames are transferred by UART DMA (UHCI). */
+#define MB_SERIAL_DMA_ENABLED                   (  CONFIG_FMB_SERIAL_UHCI_DMA )
+
+/*! \brief Number of the virtual slave addresses served in addition to the slave address. */
+#ifdef CONFIG_FMB_CONTROLLER_SLAVE_ADDR_MAX
+#define MB_SLAVE_ADDR_MAX                       (  CONFIG_FMB_CONTROLLER_SLAVE_ADDR_MAX )
+#else
+#define MB_SLAVE_ADDR_MAX                       (  0 )
+#endif
+
+/*! \brief If the serial slave serves the TCP clients from the TCP port task. */
+#define MB_SLAVE_DUAL_TCP_ENABLED               (  CONFIG_FMB_SLAVE_DUAL_TCP )
+
+/*! \brief If the TCP requests for other unit identifiers are passed to the forward handler. */
+#define MB_SLAVE_TCP_FORWARD_ENABLED            (  CONFIG_FMB_SLAVE_DUAL_TCP_FORWARD )
+
+/*! \brief Number of the worker tasks which execute the read requests of the TCP clients. */
+#ifdef CONFIG_FMB_SLAVE_DUAL_TCP_READ_WORKERS
+#define MB_SLAVE_TCP_READ_WORKERS               (  CONFIG_FMB_SLAVE_DUAL_TCP_READ_WORKERS )
+#else
+#define MB_SLAVE_TCP_READ_WORKERS               (  0 )
+#endif
+
+/*! \brief Number of the additional RTU ports which execute their requests in their own tasks. */
+#ifdef CONFIG_FMB_SLAVE_RTU_PORTS
+#define MB_SLAVE_RTU_PORTS_MAX                  (  CONFIG_FMB_SLAVE_RTU_PORTS )
+#else
+#define MB_SLAVE_RTU_PORTS_MAX                  ( 0 )
+#endif
+
+/*! \brief If more than one port task executes requests (dual TCP or additional RTU ports). */
+#define MB_SLAVE_CONCURRENT_ENABLED             (  CONFIG_FMB_SLAVE_CONCURRENT_EXEC )
+
+/*! \brief If the slave stack events are signaled by task notification instead of queue. */
+#define MB_PORT_EVENT_NOTIFY_ENABLED            (  CONFIG_FMB_PORT_EVENT_NOTIFY )
+
+/*! \brief If the slave turnaround latency statistics should be collected. */
+#define MB_SLAVE_LATENCY_ENABLED                (  CONFIG_FMB_SLAVE_LATENCY_STATS )
+
+/*! \brief If the RTU receiver drops the frames for other slaves by the address byte. */
+#define MB_SERIAL_ADDR_FILTER_ENABLED           (  CONFIG_FMB_SERIAL_ADDR_FILTER )
+
+/*! \brief If the serial slave port takes the power management lock only while the bus is active. */
+#define MB_SERIAL_PM_ENABLED                    (  CONFIG_FMB_SERIAL_PM_LOCK )
+
+/*! \brief If the RTU slave answers the repeated register reads with the stored response frames. */
+#define MB_SLAVE_RESP_CACHE_ENABLED             (  CONFIG_FMB_SLAVE_RESP_CACHE )
+
+/*! \brief Number of the stored response frames. */
+#ifdef CONFIG_FMB_SLAVE_RESP_CACHE_ENTRIES
+#define MB_SLAVE_RESP_CACHE_ENTRIES             (  CONFIG_FMB_SLAVE_RESP_CACHE_ENTRIES )
+#else
+#define MB_SLAVE_RESP_CACHE_ENTRIES             (  0 )
+#endif
+
+/*! \brief If the slave frames should be recorded into the frame trace ring. */
+#define MB_FRAME_TRACE_ENABLED                  (  CONFIG_FMB_FRAME_TRACE )
+
+/*! \brief If the serial slave can analyze the traffic of the other slaves on the bus. */
+#define MB_SLAVE_BUS_ANALYZER_ENABLED           (  CONFIG_FMB_SLAVE_BUS_ANALYZER )
+
+/*! \brief If the slave hot path micro-benchmark is run on slave start. */
+#define MB_SLAVE_BENCHMARK_ENABLED              (  CONFIG_FMB_SLAVE_HOTPATH_BENCHMARK )
+
+/*! \brief If the slave port objects are placed in static buffers instead of the heap. */
+#define MB_STATIC_ALLOCATION_ENABLED            (  CONFIG_FMB_STATIC_ALLOCATION )
+
 /*! \brief Check the option to place timer handler into IRAM */
 #define MB_PORT_TIMER_ISR_IN_IRAM               (  CONFIG_FMB_TIMER_USE_ISR_DISPATCH_METHOD )
 
+#if CONFIG_IDF_TARGET_LINUX
+/*! \brief The host build has the serial slave stack on the simulated port only,
+ * the options of the other stacks and of the target port are overridden. */
+#undef MB_MASTER_ASCII_ENABLED
+#define MB_MASTER_ASCII_ENABLED                 ( 0 )
+#undef MB_MASTER_RTU_ENABLED
+#define MB_MASTER_RTU_ENABLED                   ( 0 )
+#undef MB_MASTER_TCP_ENABLED
+#define MB_MASTER_TCP_ENABLED                   ( 0 )
+#undef MB_TCP_ENABLED
+#define MB_TCP_ENABLED                          ( 0 )
+#undef MB_SLAVE_DUAL_TCP_ENABLED
+#define MB_SLAVE_DUAL_TCP_ENABLED               ( 0 )
+#undef MB_SLAVE_TCP_FORWARD_ENABLED
+#define MB_SLAVE_TCP_FORWARD_ENABLED            ( 0 )
+#undef MB_SLAVE_TCP_READ_WORKERS
+#define MB_SLAVE_TCP_READ_WORKERS               ( 0 )
+#undef MB_FUNC_FILE_RECORD_ENABLED
+#define MB_FUNC_FILE_RECORD_ENABLED             ( 0 )
+#undef MB_SLAVE_RTU_PORTS_MAX
+#define MB_SLAVE_RTU_PORTS_MAX                  ( 0 )
+#undef MB_SLAVE_CONCURRENT_ENABLED
+#define MB_SLAVE_CONCURRENT_ENABLED             ( 0 )
+#undef MB_SLAVE_LATENCY_ENABLED
+#define MB_SLAVE_LATENCY_ENABLED                ( 0 )
+#undef MB_FRAME_TRACE_ENABLED
+#define MB_FRAME_TRACE_ENABLED                  ( 0 )
+#undef MB_SLAVE_BUS_ANALYZER_ENABLED
+#define MB_SLAVE_BUS_ANALYZER_ENABLED           ( 0 )
+#undef MB_SERIAL_PM_ENABLED
+#define MB_SERIAL_PM_ENABLED                    ( 0 )
+#undef MB_SLAVE_BENCHMARK_ENABLED
+#define MB_SLAVE_BENCHMARK_ENABLED              ( 0 )
+#undef MB_STATIC_ALLOCATION_ENABLED
+#define MB_STATIC_ALLOCATION_ENABLED            ( 0 )
+#undef MB_SERIAL_DMA_ENABLED
+#define MB_SERIAL_DMA_ENABLED                   ( 0 )
+#undef MB_PORT_TIMER_ISR_IN_IRAM
+#define MB_PORT_TIMER_ISR_IN_IRAM               ( 0 )
+#endif
+
 /*! @} */
 #ifdef __cplusplus
     PR_END_EXTERN_C
@@ -192,6 +324,9 @@ PR_BEGIN_EXTERN_C
  * And if slave is not respond in this time,the master will process this timeout error.
  * Then master can send other frame */
 #define MB_MASTER_TIMEOUT_MS_RESPOND            ( CONFIG_FMB_MASTER_TIMEOUT_MS_RESPOND )
+/*! \brief If the respond timeout is adapted to the response time of each slave
+ * and the slaves which do not respond are quarantined. */
+#define MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED      ( CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT )
 /*! \brief The total slaves in Modbus Master system.
  * \note : The slave ID must be continuous from 1.*/
 #define MB_MASTER_TOTAL_SLAVE_NUM               ( 247 )
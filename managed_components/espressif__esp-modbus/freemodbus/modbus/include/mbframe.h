@@ -110,6 +110,8 @@ typedef eMBErrorCode( *peMBFrameSend ) ( UCHAR slaveAddress,
 
 typedef void( *pvMBFrameClose ) ( void );
 
+typedef eMBErrorCode( *peMBFrameSetConfig ) ( ULONG ulBaudRate, eMBParity eParity );
+
 #ifdef __cplusplus
 PR_END_EXTERN_C
 #endif
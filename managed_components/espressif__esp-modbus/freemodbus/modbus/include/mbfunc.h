@@ -81,6 +81,15 @@ eMBException    eMBFuncReadDiscreteInputs( UCHAR * pucFrame, USHORT * usLen );
 eMBException    eMBFuncReadWriteMultipleHoldingRegister( UCHAR * pucFrame, USHORT * usLen );
 #endif
 
+#if MB_FUNC_DIAG_DIAGNOSTIC_ENABLED > 0
+eMBException    eMBFuncDiagnostic( UCHAR * pucFrame, USHORT * usLen );
+#endif
+
+#if MB_FUNC_FILE_RECORD_ENABLED > 0
+eMBException    eMBFuncReadFileRecord( UCHAR * pucFrame, USHORT * usLen );
+eMBException    eMBFuncWriteFileRecord( UCHAR * pucFrame, USHORT * usLen );
+#endif
+
 #ifdef __cplusplus
 PR_END_EXTERN_C
 #endif
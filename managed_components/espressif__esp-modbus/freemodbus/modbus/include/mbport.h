@@ -81,7 +81,8 @@ typedef enum {
     EV_MASTER_PROCESS_SUCCESS = 0x0080,         /*!< Request process success. */
     EV_MASTER_ERROR_RESPOND_TIMEOUT = 0x0100,   /*!< Request respond timeout. */
     EV_MASTER_ERROR_RECEIVE_DATA = 0x0200,      /*!< Request receive data error. */
-    EV_MASTER_ERROR_EXECUTE_FUNCTION = 0x0400   /*!< Request execute function error. */
+    EV_MASTER_ERROR_EXECUTE_FUNCTION = 0x0400,  /*!< Request execute function error. */
+    EV_MASTER_PORT_PIPELINE = 0x0800            /*!< Pipelined batch for the port task, not handled by the FSM. */
 } eMBMasterEventEnum;
 
 typedef enum {
@@ -132,6 +133,19 @@ BOOL            xMBMasterPortEventGet(  /*@out@ */ xMBMasterEventType * eEvent )
 eMBMasterEventEnum
                 xMBMasterPortFsmWaitConfirmation( eMBMasterEventEnum eEventMask, ULONG ulTimeout);
 
+void            vMBMasterPortFsmConfirm( eMBMasterEventEnum eEvent );
+
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+/* ----------------------- Slave health tracking (porthealth_m.c) -----------*/
+uint64_t        xMBMasterPortHealthRequestStart( UCHAR ucSlaveAddr );
+
+void            vMBMasterPortHealthResponse( UCHAR ucSlaveAddr, int64_t xRxTimeUs );
+
+void            vMBMasterPortHealthTimeout( UCHAR ucSlaveAddr );
+
+BOOL            xMBMasterPortHealthAllowed( UCHAR ucSlaveAddr );
+#endif
+
 void            vMBMasterOsResInit( void );
 
 BOOL            xMBMasterRunResTake( LONG time );
@@ -156,6 +170,10 @@ BOOL            xMBPortSerialGetByte( CHAR * pucByte );
 
 BOOL            xMBPortSerialPutByte( CHAR ucByte );
 
+USHORT          usMBPortSerialGetBlock( UCHAR * pucBuf, USHORT usLength );
+
+BOOL            xMBPortSerialSetConfig( ULONG ulBaudRate, eMBParity eParity );
+
 BOOL            xMBPortSerialGetRequest( UCHAR **ppucMBSerialFrame, USHORT * pusSerialLength ) __attribute__ ((weak));
 
 BOOL            xMBPortSerialSendResponse( UCHAR *pucMBSerialFrame, USHORT usSerialLength ) __attribute__ ((weak));
@@ -182,9 +200,83 @@ void            vMBMasterRxFlush( void );
 
 #endif
 
+/* ----------------------- Latency statistics functions ---------------------*/
+typedef enum
+{
+    MB_LATENCY_POINT_RX,                /*!< Frame received, T3.5 expired */
+    MB_LATENCY_POINT_EXECUTE,           /*!< Function handler dispatched */
+    MB_LATENCY_POINT_DONE,              /*!< Function handler completed */
+    MB_LATENCY_POINT_COUNT
+} eMBLatencyPoint;
+
+#if MB_SLAVE_LATENCY_ENABLED
+extern volatile int64_t xMBPortLatencyStamps[MB_LATENCY_POINT_COUNT];
+extern volatile UCHAR ucMBPortLatencyFunc;
+
+/* Safe to use from ISR, esp_timer_get_time() is placed into IRAM */
+#define vMBPortLatencyMark( ePoint )        ( xMBPortLatencyStamps[( ePoint )] = esp_timer_get_time( ) )
+#define vMBPortLatencySetFunc( ucFunc )     ( ucMBPortLatencyFunc = ( ucFunc ) )
+
+void            vMBPortLatencyFrameSent( void );
+#else
+#define vMBPortLatencyMark( ePoint )
+#define vMBPortLatencySetFunc( ucFunc )
+#define vMBPortLatencyFrameSent( )
+#endif
+
+/* ----------------------- Frame trace functions ----------------------------*/
+/* The flags are the MB_FRAME_* flags of esp_modbus_slave.h */
+#define MB_TRACE_RX                         ( 0x00 )
+#define MB_TRACE_TX                         ( 0x01 )
+#define MB_TRACE_TCP                        ( 0x02 )
+#define MB_TRACE_ERROR                      ( 0x04 )
+
+#if MB_FRAME_TRACE_ENABLED
+void            vMBPortTraceFrame( UCHAR ucFlags, const UCHAR * pucFrame, USHORT usLength );
+#else
+#define vMBPortTraceFrame( ucFlags, pucFrame, usLength )
+#endif
+
+/* ----------------------- Bus analyzer functions ---------------------------*/
+#if MB_SLAVE_BUS_ANALYZER_ENABLED
+/* The flags are the MB_TRACE_* flags, the RTU frames of the serial slave only */
+void            vMBPortAnalyzerFrame( UCHAR ucFlags, const UCHAR * pucFrame, USHORT usLength );
+
+/* The analyzer runs, the address filter is bypassed */
+BOOL            xMBPortAnalyzerRunning( void );
+
+/* The analyzer runs in the listen-only mode, no request is answered */
+BOOL            xMBPortAnalyzerListenOnly( void );
+
+/* End of the last received frame on the wire estimated at the UART TOUT and the character time */
+int64_t         xMBPortSerialRxFrameEnd( void );
+
+ULONG           ulMBPortSerialCharNs( void );
+#else
+#define vMBPortAnalyzerFrame( ucFlags, pucFrame, usLength )
+#define xMBPortAnalyzerRunning( )           ( FALSE )
+#define xMBPortAnalyzerListenOnly( )        ( FALSE )
+#endif
+
+/* ----------------------- Benchmark functions ------------------------------*/
+#if MB_SLAVE_BENCHMARK_ENABLED
+/* The serial port reads the received bytes from this buffer instead of the UART
+ * until it is reset with a NULL buffer.
+ */
+void            vMBPortSerialSetBenchSource( const UCHAR * pucData, USHORT usLength );
+
+/* Drop the pending events of the stack. */
+void            vMBPortEventFlush( void );
+
+/* Log the cycles of the slave hot path operations, called before the stack is enabled. */
+void            vMBPortBenchmark( void );
+#endif
+
 /* ----------------------- Timers functions ---------------------------------*/
 BOOL            xMBPortTimersInit( USHORT usTimeOut50us );
 
+void            vMBPortTimersSetTimeout( USHORT usTimeOut50us );
+
 void            xMBPortTimersClose( void );
 
 void            vMBPortTimersEnable( void );
@@ -242,6 +334,26 @@ extern          BOOL( *pxMBFrameCBTransmitterEmpty ) ( void );
 
 extern          BOOL( *pxMBPortCBTimerExpired ) ( void );
 
+/*!
+ * \brief Callback function for the porting layer when a complete frame
+ *   of usLength bytes is buffered by the serial driver.
+ *
+ * \return <code>TRUE</code> if the frame was read by the transmission layer,
+ *   <code>FALSE</code> if it has to be passed byte by byte to pxMBFrameCBByteReceived.
+ *   May be NULL if the mode does not support block receive.
+ */
+extern          BOOL( *pxMBFrameCBBlockReceived ) ( USHORT usLength );
+
+/*!
+ * \brief Callback function for the porting layer to get the complete frame
+ *   to transmit at once.
+ *
+ * \return <code>TRUE</code> if the frame is returned and the transmitter
+ *   is finished, <code>FALSE</code> if the frame has to be sent byte by byte
+ *   with pxMBFrameCBTransmitterEmpty. May be NULL if the mode does not support it.
+ */
+extern          BOOL( *pxMBFrameCBTransmitBlock ) ( UCHAR ** ppucFrame, USHORT * pusLength );
+
 #if MB_MASTER_RTU_ENABLED || MB_MASTER_ASCII_ENABLED || MB_MASTER_TCP_ENABLED
 extern          BOOL( *pxMBMasterFrameCBByteReceived ) ( void );
 
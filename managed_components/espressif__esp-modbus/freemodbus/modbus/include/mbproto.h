@@ -60,6 +60,12 @@ PR_BEGIN_EXTERN_C
 #define MB_FUNC_DIAG_GET_COM_EVENT_CNT        ( 11 )
 #define MB_FUNC_DIAG_GET_COM_EVENT_LOG        ( 12 )
 #define MB_FUNC_OTHER_REPORT_SLAVEID          ( 17 )
+#define MB_FUNC_READ_FILE_RECORD              ( 20 )
+#define MB_FUNC_WRITE_FILE_RECORD             ( 21 )
+#define MB_FUNC_MASK_WRITE_REGISTER           ( 22 )
+#define MB_FUNC_READ_FIFO_QUEUE               ( 24 )
+#define MB_FUNC_ENCAPSULATED_INTERFACE        ( 43 )
+#define MB_MEI_READ_DEVICE_ID                 ( 14 )
 #define MB_FUNC_ERROR                         ( 128u )
 /* ----------------------- Type definitions ---------------------------------*/
 typedef enum
@@ -107,6 +107,28 @@ void            xMBUtilSetBits( UCHAR * ucByteBuf, USHORT usBitOffset,
 UCHAR           xMBUtilGetBits( UCHAR * ucByteBuf, USHORT usBitOffset,
                                 UCHAR ucNBits );
 
+/*! \brief Function to copy a bitfield between byte buffers.
+ *
+ * The bits are copied with a funnel shift over 32-bit words, so the source
+ * and destination offsets can be unaligned. Only the bytes which hold the
+ * bits of the field are accessed, the other bits of the first and the last
+ * destination byte are kept.
+ *
+ * \param pucDst The destination buffer.
+ * \param usDstOffset The bit offset of the field in the destination buffer.
+ * \param pucSrc The source buffer, must not overlap the destination.
+ * \param usSrcOffset The bit offset of the field in the source buffer.
+ * \param usNBits Number of bits to copy.
+ */
+void            vMBUtilCopyBits( UCHAR * pucDst, USHORT usDstOffset,
+                                 const UCHAR * pucSrc, USHORT usSrcOffset,
+                                 USHORT usNBits );
+
+#if CONFIG_FMB_BITCOPY_BENCHMARK
+/*! \brief Log the cycles of the bitfield copy at the maximum quantity of FC01, FC02 and FC15. */
+void            vMBUtilCopyBitsBenchmark( void );
+#endif
+
 /*! @} */
 
 #ifdef __cplusplus
@@ -86,6 +86,18 @@ static pvMBFrameStart pvMBFrameStartCur;
 static pvMBFrameStop pvMBFrameStopCur;
 static peMBFrameReceive peMBFrameReceiveCur;
 static pvMBFrameClose pvMBFrameCloseCur;
+static peMBFrameSetConfig peMBFrameSetConfigCur;
+
+/* Configuration change requested by eMBSetConfig( ), applied by eMBPoll( )
+ * when no request is in progress.
+ */
+static struct
+{
+    volatile BOOL   xPending;
+    UCHAR           ucSlaveAddress;
+    ULONG           ulBaudRate;
+    eMBParity       eParity;
+} xMBNewConfig;
 
 /* Callback functions required by the porting layer. They are called when
  * an external event has happend which includes a timeout or the reception
@@ -94,45 +106,128 @@ static pvMBFrameClose pvMBFrameCloseCur;
 BOOL( *pxMBFrameCBByteReceived ) ( void );
 BOOL( *pxMBFrameCBTransmitterEmpty ) ( void );
 BOOL( *pxMBPortCBTimerExpired ) ( void );
+BOOL( *pxMBFrameCBBlockReceived ) ( USHORT usLength );
+BOOL( *pxMBFrameCBTransmitBlock ) ( UCHAR ** ppucFrame, USHORT * pusLength );
 BOOL( *pxMBFrameCBReceiveFSMCur ) ( void );
 BOOL( *pxMBFrameCBTransmitFSMCur ) ( void );
 
-/* An array of Modbus functions handlers which associates Modbus function
- * codes with implementing functions.
+/* A table of Modbus functions handlers indexed by the function code. The
+ * request is dispatched with one lookup and no search.
  */
-static xMBFunctionHandler xFuncHandlers[MB_FUNC_HANDLERS_MAX] = {
+static pxMBFunctionHandler pxFuncHandlers[MB_FUNC_CODE_MAX + 1] = {
 #if MB_FUNC_OTHER_REP_SLAVEID_ENABLED > 0
-    {MB_FUNC_OTHER_REPORT_SLAVEID, eMBFuncReportSlaveID},
+    [MB_FUNC_OTHER_REPORT_SLAVEID] = eMBFuncReportSlaveID,
 #endif
 #if MB_FUNC_READ_INPUT_ENABLED > 0
-    {MB_FUNC_READ_INPUT_REGISTER, eMBFuncReadInputRegister},
+    [MB_FUNC_READ_INPUT_REGISTER] = eMBFuncReadInputRegister,
 #endif
 #if MB_FUNC_READ_HOLDING_ENABLED > 0
-    {MB_FUNC_READ_HOLDING_REGISTER, eMBFuncReadHoldingRegister},
+    [MB_FUNC_READ_HOLDING_REGISTER] = eMBFuncReadHoldingRegister,
 #endif
 #if MB_FUNC_WRITE_MULTIPLE_HOLDING_ENABLED > 0
-    {MB_FUNC_WRITE_MULTIPLE_REGISTERS, eMBFuncWriteMultipleHoldingRegister},
+    [MB_FUNC_WRITE_MULTIPLE_REGISTERS] = eMBFuncWriteMultipleHoldingRegister,
 #endif
 #if MB_FUNC_WRITE_HOLDING_ENABLED > 0
-    {MB_FUNC_WRITE_REGISTER, eMBFuncWriteHoldingRegister},
+    [MB_FUNC_WRITE_REGISTER] = eMBFuncWriteHoldingRegister,
 #endif
 #if MB_FUNC_READWRITE_HOLDING_ENABLED > 0
-    {MB_FUNC_READWRITE_MULTIPLE_REGISTERS, eMBFuncReadWriteMultipleHoldingRegister},
+    [MB_FUNC_READWRITE_MULTIPLE_REGISTERS] = eMBFuncReadWriteMultipleHoldingRegister,
 #endif
 #if MB_FUNC_READ_COILS_ENABLED > 0
-    {MB_FUNC_READ_COILS, eMBFuncReadCoils},
+    [MB_FUNC_READ_COILS] = eMBFuncReadCoils,
 #endif
 #if MB_FUNC_WRITE_COIL_ENABLED > 0
-    {MB_FUNC_WRITE_SINGLE_COIL, eMBFuncWriteCoil},
+    [MB_FUNC_WRITE_SINGLE_COIL] = eMBFuncWriteCoil,
 #endif
 #if MB_FUNC_WRITE_MULTIPLE_COILS_ENABLED > 0
-    {MB_FUNC_WRITE_MULTIPLE_COILS, eMBFuncWriteMultipleCoils},
+    [MB_FUNC_WRITE_MULTIPLE_COILS] = eMBFuncWriteMultipleCoils,
 #endif
 #if MB_FUNC_READ_DISCRETE_INPUTS_ENABLED > 0
-    {MB_FUNC_READ_DISCRETE_INPUTS, eMBFuncReadDiscreteInputs},
+    [MB_FUNC_READ_DISCRETE_INPUTS] = eMBFuncReadDiscreteInputs,
+#endif
+#if MB_FUNC_DIAG_DIAGNOSTIC_ENABLED > 0
+    [MB_FUNC_DIAG_DIAGNOSTIC] = eMBFuncDiagnostic,
+#endif
+#if MB_FUNC_FILE_RECORD_ENABLED > 0
+    [MB_FUNC_READ_FILE_RECORD] = eMBFuncReadFileRecord,
+    [MB_FUNC_WRITE_FILE_RECORD] = eMBFuncWriteFileRecord,
 #endif
 };
 
+/* Number of requests received per function code. The requests with function
+ * codes above MB_FUNC_CODE_MAX are accounted in the entry 0.
+ */
+static volatile ULONG ulFuncHits[MB_FUNC_CODE_MAX + 1];
+
+/* Diagnostic counters of the serial line, see eMBDiagCounter. */
+static volatile ULONG ulDiagCounters[MB_DIAG_COUNTER_COUNT];
+
+typedef struct
+{
+    UCHAR           ucAddress;          /* Slave address, 0 if the entry is free */
+    ULONG           ulRequests;         /* Number of executed requests */
+    ULONG           ulExceptions;       /* Number of exception responses */
+} xMBSlaveContext;
+
+/* Slave contexts, the entry 0 is the slave address given to eMBInit( ) and
+ * the other entries are the virtual slave addresses served on the same port.
+ */
+static xMBSlaveContext xMBSlaves[MB_SLAVE_ADDR_MAX + 1];
+
+#if MB_SLAVE_ADDR_MAX > 0
+/* Maps the virtual slave address to the slave context, 0 if not served. */
+static UCHAR    ucMBAddrSlot[MB_ADDRESS_MAX + 1];
+#endif
+
+/* Context of the request in progress. The TCP port task of the dual transport
+ * mode and the additional RTU port tasks execute their requests concurrently,
+ * so the context is kept per task. */
+#if MB_SLAVE_CONCURRENT_ENABLED
+static __thread UCHAR ucMBReqSlot = 0;
+#else
+static UCHAR    ucMBReqSlot = 0;
+#endif
+
+/* The slave context of the request in progress. Without the virtual slaves the
+ * slot is always 0, the index is not used so the compiler sees the array bounds. */
+static inline xMBSlaveContext *
+prvpxMBReqSlave( void )
+{
+#if MB_SLAVE_ADDR_MAX > 0
+    return &xMBSlaves[ucMBReqSlot];
+#else
+    return &xMBSlaves[0];
+#endif
+}
+
+#if MB_SERIAL_ADDR_FILTER_ENABLED
+/* The receiver drops the frames for other slaves if set, see xMBIsAddressFiltered( ). */
+static volatile BOOL xMBAddrFilter = TRUE;
+#endif
+
+#if MB_SLAVE_RESP_CACHE_ENABLED
+/* The request of the cached read: slave address, function, start and quantity. */
+#define MB_RESP_CACHE_REQ_SIZE          ( 6 )
+#define MB_RESP_CACHE_REGCNT_MAX        ( 0x007D )
+
+typedef struct
+{
+    ULONG           ulVersion;          /* Version of the registers in the frame, 0 if not valid */
+    ULONG           ulGeneration;       /* Generation of the register map, see vMBRespCacheFlush( ) */
+    ULONG           ulLastUse;          /* Value of the use counter when the entry was last used */
+    UCHAR           ucRequest[MB_RESP_CACHE_REQ_SIZE];
+    USHORT          usLength;           /* Length of the response frame including the CRC */
+    UCHAR           ucFrame[MB_SER_PDU_SIZE_MAX];
+} xMBRespCacheEntry;
+
+/* Response frames of the repeated register reads, used by the Modbus task only. */
+static xMBRespCacheEntry xMBRespCache[MB_SLAVE_RESP_CACHE_ENTRIES];
+static ULONG    ulMBRespCacheUse = 0;
+
+/* Incremented by vMBRespCacheFlush( ), the entries of the older generations are stale. */
+static volatile ULONG ulMBRespCacheGen = 0;
+#endif
+
 /* ----------------------- Start implementation -----------------------------*/
 eMBErrorCode
 eMBInit( eMBMode eMode, UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
@@ -158,9 +253,20 @@ eMBInit( eMBMode eMode, UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eM
             peMBFrameSendCur = eMBRTUSend;
             peMBFrameReceiveCur = eMBRTUReceive;
             pvMBFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBPortClose : NULL;
+            peMBFrameSetConfigCur = eMBRTUSetConfig;
             pxMBFrameCBByteReceived = xMBRTUReceiveFSM;
             pxMBFrameCBTransmitterEmpty = xMBRTUTransmitFSM;
             pxMBPortCBTimerExpired = xMBRTUTimerT35Expired;
+#if MB_SERIAL_RX_BLOCK_ENABLED
+            pxMBFrameCBBlockReceived = xMBRTUReceiveBlock;
+#else
+            pxMBFrameCBBlockReceived = NULL;
+#endif
+#if MB_SERIAL_TX_BLOCK_ENABLED
+            pxMBFrameCBTransmitBlock = xMBRTUTransmitBlock;
+#else
+            pxMBFrameCBTransmitBlock = NULL;
+#endif
 
             eStatus = eMBRTUInit( ucMBAddress, ucPort, ulBaudRate, eParity );
             break;
@@ -172,9 +278,20 @@ eMBInit( eMBMode eMode, UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eM
             peMBFrameSendCur = eMBASCIISend;
             peMBFrameReceiveCur = eMBASCIIReceive;
             pvMBFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBPortClose : NULL;
+            peMBFrameSetConfigCur = NULL;
             pxMBFrameCBByteReceived = xMBASCIIReceiveFSM;
             pxMBFrameCBTransmitterEmpty = xMBASCIITransmitFSM;
             pxMBPortCBTimerExpired = xMBASCIITimerT1SExpired;
+#if MB_SERIAL_RX_BLOCK_ENABLED
+            pxMBFrameCBBlockReceived = xMBASCIIReceiveBlock;
+#else
+            pxMBFrameCBBlockReceived = NULL;
+#endif
+#if MB_SERIAL_TX_BLOCK_ENABLED
+            pxMBFrameCBTransmitBlock = xMBASCIITransmitBlock;
+#else
+            pxMBFrameCBTransmitBlock = NULL;
+#endif
 
             eStatus = eMBASCIIInit( ucMBAddress, ucPort, ulBaudRate, eParity );
             break;
@@ -227,6 +344,7 @@ eMBTCPInit( UCHAR ucSlaveUid, USHORT ucTCPPort )
         peMBFrameReceiveCur = eMBTCPReceive;
         peMBFrameSendCur = eMBTCPSend;
         pvMBFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBTCPPortClose : NULL;
+        peMBFrameSetConfigCur = NULL;
         ucMBAddress = ucSlaveUid;
         eMBCurrentMode = MB_TCP;
         eMBState = STATE_DISABLED;
@@ -238,47 +356,248 @@ eMBTCPInit( UCHAR ucSlaveUid, USHORT ucTCPPort )
 eMBErrorCode
 eMBRegisterCB( UCHAR ucFunctionCode, pxMBFunctionHandler pxHandler )
 {
-    int             i;
     eMBErrorCode    eStatus;
 
     if( ( 0 < ucFunctionCode ) && ( ucFunctionCode <= MB_FUNC_CODE_MAX ) )
     {
+        /* A NULL handler removes the function code. */
         ENTER_CRITICAL_SECTION(  );
-        if( pxHandler != NULL )
+        pxFuncHandlers[ucFunctionCode] = pxHandler;
+        EXIT_CRITICAL_SECTION(  );
+        eStatus = MB_ENOERR;
+    }
+    else
+    {
+        eStatus = MB_EINVAL;
+    }
+    return eStatus;
+}
+
+eMBErrorCode
+eMBSetConfig( UCHAR ucSlaveAddress, ULONG ulBaudRate, eMBParity eParity )
+{
+    if( eMBState != STATE_ENABLED )
+    {
+        return MB_EILLSTATE;
+    }
+    if( ( ucSlaveAddress > MB_ADDRESS_MAX )
+        || ( ( eMBCurrentMode != MB_TCP ) && ( ucSlaveAddress < MB_ADDRESS_MIN ) ) )
+    {
+        return MB_EINVAL;
+    }
+    if( ( ulBaudRate != 0 ) && ( peMBFrameSetConfigCur == NULL ) )
+    {
+        /* The transport does not support the change of serial settings. */
+        return MB_EINVAL;
+    }
+    ENTER_CRITICAL_SECTION(  );
+    xMBNewConfig.ucSlaveAddress = ucSlaveAddress;
+    xMBNewConfig.ulBaudRate = ulBaudRate;
+    xMBNewConfig.eParity = eParity;
+    xMBNewConfig.xPending = TRUE;
+    EXIT_CRITICAL_SECTION(  );
+    /* Wake up the stack task to apply the change if the bus is idle. */
+    ( void )xMBPortEventPost( EV_READY );
+    return MB_ENOERR;
+}
+
+static void
+prvvMBApplyConfig( void )
+{
+    eMBErrorCode    eStatus = MB_ENOERR;
+
+    ENTER_CRITICAL_SECTION(  );
+    UCHAR           ucSlaveAddress = xMBNewConfig.ucSlaveAddress;
+    ULONG           ulBaudRate = xMBNewConfig.ulBaudRate;
+    eMBParity       eParity = xMBNewConfig.eParity;
+    xMBNewConfig.xPending = FALSE;
+    EXIT_CRITICAL_SECTION(  );
+
+    if( ulBaudRate != 0 )
+    {
+        eStatus = peMBFrameSetConfigCur( ulBaudRate, eParity );
+    }
+    if( eStatus == MB_ENOERR )
+    {
+        ucMBAddress = ucSlaveAddress;
+        ESP_LOGI(MB_PORT_TAG, "Slave reconfigured, address: %u, baud rate: %lu, parity: %u.",
+                    (unsigned)ucSlaveAddress, (unsigned long)ulBaudRate, (unsigned)eParity);
+    }
+    else
+    {
+        ESP_LOGE(MB_PORT_TAG, "Slave reconfiguration failure, (0x%x).", (int)eStatus);
+    }
+}
+
+eMBErrorCode
+eMBSetSlaveAddress( UCHAR ucAddress, BOOL xEnable )
+{
+#if MB_SLAVE_ADDR_MAX > 0
+    eMBErrorCode    eStatus = MB_ENOERR;
+    UCHAR           ucSlot;
+
+    if( ( ucAddress < MB_ADDRESS_MIN ) || ( ucAddress > MB_ADDRESS_MAX ) )
+    {
+        return MB_EINVAL;
+    }
+    ENTER_CRITICAL_SECTION(  );
+    if( xEnable )
+    {
+        if( ucMBAddrSlot[ucAddress] == 0 )
         {
-            for( i = 0; i < MB_FUNC_HANDLERS_MAX; i++ )
+            for( ucSlot = 1; ucSlot <= MB_SLAVE_ADDR_MAX; ucSlot++ )
             {
-                if( ( xFuncHandlers[i].pxHandler == NULL ) ||
-                    ( xFuncHandlers[i].pxHandler == pxHandler ) )
+                if( xMBSlaves[ucSlot].ucAddress == 0 )
                 {
-                    xFuncHandlers[i].ucFunctionCode = ucFunctionCode;
-                    xFuncHandlers[i].pxHandler = pxHandler;
+                    xMBSlaves[ucSlot].ucAddress = ucAddress;
+                    xMBSlaves[ucSlot].ulRequests = 0;
+                    xMBSlaves[ucSlot].ulExceptions = 0;
+                    ucMBAddrSlot[ucAddress] = ucSlot;
                     break;
                 }
             }
-            eStatus = ( i != MB_FUNC_HANDLERS_MAX ) ? MB_ENOERR : MB_ENORES;
+            eStatus = ( ucSlot <= MB_SLAVE_ADDR_MAX ) ? MB_ENOERR : MB_ENORES;
         }
-        else
+    }
+    else if( ucMBAddrSlot[ucAddress] != 0 )
+    {
+        xMBSlaves[ucMBAddrSlot[ucAddress]].ucAddress = 0;
+        ucMBAddrSlot[ucAddress] = 0;
+    }
+    EXIT_CRITICAL_SECTION(  );
+    return eStatus;
+#else
+    ( void )ucAddress;
+    ( void )xEnable;
+    return MB_ENORES;
+#endif
+}
+
+void
+vMBSetAddressFilter( BOOL xEnable )
+{
+#if MB_SERIAL_ADDR_FILTER_ENABLED
+    xMBAddrFilter = xEnable;
+#else
+    ( void )xEnable;
+#endif
+}
+
+void
+vMBRespCacheFlush( void )
+{
+#if MB_SLAVE_RESP_CACHE_ENABLED
+    ENTER_CRITICAL_SECTION(  );
+    ulMBRespCacheGen++;
+    EXIT_CRITICAL_SECTION(  );
+#endif
+}
+
+BOOL
+xMBIsAddressFiltered( UCHAR ucAddress )
+{
+#if MB_SERIAL_ADDR_FILTER_ENABLED
+    /* The bus analyzer takes the frames of all the slaves. */
+    if( !xMBAddrFilter || xMBPortAnalyzerRunning( ) || ( ucAddress == ucMBAddress )
+        || ( ucAddress == MB_ADDRESS_BROADCAST ) )
+    {
+        return FALSE;
+    }
+#if MB_SLAVE_ADDR_MAX > 0
+    if( ( ucAddress <= MB_ADDRESS_MAX ) && ( ucMBAddrSlot[ucAddress] != 0 ) )
+    {
+        return FALSE;
+    }
+#endif
+    return TRUE;
+#else
+    ( void )ucAddress;
+    return FALSE;
+#endif
+}
+
+UCHAR
+ucMBGetRequestAddress( void )
+{
+#if MB_SLAVE_ADDR_MAX > 0
+    return ( ucMBReqSlot != 0 ) ? xMBSlaves[ucMBReqSlot].ucAddress : 0;
+#else
+    return 0;
+#endif
+}
+
+BOOL
+xMBGetSlaveStats( UCHAR ucAddress, ULONG * pulRequests, ULONG * pulExceptions )
+{
+    UCHAR           ucSlot = 0;
+
+#if MB_SLAVE_ADDR_MAX > 0
+    if( ( ucAddress != 0 ) && ( ucAddress <= MB_ADDRESS_MAX ) )
+    {
+        ucSlot = ucMBAddrSlot[ucAddress];
+        if( ucSlot == 0 )
         {
-            for( i = 0; i < MB_FUNC_HANDLERS_MAX; i++ )
-            {
-                if( xFuncHandlers[i].ucFunctionCode == ucFunctionCode )
-                {
-                    xFuncHandlers[i].ucFunctionCode = 0;
-                    xFuncHandlers[i].pxHandler = NULL;
-                    break;
-                }
-            }
-            /* Remove can't fail. */
-            eStatus = MB_ENOERR;
+            return FALSE;
         }
-        EXIT_CRITICAL_SECTION(  );
     }
-    else
+#else
+    if( ucAddress != 0 )
     {
-        eStatus = MB_EINVAL;
+        return FALSE;
+    }
+#endif
+    *pulRequests = __atomic_load_n( &xMBSlaves[ucSlot].ulRequests, __ATOMIC_RELAXED );
+    *pulExceptions = __atomic_load_n( &xMBSlaves[ucSlot].ulExceptions, __ATOMIC_RELAXED );
+    return TRUE;
+}
+
+ULONG
+ulMBGetFuncHits( UCHAR ucFunctionCode )
+{
+    return ( ucFunctionCode <= MB_FUNC_CODE_MAX ) ? ulFuncHits[ucFunctionCode] : 0;
+}
+
+void
+vMBResetFuncHits( void )
+{
+    USHORT          usIdx;
+
+    for( usIdx = 0; usIdx <= MB_FUNC_CODE_MAX; usIdx++ )
+    {
+        ulFuncHits[usIdx] = 0;
+    }
+}
+
+void
+vMBDiagCount( eMBDiagCounter eCounter )
+{
+    ( void )__atomic_fetch_add( &ulDiagCounters[eCounter], 1, __ATOMIC_RELAXED );
+}
+
+ULONG
+ulMBGetDiagCounter( eMBDiagCounter eCounter )
+{
+    return ( eCounter < MB_DIAG_COUNTER_COUNT ) ? __atomic_load_n( &ulDiagCounters[eCounter], __ATOMIC_RELAXED ) : 0;
+}
+
+void
+vMBResetDiagCounter( eMBDiagCounter eCounter )
+{
+    if( eCounter < MB_DIAG_COUNTER_COUNT )
+    {
+        __atomic_store_n( &ulDiagCounters[eCounter], 0, __ATOMIC_RELAXED );
+    }
+}
+
+void
+vMBResetDiagCounters( void )
+{
+    USHORT          usIdx;
+
+    for( usIdx = 0; usIdx < MB_DIAG_COUNTER_COUNT; usIdx++ )
+    {
+        __atomic_store_n( &ulDiagCounters[usIdx], 0, __ATOMIC_RELAXED );
     }
-    return eStatus;
 }
 
 
@@ -341,16 +660,256 @@ eMBDisable( void )
     return eStatus;
 }
 
+/* Call the handler of the function code. */
+static inline eMBException
+prveMBDispatch( UCHAR ucFunctionCode, UCHAR * pucMBFrame, USHORT * pusLength )
+{
+    if( ( ucFunctionCode <= MB_FUNC_CODE_MAX ) && ( pxFuncHandlers[ucFunctionCode] != NULL ) )
+    {
+        return pxFuncHandlers[ucFunctionCode]( pucMBFrame, pusLength );
+    }
+    return MB_EX_ILLEGAL_FUNCTION;
+}
+
+#if MB_SLAVE_CONCURRENT_ENABLED || MB_SLAVE_BENCHMARK_ENABLED
+eMBException
+eMBExecutePDU( UCHAR * pucMBFrame, USHORT * pusLength )
+{
+    UCHAR           ucFunctionCode = pucMBFrame[MB_PDU_FUNC_OFF];
+    eMBException    eException = prveMBDispatch( ucFunctionCode, pucMBFrame, pusLength );
+
+    if( eException != MB_EX_NONE )
+    {
+        *pusLength = 0;
+        pucMBFrame[( *pusLength )++] = ( UCHAR )( ucFunctionCode | MB_FUNC_ERROR );
+        pucMBFrame[( *pusLength )++] = eException;
+    }
+    return eException;
+}
+
+#if MB_SLAVE_RTU_PORTS_MAX > 0
+eMBException
+eMBExecuteAddrPDU( UCHAR ucAddress, UCHAR * pucMBFrame, USHORT * pusLength )
+{
+    eMBException    eException;
+
+    ucMBReqSlot = 0;
+#if MB_SLAVE_ADDR_MAX > 0
+    if( ( ucAddress != ucMBAddress ) && ( ucAddress <= MB_ADDRESS_MAX ) )
+    {
+        ucMBReqSlot = ucMBAddrSlot[ucAddress];
+    }
+#endif
+    eException = eMBExecutePDU( pucMBFrame, pusLength );
+#if MB_SLAVE_ADDR_MAX > 0
+    /* The counters of the main slave belong to the stack task. */
+    if( ucMBReqSlot != 0 )
+    {
+        ( void )__atomic_fetch_add( &xMBSlaves[ucMBReqSlot].ulRequests, 1, __ATOMIC_RELAXED );
+        if( eException != MB_EX_NONE )
+        {
+            ( void )__atomic_fetch_add( &xMBSlaves[ucMBReqSlot].ulExceptions, 1, __ATOMIC_RELAXED );
+        }
+    }
+#endif
+    ucMBReqSlot = 0;
+    return eException;
+}
+#endif
+#endif
+
+#if MB_SLAVE_RESP_CACHE_ENABLED
+/* Only the reads of the built-in handlers are cached, a custom handler may
+ * build its response from anything. */
+static BOOL
+prvxMBRespCacheable( UCHAR ucFunctionCode )
+{
+#if MB_FUNC_READ_HOLDING_ENABLED > 0
+    if( ( ucFunctionCode == MB_FUNC_READ_HOLDING_REGISTER )
+        && ( pxFuncHandlers[ucFunctionCode] == eMBFuncReadHoldingRegister ) )
+    {
+        return TRUE;
+    }
+#endif
+#if MB_FUNC_READ_INPUT_ENABLED > 0
+    if( ( ucFunctionCode == MB_FUNC_READ_INPUT_REGISTER )
+        && ( pxFuncHandlers[ucFunctionCode] == eMBFuncReadInputRegister ) )
+    {
+        return TRUE;
+    }
+#endif
+    return FALSE;
+}
+
+/* Look up the read request in the cache. Returns the entry with the valid
+ * response frame if *pxHit is set, otherwise the entry prepared to store the
+ * response with the version *pulVersion. NULL if the request is not cached.
+ */
+static xMBRespCacheEntry *
+prvpxMBRespCacheFind( UCHAR ucRcvAddress, const UCHAR * pucMBFrame, USHORT usLength,
+                      ULONG * pulVersion, BOOL * pxHit )
+{
+    xMBRespCacheEntry *pxEntry = NULL;
+    xMBRespCacheEntry *pxVictim = &xMBRespCache[0];
+    ULONG           ulGeneration = ulMBRespCacheGen;
+    USHORT          usRegAddress;
+    USHORT          usRegCount;
+    USHORT          i;
+
+    *pxHit = FALSE;
+    if( ( eMBCurrentMode != MB_RTU ) || ( ucRcvAddress == MB_ADDRESS_BROADCAST )
+        || ( usLength != ( MB_RESP_CACHE_REQ_SIZE - 1 ) ) || !prvxMBRespCacheable( pucMBFrame[MB_PDU_FUNC_OFF] ) )
+    {
+        return NULL;
+    }
+    usRegAddress = ( USHORT )( ( pucMBFrame[MB_PDU_DATA_OFF] << 8 ) | pucMBFrame[MB_PDU_DATA_OFF + 1] );
+    usRegCount = ( USHORT )( ( pucMBFrame[MB_PDU_DATA_OFF + 2] << 8 ) | pucMBFrame[MB_PDU_DATA_OFF + 3] );
+    if( ( usRegCount < 1 ) || ( usRegCount > MB_RESP_CACHE_REGCNT_MAX ) )
+    {
+        return NULL;
+    }
+    /* The register address of the callbacks starts at 1. */
+    *pulVersion = ulMBRegVersionCB( pucMBFrame[MB_PDU_FUNC_OFF], ( USHORT )( usRegAddress + 1 ), usRegCount );
+    if( *pulVersion == 0 )
+    {
+        return NULL;
+    }
+    for( i = 0; i < MB_SLAVE_RESP_CACHE_ENTRIES; i++ )
+    {
+        xMBRespCacheEntry *pxIt = &xMBRespCache[i];
+        BOOL            xValid = ( pxIt->ulVersion != 0 ) && ( pxIt->ulGeneration == ulGeneration );
+
+        if( xValid && ( pxIt->ucRequest[0] == ucRcvAddress )
+            && ( memcmp( &pxIt->ucRequest[1], pucMBFrame, usLength ) == 0 ) )
+        {
+            pxEntry = pxIt;
+            break;
+        }
+        if( !xValid )
+        {
+            pxVictim = pxIt;
+            pxVictim->ulLastUse = 0;
+        }
+        else if( pxIt->ulLastUse < pxVictim->ulLastUse )
+        {
+            pxVictim = pxIt;
+        }
+    }
+    if( ( pxEntry != NULL ) && ( pxEntry->ulVersion == *pulVersion ) )
+    {
+        pxEntry->ulLastUse = ++ulMBRespCacheUse;
+        *pxHit = TRUE;
+        return pxEntry;
+    }
+    /* The stale frame of the same request is replaced instead of another entry. */
+    if( pxEntry == NULL )
+    {
+        pxEntry = pxVictim;
+        pxEntry->ucRequest[0] = ucRcvAddress;
+        memcpy( &pxEntry->ucRequest[1], pucMBFrame, usLength );
+        pxEntry->ulGeneration = ulGeneration;
+    }
+    pxEntry->ulVersion = 0;
+    return pxEntry;
+}
+
+/* Send the stored response frame on behalf of the handler of the read request. */
+static eMBErrorCode
+prveMBRespCacheSend( xMBRespCacheEntry * pxEntry )
+{
+    UCHAR           ucFunctionCode = pxEntry->ucRequest[1 + MB_PDU_FUNC_OFF];
+    USHORT          usRegAddress = ( USHORT )( ( pxEntry->ucRequest[1 + MB_PDU_DATA_OFF] << 8 )
+                                              | pxEntry->ucRequest[1 + MB_PDU_DATA_OFF + 1] );
+    USHORT          usRegCount = ( USHORT )( ( pxEntry->ucRequest[1 + MB_PDU_DATA_OFF + 2] << 8 )
+                                            | pxEntry->ucRequest[1 + MB_PDU_DATA_OFF + 3] );
+
+    vMBPortLatencyMark( MB_LATENCY_POINT_EXECUTE );
+    vMBPortLatencySetFunc( ucFunctionCode );
+    ulFuncHits[ucFunctionCode]++;
+    vMBRegCachedReadCB( ucFunctionCode, ( USHORT )( usRegAddress + 1 ), usRegCount );
+    vMBPortLatencyMark( MB_LATENCY_POINT_DONE );
+    ( void )__atomic_fetch_add( &prvpxMBReqSlave( )->ulRequests, 1, __ATOMIC_RELAXED );
+    vMBDiagCount( MB_DIAG_CACHED );
+    return eMBRTUSendFrame( pxEntry->ucFrame, pxEntry->usLength );
+}
+#endif
+
+/* Execute the request in the frame and send the response if required. */
+static eMBErrorCode
+prveMBExecute( UCHAR ucRcvAddress, UCHAR * pucMBFrame, USHORT * pusLength )
+{
+    UCHAR           ucFunctionCode = pucMBFrame[MB_PDU_FUNC_OFF];
+    eMBException    eException;
+    eMBErrorCode    eStatus = MB_ENOERR;
+#if MB_SLAVE_RESP_CACHE_ENABLED
+    ULONG           ulVersion = 0;
+    BOOL            xHit = FALSE;
+    xMBRespCacheEntry *pxEntry = prvpxMBRespCacheFind( ucRcvAddress, pucMBFrame, *pusLength, &ulVersion, &xHit );
+
+    if( xHit )
+    {
+        return prveMBRespCacheSend( pxEntry );
+    }
+#endif
+
+    vMBPortLatencyMark( MB_LATENCY_POINT_EXECUTE );
+    vMBPortLatencySetFunc( ucFunctionCode );
+    ulFuncHits[( ucFunctionCode <= MB_FUNC_CODE_MAX ) ? ucFunctionCode : 0]++;
+    eException = prveMBDispatch( ucFunctionCode, pucMBFrame, pusLength );
+    vMBPortLatencyMark( MB_LATENCY_POINT_DONE );
+    ( void )__atomic_fetch_add( &prvpxMBReqSlave( )->ulRequests, 1, __ATOMIC_RELAXED );
+    if( eException != MB_EX_NONE )
+    {
+        ( void )__atomic_fetch_add( &prvpxMBReqSlave( )->ulExceptions, 1, __ATOMIC_RELAXED );
+    }
+
+    /* If the request was not sent to the broadcast address we
+     * return a reply. In case of TCP the slave answers to broadcast address. */
+    if( ( ucRcvAddress != MB_ADDRESS_BROADCAST ) || ( eMBCurrentMode == MB_TCP ) )
+    {
+        if( eException != MB_EX_NONE )
+        {
+            vMBDiagCount( MB_DIAG_EXCEPTIONS );
+            /* An exception occurred. Build an error frame. */
+            *pusLength = 0;
+            pucMBFrame[( *pusLength )++] = ( UCHAR )( ucFunctionCode | MB_FUNC_ERROR );
+            pucMBFrame[( *pusLength )++] = eException;
+        }
+        if( ( eMBCurrentMode == MB_ASCII ) && MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS )
+        {
+            vMBPortTimersDelay( MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS );
+        }
+        /* The virtual slave responds with its own address. */
+        eStatus = peMBFrameSendCur( ( ucMBReqSlot != 0 ) ? prvpxMBReqSlave( )->ucAddress : ucMBAddress,
+                                    pucMBFrame, *pusLength );
+#if MB_SLAVE_RESP_CACHE_ENABLED
+        /* The RTU sender has put the address before and the CRC after the PDU. The registers
+         * changed while the handler was reading them have a newer version than ulVersion,
+         * so the frame is not sent for them. */
+        if( ( pxEntry != NULL ) && ( eException == MB_EX_NONE ) && ( eStatus == MB_ENOERR )
+            && ( ( *pusLength + 3 ) <= MB_SER_PDU_SIZE_MAX ) )
+        {
+            pxEntry->usLength = ( USHORT )( *pusLength + 3 );
+            memcpy( pxEntry->ucFrame, pucMBFrame - 1, pxEntry->usLength );
+            pxEntry->ulLastUse = ++ulMBRespCacheUse;
+            pxEntry->ulVersion = ulVersion;
+        }
+#endif
+    }
+    else
+    {
+        vMBDiagCount( MB_DIAG_NO_RESPONSE );
+    }
+    return eStatus;
+}
+
 eMBErrorCode
 eMBPoll( void )
 {
     static UCHAR    *ucMBFrame = NULL;
     static UCHAR    ucRcvAddress;
-    static UCHAR    ucFunctionCode;
     static USHORT   usLength;
-    static eMBException eException;
 
-    int             i;
     eMBErrorCode    eStatus = MB_ENOERR;
     eMBEventType    eEvent;
 
@@ -364,6 +923,12 @@ eMBPoll( void )
      * Otherwise we will handle the event. */
     if( xMBPortEventGet( &eEvent ) == TRUE )
     {
+        /* The change is applied between the requests, a received frame is served
+         * with the previous settings first. */
+        if( xMBNewConfig.xPending && ( eEvent != EV_FRAME_RECEIVED ) && ( eEvent != EV_EXECUTE ) )
+        {
+            prvvMBApplyConfig(  );
+        }
         switch ( eEvent )
         {
         case EV_READY:
@@ -376,11 +941,37 @@ eMBPoll( void )
             if( eStatus == MB_ENOERR )
             {
                 /* Check if the frame is for us. If not ignore the frame. */
-                if( ( ucRcvAddress == ucMBAddress ) || ( ucRcvAddress == MB_ADDRESS_BROADCAST ) 
-                                            || ( ucRcvAddress == MB_TCP_PSEUDO_ADDRESS ) )
+                ucMBReqSlot = 0;
+#if MB_SLAVE_ADDR_MAX > 0
+                if( ( ucRcvAddress != ucMBAddress ) && ( ucRcvAddress <= MB_ADDRESS_MAX ) )
+                {
+                    ucMBReqSlot = ucMBAddrSlot[ucRcvAddress];
+                }
+#endif
+                if( ( eMBCurrentMode == MB_RTU ) && xMBPortAnalyzerListenOnly( ) )
                 {
-                    ( void )xMBPortEventPost( EV_EXECUTE );
+                    /* The passive bus probe does not answer, the frame is only analyzed. */
+                }
+                else if( ( ucRcvAddress == ucMBAddress ) || ( ucRcvAddress == MB_ADDRESS_BROADCAST ) 
+                                            || ( ucRcvAddress == MB_TCP_PSEUDO_ADDRESS ) || ( ucMBReqSlot != 0 ) )
+                {
+                    /* The serial line counters are not updated by the TCP frames. */
+                    if( eMBCurrentMode != MB_TCP )
+                    {
+                        vMBDiagCount( MB_DIAG_SERVER_MESSAGES );
+                        if( ucRcvAddress == MB_ADDRESS_BROADCAST )
+                        {
+                            vMBDiagCount( MB_DIAG_BROADCASTS );
+                        }
+                    }
                     ESP_LOG_BUFFER_HEX_LEVEL(MB_PORT_TAG, &ucMBFrame[MB_PDU_FUNC_OFF], usLength, ESP_LOG_DEBUG);
+                    /* Execute the request right away instead of a round trip
+                     * through the event transport with EV_EXECUTE. */
+                    eStatus = prveMBExecute( ucRcvAddress, ucMBFrame, &usLength );
+                }
+                else if( eMBCurrentMode != MB_TCP )
+                {
+                    vMBDiagCount( MB_DIAG_NOT_ADDRESSED );
                 }
             }
             break;
@@ -390,39 +981,7 @@ eMBPoll( void )
                 return MB_EILLSTATE;
             }
             ESP_LOGD(MB_PORT_TAG, "%s:EV_EXECUTE", __func__);
-            ucFunctionCode = ucMBFrame[MB_PDU_FUNC_OFF];
-            eException = MB_EX_ILLEGAL_FUNCTION;
-            for( i = 0; i < MB_FUNC_HANDLERS_MAX; i++ )
-            {
-                /* No more function handlers registered. Abort. */
-                if( xFuncHandlers[i].ucFunctionCode == 0 )
-                {
-                    break;
-                }
-                if( xFuncHandlers[i].ucFunctionCode == ucFunctionCode )
-                {
-                    eException = xFuncHandlers[i].pxHandler( ucMBFrame, &usLength );
-                    break;
-                }
-            }
-
-            /* If the request was not sent to the broadcast address we
-             * return a reply. In case of TCP the slave answers to broadcast address. */
-            if( ( ucRcvAddress != MB_ADDRESS_BROADCAST ) || ( eMBCurrentMode == MB_TCP ) )
-            {
-                if( eException != MB_EX_NONE )
-                {
-                    /* An exception occurred. Build an error frame. */
-                    usLength = 0;
-                    ucMBFrame[usLength++] = ( UCHAR )( ucFunctionCode | MB_FUNC_ERROR );
-                    ucMBFrame[usLength++] = eException;
-                }
-                if( ( eMBCurrentMode == MB_ASCII ) && MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS )
-                {
-                    vMBPortTimersDelay( MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS );
-                }
-                eStatus = peMBFrameSendCur( ucMBAddress, ucMBFrame, usLength );
-            }
+            eStatus = prveMBExecute( ucRcvAddress, ucMBFrame, &usLength );
             break;
 
         case EV_FRAME_TRANSMIT:
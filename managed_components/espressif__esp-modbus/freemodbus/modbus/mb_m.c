@@ -399,6 +399,10 @@ eMBMasterPoll( void )
                         if ( ( pucMBRecvFrame[MB_PDU_FUNC_OFF]  & ~MB_FUNC_ERROR ) == ( pucMBSendFrame[MB_PDU_FUNC_OFF] ) ) {
                             ESP_LOGD(MB_PORT_TAG, "%" PRIu64 ": Packet data received successfully (%u).", xEvent.xTransactionId, (unsigned)eStatus);
                             ESP_LOG_BUFFER_HEX_LEVEL("POLL receive buffer", (void*)pucMBRecvFrame, (uint16_t)usRecvLength, ESP_LOG_DEBUG);
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+                            // The exception response also shows the slave is alive
+                            vMBMasterPortHealthResponse( ucMBMasterGetDestAddress( ), ( int64_t )xEvent.xPostTimestamp );
+#endif
                             ( void ) xMBMasterPortEventPost( EV_MASTER_EXECUTE );
                         } else {
                             ESP_LOGE( MB_PORT_TAG, "Drop incorrect frame, receive_func(%u) != send_func(%u)",
@@ -482,6 +486,9 @@ eMBMasterPoll( void )
                     switch ( errorType )
                     {
                         case EV_ERROR_RESPOND_TIMEOUT:
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+                            vMBMasterPortHealthTimeout( ucMBMasterGetDestAddress( ) );
+#endif
                             vMBMasterErrorCBRespondTimeout( xEvent.xTransactionId,
                                                             ucMBMasterGetDestAddress( ),
                                                             pucMBSendFrame, usMBMasterGetPDUSndLength( ) );
@@ -40,4 +40,8 @@
 
 USHORT          usMBCRC16( UCHAR * pucFrame, USHORT usLen );
 
+#if CONFIG_FMB_CRC16_BENCHMARK
+void            vMBCRC16Benchmark( void );
+#endif
+
 #endif
@@ -78,8 +78,37 @@ static volatile UCHAR *pucSndBufferCur;
 static volatile USHORT usSndBufferCount;
 
 static volatile USHORT usRcvBufferPos;
+static volatile BOOL xRcvFrameChecked = FALSE;
 static volatile UCHAR *ucRTUBuf = ucMbSlaveBuf;
 
+/* ----------------------- Static functions ---------------------------------*/
+static ULONG
+prvulMBRTUGetT35Timeout( ULONG ulBaudRate )
+{
+    ULONG           usTimerT35_50us;
+
+    /* If baudrate > 19200 then we should use the fixed timer values
+     * t35 = 1750us. Otherwise t35 must be 3.5 times the character time.
+     */
+    if( ulBaudRate > 19200 )
+    {
+        usTimerT35_50us = 35;       /* 1800us. */
+    }
+    else
+    {
+        /* The timer reload value for a character is given by:
+         *
+         * ChTimeValue = Ticks_per_1s / ( Baudrate / 11 )
+         *             = 11 * Ticks_per_1s / Baudrate
+         *             = 220000 / Baudrate
+         * The reload for t3.5 is 1.5 times this value and similary
+         * for t3.5.
+         */
+        usTimerT35_50us = ( 7UL * 220000UL ) / ( 2UL * ulBaudRate );
+    }
+    return usTimerT35_50us;
+}
+
 /* ----------------------- Start implementation -----------------------------*/
 eMBErrorCode
 eMBRTUInit( UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
@@ -97,25 +126,7 @@ eMBRTUInit( UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity ePar
     }
     else
     {
-        /* If baudrate > 19200 then we should use the fixed timer values
-         * t35 = 1750us. Otherwise t35 must be 3.5 times the character time.
-         */
-        if( ulBaudRate > 19200 )
-        {
-            usTimerT35_50us = 35;       /* 1800us. */
-        }
-        else
-        {
-            /* The timer reload value for a character is given by:
-             *
-             * ChTimeValue = Ticks_per_1s / ( Baudrate / 11 )
-             *             = 11 * Ticks_per_1s / Baudrate
-             *             = 220000 / Baudrate
-             * The reload for t3.5 is 1.5 times this value and similary
-             * for t3.5.
-             */
-            usTimerT35_50us = ( 7UL * 220000UL ) / ( 2UL * ulBaudRate );
-        }
+        usTimerT35_50us = prvulMBRTUGetT35Timeout( ulBaudRate );
         if( xMBPortTimersInit( ( USHORT ) usTimerT35_50us ) != TRUE )
         {
             eStatus = MB_EPORTERR;
@@ -126,6 +137,36 @@ eMBRTUInit( UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity ePar
     return eStatus;
 }
 
+eMBErrorCode
+eMBRTUSetConfig( ULONG ulBaudRate, eMBParity eParity )
+{
+    eMBErrorCode    eStatus = MB_ENOERR;
+
+    if( ulBaudRate == 0 )
+    {
+        return MB_EINVAL;
+    }
+    if( xMBPortSerialSetConfig( ulBaudRate, eParity ) != TRUE )
+    {
+        eStatus = MB_EPORTERR;
+    }
+    else
+    {
+        vMBPortTimersSetTimeout( ( USHORT ) prvulMBRTUGetT35Timeout( ulBaudRate ) );
+    }
+    ENTER_CRITICAL_SECTION(  );
+    /* Drop the frame which was partially received with the previous settings. */
+    if( ( eRcvState == STATE_RX_RCV ) || ( eRcvState == STATE_RX_ERROR ) )
+    {
+        vMBPortTimersDisable(  );
+        eRcvState = STATE_RX_IDLE;
+    }
+    usRcvBufferPos = 0;
+    EXIT_CRITICAL_SECTION(  );
+
+    return eStatus;
+}
+
 void
 eMBRTUStart( void )
 {
@@ -166,12 +207,13 @@ eMBRTUReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength )
         return MB_EIO;
     }
 
+    vMBDiagCount( MB_DIAG_BUS_MESSAGES );
     ENTER_CRITICAL_SECTION(  );
     assert( usFrameLength < MB_SER_PDU_SIZE_MAX );
 
-    /* Length and CRC check */
+    /* Length and CRC check, the frame read in block mode is already checked. */
     if( ( usFrameLength >= MB_SER_PDU_SIZE_MIN )
-        && ( usMBCRC16( ( UCHAR * ) pucMBRTUFrame, usFrameLength ) == 0 ) )
+        && ( xRcvFrameChecked || ( usMBCRC16( ( UCHAR * ) pucMBRTUFrame, usFrameLength ) == 0 ) ) )
     {
         /* Save the address field. All frames are passed to the upper layed
          * and the decision if a frame is used is done there.
@@ -188,10 +230,16 @@ eMBRTUReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength )
     }
     else
     {
+        vMBDiagCount( MB_DIAG_BUS_COMM_ERRORS );
         eStatus = MB_EIO;
     }
+    xRcvFrameChecked = FALSE;
 
     EXIT_CRITICAL_SECTION(  );
+    vMBPortTraceFrame( ( eStatus == MB_ENOERR ) ? MB_TRACE_RX : ( MB_TRACE_RX | MB_TRACE_ERROR ),
+                       pucMBRTUFrame, usFrameLength );
+    vMBPortAnalyzerFrame( ( eStatus == MB_ENOERR ) ? MB_TRACE_RX : ( MB_TRACE_RX | MB_TRACE_ERROR ),
+                          pucMBRTUFrame, usFrameLength );
     return eStatus;
 }
 
@@ -225,6 +273,42 @@ eMBRTUSend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength )
         eSndState = STATE_TX_XMIT;
         EXIT_CRITICAL_SECTION(  );
 
+        vMBPortTraceFrame( MB_TRACE_TX, ( UCHAR * ) pucSndBufferCur, usSndBufferCount );
+        vMBPortAnalyzerFrame( MB_TRACE_TX, ( UCHAR * ) pucSndBufferCur, usSndBufferCount );
+        if( xMBPortSerialSendResponse( ( UCHAR * ) pucSndBufferCur, usSndBufferCount ) == FALSE )
+        {
+            eStatus = MB_EIO;
+        }
+
+        vMBPortSerialEnable( FALSE, TRUE );
+    }
+    else
+    {
+        eStatus = MB_EIO;
+    }
+    return eStatus;
+}
+
+#if MB_SLAVE_RESP_CACHE_ENABLED
+/* Send the complete frame with the slave address and the CRC as built by
+ * eMBRTUSend( ) for an earlier request.
+ */
+eMBErrorCode
+eMBRTUSendFrame( const UCHAR * pucFrame, USHORT usLength )
+{
+    eMBErrorCode    eStatus = MB_ENOERR;
+
+    if( ( eRcvState == STATE_RX_IDLE ) && ( usLength <= MB_SER_PDU_SIZE_MAX ) )
+    {
+        ENTER_CRITICAL_SECTION(  );
+        memcpy( ( UCHAR * ) ucRTUBuf, pucFrame, usLength );
+        pucSndBufferCur = ucRTUBuf;
+        usSndBufferCount = usLength;
+        eSndState = STATE_TX_XMIT;
+        EXIT_CRITICAL_SECTION(  );
+
+        vMBPortTraceFrame( MB_TRACE_TX, ( UCHAR * ) pucSndBufferCur, usSndBufferCount );
+        vMBPortAnalyzerFrame( MB_TRACE_TX, ( UCHAR * ) pucSndBufferCur, usSndBufferCount );
         if( xMBPortSerialSendResponse( ( UCHAR * ) pucSndBufferCur, usSndBufferCount ) == FALSE )
         {
             eStatus = MB_EIO;
@@ -238,6 +322,7 @@ eMBRTUSend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength )
     }
     return eStatus;
 }
+#endif
 
 BOOL
 xMBRTUReceiveFSM( void )
@@ -273,6 +358,16 @@ xMBRTUReceiveFSM( void )
          * receiver is in the state STATE_RX_RCV.
          */
     case STATE_RX_IDLE:
+#if MB_SERIAL_ADDR_FILTER_ENABLED
+        /* The frame for other slave is skipped as a damaged one until t3.5. */
+        if( xStatus && xMBIsAddressFiltered( ucByte ) )
+        {
+            vMBDiagCount( MB_DIAG_FILTERED );
+            eRcvState = STATE_RX_ERROR;
+            vMBPortTimersEnable(  );
+            break;
+        }
+#endif
         usRcvBufferPos = 0;
         ucRTUBuf[usRcvBufferPos++] = ucByte;
         eRcvState = STATE_RX_RCV;
@@ -304,6 +399,55 @@ xMBRTUReceiveFSM( void )
     return xStatus;
 }
 
+#if MB_SERIAL_RX_BLOCK_ENABLED
+BOOL
+xMBRTUReceiveBlock( USHORT usLength )
+{
+    /* Only a complete frame in idle state is read at once. The startup
+     * and error states and the oversized frames are handled by the
+     * receiver state machine.
+     */
+    if( ( eSndState != STATE_TX_IDLE ) || ( eRcvState != STATE_RX_IDLE )
+        || ( usLength < MB_SER_PDU_SIZE_MIN ) || ( usLength >= MB_SER_PDU_SIZE_MAX ) )
+    {
+        return FALSE;
+    }
+
+    usRcvBufferPos = usMBPortSerialGetBlock( ( UCHAR * ) ucRTUBuf, usLength );
+
+#if MB_SERIAL_ADDR_FILTER_ENABLED
+    /* The frame for other slave (or its reply) is dropped before the CRC check. */
+    if( ( usRcvBufferPos > 0 ) && xMBIsAddressFiltered( ucRTUBuf[MB_SER_PDU_ADDR_OFF] ) )
+    {
+        vMBDiagCount( MB_DIAG_FILTERED );
+        return TRUE;
+    }
+#endif
+
+    /* The frame is delimited by the UART receive timeout, so there is no
+     * need to wait for t3.5. The damaged frame is dropped here without
+     * waking up the stack.
+     */
+    if( ( usRcvBufferPos == usLength )
+        && ( usMBCRC16( ( UCHAR * ) ucRTUBuf, usRcvBufferPos ) == 0 ) )
+    {
+        vMBPortLatencyMark( MB_LATENCY_POINT_RX );
+        xRcvFrameChecked = TRUE;
+        ( void )xMBPortEventPost( EV_FRAME_RECEIVED );
+    }
+    else
+    {
+        /* Counted as eMBRTUReceive() counts the damaged frames of the
+         * receiver state machine. */
+        vMBDiagCount( MB_DIAG_BUS_MESSAGES );
+        vMBDiagCount( MB_DIAG_BUS_COMM_ERRORS );
+        vMBPortTraceFrame( MB_TRACE_RX | MB_TRACE_ERROR, ( UCHAR * ) ucRTUBuf, usRcvBufferPos );
+        vMBPortAnalyzerFrame( MB_TRACE_RX | MB_TRACE_ERROR, ( UCHAR * ) ucRTUBuf, usRcvBufferPos );
+    }
+    return TRUE;
+}
+#endif
+
 BOOL
 xMBRTUTransmitFSM( void )
 {
@@ -341,6 +485,29 @@ xMBRTUTransmitFSM( void )
     return xNeedPoll;
 }
 
+#if MB_SERIAL_TX_BLOCK_ENABLED
+BOOL
+xMBRTUTransmitBlock( UCHAR ** ppucFrame, USHORT * pusLength )
+{
+    if( ( eRcvState != STATE_RX_IDLE ) || ( eSndState != STATE_TX_XMIT ) || ( usSndBufferCount == 0 ) )
+    {
+        return FALSE;
+    }
+
+    /* Give away the whole frame including CRC and finish the transmitter
+     * the same way as xMBRTUTransmitFSM() does after the last byte. */
+    *ppucFrame = ( UCHAR * ) pucSndBufferCur;
+    *pusLength = usSndBufferCount;
+    pucSndBufferCur += usSndBufferCount;
+    usSndBufferCount = 0;
+
+    xMBPortEventPost( EV_FRAME_TRANSMIT );
+    eSndState = STATE_TX_IDLE;
+    vMBPortTimersEnable(  );
+    return TRUE;
+}
+#endif
+
 BOOL MB_PORT_ISR_ATTR
 xMBRTUTimerT35Expired( void )
 {
@@ -356,6 +523,7 @@ xMBRTUTimerT35Expired( void )
         /* A frame was received and t35 expired. Notify the listener that
          * a new frame was received. */
     case STATE_RX_RCV:
+        vMBPortLatencyMark( MB_LATENCY_POINT_RX );
         xNeedPoll = xMBPortEventPost( EV_FRAME_RECEIVED );
         break;
 
@@ -51,10 +51,14 @@ eMBErrorCode eMBRTUInit( UCHAR slaveAddress, UCHAR ucPort, ULONG ulBaudRate,
                              eMBParity eParity );
 void            eMBRTUStart( void );
 void            eMBRTUStop( void );
+eMBErrorCode    eMBRTUSetConfig( ULONG ulBaudRate, eMBParity eParity );
 eMBErrorCode    eMBRTUReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength );
 eMBErrorCode    eMBRTUSend( UCHAR slaveAddress, const UCHAR * pucFrame, USHORT usLength );
+eMBErrorCode    eMBRTUSendFrame( const UCHAR * pucFrame, USHORT usLength );
 BOOL            xMBRTUReceiveFSM( void );
+BOOL            xMBRTUReceiveBlock( USHORT usLength );
 BOOL            xMBRTUTransmitFSM( void );
+BOOL            xMBRTUTransmitBlock( UCHAR ** ppucFrame, USHORT * pusLength );
 BOOL            xMBRTUTimerT15Expired( void );
 BOOL            xMBRTUTimerT35Expired( void );
 #endif
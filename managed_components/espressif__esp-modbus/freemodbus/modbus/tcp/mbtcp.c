@@ -133,6 +133,8 @@ eMBTCPReceive( UCHAR * pucRcvAddress, UCHAR ** ppucFrame, USHORT * pusLength )
             *pucRcvAddress = MB_TCP_PSEUDO_ADDRESS;
 #endif
         }
+        vMBPortTraceFrame( ( eStatus == MB_ENOERR ) ? ( MB_TRACE_RX | MB_TRACE_TCP ) :
+                           ( MB_TRACE_RX | MB_TRACE_TCP | MB_TRACE_ERROR ), pucMBTCPFrame, usLength );
     }
     else
     {
@@ -157,6 +159,7 @@ eMBTCPSend( UCHAR _unused, const UCHAR * pucFrame, USHORT usLength )
     pucMBTCPFrame[MB_TCP_LEN] = ( usLength + 1 ) >> 8U;
     pucMBTCPFrame[MB_TCP_LEN + 1] = ( usLength + 1 ) & 0xFF;
 
+    vMBPortTraceFrame( MB_TRACE_TX | MB_TRACE_TCP, pucMBTCPFrame, usTCPLength );
     if( xMBTCPPortSendResponse( pucMBTCPFrame, usTCPLength ) == FALSE )
     {
         eStatus = MB_EIO;
@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _PORT_SIM_H
+#define _PORT_SIM_H
+
+/* ----------------------- Platform includes --------------------------------*/
+#include <stdint.h>
+#include "port.h"
+
+#ifdef __cplusplus
+PR_BEGIN_EXTERN_C
+#endif /* __cplusplus */
+
+/*
+ * Simulated port layer of the slave stack for the host build (linux target).
+ *
+ * The UART is a pair of memory buffers, the timer runs on a virtual clock that
+ * only moves with vMBPortSimAdvance() and the wire time of the simulated bytes,
+ * the events are kept in a bit mask protected by a pthread mutex. The stack is
+ * initialized and enabled with eMBInit() and eMBEnable() as on the target, the
+ * register callbacks eMBReg*CB() are provided by the host program.
+ */
+
+/* ----------------------- Function prototypes ------------------------------*/
+
+/**
+ * Deliver bytes to the virtual UART as one burst, with the wire time of each byte
+ *
+ * @param pucData received bytes
+ * @param usLength number of bytes, up to an ASCII frame of MB_SERIAL_BUF_SIZE bytes (2 * MB_SERIAL_BUF_SIZE + 3)
+ *
+ * @return TRUE if the receiver is enabled and the bytes are passed to the stack
+ */
+BOOL xMBPortSimReceive( const UCHAR * pucData, USHORT usLength );
+
+/**
+ * Take the bytes sent by the stack since the last call
+ *
+ * @param pucBuf buffer for the sent bytes
+ * @param usMaxLength size of the buffer
+ *
+ * @return number of the bytes copied into the buffer
+ */
+USHORT usMBPortSimTransmitted( UCHAR * pucBuf, USHORT usMaxLength );
+
+/**
+ * Move the virtual clock forward and expire the timer if its deadline is reached
+ *
+ * @param ulMicros time in microseconds
+ */
+void vMBPortSimAdvance( ULONG ulMicros );
+
+/**
+ * Move the virtual clock up to the deadline of the running timer and expire it
+ *
+ * @return TRUE if a timer was running
+ */
+BOOL xMBPortSimExpireTimer( void );
+
+/**
+ * Get the virtual clock
+ *
+ * @return time since start in microseconds
+ */
+uint64_t ullMBPortSimTime( void );
+
+/**
+ * Check for pending stack events, eMBPoll() does not block if one is pending
+ *
+ * @return TRUE if an event is pending
+ */
+BOOL xMBPortSimEventPending( void );
+
+/**
+ * Move the response of the stack into the virtual UART as the slave task of the target does
+ *
+ * @return TRUE if a frame was sent
+ */
+BOOL xMBPortSerialTxPoll( void );
+
+/**
+ * Run eMBPoll() and the transmitter for all pending events
+ *
+ * @return number of the handled events
+ */
+USHORT usMBPortSimPoll( void );
+
+/**
+ * Serve one request frame: receive it, expire T3.5, poll the stack and collect the response
+ *
+ * @param pucRequest request frame including the CRC or ASCII framing
+ * @param usRequestLength length of the request
+ * @param pucResponse buffer for the response frame
+ * @param usMaxLength size of the response buffer
+ *
+ * @return length of the response, 0 if the stack did not respond
+ */
+USHORT usMBPortSimTransaction( const UCHAR * pucRequest, USHORT usRequestLength,
+                               UCHAR * pucResponse, USHORT usMaxLength );
+
+#ifdef __cplusplus
+PR_END_EXTERN_C
+#endif /* __cplusplus */
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <pthread.h>
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+#include "port_sim.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+
+/* ----------------------- Variables ----------------------------------------*/
+/* Pending events as bits like the task notification mode of the target port,
+ * eMBPoll() may run in a separate thread and wait for them.
+ */
+static pthread_mutex_t xEventLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xEventCond = PTHREAD_COND_INITIALIZER;
+static uint32_t ulEventBits = 0;
+static BOOL     xEventInit = FALSE;
+
+static pthread_mutex_t xPortLock = PTHREAD_MUTEX_INITIALIZER;
+static UCHAR    ucPortMode = 0;
+
+/* ----------------------- Start implementation -----------------------------*/
+BOOL
+xMBPortEventInit( void )
+{
+    pthread_mutex_lock( &xEventLock );
+    ulEventBits = 0;
+    xEventInit = TRUE;
+    pthread_mutex_unlock( &xEventLock );
+    return TRUE;
+}
+
+void
+vMBPortEventClose( void )
+{
+    pthread_mutex_lock( &xEventLock );
+    xEventInit = FALSE;
+    ulEventBits = 0;
+    pthread_mutex_unlock( &xEventLock );
+}
+
+BOOL
+xMBPortEventPost( eMBEventType eEvent )
+{
+    assert( xEventInit == TRUE );
+    pthread_mutex_lock( &xEventLock );
+    ulEventBits |= ( uint32_t )eEvent;
+    pthread_cond_signal( &xEventCond );
+    pthread_mutex_unlock( &xEventLock );
+    return TRUE;
+}
+
+BOOL
+xMBPortEventGet( eMBEventType * peEvent )
+{
+    assert( xEventInit == TRUE );
+    uint32_t ulBits;
+
+    pthread_mutex_lock( &xEventLock );
+    while( ulEventBits == 0 )
+    {
+        pthread_cond_wait( &xEventCond, &xEventLock );
+    }
+    /* Take the lowest pending event, the others stay pending for the next call. */
+    ulBits = ulEventBits & ( ~ulEventBits + 1 );
+    ulEventBits &= ~ulBits;
+    pthread_mutex_unlock( &xEventLock );
+    *peEvent = ( eMBEventType )ulBits;
+    return TRUE;
+}
+
+BOOL
+xMBPortSimEventPending( void )
+{
+    pthread_mutex_lock( &xEventLock );
+    BOOL xPending = ( ulEventBits != 0 );
+    pthread_mutex_unlock( &xEventLock );
+    return xPending;
+}
+
+#if MB_SLAVE_BENCHMARK_ENABLED
+void
+vMBPortEventFlush( void )
+{
+    pthread_mutex_lock( &xEventLock );
+    ulEventBits = 0;
+    pthread_mutex_unlock( &xEventLock );
+}
+#endif
+
+void
+vMBPortEnterCritical( void )
+{
+    pthread_mutex_lock( &xPortLock );
+}
+
+void
+vMBPortExitCritical( void )
+{
+    pthread_mutex_unlock( &xPortLock );
+}
+
+UCHAR
+ucMBPortGetMode( void )
+{
+    return ucPortMode;
+}
+
+void
+vMBPortSetMode( UCHAR ucMode )
+{
+    ENTER_CRITICAL_SECTION();
+    ucPortMode = ucMode;
+    EXIT_CRITICAL_SECTION();
+}
+
+/* The stack keeps the frames in its own buffers as with the default target port. */
+__attribute__ ((weak))
+BOOL
+xMBPortSerialGetRequest( UCHAR **ppucMBSerialFrame, USHORT * usSerialLength )
+{
+    return TRUE;
+}
+
+__attribute__ ((weak))
+BOOL
+xMBPortSerialSendResponse( UCHAR *pucMBSerialFrame, USHORT usSerialLength )
+{
+    return TRUE;
+}
+
+BOOL
+bMBPortIsWithinException( void )
+{
+    return FALSE;
+}
+
+void
+vMBPortClose( void )
+{
+    extern void     vMBPortSerialClose( void );
+    extern void     vMBPortTimerClose( void );
+    vMBPortSerialClose( );
+    vMBPortTimerClose( );
+    vMBPortEventClose( );
+}
@@ -0,0 +1,207 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <string.h>
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+#include "port_sim.h"
+#include "esp_log.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+
+/* ----------------------- Variables ----------------------------------------*/
+static const CHAR *TAG = "MB_SERIAL_SIM";
+
+static BOOL bRxStateEnabled = FALSE; // Receiver enabled flag
+static BOOL bTxStateEnabled = FALSE; // Transmitter enabled flag
+static ULONG ulUartBaudRate = MB_BAUD_RATE_DEFAULT; // Baud rate to calculate the wire time
+
+// The virtual UART buffers, large enough for the ASCII frame of two characters per byte
+#define MB_SIM_BUF_SIZE     (1 + 2 * MB_SERIAL_BUF_SIZE + 2)
+static UCHAR ucRxBuf[MB_SIM_BUF_SIZE];
+static USHORT usRxHead = 0;
+static USHORT usRxTail = 0;
+static UCHAR ucTxBuf[MB_SIM_BUF_SIZE];
+static USHORT usTxLen = 0;
+
+/* ----------------------- Static functions ---------------------------------*/
+static ULONG ulMBPortSimWireTime(USHORT usBytes)
+{
+    return ((ULONG)usBytes * MB_SERIAL_SYMB_BITS * 1000000UL) / ulUartBaudRate;
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+void vMBPortSerialEnable(BOOL bRxEnable, BOOL bTxEnable)
+{
+    bTxStateEnabled = bTxEnable ? TRUE : FALSE;
+    bRxStateEnabled = bRxEnable ? TRUE : FALSE;
+}
+
+BOOL xMBPortSerialInit(UCHAR ucPORT, ULONG ulBaudRate,
+                        UCHAR ucDataBits, eMBParity eParity)
+{
+    (void)ucPORT;
+    (void)ucDataBits;
+    MB_PORT_CHECK((eParity <= MB_PAR_EVEN), FALSE, "Incorrect parity option: %u", (unsigned)eParity);
+    ulUartBaudRate = (ulBaudRate != 0) ? ulBaudRate : MB_BAUD_RATE_DEFAULT;
+    bRxStateEnabled = FALSE;
+    bTxStateEnabled = FALSE;
+    usRxHead = usRxTail = usTxLen = 0;
+    return TRUE;
+}
+
+BOOL xMBPortSerialSetConfig(ULONG ulBaudRate, eMBParity eParity)
+{
+    MB_PORT_CHECK((eParity <= MB_PAR_EVEN), FALSE, "Incorrect parity option: %u", (unsigned)eParity);
+    MB_PORT_CHECK((ulBaudRate != 0), FALSE, "mb incorrect baud rate.");
+    ulUartBaudRate = ulBaudRate;
+    // The characters received with the previous settings are garbage
+    usRxHead = usRxTail = 0;
+    return TRUE;
+}
+
+void vMBPortSerialClose(void)
+{
+    bRxStateEnabled = FALSE;
+    bTxStateEnabled = FALSE;
+    usRxHead = usRxTail = usTxLen = 0;
+}
+
+BOOL xMBPortSerialPutByte(CHAR ucByte)
+{
+    MB_PORT_CHECK((usTxLen < MB_SIM_BUF_SIZE), FALSE, "mb serial TX buffer overflow.");
+    ucTxBuf[usTxLen++] = (UCHAR)ucByte;
+    return TRUE;
+}
+
+USHORT usMBPortSerialGetBlock(UCHAR* pucBuf, USHORT usLength)
+{
+    assert(pucBuf != NULL);
+    USHORT usAvail = usRxTail - usRxHead;
+    usLength = (usLength < usAvail) ? usLength : usAvail;
+    memcpy(pucBuf, &ucRxBuf[usRxHead], usLength);
+    usRxHead += usLength;
+    return usLength;
+}
+
+BOOL xMBPortSerialGetByte(CHAR* pucByte)
+{
+    assert(pucByte != NULL);
+    if (usRxHead == usRxTail) {
+        return FALSE;
+    }
+    *pucByte = (CHAR)ucRxBuf[usRxHead++];
+    return TRUE;
+}
+
+BOOL xMBPortSimReceive(const UCHAR* pucData, USHORT usLength)
+{
+    MB_PORT_CHECK((pucData != NULL) && (usLength <= MB_SIM_BUF_SIZE), FALSE,
+                    "mb incorrect simulated frame.");
+    if (!bRxStateEnabled) {
+        return FALSE;
+    }
+    memcpy(ucRxBuf, pucData, usLength);
+    usRxHead = 0;
+    usRxTail = usLength;
+#if MB_SERIAL_RX_BLOCK_ENABLED
+    // The burst is delimited by UART TOUT as on the target, give it to the stack at once if possible
+    vMBPortSimAdvance(ulMBPortSimWireTime(usLength));
+    if ((pxMBFrameCBBlockReceived != NULL) && pxMBFrameCBBlockReceived(usLength)) {
+        usRxHead = usRxTail = 0;
+        ESP_LOGD(TAG, "RX block: %u bytes", (unsigned)usLength);
+        return TRUE;
+    }
+    // The receiver state machine gets the bytes without the wire time, it was already spent
+    while (usRxHead < usRxTail) {
+        (void)pxMBFrameCBByteReceived();
+    }
+#else
+    // Each byte restarts T3.5 in the receiver state machine after its wire time
+    while (usRxHead < usRxTail) {
+        vMBPortSimAdvance(ulMBPortSimWireTime(1));
+        (void)pxMBFrameCBByteReceived();
+    }
+#endif
+    ESP_LOGD(TAG, "RX: %u bytes", (unsigned)usLength);
+    return TRUE;
+}
+
+USHORT usMBPortSimTransmitted(UCHAR* pucBuf, USHORT usMaxLength)
+{
+    assert(pucBuf != NULL);
+    USHORT usLength = (usTxLen < usMaxLength) ? usTxLen : usMaxLength;
+    memcpy(pucBuf, ucTxBuf, usLength);
+    usTxLen = 0;
+    return usLength;
+}
+
+BOOL xMBPortSerialTxPoll(void)
+{
+    USHORT usCount = 0;
+    BOOL bNeedPoll = TRUE;
+
+    if (bTxStateEnabled) {
+#if MB_SERIAL_TX_BLOCK_ENABLED
+        UCHAR* pucFrame = NULL;
+        USHORT usLength = 0;
+        if ((pxMBFrameCBTransmitBlock != NULL) && pxMBFrameCBTransmitBlock(&pucFrame, &usLength)) {
+            MB_PORT_CHECK(((usTxLen + usLength) <= MB_SIM_BUF_SIZE), FALSE, "mb serial TX buffer overflow.");
+            memcpy(&ucTxBuf[usTxLen], pucFrame, usLength);
+            usTxLen += usLength;
+            vMBPortSerialEnable(TRUE, FALSE);
+            // The post transmission T3.5 starts when the frame is on the wire
+            vMBPortSimAdvance(ulMBPortSimWireTime(usLength));
+            ESP_LOGD(TAG, "MB_TX_block send: (%u) bytes", (unsigned)usLength);
+            return TRUE;
+        }
+#endif
+        while ((bNeedPoll) && (usCount++ < MB_SIM_BUF_SIZE)) {
+            bNeedPoll = pxMBFrameCBTransmitterEmpty( ); // callback to transmit FSM
+        }
+        vMBPortSerialEnable(TRUE, FALSE);
+        vMBPortSimAdvance(ulMBPortSimWireTime(usTxLen));
+        ESP_LOGD(TAG, "MB_TX_buffer send: (%u) bytes", (unsigned)usTxLen);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+USHORT usMBPortSimPoll(void)
+{
+    USHORT usEvents = 0;
+
+    // The same cycle as the slave task of the target, without blocking on idle stack
+    while (xMBPortSimEventPending()) {
+        (void)eMBPoll();
+        if (xMBPortSerialTxPoll()) {
+            (void)xMBPortEventPost(EV_FRAME_SENT);
+        }
+        usEvents++;
+    }
+    return usEvents;
+}
+
+USHORT usMBPortSimTransaction(const UCHAR* pucRequest, USHORT usRequestLength,
+                                UCHAR* pucResponse, USHORT usMaxLength)
+{
+    // The line is idle before the request, finish the startup or previous frame timeout
+    do {
+        (void)usMBPortSimPoll();
+    } while (xMBPortSimExpireTimer());
+    (void)usMBPortSimPoll();
+    if (!xMBPortSimReceive(pucRequest, usRequestLength)) {
+        return 0;
+    }
+    // T3.5 (RTU) after the last byte delimits the frame, ASCII frame ends with LF
+    (void)xMBPortSimExpireTimer();
+    (void)usMBPortSimPoll();
+    return usMBPortSimTransmitted(pucResponse, usMaxLength);
+}
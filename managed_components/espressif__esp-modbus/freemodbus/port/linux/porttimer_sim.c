@@ -0,0 +1,80 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+#include "port_sim.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+
+/* ----------------------- Variables ----------------------------------------*/
+static uint64_t ullSimTime = 0;         /* Virtual clock in microseconds */
+static uint64_t ullTimerDeadline = 0;
+static USHORT   usT35Ticks = 0;         /* Timer period in 50 us ticks */
+static BOOL     xTimerActive = FALSE;
+
+/* ----------------------- Start implementation -----------------------------*/
+BOOL xMBPortTimersInit(USHORT usTimeOut50us)
+{
+    MB_PORT_CHECK((usTimeOut50us > 0), FALSE, "Modbus timeout discreet is incorrect.");
+    usT35Ticks = usTimeOut50us;
+    xTimerActive = FALSE;
+    return TRUE;
+}
+
+void vMBPortTimersSetTimeout(USHORT usTimeOut50us)
+{
+    MB_PORT_CHECK((usTimeOut50us > 0), ; , "timer is not initialized.");
+    usT35Ticks = usTimeOut50us;
+}
+
+void vMBPortTimersEnable(void)
+{
+    ullTimerDeadline = ullSimTime + (uint64_t)usT35Ticks * MB_TIMER_TICK_TIME_US;
+    xTimerActive = TRUE;
+}
+
+void vMBPortTimersDisable(void)
+{
+    xTimerActive = FALSE;
+}
+
+void vMBPortTimerClose(void)
+{
+    xTimerActive = FALSE;
+    usT35Ticks = 0;
+}
+
+void vMBPortTimersDelay(USHORT usTimeOutMS)
+{
+    vMBPortSimAdvance((ULONG)usTimeOutMS * 1000UL);
+}
+
+void vMBPortSimAdvance(ULONG ulMicros)
+{
+    ullSimTime += ulMicros;
+    if (xTimerActive && (ullSimTime >= ullTimerDeadline)) {
+        // One shot timer as the esp_timer of the target port
+        xTimerActive = FALSE;
+        (void)pxMBPortCBTimerExpired();
+    }
+}
+
+BOOL xMBPortSimExpireTimer(void)
+{
+    if (!xTimerActive) {
+        return FALSE;
+    }
+    vMBPortSimAdvance((ULONG)(ullTimerDeadline - ullSimTime));
+    return TRUE;
+}
+
+uint64_t ullMBPortSimTime(void)
+{
+    return ullSimTime;
+}
@@ -37,12 +37,15 @@
 #ifndef PORT_COMMON_H_
 #define PORT_COMMON_H_
 
-#include "sys/lock.h"
-
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"         // for queue
 
 #include "esp_log.h"                // for ESP_LOGE macro
+
+// The host build (linux target) uses the simulated port without the drivers, see port/linux
+#if !CONFIG_IDF_TARGET_LINUX
+#include "sys/lock.h"
 #include "esp_timer.h"
 #include "driver/uart.h"            // for uart_event_t
 
@@ -51,6 +54,7 @@
 #else
 #include "driver/timer.h"
 #endif
+#endif
 
 #include "mbconfig.h"
 
@@ -66,6 +70,9 @@
 #define MB_SERIAL_TASK_PRIO             (CONFIG_FMB_PORT_TASK_PRIO)
 #define MB_SERIAL_TASK_STACK_SIZE       (CONFIG_FMB_PORT_TASK_STACK_SIZE)
 #define MB_SERIAL_TOUT                  (3) // 3.5*8 = 28 ticks, TOUT=3 -> ~24..33 ticks
+#define MB_SERIAL_TOUT_MAX              (126) // maximum UART TOUT threshold in symbols
+#define MB_SERIAL_SYMB_BITS             (11) // bits per RTU character (start, 8 data, parity or second stop, stop)
+#define MB_SERIAL_T35_FIXED_US          (1750) // fixed T3.5 interval for baud rates above 19200
 
 // Set buffer size for transmission
 #define MB_SERIAL_BUF_SIZE              (CONFIG_FMB_SERIAL_BUF_SIZE)
@@ -73,6 +80,7 @@
 // common definitions for serial port implementations
 #define MB_SERIAL_TX_TOUT_MS            (2200) // maximum time for transmission of longest allowed frame buffer
 #define MB_SERIAL_TX_TOUT_TICKS         (pdMS_TO_TICKS(MB_SERIAL_TX_TOUT_MS)) // timeout for transmission
+#define MB_SERIAL_TX_MARGIN_MS          (10) // margin added to the frame wire time to wait for TX done
 #define MB_SERIAL_RX_TOUT_MS            (1)
 #define MB_SERIAL_RX_TOUT_TICKS         (pdMS_TO_TICKS(MB_SERIAL_RX_TOUT_MS)) // timeout for receive
 
@@ -125,6 +133,7 @@
     } \
 } while(0)
 
+#if !CONFIG_IDF_TARGET_LINUX
 int lock_obj(_lock_t *plock);
 void unlock_obj(_lock_t *plock);
 
@@ -153,6 +162,7 @@ void unlock_obj(_lock_t *plock);
     } while (0)
 
 #define CRITICAL_SECTION(lock) for (int st = lock_obj((_lock_t *)&lock); (st > 0); unlock_obj((_lock_t *)&lock), st = -1)
+#endif
 
 #ifdef __cplusplus
 PR_BEGIN_EXTERN_C
@@ -198,11 +208,13 @@ typedef enum {
     MB_PORT_IPV6 = 1                      /*!< TCP IPV6 addressing */
 } eMBPortIpVer;
 
+#if !CONFIG_IDF_TARGET_LINUX
 typedef struct {
     esp_timer_handle_t xTimerIntHandle;
     USHORT usT35Ticks;
     BOOL xTimerState;
 } xTimerContext_t;
+#endif
 
 void vMBPortEnterCritical(void);
 void vMBPortExitCritical(void);
@@ -219,6 +231,18 @@ void vMBPortExitCritical(void);
 #define MB_PORT_PARITY_GET(parity) ((parity != UART_PARITY_DISABLE) ? \
                                         ((parity == UART_PARITY_ODD) ? MB_PAR_ODD : MB_PAR_EVEN) : MB_PAR_NONE)
 
+// Get the UART TOUT threshold (in symbols) for T3.5 end of frame detection
+static inline UCHAR ucMBPortSerialGetTout(ULONG ulBaudRate)
+{
+    ULONG ulTout = MB_SERIAL_TOUT;
+    if (ulBaudRate > 19200) {
+        // The spec requires the fixed 1.75 mS interval above 19200 baud
+        ULONG ulSymbUs = (MB_SERIAL_SYMB_BITS * 1000000UL) / ulBaudRate;
+        ulTout = (MB_SERIAL_T35_FIXED_US + ulSymbUs - 1) / ulSymbUs;
+    }
+    return (UCHAR)((ulTout > MB_SERIAL_TOUT_MAX) ? MB_SERIAL_TOUT_MAX : ulTout);
+}
+
 // Legacy Modbus logging function
 #if MB_TCP_DEBUG
 void vMBPortLog( eMBPortLogLevel eLevel, const CHAR * szModule,
@@ -229,7 +253,9 @@ void prvvMBTCPLogFrame( const CHAR * pucMsg, UCHAR * pucFrame, USHORT usFrameLen
 void vMBPortSetMode( UCHAR ucMode );
 UCHAR ucMBPortGetMode( void );
 
+#if !CONFIG_IDF_TARGET_LINUX
 BOOL xMBPortSerialWaitEvent(QueueHandle_t xMbUartQueue, uart_event_t* pxEvent, ULONG xTimeout);
+#endif
 
 /**
  * This is modbus master user error handling funcion.
@@ -0,0 +1,354 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <string.h>
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+#include "esp_timer.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mbframe.h"
+#include "mbc_slave.h"
+
+#if MB_SLAVE_BUS_ANALYZER_ENABLED
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_ANALYZER_SLAVES          ( CONFIG_FMB_SLAVE_BUS_ANALYZER_SLAVES )
+#define MB_ANALYZER_TIMEOUT_US      ( ( int64_t )CONFIG_FMB_SLAVE_BUS_ANALYZER_TIMEOUT_MS * 1000 )
+#define MB_ANALYZER_GAP_MAX_US      ( 1000000 )     /* Longer idle times are counted as 1 s */
+#define MB_ANALYZER_FRAME_MIN       ( 4 )           /* Address, function code and CRC */
+#define MB_ANALYZER_READ_REQ_LEN    ( 8 )           /* Request of FC01-04 and response of FC15/16 */
+#define MB_ANALYZER_READ_RESP_LEN   ( 5 )           /* Response of FC01-04 without the data */
+#define MB_ANALYZER_WRITE_REQ_LEN   ( 9 )           /* Request of FC15/16 without the data */
+#define MB_ANALYZER_WRITE_CNT_OFF   ( 6 )           /* Byte count of the request of FC15/16 */
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef enum
+{
+    MB_ANALYZER_SHAPE_ANY,                      /* Tells nothing, the timing decides */
+    MB_ANALYZER_SHAPE_REQUEST,                  /* Only a request has this length */
+    MB_ANALYZER_SHAPE_RESPONSE                  /* Only a response has this length */
+} eMBAnalyzerShape;
+
+/* ----------------------- Variables ----------------------------------------*/
+/* The frames come from the Modbus task and, in the RX block mode, from the serial port task. */
+static portMUX_TYPE xAnalyzerMux = portMUX_INITIALIZER_UNLOCKED;
+static BOOL     xAnalyzerRunning = FALSE;
+static BOOL     xAnalyzerListenOnly = FALSE;
+
+static mb_bus_stats_t xBusStats;
+static mb_bus_slave_stats_t xSlaveStats[MB_ANALYZER_SLAVES];
+static UCHAR    ucSlaveSlot[MB_ADDRESS_MAX + 1];    /* Entry index + 1 per address, 0 if not tracked */
+static int64_t  xStartTime = 0;                     /* Start of the counting */
+static int64_t  xStopTime = 0;                      /* Time the analyzer was stopped */
+static int64_t  xLastFrameEnd = 0;                  /* End of the previous frame, 0 before the first one */
+
+/* The request waiting for the response */
+static BOOL     xPending = FALSE;
+static UCHAR    ucPendingSlot;
+static UCHAR    ucPendingFunc;
+static int64_t  xPendingEnd;
+
+/* ----------------------- Static functions ---------------------------------*/
+static void
+prvvMBAnalyzerClear( int64_t xNow )
+{
+    BOOL            xListenOnly = xBusStats.listen_only;
+
+    memset( &xBusStats, 0, sizeof( xBusStats ) );
+    memset( xSlaveStats, 0, sizeof( xSlaveStats ) );
+    memset( ucSlaveSlot, 0, sizeof( ucSlaveSlot ) );
+    xBusStats.gap_min_us = UINT32_MAX;
+    xBusStats.listen_only = xListenOnly;
+    xStartTime = xNow;
+    xStopTime = xNow;
+    xLastFrameEnd = 0;
+    xPending = FALSE;
+}
+
+static mb_bus_slave_stats_t *
+prvpxMBAnalyzerGetSlave( UCHAR ucAddress )
+{
+    if( ucSlaveSlot[ucAddress] == 0 )
+    {
+        if( xBusStats.slaves >= MB_ANALYZER_SLAVES )
+        {
+            return NULL;
+        }
+        mb_bus_slave_stats_t *pxSlave = &xSlaveStats[xBusStats.slaves++];
+        pxSlave->addr = ucAddress;
+        pxSlave->resp_min_us = UINT32_MAX;
+        ucSlaveSlot[ucAddress] = ( UCHAR )xBusStats.slaves;
+    }
+    return &xSlaveStats[ucSlaveSlot[ucAddress] - 1];
+}
+
+/* A request is missed by the slave when the time is over or the master sends the next frame. */
+static void
+prvvMBAnalyzerCheckTimeout( int64_t xTime, BOOL xForce )
+{
+    if( xPending && ( xForce || ( ( xTime - xPendingEnd ) > MB_ANALYZER_TIMEOUT_US ) ) )
+    {
+        xSlaveStats[ucPendingSlot].timeouts++;
+        xPending = FALSE;
+    }
+}
+
+/* The role of the frame by its length. The masters retrying faster than the analyzer
+ * timeout would be taken as the responses of a silent slave otherwise. The echo
+ * function codes (05, 06, 08) have the same frame in both directions. */
+static eMBAnalyzerShape
+prveMBAnalyzerShape( const UCHAR * pucFrame, USHORT usLength )
+{
+    UCHAR           ucFunc = pucFrame[MB_SER_PDU_PDU_OFF + MB_PDU_FUNC_OFF];
+    BOOL            xRequest = FALSE;
+    BOOL            xResponse = FALSE;
+
+    if( ucFunc & MB_FUNC_ERROR )
+    {
+        return MB_ANALYZER_SHAPE_RESPONSE;
+    }
+    switch ( ucFunc )
+    {
+    case MB_FUNC_READ_COILS:
+    case MB_FUNC_READ_DISCRETE_INPUTS:
+    case MB_FUNC_READ_HOLDING_REGISTER:
+    case MB_FUNC_READ_INPUT_REGISTER:
+        xRequest = ( usLength == MB_ANALYZER_READ_REQ_LEN );
+        xResponse = ( usLength == ( MB_ANALYZER_READ_RESP_LEN + pucFrame[MB_SER_PDU_PDU_OFF + MB_PDU_DATA_OFF] ) );
+        break;
+    case MB_FUNC_WRITE_MULTIPLE_COILS:
+    case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+        xRequest = ( usLength > MB_ANALYZER_WRITE_CNT_OFF )
+                    && ( usLength == ( MB_ANALYZER_WRITE_REQ_LEN + pucFrame[MB_ANALYZER_WRITE_CNT_OFF] ) );
+        xResponse = ( usLength == MB_ANALYZER_READ_REQ_LEN );
+        break;
+    default:
+        break;
+    }
+    if( xRequest == xResponse )
+    {
+        return MB_ANALYZER_SHAPE_ANY;
+    }
+    return xRequest ? MB_ANALYZER_SHAPE_REQUEST : MB_ANALYZER_SHAPE_RESPONSE;
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+void
+vMBPortAnalyzerFrame( UCHAR ucFlags, const UCHAR * pucFrame, USHORT usLength )
+{
+    if( !__atomic_load_n( &xAnalyzerRunning, __ATOMIC_RELAXED ) || ( pucFrame == NULL ) )
+    {
+        return;
+    }
+    int64_t         xNow = esp_timer_get_time( );
+    int64_t         xWire = ( ( int64_t )usLength * ulMBPortSerialCharNs( ) ) / 1000;
+    int64_t         xStart;
+    int64_t         xEnd;
+
+    if( ucFlags & MB_TRACE_TX )
+    {
+        /* The response of the slave goes to the UART now. */
+        xStart = xNow;
+        xEnd = xNow + xWire;
+    }
+    else
+    {
+        /* The frame end is detected by UART TOUT (T3.5) after the last character. */
+        xEnd = xMBPortSerialRxFrameEnd( );
+        if( ( xEnd == 0 ) || ( xEnd > xNow ) )
+        {
+            xEnd = xNow;
+        }
+        xStart = xEnd - xWire;
+    }
+
+    portENTER_CRITICAL( &xAnalyzerMux );
+    if( !xAnalyzerRunning )
+    {
+        portEXIT_CRITICAL( &xAnalyzerMux );
+        return;
+    }
+    xBusStats.frames++;
+    xBusStats.bytes += usLength;
+    xBusStats.busy_us += ( uint64_t )xWire;
+    if( ( xLastFrameEnd != 0 ) && ( xStart >= xLastFrameEnd ) )
+    {
+        int64_t         xGap = xStart - xLastFrameEnd;
+        ULONG           ulGap = ( xGap > MB_ANALYZER_GAP_MAX_US ) ? MB_ANALYZER_GAP_MAX_US : ( ULONG )xGap;
+
+        xBusStats.gaps++;
+        xBusStats.gap_total_us += ulGap;
+        if( ulGap < xBusStats.gap_min_us )
+        {
+            xBusStats.gap_min_us = ulGap;
+        }
+        if( ulGap > xBusStats.gap_max_us )
+        {
+            xBusStats.gap_max_us = ulGap;
+        }
+    }
+    xLastFrameEnd = xEnd;
+    prvvMBAnalyzerCheckTimeout( xStart, FALSE );
+
+    if( ( ucFlags & MB_TRACE_ERROR ) || ( usLength < MB_ANALYZER_FRAME_MIN ) )
+    {
+        xBusStats.bad_frames++;
+        if( xPending )
+        {
+            /* The damaged frame in the response window is the response of the pending request. */
+            xSlaveStats[ucPendingSlot].bad_responses++;
+            xPending = FALSE;
+        }
+        portEXIT_CRITICAL( &xAnalyzerMux );
+        return;
+    }
+
+    UCHAR           ucAddress = pucFrame[MB_SER_PDU_ADDR_OFF];
+    UCHAR           ucFunc = pucFrame[MB_SER_PDU_PDU_OFF + MB_PDU_FUNC_OFF];
+    eMBAnalyzerShape eShape = prveMBAnalyzerShape( pucFrame, usLength );
+
+    if( xPending && ( eShape != MB_ANALYZER_SHAPE_REQUEST ) && ( ucAddress == xSlaveStats[ucPendingSlot].addr )
+        && ( ( ucFunc & ~MB_FUNC_ERROR ) == ucPendingFunc ) )
+    {
+        mb_bus_slave_stats_t *pxSlave = &xSlaveStats[ucPendingSlot];
+        int64_t         xResp = ( xStart > xPendingEnd ) ? ( xStart - xPendingEnd ) : 0;
+        ULONG           ulResp = ( xResp > UINT32_MAX ) ? UINT32_MAX : ( ULONG )xResp;
+
+        if( ucFunc & MB_FUNC_ERROR )
+        {
+            pxSlave->exceptions++;
+        }
+        else
+        {
+            pxSlave->responses++;
+        }
+        pxSlave->resp_last_us = ulResp;
+        pxSlave->resp_total_us += ulResp;
+        if( ulResp < pxSlave->resp_min_us )
+        {
+            pxSlave->resp_min_us = ulResp;
+        }
+        if( ulResp > pxSlave->resp_max_us )
+        {
+            pxSlave->resp_max_us = ulResp;
+        }
+        xPending = FALSE;
+    }
+    else
+    {
+        /* The pending request has not been answered before this frame of the master. */
+        prvvMBAnalyzerCheckTimeout( xStart, TRUE );
+        if( ( eShape == MB_ANALYZER_SHAPE_RESPONSE ) || ( ucAddress > MB_ADDRESS_MAX ) )
+        {
+            xBusStats.unmatched++;
+        }
+        else if( ucAddress == MB_ADDRESS_BROADCAST )
+        {
+            xBusStats.broadcasts++;
+        }
+        else
+        {
+            mb_bus_slave_stats_t *pxSlave = prvpxMBAnalyzerGetSlave( ucAddress );
+            if( pxSlave == NULL )
+            {
+                xBusStats.untracked++;
+            }
+            else
+            {
+                pxSlave->requests++;
+                pxSlave->last_func = ucFunc;
+                ucPendingSlot = ( UCHAR )( ucSlaveSlot[ucAddress] - 1 );
+                ucPendingFunc = ucFunc;
+                xPendingEnd = xEnd;
+                xPending = TRUE;
+            }
+        }
+    }
+    portEXIT_CRITICAL( &xAnalyzerMux );
+}
+
+BOOL
+xMBPortAnalyzerRunning( void )
+{
+    return __atomic_load_n( &xAnalyzerRunning, __ATOMIC_RELAXED );
+}
+
+BOOL
+xMBPortAnalyzerListenOnly( void )
+{
+    return __atomic_load_n( &xAnalyzerRunning, __ATOMIC_RELAXED )
+            && __atomic_load_n( &xAnalyzerListenOnly, __ATOMIC_RELAXED );
+}
+
+void
+mb_port_analyzer_set( bool bEnable, bool bListenOnly )
+{
+    int64_t         xNow = esp_timer_get_time( );
+
+    portENTER_CRITICAL( &xAnalyzerMux );
+    if( bEnable && !xAnalyzerRunning )
+    {
+        prvvMBAnalyzerClear( xNow );
+    }
+    else if( !bEnable && xAnalyzerRunning )
+    {
+        prvvMBAnalyzerCheckTimeout( xNow, FALSE );
+        xStopTime = xNow;
+    }
+    xBusStats.listen_only = bListenOnly;
+    xAnalyzerListenOnly = bListenOnly ? TRUE : FALSE;
+    xAnalyzerRunning = bEnable ? TRUE : FALSE;
+    portEXIT_CRITICAL( &xAnalyzerMux );
+}
+
+size_t
+mb_port_analyzer_get( mb_bus_stats_t *pxStats, mb_bus_slave_stats_t *pxSlaves, size_t xMaxCount )
+{
+    int64_t         xNow = esp_timer_get_time( );
+    size_t          xCount;
+
+    portENTER_CRITICAL( &xAnalyzerMux );
+    if( xAnalyzerRunning )
+    {
+        prvvMBAnalyzerCheckTimeout( xNow, FALSE );
+        xStopTime = xNow;
+    }
+    xBusStats.running = xAnalyzerRunning;
+    xBusStats.elapsed_us = ( uint64_t )( xStopTime - xStartTime );
+    *pxStats = xBusStats;
+    if( pxStats->gaps == 0 )
+    {
+        pxStats->gap_min_us = 0;
+    }
+    xCount = ( xBusStats.slaves < xMaxCount ) ? xBusStats.slaves : xMaxCount;
+    for( size_t i = 0; i < xCount; i++ )
+    {
+        pxSlaves[i] = xSlaveStats[i];
+        if( ( pxSlaves[i].responses + pxSlaves[i].exceptions ) == 0 )
+        {
+            pxSlaves[i].resp_min_us = 0;
+        }
+    }
+    portEXIT_CRITICAL( &xAnalyzerMux );
+    return xCount;
+}
+
+void
+mb_port_analyzer_reset( void )
+{
+    int64_t         xNow = esp_timer_get_time( );
+
+    portENTER_CRITICAL( &xAnalyzerMux );
+    prvvMBAnalyzerClear( xNow );
+    portEXIT_CRITICAL( &xAnalyzerMux );
+}
+
+#endif
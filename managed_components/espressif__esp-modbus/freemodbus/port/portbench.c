@@ -0,0 +1,239 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <string.h>
+#include <inttypes.h>
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+#include "esp_log.h"
+#include "esp_idf_version.h"
+#if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0))
+#include "esp_cpu.h"
+#define MB_BENCH_CYCLE_COUNT()  esp_cpu_get_cycle_count()
+#else
+#include "hal/cpu_hal.h"
+#define MB_BENCH_CYCLE_COUNT()  cpu_hal_get_cycle_count()
+#endif
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mbframe.h"
+#include "mbutils.h"
+#include "mbcrc.h"
+#include "mbrtu.h"
+#if CONFIG_FMB_EXT_TYPE_SUPPORT
+#include "mb_endianness_utils.h"
+#endif
+
+#if MB_SLAVE_BENCHMARK_ENABLED
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_BENCH_ROUNDS         ( 64 )
+#define MB_BENCH_REG_START      ( CONFIG_FMB_SLAVE_HOTPATH_BENCHMARK_REG_START )
+#define MB_BENCH_REG_COUNT      ( CONFIG_FMB_SLAVE_HOTPATH_BENCHMARK_REG_COUNT )
+#define MB_BENCH_BITS           ( 0x07D0 )  /* Maximum quantity of FC01 and FC02 */
+#define MB_BENCH_BITS_OFF       ( 3 )       /* Unaligned start of the copied bits in the area */
+#define MB_BENCH_RTU_FRAME_SIZE ( 8 )       /* FC03 request */
+#define MB_BENCH_FLOATS         ( 60 )      /* Register block of an energy meter poll */
+
+#if CONFIG_FMB_CRC16_ENGINE_SLICE8
+#define MB_BENCH_CRC_ENGINE     "slice-by-8"
+#elif CONFIG_FMB_CRC16_ENGINE_SLICE4
+#define MB_BENCH_CRC_ENGINE     "slice-by-4"
+#else
+#define MB_BENCH_CRC_ENGINE     "table"
+#endif
+
+#if CONFIG_FMB_CRC16_IN_IRAM
+#define MB_BENCH_CRC_PLACE      " in IRAM"
+#else
+#define MB_BENCH_CRC_PLACE      ""
+#endif
+
+#if CONFIG_FMB_LOW_LATENCY_PROFILE
+#define MB_BENCH_PATH_PLACE     ", request path in IRAM"
+#else
+#define MB_BENCH_PATH_PLACE     ""
+#endif
+
+#if MB_SERIAL_RX_BLOCK_ENABLED
+#define MB_BENCH_RX_MODE        "block"
+#else
+#define MB_BENCH_RX_MODE        "FSM"
+#endif
+
+#if MB_PORT_EVENT_NOTIFY_ENABLED
+#define MB_BENCH_EVENT_MODE     "notification"
+#else
+#define MB_BENCH_EVENT_MODE     "queue"
+#endif
+
+/* Run the statement MB_BENCH_ROUNDS times and log the average and minimum cycles,
+ * the minimum is the cost without interrupts and cache misses.
+ */
+#define MB_BENCH_MEASURE( pcName, xStatement )                                              \
+    do                                                                                          \
+    {                                                                                           \
+        uint32_t ulSum = 0, ulMin = UINT32_MAX;                                                 \
+        for( int iRound = 0; iRound < MB_BENCH_ROUNDS; iRound++ )                              \
+        {                                                                                       \
+            uint32_t ulStart = MB_BENCH_CYCLE_COUNT( );                                         \
+            xStatement;                                                                         \
+            uint32_t ulCycles = MB_BENCH_CYCLE_COUNT( ) - ulStart;                              \
+            ulSum += ulCycles;                                                                  \
+            ulMin = ( ulCycles < ulMin ) ? ulCycles : ulMin;                                    \
+        }                                                                                       \
+        ESP_LOGI( TAG, "%-24s %8" PRIu32 " avg %8" PRIu32 " min cycles/op",                     \
+                  ( pcName ), ulSum / MB_BENCH_ROUNDS, ulMin );                                 \
+    } while( 0 )
+
+/* ----------------------- Variables ----------------------------------------*/
+static const char *TAG = "MB_BENCH";
+
+static UCHAR    ucBenchData[MB_SER_PDU_SIZE_MAX];
+static UCHAR    ucBenchFrame[MB_SER_PDU_SIZE_MAX];
+static UCHAR    ucBenchPDU[MB_PDU_SIZE_MAX];
+static volatile USHORT usBenchSink;
+
+/* ----------------------- Static functions ---------------------------------*/
+static USHORT
+prvusMBBenchBuildRead( UCHAR * pucPDU )
+{
+    pucPDU[MB_PDU_FUNC_OFF] = MB_FUNC_READ_HOLDING_REGISTER;
+    pucPDU[1] = ( UCHAR )( MB_BENCH_REG_START >> 8 );
+    pucPDU[2] = ( UCHAR )( MB_BENCH_REG_START & 0xFF );
+    pucPDU[3] = 0;
+    pucPDU[4] = ( UCHAR )MB_BENCH_REG_COUNT;
+    return 5;
+}
+
+/* Receive one FC03 request frame from the synthetic source up to the PDU of the frame. */
+static eMBErrorCode
+prveMBBenchReceive( void )
+{
+    UCHAR           ucAddress;
+    UCHAR          *pucPDU;
+    USHORT          usLength;
+
+    vMBPortSerialSetBenchSource( ucBenchFrame, MB_BENCH_RTU_FRAME_SIZE );
+#if MB_SERIAL_RX_BLOCK_ENABLED
+    ( void )xMBRTUReceiveBlock( MB_BENCH_RTU_FRAME_SIZE );
+#else
+    for( USHORT i = 0; i < MB_BENCH_RTU_FRAME_SIZE; i++ )
+    {
+        ( void )xMBRTUReceiveFSM( );
+    }
+    ( void )xMBRTUTimerT35Expired( );
+#endif
+    return eMBRTUReceive( &ucAddress, &pucPDU, &usLength );
+}
+
+/* Execute the PDU built by the request builder, the response overwrites the request. */
+static eMBException
+prveMBBenchExecute( const UCHAR * pucRequest, USHORT usLength )
+{
+    memcpy( ucBenchPDU, pucRequest, usLength );
+    return eMBExecutePDU( ucBenchPDU, &usLength );
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+void
+vMBPortBenchmark( void )
+{
+    static UCHAR    ucReadPDU[5];
+    static UCHAR    ucWritePDU[6 + 2 * MB_BENCH_REG_COUNT];
+    USHORT          usReadLen = prvusMBBenchBuildRead( ucReadPDU );
+    USHORT          usWriteLen;
+    USHORT          usCRC;
+    eMBException    eException;
+
+    for( USHORT i = 0; i < MB_SER_PDU_SIZE_MAX; i++ )
+    {
+        ucBenchData[i] = ( UCHAR )( i * 7 + 3 );
+    }
+    ESP_LOGI( TAG, "Hot path benchmark: CRC16 " MB_BENCH_CRC_ENGINE MB_BENCH_CRC_PLACE MB_BENCH_PATH_PLACE ", RX " MB_BENCH_RX_MODE
+              ", events by " MB_BENCH_EVENT_MODE ", %d rounds.", MB_BENCH_ROUNDS );
+
+    MB_BENCH_MEASURE( "usMBCRC16 8 bytes", usBenchSink = usMBCRC16( ucBenchData, 8 ) );
+    MB_BENCH_MEASURE( "usMBCRC16 64 bytes", usBenchSink = usMBCRC16( ucBenchData, 64 ) );
+    MB_BENCH_MEASURE( "usMBCRC16 256 bytes", usBenchSink = usMBCRC16( ucBenchData, MB_SER_PDU_SIZE_MAX ) );
+
+    /* The receiver has to be idle, the startup event is flushed at the end. */
+    ( void )xMBRTUTimerT35Expired( );
+    ucBenchFrame[MB_SER_PDU_ADDR_OFF] = 1;
+    memcpy( &ucBenchFrame[MB_SER_PDU_PDU_OFF], ucReadPDU, usReadLen );
+    usCRC = usMBCRC16( ucBenchFrame, MB_BENCH_RTU_FRAME_SIZE - 2 );
+    ucBenchFrame[MB_BENCH_RTU_FRAME_SIZE - 2] = ( UCHAR )( usCRC & 0xFF );
+    ucBenchFrame[MB_BENCH_RTU_FRAME_SIZE - 1] = ( UCHAR )( usCRC >> 8 );
+    /* The event of each received frame is flushed, otherwise the event queue fills up. */
+    MB_BENCH_MEASURE( "RTU receive FC03 frame", usBenchSink = ( USHORT )prveMBBenchReceive( ); vMBPortEventFlush( ) );
+    vMBPortSerialSetBenchSource( NULL, 0 );
+
+    /* The same values are written back, the registers are not changed by the benchmark. */
+    eException = prveMBBenchExecute( ucReadPDU, usReadLen );
+    if( eException == MB_EX_NONE )
+    {
+        MB_BENCH_MEASURE( "dispatch FC03", usBenchSink = ( USHORT )prveMBBenchExecute( ucReadPDU, usReadLen ) );
+        memcpy( ucWritePDU, ucReadPDU, usReadLen );
+        ucWritePDU[MB_PDU_FUNC_OFF] = MB_FUNC_WRITE_MULTIPLE_REGISTERS;
+        ucWritePDU[5] = ( UCHAR )( 2 * MB_BENCH_REG_COUNT );
+        memcpy( &ucWritePDU[6], &ucBenchPDU[2], 2 * MB_BENCH_REG_COUNT );
+        usWriteLen = ( USHORT )sizeof( ucWritePDU );
+        MB_BENCH_MEASURE( "dispatch FC16", usBenchSink = ( USHORT )prveMBBenchExecute( ucWritePDU, usWriteLen ) );
+        MB_BENCH_MEASURE( "eMBRegHoldingCB read",
+                          usBenchSink = ( USHORT )eMBRegHoldingCB( ucBenchPDU, MB_BENCH_REG_START + 1,
+                                                                   MB_BENCH_REG_COUNT, MB_REG_READ ) );
+    }
+    else
+    {
+        ESP_LOGW( TAG, "Holding registers %d..%d are not readable (exception %d), dispatch is skipped.",
+                  MB_BENCH_REG_START, MB_BENCH_REG_START + MB_BENCH_REG_COUNT - 1, ( int )eException );
+    }
+
+    MB_BENCH_MEASURE( "coil copy 2000 bits",
+                      vMBUtilCopyBits( ucBenchFrame, 0, ucBenchData, MB_BENCH_BITS_OFF, MB_BENCH_BITS ) );
+#if CONFIG_FMB_EXT_TYPE_SUPPORT
+    val_32_arr      xVal32;
+    val_64_arr      xVal64;
+    volatile float  fSink;
+    volatile double dSink;
+
+    memcpy( xVal32, ucBenchData, sizeof( xVal32 ) );
+    memcpy( xVal64, ucBenchData, sizeof( xVal64 ) );
+    MB_BENCH_MEASURE( "mb_get_float_cdab", fSink = mb_get_float_cdab( &xVal32 ) );
+    MB_BENCH_MEASURE( "mb_set_float_cdab", usBenchSink = ( USHORT )mb_set_float_cdab( &xVal32, 1.5f ) );
+    MB_BENCH_MEASURE( "mb_get_double_ghefcdab", dSink = mb_get_double_ghefcdab( &xVal64 ) );
+    MB_BENCH_MEASURE( "mb_set_double_ghefcdab", usBenchSink = ( USHORT )mb_set_double_ghefcdab( &xVal64, 1.5 ) );
+    ( void )fSink;
+    ( void )dSink;
+
+    /* The same block of floats by the value converter per element and by the array converter. */
+    static float    afBenchFloats[MB_BENCH_FLOATS];
+    val_32_arr     *pxRegs = ( val_32_arr * )ucBenchFrame;
+
+    memcpy( ucBenchFrame, ucBenchData, MB_BENCH_FLOATS * sizeof( val_32_arr ) );
+    MB_BENCH_MEASURE( "get 60 float cdab",
+        for( int i = 0; i < MB_BENCH_FLOATS; i++ ) { afBenchFloats[i] = mb_get_float_cdab( &pxRegs[i] ); } );
+    MB_BENCH_MEASURE( "mb_get_float_array cdab",
+                      mb_get_float_array( afBenchFloats, pxRegs, MB_BENCH_FLOATS, MB_ORDER32_CDAB ) );
+    MB_BENCH_MEASURE( "set 60 float cdab",
+        for( int i = 0; i < MB_BENCH_FLOATS; i++ ) { ( void )mb_set_float_cdab( &pxRegs[i], afBenchFloats[i] ); } );
+    MB_BENCH_MEASURE( "mb_set_float_array cdab",
+                      mb_set_float_array( pxRegs, afBenchFloats, MB_BENCH_FLOATS, MB_ORDER32_CDAB ) );
+    MB_BENCH_MEASURE( "mb_get_float_array dcba",
+                      mb_get_float_array( afBenchFloats, pxRegs, MB_BENCH_FLOATS, MB_ORDER32_DCBA ) );
+#endif
+
+    /* Leave the stack as it was initialized. */
+    vMBPortTimersDisable( );
+    vMBPortEventFlush( );
+    vMBResetDiagCounters( );
+}
+
+#endif
@@ -47,14 +47,114 @@
 #include "mbconfig.h"
 #include "port_serial_slave.h"
 /* ----------------------- Variables ----------------------------------------*/
+#if MB_PORT_EVENT_NOTIFY_ENABLED
+
+/* Pending events as bits, the Modbus task is woken by a task notification. */
+static volatile uint32_t ulEventBits = 0;
+static TaskHandle_t xEventTaskHdl = NULL;
+static BOOL xEventInit = FALSE;
+
+/* ----------------------- Start implementation -----------------------------*/
+BOOL
+xMBPortEventInit( void )
+{
+    ulEventBits = 0;
+    xEventTaskHdl = NULL;
+    xEventInit = TRUE;
+    return TRUE;
+}
+
+void
+vMBPortEventClose( void )
+{
+    xEventInit = FALSE;
+    xEventTaskHdl = NULL;
+    ulEventBits = 0;
+}
+
+BOOL MB_PORT_ISR_ATTR
+xMBPortEventPost( eMBEventType eEvent )
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    TaskHandle_t xTaskHdl = xEventTaskHdl;
+    assert(xEventInit == TRUE);
+
+    ( void )__atomic_fetch_or( &ulEventBits, ( uint32_t )eEvent, __ATOMIC_RELEASE );
+    /* The events posted before the Modbus task waits are found in the pending bits. */
+    if( xTaskHdl != NULL )
+    {
+        if( (BOOL)xPortInIsrContext() == TRUE )
+        {
+            vTaskNotifyGiveFromISR( xTaskHdl, &xHigherPriorityTaskWoken );
+            if ( xHigherPriorityTaskWoken )
+            {
+                portYIELD_FROM_ISR();
+            }
+        }
+        else
+        {
+            ( void )xTaskNotifyGive( xTaskHdl );
+        }
+    }
+    return TRUE;
+}
+
+BOOL
+xMBPortEventGet(eMBEventType * peEvent)
+{
+    assert(xEventInit == TRUE);
+    uint32_t ulBits;
+
+    if( xEventTaskHdl == NULL )
+    {
+        xEventTaskHdl = xTaskGetCurrentTaskHandle( );
+    }
+    while( ( ulBits = __atomic_load_n( &ulEventBits, __ATOMIC_ACQUIRE ) ) == 0 )
+    {
+        ( void )ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+    }
+    /* Take the lowest pending event, the others stay pending for the next call. */
+    ulBits &= ( ~ulBits + 1 );
+    ( void )__atomic_fetch_and( &ulEventBits, ~ulBits, __ATOMIC_ACQ_REL );
+    *peEvent = ( eMBEventType )ulBits;
+    return TRUE;
+}
+
+#if MB_SLAVE_BENCHMARK_ENABLED
+void
+vMBPortEventFlush( void )
+{
+    /* A notification left without pending bits only wakes the task once. */
+    __atomic_store_n( &ulEventBits, 0, __ATOMIC_RELEASE );
+}
+#endif
+
+QueueHandle_t
+xMBPortEventGetHandle(void)
+{
+    /* There is no event queue in this mode. */
+    return NULL;
+}
+
+#else
+
 static QueueHandle_t xQueueHdl;
+#if MB_STATIC_ALLOCATION_ENABLED
+static StaticQueue_t xQueueBuf;
+static uint8_t ucQueueStorage[MB_EVENT_QUEUE_SIZE * sizeof(eMBEventType)];
+#endif
 
 /* ----------------------- Start implementation -----------------------------*/
 BOOL
 xMBPortEventInit( void )
 {
     BOOL bStatus = FALSE;
-    if((xQueueHdl = xQueueCreate(MB_EVENT_QUEUE_SIZE, sizeof(eMBEventType))) != NULL)
+#if MB_STATIC_ALLOCATION_ENABLED
+    xQueueHdl = xQueueCreateStatic(MB_EVENT_QUEUE_SIZE, sizeof(eMBEventType), ucQueueStorage, &xQueueBuf);
+#else
+    xQueueHdl = xQueueCreate(MB_EVENT_QUEUE_SIZE, sizeof(eMBEventType));
+#endif
+    if(xQueueHdl != NULL)
     {
         vQueueAddToRegistry(xQueueHdl, "MbPortEventQueue");
         bStatus = TRUE;
@@ -110,6 +210,17 @@ xMBPortEventGet(eMBEventType * peEvent)
     return xEventHappened;
 }
 
+#if MB_SLAVE_BENCHMARK_ENABLED
+void
+vMBPortEventFlush( void )
+{
+    if( xQueueHdl != NULL )
+    {
+        ( void )xQueueReset( xQueueHdl );
+    }
+}
+#endif
+
 QueueHandle_t
 xMBPortEventGetHandle(void)
 {
@@ -119,3 +230,5 @@ xMBPortEventGetHandle(void)
     }
     return NULL;
 }
+
+#endif
@@ -144,6 +144,12 @@ xMBMasterPortFsmWaitConfirmation( eMBMasterEventEnum eEventMask, ULONG ulTimeout
     return (eMBMasterEventEnum)(uxBits & eEventMask);
 }
 
+// Set the confirmation event without the FSM, wakes the port task waiting for it
+void vMBMasterPortFsmConfirm( eMBMasterEventEnum eEvent )
+{
+    xEventGroupSetBits( xEventGroupMasterConfirmHdl, (EventBits_t)eEvent );
+}
+
 uint64_t xMBMasterPortGetTransactionId( )
 {
     return atomic_load(&xTransactionID);
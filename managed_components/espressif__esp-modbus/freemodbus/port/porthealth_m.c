@@ -0,0 +1,257 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <string.h>
+#include <limits.h>
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+#include "esp_timer.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb_m.h"
+#include "mbport.h"
+#include "mbframe.h"
+#include "mbc_master.h"
+
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_HEALTH_SLAVES_MAX            ( 32 )      // Number of tracked slaves, the others use the default timeout
+#define MB_HEALTH_TIMEOUT_MAX_US        ( (ULONG)MB_MASTER_TIMEOUT_MS_RESPOND * 1000 )
+#define MB_HEALTH_TIMEOUT_MIN_US        ( (ULONG)CONFIG_FMB_MASTER_TIMEOUT_MS_MIN * 1000 )
+#define MB_HEALTH_GRANULARITY_US        ( 1000 )    // Lower limit of the variance term of the timeout
+#define MB_HEALTH_QUARANTINE_FAILS      ( CONFIG_FMB_MASTER_QUARANTINE_FAILS )
+#define MB_HEALTH_QUARANTINE_MIN_US     ( (int64_t)CONFIG_FMB_MASTER_QUARANTINE_MIN_MS * 1000 )
+#define MB_HEALTH_QUARANTINE_MAX_US     ( (int64_t)CONFIG_FMB_MASTER_QUARANTINE_MAX_MS * 1000 )
+#define MB_HEALTH_BACKOFF_MAX           ( 16 )
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct
+{
+    UCHAR           ucSlaveAddr;        /* Slave address, 0 - free entry */
+    UCHAR           ucFails;            /* Consecutive respond timeouts */
+    UCHAR           ucBackoff;          /* Exponent of the next quarantine period */
+    ULONG           ulSrttUs;           /* Smoothed response time, 0 - no response yet */
+    ULONG           ulRttVarUs;         /* Response time variance */
+    ULONG           ulRtoUs;            /* Respond timeout of the slave */
+    int64_t         xQuarantineEnd;     /* End of the quarantine, 0 - not quarantined */
+    ULONG           ulResponses;
+    ULONG           ulTimeouts;
+    ULONG           ulFastFails;
+} xMBHealthEntry;
+
+/* ----------------------- Variables ----------------------------------------*/
+static xMBHealthEntry xHealthTable[MB_HEALTH_SLAVES_MAX];
+static UCHAR ucHealthPendingAddr = 0;
+static int64_t xHealthPendingStamp = 0;
+static portMUX_TYPE xHealthLock = portMUX_INITIALIZER_UNLOCKED;
+
+/* ----------------------- Static functions ---------------------------------*/
+static xMBHealthEntry *
+prvpxMBMasterHealthFind( UCHAR ucSlaveAddr, BOOL xCreate )
+{
+    xMBHealthEntry *pxFree = NULL;
+    USHORT          usIdx;
+
+    for( usIdx = 0; usIdx < MB_HEALTH_SLAVES_MAX; usIdx++ )
+    {
+        if( xHealthTable[usIdx].ucSlaveAddr == ucSlaveAddr )
+        {
+            return &xHealthTable[usIdx];
+        }
+        if( ( pxFree == NULL ) && ( xHealthTable[usIdx].ucSlaveAddr == 0 ) )
+        {
+            pxFree = &xHealthTable[usIdx];
+        }
+    }
+    if( xCreate && ( pxFree != NULL ) )
+    {
+        memset( pxFree, 0, sizeof( xMBHealthEntry ) );
+        pxFree->ucSlaveAddr = ucSlaveAddr;
+        pxFree->ulRtoUs = MB_HEALTH_TIMEOUT_MAX_US;
+        return pxFree;
+    }
+    return NULL;
+}
+
+/* Respond timeout from the response time statistics (RFC 6298): SRTT + max(G, 4 * RTTVAR). */
+static void
+prvvMBMasterHealthUpdateRto( xMBHealthEntry *pxEntry )
+{
+    ULONG           ulVarTerm = pxEntry->ulRttVarUs * 4;
+    ULONG           ulRto = pxEntry->ulSrttUs +
+                            ( ( ulVarTerm > MB_HEALTH_GRANULARITY_US ) ? ulVarTerm : MB_HEALTH_GRANULARITY_US );
+
+    if( ulRto < MB_HEALTH_TIMEOUT_MIN_US )
+    {
+        ulRto = MB_HEALTH_TIMEOUT_MIN_US;
+    }
+    pxEntry->ulRtoUs = ( ulRto > MB_HEALTH_TIMEOUT_MAX_US ) ? MB_HEALTH_TIMEOUT_MAX_US : ulRto;
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+uint64_t
+xMBMasterPortHealthRequestStart( UCHAR ucSlaveAddr )
+{
+    uint64_t        xToutUs = MB_HEALTH_TIMEOUT_MAX_US;
+    int64_t         xNow = esp_timer_get_time( );
+
+    if( ( ucSlaveAddr == MB_ADDRESS_BROADCAST ) || ( ucSlaveAddr == MB_TCP_PSEUDO_ADDRESS ) )
+    {
+        return xToutUs;
+    }
+    portENTER_CRITICAL_SAFE( &xHealthLock );
+    xMBHealthEntry *pxEntry = prvpxMBMasterHealthFind( ucSlaveAddr, TRUE );
+    if( pxEntry != NULL )
+    {
+        xToutUs = pxEntry->ulRtoUs;
+    }
+    /* The timeout is restarted while the response is received (ASCII), keep the first stamp. */
+    if( ( xHealthPendingStamp == 0 ) || ( ucHealthPendingAddr != ucSlaveAddr ) )
+    {
+        ucHealthPendingAddr = ucSlaveAddr;
+        xHealthPendingStamp = xNow;
+    }
+    portEXIT_CRITICAL_SAFE( &xHealthLock );
+    return xToutUs;
+}
+
+void
+vMBMasterPortHealthResponse( UCHAR ucSlaveAddr, int64_t xRxTimeUs )
+{
+    BOOL            xReleased = FALSE;
+
+    portENTER_CRITICAL_SAFE( &xHealthLock );
+    xMBHealthEntry *pxEntry = prvpxMBMasterHealthFind( ucSlaveAddr, FALSE );
+    if( ( pxEntry != NULL ) && ( ucHealthPendingAddr == ucSlaveAddr ) && ( xHealthPendingStamp != 0 ) )
+    {
+        int64_t         xDelta = xRxTimeUs - xHealthPendingStamp;
+        ULONG           ulRtt = ( xDelta < 0 ) ? 0 : ( ( xDelta > MB_HEALTH_TIMEOUT_MAX_US ) ? MB_HEALTH_TIMEOUT_MAX_US : ( ULONG )xDelta );
+
+        if( pxEntry->ulSrttUs == 0 )
+        {
+            pxEntry->ulSrttUs = ( ulRtt != 0 ) ? ulRtt : 1;
+            pxEntry->ulRttVarUs = ulRtt / 2;
+        }
+        else
+        {
+            ULONG           ulErr = ( pxEntry->ulSrttUs > ulRtt ) ? ( pxEntry->ulSrttUs - ulRtt ) : ( ulRtt - pxEntry->ulSrttUs );
+            pxEntry->ulRttVarUs = ( 3 * pxEntry->ulRttVarUs + ulErr ) / 4;
+            pxEntry->ulSrttUs = ( 7 * pxEntry->ulSrttUs + ulRtt ) / 8;
+        }
+        prvvMBMasterHealthUpdateRto( pxEntry );
+        xReleased = ( pxEntry->xQuarantineEnd != 0 );
+        pxEntry->ucFails = 0;
+        pxEntry->ucBackoff = 0;
+        pxEntry->xQuarantineEnd = 0;
+        pxEntry->ulResponses++;
+    }
+    xHealthPendingStamp = 0;
+    portEXIT_CRITICAL_SAFE( &xHealthLock );
+    /* The log waits for the UART, it is written with the interrupts enabled */
+    if( xReleased )
+    {
+        ESP_EARLY_LOGI( MB_PORT_TAG, "Slave %u responds, released from quarantine.", ( unsigned )ucSlaveAddr );
+    }
+}
+
+void
+vMBMasterPortHealthTimeout( UCHAR ucSlaveAddr )
+{
+    int64_t         xNow = esp_timer_get_time( );
+    int64_t         xQuarantine = 0;
+
+    portENTER_CRITICAL_SAFE( &xHealthLock );
+    xMBHealthEntry *pxEntry = prvpxMBMasterHealthFind( ucSlaveAddr, FALSE );
+    if( pxEntry != NULL )
+    {
+        pxEntry->ulTimeouts++;
+        if( pxEntry->ucFails < UCHAR_MAX )
+        {
+            pxEntry->ucFails++;
+        }
+        /* Back off the timeout, the slave may be just slower than its statistics say. */
+        pxEntry->ulRtoUs = ( pxEntry->ulRtoUs > ( MB_HEALTH_TIMEOUT_MAX_US / 2 ) ) ? MB_HEALTH_TIMEOUT_MAX_US : ( pxEntry->ulRtoUs * 2 );
+        if( MB_HEALTH_QUARANTINE_FAILS && ( pxEntry->ucFails >= MB_HEALTH_QUARANTINE_FAILS ) )
+        {
+            int64_t         xPeriod = MB_HEALTH_QUARANTINE_MIN_US << pxEntry->ucBackoff;
+
+            if( xPeriod > MB_HEALTH_QUARANTINE_MAX_US )
+            {
+                xPeriod = MB_HEALTH_QUARANTINE_MAX_US;
+            }
+            else if( pxEntry->ucBackoff < MB_HEALTH_BACKOFF_MAX )
+            {
+                pxEntry->ucBackoff++;
+            }
+            pxEntry->xQuarantineEnd = xNow + xPeriod;
+            xQuarantine = xPeriod;
+        }
+    }
+    xHealthPendingStamp = 0;
+    portEXIT_CRITICAL_SAFE( &xHealthLock );
+    if( xQuarantine != 0 )
+    {
+        ESP_EARLY_LOGD( MB_PORT_TAG, "Slave %u quarantined for %u ms.", ( unsigned )ucSlaveAddr, ( unsigned )( xQuarantine / 1000 ) );
+    }
+}
+
+BOOL
+xMBMasterPortHealthAllowed( UCHAR ucSlaveAddr )
+{
+    BOOL            xAllowed = TRUE;
+    int64_t         xNow = esp_timer_get_time( );
+
+    portENTER_CRITICAL_SAFE( &xHealthLock );
+    xMBHealthEntry *pxEntry = prvpxMBMasterHealthFind( ucSlaveAddr, FALSE );
+    /* After the end of quarantine the next request probes the slave. */
+    if( ( pxEntry != NULL ) && ( pxEntry->xQuarantineEnd != 0 ) && ( xNow < pxEntry->xQuarantineEnd ) )
+    {
+        pxEntry->ulFastFails++;
+        xAllowed = FALSE;
+    }
+    portEXIT_CRITICAL_SAFE( &xHealthLock );
+    return xAllowed;
+}
+
+esp_err_t
+mb_port_health_get( uint8_t slave_addr, mb_slave_health_t *health )
+{
+    esp_err_t       xErr = ESP_ERR_NOT_FOUND;
+    int64_t         xNow = esp_timer_get_time( );
+
+    portENTER_CRITICAL_SAFE( &xHealthLock );
+    xMBHealthEntry *pxEntry = ( slave_addr != 0 ) ? prvpxMBMasterHealthFind( slave_addr, FALSE ) : NULL;
+    if( pxEntry != NULL )
+    {
+        health->slave_addr = slave_addr;
+        health->quarantined = ( pxEntry->xQuarantineEnd != 0 );
+        health->fails = pxEntry->ucFails;
+        health->srtt_us = pxEntry->ulSrttUs;
+        health->rttvar_us = pxEntry->ulRttVarUs;
+        health->timeout_us = pxEntry->ulRtoUs;
+        health->quarantine_left_ms = ( pxEntry->xQuarantineEnd > xNow ) ? ( uint32_t )( ( pxEntry->xQuarantineEnd - xNow ) / 1000 ) : 0;
+        health->responses = pxEntry->ulResponses;
+        health->timeouts = pxEntry->ulTimeouts;
+        health->fast_fails = pxEntry->ulFastFails;
+        xErr = ESP_OK;
+    }
+    portEXIT_CRITICAL_SAFE( &xHealthLock );
+    return xErr;
+}
+
+void
+mb_port_health_reset( void )
+{
+    portENTER_CRITICAL_SAFE( &xHealthLock );
+    memset( xHealthTable, 0, sizeof( xHealthTable ) );
+    xHealthPendingStamp = 0;
+    portEXIT_CRITICAL_SAFE( &xHealthLock );
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <string.h>
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+#include "esp_timer.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mbc_slave.h"
+
+#if MB_SLAVE_LATENCY_ENABLED
+
+/* ----------------------- Variables ----------------------------------------*/
+volatile int64_t xMBPortLatencyStamps[MB_LATENCY_POINT_COUNT];
+volatile UCHAR ucMBPortLatencyFunc;
+
+static mb_latency_hist_t xLatencyHist[MB_LATENCY_FUNC_MAX];
+static USHORT usLatencyHistUsed = 0;
+
+/* ----------------------- Static functions ---------------------------------*/
+static mb_latency_hist_t *
+prvpxMBPortLatencyGetHist( UCHAR ucFunc )
+{
+    USHORT usIdx;
+
+    for( usIdx = 0; usIdx < usLatencyHistUsed; usIdx++ )
+    {
+        if( xLatencyHist[usIdx].func_code == ucFunc )
+        {
+            return &xLatencyHist[usIdx];
+        }
+    }
+    if( usLatencyHistUsed < ( MB_LATENCY_FUNC_MAX - 1 ) )
+    {
+        xLatencyHist[usLatencyHistUsed].func_code = ucFunc;
+        return &xLatencyHist[usLatencyHistUsed++];
+    }
+    /* The last histogram collects all the function codes which do not fit. */
+    return &xLatencyHist[MB_LATENCY_FUNC_MAX - 1];
+}
+
+static void
+prvvMBPortLatencyAdd( mb_latency_hist_t *pxHist, mb_latency_stage_t eStage, int64_t xDelta )
+{
+    ULONG           ulDelta = ( xDelta > UINT32_MAX ) ? UINT32_MAX : ( ULONG )xDelta;
+    USHORT          usBucket = ( ulDelta == 0 ) ? 0 : ( USHORT )( 32 - __builtin_clz( ( uint32_t )ulDelta ) );
+
+    if( usBucket >= MB_LATENCY_BUCKETS )
+    {
+        usBucket = MB_LATENCY_BUCKETS - 1;
+    }
+    pxHist->buckets[eStage][usBucket]++;
+    if( ulDelta > pxHist->max_us[eStage] )
+    {
+        pxHist->max_us[eStage] = ( uint32_t )ulDelta;
+    }
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+void
+vMBPortLatencyFrameSent( void )
+{
+    int64_t         xNow = esp_timer_get_time( );
+    int64_t         xRx = xMBPortLatencyStamps[MB_LATENCY_POINT_RX];
+    int64_t         xExecute = xMBPortLatencyStamps[MB_LATENCY_POINT_EXECUTE];
+    int64_t         xDone = xMBPortLatencyStamps[MB_LATENCY_POINT_DONE];
+
+    /* Account the response only if all the points belong to the current request. */
+    if( ( xRx != 0 ) && ( xExecute >= xRx ) && ( xDone >= xExecute ) && ( xNow >= xDone ) )
+    {
+        mb_latency_hist_t *pxHist = prvpxMBPortLatencyGetHist( ucMBPortLatencyFunc );
+        pxHist->count++;
+        prvvMBPortLatencyAdd( pxHist, MB_LATENCY_STAGE_DISPATCH, xExecute - xRx );
+        prvvMBPortLatencyAdd( pxHist, MB_LATENCY_STAGE_HANDLER, xDone - xExecute );
+        prvvMBPortLatencyAdd( pxHist, MB_LATENCY_STAGE_TX, xNow - xDone );
+        prvvMBPortLatencyAdd( pxHist, MB_LATENCY_STAGE_TOTAL, xNow - xRx );
+    }
+    xMBPortLatencyStamps[MB_LATENCY_POINT_RX] = 0;
+    xMBPortLatencyStamps[MB_LATENCY_POINT_EXECUTE] = 0;
+    xMBPortLatencyStamps[MB_LATENCY_POINT_DONE] = 0;
+}
+
+size_t
+mb_port_latency_get( mb_latency_hist_t *pxHist, size_t xMaxCount )
+{
+    size_t          xCount = 0;
+    USHORT          usIdx;
+
+    for( usIdx = 0; ( usIdx < MB_LATENCY_FUNC_MAX ) && ( xCount < xMaxCount ); usIdx++ )
+    {
+        if( xLatencyHist[usIdx].count != 0 )
+        {
+            memcpy( &pxHist[xCount++], &xLatencyHist[usIdx], sizeof( mb_latency_hist_t ) );
+        }
+    }
+    return xCount;
+}
+
+void
+mb_port_latency_reset( void )
+{
+    memset( xLatencyHist, 0, sizeof( xLatencyHist ) );
+    usLatencyHistUsed = 0;
+}
+
+#endif
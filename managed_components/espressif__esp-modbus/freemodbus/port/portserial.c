@@ -34,6 +34,7 @@
  * File: $Id: portother.c,v 1.1 2010/06/06 13:07:20 wolti Exp $
  */
 
+#include <string.h>
 #include "driver/uart.h"
 #include "port.h"
 #include "driver/uart.h"
@@ -49,11 +50,41 @@
 #include "sdkconfig.h"              // for KConfig options
 #include "port_serial_slave.h"
 
+#if MB_SERIAL_DMA_ENABLED
+#include "driver/uhci.h"
+#include "hal/uart_ll.h"
+
+#define MB_SERIAL_IDLE_THR_MAX      (1023) // maximum UART RX idle threshold in bit times
+#if MB_SLAVE_ASCII_ENABLED
+// The ASCII frame takes two characters per byte, the ':' and CR LF
+#define MB_SERIAL_DMA_BUF_SIZE      (1 + 2 * MB_SERIAL_BUF_SIZE + 2)
+#else
+#define MB_SERIAL_DMA_BUF_SIZE      (MB_SERIAL_BUF_SIZE)
+#endif
+#endif
+
+#if MB_SERIAL_PM_ENABLED
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "mbc_slave.h"              // for mb_port_pm_get()
+#endif
+
+#if MB_SLAVE_BUS_ANALYZER_ENABLED && !MB_SERIAL_PM_ENABLED
+#include "esp_timer.h"
+#endif
+
 // Note: This code uses mixed coding standard from legacy IDF code and used freemodbus stack
 
+#if !MB_SERIAL_DMA_ENABLED
 // A queue to handle UART event.
 static QueueHandle_t xMbUartQueue;
+#endif
 static TaskHandle_t  xMbTaskHandle;
+#if MB_STATIC_ALLOCATION_ENABLED
+static StaticTask_t xMbTaskBuf;
+static StackType_t  xMbTaskStack[MB_SERIAL_TASK_STACK_SIZE / sizeof(StackType_t)];
+#endif
 static const CHAR *TAG = "MB_SERIAL";
 
 // The UART hardware port number
@@ -61,6 +92,168 @@ static UCHAR ucUartNumber = UART_NUM_MAX - 1;
 
 static BOOL bRxStateEnabled = FALSE; // Receiver enabled flag
 static BOOL bTxStateEnabled = FALSE; // Transmitter enabled flag
+static ULONG ulUartBaudRate = MB_BAUD_RATE_DEFAULT; // Baud rate to calculate the frame wire time
+#if MB_SLAVE_BUS_ANALYZER_ENABLED
+static int64_t xRxFrameEnd = 0; // End of the last character of the frame read at the last TOUT
+#endif
+
+#if MB_SERIAL_DMA_ENABLED
+// UHCI controller and the frame buffer the DMA receives into, it is armed again after the frame is read
+static uhci_controller_handle_t xMbUhciHandle = NULL;
+static QueueHandle_t xMbDmaQueue = NULL; // lengths of the received frames
+#if MB_STATIC_ALLOCATION_ENABLED
+static StaticQueue_t xMbDmaQueueBuf;
+static uint8_t ucMbDmaQueueStorage[MB_QUEUE_LENGTH * sizeof(USHORT)];
+#endif
+DMA_ATTR static UCHAR ucDmaRxBuf[MB_SERIAL_DMA_BUF_SIZE];
+static USHORT usDmaRxCount = 0; // bytes received by the ISR since the last frame end
+static const UCHAR* pucDmaRxCur = NULL; // read position while the frame is given to the stack
+static USHORT usDmaRxLeft = 0;
+#endif
+
+#if MB_SERIAL_PM_ENABLED
+// The locks are held from the first received frame until the bus is idle for the hold time,
+// the CPU frequency lock keeps the response latency of the active bus at the maximum clock
+static esp_pm_lock_handle_t xMbPmLock = NULL;
+static esp_pm_lock_handle_t xMbPmCpuLock = NULL;
+static esp_timer_handle_t xMbPmHoldTimer = NULL;
+static portMUX_TYPE xMbPmMux = portMUX_INITIALIZER_UNLOCKED;
+static BOOL bPmLockHeld = FALSE;
+static int64_t xPmAwakeStart = 0; // time of the wakeup, the lock is taken
+static int64_t xPmWakeStamp = 0; // time of the wakeup until the first response is sent
+static mb_serial_pm_stats_t xPmStats = { 0 };
+
+// Release the lock after the hold time without frames (esp_timer task)
+static void vMBPortSerialPmRelease(void* pvArg)
+{
+    (void)pvArg;
+    BOOL bRelease = FALSE;
+    portENTER_CRITICAL(&xMbPmMux);
+    if (bPmLockHeld) {
+        bPmLockHeld = FALSE;
+        xPmStats.awake_us += (uint64_t)(esp_timer_get_time() - xPmAwakeStart);
+        xPmWakeStamp = 0;
+        bRelease = TRUE;
+    }
+    portEXIT_CRITICAL(&xMbPmMux);
+    if (bRelease) {
+        (void)esp_pm_lock_release(xMbPmCpuLock);
+        (void)esp_pm_lock_release(xMbPmLock);
+    }
+}
+
+// Keep the chip awake for the frame in flight and the hold time after it (port task)
+static void vMBPortSerialPmActivity(void)
+{
+    BOOL bAcquire = FALSE;
+    portENTER_CRITICAL(&xMbPmMux);
+    if (!bPmLockHeld) {
+        bPmLockHeld = TRUE;
+        xPmAwakeStart = xPmWakeStamp = esp_timer_get_time();
+        xPmStats.wakeups++;
+        bAcquire = TRUE;
+    }
+    portEXIT_CRITICAL(&xMbPmMux);
+    if (bAcquire) {
+        (void)esp_pm_lock_acquire(xMbPmLock);
+        (void)esp_pm_lock_acquire(xMbPmCpuLock);
+    }
+    (void)esp_timer_stop(xMbPmHoldTimer);
+    (void)esp_timer_start_once(xMbPmHoldTimer, (uint64_t)CONFIG_FMB_SERIAL_PM_HOLD_MS * 1000);
+}
+
+// Account the time from the wakeup to the first response sent after it
+static void vMBPortSerialPmFrameSent(void)
+{
+    int64_t xNow = esp_timer_get_time();
+    portENTER_CRITICAL(&xMbPmMux);
+    if (xPmWakeStamp != 0) {
+        uint32_t ulLatency = (uint32_t)(xNow - xPmWakeStamp);
+        xPmStats.responses++;
+        xPmStats.wake_to_tx_last_us = ulLatency;
+        xPmStats.wake_to_tx_total_us += ulLatency;
+        if (ulLatency > xPmStats.wake_to_tx_max_us) {
+            xPmStats.wake_to_tx_max_us = ulLatency;
+        }
+        xPmWakeStamp = 0;
+    }
+    portEXIT_CRITICAL(&xMbPmMux);
+}
+
+static BOOL xMBPortSerialPmInit(void)
+{
+    esp_err_t xErr = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "mb_serial", &xMbPmLock);
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial PM failure, esp_pm_lock_create() returned (0x%x).", (int)xErr);
+    xErr = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "mb_serial_cpu", &xMbPmCpuLock);
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial PM failure, esp_pm_lock_create() returned (0x%x).", (int)xErr);
+    esp_timer_create_args_t xTimerConf = {
+        .callback = vMBPortSerialPmRelease,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "mb_pm_hold",
+        .skip_unhandled_events = true
+    };
+    xErr = esp_timer_create(&xTimerConf, &xMbPmHoldTimer);
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial PM failure, esp_timer_create() returned (0x%x).", (int)xErr);
+    xErr = uart_set_wakeup_threshold(ucUartNumber, CONFIG_FMB_SERIAL_PM_WAKEUP_THRESHOLD);
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial PM failure, uart_set_wakeup_threshold() returned (0x%x).", (int)xErr);
+    xErr = esp_sleep_enable_uart_wakeup(ucUartNumber);
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial PM failure, esp_sleep_enable_uart_wakeup() returned (0x%x).", (int)xErr);
+    memset(&xPmStats, 0, sizeof(xPmStats));
+    bPmLockHeld = FALSE;
+    // Stay awake for the first request after start
+    vMBPortSerialPmActivity();
+    return TRUE;
+}
+
+static void vMBPortSerialPmClose(void)
+{
+    if (xMbPmHoldTimer != NULL) {
+        (void)esp_timer_stop(xMbPmHoldTimer);
+        (void)esp_timer_delete(xMbPmHoldTimer);
+        xMbPmHoldTimer = NULL;
+    }
+    vMBPortSerialPmRelease(NULL);
+    if (xMbPmCpuLock != NULL) {
+        (void)esp_pm_lock_delete(xMbPmCpuLock);
+        xMbPmCpuLock = NULL;
+    }
+    if (xMbPmLock != NULL) {
+        (void)esp_pm_lock_delete(xMbPmLock);
+        xMbPmLock = NULL;
+    }
+}
+
+void mb_port_pm_get(mb_serial_pm_stats_t* pxStats)
+{
+    int64_t xNow = esp_timer_get_time();
+    portENTER_CRITICAL(&xMbPmMux);
+    *pxStats = xPmStats;
+    if (bPmLockHeld) {
+        pxStats->awake_us += (uint64_t)(xNow - xPmAwakeStart);
+    }
+    pxStats->lock_held = bPmLockHeld;
+    portEXIT_CRITICAL(&xMbPmMux);
+    pxStats->uptime_us = (uint64_t)xNow;
+}
+#endif
+
+#if MB_SLAVE_BENCHMARK_ENABLED
+// Synthetic receive buffer of the hot path benchmark, used instead of the UART if set
+static const UCHAR* pucBenchSource = NULL;
+static USHORT usBenchSourceLen = 0;
+
+void vMBPortSerialSetBenchSource(const UCHAR* pucData, USHORT usLength)
+{
+    pucBenchSource = pucData;
+    usBenchSourceLen = (pucData != NULL) ? usLength : 0;
+}
+#endif
 
 void vMBPortSerialEnable(BOOL bRxEnable, BOOL bTxEnable)
 {
@@ -86,6 +279,20 @@ static USHORT usMBPortSerialRxPoll(size_t xEventSize)
     USHORT usCnt = 0;
 
     if (bRxStateEnabled) {
+#if MB_SLAVE_BUS_ANALYZER_ENABLED
+        // The line has been idle for the TOUT (T3.5) time since the last character
+        // Read by the analyzer in the Modbus task, the 64 bit value is accessed atomically
+        __atomic_store_n(&xRxFrameEnd, esp_timer_get_time() - ((int64_t)ucMBPortSerialGetTout(ulUartBaudRate)
+                                                * MB_SERIAL_SYMB_BITS * 1000000) / ulUartBaudRate, __ATOMIC_RELAXED);
+#endif
+#if MB_SERIAL_RX_BLOCK_ENABLED
+        // The frame is delimited by UART TOUT, give it to the stack at once if possible
+        if ((pxMBFrameCBBlockReceived != NULL) && pxMBFrameCBBlockReceived((USHORT)xEventSize)) {
+            uart_flush_input(ucUartNumber);
+            ESP_LOGD(TAG, "RX block: %u bytes\n", (unsigned)xEventSize);
+            return (USHORT)xEventSize;
+        }
+#endif
         // Get received packet into Rx buffer
         while(xReadStatus && (usCnt++ <= xEventSize)) {
             // Call the Modbus stack callback function and let it fill the buffers.
@@ -101,12 +308,120 @@ static USHORT usMBPortSerialRxPoll(size_t xEventSize)
     return usCnt;
 }
 
+#if MB_SERIAL_DMA_ENABLED
+// Called from the UHCI ISR for each received chunk, the frame ends on idle line (T3.5)
+static bool IRAM_ATTR xMBPortSerialDmaRxEvent(uhci_controller_handle_t xCtrl, const uhci_rx_event_data_t* pxData, void* pvCtx)
+{
+    BaseType_t xHigherPrioTaskWoken = pdFALSE;
+    usDmaRxCount += pxData->recv_size;
+    if (pxData->flags.totally_received) {
+        USHORT usLength = usDmaRxCount;
+        usDmaRxCount = 0;
+        (void)xQueueSendFromISR(xMbDmaQueue, &usLength, &xHigherPrioTaskWoken);
+    }
+    return (xHigherPrioTaskWoken == pdTRUE);
+}
+
+static BOOL xMBPortSerialDmaReceive(void)
+{
+    esp_err_t xErr = uhci_receive(xMbUhciHandle, ucDmaRxBuf, sizeof(ucDmaRxBuf));
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial DMA receive failure, uhci_receive() returned (0x%x).", (int)xErr);
+    return TRUE;
+}
+
+// Set the idle time which ends the DMA frame, the same T3.5 as the TOUT of the FIFO mode
+static void vMBPortSerialDmaSetIdle(ULONG ulBaudRate)
+{
+    ULONG ulBits = (ULONG)ucMBPortSerialGetTout(ulBaudRate) * MB_SERIAL_SYMB_BITS;
+    UART_LL_GET_HW(ucUartNumber)->idle_conf.rx_idle_thrhd =
+                        (ulBits > MB_SERIAL_IDLE_THR_MAX) ? MB_SERIAL_IDLE_THR_MAX : ulBits;
+}
+
+// Send the frame from the stack buffer by DMA, returns when the frame is on the wire
+static int iMBPortSerialDmaWrite(UCHAR* pucFrame, USHORT usLength, TickType_t xTout)
+{
+    // The driver drives RTS (DE) in RS485 half duplex mode only for uart_write_bytes() and
+    // releases it on the TX done armed there, so the DMA frame sets and releases it here
+    (void)uart_set_rts(ucUartNumber, 0);
+    esp_err_t xErr = uhci_transmit(xMbUhciHandle, pucFrame, usLength);
+    if (xErr == ESP_OK) {
+        xErr = uhci_wait_all_tx_transaction_done(xMbUhciHandle, pdTICKS_TO_MS(xTout));
+    }
+    if (xErr == ESP_OK) {
+        // The DMA is done when the frame is in the FIFO, wait for the last stop bit
+        xErr = uart_wait_tx_done(ucUartNumber, xTout);
+    }
+    (void)uart_set_rts(ucUartNumber, 1);
+    MB_PORT_CHECK((xErr == ESP_OK), -1, "mb serial DMA send failure (0x%x).", (int)xErr);
+    return usLength;
+}
+
+static BOOL xMBPortSerialDmaInit(ULONG ulBaudRate)
+{
+    uhci_controller_config_t xUhciConfig = {
+        .uart_port = ucUartNumber,
+        .tx_trans_queue_depth = 1,
+        .max_transmit_size = MB_SERIAL_DMA_BUF_SIZE,
+        .max_receive_internal_mem = MB_SERIAL_DMA_BUF_SIZE,
+        .rx_eof_flags.idle_eof = 1,
+    };
+    uhci_event_callbacks_t xUhciCallbacks = {
+        .on_rx_trans_event = xMBPortSerialDmaRxEvent,
+    };
+#if MB_STATIC_ALLOCATION_ENABLED
+    xMbDmaQueue = xQueueCreateStatic(MB_QUEUE_LENGTH, sizeof(USHORT), ucMbDmaQueueStorage, &xMbDmaQueueBuf);
+#else
+    xMbDmaQueue = xQueueCreate(MB_QUEUE_LENGTH, sizeof(USHORT));
+#endif
+    MB_PORT_CHECK((xMbDmaQueue != NULL), FALSE, "mb serial DMA queue creation failure.");
+    // The RX FIFO is read by the DMA only
+    esp_err_t xErr = uart_disable_rx_intr(ucUartNumber);
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial disable rx interrupt failure, uart_disable_rx_intr() returned (0x%x).", (int)xErr);
+    xErr = uhci_new_controller(&xUhciConfig, &xMbUhciHandle);
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial DMA failure, uhci_new_controller() returned (0x%x).", (int)xErr);
+    xErr = uhci_register_event_callbacks(xMbUhciHandle, &xUhciCallbacks, NULL);
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial DMA failure, uhci_register_event_callbacks() returned (0x%x).", (int)xErr);
+    vMBPortSerialDmaSetIdle(ulBaudRate);
+    return xMBPortSerialDmaReceive();
+}
+#endif
+
 BOOL xMBPortSerialTxPoll(void)
 {
     USHORT usCount = 0;
     BOOL bNeedPoll = TRUE;
 
     if( bTxStateEnabled ) {
+#if MB_SERIAL_TX_BLOCK_ENABLED
+        UCHAR* pucFrame = NULL;
+        USHORT usLength = 0;
+        // Write the whole frame at once, the RS485 DE line is driven by UART in half duplex mode
+        if ((pxMBFrameCBTransmitBlock != NULL) && pxMBFrameCBTransmitBlock(&pucFrame, &usLength)) {
+            // Wait for TX done interrupt, the longest frame takes 11 bits per byte on the wire
+            TickType_t xTout = pdMS_TO_TICKS(((ULONG)usLength * 11UL * 1000UL) / ulUartBaudRate
+                                                + MB_SERIAL_TX_MARGIN_MS);
+#if MB_SERIAL_DMA_ENABLED
+            int iSent = iMBPortSerialDmaWrite(pucFrame, usLength, xTout);
+#else
+            int iSent = uart_write_bytes(ucUartNumber, pucFrame, usLength);
+#endif
+            esp_err_t xTxStatus = uart_wait_tx_done(ucUartNumber, xTout);
+            if (xTxStatus == ESP_OK) {
+                vMBPortLatencyFrameSent();
+#if MB_SERIAL_PM_ENABLED
+                vMBPortSerialPmFrameSent();
+#endif
+            }
+            vMBPortSerialEnable(TRUE, FALSE);
+            ESP_LOGD(TAG, "MB_TX_block send: (%u) bytes\n", (unsigned)usLength);
+            MB_PORT_CHECK(((iSent == usLength) && (xTxStatus == ESP_OK)), FALSE, "mb serial sent buffer failure.");
+            return TRUE;
+        }
+#endif
         // Continue while all response bytes put in buffer or out of buffer
         while((bNeedPoll) && (usCount++ < MB_SERIAL_BUF_SIZE)) {
             // Calls the modbus stack callback function to let it fill the UART transmit buffer.
@@ -115,6 +430,12 @@ BOOL xMBPortSerialTxPoll(void)
         ESP_LOGD(TAG, "MB_TX_buffer send: (%u) bytes\n", (unsigned)usCount);
         // Waits while UART sending the packet
         esp_err_t xTxStatus = uart_wait_tx_done(ucUartNumber, MB_SERIAL_TX_TOUT_TICKS);
+        if (xTxStatus == ESP_OK) {
+            vMBPortLatencyFrameSent();
+#if MB_SERIAL_PM_ENABLED
+            vMBPortSerialPmFrameSent();
+#endif
+        }
         vMBPortSerialEnable(TRUE, FALSE);
         MB_PORT_CHECK((xTxStatus == ESP_OK), FALSE, "mb serial sent buffer failure.");
         return TRUE;
@@ -122,6 +443,7 @@ BOOL xMBPortSerialTxPoll(void)
     return FALSE;
 }
 
+#if !MB_SERIAL_DMA_ENABLED
 static void vUartTask(void *pvParameters)
 {
     uart_event_t xEvent;
@@ -133,6 +455,9 @@ static void vUartTask(void *pvParameters)
                 //Event of UART receving data
                 case UART_DATA:
                     ESP_LOGD(TAG,"Data event, length: %u", (unsigned)xEvent.size);
+#if MB_SERIAL_PM_ENABLED
+                    vMBPortSerialPmActivity();
+#endif
                     // This flag set in the event means that no more
                     // data received during configured timeout and UART TOUT feature is triggered
                     if (xEvent.timeout_flag) {
@@ -146,11 +471,13 @@ static void vUartTask(void *pvParameters)
                 //Event of HW FIFO overflow detected
                 case UART_FIFO_OVF:
                     ESP_LOGD(TAG, "hw fifo overflow");
+                    vMBDiagCount(MB_DIAG_FIFO_OVERFLOWS);
                     xQueueReset(xMbUartQueue);
                     break;
                 //Event of UART ring buffer full
                 case UART_BUFFER_FULL:
                     ESP_LOGD(TAG, "ring buffer full");
+                    vMBDiagCount(MB_DIAG_BUFFER_FULL);
                     xQueueReset(xMbUartQueue);
                     uart_flush_input(ucUartNumber);
                     break;
@@ -161,12 +488,14 @@ static void vUartTask(void *pvParameters)
                 //Event of UART parity check error
                 case UART_PARITY_ERR:
                     ESP_LOGD(TAG, "uart parity error");
+                    vMBDiagCount(MB_DIAG_PARITY_ERRORS);
                     xQueueReset(xMbUartQueue);
                     uart_flush_input(ucUartNumber);
                     break;
                 //Event of UART frame error
                 case UART_FRAME_ERR:
                     ESP_LOGD(TAG, "uart frame error");
+                    vMBDiagCount(MB_DIAG_FRAME_ERRORS);
                     xQueueReset(xMbUartQueue);
                     uart_flush_input(ucUartNumber);
                     break;
@@ -178,6 +507,27 @@ static void vUartTask(void *pvParameters)
     }
     vTaskDelete(NULL);
 }
+#define MB_SERIAL_TASK_FUNC     (vUartTask)
+#else
+static void vUartDmaTask(void *pvParameters)
+{
+    USHORT usLength = 0;
+    for(;;) {
+        if (xQueueReceive(xMbDmaQueue, &usLength, portMAX_DELAY) == pdTRUE) {
+            ESP_LOGD(TAG, "MB_uart[%u] DMA frame: %u bytes", (unsigned)ucUartNumber, (unsigned)usLength);
+            // The frame is delimited by the idle line as by UART TOUT in the FIFO mode
+            pucDmaRxCur = ucDmaRxBuf;
+            usDmaRxLeft = (usLength < sizeof(ucDmaRxBuf)) ? usLength : sizeof(ucDmaRxBuf);
+            (void)usMBPortSerialRxPoll(usDmaRxLeft);
+            pucDmaRxCur = NULL;
+            usDmaRxLeft = 0;
+            (void)xMBPortSerialDmaReceive();
+        }
+    }
+    vTaskDelete(NULL);
+}
+#define MB_SERIAL_TASK_FUNC     (vUartDmaTask)
+#endif
 
 BOOL xMBPortSerialInit(UCHAR ucPORT, ULONG ulBaudRate,
                         UCHAR ucDataBits, eMBParity eParity)
@@ -185,6 +535,7 @@ BOOL xMBPortSerialInit(UCHAR ucPORT, ULONG ulBaudRate,
     esp_err_t xErr = ESP_OK;
     // Set communication port number
     ucUartNumber = ucPORT;
+    ulUartBaudRate = (ulBaudRate != 0) ? ulBaudRate : MB_BAUD_RATE_DEFAULT;
     // Configure serial communication parameters
     UCHAR ucParity = UART_PARITY_DISABLE;
     UCHAR ucData = UART_DATA_8_BITS;
@@ -226,7 +577,10 @@ BOOL xMBPortSerialInit(UCHAR ucPORT, ULONG ulBaudRate,
         .stop_bits = UART_STOP_BITS_1,
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
         .rx_flow_ctrl_thresh = 2,
-#if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0))
+#if MB_SERIAL_PM_ENABLED
+        // The baud rate does not depend on the APB frequency changed by power management
+        .source_clk = UART_SCLK_XTAL,
+#elif (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0))
         .source_clk = UART_SCLK_DEFAULT,
 #else
         .source_clk = UART_SCLK_APB,
@@ -236,26 +590,47 @@ BOOL xMBPortSerialInit(UCHAR ucPORT, ULONG ulBaudRate,
     xErr = uart_param_config(ucUartNumber, &xUartConfig);
     MB_PORT_CHECK((xErr == ESP_OK),
             FALSE, "mb config failure, uart_param_config() returned (0x%x).", (int)xErr);
+#if MB_SERIAL_DMA_ENABLED
+    // Install UART driver without event queue, it only configures the port and transmits ASCII frames
+    xErr = uart_driver_install(ucUartNumber, MB_SERIAL_BUF_SIZE, MB_SERIAL_BUF_SIZE,
+                                    0, NULL, MB_PORT_SERIAL_ISR_FLAG);
+#else
     // Install UART driver, and get the queue.
     xErr = uart_driver_install(ucUartNumber, MB_SERIAL_BUF_SIZE, MB_SERIAL_BUF_SIZE,
                                     MB_QUEUE_LENGTH, &xMbUartQueue, MB_PORT_SERIAL_ISR_FLAG);
+#endif
     MB_PORT_CHECK((xErr == ESP_OK), FALSE,
             "mb serial driver failure, uart_driver_install() returned (0x%x).", (int)xErr);
 #if !CONFIG_FMB_TIMER_PORT_ENABLED
-    // Set timeout for TOUT interrupt (T3.5 modbus time)
-    xErr = uart_set_rx_timeout(ucUartNumber, MB_SERIAL_TOUT);
+    // Set timeout for TOUT interrupt (T3.5 modbus time) depending on baud rate
+    xErr = uart_set_rx_timeout(ucUartNumber, ucMBPortSerialGetTout(ulBaudRate));
     MB_PORT_CHECK((xErr == ESP_OK), FALSE,
             "mb serial set rx timeout failure, uart_set_rx_timeout() returned (0x%x).", (int)xErr);
 #endif
 
     // Set always timeout flag to trigger timeout interrupt even after rx fifo full
     uart_set_always_rx_timeout(ucUartNumber, true);
+#if MB_SERIAL_DMA_ENABLED
+    MB_PORT_CHECK(xMBPortSerialDmaInit(ulUartBaudRate), FALSE, "mb serial DMA initialization failure.");
+#endif
+#if MB_SERIAL_PM_ENABLED
+    MB_PORT_CHECK(xMBPortSerialPmInit(), FALSE, "mb serial power management initialization failure.");
+#endif
 
     // Create a task to handle UART events
-    BaseType_t xStatus = xTaskCreatePinnedToCore(vUartTask, "uart_queue_task",
+#if MB_STATIC_ALLOCATION_ENABLED
+    xMbTaskHandle = xTaskCreateStaticPinnedToCore(MB_SERIAL_TASK_FUNC, "uart_queue_task",
+                                                    MB_SERIAL_TASK_STACK_SIZE,
+                                                    NULL, MB_SERIAL_TASK_PRIO,
+                                                    xMbTaskStack, &xMbTaskBuf,
+                                                    MB_PORT_TASK_AFFINITY);
+    BaseType_t xStatus = (xMbTaskHandle != NULL) ? pdPASS : pdFAIL;
+#else
+    BaseType_t xStatus = xTaskCreatePinnedToCore(MB_SERIAL_TASK_FUNC, "uart_queue_task",
                                                     MB_SERIAL_TASK_STACK_SIZE,
                                                     NULL, MB_SERIAL_TASK_PRIO,
                                                     &xMbTaskHandle, MB_PORT_TASK_AFFINITY);
+#endif
     if (xStatus != pdPASS) {
         vTaskDelete(xMbTaskHandle);
         // Force exit from function with failure
@@ -268,10 +643,59 @@ BOOL xMBPortSerialInit(UCHAR ucPORT, ULONG ulBaudRate,
     return TRUE;
 }
 
+// Change baud rate and parity of the running port, the data in RX buffer is dropped
+BOOL xMBPortSerialSetConfig(ULONG ulBaudRate, eMBParity eParity)
+{
+    esp_err_t xErr = ESP_OK;
+    uart_parity_t xParity = UART_PARITY_DISABLE;
+    switch(eParity){
+        case MB_PAR_NONE:
+            xParity = UART_PARITY_DISABLE;
+            break;
+        case MB_PAR_ODD:
+            xParity = UART_PARITY_ODD;
+            break;
+        case MB_PAR_EVEN:
+            xParity = UART_PARITY_EVEN;
+            break;
+        default:
+            ESP_LOGE(TAG, "Incorrect parity option: %u", (unsigned)eParity);
+            return FALSE;
+    }
+    MB_PORT_CHECK((ulBaudRate != 0), FALSE, "mb incorrect baud rate.");
+    xErr = uart_set_baudrate(ucUartNumber, ulBaudRate);
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial set baud rate failure, uart_set_baudrate() returned (0x%x).", (int)xErr);
+    xErr = uart_set_parity(ucUartNumber, xParity);
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial set parity failure, uart_set_parity() returned (0x%x).", (int)xErr);
+#if !CONFIG_FMB_TIMER_PORT_ENABLED
+    xErr = uart_set_rx_timeout(ucUartNumber, ucMBPortSerialGetTout(ulBaudRate));
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial set rx timeout failure, uart_set_rx_timeout() returned (0x%x).", (int)xErr);
+#endif
+    ulUartBaudRate = ulBaudRate;
+#if MB_SERIAL_DMA_ENABLED
+    vMBPortSerialDmaSetIdle(ulBaudRate);
+#endif
+    // The characters received with the previous settings are garbage
+    uart_flush_input(ucUartNumber);
+    return TRUE;
+}
+
 void vMBPortSerialClose(void)
 {
     (void)vTaskSuspend(xMbTaskHandle);
     (void)vTaskDelete(xMbTaskHandle);
+#if MB_SERIAL_DMA_ENABLED
+    ESP_ERROR_CHECK(uhci_del_controller(xMbUhciHandle));
+    xMbUhciHandle = NULL;
+    vQueueDelete(xMbDmaQueue);
+    xMbDmaQueue = NULL;
+#endif
+#if MB_SERIAL_PM_ENABLED
+    vMBPortSerialPmClose();
+#endif
     ESP_ERROR_CHECK(uart_driver_delete(ucUartNumber));
 }
 
@@ -283,10 +707,69 @@ BOOL xMBPortSerialPutByte(CHAR ucByte)
     return (ucLength == 1);
 }
 
+// Get the buffered frame from intermediate RX buffer at once
+USHORT usMBPortSerialGetBlock(UCHAR* pucBuf, USHORT usLength)
+{
+    assert(pucBuf != NULL);
+#if MB_SLAVE_BENCHMARK_ENABLED
+    if (pucBenchSource != NULL) {
+        usLength = (usLength < usBenchSourceLen) ? usLength : usBenchSourceLen;
+        memcpy(pucBuf, pucBenchSource, usLength);
+        pucBenchSource += usLength;
+        usBenchSourceLen -= usLength;
+        return usLength;
+    }
+#endif
+#if MB_SERIAL_DMA_ENABLED
+    if (pucDmaRxCur != NULL) {
+        usLength = (usLength < usDmaRxLeft) ? usLength : usDmaRxLeft;
+        memcpy(pucBuf, pucDmaRxCur, usLength);
+        pucDmaRxCur += usLength;
+        usDmaRxLeft -= usLength;
+        return usLength;
+    }
+#endif
+    int iLength = uart_read_bytes(ucUartNumber, pucBuf, usLength, 0);
+    return (iLength > 0) ? (USHORT)iLength : 0;
+}
+
 // Get one byte from intermediate RX buffer
 BOOL xMBPortSerialGetByte(CHAR* pucByte)
 {
     assert(pucByte != NULL);
+#if MB_SLAVE_BENCHMARK_ENABLED
+    if (pucBenchSource != NULL) {
+        if (usBenchSourceLen == 0) {
+            return FALSE;
+        }
+        *pucByte = (CHAR)*pucBenchSource++;
+        usBenchSourceLen--;
+        return TRUE;
+    }
+#endif
+#if MB_SERIAL_DMA_ENABLED
+    if (pucDmaRxCur != NULL) {
+        if (usDmaRxLeft == 0) {
+            return FALSE;
+        }
+        *pucByte = (CHAR)*pucDmaRxCur++;
+        usDmaRxLeft--;
+        return TRUE;
+    }
+#endif
     USHORT usLength = uart_read_bytes(ucUartNumber, (uint8_t*)pucByte, 1, MB_SERIAL_RX_TOUT_TICKS);
     return (usLength == 1);
 }
+
+#if MB_SLAVE_BUS_ANALYZER_ENABLED
+int64_t xMBPortSerialRxFrameEnd(void)
+{
+    return __atomic_load_n(&xRxFrameEnd, __ATOMIC_RELAXED);
+}
+
+// Wire time of one RTU character at the current baud rate
+ULONG ulMBPortSerialCharNs(void)
+{
+    return (ULONG)(((uint64_t)MB_SERIAL_SYMB_BITS * 1000000000ULL) / ulUartBaudRate);
+}
+#endif
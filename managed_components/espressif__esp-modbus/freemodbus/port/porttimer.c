@@ -34,6 +34,9 @@
  *
  * File: $Id: portother.c,v 1.1 2010/06/06 13:07:20 wolti Exp $
  */
+/* ----------------------- System includes ----------------------------------*/
+#include <string.h>
+
 /* ----------------------- Platform includes --------------------------------*/
 #include "port.h"
 
@@ -47,6 +50,9 @@
 static const char *TAG = "MBS_TIMER";
 
 static xTimerContext_t* pxTimerContext = NULL;
+#if MB_STATIC_ALLOCATION_ENABLED
+static xTimerContext_t xTimerContextBuf;
+#endif
 
 /* ----------------------- Start implementation -----------------------------*/
 static void IRAM_ATTR vTimerAlarmCBHandler(void *param)
@@ -64,10 +70,15 @@ BOOL xMBPortTimersInit(USHORT usTimeOut50us)
             "Modbus timeout discreet is incorrect.");
     MB_PORT_CHECK(!pxTimerContext, FALSE,
                 "Modbus timer is already created.");
+#if MB_STATIC_ALLOCATION_ENABLED
+    memset(&xTimerContextBuf, 0, sizeof(xTimerContextBuf));
+    pxTimerContext = &xTimerContextBuf;
+#else
     pxTimerContext = calloc(1, sizeof(xTimerContext_t));
     if (!pxTimerContext) {
         return FALSE;
     }
+#endif
     pxTimerContext->xTimerIntHandle = NULL;
     // Save timer reload value for Modbus T35 period
     pxTimerContext->usT35Ticks = usTimeOut50us;
@@ -90,6 +101,16 @@ BOOL xMBPortTimersInit(USHORT usTimeOut50us)
     return TRUE;
 }
 
+void vMBPortTimersSetTimeout(USHORT usTimeOut50us)
+{
+#if CONFIG_FMB_TIMER_PORT_ENABLED
+    MB_PORT_CHECK((pxTimerContext && (usTimeOut50us > 0)), ; ,
+                                "timer is not initialized.");
+    // The new reload value is used when the timer is enabled next time
+    pxTimerContext->usT35Ticks = usTimeOut50us;
+#endif
+}
+
 void vMBPortTimersEnable(void)
 {
 #if CONFIG_FMB_TIMER_PORT_ENABLED
@@ -120,7 +141,9 @@ void vMBPortTimerClose(void)
             esp_timer_stop(pxTimerContext->xTimerIntHandle);
             esp_timer_delete(pxTimerContext->xTimerIntHandle);
         }
+#if !MB_STATIC_ALLOCATION_ENABLED
         free(pxTimerContext);
+#endif
         pxTimerContext = NULL;
     }
 #endif
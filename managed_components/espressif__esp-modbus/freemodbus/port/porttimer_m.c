@@ -122,7 +122,12 @@ void vMBMasterPortTimersConvertDelayEnable(void)
 
 void vMBMasterPortTimersRespondTimeoutEnable(void)
 {
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+    // Timeout of the destination slave learned from its response times
+    uint64_t xToutUs = xMBMasterPortHealthRequestStart(ucMBMasterGetDestAddress());
+#else
     uint64_t xToutUs = (MB_MASTER_TIMEOUT_MS_RESPOND * 1000);
+#endif
 
     vMBMasterSetCurTimerMode(MB_TMODE_RESPOND_TIMEOUT);
     ESP_LOGD(MB_PORT_TAG,"%s Respond enable timeout.", __func__);
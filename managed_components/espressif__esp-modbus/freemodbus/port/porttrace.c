@@ -0,0 +1,153 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <string.h>
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "port.h"
+#include "esp_timer.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mbc_slave.h"
+
+#if MB_FRAME_TRACE_ENABLED
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_TRACE_RING_SIZE          ( CONFIG_FMB_FRAME_TRACE_RING_SIZE )
+#define MB_TRACE_CAPTURE            ( CONFIG_FMB_FRAME_TRACE_BYTES )
+
+/* ----------------------- Type definitions ---------------------------------*/
+/* The slot is written by the transport tasks of the serial and TCP slaves without locking.
+ * ulSeq is 0 while the slot is written and the record sequence number once it is complete,
+ * the reader copies the slot and drops the copy if ulSeq has changed meanwhile.
+ */
+typedef struct
+{
+    ULONG           ulSeq;
+    int64_t         xTimestamp;
+    USHORT          usLength;
+    UCHAR           ucFlags;
+    UCHAR           ucCaptured;
+    UCHAR           ucData[MB_TRACE_CAPTURE];
+} xMBTraceSlot;
+
+/* ----------------------- Variables ----------------------------------------*/
+static xMBTraceSlot xTraceRing[MB_TRACE_RING_SIZE];
+static ULONG    ulTraceHead = 0;        /* Sequence number of the last reserved slot */
+static BOOL     xTraceEnabled = TRUE;
+
+/* ----------------------- Start implementation -----------------------------*/
+void
+vMBPortTraceFrame( UCHAR ucFlags, const UCHAR * pucFrame, USHORT usLength )
+{
+    if( !__atomic_load_n( &xTraceEnabled, __ATOMIC_RELAXED ) || ( pucFrame == NULL ) )
+    {
+        return;
+    }
+    ULONG           ulSeq = __atomic_add_fetch( &ulTraceHead, 1, __ATOMIC_RELAXED );
+    xMBTraceSlot   *pxSlot = &xTraceRing[( ulSeq - 1 ) % MB_TRACE_RING_SIZE];
+    UCHAR           ucCaptured = ( UCHAR )( ( usLength < MB_TRACE_CAPTURE ) ? usLength : MB_TRACE_CAPTURE );
+
+    __atomic_store_n( &pxSlot->ulSeq, 0, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    pxSlot->xTimestamp = esp_timer_get_time( );
+    pxSlot->usLength = usLength;
+    pxSlot->ucFlags = ucFlags;
+    pxSlot->ucCaptured = ucCaptured;
+    memcpy( pxSlot->ucData, pucFrame, ucCaptured );
+    __atomic_store_n( &pxSlot->ulSeq, ulSeq, __ATOMIC_RELEASE );
+}
+
+size_t
+mb_port_trace_get( uint32_t ulSinceSeq, mb_frame_record_t *pxRecords, size_t xMaxCount, uint32_t *pulLastSeq )
+{
+    ULONG           ulHead = __atomic_load_n( &ulTraceHead, __ATOMIC_ACQUIRE );
+    ULONG           ulSeq;
+    size_t          xCount = 0;
+
+    if( ulSinceSeq > ulHead )
+    {
+        /* The caller has seen the records before a restart. */
+        ulSinceSeq = 0;
+    }
+    ulSeq = ulSinceSeq + 1;
+    if( ( ulHead - ulSinceSeq ) > MB_TRACE_RING_SIZE )
+    {
+        /* The older records are overwritten, start with the oldest one in the ring. */
+        ulSeq = ulHead - MB_TRACE_RING_SIZE + 1;
+    }
+    *pulLastSeq = ulSeq - 1;
+
+    for( ; ( ulSeq <= ulHead ) && ( xCount < xMaxCount ); ulSeq++ )
+    {
+        xMBTraceSlot   *pxSlot = &xTraceRing[( ulSeq - 1 ) % MB_TRACE_RING_SIZE];
+        mb_frame_record_t *pxRecord = &pxRecords[xCount];
+
+        ULONG           ulSlotSeq = __atomic_load_n( &pxSlot->ulSeq, __ATOMIC_ACQUIRE );
+
+        if( ulSlotSeq != ulSeq )
+        {
+            if( ( ulSlotSeq == 0 ) || ( ulSlotSeq < ulSeq ) )
+            {
+                /* Not complete yet, the next call continues with it. */
+                break;
+            }
+            /* Overwritten by a newer record. */
+            *pulLastSeq = ulSeq;
+            continue;
+        }
+        pxRecord->timestamp_us = pxSlot->xTimestamp;
+        pxRecord->length = pxSlot->usLength;
+        pxRecord->flags = pxSlot->ucFlags;
+        pxRecord->captured = pxSlot->ucCaptured;
+        memcpy( pxRecord->data, pxSlot->ucData, MB_TRACE_CAPTURE );
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+        *pulLastSeq = ulSeq;
+        if( __atomic_load_n( &pxSlot->ulSeq, __ATOMIC_RELAXED ) != ulSeq )
+        {
+            continue;
+        }
+        pxRecord->seq = ulSeq;
+        xCount++;
+    }
+    return xCount;
+}
+
+bool
+mb_port_trace_get_slot( uint16_t usSlot, mb_frame_record_t *pxRecord )
+{
+    xMBTraceSlot   *pxSlot = &xTraceRing[usSlot];
+    ULONG           ulSeq = __atomic_load_n( &pxSlot->ulSeq, __ATOMIC_ACQUIRE );
+
+    if( ulSeq == 0 )
+    {
+        /* Never used or being written. */
+        return false;
+    }
+    pxRecord->timestamp_us = pxSlot->xTimestamp;
+    pxRecord->length = pxSlot->usLength;
+    pxRecord->flags = pxSlot->ucFlags;
+    pxRecord->captured = pxSlot->ucCaptured;
+    memcpy( pxRecord->data, pxSlot->ucData, MB_TRACE_CAPTURE );
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    if( __atomic_load_n( &pxSlot->ulSeq, __ATOMIC_RELAXED ) != ulSeq )
+    {
+        return false;
+    }
+    pxRecord->seq = ulSeq;
+    return true;
+}
+
+void
+mb_port_trace_enable( bool bEnable )
+{
+    __atomic_store_n( &xTraceEnabled, bEnable ? TRUE : FALSE, __ATOMIC_RELAXED );
+}
+
+#endif
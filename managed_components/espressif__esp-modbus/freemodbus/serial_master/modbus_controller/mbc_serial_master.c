@@ -179,6 +179,14 @@ static esp_err_t mbc_serial_master_send_request(mb_param_request_t* request, voi
     eMBMasterReqErrCode mb_error = MB_MRE_MASTER_BUSY;
     esp_err_t error = ESP_FAIL;
 
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+    // Fail fast while the slave is quarantined, the bus is not blocked by the dead slave
+    if (!xMBMasterPortHealthAllowed(request->slave_addr)) {
+        ESP_LOGD(TAG, "Slave %u is quarantined.", (unsigned)request->slave_addr);
+        return ESP_ERR_TIMEOUT;
+    }
+#endif
+
     if (xSemaphoreTake(mbm_opts->mbm_sema, MB_SERIAL_API_RESP_TICS) == pdTRUE) {
         uint8_t mb_slave_addr = request->slave_addr;
         uint8_t mb_command = request->command;
@@ -269,6 +277,10 @@ static esp_err_t mbc_serial_master_send_request(mb_param_request_t* request, voi
             error = ESP_ERR_INVALID_STATE; // Master is busy (previous request is pending)
             break;
 
+        case MB_MRE_ILL_ARG:
+            error = ESP_ERR_INVALID_ARG; // The request does not fit the frame
+            break;
+
         default:
             ESP_LOGE(TAG, "%s: Incorrect return code (0x%x) ", __FUNCTION__, (int)mb_error);
             error = ESP_FAIL;
@@ -733,6 +745,7 @@ esp_err_t mbc_serial_master_create(void** handler)
     mbm_interface_ptr->get_cid_info = mbc_serial_master_get_cid_info;
     mbm_interface_ptr->get_parameter = mbc_serial_master_get_parameter;
     mbm_interface_ptr->send_request = mbc_serial_master_send_request;
+    mbm_interface_ptr->send_requests = NULL;
     mbm_interface_ptr->set_descriptor = mbc_serial_master_set_descriptor;
     mbm_interface_ptr->set_parameter = mbc_serial_master_set_parameter;
 
@@ -16,9 +16,27 @@
 #include "mbc_slave.h"              // for private slave interface types
 #include "mbc_serial_slave.h"       // for serial slave implementation definitions
 #include "port_serial_slave.h"
+#if CONFIG_FMB_CRC16_BENCHMARK
+#include "mbcrc.h"                  // for CRC16 engine benchmark
+#endif
+#if CONFIG_FMB_BITCOPY_BENCHMARK
+#include "mbutils.h"                // for bitfield copy benchmark
+#endif
+#if CONFIG_FMB_SLAVE_HOTPATH_BENCHMARK
+#include "mbport.h"                 // for hot path benchmark
+#endif
 
 // Shared pointer to interface structure
 static mb_slave_interface_t* mbs_interface_ptr = NULL;
+#if CONFIG_FMB_STATIC_ALLOCATION
+// The controller objects are kept over a destroy, the next create reuses them
+static mb_slave_interface_t mbs_interface_buf;
+static StaticEventGroup_t mbs_event_group_buf;
+static StaticQueue_t mbs_notification_queue_buf;
+static uint8_t mbs_notification_queue_storage[MB_CONTROLLER_NOTIFY_QUEUE_SIZE * sizeof(mb_param_info_t)];
+static StaticTask_t mbs_task_buf;
+static StackType_t mbs_task_stack[MB_CONTROLLER_STACK_SIZE / sizeof(StackType_t)];
+#endif
 static const char *TAG = "MB_CONTROLLER_SLAVE";
 
 // Modbus task function
@@ -68,6 +86,18 @@ static esp_err_t mbc_serial_slave_setup(void* comm_info)
     MB_SLAVE_CHECK((comm_settings->parity <= UART_PARITY_ODD), ESP_ERR_INVALID_ARG,
                     "mb wrong parity option = (%u).", (unsigned)comm_settings->parity);
 
+    // Apply the new settings to the running stack without its restart
+    EventBits_t bits = xEventGroupGetBits(mbs_opts->mbs_event_group);
+    if (bits & MB_EVENT_STACK_STARTED) {
+        MB_SLAVE_CHECK(((comm_settings->mode == mbs_opts->mbs_comm.mode)
+                        && (comm_settings->port == mbs_opts->mbs_comm.port)),
+                        ESP_ERR_INVALID_STATE, "mb mode or port can not be changed while the stack is running.");
+        eMBErrorCode status = eMBSetConfig((UCHAR)comm_settings->slave_addr,
+                                            (ULONG)comm_settings->baudrate,
+                                            MB_PORT_PARITY_GET(comm_settings->parity));
+        MB_SLAVE_CHECK((status == MB_ENOERR), ESP_ERR_INVALID_STATE,
+                        "mb stack reconfiguration failure, eMBSetConfig() returns (0x%x).", (int)status);
+    }
     // Set communication options of the controller
     mbs_opts->mbs_comm = *(mb_communication_info_t*)comm_settings;
     return ESP_OK;
@@ -83,6 +113,12 @@ static esp_err_t mbc_serial_slave_start(void)
     eMBErrorCode status = MB_EIO;
     const mb_communication_info_t* comm_info = (mb_communication_info_t*)&mbs_opts->mbs_comm;
 
+#if CONFIG_FMB_CRC16_BENCHMARK
+    vMBCRC16Benchmark();
+#endif
+#if CONFIG_FMB_BITCOPY_BENCHMARK
+    vMBUtilCopyBitsBenchmark();
+#endif
     // Initialize Modbus stack using mbcontroller parameters
     status = eMBInit((eMBMode)comm_info->mode,
                          (UCHAR)comm_info->slave_addr,
@@ -92,6 +128,10 @@ static esp_err_t mbc_serial_slave_start(void)
 
     MB_SLAVE_CHECK((status == MB_ENOERR), ESP_ERR_INVALID_STATE,
                     "mb stack initialization failure, eMBInit() returns (0x%x).", (int)status);
+#if CONFIG_FMB_SLAVE_HOTPATH_BENCHMARK
+    // The stack is initialized but not enabled, the benchmark does not use the UART
+    vMBPortBenchmark();
+#endif
     status = eMBEnable();
     MB_SLAVE_CHECK((status == MB_ENOERR), ESP_ERR_INVALID_STATE,
                     "mb stack set slave ID failure, eMBEnable() returned (0x%x).", (int)status);
@@ -128,7 +168,7 @@ static esp_err_t mbc_serial_slave_get_param_info(mb_param_info_t* reg_info, uint
                 ESP_ERR_INVALID_ARG, "mb queue handle is invalid.");
     MB_SLAVE_CHECK((reg_info != NULL), ESP_ERR_INVALID_ARG, "mb register information is invalid.");
     BaseType_t status = xQueueReceive(mbs_opts->mbs_notification_queue_handle,
-                                        reg_info, pdMS_TO_TICKS(timeout));
+                                        reg_info, MB_PAR_INFO_TO_TICKS(timeout));
     if (status == pdTRUE) {
         err = ESP_OK;
     }
@@ -173,7 +213,11 @@ esp_err_t mbc_serial_slave_create(void** handler)
 {
     // Allocate space for options
     if (mbs_interface_ptr == NULL) {
+#if CONFIG_FMB_STATIC_ALLOCATION
+        mbs_interface_ptr = &mbs_interface_buf;
+#else
         mbs_interface_ptr = malloc(sizeof(mb_slave_interface_t));
+#endif
     }
     MB_SLAVE_ASSERT(mbs_interface_ptr != NULL);
 
@@ -192,16 +236,39 @@ esp_err_t mbc_serial_slave_create(void** handler)
     // Initialization of active context of the Modbus controller
     BaseType_t status = 0;
     // Parameter change notification queue
+#if CONFIG_FMB_STATIC_ALLOCATION
+    mbs_opts->mbs_event_group = xEventGroupCreateStatic(&mbs_event_group_buf);
+#else
     mbs_opts->mbs_event_group = xEventGroupCreate();
+#endif
     MB_SLAVE_CHECK((mbs_opts->mbs_event_group != NULL),
             ESP_ERR_NO_MEM, "mb event group error.");
     // Parameter change notification queue
+#if CONFIG_FMB_STATIC_ALLOCATION
+    mbs_opts->mbs_notification_queue_handle = xQueueCreateStatic(
+                                                MB_CONTROLLER_NOTIFY_QUEUE_SIZE,
+                                                sizeof(mb_param_info_t),
+                                                mbs_notification_queue_storage,
+                                                &mbs_notification_queue_buf);
+#else
     mbs_opts->mbs_notification_queue_handle = xQueueCreate(
                                                 MB_CONTROLLER_NOTIFY_QUEUE_SIZE,
                                                 sizeof(mb_param_info_t));
+#endif
     MB_SLAVE_CHECK((mbs_opts->mbs_notification_queue_handle != NULL),
                         ESP_ERR_NO_MEM, "mb notify queue creation error.");
     // Create Modbus controller task
+#if CONFIG_FMB_STATIC_ALLOCATION
+    mbs_opts->mbs_task_handle = xTaskCreateStaticPinnedToCore((void*)&modbus_slave_task,
+                            "modbus_slave_task",
+                            MB_CONTROLLER_STACK_SIZE,
+                            NULL,
+                            MB_CONTROLLER_PRIORITY,
+                            mbs_task_stack,
+                            &mbs_task_buf,
+                            MB_PORT_TASK_AFFINITY);
+    status = (mbs_opts->mbs_task_handle != NULL) ? pdPASS : pdFAIL;
+#else
     status = xTaskCreatePinnedToCore((void*)&modbus_slave_task,
                             "modbus_slave_task",
                             MB_CONTROLLER_STACK_SIZE,
@@ -209,6 +276,7 @@ esp_err_t mbc_serial_slave_create(void** handler)
                             MB_CONTROLLER_PRIORITY,
                             &mbs_opts->mbs_task_handle,
                             MB_PORT_TASK_AFFINITY);
+#endif
     if (status != pdPASS) {
         vTaskDelete(mbs_opts->mbs_task_handle);
         MB_SLAVE_CHECK((status == pdPASS), ESP_ERR_NO_MEM,
@@ -0,0 +1,263 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <stdio.h>
+#include <string.h>
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "mbframe.h"
+#include "mbrtu.h"
+#include "mbcrc.h"
+#include "port_rtu_slave.h"
+
+#if MB_SLAVE_RTU_PORTS_MAX > 0
+
+/* ----------------------- Defines ------------------------------------------*/
+#define MB_RTU_PORT_FRAME_MAX       ( 256 )     /* Address, the longest PDU and CRC */
+#define MB_RTU_PORT_TASK_PRIO       ( CONFIG_FMB_SLAVE_RTU_PORTS_TASK_PRIO )
+#define MB_RTU_PORT_STACK_SIZE      ( MB_SERIAL_TASK_STACK_SIZE )
+#define MB_RTU_PORT_STOP_TOUT_MS    ( 1000 )
+#define MB_RTU_PORT_EVENT_STOP      ( ( uart_event_type_t )UART_EVENT_MAX ) /* Queued by xMBRTUPortStop() */
+
+/* ----------------------- Type definitions ---------------------------------*/
+/* The instance is used by its port task only while the port is started, the control
+ * functions are called from the application task. */
+typedef struct {
+    UCHAR ucUartNumber;             /*!< UART of the port */
+    UCHAR ucSlaveAddress;           /*!< Slave address of the port */
+    QueueHandle_t xUartQueue;       /*!< Event queue of the UART driver */
+    TaskHandle_t xTaskHandle;       /*!< Port task, NULL if the instance is free */
+    TaskHandle_t xStopWaiter;       /*!< Task waiting in xMBRTUPortStop() */
+    USHORT usRcvPos;                /*!< Received bytes of the current frame */
+    BOOL xRcvDiscard;               /*!< The current frame has an error, drop it at the end */
+    UCHAR ucBuf[MB_RTU_PORT_FRAME_MAX]; /*!< Request frame, replaced by the response */
+    MbRTUPortStats_t xStats;        /*!< Counters of the port */
+#if MB_STATIC_ALLOCATION_ENABLED
+    StaticTask_t xTaskBuf;
+    StackType_t xTaskStack[MB_RTU_PORT_STACK_SIZE / sizeof(StackType_t)];
+#endif
+} MbRTUPort_t;
+
+/* ----------------------- Static variables ---------------------------------*/
+static const char *TAG = "MB_RTU_SLAVE_PORT";
+static MbRTUPort_t xRTUPorts[MB_SLAVE_RTU_PORTS_MAX];
+
+/* ----------------------- Static functions ---------------------------------*/
+// Append the buffered bytes to the current frame
+static void vMBRTUPortRead(MbRTUPort_t* pxPort)
+{
+    size_t xLength = 0;
+    (void)uart_get_buffered_data_len(pxPort->ucUartNumber, &xLength);
+    while (xLength > 0) {
+        USHORT usSpace = MB_RTU_PORT_FRAME_MAX - pxPort->usRcvPos;
+        if (usSpace == 0) {
+            // Too long for a Modbus frame, drop the rest
+            uart_flush_input(pxPort->ucUartNumber);
+            pxPort->xRcvDiscard = TRUE;
+            return;
+        }
+        int iRead = uart_read_bytes(pxPort->ucUartNumber, &pxPort->ucBuf[pxPort->usRcvPos],
+                                    (xLength < usSpace) ? xLength : usSpace, 0);
+        if (iRead <= 0) {
+            break;
+        }
+        pxPort->usRcvPos += (USHORT)iRead;
+        xLength -= (size_t)iRead;
+    }
+}
+
+// Execute the frame delimited by the T3.5 timeout and send the response
+static void vMBRTUPortFrame(MbRTUPort_t* pxPort)
+{
+    UCHAR* pucFrame = pxPort->ucBuf;
+    USHORT usLength = pxPort->usRcvPos;
+    BOOL xDiscard = pxPort->xRcvDiscard;
+
+    pxPort->usRcvPos = 0;
+    pxPort->xRcvDiscard = FALSE;
+    if (usLength == 0) {
+        return;
+    }
+    if (xDiscard || (usLength < MB_SER_PDU_SIZE_MIN) || (usMBCRC16(pucFrame, usLength) != 0)) {
+        pxPort->xStats.ulCRCErrors++;
+        return;
+    }
+    UCHAR ucAddress = pucFrame[MB_SER_PDU_ADDR_OFF];
+    if ((ucAddress != pxPort->ucSlaveAddress) && (ucAddress != MB_ADDRESS_BROADCAST)) {
+        pxPort->xStats.ulNotAddressed++;
+        return;
+    }
+    USHORT usPDULength = usLength - MB_SER_PDU_PDU_OFF - MB_SER_PDU_SIZE_CRC;
+    pxPort->xStats.ulRequests++;
+    if (eMBExecuteAddrPDU(pxPort->ucSlaveAddress, &pucFrame[MB_SER_PDU_PDU_OFF], &usPDULength) != MB_EX_NONE) {
+        pxPort->xStats.ulExceptions++;
+    }
+    if (ucAddress == MB_ADDRESS_BROADCAST) {
+        return;
+    }
+    // The response keeps the address of the request
+    USHORT usFrameLength = MB_SER_PDU_PDU_OFF + usPDULength;
+    USHORT usCRC16 = usMBCRC16(pucFrame, usFrameLength);
+    pucFrame[usFrameLength++] = (UCHAR)(usCRC16 & 0xFF);
+    pucFrame[usFrameLength++] = (UCHAR)(usCRC16 >> 8);
+    if (uart_write_bytes(pxPort->ucUartNumber, pucFrame, usFrameLength) != usFrameLength) {
+        pxPort->xStats.ulUartErrors++;
+    }
+}
+
+static void vMBRTUPortTask(void* pvParameters)
+{
+    MbRTUPort_t* pxPort = (MbRTUPort_t*)pvParameters;
+    uart_event_t xEvent;
+    for(;;) {
+        if (xQueueReceive(pxPort->xUartQueue, (void*)&xEvent, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        switch(xEvent.type) {
+            case UART_DATA:
+                vMBRTUPortRead(pxPort);
+                // No more data during the T3.5 timeout, the frame is complete
+                if (xEvent.timeout_flag) {
+                    vMBRTUPortFrame(pxPort);
+                }
+                break;
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                pxPort->xStats.ulUartErrors++;
+                xQueueReset(pxPort->xUartQueue);
+                uart_flush_input(pxPort->ucUartNumber);
+                pxPort->usRcvPos = 0;
+                pxPort->xRcvDiscard = FALSE;
+                break;
+            case UART_PARITY_ERR:
+            case UART_FRAME_ERR:
+                // The frame is dropped when its timeout comes
+                pxPort->xStats.ulUartErrors++;
+                pxPort->xRcvDiscard = TRUE;
+                break;
+            case MB_RTU_PORT_EVENT_STOP:
+                // Wait for the deletion outside of a request
+                xTaskNotifyGive(pxPort->xStopWaiter);
+                vTaskSuspend(NULL);
+                break;
+            default:
+                ESP_LOGD(TAG, "uart event type: %u", (unsigned)xEvent.type);
+                break;
+        }
+    }
+}
+
+/* ----------------------- Start implementation -----------------------------*/
+BOOL xMBRTUPortStart(UCHAR ucUartNumber, ULONG ulBaudRate, uart_parity_t eParity,
+                     UCHAR ucSlaveAddress, BaseType_t xCoreId, UCHAR* pucIndex)
+{
+    MbRTUPort_t* pxPort = NULL;
+    UCHAR ucIndex;
+    for (ucIndex = 0; ucIndex < MB_SLAVE_RTU_PORTS_MAX; ucIndex++) {
+        if (xRTUPorts[ucIndex].xTaskHandle == NULL) {
+            pxPort = &xRTUPorts[ucIndex];
+            break;
+        }
+    }
+    MB_PORT_CHECK((pxPort != NULL), FALSE, "no free RTU port instance.");
+    MB_PORT_CHECK((ucUartNumber < UART_NUM_MAX) && !uart_is_driver_installed(ucUartNumber), FALSE,
+                    "UART %u is not available.", (unsigned)ucUartNumber);
+    MB_PORT_CHECK((ulBaudRate != 0), FALSE, "incorrect baud rate.");
+
+    uart_config_t xUartConfig = {
+        .baud_rate = ulBaudRate,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = eParity,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = 2,
+#if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0))
+        .source_clk = UART_SCLK_DEFAULT,
+#else
+        .source_clk = UART_SCLK_APB,
+#endif
+    };
+    esp_err_t xErr = uart_param_config(ucUartNumber, &xUartConfig);
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb config failure, uart_param_config() returned (0x%x).", (int)xErr);
+    xErr = uart_driver_install(ucUartNumber, MB_SERIAL_BUF_SIZE, MB_SERIAL_BUF_SIZE,
+                                MB_QUEUE_LENGTH, &pxPort->xUartQueue, MB_PORT_SERIAL_ISR_FLAG);
+    MB_PORT_CHECK((xErr == ESP_OK), FALSE,
+            "mb serial driver failure, uart_driver_install() returned (0x%x).", (int)xErr);
+    // The frames are delimited by UART TOUT
+    (void)uart_set_rx_timeout(ucUartNumber, ucMBPortSerialGetTout(ulBaudRate));
+    (void)uart_set_always_rx_timeout(ucUartNumber, true);
+
+    pxPort->ucUartNumber = ucUartNumber;
+    pxPort->ucSlaveAddress = ucSlaveAddress;
+    pxPort->usRcvPos = 0;
+    pxPort->xRcvDiscard = FALSE;
+    memset(&pxPort->xStats, 0, sizeof(pxPort->xStats));
+
+    char cName[configMAX_TASK_NAME_LEN];
+    snprintf(cName, sizeof(cName), "mbs_rtu_port%u", (unsigned)ucIndex);
+#if MB_STATIC_ALLOCATION_ENABLED
+    pxPort->xTaskHandle = xTaskCreateStaticPinnedToCore(vMBRTUPortTask, cName, MB_RTU_PORT_STACK_SIZE,
+                                                        pxPort, MB_RTU_PORT_TASK_PRIO, pxPort->xTaskStack,
+                                                        &pxPort->xTaskBuf, xCoreId);
+#else
+    if (xTaskCreatePinnedToCore(vMBRTUPortTask, cName, MB_RTU_PORT_STACK_SIZE, pxPort,
+                                MB_RTU_PORT_TASK_PRIO, &pxPort->xTaskHandle, xCoreId) != pdPASS) {
+        pxPort->xTaskHandle = NULL;
+    }
+#endif
+    if (pxPort->xTaskHandle == NULL) {
+        uart_driver_delete(ucUartNumber);
+        pxPort->xUartQueue = NULL;
+        MB_PORT_CHECK(FALSE, FALSE, "RTU port task creation failure.");
+    }
+    ESP_LOGI(TAG, "Port %u started on UART %u, slave address %u.",
+                (unsigned)ucIndex, (unsigned)ucUartNumber, (unsigned)ucSlaveAddress);
+    *pucIndex = ucIndex;
+    return TRUE;
+}
+
+BOOL xMBRTUPortStop(UCHAR ucIndex)
+{
+    MB_PORT_CHECK(((ucIndex < MB_SLAVE_RTU_PORTS_MAX) && (xRTUPorts[ucIndex].xTaskHandle != NULL)),
+                    FALSE, "RTU port %u is not started.", (unsigned)ucIndex);
+    MbRTUPort_t* pxPort = &xRTUPorts[ucIndex];
+    uart_event_t xEvent = { .type = MB_RTU_PORT_EVENT_STOP };
+
+    // Let the task finish the request in progress, the descriptor locks must not be left taken
+    pxPort->xStopWaiter = xTaskGetCurrentTaskHandle();
+    if ((xQueueSend(pxPort->xUartQueue, &xEvent, pdMS_TO_TICKS(MB_RTU_PORT_STOP_TOUT_MS)) != pdTRUE)
+        || (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MB_RTU_PORT_STOP_TOUT_MS)) == 0)) {
+        ESP_LOGE(TAG, "Port %u task couldn't stop within timeout -> abruptly deleting the task", (unsigned)ucIndex);
+    }
+    vTaskDelete(pxPort->xTaskHandle);
+    pxPort->xTaskHandle = NULL;
+    (void)uart_driver_delete(pxPort->ucUartNumber);
+    pxPort->xUartQueue = NULL;
+    return TRUE;
+}
+
+BOOL xMBRTUPortGetStats(UCHAR ucIndex, MbRTUPortStats_t* pxStats)
+{
+    if ((ucIndex >= MB_SLAVE_RTU_PORTS_MAX) || (xRTUPorts[ucIndex].xTaskHandle == NULL)) {
+        return FALSE;
+    }
+    *pxStats = xRTUPorts[ucIndex].xStats;
+    return TRUE;
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _PORT_RTU_SLAVE_H
+#define _PORT_RTU_SLAVE_H
+
+/* ----------------------- Platform includes --------------------------------*/
+#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "port.h"
+#include "mbconfig.h"
+
+#ifdef __cplusplus
+PR_BEGIN_EXTERN_C
+#endif /* __cplusplus */
+
+#if MB_SLAVE_RTU_PORTS_MAX > 0
+
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct {
+    ULONG ulRequests;               /*!< Number of the executed requests, broadcasts included */
+    ULONG ulExceptions;             /*!< Number of the exception responses */
+    ULONG ulCRCErrors;              /*!< Number of the frames with CRC error or incomplete frames */
+    ULONG ulNotAddressed;           /*!< Number of the frames for other slaves */
+    ULONG ulUartErrors;             /*!< Number of the UART overruns, parity, framing and send errors */
+} MbRTUPortStats_t;
+
+/* ----------------------- Function prototypes ------------------------------*/
+
+/**
+ * Start an additional RTU port on its own UART, the port task executes the
+ * requests for its slave address with eMBExecuteAddrPDU()
+ *
+ * @param ucUartNumber UART of the port, must not be used by the serial slave
+ * @param ulBaudRate baud rate
+ * @param eParity UART parity
+ * @param ucSlaveAddress slave address of the port
+ * @param xCoreId core of the port task or tskNO_AFFINITY
+ * @param pucIndex index of the started port instance
+ *
+ * @return TRUE if the port is started
+ */
+BOOL xMBRTUPortStart(UCHAR ucUartNumber, ULONG ulBaudRate, uart_parity_t eParity,
+                     UCHAR ucSlaveAddress, BaseType_t xCoreId, UCHAR* pucIndex);
+
+/**
+ * Stop the port task and delete the UART driver of the port
+ *
+ * @param ucIndex index of the port instance
+ *
+ * @return TRUE if the port was started
+ */
+BOOL xMBRTUPortStop(UCHAR ucIndex);
+
+/**
+ * Get the counters of the port
+ *
+ * @param ucIndex index of the port instance
+ * @param pxStats pointer to the counters
+ *
+ * @return TRUE if the port is started
+ */
+BOOL xMBRTUPortGetStats(UCHAR ucIndex, MbRTUPortStats_t* pxStats);
+
+#endif
+
+#ifdef __cplusplus
+PR_END_EXTERN_C
+#endif /* __cplusplus */
+
+#endif
@@ -16,7 +16,9 @@
 #include "freertos/event_groups.h"  // for event groups
 #include "freertos/queue.h"         // for queue api access
 #include "freertos/semphr.h"        // for semaphore
+#include "lwip/err.h"               // for results of the port transactions
 #include "mb_m.h"                   // for modbus stack master types definition
+#include "mbframe.h"                // for PDU definitions
 #include "port.h"                   // for port callback functions and defines
 #include "mbutils.h"                // for mbutils functions definition for stack callback
 #include "sdkconfig.h"              // for KConfig values
@@ -263,6 +265,14 @@ static esp_err_t mbc_tcp_master_send_request(mb_param_request_t* request, void*
     eMBMasterReqErrCode mb_error = MB_MRE_MASTER_BUSY;
     esp_err_t error = ESP_FAIL;
 
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+    // Fail fast while the slave is quarantined, the bus is not blocked by the dead slave
+    if (!xMBMasterPortHealthAllowed(request->slave_addr)) {
+        ESP_LOGD(TAG, "Slave %u is quarantined.", (unsigned)request->slave_addr);
+        return ESP_ERR_TIMEOUT;
+    }
+#endif
+
     if (xSemaphoreTake(mbm_opts->mbm_sema, MB_TCP_API_RESP_TICS) == pdTRUE) {
         uint8_t mb_slave_addr = request->slave_addr;
         uint8_t mb_command = request->command;
@@ -350,6 +360,10 @@ static esp_err_t mbc_tcp_master_send_request(mb_param_request_t* request, void*
             error = ESP_ERR_INVALID_STATE; // Master is busy (previous request is pending)
             break;
 
+        case MB_MRE_ILL_ARG:
+            error = ESP_ERR_INVALID_ARG; // The request does not fit the frame
+            break;
+
         default:
             ESP_LOGE(TAG, "%s: Incorrect return code (0x%x) ", __FUNCTION__, (int)mb_error);
             error = ESP_FAIL;
@@ -537,6 +551,201 @@ static esp_err_t mbc_tcp_master_set_parameter(uint16_t cid, char* name, uint8_t*
     return error;
 }
 
+#if MB_MASTER_TCP_PIPELINE_ENABLED
+
+#define MB_PIPE_BITS_BYTES(bits)    (((bits) + 7) >> 3)
+#define MB_PIPE_READ_BITCNT_MAX     (0x07D0)
+#define MB_PIPE_READ_REGCNT_MAX     (0x007D)
+#define MB_PIPE_WRITE_COILCNT_MAX   (0x07B0)
+#define MB_PIPE_WRITE_REGCNT_MAX    (0x0078)
+
+// Build the request PDU of the pipelined transaction
+static esp_err_t mbc_tcp_master_build_pdu(const mb_param_request_t* request, const uint8_t* data_ptr,
+                                          MbTCPTransaction_t* trans)
+{
+    uint8_t* pdu = trans->pucPdu;
+    uint16_t size = request->reg_size;
+    uint16_t len = 5;
+
+    pdu[MB_PDU_FUNC_OFF] = request->command;
+    pdu[1] = (uint8_t)(request->reg_start >> 8);
+    pdu[2] = (uint8_t)(request->reg_start & 0xFF);
+    pdu[3] = (uint8_t)(size >> 8);
+    pdu[4] = (uint8_t)(size & 0xFF);
+    switch(request->command)
+    {
+        case MB_FUNC_READ_COILS:
+        case MB_FUNC_READ_DISCRETE_INPUTS:
+            MB_MASTER_CHECK(((size >= 1) && (size <= MB_PIPE_READ_BITCNT_MAX)),
+                            ESP_ERR_INVALID_ARG, "mb incorrect bit count %u.", (unsigned)size);
+            break;
+        case MB_FUNC_READ_HOLDING_REGISTER:
+        case MB_FUNC_READ_INPUT_REGISTER:
+            MB_MASTER_CHECK(((size >= 1) && (size <= MB_PIPE_READ_REGCNT_MAX)),
+                            ESP_ERR_INVALID_ARG, "mb incorrect register count %u.", (unsigned)size);
+            break;
+        case MB_FUNC_WRITE_SINGLE_COIL:
+        case MB_FUNC_WRITE_REGISTER:
+            // The value replaces the count field
+            pdu[3] = (uint8_t)(*(uint16_t*)data_ptr >> 8);
+            pdu[4] = (uint8_t)(*(uint16_t*)data_ptr & 0xFF);
+            break;
+        case MB_FUNC_WRITE_MULTIPLE_COILS:
+            MB_MASTER_CHECK(((size >= 1) && (size <= MB_PIPE_WRITE_COILCNT_MAX)),
+                            ESP_ERR_INVALID_ARG, "mb incorrect bit count %u.", (unsigned)size);
+            pdu[5] = (uint8_t)MB_PIPE_BITS_BYTES(size);
+            memcpy(&pdu[6], data_ptr, pdu[5]);
+            len = 6 + pdu[5];
+            break;
+        case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+            MB_MASTER_CHECK(((size >= 1) && (size <= MB_PIPE_WRITE_REGCNT_MAX)),
+                            ESP_ERR_INVALID_ARG, "mb incorrect register count %u.", (unsigned)size);
+            pdu[5] = (uint8_t)(size << 1);
+            for (uint16_t idx = 0; idx < size; idx++) {
+                _XFER_2_WR(&pdu[6 + (idx << 1)], data_ptr);
+            }
+            len = 6 + pdu[5];
+            break;
+        default:
+            ESP_LOGE(TAG, "%s: Function is not supported in pipelined request (%u) ",
+                        __FUNCTION__, (unsigned)request->command);
+            return ESP_ERR_NOT_SUPPORTED;
+    }
+    trans->usPduLen = len;
+    return ESP_OK;
+}
+
+// Check the response PDU of the pipelined transaction and get the read data
+static esp_err_t mbc_tcp_master_parse_pdu(const mb_param_request_t* request, uint8_t* data_ptr,
+                                          const MbTCPTransaction_t* trans)
+{
+    const uint8_t* pdu = trans->pucPdu;
+    uint16_t size = request->reg_size;
+    uint16_t bytes = 0;
+
+    if (pdu[MB_PDU_FUNC_OFF] != request->command) {
+        // Exception response or response to other function
+        ESP_LOGD(TAG, "Slave %u, exception response 0x%02x(0x%02x).", (unsigned)request->slave_addr,
+                    (unsigned)pdu[MB_PDU_FUNC_OFF], (unsigned)((trans->usPduLen > 1) ? pdu[1] : 0));
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    switch(request->command)
+    {
+        case MB_FUNC_READ_COILS:
+        case MB_FUNC_READ_DISCRETE_INPUTS:
+            bytes = MB_PIPE_BITS_BYTES(size);
+            if ((trans->usPduLen < (2 + bytes)) || (pdu[1] != bytes)) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            memcpy(data_ptr, &pdu[2], bytes - 1);
+            // Keep the bits of the last byte which are out of the request
+            if (size & 7) {
+                uint8_t mask = (uint8_t)((1U << (size & 7)) - 1);
+                data_ptr[bytes - 1] = (data_ptr[bytes - 1] & ~mask) | (pdu[1 + bytes] & mask);
+            } else {
+                data_ptr[bytes - 1] = pdu[1 + bytes];
+            }
+            break;
+        case MB_FUNC_READ_HOLDING_REGISTER:
+        case MB_FUNC_READ_INPUT_REGISTER: {
+            bytes = size << 1;
+            if ((trans->usPduLen < (2 + bytes)) || (pdu[1] != bytes)) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            const uint8_t* src = &pdu[2];
+            for (uint16_t idx = 0; idx < size; idx++) {
+                _XFER_2_RD(data_ptr, src);
+            }
+            break;
+        }
+        default:
+            // The write response echoes the address and count (or value)
+            if (trans->usPduLen < 5) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            break;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t mbc_tcp_master_send_requests(const mb_param_request_t* requests, void* const data_ptrs[],
+                                              esp_err_t* status, size_t count)
+{
+    MB_MASTER_ASSERT(mbm_interface_ptr != NULL);
+    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    MB_MASTER_CHECK((count <= USHRT_MAX), ESP_ERR_INVALID_ARG, "mb too many requests in batch.");
+
+    // One allocation for the transactions and their PDU buffers
+    MbTCPTransaction_t* trans = calloc(count, sizeof(MbTCPTransaction_t) + MB_PDU_SIZE_MAX);
+    MB_MASTER_CHECK((trans != NULL), ESP_ERR_NO_MEM, "mb batch allocation failure.");
+    uint8_t* pdu_buf = (uint8_t*)&trans[count];
+    esp_err_t result = ESP_OK;
+    esp_err_t error = ESP_OK;
+
+    for (size_t idx = 0; idx < count; idx++) {
+        trans[idx].ucSlaveAddr = requests[idx].slave_addr;
+        trans[idx].pucPdu = &pdu_buf[idx * MB_PDU_SIZE_MAX];
+        trans[idx].usPduSize = MB_PDU_SIZE_MAX;
+        trans[idx].xResult = ERR_ARG;
+        error = (data_ptrs[idx] != NULL) ? mbc_tcp_master_build_pdu(&requests[idx], data_ptrs[idx], &trans[idx])
+                                         : ESP_ERR_INVALID_ARG;
+        if (error != ESP_OK) {
+            // Zero length PDU is not sent by the port
+            trans[idx].usPduLen = 0;
+            result = (result == ESP_OK) ? error : result;
+        }
+        if (status) {
+            status[idx] = error;
+        }
+    }
+
+    // The FSM is idle while the semaphore is taken, the port task owns the sockets for the batch
+    if (xSemaphoreTake(mbm_opts->mbm_sema, MB_TCP_API_RESP_TICS) != pdTRUE) {
+        ESP_LOGD(TAG, "%s:MBC semaphore take fail.", __func__);
+        free(trans);
+        return ESP_ERR_INVALID_STATE;
+    }
+    BOOL executed = xMBTCPPortMasterPipelineRun(trans, (USHORT)count);
+    xSemaphoreGive(mbm_opts->mbm_sema);
+
+    for (size_t idx = 0; idx < count; idx++) {
+        if (trans[idx].usPduLen == 0) {
+            continue; // The request is not built, the error is already set
+        } else if (!executed) {
+            error = ESP_ERR_INVALID_STATE;
+        } else {
+            switch(trans[idx].xResult)
+            {
+                case ERR_OK:
+                    error = mbc_tcp_master_parse_pdu(&requests[idx], data_ptrs[idx], &trans[idx]);
+                    break;
+                case ERR_TIMEOUT:
+                    error = ESP_ERR_TIMEOUT; // Slave did not send response
+                    break;
+                case ERR_ARG:
+                    error = ESP_ERR_NOT_FOUND; // Slave is not registered
+                    break;
+                case ERR_CONN:
+                    error = ESP_ERR_INVALID_STATE; // Slave is not connected
+                    break;
+                default:
+                    error = ESP_ERR_INVALID_RESPONSE;
+                    break;
+            }
+        }
+        if (status) {
+            status[idx] = error;
+        }
+        if ((error != ESP_OK) && (result == ESP_OK)) {
+            result = error;
+        }
+    }
+    free(trans);
+    return result;
+}
+
+#endif
+
 /* ----------------------- Callback functions for Modbus stack ---------------------------------*/
 // These are executed by modbus stack to read appropriate type of registers.
 
@@ -775,6 +984,11 @@ esp_err_t mbc_tcp_master_create(void** handler)
     mbm_interface_ptr->get_cid_info = mbc_tcp_master_get_cid_info;
     mbm_interface_ptr->get_parameter = mbc_tcp_master_get_parameter;
     mbm_interface_ptr->send_request = mbc_tcp_master_send_request;
+#if MB_MASTER_TCP_PIPELINE_ENABLED
+    mbm_interface_ptr->send_requests = mbc_tcp_master_send_requests;
+#else
+    mbm_interface_ptr->send_requests = NULL;
+#endif
     mbm_interface_ptr->set_descriptor = mbc_tcp_master_set_descriptor;
     mbm_interface_ptr->set_parameter = mbc_tcp_master_set_parameter;
 
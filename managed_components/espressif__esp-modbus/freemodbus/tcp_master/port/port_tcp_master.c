@@ -58,7 +58,12 @@
 
 /* ----------------------- Defines  -----------------------------------------*/
 #define MB_TCP_CONNECTION_TIMEOUT_MS    ( 20 )      // Connection timeout in mS
-#define MB_TCP_RECONNECT_TIMEOUT        ( 5000000 ) // Connection timeout in uS
+#define MB_TCP_ADDR_TTL_US              ( (int64_t)CONFIG_FMB_TCP_MASTER_ADDR_TTL_SEC * 1000000 )
+#define MB_TCP_CONNECT_TOUT_US          ( (int64_t)CONFIG_FMB_TCP_MASTER_CONNECT_TOUT_MS * 1000 )
+#define MB_TCP_RECONNECT_MIN_US         ( (int64_t)CONFIG_FMB_TCP_MASTER_RECONNECT_MIN_MS * 1000 )
+#define MB_TCP_RECONNECT_MAX_US         ( (int64_t)CONFIG_FMB_TCP_MASTER_RECONNECT_MAX_MS * 1000 )
+#define MB_TCP_RECONNECT_POLL_MS        ( 100 )     // Idle wait of the port task while slaves are disconnected
+#define MB_TCP_CONNECT_GRACE_US         ( 100000 )  // Wait of the pending slaves before the polling starts
 
 #define MB_EVENT_REQ_DONE_MASK          (   EV_MASTER_PROCESS_SUCCESS | \
                                             EV_MASTER_ERROR_RESPOND_TIMEOUT | \
@@ -72,10 +77,21 @@
 
 #define MB_TCP_READ_TICK_MS             ( 1 )
 #define MB_TCP_READ_BUF_RETRY_CNT       ( 4 )
+#define MB_TCP_PROTOCOL_ID              ( 0 )       // Modbus protocol
 #define MB_SLAVE_FMT(fmt)               "Slave #%d, Socket(#%d)(%s)"fmt
 
 /* ----------------------- Types & Prototypes --------------------------------*/
 void vMBPortEventClose(void);
+int xMBMasterTCPPortWritePoll(MbSlaveInfo_t *pxInfo, const UCHAR *pucMBTCPFrame, USHORT usTCPLength, ULONG xTimeout);
+
+#if MB_MASTER_TCP_PIPELINE_ENABLED
+typedef enum {
+    MB_PIPE_IDLE = 0,
+    MB_PIPE_PENDING,                            // The batch waits for the port task
+    MB_PIPE_RUNNING,                            // The batch is executed by the port task
+    MB_PIPE_CANCELLED                           // The batch is stopped by the caller, the port still uses it
+} eMBPipeState;
+#endif
 
 /* ----------------------- Static variables ---------------------------------*/
 static const char *TAG = "MB_TCP_MASTER_PORT";
@@ -83,6 +99,13 @@ static MbPortConfig_t xMbPortConfig;
 static EventGroupHandle_t xMasterEventHandle = NULL;
 static SemaphoreHandle_t xShutdownSema = NULL;
 static EventBits_t xMasterEvent = 0;
+#if MB_MASTER_TCP_PIPELINE_ENABLED
+static MbTCPTransaction_t *pxPipeTrans = NULL;
+static USHORT usPipeCount = 0;
+static volatile eMBPipeState ePipeState = MB_PIPE_IDLE;
+static SemaphoreHandle_t xPipeDoneSema = NULL;
+static portMUX_TYPE xPipeLock = portMUX_INITIALIZER_UNLOCKED;
+#endif
 
 /* ----------------------- Static functions ---------------------------------*/
 static void vMBTCPPortMasterTask(void *pvParameters);
@@ -127,6 +150,14 @@ xMBMasterTCPPortInit( USHORT usTCPPort )
         ESP_LOGE(TAG, "TCP master queue creation failure.");
         return FALSE;
     }
+#if MB_MASTER_TCP_PIPELINE_ENABLED
+    ePipeState = MB_PIPE_IDLE;
+    xPipeDoneSema = xSemaphoreCreateBinary();
+    if (!xPipeDoneSema) {
+        ESP_LOGE(TAG, "TCP master pipeline semaphore creation failure.");
+        return FALSE;
+    }
+#endif
 
     // Create task for packet processing
     BaseType_t xErr = xTaskCreatePinnedToCore(vMBTCPPortMasterTask,
@@ -249,6 +280,16 @@ static void xMBTCPPortMasterShutdown(void)
     }
     free(xMbPortConfig.pxMbSlaveInfo);
     xMbPortConfig.pxMbSlaveInfo = NULL;
+#if MB_MASTER_TCP_PIPELINE_ENABLED
+    // Release the batch of the caller, the transactions are not used after this point
+    portENTER_CRITICAL(&xPipeLock);
+    BOOL xRunning = (ePipeState == MB_PIPE_RUNNING) || (ePipeState == MB_PIPE_CANCELLED);
+    ePipeState = MB_PIPE_IDLE;
+    portEXIT_CRITICAL(&xPipeLock);
+    if (xRunning) {
+        xSemaphoreGive(xPipeDoneSema);
+    }
+#endif
     xSemaphoreGive(xShutdownSema);
     ESP_LOGD(TAG,"Shutdown the port task.");
     vTaskSuspend(NULL);
@@ -328,6 +369,11 @@ static int xMBTCPPortMasterGetBuf(MbSlaveInfo_t *pxInfo, UCHAR *pucDstBuf, USHOR
         } else if (xLength) {
             pucBuf += xLength;
             usBytesLeft -= xLength;
+        } else {
+            // The slave closed the connection
+            ESP_LOGD(TAG, "Socket(#%d)(%s) connection closed by the slave.",
+                     (int)pxInfo->xSockId, pxInfo->pcIpAddr);
+            return ERR_CONN;
         }
         if (xMBTCPPortMasterGetRespTimeLeft(pxInfo) == 0) {
             return ERR_TIMEOUT;
@@ -522,20 +568,20 @@ BOOL xMBTCPPortMasterAddSlaveIp(const USHORT usIndex, const CHAR *pcIpStr, UCHAR
     return xRes;
 }
 
-// Unblocking connect function
-static err_t xMBTCPPortMasterConnect(MbSlaveInfo_t *pxInfo)
+// Get the slave address from the cache or resolve the host name when the cached one is expired
+static err_t xMBTCPPortMasterResolve(MbSlaveInfo_t *pxInfo)
 {
-    if (!pxInfo) {
-        return ERR_CONN;
-    }
-
-    err_t xErr = ERR_OK;
     CHAR cStr[128];
-    CHAR *pcStr = NULL;
+    CHAR cPort[8];
+    CHAR *pcStr = cStr;
     ip_addr_t xTargetAddr;
     struct addrinfo xHint;
     struct addrinfo *pxAddrList;
-    struct addrinfo *pxCurAddr;
+    int64_t xTime = xMBTCPGetTimeStamp();
+
+    if (pxInfo->xAddrLen && ((xTime - pxInfo->xAddrTimeStamp) < MB_TCP_ADDR_TTL_US)) {
+        return ERR_OK;
+    }
 
     memset(&xHint, 0, sizeof(xHint));
     // Do name resolution for both protocols
@@ -545,127 +591,484 @@ static err_t xMBTCPPortMasterConnect(MbSlaveInfo_t *pxInfo)
     xHint.ai_socktype = (pxInfo->xMbProto == MB_PROTO_UDP) ? SOCK_DGRAM : SOCK_STREAM;
     xHint.ai_protocol = (pxInfo->xMbProto == MB_PROTO_UDP) ? IPPROTO_UDP : IPPROTO_TCP;
     memset(&xTargetAddr, 0, sizeof(xTargetAddr));
-
-    if (asprintf(&pcStr, "%u", xMbPortConfig.usPort) == -1) {
-        abort();
-    }
+    cStr[0] = '\0';
+    snprintf(cPort, sizeof(cPort), "%u", (unsigned)xMbPortConfig.usPort);
 
     // convert domain name to IP address
-    int xRet = getaddrinfo(pxInfo->pcIpAddr, pcStr, &xHint, &pxAddrList);
-    free(pcStr);
-    if (xRet != 0) {
+    int xRet = getaddrinfo(pxInfo->pcIpAddr, cPort, &xHint, &pxAddrList);
+    if ((xRet != 0) || !pxAddrList || (pxAddrList->ai_addrlen > sizeof(pxInfo->xAddr))) {
+        if (xRet == 0) {
+            freeaddrinfo(pxAddrList);
+        }
+        if (pxInfo->xAddrLen) {
+            // Keep the stale address, the host may be reachable while the name server is not
+            ESP_LOGW(TAG, "Cannot resolve host: %s, use the cached address.", pxInfo->pcIpAddr);
+            pxInfo->xAddrTimeStamp = xTime;
+            return ERR_OK;
+        }
         ESP_LOGE(TAG, "Cannot resolve host: %s", pxInfo->pcIpAddr);
         return ERR_CONN;
     }
 
-    for (pxCurAddr = pxAddrList; pxCurAddr != NULL; pxCurAddr = pxCurAddr->ai_next) {
-        if (pxCurAddr->ai_family == AF_INET) {
-            struct in_addr addr4 = ((struct sockaddr_in *) (pxCurAddr->ai_addr))->sin_addr;
-            inet_addr_to_ip4addr(ip_2_ip4(&xTargetAddr), &addr4);
-            pcStr = ip4addr_ntoa_r(ip_2_ip4(&xTargetAddr), cStr, sizeof(cStr));
-        }
+    if (pxAddrList->ai_family == AF_INET) {
+        struct in_addr addr4 = ((struct sockaddr_in *) (pxAddrList->ai_addr))->sin_addr;
+        inet_addr_to_ip4addr(ip_2_ip4(&xTargetAddr), &addr4);
+        pcStr = ip4addr_ntoa_r(ip_2_ip4(&xTargetAddr), cStr, sizeof(cStr));
+    }
 #if CONFIG_LWIP_IPV6
-        else if (pxCurAddr->ai_family == AF_INET6) {
-            struct in6_addr addr6 = ((struct sockaddr_in6 *) (pxCurAddr->ai_addr))->sin6_addr;
-            inet6_addr_to_ip6addr(ip_2_ip6(&xTargetAddr), &addr6);
-            pcStr = ip6addr_ntoa_r(ip_2_ip6(&xTargetAddr), cStr, sizeof(cStr));
-            // Set scope id to fix routing issues with local address
-            ((struct sockaddr_in6 *)(pxCurAddr->ai_addr))->sin6_scope_id =
-                esp_netif_get_netif_impl_index(xMbPortConfig.pvNetIface);
-        }
+    else if (pxAddrList->ai_family == AF_INET6) {
+        struct in6_addr addr6 = ((struct sockaddr_in6 *) (pxAddrList->ai_addr))->sin6_addr;
+        inet6_addr_to_ip6addr(ip_2_ip6(&xTargetAddr), &addr6);
+        pcStr = ip6addr_ntoa_r(ip_2_ip6(&xTargetAddr), cStr, sizeof(cStr));
+        // Set scope id to fix routing issues with local address
+        ((struct sockaddr_in6 *)(pxAddrList->ai_addr))->sin6_scope_id =
+            esp_netif_get_netif_impl_index(xMbPortConfig.pvNetIface);
+    }
 #endif
-        if (pxInfo->xSockId <= 0) {
-            pxInfo->xSockId = socket(pxCurAddr->ai_family, pxCurAddr->ai_socktype, pxCurAddr->ai_protocol);
-            if (pxInfo->xSockId < 0) {
-                ESP_LOGE(TAG, "Unable to create socket: #%d, errno %u", (int)pxInfo->xSockId, (unsigned)errno);
-                xErr = ERR_IF;
-                continue;
-            }
-        } else {
-            ESP_LOGV(TAG, "Socket (#%d)(%s) created.", (int)pxInfo->xSockId, cStr);
-        }
+    memcpy(&pxInfo->xAddr, pxAddrList->ai_addr, pxAddrList->ai_addrlen);
+    pxInfo->xAddrLen = pxAddrList->ai_addrlen;
+    pxInfo->xAddrTimeStamp = xTime;
+    freeaddrinfo(pxAddrList);
+    ESP_LOGD(TAG, "Slave #%d, host %s resolved to [%s].", (int)pxInfo->xIndex, pxInfo->pcIpAddr, pcStr);
+    return ERR_OK;
+}
 
-        // Set non blocking attribute for socket
-        xMBTCPPortMasterSetNonBlocking(pxInfo);
-
-        // Can return EINPROGRESS as an error which means
-        // that connection is in progress and should be checked later
-        xErr = connect(pxInfo->xSockId, (struct sockaddr*)pxCurAddr->ai_addr, pxCurAddr->ai_addrlen);
-        if ((xErr < 0) && (errno == EINPROGRESS || errno == EALREADY)) {
-            // The unblocking connect is pending (check status later) or already connected
-            ESP_LOGV(TAG, "Socket(#%d)(%s) connection is pending, errno %u (%s).",
-                     (int)pxInfo->xSockId, cStr, (unsigned)errno, strerror(errno));
-
-            // Set keep alive flag in socket options
-            vMBTCPPortSetKeepAlive(pxInfo);
-            xErr = xMBTCPPortMasterCheckAlive(pxInfo, MB_TCP_CONNECTION_TIMEOUT_MS);
-            continue;
-        } else if ((xErr < 0) && (errno == EISCONN)) {
-            // Socket already connected
-            xErr = ERR_OK;
-            continue;
-        } else if (xErr != ERR_OK) {
-            // Other error occurred during connection
-            ESP_LOGV(TAG, MB_SLAVE_FMT(" unable to connect, error=0x%x, errno %u (%s)"),
-                     (int)pxInfo->xIndex, (int)pxInfo->xSockId, cStr, (int)xErr, (unsigned)errno, strerror(errno));
-            xMBTCPPortMasterCloseConnection(pxInfo);
-            xErr = ERR_CONN;
-        } else {
-            ESP_LOGI(TAG, MB_SLAVE_FMT(", successfully connected."),
-                     (int)pxInfo->xIndex, (int)pxInfo->xSockId, cStr);
-            continue;
+// Unblocking connect function, starts the connection and returns ERR_INPROGRESS if it is pending
+static err_t xMBTCPPortMasterConnect(MbSlaveInfo_t *pxInfo)
+{
+    if (!pxInfo) {
+        return ERR_CONN;
+    }
+
+    err_t xErr = xMBTCPPortMasterResolve(pxInfo);
+    if (xErr != ERR_OK) {
+        return xErr;
+    }
+    pxInfo->xConnTimeStamp = xMBTCPGetTimeStamp();
+    if (pxInfo->xSockId < 0) {
+        pxInfo->xSockId = socket(pxInfo->xAddr.ss_family,
+                                 (pxInfo->xMbProto == MB_PROTO_UDP) ? SOCK_DGRAM : SOCK_STREAM,
+                                 (pxInfo->xMbProto == MB_PROTO_UDP) ? IPPROTO_UDP : IPPROTO_TCP);
+        if (pxInfo->xSockId < 0) {
+            ESP_LOGE(TAG, "Unable to create socket: #%d, errno %u", (int)pxInfo->xSockId, (unsigned)errno);
+            return ERR_IF;
         }
     }
-    freeaddrinfo(pxAddrList);
-    return xErr;
+
+    // Set non blocking attribute for socket
+    xMBTCPPortMasterSetNonBlocking(pxInfo);
+    // Set keep alive flag in socket options
+    vMBTCPPortSetKeepAlive(pxInfo);
+
+    // Can return EINPROGRESS as an error which means
+    // that connection is in progress and should be checked later
+    xErr = connect(pxInfo->xSockId, (struct sockaddr *)&pxInfo->xAddr, pxInfo->xAddrLen);
+    if ((xErr < 0) && (errno == EINPROGRESS || errno == EALREADY)) {
+        ESP_LOGV(TAG, MB_SLAVE_FMT(" connection is pending, errno %u (%s)."),
+                 (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (unsigned)errno, strerror(errno));
+        return ERR_INPROGRESS;
+    } else if ((xErr < 0) && (errno == EISCONN)) {
+        // Socket already connected
+        return ERR_OK;
+    } else if (xErr != ERR_OK) {
+        // Other error occurred during connection
+        ESP_LOGV(TAG, MB_SLAVE_FMT(" unable to connect, error=0x%x, errno %u (%s)"),
+                 (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (int)xErr, (unsigned)errno, strerror(errno));
+        return ERR_CONN;
+    }
+    return ERR_OK;
 }
 
-// Find the first slave info whose descriptor is set in xFdSet
-static MbSlaveInfo_t *xMBTCPPortMasterGetSlaveReady(fd_set *pxFdSet)
+// Close the socket of the slave and schedule the next connection attempt after the backoff period
+static void vMBTCPPortMasterConnFailed(MbSlaveInfo_t *pxInfo, fd_set *pxConnSet)
+{
+    int64_t xPeriod = MB_TCP_RECONNECT_MIN_US << pxInfo->ucConnBackoff;
+
+    if (xPeriod >= MB_TCP_RECONNECT_MAX_US) {
+        xPeriod = MB_TCP_RECONNECT_MAX_US;
+    } else {
+        pxInfo->ucConnBackoff++;
+    }
+    if (pxInfo->xSockId >= 0) {
+        FD_CLR(pxInfo->xSockId, pxConnSet);
+        xMBTCPPortMasterCloseConnection(pxInfo);
+    }
+    pxInfo->usRcvPos = 0;
+    pxInfo->xConnState = MB_CONN_IDLE;
+    pxInfo->xConnTimeStamp = xMBTCPGetTimeStamp() + xPeriod;
+    ESP_LOGD(TAG, "Slave #%d(%s), reconnect in %" PRIu64 " ms.",
+             (int)pxInfo->xIndex, pxInfo->pcIpAddr, (int64_t)(xPeriod / 1000));
+}
+
+// Advance the connections of all the slaves in parallel, waits up to ulWaitMs for a pending one,
+// returns the number of the connected slaves
+static USHORT usMBTCPPortMasterConnectAll(fd_set *pxConnSet, int *pxMaxSd, ULONG ulWaitMs)
 {
     MbSlaveInfo_t *pxInfo = NULL;
+    fd_set xWriteSet;
+    int xMaxSd = -1;
+    USHORT usConnCnt = 0;
+    int64_t xTime = xMBTCPGetTimeStamp();
 
-    // Slave connection loop
-    for (int xIndex = 0; (xIndex < MB_TCP_PORT_MAX_CONN); xIndex++) {
+    // Start the attempts of the disconnected slaves whose reconnection period has expired
+    FD_ZERO(&xWriteSet);
+    for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
         pxInfo = xMbPortConfig.pxMbSlaveInfo[xIndex];
-        if (pxInfo) {
-            // Is this response for current processing slave
-            if (FD_ISSET(pxInfo->xSockId, pxFdSet)) {
-                FD_CLR(pxInfo->xSockId, pxFdSet);
-                return pxInfo;
+        if ((pxInfo->xConnState == MB_CONN_IDLE) && (xTime >= pxInfo->xConnTimeStamp)) {
+            err_t xErr = xMBTCPPortMasterConnect(pxInfo);
+            pxInfo->xError = xErr;
+            if ((xErr == ERR_INPROGRESS) || (xErr == ERR_OK)) {
+                // The alive check below completes the connection
+                pxInfo->xConnState = MB_CONN_PENDING;
+            } else {
+                ESP_LOGD(TAG, MB_SLAVE_FMT(" connect failed, error = 0x%x."),
+                         (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (int)xErr);
+                vMBTCPPortMasterConnFailed(pxInfo, pxConnSet);
             }
         }
+        if (pxInfo->xConnState == MB_CONN_PENDING) {
+            FD_SET(pxInfo->xSockId, &xWriteSet);
+            xMaxSd = (pxInfo->xSockId > xMaxSd) ? pxInfo->xSockId : xMaxSd;
+        }
+    }
+
+    // Wait for the first of the pending connections, the other ones are checked without waiting
+    if ((xMaxSd >= 0) && ulWaitMs) {
+        fd_set xErrorSet = xWriteSet;
+        struct timeval xTimeVal;
+        vMBTCPPortMasterMStoTimeVal((USHORT)ulWaitMs, &xTimeVal);
+        (void)select(xMaxSd + 1, NULL, &xWriteSet, &xErrorSet, &xTimeVal);
     }
-    return (MbSlaveInfo_t *)NULL;
+
+    xTime = xMBTCPGetTimeStamp();
+    for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+        pxInfo = xMbPortConfig.pxMbSlaveInfo[xIndex];
+        if (pxInfo->xConnState == MB_CONN_PENDING) {
+            errno = 0; // The errno of the connect() call is not related to the check
+            err_t xErr = xMBTCPPortMasterCheckAlive(pxInfo, 0);
+            if (xErr == ERR_OK) {
+                pxInfo->xConnState = MB_CONN_DONE;
+                pxInfo->ucConnBackoff = 0;
+                pxInfo->xError = ERR_OK;
+                pxInfo->usRcvPos = 0;
+                FD_SET(pxInfo->xSockId, pxConnSet);
+                *pxMaxSd = (pxInfo->xSockId > *pxMaxSd) ? pxInfo->xSockId : *pxMaxSd;
+                // Update time stamp for connected slaves
+                pxInfo->xRecvTimeStamp = xTime;
+                pxInfo->xSendTimeStamp = xTime;
+                ESP_LOGI(TAG, MB_SLAVE_FMT(", successfully connected."),
+                         (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr);
+            } else if ((xErr == ERR_INPROGRESS) && ((xTime - pxInfo->xConnTimeStamp) < MB_TCP_CONNECT_TOUT_US)) {
+                continue;
+            } else {
+                ESP_LOGD(TAG, MB_SLAVE_FMT(" connect failed, error = 0x%x."),
+                         (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (int)xErr);
+                pxInfo->xError = ERR_CONN;
+                vMBTCPPortMasterConnFailed(pxInfo, pxConnSet);
+            }
+        }
+        usConnCnt += (pxInfo->xConnState == MB_CONN_DONE);
+    }
+    return usConnCnt;
+}
+
+// Check if there are slaves which are not connected yet
+static BOOL xMBTCPPortMasterConnPending(void)
+{
+    for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+        if (xMbPortConfig.pxMbSlaveInfo[xIndex]->xConnState == MB_CONN_PENDING) {
+            return TRUE;
+        }
+    }
+    return FALSE;
 }
 
+// Check the connected slaves, the failed ones are closed and reconnected in background
 static int xMBTCPPortMasterCheckConnState(fd_set *pxFdSet)
 {
-    fd_set xConnSetCheck = *pxFdSet;
     MbSlaveInfo_t *pxInfo = NULL;
-    int64_t xTime = 0;
-    int xErr = 0;
+    int64_t xTime = xMBTCPGetTimeStamp();
     int xCount = 0;
-    do {
-        xTime = xMBTCPGetTimeStamp();
-        pxInfo = xMBTCPPortMasterGetSlaveReady(&xConnSetCheck);
-        if (pxInfo) {
-            xErr = xMBTCPPortMasterCheckAlive(pxInfo, 0);
-            if ((xErr < 0) && (((xTime - pxInfo->xRecvTimeStamp) > MB_TCP_RECONNECT_TIMEOUT) ||
-                                ((xTime - pxInfo->xSendTimeStamp) > MB_TCP_RECONNECT_TIMEOUT))) {
-                ESP_LOGI(TAG, MB_SLAVE_FMT(", slave is down, off_time[r][w](us) = [%" PRIu64 "][%" PRIu64 "]."),
-                         (int)pxInfo->xIndex,
-                         (int)pxInfo->xSockId,
-                         pxInfo->pcIpAddr,
-                         (int64_t)(xTime - pxInfo->xRecvTimeStamp),
-                         (int64_t)(xTime - pxInfo->xSendTimeStamp));
-                xCount++;
-            }
+    for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+        pxInfo = xMbPortConfig.pxMbSlaveInfo[xIndex];
+        if ((pxInfo->xConnState == MB_CONN_DONE)
+                && ((pxInfo->xError < 0) || (xMBTCPPortMasterCheckAlive(pxInfo, 0) == ERR_CONN))) {
+            ESP_LOGI(TAG, MB_SLAVE_FMT(", slave is down, off_time[r][w](us) = [%" PRIu64 "][%" PRIu64 "]."),
+                     (int)pxInfo->xIndex,
+                     (int)pxInfo->xSockId,
+                     pxInfo->pcIpAddr,
+                     (int64_t)(xTime - pxInfo->xRecvTimeStamp),
+                     (int64_t)(xTime - pxInfo->xSendTimeStamp));
+            vMBTCPPortMasterConnFailed(pxInfo, pxFdSet);
+            xCount++;
         }
-    } while (pxInfo && (xCount < MB_TCP_PORT_MAX_CONN));
+    }
     return xCount;
 }
 
+#if MB_MASTER_TCP_PIPELINE_ENABLED
+
+// Find the slave info of the pipelined transaction
+static MbSlaveInfo_t *xMBTCPPortMasterPipeFindInfo(UCHAR ucSlaveAddr)
+{
+    for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+        if (xMbPortConfig.pxMbSlaveInfo[xIndex]->ucSlaveAddr == ucSlaveAddr) {
+            return xMbPortConfig.pxMbSlaveInfo[xIndex];
+        }
+    }
+    return NULL;
+}
+
+// Complete the outstanding and queued transactions of the slave with the error
+static void vMBTCPPortMasterPipeFail(MbSlaveInfo_t *pxInfo, int xResult, USHORT *pusLeft)
+{
+    for (USHORT usIdx = 0; usIdx < usPipeCount; usIdx++) {
+        MbTCPTransaction_t *pxTrans = &pxPipeTrans[usIdx];
+        if ((pxTrans->xResult == ERR_INPROGRESS) && (pxTrans->ucSlaveAddr == pxInfo->ucSlaveAddr)) {
+            pxTrans->xResult = xResult;
+            (*pusLeft)--;
+        }
+    }
+    pxInfo->xPipeTrans = -1;
+}
+
+// Build the MBAP frame of the transaction and send it to the slave
+static int xMBTCPPortMasterPipeSend(MbSlaveInfo_t *pxInfo, MbTCPTransaction_t *pxTrans)
+{
+    UCHAR *pucFrame = pxInfo->pucRcvBuf;
+    USHORT usLength = pxTrans->usPduLen + MB_TCP_FUNC;
+
+    if ((pxTrans->usPduLen == 0) || (usLength > MB_TCP_BUF_SIZE)) {
+        return ERR_VAL;
+    }
+    // The receive buffer is free, the slave has no outstanding transaction
+    pucFrame[MB_TCP_TID] = (UCHAR)(pxInfo->usTidCnt >> 8U);
+    pucFrame[MB_TCP_TID + 1] = (UCHAR)(pxInfo->usTidCnt & 0xFF);
+    pucFrame[MB_TCP_PID] = 0;
+    pucFrame[MB_TCP_PID + 1] = 0;
+    pucFrame[MB_TCP_LEN] = (UCHAR)((pxTrans->usPduLen + 1) >> 8U);
+    pucFrame[MB_TCP_LEN + 1] = (UCHAR)((pxTrans->usPduLen + 1) & 0xFF);
+#if MB_TCP_UID_ENABLED
+    pucFrame[MB_TCP_UID] = pxTrans->ucSlaveAddr;
+#else
+    pucFrame[MB_TCP_UID] = 0x00;
+#endif
+    memcpy(&pucFrame[MB_TCP_FUNC], pxTrans->pucPdu, pxTrans->usPduLen);
+
+    int xRes = xMBMasterTCPPortWritePoll(pxInfo, pucFrame, usLength, MB_TCP_SEND_TIMEOUT_MS);
+    pxInfo->xSendTimeStamp = xMBTCPGetTimeStamp();
+    if (xRes < 0) {
+        pxInfo->xError = xRes;
+        return ERR_CONN;
+    }
+    ESP_LOGD(TAG, MB_SLAVE_FMT(", pipelined request sent: TID=0x%02x, %d (bytes)"),
+             (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, pxInfo->usTidCnt, (int)xRes);
+    pxInfo->xError = 0;
+    pxInfo->usRcvPos = 0;
+    if (pxInfo->usTidCnt < (USHRT_MAX - 1)) {
+        pxInfo->usTidCnt++;
+    } else {
+        pxInfo->usTidCnt = (USHORT)(pxInfo->xIndex << 8U);
+    }
+    return ERR_OK;
+}
+
+// Get the response of the outstanding transaction, returns ERR_INPROGRESS if it is not received yet
+static int xMBTCPPortMasterPipeReceive(MbSlaveInfo_t *pxInfo, MbTCPTransaction_t *pxTrans)
+{
+    int xRet = vMBTCPPortMasterReadPacket(pxInfo);
+    if (xRet == ERR_BUF) {
+        // The late response of a timed out transaction, drop it and wait for the own response
+        pxInfo->usRcvPos = 0;
+        return ERR_INPROGRESS;
+    } else if (xRet == ERR_TIMEOUT) {
+        return ERR_INPROGRESS;
+    } else if (xRet < 0) {
+        return ERR_CONN;
+    }
+    USHORT usPduLen = pxInfo->usRcvPos - MB_TCP_FUNC;
+    pxInfo->usRcvPos = 0;
+    pxInfo->xRecvTimeStamp = xMBTCPGetTimeStamp();
+    if ((MB_TCP_GET_FIELD(pxInfo->pucRcvBuf, MB_TCP_PID) != MB_TCP_PROTOCOL_ID)
+            || (usPduLen == 0) || (usPduLen > pxTrans->usPduSize)) {
+        return ERR_VAL;
+    }
+    memcpy(pxTrans->pucPdu, &pxInfo->pucRcvBuf[MB_TCP_FUNC], usPduLen);
+    pxTrans->usPduLen = usPduLen;
+    return ERR_OK;
+}
+
+// Execute the pending batch, returns -1 if a slave connection failed
+static int xMBTCPPortMasterPipeProcess(void)
+{
+    MbSlaveInfo_t *pxInfo = NULL;
+    MbTCPTransaction_t *pxTrans = NULL;
+    USHORT usLeft = 0;
+    BOOL xConnFailed = FALSE;
+    BOOL xStart = FALSE;
+
+    portENTER_CRITICAL(&xPipeLock);
+    if (ePipeState == MB_PIPE_PENDING) {
+        ePipeState = MB_PIPE_RUNNING;
+        xStart = TRUE;
+    }
+    portEXIT_CRITICAL(&xPipeLock);
+    if (!xStart) {
+        return 0; // The batch is cancelled by the caller
+    }
+
+    for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+        xMbPortConfig.pxMbSlaveInfo[xIndex]->xPipeTrans = -1;
+    }
+    for (USHORT usIdx = 0; usIdx < usPipeCount; usIdx++) {
+        pxTrans = &pxPipeTrans[usIdx];
+        pxInfo = xMBTCPPortMasterPipeFindInfo(pxTrans->ucSlaveAddr);
+        pxTrans->xResult = !pxInfo ? ERR_ARG : ((pxInfo->xConnState != MB_CONN_DONE) ? ERR_CONN : ERR_INPROGRESS);
+        usLeft += (pxTrans->xResult == ERR_INPROGRESS);
+    }
+
+    while (usLeft) {
+        portENTER_CRITICAL(&xPipeLock);
+        BOOL xCancel = (ePipeState == MB_PIPE_CANCELLED);
+        portEXIT_CRITICAL(&xPipeLock);
+        if (xCancel) {
+            ESP_LOGD(TAG, "Pipelined batch is cancelled, %u transactions left.", (unsigned)usLeft);
+            break;
+        }
+        // Start the next transaction of each slave which has no outstanding one
+        for (USHORT usIdx = 0; usIdx < usPipeCount; usIdx++) {
+            pxTrans = &pxPipeTrans[usIdx];
+            if (pxTrans->xResult != ERR_INPROGRESS) {
+                continue;
+            }
+            pxInfo = xMBTCPPortMasterPipeFindInfo(pxTrans->ucSlaveAddr);
+            if (pxInfo->xPipeTrans >= 0) {
+                continue;
+            }
+            int xRes = xMBTCPPortMasterPipeSend(pxInfo, pxTrans);
+            if (xRes == ERR_OK) {
+                pxInfo->xPipeTrans = usIdx;
+            } else if (xRes == ERR_VAL) {
+                pxTrans->xResult = ERR_VAL;
+                usLeft--;
+            } else {
+                vMBTCPPortMasterPipeFail(pxInfo, ERR_CONN, &usLeft);
+                xConnFailed = TRUE;
+            }
+        }
+
+        // Wait for the first response of the outstanding transactions
+        fd_set xWaitSet;
+        int xMaxSd = -1;
+        int64_t xTimeLeft = MB_MASTER_TIMEOUT_MS_RESPOND;
+        FD_ZERO(&xWaitSet);
+        for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+            pxInfo = xMbPortConfig.pxMbSlaveInfo[xIndex];
+            if (pxInfo->xPipeTrans >= 0) {
+                FD_SET(pxInfo->xSockId, &xWaitSet);
+                xMaxSd = (pxInfo->xSockId > xMaxSd) ? pxInfo->xSockId : xMaxSd;
+                int64_t xInfoTimeLeft = xMBTCPPortMasterGetRespTimeLeft(pxInfo);
+                xTimeLeft = (xInfoTimeLeft < xTimeLeft) ? xInfoTimeLeft : xTimeLeft;
+            }
+        }
+        if (xMaxSd < 0) {
+            break;
+        }
+        fd_set xReadSet = xWaitSet;
+        fd_set xErrorSet = xWaitSet;
+        struct timeval xTimeVal;
+        vMBTCPPortMasterMStoTimeVal((USHORT)xTimeLeft, &xTimeVal);
+        if (select(xMaxSd + 1, &xReadSet, NULL, &xErrorSet, &xTimeVal) < 0) {
+            ESP_LOGD(TAG, "Pipelined batch, select error, errno = %u.", (unsigned)errno);
+            xErrorSet = xWaitSet;
+        }
+        for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+            pxInfo = xMbPortConfig.pxMbSlaveInfo[xIndex];
+            if (pxInfo->xPipeTrans < 0) {
+                continue;
+            }
+            pxTrans = &pxPipeTrans[pxInfo->xPipeTrans];
+            int xRes = ERR_INPROGRESS;
+            if (FD_ISSET(pxInfo->xSockId, &xErrorSet)) {
+                xRes = ERR_CONN;
+            } else if (FD_ISSET(pxInfo->xSockId, &xReadSet)) {
+                xRes = xMBTCPPortMasterPipeReceive(pxInfo, pxTrans);
+            }
+            if ((xRes == ERR_INPROGRESS) && (xMBTCPPortMasterGetRespTimeLeft(pxInfo) == 0)) {
+                ESP_LOGD(TAG, MB_SLAVE_FMT(", pipelined response timeout."),
+                         (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr);
+                xRes = ERR_TIMEOUT;
+            }
+            if (xRes == ERR_CONN) {
+                ESP_LOGD(TAG, MB_SLAVE_FMT(", pipelined transaction connection error."),
+                         (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr);
+                vMBTCPPortMasterPipeFail(pxInfo, ERR_CONN, &usLeft);
+                pxInfo->xError = ERR_CONN;
+                xConnFailed = TRUE;
+            } else if (xRes != ERR_INPROGRESS) {
+                pxTrans->xResult = xRes;
+                pxInfo->xPipeTrans = -1;
+                usLeft--;
+            }
+        }
+        TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
+    }
+
+    portENTER_CRITICAL(&xPipeLock);
+    ePipeState = MB_PIPE_IDLE;
+    portEXIT_CRITICAL(&xPipeLock);
+    xSemaphoreGive(xPipeDoneSema);
+    return xConnFailed ? -1 : 0;
+}
+
+BOOL xMBTCPPortMasterPipelineRun(MbTCPTransaction_t *pxTrans, USHORT usCount)
+{
+    BOOL xCancelled = FALSE;
+
+    MB_PORT_CHECK((pxTrans && usCount), FALSE, "Incorrect pipelined transactions.");
+    MB_PORT_CHECK((xPipeDoneSema != NULL), FALSE, "TCP master pipeline is not initialized.");
+    pxPipeTrans = pxTrans;
+    usPipeCount = usCount;
+    portENTER_CRITICAL(&xPipeLock);
+    ePipeState = MB_PIPE_PENDING;
+    portEXIT_CRITICAL(&xPipeLock);
+    // Wake the port task waiting for the next frame of the FSM
+    vMBMasterPortFsmConfirm(EV_MASTER_PORT_PIPELINE);
+    if (xSemaphoreTake(xPipeDoneSema, pdMS_TO_TICKS(MB_EVENT_WAIT_TOUT_MS)) != pdTRUE) {
+        portENTER_CRITICAL(&xPipeLock);
+        if (ePipeState == MB_PIPE_PENDING) {
+            ePipeState = MB_PIPE_IDLE;
+            xCancelled = TRUE;
+        }
+        portEXIT_CRITICAL(&xPipeLock);
+        if (xCancelled) {
+            ESP_LOGD(TAG, "Pipelined batch is not started, the slaves are not connected.");
+            return FALSE;
+        }
+        // The batch is running, each transaction is limited by the respond timeout
+        ULONG ulMaxMs = (ULONG)usCount * (MB_MASTER_TIMEOUT_MS_RESPOND + MB_TCP_SEND_TIMEOUT_MS)
+                            + MB_EVENT_WAIT_TOUT_MS;
+        if (xSemaphoreTake(xPipeDoneSema, pdMS_TO_TICKS(ulMaxMs)) != pdTRUE) {
+            // The port task writes the transactions until it sees the cancellation
+            // at the end of its current wait, the caller owns them after the release.
+            portENTER_CRITICAL(&xPipeLock);
+            if (ePipeState == MB_PIPE_RUNNING) {
+                ePipeState = MB_PIPE_CANCELLED;
+                xCancelled = TRUE;
+            }
+            portEXIT_CRITICAL(&xPipeLock);
+            (void)xSemaphoreTake(xPipeDoneSema, portMAX_DELAY);
+            if (xCancelled) {
+                ESP_LOGE(TAG, "Pipelined batch is not completed.");
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+#endif
+
 static void xMBTCPPortMasterFsmSetError(eMBMasterErrorEventType xErrType, eMBMasterEventEnum xPostEvent)
 {
     vMBMasterPortTimersDisable();
@@ -681,7 +1084,6 @@ static void vMBTCPPortMasterTask(void *pvParameters)
     fd_set xConnSet;
     fd_set xReadSet;
     int xMaxSd = 0;
-    err_t xErr = ERR_ABRT;
     USHORT usSlaveConnCnt = 0;
     int64_t xTime = 0;
 
@@ -732,6 +1134,7 @@ static void vMBTCPPortMasterTask(void *pvParameters)
         }
     }
 
+    FD_ZERO(&xConnSet);
     // Main connection cycle
     while (1)
     {
@@ -739,78 +1142,57 @@ static void vMBTCPPortMasterTask(void *pvParameters)
         xTime = xMBTCPGetTimeStamp();
         usSlaveConnCnt = 0;
         CHAR ucDot = '.';
-        while(usSlaveConnCnt < xMbPortConfig.usMbSlaveInfoCount) {
-            usSlaveConnCnt = 0;
-            FD_ZERO(&xConnSet);
+        // Connect all the slaves in parallel, the polling starts as soon as the reachable ones are connected
+        while (!usSlaveConnCnt
+               || ((usSlaveConnCnt < xMbPortConfig.usMbSlaveInfoCount) && xMBTCPPortMasterConnPending()
+                   && ((xMBTCPGetTimeStamp() - xTime) < MB_TCP_CONNECT_GRACE_US))) {
             ucDot ^= 0x03;
-            // Slave connection loop
-            for (UCHAR ucCnt = 0; (ucCnt < MB_TCP_PORT_MAX_CONN); ucCnt++) {
-                pxInfo = xMbPortConfig.pxMbSlaveInfo[ucCnt];
-                // if slave descriptor is NULL then it is end of list or connection closed.
-                if (!pxInfo) {
-                    ESP_LOGV(TAG, "Index: % is not initialized, skip.", ucCnt);
-                    if (xMbPortConfig.usMbSlaveInfoCount) {
-                        continue;
-                    }
-                    break;
-                }
-                putchar(ucDot);
-                // if we don't yield we run the risk of hogging CPU
-                vTaskDelay(pdMS_TO_TICKS(MB_TCP_CONNECTION_TIMEOUT_MS));
-                xErr = xMBTCPPortMasterConnect(pxInfo);
-                switch(xErr)
-                {
-                    case ERR_CONN:
-                    case ERR_INPROGRESS:
-                        // In case of connection errors remove the socket from set
-                        if (FD_ISSET(pxInfo->xSockId, &xConnSet)) {
-                            FD_CLR(pxInfo->xSockId, &xConnSet);
-                            ESP_LOGE(TAG, MB_SLAVE_FMT(" connect failed, error = 0x%x."),
-                                                                            (int)pxInfo->xIndex, (int)pxInfo->xSockId,
-                                                                            (char*)pxInfo->pcIpAddr, (int)xErr);
-                            if (usSlaveConnCnt) {
-                                usSlaveConnCnt--;
-                            }
-                        }
-                        break;
-                    case ERR_OK:
-                        // if connection is successful, add the descriptor into set
-                        if (!FD_ISSET(pxInfo->xSockId, &xConnSet)) {
-                            FD_SET(pxInfo->xSockId, &xConnSet);
-                            usSlaveConnCnt++;
-                            xMaxSd = (pxInfo->xSockId > xMaxSd) ? pxInfo->xSockId : xMaxSd;
-                            ESP_LOGD(TAG, MB_SLAVE_FMT(", connected %u slave(s), error = 0x%x."),
-                                                                (int)pxInfo->xIndex, (int)pxInfo->xSockId,
-                                                                pxInfo->pcIpAddr,
-                                                                (unsigned)usSlaveConnCnt, (int)xErr);
-                            // Update time stamp for connected slaves
-                            pxInfo->xRecvTimeStamp = xMBTCPGetTimeStamp();
-                            pxInfo->xSendTimeStamp = xMBTCPGetTimeStamp();
-                        }
-                        break;
-                    default:
-                        ESP_LOGE(TAG, MB_SLAVE_FMT(", unexpected error = 0x%x."),
-                                                            (int)pxInfo->xIndex,
-                                                            (int)pxInfo->xSockId,
-                                                            pxInfo->pcIpAddr, (int)xErr);
-                        break;
-                }
-                if (pxInfo) {
-                    pxInfo->xError = xErr;
-                }
-                TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
+            putchar(ucDot);
+            usSlaveConnCnt = usMBTCPPortMasterConnectAll(&xConnSet, &xMaxSd, MB_TCP_CONNECTION_TIMEOUT_MS);
+            if (!usSlaveConnCnt && !xMBTCPPortMasterConnPending()) {
+                // All the slaves wait for the reconnection period, do not hog the CPU
+                vTaskDelay(pdMS_TO_TICKS(MB_TCP_RECONNECT_POLL_MS));
             }
+            TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
         }
         ESP_LOGI(TAG, "Connected %u slaves, start polling...", (unsigned)usSlaveConnCnt);
 
         vMBTCPPortMasterStartPoll(); // Send event to start stack
 
-        // Slave receive data loop
-        while(usSlaveConnCnt) {
+        // Slave receive data loop, the disconnected slaves are reconnected in background
+        while (1) {
+            usSlaveConnCnt = usMBTCPPortMasterConnectAll(&xConnSet, &xMaxSd, 0);
+            if (!usSlaveConnCnt) {
+                // Stop polling process, all the slaves are disconnected
+                vMBTCPPortMasterStopPoll();
+                break;
+            }
+            // Wake up periodically to advance the connections of the disconnected slaves
+            ULONG ulWaitMs = (usSlaveConnCnt < xMbPortConfig.usMbSlaveInfoCount) ?
+                                MB_TCP_RECONNECT_POLL_MS : MB_EVENT_WAIT_TOUT_MS;
             xReadSet = xConnSet;
             // Check transmission event to clear appropriate bit.
-            xMBMasterPortFsmWaitConfirmation(EV_MASTER_FRAME_TRANSMIT, pdMS_TO_TICKS(MB_EVENT_WAIT_TOUT_MS));
+#if MB_MASTER_TCP_PIPELINE_ENABLED
+            // The pipelined batch is executed here while the FSM is idle
+            eMBMasterEventEnum eEvent = xMBMasterPortFsmWaitConfirmation(
+                                            (eMBMasterEventEnum)(EV_MASTER_FRAME_TRANSMIT | EV_MASTER_PORT_PIPELINE),
+                                            pdMS_TO_TICKS(ulWaitMs));
+            if (eEvent & EV_MASTER_PORT_PIPELINE) {
+                TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
+                if (xMBTCPPortMasterPipeProcess() < 0) {
+                    // Close the failed slaves, they are reconnected in background
+                    xMBTCPPortMasterCheckConnState(&xConnSet);
+                }
+                continue;
+            }
+#else
+            eMBMasterEventEnum eEvent = xMBMasterPortFsmWaitConfirmation(EV_MASTER_FRAME_TRANSMIT,
+                                                                         pdMS_TO_TICKS(ulWaitMs));
+#endif
             TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
+            if (!(eEvent & EV_MASTER_FRAME_TRANSMIT)) {
+                continue; // No request to process
+            }
             // Synchronize state machine with send packet event
             if (xMBMasterPortFsmWaitConfirmation(EV_MASTER_FRAME_SENT, pdMS_TO_TICKS(MB_EVENT_WAIT_TOUT_MS))) {
                 ESP_LOGD(TAG, "FSM Synchronized with sent event.");
@@ -824,6 +1206,16 @@ static void vMBTCPPortMasterTask(void *pvParameters)
                 TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
                 break; // incorrect slave descriptor, reconnect.
             }
+            if ((pxCurrInfo->xConnState == MB_CONN_DONE) && (pxCurrInfo->xError < 0)) {
+                // The request is not sent, reconnect the slave in background
+                vMBTCPPortMasterConnFailed(pxCurrInfo, &xConnSet);
+            }
+            if (pxCurrInfo->xConnState != MB_CONN_DONE) {
+                // The slave is not connected, the respond timeout completes the transaction
+                xMBMasterPortFsmWaitConfirmation(MB_EVENT_REQ_DONE_MASK, pdMS_TO_TICKS(MB_MASTER_TIMEOUT_MS_RESPOND + 1));
+                TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
+                continue;
+            }
             xTime = xMBTCPPortMasterGetRespTimeLeft(pxCurrInfo);
             ESP_LOGD(TAG, "Set select timeout, left time: %" PRIu64 " ms.",
                      xMBTCPPortMasterGetRespTimeLeft(pxCurrInfo));
@@ -846,12 +1238,10 @@ static void vMBTCPPortMasterTask(void *pvParameters)
                 xTime = xMBTCPPortMasterGetRespTimeLeft(pxCurrInfo);
                 // Wait completion of last transaction
                 xMBMasterPortFsmWaitConfirmation(MB_EVENT_REQ_DONE_MASK, pdMS_TO_TICKS(xTime));
-                // Stop polling process
-                vMBTCPPortMasterStopPoll();
+                // Close the failed slave, it is reconnected in background
+                vMBTCPPortMasterConnFailed(pxCurrInfo, &xConnSet);
                 TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
-                // Check disconnected slaves, do not need a result just to print information.
-                xMBTCPPortMasterCheckConnState(&xConnSet);
-                break;
+                continue;
             } else {
                 // Check to make sure that active slave data is ready
                 if (FD_ISSET(pxCurrInfo->xSockId, &xReadSet)) {
@@ -880,12 +1270,10 @@ static void vMBTCPPortMasterTask(void *pvParameters)
                     } else {
                         ESP_LOGE(TAG, MB_SLAVE_FMT(", critical error=%d."),
                                  (int)pxCurrInfo->xIndex, (int)pxCurrInfo->xSockId, pxCurrInfo->pcIpAddr, (int)xRet);
-                        // Stop polling process
-                        vMBTCPPortMasterStopPoll();
+                        // Close the failed slave, it is reconnected in background
+                        vMBTCPPortMasterConnFailed(pxCurrInfo, &xConnSet);
                         TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
-                        // Check disconnected slaves, do not need a result just to print information.
-                        xMBTCPPortMasterCheckConnState(&xConnSet);
-                        break;
+                        continue;
                     }
                     xTime = xMBTCPPortMasterGetRespTimeLeft(pxCurrInfo);
                     ESP_LOGD(TAG, "Slave #%d, data processing left time %" PRIu64 " [ms].", (int)pxCurrInfo->xIndex, xTime);
@@ -900,7 +1288,7 @@ static void vMBTCPPortMasterTask(void *pvParameters)
                 }
             }
             TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
-        } // while(usMbSlaveInfoCount)
+        } // while (1)
     } // while (1)
     vTaskDelete(NULL);
 }
@@ -934,6 +1322,12 @@ void vMBMasterTCPPortDisable(void)
 void vMBMasterTCPPortClose(void)
 {
     vQueueDelete(xMbPortConfig.xConnectQueue);
+#if MB_MASTER_TCP_PIPELINE_ENABLED
+    if (xPipeDoneSema) {
+        vSemaphoreDelete(xPipeDoneSema);
+        xPipeDoneSema = NULL;
+    }
+#endif
     vMBMasterPortTimerClose();
     // Release resources for the event queue.
     vMBMasterPortEventClose();
@@ -981,7 +1375,7 @@ BOOL xMBMasterTCPPortSendResponse(UCHAR *pucMBTCPFrame, USHORT usTCPLength)
     // If the slave is correct and active then send data
     // otherwise treat slave as died and skip
     if (pxInfo != NULL) {
-        if (pxInfo->xSockId < 0) {
+        if (pxInfo->xConnState != MB_CONN_DONE) {
             ESP_LOGD(TAG, MB_SLAVE_FMT(", send to died slave, error = %u"),
                                                 (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (unsigned)pxInfo->xError);
         } else {
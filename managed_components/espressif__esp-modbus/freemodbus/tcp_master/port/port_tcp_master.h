@@ -42,6 +42,7 @@
 #include "esp_log.h"
 
 #include "lwip/sys.h"
+#include "lwip/sockets.h"
 #include "freertos/event_groups.h"
 #include "port.h"
 
@@ -61,6 +62,12 @@ PR_BEGIN_EXTERN_C
 
 /* ----------------------- Type definitions ---------------------------------*/
 
+typedef enum {
+    MB_CONN_IDLE = 0,           /*!< Not connected, waits for the next connection attempt */
+    MB_CONN_PENDING,            /*!< Non-blocking connection is in progress */
+    MB_CONN_DONE                /*!< Connected, the socket is polled */
+} eMBPortConnState;
+
 typedef struct {
     int xIndex;                 /*!< Slave information index */
     int xSockId;                /*!< Socket ID of slave */
@@ -75,6 +82,15 @@ typedef struct {
     int64_t xSendTimeStamp;     /*!< Send request time stamp */
     int64_t xRecvTimeStamp;     /*!< Receive response time stamp */
     uint16_t usTidCnt;          /*!< Transaction identifier (TID) for slave */
+    eMBPortConnState xConnState;    /*!< Connection state of the slave socket */
+    int64_t xConnTimeStamp;         /*!< Start of the pending attempt or time of the next attempt */
+    UCHAR ucConnBackoff;            /*!< Number of the reconnection period doublings */
+    struct sockaddr_storage xAddr;  /*!< Cached resolved address of the slave */
+    socklen_t xAddrLen;             /*!< Length of the cached address, 0 if not resolved */
+    int64_t xAddrTimeStamp;         /*!< Resolution time stamp of the cached address */
+#if MB_MASTER_TCP_PIPELINE_ENABLED
+    int xPipeTrans;             /*!< Index of the outstanding pipelined transaction, -1 if none */
+#endif
 } MbSlaveInfo_t;
 
 typedef struct {
@@ -90,6 +106,17 @@ typedef struct {
     MbSlaveInfo_t* pxMbSlaveCurrInfo;   /*!< Master current slave information */
 } MbPortConfig_t;
 
+#if MB_MASTER_TCP_PIPELINE_ENABLED
+typedef struct {
+    UCHAR ucSlaveAddr;                  /*!< Slave short address of the request */
+    UCHAR* pucPdu;                      /*!< Request PDU, replaced by the response PDU */
+    USHORT usPduLen;                    /*!< Length of the request PDU, then of the response PDU */
+    USHORT usPduSize;                   /*!< Size of the PDU buffer */
+    int xResult;                        /*!< ERR_OK, ERR_TIMEOUT, ERR_CONN (slave is not connected),
+                                             ERR_ARG (unknown slave) or ERR_VAL (incorrect frame) */
+} MbTCPTransaction_t;
+#endif
+
 typedef struct {
     USHORT usIndex;                     /*!< index of the address info */
     const char* pcIPAddr;               /*!< represents the IP address of the slave */
@@ -132,6 +159,21 @@ BOOL xMBTCPPortMasterWaitEvent(EventGroupHandle_t xEventHandle, EventBits_t xEve
  */
 void vMBTCPPortMasterSetNetOpt(void* pvNetIf, eMBPortIpVer xIpVersion, eMBPortProto xProto);
 
+#if MB_MASTER_TCP_PIPELINE_ENABLED
+/**
+ * Execute the batch of transactions by the port task, one outstanding transaction per slave
+ *
+ * Must be called while the master FSM is idle (the controller holds its semaphore).
+ * Each transaction waits for the response during the master respond timeout.
+ *
+ * @param pxTrans transactions of the batch
+ * @param usCount number of transactions
+ *
+ * @return TRUE if the batch is executed (see the result of each transaction), else FALSE
+ */
+BOOL xMBTCPPortMasterPipelineRun(MbTCPTransaction_t* pxTrans, USHORT usCount);
+#endif
+
 #ifdef __cplusplus
 PR_END_EXTERN_C
 #endif
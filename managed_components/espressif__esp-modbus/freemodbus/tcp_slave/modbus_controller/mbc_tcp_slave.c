@@ -23,6 +23,15 @@
 
 // Shared pointer to interface structure
 static mb_slave_interface_t* mbs_interface_ptr = NULL;
+#if CONFIG_FMB_STATIC_ALLOCATION
+// The controller objects are kept over a destroy, the next create reuses them
+static mb_slave_interface_t mbs_interface_buf;
+static StaticEventGroup_t mbs_event_group_buf;
+static StaticQueue_t mbs_notification_queue_buf;
+static uint8_t mbs_notification_queue_storage[MB_CONTROLLER_NOTIFY_QUEUE_SIZE * sizeof(mb_param_info_t)];
+static StaticTask_t mbs_task_buf;
+static StackType_t mbs_task_stack[MB_CONTROLLER_STACK_SIZE / sizeof(StackType_t)];
+#endif
 static const char *TAG = "MB_CONTROLLER_SLAVE";
 
 // Modbus task function
@@ -53,7 +62,7 @@ static esp_err_t mbc_tcp_slave_setup(void* comm_info)
     MB_SLAVE_CHECK((comm_info != NULL), ESP_ERR_INVALID_ARG,
                     "mb wrong communication settings.");
     mb_communication_info_t* comm_settings = (mb_communication_info_t*)comm_info;
-    MB_SLAVE_CHECK((comm_settings->ip_mode == MB_MODE_TCP),
+    MB_SLAVE_CHECK(MB_SLAVE_IP_MODE_VALID(comm_settings->ip_mode),
                         ESP_ERR_INVALID_ARG, "mb incorrect mode = (%u).", (unsigned)comm_settings->ip_mode);
     MB_SLAVE_CHECK(((comm_settings->ip_addr_type == MB_IPV4) || (comm_settings->ip_addr_type == MB_IPV6)),
                         ESP_ERR_INVALID_ARG, "mb incorrect addr type = (%u).", (unsigned)comm_settings->ip_addr_type);
@@ -71,15 +80,19 @@ static esp_err_t mbc_tcp_slave_start(void)
     mb_slave_options_t* mbs_opts = &mbs_interface_ptr->opts;
     eMBErrorCode status = MB_EIO;
 
+    // The port task binds the socket as soon as it is started, set the options before
+    eMBPortProto proto = MB_SLAVE_IP_MODE_PROTO(mbs_opts->mbs_comm.ip_mode);
+    eMBPortIpVer ip_ver = (mbs_opts->mbs_comm.ip_addr_type == MB_IPV4) ? MB_PORT_IPV4 : MB_PORT_IPV6;
+    vMBTCPPortSlaveSetNetOpt(mbs_opts->mbs_comm.ip_netif_ptr, ip_ver, proto, (char*)mbs_opts->mbs_comm.ip_addr);
+#if MB_TCP_RTU_ENCAP_ENABLED
+    vMBTCPPortSlaveSetRtuFraming(MB_SLAVE_IP_MODE_RTU(mbs_opts->mbs_comm.ip_mode));
+#endif
+
     // Initialize Modbus stack using mbcontroller parameters
     status = eMBTCPInit((UCHAR)mbs_opts->mbs_comm.slave_uid, (USHORT)mbs_opts->mbs_comm.ip_port);
     MB_SLAVE_CHECK((status == MB_ENOERR), ESP_ERR_INVALID_STATE,
                     "mb stack initialization failure, eMBInit() returns (0x%x).", (int)status);
 
-    eMBPortProto proto = (mbs_opts->mbs_comm.ip_mode == MB_MODE_TCP) ? MB_PROTO_TCP : MB_PROTO_UDP;
-    eMBPortIpVer ip_ver = (mbs_opts->mbs_comm.ip_addr_type == MB_IPV4) ? MB_PORT_IPV4 : MB_PORT_IPV6;
-    vMBTCPPortSlaveSetNetOpt(mbs_opts->mbs_comm.ip_netif_ptr, ip_ver, proto, (char*)mbs_opts->mbs_comm.ip_addr);
-
     status = eMBEnable();
     MB_SLAVE_CHECK((status == MB_ENOERR), ESP_ERR_INVALID_STATE,
                     "mb TCP stack start failure, eMBEnable() returned (0x%x).", (int)status);
@@ -135,7 +148,7 @@ static esp_err_t mbc_tcp_slave_get_param_info(mb_param_info_t* reg_info, uint32_
                     ESP_ERR_INVALID_ARG, "mb queue handle is invalid.");
     MB_SLAVE_CHECK((reg_info != NULL), ESP_ERR_INVALID_ARG, "mb register information is invalid.");
     BaseType_t status = xQueueReceive(mbs_opts->mbs_notification_queue_handle,
-                                        reg_info, pdMS_TO_TICKS(timeout));
+                                        reg_info, MB_PAR_INFO_TO_TICKS(timeout));
     if (status == pdTRUE) {
         err = ESP_OK;
     }
@@ -153,7 +166,11 @@ esp_err_t mbc_tcp_slave_create(void** handler)
 {
     // Allocate space for options
     if (mbs_interface_ptr == NULL) {
+#if CONFIG_FMB_STATIC_ALLOCATION
+        mbs_interface_ptr = &mbs_interface_buf;
+#else
         mbs_interface_ptr = malloc(sizeof(mb_slave_interface_t));
+#endif
     }
     MB_SLAVE_ASSERT(mbs_interface_ptr != NULL);
     mb_slave_options_t* mbs_opts = &mbs_interface_ptr->opts;
@@ -168,16 +185,39 @@ esp_err_t mbc_tcp_slave_create(void** handler)
     BaseType_t status = 0;
 
     // Parameter change notification queue
+#if CONFIG_FMB_STATIC_ALLOCATION
+    mbs_opts->mbs_event_group = xEventGroupCreateStatic(&mbs_event_group_buf);
+#else
     mbs_opts->mbs_event_group = xEventGroupCreate();
+#endif
     MB_SLAVE_CHECK((mbs_opts->mbs_event_group != NULL),
                     ESP_ERR_NO_MEM, "mb event group error.");
     // Parameter change notification queue
+#if CONFIG_FMB_STATIC_ALLOCATION
+    mbs_opts->mbs_notification_queue_handle = xQueueCreateStatic(
+                                                MB_CONTROLLER_NOTIFY_QUEUE_SIZE,
+                                                sizeof(mb_param_info_t),
+                                                mbs_notification_queue_storage,
+                                                &mbs_notification_queue_buf);
+#else
     mbs_opts->mbs_notification_queue_handle = xQueueCreate(
                                                 MB_CONTROLLER_NOTIFY_QUEUE_SIZE,
                                                 sizeof(mb_param_info_t));
+#endif
     MB_SLAVE_CHECK((mbs_opts->mbs_notification_queue_handle != NULL),
                     ESP_ERR_NO_MEM, "mb notify queue creation error.");
     // Create Modbus controller task
+#if CONFIG_FMB_STATIC_ALLOCATION
+    mbs_opts->mbs_task_handle = xTaskCreateStaticPinnedToCore((void*)&modbus_tcp_slave_task,
+                            "mbs_port_tcp_task",
+                            MB_CONTROLLER_STACK_SIZE,
+                            NULL,
+                            MB_CONTROLLER_PRIORITY,
+                            mbs_task_stack,
+                            &mbs_task_buf,
+                            MB_PORT_TASK_AFFINITY);
+    status = (mbs_opts->mbs_task_handle != NULL) ? pdPASS : pdFAIL;
+#else
     status = xTaskCreatePinnedToCore((void*)&modbus_tcp_slave_task,
                             "mbs_port_tcp_task",
                             MB_CONTROLLER_STACK_SIZE,
@@ -185,6 +225,7 @@ esp_err_t mbc_tcp_slave_create(void** handler)
                             MB_CONTROLLER_PRIORITY,
                             &mbs_opts->mbs_task_handle,
                             MB_PORT_TASK_AFFINITY);
+#endif
     if (status != pdPASS) {
         vTaskDelete(mbs_opts->mbs_task_handle);
         MB_SLAVE_CHECK((status == pdPASS), ESP_ERR_NO_MEM,
@@ -56,6 +56,9 @@
 #include "mbframe.h"
 #include "port_tcp_slave.h"
 #include "esp_modbus_common.h"      // for common types for network options
+#if MB_TCP_RTU_ENCAP_ENABLED
+#include "mbcrc.h"
+#endif
 
 #if MB_TCP_ENABLED
 
@@ -63,6 +66,81 @@
 #define MB_TCP_DISCONNECT_TIMEOUT       ( CONFIG_FMB_TCP_CONNECTION_TOUT_SEC * 1000000UL ) // disconnect timeout in uS
 #define MB_TCP_RESP_TIMEOUT_MS          ( MB_MASTER_TIMEOUT_MS_RESPOND - 1 ) // slave response time limit
 #define MB_TCP_NET_LISTEN_BACKLOG       ( SOMAXCONN )
+#define MB_TCP_PIPELINE_MAX             ( 4 ) // requests served per client and poll cycle
+#define MB_TCP_IDLE_SWEEP_MS            ( 100 ) // period of the client timeout check
+#define MB_TCP_KEEPALIVE_IDLE_SEC       ( CONFIG_FMB_TCP_KEEPALIVE_IDLE_SEC )
+
+#if defined(CONFIG_FMB_TCP_RATE_LIMIT) && (CONFIG_FMB_TCP_RATE_LIMIT > 0)
+#define MB_TCP_CLIENT_RATE              ( CONFIG_FMB_TCP_RATE_LIMIT )
+#else
+#define MB_TCP_CLIENT_RATE              ( 0 )
+#endif
+#if defined(CONFIG_FMB_TCP_UNIT_RATE_LIMIT) && (CONFIG_FMB_TCP_UNIT_RATE_LIMIT > 0)
+#define MB_TCP_UNIT_RATE                ( CONFIG_FMB_TCP_UNIT_RATE_LIMIT )
+#define MB_TCP_UNIT_BUCKETS             ( 8 ) // Buckets of the most recently used unit identifiers
+#else
+#define MB_TCP_UNIT_RATE                ( 0 )
+#endif
+#define MB_TCP_RATE_LIMIT_ENABLED       ( ( MB_TCP_CLIENT_RATE > 0 ) || ( MB_TCP_UNIT_RATE > 0 ) )
+#if MB_TCP_RATE_LIMIT_ENABLED
+#define MB_TCP_RATE_BURST               ( CONFIG_FMB_TCP_RATE_BURST * 1000UL ) // Bucket size in 1/1000 of request
+#endif
+
+#if MB_SLAVE_DUAL_TCP_ENABLED
+#define MB_TCP_PROTOCOL_ID              ( 0 ) // Modbus protocol
+#define MB_TCP_DIRECT_TASK_PRIO         ( CONFIG_FMB_SLAVE_DUAL_TCP_TASK_PRIO )
+#define MB_TCP_DIRECT_TASK_AFFINITY     ( ( CONFIG_FMB_SLAVE_DUAL_TCP_TASK_CORE < 0 ) ? \
+                                            tskNO_AFFINITY : CONFIG_FMB_SLAVE_DUAL_TCP_TASK_CORE )
+#define MB_TCP_IS_DIRECT()              ( xConfig.xDirectExec )
+#if MB_TCP_ASYNC_SEND_ENABLED
+// Client slot, connection counter and TID of the request answered by another task
+#define MB_TCP_ASYNC_TAG(pxInfo)        ( ( (ULONG)(pxInfo)->xIndex << 24 ) | ( (ULONG)(pxInfo)->ucConnGen << 16 ) \
+                                            | (pxInfo)->usTidCnt )
+#endif
+#if MB_SLAVE_TCP_FORWARD_ENABLED
+// The datagram peer is overwritten by the next request, the UDP requests are not forwarded
+#define MB_TCP_HAS_FORWARD()            ( ( xConfig.pxForwardCb != NULL ) && !MB_TCP_IS_UDP() )
+#else
+#define MB_TCP_HAS_FORWARD()            ( FALSE )
+#endif
+#if MB_SLAVE_TCP_READ_WORKERS > 0
+// Each connection is served by one worker, so its reads are answered in the order of the requests
+#define MB_TCP_READ_WORKER(pxInfo)      ( (pxInfo)->xIndex % MB_SLAVE_TCP_READ_WORKERS )
+#define MB_TCP_READ_QUEUE_LEN           ( ( MB_TCP_PORT_MAX_CONN + MB_SLAVE_TCP_READ_WORKERS - 1 ) / MB_SLAVE_TCP_READ_WORKERS )
+// The workers copy the registers in critical sections, they stay off the core of the serial port task
+#define MB_TCP_READ_WORKER_AFFINITY     ( ( ( MB_PORT_TASK_AFFINITY != 0 ) && ( MB_PORT_TASK_AFFINITY != 1 ) ) \
+                                            || ( portNUM_PROCESSORS < 2 ) ? tskNO_AFFINITY : ( 1 - MB_PORT_TASK_AFFINITY ) )
+#define MB_TCP_IS_READ(ucFunc)          ( ( (ucFunc) >= MB_FUNC_READ_COILS ) && ( (ucFunc) <= MB_FUNC_READ_INPUT_REGISTER ) )
+#endif
+#else
+#define MB_TCP_IS_DIRECT()              ( FALSE )
+#endif
+
+#define MB_TCP_IS_UDP()                 ( xConfig.eMbProto == MB_PROTO_UDP )
+#define MB_TCP_POOL_SIZE()              ( MB_TCP_IS_UDP() ? 1 : MB_TCP_PORT_MAX_CONN )
+
+#if MB_TCP_RTU_ENCAP_ENABLED
+#define MB_TCP_IS_RTU()                 ( xConfig.xRtuFrames )
+#define MB_TCP_RTU_ADU_MIN              ( 4 ) // Address, function code and CRC
+#define MB_TCP_RTU_ADU_MAX              ( 256 ) // Address, PDU and CRC
+#define MB_TCP_RTU_CRC_SIZE             ( 2 )
+// The address of the RTU frame is received into the UID field, the PDU follows as in the MBAP frame
+#define MB_TCP_RTU_ADU(pucBuf)          ( &(pucBuf)[MB_TCP_UID] )
+#define MB_TCP_FRAME_START()            ( MB_TCP_IS_RTU() ? 2 : MB_TCP_FUNC ) // Bytes to receive first
+#else
+#define MB_TCP_IS_RTU()                 ( FALSE )
+#define MB_TCP_RTU_CRC_SIZE             ( 0 )
+#define MB_TCP_FRAME_START()            ( MB_TCP_FUNC )
+#endif
+
+/* ----------------------- Type definitions ---------------------------------*/
+#if MB_SLAVE_TCP_READ_WORKERS > 0
+typedef struct {
+    ULONG ulTag;                    // MB_TCP_ASYNC_TAG() of the request
+    USHORT usLength;                // Length of the PDU
+    UCHAR ucFrame[MB_TCP_BUF_SIZE + MB_TCP_RTU_CRC_SIZE]; // Request frame, the response is built in place
+} MbTcpReadJob_t;
+#endif
 
 /* ----------------------- Prototypes ---------------------------------------*/
 void vMBPortEventClose( void );
@@ -72,6 +150,44 @@ static const char *TAG = "MB_TCP_SLAVE_PORT";
 static int xListenSock = -1;
 static SemaphoreHandle_t xShutdownSema = NULL;
 static MbSlavePortConfig_t xConfig = { 0 };
+static fd_set xActiveSet;           // Poll set of the listen socket and the connected clients
+static int xMaxSockId = -1;
+static struct sockaddr_storage xUdpPeerAddr; // Sender of the current datagram request (UDP)
+static socklen_t xUdpPeerLen = 0;
+static portMUX_TYPE xClientMux = portMUX_INITIALIZER_UNLOCKED; // Guards the active list for the readers of stats
+#if MB_TCP_UNIT_RATE > 0
+static struct {
+    BOOL xUsed;
+    UCHAR ucUnitId;
+    MbTokenBucket_t xBucket;
+} xUnitBuckets[MB_TCP_UNIT_BUCKETS];
+#endif
+#if MB_SLAVE_TCP_READ_WORKERS > 0
+static QueueHandle_t xReadQueue[MB_SLAVE_TCP_READ_WORKERS] = { NULL };
+static SemaphoreHandle_t xReadDoneSema = NULL; // Given by the workers after each answered read
+static MbTcpReadJob_t xReadJob;     // Queued by the TCP task only
+static ULONG ulWorkerReads = 0;     // Counters of the workers, added to the port counters
+static ULONG ulWorkerExceptions = 0;
+static ULONG ulWorkerErrors = 0;
+#endif
+#if MB_STATIC_ALLOCATION_ENABLED
+static MbClientInfo_t* pxClientInfoBuf[MB_TCP_PORT_MAX_CONN + 1];
+static MbClientInfo_t xClientPoolBuf[MB_TCP_PORT_MAX_CONN];
+static UCHAR ucClientBufPoolBuf[MB_TCP_PORT_MAX_CONN * MB_TCP_BUF_SIZE];
+static StaticTask_t xTcpTaskBuf;
+static StackType_t xTcpTaskStack[MB_TCP_STACK_SIZE / sizeof(StackType_t)];
+static StaticSemaphore_t xShutdownSemaBuf;
+#if MB_TCP_ASYNC_SEND_ENABLED
+static StaticSemaphore_t xSendLockBuf;
+#endif
+#if MB_SLAVE_TCP_READ_WORKERS > 0
+static StaticQueue_t xReadQueueBuf[MB_SLAVE_TCP_READ_WORKERS];
+static UCHAR ucReadQueueStorage[MB_SLAVE_TCP_READ_WORKERS][MB_TCP_READ_QUEUE_LEN * sizeof(MbTcpReadJob_t)];
+static StaticSemaphore_t xReadDoneSemaBuf;
+static StaticTask_t xReadTaskBuf[MB_SLAVE_TCP_READ_WORKERS];
+static StackType_t xReadTaskStack[MB_SLAVE_TCP_READ_WORKERS][MB_TCP_STACK_SIZE / sizeof(StackType_t)];
+#endif
+#endif
 
 /* ----------------------- Static functions ---------------------------------*/
 // The helper function to get time stamp in microseconds
@@ -87,42 +203,322 @@ static void vxMBTCPPortMStoTimeVal(USHORT usTimeoutMs, struct timeval *pxTimeout
     pxTimeout->tv_usec = (usTimeoutMs - (pxTimeout->tv_sec * 1000)) * 1000;
 }
 
-static QueueHandle_t xMBTCPPortRespQueueCreate(void)
+// Tag of the response confirmation: client slot and transaction identifier of the request
+static uint32_t ulMBTCPPortRespTag(const MbClientInfo_t* pxClientInfo)
 {
-    QueueHandle_t xRespQueueHandle = xQueueCreate(2, sizeof(void*));
-    MB_PORT_CHECK((xRespQueueHandle != NULL), NULL, "TCP respond queue creation failure.");
-    return xRespQueueHandle;
+    return ((uint32_t)pxClientInfo->xIndex << 16) | pxClientInfo->usTidCnt;
 }
 
-static void vMBTCPPortRespQueueDelete(QueueHandle_t xRespQueueHandle)
+// Confirm to the server task that the stack has processed the current request
+static void vMBTCPPortRespNotify(uint32_t ulTag)
 {
-    vQueueDelete(xRespQueueHandle);
+    if (xConfig.xMbTcpTaskHandle) {
+        (void)xTaskNotify(xConfig.xMbTcpTaskHandle, ulTag, eSetValueWithOverwrite);
+    }
 }
 
-static void* vxMBTCPPortRespQueueRecv(QueueHandle_t xRespQueueHandle)
+// Wait for the confirmation of the response, returns FALSE if the stack did not process the request
+static BOOL xMBTCPPortRespWait(const MbClientInfo_t* pxClientInfo)
 {
-    void* pvResp = NULL;
-    MB_PORT_CHECK(xRespQueueHandle != NULL, NULL, "Response queue is not initialized.");
-    BaseType_t xStatus = xQueueReceive(xRespQueueHandle,
-                                        (void*)&pvResp,
-                                        pdMS_TO_TICKS(MB_TCP_RESP_TIMEOUT_MS));
-    if (xStatus != pdTRUE) {
+    uint32_t ulTag = 0;
+    if (xTaskNotifyWait(0, UINT32_MAX, &ulTag, pdMS_TO_TICKS(MB_TCP_RESP_TIMEOUT_MS)) != pdTRUE) {
         ESP_LOGD(TAG, "Could not get respond confirmation.");
+        return FALSE;
     }
-    return pvResp;
+    if (ulTag != ulMBTCPPortRespTag(pxClientInfo)) {
+        ESP_LOGE(TAG, "Sent TID(%x) != Recv TID(%x), ignore packet.",
+                                            (int)(ulTag & 0xFFFF), (int)pxClientInfo->usTidCnt);
+    }
+    return TRUE;
 }
 
-static BOOL vxMBTCPPortRespQueueSend(QueueHandle_t xRespQueueHandle, void* pvResp)
+// Apply the socket options of the accepted connection
+static void vMBTCPPortSetSockOpts(int xSockId)
 {
-    MB_PORT_CHECK(xRespQueueHandle != NULL, FALSE, "Response queue is not initialized.");
-    BaseType_t xStatus = xQueueSend(xConfig.xRespQueueHandle,
-                                    (const void*)&pvResp,
-                                    pdMS_TO_TICKS(MB_TCP_RESP_TIMEOUT_MS));
-    MB_PORT_CHECK((xStatus == pdTRUE), FALSE, "FAIL to send to response queue.");
-    return TRUE;
+    int xPar = 1;
+    struct timeval xTimeVal;
+
+    // The responses are complete frames, disable Nagle's algorithm
+    if (setsockopt(xSockId, IPPROTO_TCP, TCP_NODELAY, &xPar, sizeof(xPar)) != 0) {
+        ESP_LOGW(TAG, "Socket (#%d), TCP_NODELAY failed: errno %u", (int)xSockId, (unsigned)errno);
+    }
+    // The send blocks at most for the send timeout instead of a select() before each send
+    vxMBTCPPortMStoTimeVal(MB_TCP_SEND_TIMEOUT_MS, &xTimeVal);
+    if (setsockopt(xSockId, SOL_SOCKET, SO_SNDTIMEO, &xTimeVal, sizeof(xTimeVal)) != 0) {
+        ESP_LOGW(TAG, "Socket (#%d), SO_SNDTIMEO failed: errno %u", (int)xSockId, (unsigned)errno);
+    }
+#if MB_TCP_KEEPALIVE_IDLE_SEC > 0
+    // Detect the half-open connections of the clients which disappeared without closing
+    int xIdle = MB_TCP_KEEPALIVE_IDLE_SEC;
+    int xIntvl = CONFIG_FMB_TCP_KEEPALIVE_INTVL_SEC;
+    int xCount = CONFIG_FMB_TCP_KEEPALIVE_COUNT;
+    if ((setsockopt(xSockId, SOL_SOCKET, SO_KEEPALIVE, &xPar, sizeof(xPar)) != 0)
+            || (setsockopt(xSockId, IPPROTO_TCP, TCP_KEEPIDLE, &xIdle, sizeof(xIdle)) != 0)
+            || (setsockopt(xSockId, IPPROTO_TCP, TCP_KEEPINTVL, &xIntvl, sizeof(xIntvl)) != 0)
+            || (setsockopt(xSockId, IPPROTO_TCP, TCP_KEEPCNT, &xCount, sizeof(xCount)) != 0)) {
+        ESP_LOGW(TAG, "Socket (#%d), TCP keepalive failed: errno %u", (int)xSockId, (unsigned)errno);
+    }
+#endif
+}
+
+// The forwarded and worker responses are sent from other tasks, the sends and the close are serialized
+static void vMBTCPPortSendLock(void)
+{
+#if MB_TCP_ASYNC_SEND_ENABLED
+    if (xConfig.xSendLock) {
+        (void)xSemaphoreTake(xConfig.xSendLock, portMAX_DELAY);
+    }
+#endif
+}
+
+static void vMBTCPPortSendUnlock(void)
+{
+#if MB_TCP_ASYNC_SEND_ENABLED
+    if (xConfig.xSendLock) {
+        (void)xSemaphoreGive(xConfig.xSendLock);
+    }
+#endif
 }
 
+// Send the frame to the client, the datagram response goes to the sender of the request.
+// In RTU framing the MBAP header is dropped and the CRC is appended behind the PDU.
+static int xMBTCPPortSend(const MbClientInfo_t* pxClientInfo, UCHAR* pucFrame, USHORT usLength)
+{
+#if MB_TCP_RTU_ENCAP_ENABLED
+    if (MB_TCP_IS_RTU()) {
+        if (pucFrame[MB_TCP_UID] == MB_ADDRESS_BROADCAST) {
+            return usLength; // The broadcast requests are not answered
+        }
+        pucFrame = MB_TCP_RTU_ADU(pucFrame);
+        usLength -= MB_TCP_UID;
+        USHORT usCRC16 = usMBCRC16(pucFrame, usLength);
+        pucFrame[usLength++] = (UCHAR)(usCRC16 & 0xFF);
+        pucFrame[usLength++] = (UCHAR)(usCRC16 >> 8);
+    }
+#endif
+    if (MB_TCP_IS_UDP()) {
+        return sendto(pxClientInfo->xSockId, pucFrame, usLength, 0,
+                        (struct sockaddr *)&xUdpPeerAddr, xUdpPeerLen);
+    }
+    return send(pxClientInfo->xSockId, pucFrame, usLength, 0);
+}
+
+#if MB_TCP_ASYNC_SEND_ENABLED
+// Send the response of another task if the client of the tagged request is still connected.
+// The answered read is removed from the pending reads of the connection after the send.
+static BOOL xMBTCPPortSendTagged(ULONG ulTag, UCHAR* pucFrame, USHORT usLength, BOOL xRead)
+{
+    int xIndex = (int)(ulTag >> 24);
+    BOOL xSent = FALSE;
+
+    vMBTCPPortSendLock();
+    MbClientInfo_t* pxClientInfo = (xConfig.pxClientPool && (xIndex < MB_TCP_POOL_SIZE()))
+                                        ? &xConfig.pxClientPool[xIndex] : NULL;
+    // The client could be disconnected and the slot taken by another connection meanwhile
+    if (pxClientInfo && (pxClientInfo->xSockId >= 0)
+            && (pxClientInfo->ucConnGen == (UCHAR)((ulTag >> 16) & 0xFF))) {
+        vMBPortTraceFrame(MB_TRACE_TX | MB_TRACE_TCP, pucFrame, usLength);
+        xSent = (xMBTCPPortSend(pxClientInfo, pucFrame, usLength) >= 0);
+        if (!xSent) {
+            ESP_LOGE(TAG, "Socket(#%d), fail to send response, errno = %u",
+                        (int)pxClientInfo->xSockId, (unsigned)errno);
+        }
+#if MB_SLAVE_TCP_READ_WORKERS > 0
+        ULONG ulPending = __atomic_load_n(&pxClientInfo->ulReadsPending, __ATOMIC_RELAXED);
+        while (xRead && (ulPending > 0)
+                && !__atomic_compare_exchange_n(&pxClientInfo->ulReadsPending, &ulPending, ulPending - 1,
+                                                FALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+#endif
+    }
+    vMBTCPPortSendUnlock();
+    (void)xRead;
+    return xSent;
+}
+#endif
+
 static void vMBTCPPortServerTask(void *pvParameters);
+static void vMBTCPPortFreeClients(void);
+
+#if MB_SLAVE_TCP_READ_WORKERS > 0
+// Execute the queued reads against the register areas and send the responses
+static void vMBTCPPortReadTask(void *pvParameters)
+{
+    QueueHandle_t xQueue = (QueueHandle_t)pvParameters;
+    MbTcpReadJob_t xJob;
+
+    for (;;) {
+        if (xQueueReceive(xQueue, &xJob, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        USHORT usLength = xJob.usLength;
+        if (eMBExecutePDU(&xJob.ucFrame[MB_TCP_FUNC], &usLength) != MB_EX_NONE) {
+            __atomic_fetch_add(&ulWorkerExceptions, 1, __ATOMIC_RELAXED);
+        }
+        __atomic_fetch_add(&ulWorkerReads, 1, __ATOMIC_RELAXED);
+        xJob.ucFrame[MB_TCP_LEN] = (UCHAR)((usLength + 1) >> 8U);
+        xJob.ucFrame[MB_TCP_LEN + 1] = (UCHAR)((usLength + 1) & 0xFF);
+        if (!xMBTCPPortSendTagged(xJob.ulTag, xJob.ucFrame, usLength + MB_TCP_FUNC, TRUE)) {
+            __atomic_fetch_add(&ulWorkerErrors, 1, __ATOMIC_RELAXED);
+        }
+        (void)xSemaphoreGive(xReadDoneSema);
+    }
+}
+
+// The queues and the workers are created once and kept over restarts of the port,
+// a worker which could not be created is created by the next start
+static BOOL xMBTCPPortStartReadWorkers(void)
+{
+    if (!xReadDoneSema) {
+#if MB_STATIC_ALLOCATION_ENABLED
+        xReadDoneSema = xSemaphoreCreateBinaryStatic(&xReadDoneSemaBuf);
+#else
+        xReadDoneSema = xSemaphoreCreateBinary();
+#endif
+    }
+    MB_PORT_CHECK((xReadDoneSema != NULL), FALSE, "TCP read semaphore creation failure.");
+    for (int i = 0; i < MB_SLAVE_TCP_READ_WORKERS; i++) {
+        if (xReadQueue[i]) {
+            continue;
+        }
+#if MB_STATIC_ALLOCATION_ENABLED
+        xReadQueue[i] = xQueueCreateStatic(MB_TCP_READ_QUEUE_LEN, sizeof(MbTcpReadJob_t),
+                                           ucReadQueueStorage[i], &xReadQueueBuf[i]);
+        MB_PORT_CHECK((xReadQueue[i] != NULL), FALSE, "TCP read queue creation failure.");
+        TaskHandle_t xTask = xTaskCreateStaticPinnedToCore(vMBTCPPortReadTask,
+                                        "tcp_read_task",
+                                        MB_TCP_STACK_SIZE,
+                                        (void *)xReadQueue[i],
+                                        MB_TCP_DIRECT_TASK_PRIO,
+                                        xReadTaskStack[i],
+                                        &xReadTaskBuf[i],
+                                        MB_TCP_READ_WORKER_AFFINITY);
+        BaseType_t xErr = (xTask != NULL) ? pdTRUE : pdFALSE;
+#else
+        xReadQueue[i] = xQueueCreate(MB_TCP_READ_QUEUE_LEN, sizeof(MbTcpReadJob_t));
+        MB_PORT_CHECK((xReadQueue[i] != NULL), FALSE, "TCP read queue creation failure.");
+        BaseType_t xErr = xTaskCreatePinnedToCore(vMBTCPPortReadTask,
+                                        "tcp_read_task",
+                                        MB_TCP_STACK_SIZE,
+                                        (void *)xReadQueue[i],
+                                        MB_TCP_DIRECT_TASK_PRIO,
+                                        NULL,
+                                        MB_TCP_READ_WORKER_AFFINITY);
+#endif
+        if (xErr != pdTRUE) {
+            // No connection is queued to the queue without its worker
+            vQueueDelete(xReadQueue[i]);
+            xReadQueue[i] = NULL;
+        }
+        MB_PORT_CHECK((xErr == pdTRUE), FALSE, "TCP read worker creation failure.");
+    }
+    return TRUE;
+}
+
+// Wait until the queued reads of the connection are answered
+static void vMBTCPPortWaitReads(MbClientInfo_t *pxClientInfo)
+{
+    while (__atomic_load_n(&pxClientInfo->ulReadsPending, __ATOMIC_ACQUIRE) > 0) {
+        if (xSemaphoreTake(xReadDoneSema, pdMS_TO_TICKS(MB_TCP_RESP_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGW(TAG, "Socket (#%d), queued reads are not answered.", (int)pxClientInfo->xSockId);
+            break;
+        }
+    }
+}
+
+// Queue the read request to the worker of the connection, returns FALSE if the TCP task executes
+// the request. Any request executed by the TCP task waits until the queued reads of the connection
+// are answered, so the client gets the responses in the order of its requests.
+static BOOL xMBTCPPortDispatchRead(MbClientInfo_t *pxClientInfo, const UCHAR* pucFrame, USHORT usLength)
+{
+    QueueHandle_t xQueue = xReadQueue[MB_TCP_READ_WORKER(pxClientInfo)];
+
+    if (MB_TCP_IS_UDP() || (xQueue == NULL)) {
+        return FALSE;
+    }
+    if (!MB_TCP_IS_READ(pucFrame[MB_TCP_FUNC])) {
+        vMBTCPPortWaitReads(pxClientInfo);
+        return FALSE;
+    }
+    xReadJob.ulTag = MB_TCP_ASYNC_TAG(pxClientInfo);
+    xReadJob.usLength = usLength;
+    memcpy(xReadJob.ucFrame, pucFrame, usLength + MB_TCP_FUNC);
+    __atomic_fetch_add(&pxClientInfo->ulReadsPending, 1, __ATOMIC_RELAXED);
+    if (xQueueSend(xQueue, &xReadJob, 0) != pdTRUE) {
+        // The worker is busy, the read is answered by the TCP task after the queued ones
+        __atomic_fetch_sub(&pxClientInfo->ulReadsPending, 1, __ATOMIC_RELAXED);
+        vMBTCPPortWaitReads(pxClientInfo);
+        return FALSE;
+    }
+    return TRUE;
+}
+#endif
+
+#if MB_SLAVE_DUAL_TCP_ENABLED
+// Execute the request in the client buffer and send the response built in the same buffer
+static void vMBTCPPortExecute(MbClientInfo_t *pxClientInfo)
+{
+    UCHAR* pucFrame = pxClientInfo->pucTCPBuf;
+    USHORT usLength = pxClientInfo->usTCPBufPos - MB_TCP_FUNC;
+
+    vMBPortTraceFrame(MB_TRACE_RX | MB_TRACE_TCP, pucFrame, pxClientInfo->usTCPBufPos);
+    // Prepare the buffer for the next request
+    pxClientInfo->usTCPBufPos = 0;
+    pxClientInfo->usTCPFrameBytesLeft = MB_TCP_FRAME_START();
+    xConfig.xStats.ulRequests++;
+
+    BOOL xForeignUnit = FALSE;
+    // The RTU address is always checked, the broadcast request is executed without response
+    BOOL xCheckUnit = MB_TCP_IS_RTU();
+#if MB_TCP_UID_ENABLED
+    xCheckUnit = TRUE;
+#endif
+    if (xCheckUnit) {
+        UCHAR ucAnyUnit = MB_TCP_IS_RTU() ? MB_ADDRESS_BROADCAST : MB_TCP_PSEUDO_ADDRESS;
+        xForeignUnit = (pucFrame[MB_TCP_UID] != xConfig.ucUnitId) && (pucFrame[MB_TCP_UID] != ucAnyUnit);
+    }
+    if ((MB_TCP_GET_FIELD(pucFrame, MB_TCP_PID) != MB_TCP_PROTOCOL_ID) || (usLength == 0)
+        || (xForeignUnit && !MB_TCP_HAS_FORWARD())) {
+        ESP_LOGD(TAG, "Socket (#%d), request is ignored.", (int)pxClientInfo->xSockId);
+        xConfig.xStats.ulErrors++;
+        return;
+    }
+    if (xForeignUnit) {
+#if MB_SLAVE_TCP_FORWARD_ENABLED
+        // The response is sent by xMBTCPPortForwardDone() when the handler takes the request
+        xConfig.xStats.ulForwarded++;
+        if (xConfig.pxForwardCb(MB_TCP_ASYNC_TAG(pxClientInfo), pucFrame[MB_TCP_UID],
+                                &pucFrame[MB_TCP_FUNC], usLength, xConfig.pvForwardArg)) {
+            return;
+        }
+        pucFrame[MB_TCP_FUNC] |= MB_FUNC_ERROR;
+        pucFrame[MB_TCP_FUNC + 1] = MB_EX_GATEWAY_PATH_FAILED;
+        usLength = 2;
+        xConfig.xStats.ulExceptions++;
+#endif
+#if MB_SLAVE_TCP_READ_WORKERS > 0
+    } else if (xMBTCPPortDispatchRead(pxClientInfo, pucFrame, usLength)) {
+        // The response is sent by the read worker
+        return;
+#endif
+    } else if (eMBExecutePDU(&pucFrame[MB_TCP_FUNC], &usLength) != MB_EX_NONE) {
+        xConfig.xStats.ulExceptions++;
+    }
+    // The TID and UID of the request are kept, the length includes the UID
+    pucFrame[MB_TCP_LEN] = (UCHAR)((usLength + 1) >> 8U);
+    pucFrame[MB_TCP_LEN + 1] = (UCHAR)((usLength + 1) & 0xFF);
+    vMBPortTraceFrame(MB_TRACE_TX | MB_TRACE_TCP, pucFrame, usLength + MB_TCP_FUNC);
+    vMBTCPPortSendLock();
+    int xErr = xMBTCPPortSend(pxClientInfo, pucFrame, usLength + MB_TCP_FUNC);
+    vMBTCPPortSendUnlock();
+    if (xErr < 0) {
+        ESP_LOGE(TAG, "Socket(#%d), fail to send data, errno = %u",
+                    (int)pxClientInfo->xSockId, (unsigned)errno);
+        pxClientInfo->xError = ERR_CONN;
+        xConfig.xStats.ulErrors++;
+    }
+}
+#endif
 
 /* ----------------------- Begin implementation -----------------------------*/
 BOOL
@@ -130,34 +526,65 @@ xMBTCPPortInit( USHORT usTCPPort )
 {
     BOOL bOkay = FALSE;
 
-    xConfig.pxMbClientInfo = calloc(MB_TCP_PORT_MAX_CONN + 1, sizeof(MbClientInfo_t*));
-    if (!xConfig.pxMbClientInfo) {
+    // The client slots and buffers are allocated once, the connections only take and return them.
+    // The UDP port serves all requests on one socket with the buffer of the first slot.
+    vMBTCPPortFreeClients();
+#if MB_STATIC_ALLOCATION_ENABLED
+    memset(pxClientInfoBuf, 0, sizeof(pxClientInfoBuf));
+    memset(xClientPoolBuf, 0, sizeof(xClientPoolBuf));
+    memset(ucClientBufPoolBuf, 0, sizeof(ucClientBufPoolBuf));
+    xConfig.pxMbClientInfo = pxClientInfoBuf;
+    xConfig.pxClientPool = xClientPoolBuf;
+    xConfig.pucClientBufPool = ucClientBufPoolBuf;
+#else
+    xConfig.pxMbClientInfo = calloc(MB_TCP_POOL_SIZE() + 1, sizeof(MbClientInfo_t*));
+    xConfig.pxClientPool = calloc(MB_TCP_POOL_SIZE(), sizeof(MbClientInfo_t));
+    xConfig.pucClientBufPool = calloc(MB_TCP_POOL_SIZE(), MB_TCP_BUF_SIZE);
+#endif
+    if (!xConfig.pxMbClientInfo || !xConfig.pxClientPool || !xConfig.pucClientBufPool) {
         ESP_LOGE(TAG, "TCP client info allocation failure.");
+        vMBTCPPortFreeClients();
         return FALSE;
     }
-    for(int idx = 0; idx < MB_TCP_PORT_MAX_CONN; xConfig.pxMbClientInfo[idx] = NULL, idx++);
-
-    xConfig.xRespQueueHandle = xMBTCPPortRespQueueCreate();
-    if (!xConfig.xRespQueueHandle) {
-        ESP_LOGE(TAG, "Response queue allocation failure.");
-        return FALSE;
+    for (int idx = 0; idx < MB_TCP_POOL_SIZE(); idx++) {
+        xConfig.pxClientPool[idx].xIndex = idx;
+        xConfig.pxClientPool[idx].xSockId = -1;
+        xConfig.pxClientPool[idx].pucTCPBuf = &xConfig.pucClientBufPool[idx * MB_TCP_BUF_SIZE];
     }
+    FD_ZERO(&xActiveSet);
+    xMaxSockId = -1;
 
+    // The network options are set by vMBTCPPortSlaveSetNetOpt() before the port is started
     xConfig.usPort = usTCPPort;
-    xConfig.eMbProto = MB_PROTO_TCP;
     xConfig.usClientCount = 0;
-    xConfig.pvNetIface = NULL;
-    xConfig.xIpVer = MB_PORT_IPV4;
-    xConfig.pcBindAddr = NULL;
 
     // Create task for packet processing
+#if MB_SLAVE_DUAL_TCP_ENABLED
+    UBaseType_t uxPriority = xConfig.xDirectExec ? MB_TCP_DIRECT_TASK_PRIO : MB_TCP_TASK_PRIO;
+    BaseType_t xCoreId = xConfig.xDirectExec ? MB_TCP_DIRECT_TASK_AFFINITY : MB_PORT_TASK_AFFINITY;
+#else
+    UBaseType_t uxPriority = MB_TCP_TASK_PRIO;
+    BaseType_t xCoreId = MB_PORT_TASK_AFFINITY;
+#endif
+#if MB_STATIC_ALLOCATION_ENABLED
+    xConfig.xMbTcpTaskHandle = xTaskCreateStaticPinnedToCore(vMBTCPPortServerTask,
+                                    "tcp_slave_task",
+                                    MB_TCP_STACK_SIZE,
+                                    NULL,
+                                    uxPriority,
+                                    xTcpTaskStack,
+                                    &xTcpTaskBuf,
+                                    xCoreId);
+    BaseType_t xErr = (xConfig.xMbTcpTaskHandle != NULL) ? pdTRUE : pdFALSE;
+#else
     BaseType_t xErr = xTaskCreatePinnedToCore(vMBTCPPortServerTask,
                                     "tcp_slave_task",
                                     MB_TCP_STACK_SIZE,
                                     NULL,
-                                    MB_TCP_TASK_PRIO,
+                                    uxPriority,
                                     &xConfig.xMbTcpTaskHandle,
-                                    MB_PORT_TASK_AFFINITY);
+                                    xCoreId);
+#endif
     if (xErr != pdTRUE)
     {
         ESP_LOGE(TAG, "Server task creation failure.");
@@ -169,6 +596,115 @@ xMBTCPPortInit( USHORT usTCPPort )
     return bOkay;
 }
 
+#if MB_SLAVE_DUAL_TCP_ENABLED
+BOOL xMBTCPPortInitDirect(USHORT usTCPPort, UCHAR ucUnitId)
+{
+#if MB_TCP_ASYNC_SEND_ENABLED
+    // The lock is kept over restarts of the port, a late response may still wait for it
+    if (!xConfig.xSendLock) {
+#if MB_STATIC_ALLOCATION_ENABLED
+        xConfig.xSendLock = xSemaphoreCreateMutexStatic(&xSendLockBuf);
+#else
+        xConfig.xSendLock = xSemaphoreCreateMutex();
+#endif
+        MB_PORT_CHECK((xConfig.xSendLock != NULL), FALSE, "TCP send lock creation failure.");
+    }
+#endif
+#if MB_SLAVE_TCP_READ_WORKERS > 0
+    if (!xMBTCPPortStartReadWorkers()) {
+        return FALSE;
+    }
+    __atomic_store_n(&ulWorkerReads, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ulWorkerExceptions, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ulWorkerErrors, 0, __ATOMIC_RELAXED);
+#endif
+    xConfig.xDirectExec = TRUE;
+    xConfig.ucUnitId = ucUnitId;
+    memset(&xConfig.xStats, 0, sizeof(xConfig.xStats));
+    return xMBTCPPortInit(usTCPPort);
+}
+
+void vMBTCPPortGetStats(MbSlavePortStats_t* pxStats)
+{
+    *pxStats = xConfig.xStats;
+    pxStats->usClients = xConfig.usClientCount;
+#if MB_SLAVE_TCP_READ_WORKERS > 0
+    pxStats->ulWorkerReads = __atomic_load_n(&ulWorkerReads, __ATOMIC_RELAXED);
+    pxStats->ulExceptions += __atomic_load_n(&ulWorkerExceptions, __ATOMIC_RELAXED);
+    pxStats->ulErrors += __atomic_load_n(&ulWorkerErrors, __ATOMIC_RELAXED);
+#endif
+}
+
+// Convert the age of the time stamp to milliseconds
+static ULONG ulMBTCPPortAgeMs(int64_t xTimeNow, int64_t xTimeStamp)
+{
+    int64_t xAge = (xTimeNow - xTimeStamp) / 1000;
+    return (xAge > (int64_t)(UINT32_MAX - 1)) ? (UINT32_MAX - 1) : (ULONG)xAge;
+}
+
+USHORT usMBTCPPortGetClients(USHORT usFirst, MbSlavePortClientStats_t* pxClients, USHORT usMax)
+{
+    USHORT usCount = 0;
+    int64_t xTimeNow = xMBTCPGetTimeStamp();
+
+    portENTER_CRITICAL(&xClientMux);
+    for (USHORT i = 0; (i < xConfig.usClientCount) && (usCount < usMax); i++) {
+        const MbClientInfo_t* pxClientInfo = xConfig.pxMbClientInfo[i];
+        // The client which is being closed is still in the list
+        if ((pxClientInfo == NULL) || (pxClientInfo->xSockId < 0)) {
+            continue;
+        }
+        if (usFirst) {
+            usFirst--;
+            continue;
+        }
+        MbSlavePortClientStats_t* pxStats = &pxClients[usCount++];
+        memcpy(pxStats->cIpAddr, pxClientInfo->cIpAddr, sizeof(pxStats->cIpAddr));
+        pxStats->ulConnectedMs = ulMBTCPPortAgeMs(xTimeNow, pxClientInfo->xConnTimeStamp);
+        pxStats->ulIdleMs = ulMBTCPPortAgeMs(xTimeNow, pxClientInfo->xRecvTimeStamp);
+        pxStats->ulLastRequestMs = pxClientInfo->xReqTimeStamp
+                                    ? ulMBTCPPortAgeMs(xTimeNow, pxClientInfo->xReqTimeStamp) : UINT32_MAX;
+        pxStats->ulRequests = pxClientInfo->ulRequests;
+        pxStats->ulThrottled = pxClientInfo->ulThrottled;
+    }
+    portEXIT_CRITICAL(&xClientMux);
+    return usCount;
+}
+#endif
+
+#if MB_SLAVE_TCP_FORWARD_ENABLED
+void vMBTCPPortSetForward(pxMBTCPForwardCB pxCb, void* pvArg)
+{
+    vMBTCPPortSendLock();
+    xConfig.pvForwardArg = pvArg;
+    xConfig.pxForwardCb = pxCb;
+    vMBTCPPortSendUnlock();
+}
+
+BOOL xMBTCPPortForwardDone(ULONG ulTag, UCHAR ucUnitId, const UCHAR* pucPdu, USHORT usLength)
+{
+    UCHAR ucFrame[MB_TCP_BUF_SIZE + MB_TCP_RTU_CRC_SIZE];
+
+    MB_PORT_CHECK((pucPdu != NULL) && (usLength > 0) && (usLength <= (MB_TCP_BUF_SIZE - MB_TCP_FUNC)),
+                    FALSE, "Incorrect forwarded response.");
+    // The MBAP header of the request: TID from the tag, Modbus protocol, length and UID
+    ucFrame[MB_TCP_TID] = (UCHAR)((ulTag >> 8U) & 0xFF);
+    ucFrame[MB_TCP_TID + 1] = (UCHAR)(ulTag & 0xFF);
+    ucFrame[MB_TCP_PID] = 0;
+    ucFrame[MB_TCP_PID + 1] = 0;
+    ucFrame[MB_TCP_LEN] = (UCHAR)((usLength + 1) >> 8U);
+    ucFrame[MB_TCP_LEN + 1] = (UCHAR)((usLength + 1) & 0xFF);
+    ucFrame[MB_TCP_UID] = ucUnitId;
+    memcpy(&ucFrame[MB_TCP_FUNC], pucPdu, usLength);
+
+    BOOL xSent = xMBTCPPortSendTagged(ulTag, ucFrame, usLength + MB_TCP_FUNC, FALSE);
+    if (!xSent) {
+        xConfig.xStats.ulErrors++;
+    }
+    return xSent;
+}
+#endif
+
 void vMBTCPPortSlaveSetNetOpt(void* pvNetIf, eMBPortIpVer xIpVersion, eMBPortProto xProto, CHAR* pcBindAddrStr)
 {
     // Set network options
@@ -178,44 +714,43 @@ void vMBTCPPortSlaveSetNetOpt(void* pvNetIf, eMBPortIpVer xIpVersion, eMBPortPro
     xConfig.pcBindAddr = pcBindAddrStr;
 }
 
-static int xMBTCPPortAcceptConnection(int xListenSockId, char** pcIPAddr)
+#if MB_TCP_RTU_ENCAP_ENABLED
+void vMBTCPPortSlaveSetRtuFraming(BOOL xRtuFrames)
+{
+    xConfig.xRtuFrames = xRtuFrames;
+}
+#endif
+
+static int xMBTCPPortAcceptConnection(int xListenSockId, CHAR* pcIPAddr, size_t xAddrLen)
 {
     MB_PORT_CHECK(pcIPAddr, -1, "Wrong IP address pointer.");
     MB_PORT_CHECK((xListenSockId > 0), -1, "Incorrect listen socket ID.");
 
     // Address structure large enough for both IPv4 or IPv6 address
     struct sockaddr_storage xSrcAddr;
-    CHAR cAddrStr[128];
     int xSockId = -1;
-    CHAR* pcStr = NULL;
     socklen_t xSize = sizeof(struct sockaddr_storage);
 
     // Accept new socket connection if not active
     xSockId = accept(xListenSockId, (struct sockaddr *)&xSrcAddr, &xSize);
     if (xSockId < 0) {
         ESP_LOGE(TAG, "Unable to accept connection: errno=%u", (unsigned)errno);
-        close(xSockId);
     } else {
         // Get the sender's ip address as string
         if (xSrcAddr.ss_family == PF_INET) {
-            inet_ntoa_r(((struct sockaddr_in *)&xSrcAddr)->sin_addr.s_addr, cAddrStr, sizeof(cAddrStr) - 1);
+            inet_ntoa_r(((struct sockaddr_in *)&xSrcAddr)->sin_addr.s_addr, pcIPAddr, xAddrLen - 1);
         }
 #if CONFIG_LWIP_IPV6
         else if (xSrcAddr.ss_family == PF_INET6) {
-            inet6_ntoa_r(((struct sockaddr_in6 *)&xSrcAddr)->sin6_addr, cAddrStr, sizeof(cAddrStr) - 1);
+            inet6_ntoa_r(((struct sockaddr_in6 *)&xSrcAddr)->sin6_addr, pcIPAddr, xAddrLen - 1);
         }
 #endif
         else {
             // Make sure ss_family is valid
             abort();
         }
-        ESP_LOGI(TAG, "Socket (#%d), accept client connection from address: %s", (int)xSockId, cAddrStr);
-        pcStr = calloc(1, strlen(cAddrStr) + 1);
-        if (pcStr && pcIPAddr) {
-            memcpy(pcStr, cAddrStr, strlen(cAddrStr));
-            pcStr[strlen(cAddrStr)] = '\0';
-            *pcIPAddr = pcStr; // Set IP address of connected client
-        }
+        pcIPAddr[xAddrLen - 1] = '\0';
+        ESP_LOGI(TAG, "Socket (#%d), accept client connection from address: %s", (int)xSockId, pcIPAddr);
     }
     return xSockId;
 }
@@ -236,8 +771,18 @@ static BOOL xMBTCPPortCloseConnection(MbClientInfo_t* pxInfo)
     {
         ESP_LOGE(TAG, "Socket (#%d), shutdown failed: errno %u", (int)pxInfo->xSockId, (unsigned)errno);
     }
+    vMBTCPPortSendLock();
     close(pxInfo->xSockId);
+    FD_CLR(pxInfo->xSockId, &xActiveSet);
     pxInfo->xSockId = -1;
+#if MB_TCP_ASYNC_SEND_ENABLED
+    pxInfo->ucConnGen++;
+#endif
+#if MB_SLAVE_TCP_READ_WORKERS > 0
+    // The responses of the queued reads are dropped by the connection counter
+    __atomic_store_n(&pxInfo->ulReadsPending, 0, __ATOMIC_RELAXED);
+#endif
+    vMBTCPPortSendUnlock();
     if (xConfig.usClientCount) {
         xConfig.usClientCount--; // decrement counter of client connections
     } else {
@@ -246,124 +791,258 @@ static BOOL xMBTCPPortCloseConnection(MbClientInfo_t* pxInfo)
     return TRUE;
 }
 
-static void vMBTCPPortFreeClientInfo(MbClientInfo_t *pxClientInfo)
+// Take a free client slot from the pool and register the accepted socket in the poll set
+static MbClientInfo_t* pxMBTCPPortAddClient(int xSockId, const CHAR* pcIpAddr)
 {
-    if (pxClientInfo) {
-        if (pxClientInfo->pucTCPBuf) {
-            free((void *)pxClientInfo->pucTCPBuf);
-        }
-        if (pxClientInfo->pcIpAddr) {
-            free((void *)pxClientInfo->pcIpAddr);
+    MbClientInfo_t* pxClientInfo = NULL;
+
+    for (int i = 0; i < MB_TCP_POOL_SIZE(); i++) {
+        if (xConfig.pxClientPool[i].xSockId < 0) {
+            pxClientInfo = &xConfig.pxClientPool[i];
+            break;
         }
-        free((void *)pxClientInfo);
     }
+    if (pxClientInfo) {
+        pxClientInfo->xSockId = xSockId;
+        pxClientInfo->xError = 0;
+        pxClientInfo->usTCPBufPos = 0;
+        pxClientInfo->usTCPFrameBytesLeft = MB_TCP_FRAME_START();
+        pxClientInfo->usTidCnt = 0;
+        pxClientInfo->xRecvTimeStamp = xMBTCPGetTimeStamp();
+        pxClientInfo->xSendTimeStamp = pxClientInfo->xRecvTimeStamp;
+        pxClientInfo->xConnTimeStamp = pxClientInfo->xRecvTimeStamp;
+        pxClientInfo->xReqTimeStamp = 0;
+        pxClientInfo->ulRequests = 0;
+        pxClientInfo->ulThrottled = 0;
+#if MB_TCP_RATE_LIMIT_ENABLED
+        pxClientInfo->xBucket.ulTokens = MB_TCP_RATE_BURST;
+        pxClientInfo->xBucket.xTimeStamp = pxClientInfo->xRecvTimeStamp;
+#endif
+        memcpy(pxClientInfo->cIpAddr, pcIpAddr, sizeof(pxClientInfo->cIpAddr));
+        pxClientInfo->pcIpAddr = pxClientInfo->cIpAddr;
+        portENTER_CRITICAL(&xClientMux);
+        xConfig.pxMbClientInfo[xConfig.usClientCount++] = pxClientInfo;
+        portEXIT_CRITICAL(&xClientMux);
+        FD_SET(xSockId, &xActiveSet);
+        xMaxSockId = (xSockId > xMaxSockId) ? xSockId : xMaxSockId;
+    }
+    return pxClientInfo;
 }
 
-static void vMBTCPPortShutdown(void)
+// Close the connection of the active client and return its slot to the pool
+static void vMBTCPPortRemoveClient(USHORT usActiveIdx)
 {
-    for (int i = 0; i < MB_TCP_PORT_MAX_CONN; i++) {
-        MbClientInfo_t *pxClientInfo = xConfig.pxMbClientInfo[i];
-        if (pxClientInfo != NULL) {
-            if (pxClientInfo->xSockId > 0) {
-                xMBTCPPortCloseConnection(pxClientInfo);
+    MbClientInfo_t* pxClientInfo = xConfig.pxMbClientInfo[usActiveIdx];
+    int xSockId = pxClientInfo->xSockId;
+
+    if (xConfig.pxCurClientInfo == pxClientInfo) {
+        xConfig.pxCurClientInfo = NULL;
+    }
+    xMBTCPPortCloseConnection(pxClientInfo);
+    // Keep the active list dense, the last client takes the place of the removed one
+    portENTER_CRITICAL(&xClientMux);
+    xConfig.pxMbClientInfo[usActiveIdx] = xConfig.pxMbClientInfo[xConfig.usClientCount];
+    xConfig.pxMbClientInfo[xConfig.usClientCount] = NULL;
+    portEXIT_CRITICAL(&xClientMux);
+    if (xSockId == xMaxSockId) {
+        xMaxSockId = xListenSock;
+        for (USHORT i = 0; i < xConfig.usClientCount; i++) {
+            if (xConfig.pxMbClientInfo[i]->xSockId > xMaxSockId) {
+                xMaxSockId = xConfig.pxMbClientInfo[i]->xSockId;
             }
-            ESP_LOGD(TAG,"Close port instance: %p.", pxClientInfo);
-            vMBTCPPortFreeClientInfo(pxClientInfo);
-            xConfig.pxMbClientInfo[i] = NULL;
         }
     }
-    ESP_LOGD(TAG,"Shutdown port task.");
+}
+
+static void vMBTCPPortFreeClients(void)
+{
+    vMBTCPPortSendLock();
+#if !MB_STATIC_ALLOCATION_ENABLED
     free(xConfig.pxMbClientInfo);
+    free(xConfig.pucClientBufPool);
+    free(xConfig.pxClientPool);
+#endif
+    xConfig.pxMbClientInfo = NULL;
+    xConfig.pucClientBufPool = NULL;
+    xConfig.pxClientPool = NULL;
+    vMBTCPPortSendUnlock();
+}
+
+static void vMBTCPPortShutdown(void)
+{
+    while (xConfig.usClientCount) {
+        ESP_LOGD(TAG,"Close port instance: %p.", xConfig.pxMbClientInfo[xConfig.usClientCount - 1]);
+        vMBTCPPortRemoveClient(xConfig.usClientCount - 1);
+    }
+    ESP_LOGD(TAG,"Shutdown port task.");
+    vMBTCPPortFreeClients();
     xSemaphoreGive(xShutdownSema);
     vTaskSuspend(NULL);
 }
 
-static int xMBTCPPortRxPoll(MbClientInfo_t *pxClientInfo, ULONG xTimeoutMs)
+// Receive the available data of the current frame without blocking
+// Returns the length of the complete frame, 0 if the frame is incomplete or an error code
+static int xMBTCPPortRxFrame(MbClientInfo_t *pxClientInfo)
 {
-    int xRet = ERR_CLSD;
-    struct timeval xTimeVal;
-    fd_set xReadSet;
-    int64_t xStartTimeStamp = 0;
-
-    // Receive data from connected client
-    if (pxClientInfo && pxClientInfo->xSockId > -1) {
-        // Set receive timeout
-        vxMBTCPPortMStoTimeVal(xTimeoutMs, &xTimeVal);
-        xStartTimeStamp = xMBTCPGetTimeStamp();
-        while (1)
-        {
-            FD_ZERO(&xReadSet);
-            FD_SET(pxClientInfo->xSockId, &xReadSet);
-            xRet = select(pxClientInfo->xSockId + 1, &xReadSet, NULL, NULL, &xTimeVal);
-            if (xRet == -1)
-            {
-                // If select an error occurred
-                xRet = ERR_CLSD;
-                TCP_PORT_CHECK_SHDN(xShutdownSema, vMBTCPPortShutdown);
-                break;
-            } else if (xRet == 0) {
-                // timeout occurred
-                if ((xStartTimeStamp + xTimeoutMs * 1000) > xMBTCPGetTimeStamp()) {
-                    ESP_LOGD(TAG, "Socket (#%d) Read timeout.", (int)pxClientInfo->xSockId);
-                    xRet = ERR_TIMEOUT;
-                    TCP_PORT_CHECK_SHDN(xShutdownSema, vMBTCPPortShutdown);
-                    break;
-                }
+    while (1) {
+        int xLength = recv(pxClientInfo->xSockId, &pxClientInfo->pucTCPBuf[pxClientInfo->usTCPBufPos],
+                                pxClientInfo->usTCPFrameBytesLeft, MSG_DONTWAIT);
+        if (xLength < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                // The rest of the frame is not received yet
+                return 0;
             }
-            if (FD_ISSET(pxClientInfo->xSockId, &xReadSet)) {
-                // If new buffer received then read Modbus packet into buffer
-                MB_PORT_CHECK((pxClientInfo->usTCPBufPos + pxClientInfo->usTCPFrameBytesLeft < MB_TCP_BUF_SIZE),
-                                    ERR_BUF, "Socket (#%d), incorrect request buffer size = %u, ignore.",
-                                    (int)pxClientInfo->xSockId,
-                                    (unsigned)(pxClientInfo->usTCPBufPos + pxClientInfo->usTCPFrameBytesLeft));
-                int xLength = recv(pxClientInfo->xSockId, &pxClientInfo->pucTCPBuf[pxClientInfo->usTCPBufPos],
-                                      pxClientInfo->usTCPFrameBytesLeft, MSG_DONTWAIT);
-                if (xLength < 0) {
-                    // If an error occurred during receiving
-                    ESP_LOGE(TAG, "Receive failed: length=%u, errno=%u", (unsigned)xLength, (unsigned)errno);
-                    xRet = (err_t)xLength;
-                    break;
-                } else if (xLength == 0) {
-                    // Socket connection closed
-                    ESP_LOGD(TAG, "Socket (#%d)(%s), connection closed.",
-                                                        (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr);
-                    xRet = ERR_CLSD;
-                    break;
-                } else {
-                    // New data received
-                    pxClientInfo->usTCPBufPos += xLength;
-                    pxClientInfo->usTCPFrameBytesLeft -= xLength;
-                    if (pxClientInfo->usTCPBufPos >= MB_TCP_FUNC) {
-                        // Length is a byte count of Modbus PDU (function code + data) and the
-                        // unit identifier.
-                        xLength = (int)MB_TCP_GET_FIELD(pxClientInfo->pucTCPBuf, MB_TCP_LEN);
-                        // Is the frame already complete.
-                        if (pxClientInfo->usTCPBufPos < (MB_TCP_UID + xLength)) {
-                            // The incomplete frame is received
-                            pxClientInfo->usTCPFrameBytesLeft = xLength + MB_TCP_UID - pxClientInfo->usTCPBufPos;
-                        } else if (pxClientInfo->usTCPBufPos == (MB_TCP_UID + xLength)) {
+            // If an error occurred during receiving
+            ESP_LOGE(TAG, "Receive failed: length=%d, errno=%u", xLength, (unsigned)errno);
+            return ERR_CONN;
+        } else if (xLength == 0) {
+            // Socket connection closed
+            ESP_LOGD(TAG, "Socket (#%d)(%s), connection closed.",
+                                                (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr);
+            return ERR_CLSD;
+        }
+        pxClientInfo->xRecvTimeStamp = xMBTCPGetTimeStamp();
+        pxClientInfo->usTCPBufPos += xLength;
+        pxClientInfo->usTCPFrameBytesLeft -= xLength;
+        if (pxClientInfo->usTCPFrameBytesLeft) {
+            continue;
+        }
+        if (pxClientInfo->usTCPBufPos == MB_TCP_FUNC) {
+            // The header is complete, the length is a byte count of Modbus PDU
+            // (function code + data) and the unit identifier.
+            xLength = (int)MB_TCP_GET_FIELD(pxClientInfo->pucTCPBuf, MB_TCP_LEN);
+            if ((xLength < 2) || ((MB_TCP_UID + xLength) > MB_TCP_BUF_SIZE)) {
+                ESP_LOGE(TAG, "Incorrect buffer received (%u) bytes.", (unsigned)xLength);
+                // This should not happen. We can't deal with such a client and
+                // drop the connection for security reasons.
+                return ERR_BUF;
+            }
+            pxClientInfo->usTCPFrameBytesLeft = xLength + MB_TCP_UID - pxClientInfo->usTCPBufPos;
+            continue;
+        }
 #if MB_TCP_DEBUG
-                            prvvMBTCPLogFrame(TAG, (UCHAR*)&pxClientInfo->pucTCPBuf[0], pxClientInfo->usTCPBufPos);
+        prvvMBTCPLogFrame(TAG, (UCHAR*)&pxClientInfo->pucTCPBuf[0], pxClientInfo->usTCPBufPos);
 #endif
-                            // Copy TID field from incoming packet
-                            pxClientInfo->usTidCnt = MB_TCP_GET_FIELD(pxClientInfo->pucTCPBuf, MB_TCP_TID);
-                            xRet = pxClientInfo->usTCPBufPos;
-                            break;
-                        } else if ((pxClientInfo->usTCPBufPos + xLength) >= MB_TCP_BUF_SIZE) {
-                            ESP_LOGE(TAG, "Incorrect buffer received (%u) bytes.", (unsigned)xLength);
-                            // This should not happen. We can't deal with such a client and
-                            // drop the connection for security reasons.
-                            xRet = ERR_BUF;
-                            break;
-                        }
-                    } // if ( pxClientInfo->usTCPBufPos >= MB_TCP_FUNC )
-                } // if data received
-            } // if (FD_ISSET(pxClientInfo->xSockId, &xReadSet))
-        } // while (1)
+        // Copy TID field from incoming packet
+        pxClientInfo->usTidCnt = MB_TCP_GET_FIELD(pxClientInfo->pucTCPBuf, MB_TCP_TID);
+        return pxClientInfo->usTCPBufPos;
+    }
+}
+
+#if MB_TCP_RTU_ENCAP_ENABLED
+// Get the length of the RTU request from the received part of the frame: the fixed size or
+// the byte count of the function. Returns 0 if the length can not be decided from the function code.
+static USHORT usMBTCPPortRtuLength(const UCHAR* pucAdu, USHORT usReceived)
+{
+    switch (pucAdu[MB_SER_PDU_PDU_OFF]) {
+        case MB_FUNC_DIAG_READ_EXCEPTION:
+        case MB_FUNC_DIAG_GET_COM_EVENT_CNT:
+        case MB_FUNC_DIAG_GET_COM_EVENT_LOG:
+        case MB_FUNC_OTHER_REPORT_SLAVEID:
+            return 4;
+        case MB_FUNC_READ_COILS:
+        case MB_FUNC_READ_DISCRETE_INPUTS:
+        case MB_FUNC_READ_HOLDING_REGISTER:
+        case MB_FUNC_READ_INPUT_REGISTER:
+        case MB_FUNC_WRITE_SINGLE_COIL:
+        case MB_FUNC_WRITE_REGISTER:
+        case MB_FUNC_DIAG_DIAGNOSTIC:
+            return 8;
+        case MB_FUNC_WRITE_MULTIPLE_COILS:
+        case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+            // Address, function, start, quantity, byte count, data and CRC
+            return (usReceived < 7) ? 7 : (USHORT)(9 + pucAdu[6]);
+        case MB_FUNC_READWRITE_MULTIPLE_REGISTERS:
+            return (usReceived < 11) ? 11 : (USHORT)(13 + pucAdu[10]);
+        case MB_FUNC_READ_FILE_RECORD:
+        case MB_FUNC_WRITE_FILE_RECORD:
+            // Address, function, byte count, sub-requests and CRC
+            return (usReceived < 3) ? 3 : (USHORT)(5 + pucAdu[2]);
+        case MB_FUNC_MASK_WRITE_REGISTER:
+            return 10;
+        case MB_FUNC_READ_FIFO_QUEUE:
+            return 6;
+        case MB_FUNC_ENCAPSULATED_INTERFACE:
+            // Read device identification: MEI type, read code and object id, other types take the segment
+            return (usReceived < 3) ? 3 : ((pucAdu[2] == MB_MEI_READ_DEVICE_ID) ? 7 : 0);
+        default:
+            return 0;
     }
-    return (xRet);
 }
 
+// Check the CRC of the complete RTU frame and give it the MBAP header in front of the address,
+// the frame is then handled as the MBAP frame of the unit identifier. Returns FALSE on CRC error.
+static BOOL xMBTCPPortRtuToMbap(MbClientInfo_t *pxClientInfo, USHORT usAduLength)
+{
+    UCHAR* pucBuf = pxClientInfo->pucTCPBuf;
+
+    if ((usAduLength < MB_TCP_RTU_ADU_MIN) || (usMBCRC16(MB_TCP_RTU_ADU(pucBuf), usAduLength) != 0)) {
+        return FALSE;
+    }
+    USHORT usLength = usAduLength - MB_TCP_RTU_CRC_SIZE; // Address and PDU
+    pucBuf[MB_TCP_TID] = 0;
+    pucBuf[MB_TCP_TID + 1] = 0;
+    pucBuf[MB_TCP_PID] = 0;
+    pucBuf[MB_TCP_PID + 1] = 0;
+    pucBuf[MB_TCP_LEN] = (UCHAR)(usLength >> 8U);
+    pucBuf[MB_TCP_LEN + 1] = (UCHAR)(usLength & 0xFF);
+    pxClientInfo->usTCPBufPos = MB_TCP_UID + usLength;
+    pxClientInfo->usTidCnt = 0;
+    return TRUE;
+}
+
+// Receive the available data of the current RTU frame without blocking, the frame ends
+// after the length given by its function code or with the data received so far for other functions.
+// Returns the length of the converted MBAP frame, 0 if the frame is incomplete or an error code
+static int xMBTCPPortRxRtuFrame(MbClientInfo_t *pxClientInfo)
+{
+    UCHAR* pucAdu = MB_TCP_RTU_ADU(pxClientInfo->pucTCPBuf);
+
+    while (1) {
+        int xLength = recv(pxClientInfo->xSockId, &pucAdu[pxClientInfo->usTCPBufPos],
+                                pxClientInfo->usTCPFrameBytesLeft, MSG_DONTWAIT);
+        if (xLength < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return 0;
+            }
+            ESP_LOGE(TAG, "Receive failed: length=%d, errno=%u", xLength, (unsigned)errno);
+            return ERR_CONN;
+        } else if (xLength == 0) {
+            ESP_LOGD(TAG, "Socket (#%d)(%s), connection closed.",
+                                                (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr);
+            return ERR_CLSD;
+        }
+        pxClientInfo->xRecvTimeStamp = xMBTCPGetTimeStamp();
+        pxClientInfo->usTCPBufPos += xLength;
+        pxClientInfo->usTCPFrameBytesLeft -= xLength;
+        if (pxClientInfo->usTCPFrameBytesLeft) {
+            continue;
+        }
+        USHORT usAduLength = usMBTCPPortRtuLength(pucAdu, pxClientInfo->usTCPBufPos);
+        if (usAduLength == 0) {
+            // Take the rest of the segment, the CRC check below decides about the frame
+            xLength = recv(pxClientInfo->xSockId, &pucAdu[pxClientInfo->usTCPBufPos],
+                                MB_TCP_RTU_ADU_MAX - pxClientInfo->usTCPBufPos, MSG_DONTWAIT);
+            pxClientInfo->usTCPBufPos += (xLength > 0) ? xLength : 0;
+            usAduLength = pxClientInfo->usTCPBufPos;
+        } else if (usAduLength > MB_TCP_RTU_ADU_MAX) {
+            ESP_LOGE(TAG, "Incorrect RTU frame length (%u) bytes.", (unsigned)usAduLength);
+            return ERR_BUF;
+        } else if (usAduLength > pxClientInfo->usTCPBufPos) {
+            pxClientInfo->usTCPFrameBytesLeft = usAduLength - pxClientInfo->usTCPBufPos;
+            continue;
+        }
+        // The stream has no frame delimiter, the connection with a broken frame can not resync
+        if (!xMBTCPPortRtuToMbap(pxClientInfo, usAduLength)) {
+            ESP_LOGE(TAG, "Socket (#%d)(%s), RTU frame CRC error.",
+                                                (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr);
+            return ERR_BUF;
+        }
+        return pxClientInfo->usTCPBufPos;
+    }
+}
+#endif
+
 // Create a listening socket on pcBindIp: Port
 static int
 vMBTCPPortBindAddr(const CHAR* pcBindIp)
@@ -452,13 +1131,303 @@ vMBTCPPortBindAddr(const CHAR* pcBindIp)
     return(xListenSockFd);
 }
 
+#if MB_TCP_RATE_LIMIT_ENABLED
+// Refill the bucket with ulRate requests per second and take one request,
+// returns FALSE if the bucket is empty
+static BOOL xMBTCPPortTakeToken(MbTokenBucket_t* pxBucket, ULONG ulRate, int64_t xTimeNow)
+{
+    uint64_t ullTokens = pxBucket->ulTokens + ((uint64_t)(xTimeNow - pxBucket->xTimeStamp) * ulRate) / 1000;
+    pxBucket->xTimeStamp = xTimeNow;
+    ullTokens = (ullTokens > MB_TCP_RATE_BURST) ? MB_TCP_RATE_BURST : ullTokens;
+    if (ullTokens < 1000) {
+        pxBucket->ulTokens = (ULONG)ullTokens;
+        return FALSE;
+    }
+    pxBucket->ulTokens = (ULONG)(ullTokens - 1000);
+    return TRUE;
+}
+
+#if MB_TCP_UNIT_RATE > 0
+// Get the bucket of the unit identifier, the least recently used bucket is given to a new unit
+static MbTokenBucket_t* pxMBTCPPortUnitBucket(UCHAR ucUnitId, int64_t xTimeNow)
+{
+    int xOldest = 0;
+    for (int i = 0; i < MB_TCP_UNIT_BUCKETS; i++) {
+        if (xUnitBuckets[i].xUsed && (xUnitBuckets[i].ucUnitId == ucUnitId)) {
+            return &xUnitBuckets[i].xBucket;
+        }
+        if (!xUnitBuckets[i].xUsed
+                || (xUnitBuckets[xOldest].xUsed
+                    && (xUnitBuckets[i].xBucket.xTimeStamp < xUnitBuckets[xOldest].xBucket.xTimeStamp))) {
+            xOldest = i;
+        }
+    }
+    xUnitBuckets[xOldest].xUsed = TRUE;
+    xUnitBuckets[xOldest].ucUnitId = ucUnitId;
+    xUnitBuckets[xOldest].xBucket.ulTokens = MB_TCP_RATE_BURST;
+    xUnitBuckets[xOldest].xBucket.xTimeStamp = xTimeNow;
+    return &xUnitBuckets[xOldest].xBucket;
+}
+#endif
+
+// Check the request against the rate limits of the client and of the unit identifier.
+// The write and diagnostic requests are the priority class and are not limited by default.
+static BOOL xMBTCPPortThrottle(MbClientInfo_t *pxClientInfo)
+{
+    const UCHAR* pucFrame = pxClientInfo->pucTCPBuf;
+    int64_t xTimeNow = pxClientInfo->xRecvTimeStamp;
+
+#if !CONFIG_FMB_TCP_RATE_LIMIT_WRITES
+    switch (pucFrame[MB_TCP_FUNC]) {
+        case MB_FUNC_WRITE_SINGLE_COIL:
+        case MB_FUNC_WRITE_REGISTER:
+        case MB_FUNC_WRITE_MULTIPLE_COILS:
+        case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+        case MB_FUNC_READWRITE_MULTIPLE_REGISTERS:
+        case MB_FUNC_DIAG_DIAGNOSTIC:
+            return FALSE;
+        default:
+            break;
+    }
+#endif
+#if MB_TCP_CLIENT_RATE > 0
+    if (!xMBTCPPortTakeToken(&pxClientInfo->xBucket, MB_TCP_CLIENT_RATE, xTimeNow)) {
+        return TRUE;
+    }
+#endif
+#if MB_TCP_UNIT_RATE > 0
+    if (!xMBTCPPortTakeToken(pxMBTCPPortUnitBucket(pucFrame[MB_TCP_UID], xTimeNow), MB_TCP_UNIT_RATE, xTimeNow)) {
+        return TRUE;
+    }
+#endif
+    (void)pucFrame;
+    (void)xTimeNow;
+    return FALSE;
+}
+
+// Answer the throttled request with the busy exception in place of the request
+static void vMBTCPPortSendBusy(MbClientInfo_t *pxClientInfo)
+{
+    UCHAR* pucFrame = pxClientInfo->pucTCPBuf;
+
+    vMBPortTraceFrame(MB_TRACE_RX | MB_TRACE_TCP, pucFrame, pxClientInfo->usTCPBufPos);
+    pxClientInfo->usTCPBufPos = 0;
+    pxClientInfo->usTCPFrameBytesLeft = MB_TCP_FRAME_START();
+    pxClientInfo->ulThrottled++;
+#if MB_SLAVE_DUAL_TCP_ENABLED
+    xConfig.xStats.ulThrottled++;
+#endif
+    ESP_LOGD(TAG, "Socket (#%d)(%s), request rate limit exceeded.",
+                                        (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr);
+    pucFrame[MB_TCP_FUNC] |= MB_FUNC_ERROR;
+    pucFrame[MB_TCP_FUNC + 1] = MB_EX_SLAVE_BUSY;
+    pucFrame[MB_TCP_LEN] = 0;
+    pucFrame[MB_TCP_LEN + 1] = 3; // Unit identifier, function and exception code
+    vMBPortTraceFrame(MB_TRACE_TX | MB_TRACE_TCP, pucFrame, MB_TCP_FUNC + 2);
+    vMBTCPPortSendLock();
+    if (xMBTCPPortSend(pxClientInfo, pucFrame, MB_TCP_FUNC + 2) < 0) {
+        pxClientInfo->xError = ERR_CONN;
+    }
+    vMBTCPPortSendUnlock();
+}
+#endif
+
+// Process the complete request frame in the client buffer
+static void vMBTCPPortHandleFrame(MbClientInfo_t *pxClientInfo)
+{
+    pxClientInfo->xReqTimeStamp = pxClientInfo->xRecvTimeStamp;
+    pxClientInfo->ulRequests++;
+#if MB_TCP_RATE_LIMIT_ENABLED
+    if (xMBTCPPortThrottle(pxClientInfo)) {
+        vMBTCPPortSendBusy(pxClientInfo);
+        pxClientInfo->xSendTimeStamp = xMBTCPGetTimeStamp();
+        return;
+    }
+#endif
+    if (MB_TCP_IS_DIRECT()) {
+#if MB_SLAVE_DUAL_TCP_ENABLED
+        // The request is executed in this task, the serial stack is not involved
+        vMBTCPPortExecute(pxClientInfo);
+#endif
+        pxClientInfo->xSendTimeStamp = xMBTCPGetTimeStamp();
+        return;
+    }
+
+    // set current client info to active client from which we received request
+    xConfig.pxCurClientInfo = pxClientInfo;
+
+    // Drop a late confirmation of the previous request and
+    // inform state machine to process the complete frame
+    (void)xTaskNotifyStateClear(NULL);
+    xMBPortEventPost(EV_FRAME_RECEIVED);
+
+    ESP_LOGD(TAG, "Socket (#%d)(%s), get packet TID=0x%X, %d bytes.",
+                                        (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr,
+                                        (int)pxClientInfo->usTidCnt, (int)pxClientInfo->usTCPBufPos);
+
+    // Wait while response is not processed by stack by timeout
+    if (!xMBTCPPortRespWait(pxClientInfo)) {
+        ESP_LOGD(TAG, "Response is ignored, time exceeds configured %d [ms].",
+                                            (unsigned)MB_TCP_RESP_TIMEOUT_MS);
+        // The request has not been taken by the stack, drop it
+        pxClientInfo->usTCPBufPos = 0;
+        pxClientInfo->usTCPFrameBytesLeft = MB_TCP_FRAME_START();
+    }
+
+    // Get time stamp of last data update
+    pxClientInfo->xSendTimeStamp = xMBTCPGetTimeStamp();
+    ESP_LOGD(TAG, "Client %d, Socket(#%d), processing time = %" PRIu64 "(us).",
+                                (int)pxClientInfo->xIndex, (int)pxClientInfo->xSockId,
+                                (uint64_t)(pxClientInfo->xSendTimeStamp - pxClientInfo->xRecvTimeStamp));
+}
+
+// Receive and process the pipelined requests of the ready client
+// Returns the number of processed requests or an error code if the connection has to be dropped
+static int xMBTCPPortServeClient(MbClientInfo_t *pxClientInfo)
+{
+    int xCount = 0;
+
+    // The requests are answered in order, the frames behind the current one wait in the
+    // socket buffer, so the response can be built in place of the request.
+    while (xCount < MB_TCP_PIPELINE_MAX) {
+#if MB_TCP_RTU_ENCAP_ENABLED
+        int xErr = MB_TCP_IS_RTU() ? xMBTCPPortRxRtuFrame(pxClientInfo) : xMBTCPPortRxFrame(pxClientInfo);
+#else
+        int xErr = xMBTCPPortRxFrame(pxClientInfo);
+#endif
+        if (xErr <= 0) {
+            return (xErr < 0) ? xErr : xCount;
+        }
+        vMBTCPPortHandleFrame(pxClientInfo);
+        if (pxClientInfo->xError) {
+            return pxClientInfo->xError;
+        }
+        xCount++;
+    }
+    return xCount;
+}
+
+// Receive and process the queued datagrams, each datagram carries one complete request (UDP).
+// There is no connection state, the response is sent back to the sender of the request.
+static void vMBTCPPortServeDatagrams(void)
+{
+    MbClientInfo_t* pxClientInfo = &xConfig.pxClientPool[0];
+
+    for (int i = 0; i < MB_TCP_PIPELINE_MAX; i++) {
+        // The RTU frame is received behind the room of the MBAP header
+        UCHAR* pucBuf = MB_TCP_IS_RTU() ? &pxClientInfo->pucTCPBuf[MB_TCP_UID] : pxClientInfo->pucTCPBuf;
+        xUdpPeerLen = sizeof(xUdpPeerAddr);
+        int xLength = recvfrom(pxClientInfo->xSockId, pucBuf, MB_TCP_BUF_SIZE - (pucBuf - pxClientInfo->pucTCPBuf),
+                                MSG_DONTWAIT, (struct sockaddr *)&xUdpPeerAddr, &xUdpPeerLen);
+        if (xLength < 0) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                ESP_LOGE(TAG, "Socket (#%d), receive failed: errno=%u", (int)pxClientInfo->xSockId, (unsigned)errno);
+            }
+            return;
+        }
+        pxClientInfo->xRecvTimeStamp = xMBTCPGetTimeStamp();
+#if MB_TCP_RTU_ENCAP_ENABLED
+        if (MB_TCP_IS_RTU()) {
+            if ((xLength > MB_TCP_RTU_ADU_MAX) || !xMBTCPPortRtuToMbap(pxClientInfo, (USHORT)xLength)) {
+                ESP_LOGD(TAG, "Socket (#%d), incorrect RTU datagram (%d) bytes is dropped.",
+                                                    (int)pxClientInfo->xSockId, xLength);
+#if MB_SLAVE_DUAL_TCP_ENABLED
+                xConfig.xStats.ulErrors++;
+#endif
+                continue;
+            }
+            pxClientInfo->xError = 0;
+            vMBTCPPortHandleFrame(pxClientInfo);
+            continue;
+        }
+#endif
+        // The length of the header has to match the datagram, the truncated datagrams are dropped
+        if ((xLength <= MB_TCP_FUNC)
+                || ((int)MB_TCP_GET_FIELD(pxClientInfo->pucTCPBuf, MB_TCP_LEN) != (xLength - MB_TCP_UID))) {
+            ESP_LOGD(TAG, "Socket (#%d), incorrect datagram (%d) bytes is dropped.",
+                                                (int)pxClientInfo->xSockId, xLength);
+#if MB_SLAVE_DUAL_TCP_ENABLED
+            xConfig.xStats.ulErrors++;
+#endif
+            continue;
+        }
+        pxClientInfo->usTCPBufPos = (USHORT)xLength;
+        pxClientInfo->usTidCnt = MB_TCP_GET_FIELD(pxClientInfo->pucTCPBuf, MB_TCP_TID);
+        pxClientInfo->xError = 0;
+        vMBTCPPortHandleFrame(pxClientInfo);
+    }
+}
+
+// Accept the new connection into a free slot of the pool or reject it
+static void vMBTCPPortAcceptClient(void)
+{
+    CHAR cAddrStr[MB_TCP_CLIENT_ADDR_LEN];
+
+    int xSockId = xMBTCPPortAcceptConnection(xListenSock, cAddrStr, sizeof(cAddrStr));
+    if (xSockId < 0) {
+        return;
+    }
+    MbClientInfo_t* pxClientInfo = (xSockId < FD_SETSIZE) ? pxMBTCPPortAddClient(xSockId, cAddrStr) : NULL;
+#if CONFIG_FMB_TCP_EVICT_LRU
+    if ((pxClientInfo == NULL) && (xSockId < FD_SETSIZE) && xConfig.usClientCount) {
+        // All slots are used, the least recently active client gives its slot to the new one
+        int xVictim = 0;
+        for (int i = 1; i < (int)xConfig.usClientCount; i++) {
+            if (xConfig.pxMbClientInfo[i]->xRecvTimeStamp < xConfig.pxMbClientInfo[xVictim]->xRecvTimeStamp) {
+                xVictim = i;
+            }
+        }
+        ESP_LOGW(TAG, "Socket (#%d)(%s), idle for %" PRIu64 " (us), replaced by the client %s.",
+                    (int)xConfig.pxMbClientInfo[xVictim]->xSockId, xConfig.pxMbClientInfo[xVictim]->pcIpAddr,
+                    (uint64_t)(xMBTCPGetTimeStamp() - xConfig.pxMbClientInfo[xVictim]->xRecvTimeStamp), cAddrStr);
+        vMBTCPPortRemoveClient((USHORT)xVictim);
+#if MB_SLAVE_DUAL_TCP_ENABLED
+        xConfig.xStats.ulEvictions++;
+#endif
+        pxClientInfo = pxMBTCPPortAddClient(xSockId, cAddrStr);
+    }
+#endif
+    if (pxClientInfo == NULL) {
+        ESP_LOGE(TAG, "Fail to accept connection from %s, only %u connections supported.",
+                                cAddrStr, (unsigned)MB_TCP_PORT_MAX_CONN);
+        // Reject the connection, otherwise the listen socket stays readable
+        shutdown(xSockId, SHUT_RDWR);
+        close(xSockId);
+#if MB_SLAVE_DUAL_TCP_ENABLED
+        xConfig.xStats.ulErrors++;
+#endif
+        return;
+    }
+    vMBTCPPortSetSockOpts(xSockId);
+#if MB_SLAVE_DUAL_TCP_ENABLED
+    xConfig.xStats.ulConnects++;
+#endif
+}
+
+// Drop the clients which do not send data or do not complete the started frame
+static void vMBTCPPortCheckIdleClients(int64_t xTimeStamp)
+{
+    for (int i = (int)xConfig.usClientCount - 1; i >= 0; i--) {
+        MbClientInfo_t* pxClientInfo = xConfig.pxMbClientInfo[i];
+        int64_t xTime = xTimeStamp - pxClientInfo->xRecvTimeStamp;
+        if (xTime > MB_TCP_DISCONNECT_TIMEOUT) {
+            ESP_LOGE(TAG, "Client %d, Socket(#%d) do not answer for %" PRIu64 " (us). Drop connection...",
+                                            (int)pxClientInfo->xIndex, (int)pxClientInfo->xSockId, (uint64_t)xTime);
+            vMBTCPPortRemoveClient(i);
+        } else if (pxClientInfo->usTCPBufPos && (xTime > (MB_TCP_READ_TIMEOUT_MS * 1000))) {
+            ESP_LOGE(TAG, "Socket (#%d)(%s), data receive timeout, time[us]: %" PRIu64 ", close active connection.",
+                                            (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr, (uint64_t)xTime);
+            vMBTCPPortRemoveClient(i);
+        }
+    }
+}
+
 static void vMBTCPPortServerTask(void *pvParameters)
 {
     int xErr = 0;
     fd_set xReadSet;
-    int i;
-    CHAR* pcClientIp = NULL;
     struct timeval xTimeVal;
+    int64_t xSweepTimeStamp = 0;
 
     // Main connection cycle
     while (1) {
@@ -468,194 +1437,76 @@ static void vMBTCPPortServerTask(void *pvParameters)
             TCP_PORT_CHECK_SHDN(xShutdownSema, vMBTCPPortShutdown);
             continue;
         }
+        // The poll set persists over the loop cycles, it is changed only on connect and disconnect
+        FD_SET(xListenSock, &xActiveSet);
+        xMaxSockId = (xListenSock > xMaxSockId) ? xListenSock : xMaxSockId;
+        if (MB_TCP_IS_UDP()) {
+            xConfig.pxClientPool[0].xSockId = xListenSock;
+            xConfig.pxClientPool[0].pcIpAddr = "UDP";
+#if MB_TCP_RATE_LIMIT_ENABLED
+            xConfig.pxClientPool[0].xBucket.ulTokens = MB_TCP_RATE_BURST;
+            xConfig.pxClientPool[0].xBucket.xTimeStamp = xMBTCPGetTimeStamp();
+#endif
+        }
 
         // Connections handling cycle
         while (1) {
-            // clear the socket set
-            FD_ZERO(&xReadSet);
-            // add master socket to set
-            FD_SET(xListenSock, &xReadSet);
-            int xMaxSd = xListenSock;
-            xConfig.usClientCount = 0;
-
-            vxMBTCPPortMStoTimeVal(1, &xTimeVal);
-            // Initialize read set and file descriptor according to
-            // all registered connected clients
-            for (i = 0; i < MB_TCP_PORT_MAX_CONN; i++) {
-                TCP_PORT_CHECK_SHDN(xShutdownSema, vMBTCPPortShutdown);
-                if ((xConfig.pxMbClientInfo[i] != NULL) && (xConfig.pxMbClientInfo[i]->xSockId > 0)) {
-                    // calculate max file descriptor for select
-                    xMaxSd = (xConfig.pxMbClientInfo[i]->xSockId > xMaxSd) ?
-                            xConfig.pxMbClientInfo[i]->xSockId : xMaxSd;
-                    FD_SET(xConfig.pxMbClientInfo[i]->xSockId, &xReadSet);
-                    xConfig.usClientCount++;
-                }
-            }
-
+            xReadSet = xActiveSet;
             vxMBTCPPortMStoTimeVal(MB_TCP_RESP_TIMEOUT_MS, &xTimeVal);
 
             // Wait for an activity on one of the sockets during timeout
-            xErr = select(xMaxSd + 1, &xReadSet, NULL, NULL, &xTimeVal);
+            xErr = select(xMaxSockId + 1, &xReadSet, NULL, NULL, &xTimeVal);
+            TCP_PORT_CHECK_SHDN(xShutdownSema, vMBTCPPortShutdown);
             if ((xErr < 0) && (errno != EINTR)) {
                 // error occurred during wait for read
                 ESP_LOGE(TAG, "select() errno = %u.", (unsigned)errno);
-                TCP_PORT_CHECK_SHDN(xShutdownSema, vMBTCPPortShutdown);
                 continue;
             } else if (xErr == 0) {
-                // If timeout happened, something is wrong
                 ESP_LOGD(TAG, "select() timeout, errno = %u.", (unsigned)errno);
-                TCP_PORT_CHECK_SHDN(xShutdownSema, vMBTCPPortShutdown);
             }
 
-            // If something happened on the master socket, then its an incoming connection.
-            if (FD_ISSET(xListenSock, &xReadSet) && xConfig.usClientCount < MB_TCP_PORT_MAX_CONN) {
-                MbClientInfo_t* pxClientInfo = NULL;
-                // find first empty place to insert connection info
-                for (i = 0; i < MB_TCP_PORT_MAX_CONN; i++) {
-                    pxClientInfo = xConfig.pxMbClientInfo[i];
-                    if (pxClientInfo == NULL) {
-                        break;
-                    }
-                }
-                // if request for new connection but no space left
-                if (pxClientInfo != NULL) {
-                    if (xConfig.pxMbClientInfo[MB_TCP_PORT_MAX_CONN] == NULL) {
-                        ESP_LOGE(TAG, "Fail to accept connection %u, only %u connections supported.", (unsigned)(i + 1), (unsigned)MB_TCP_PORT_MAX_CONN);
-                    }
-                    xConfig.pxMbClientInfo[MB_TCP_PORT_MAX_CONN] = pxClientInfo; // set last connection info
+            // If something happened on the master socket, then its an incoming connection
+            // or the datagram requests of the UDP port
+            if ((xErr > 0) && FD_ISSET(xListenSock, &xReadSet)) {
+                if (MB_TCP_IS_UDP()) {
+                    vMBTCPPortServeDatagrams();
                 } else {
-                    // allocate memory for new client info
-                    pxClientInfo = calloc(1, sizeof(MbClientInfo_t));
-                    if (!pxClientInfo) {
-                        ESP_LOGE(TAG, "Client info allocation fail.");
-                        vMBTCPPortFreeClientInfo(pxClientInfo);
-                        pxClientInfo = NULL;
-                    } else {
-                        // Accept new client connection
-                        pxClientInfo->xSockId = xMBTCPPortAcceptConnection(xListenSock, &pcClientIp);
-                        if (pxClientInfo->xSockId < 0) {
-                            ESP_LOGE(TAG, "Fail to accept connection for client %u.", (unsigned)(xConfig.usClientCount - 1));
-                            // Accept connection fail, then free client info and continue polling.
-                            vMBTCPPortFreeClientInfo(pxClientInfo);
-                            pxClientInfo = NULL;
-                            continue;
-                        }
-                        pxClientInfo->pucTCPBuf = calloc(MB_TCP_BUF_SIZE, sizeof(UCHAR));
-                        if (!pxClientInfo->pucTCPBuf) {
-                            ESP_LOGE(TAG, "Fail to allocate buffer for client %u.", (unsigned)(xConfig.usClientCount - 1));
-                            vMBTCPPortFreeClientInfo(pxClientInfo);
-                            pxClientInfo = NULL;
-                            continue;
-                        }
-                        // Fill the connection info structure
-                        xConfig.pxMbClientInfo[i] = pxClientInfo;
-                        pxClientInfo->xIndex = i;
-                        xConfig.usClientCount++;
-                        pxClientInfo->pcIpAddr = pcClientIp;
-                        pxClientInfo->xRecvTimeStamp = xMBTCPGetTimeStamp();
-                        xConfig.pxMbClientInfo[MB_TCP_PORT_MAX_CONN] = NULL;
-                        pxClientInfo->usTCPFrameBytesLeft = MB_TCP_FUNC;
-                        pxClientInfo->usTCPBufPos = 0;
+                    vMBTCPPortAcceptClient();
+                }
+                xErr--;
+            }
+            // Handle data requests of the ready clients, the list is walked backwards
+            // so a dropped client is replaced by the one which is already served
+            for (int i = (int)xConfig.usClientCount - 1; (i >= 0) && (xErr > 0); i--) {
+                MbClientInfo_t* pxClientInfo = xConfig.pxMbClientInfo[i];
+                if (!FD_ISSET(pxClientInfo->xSockId, &xReadSet)) {
+                    continue;
+                }
+                xErr--;
+                int xStatus = xMBTCPPortServeClient(pxClientInfo);
+                // If an invalid data received from socket or connection fail
+                // then drop connection
+                if (xStatus < 0) {
+                    switch(xStatus)
+                    {
+                        case ERR_CLSD:
+                            ESP_LOGE(TAG, "Socket (#%d)(%s), connection closed by peer.",
+                                                                (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr);
+                            break;
+                        case ERR_BUF:
+                        default:
+                            ESP_LOGE(TAG, "Socket (#%d)(%s), read data error: 0x%x",
+                                                                (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr, (int)xStatus);
+                            break;
                     }
+                    vMBTCPPortRemoveClient(i);
                 }
             }
-            // Handle data request from client
-            if (xErr > 0) {
-                // Handling client connection requests
-                for (i = 0; i < MB_TCP_PORT_MAX_CONN; i++) {
-                    MbClientInfo_t* pxClientInfo = xConfig.pxMbClientInfo[i];
-                    if ((pxClientInfo != NULL) && (pxClientInfo->xSockId > 0)) {
-                        if (FD_ISSET(pxClientInfo->xSockId, &xReadSet)) {
-                            // Other sockets are ready to be read
-                            xErr = xMBTCPPortRxPoll(pxClientInfo, MB_TCP_READ_TIMEOUT_MS);
-                            // If an invalid data received from socket or connection fail
-                            // or if timeout then drop connection and restart
-                            if (xErr < 0) {
-                                uint64_t xTimeStamp = xMBTCPGetTimeStamp();
-                                // If data update is timed out
-                                switch(xErr)
-                                {
-                                    case ERR_TIMEOUT:
-                                        ESP_LOGE(TAG, "Socket (#%d)(%s), data receive timeout, time[us]: %" PRIu64 ", close active connection.",
-                                                                            (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr,
-                                                                            (uint64_t)(xTimeStamp - pxClientInfo->xRecvTimeStamp));
-                                        break;
-                                    case ERR_CLSD:
-                                        ESP_LOGE(TAG, "Socket (#%d)(%s), connection closed by peer.",
-                                                                            (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr);
-                                        break;
-                                    case ERR_BUF:
-                                    default:
-                                        ESP_LOGE(TAG, "Socket (#%d)(%s), read data error: 0x%x",
-                                                                            (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr, (int)xErr);
-                                        break;
-                                }
-
-                                TCP_PORT_CHECK_SHDN(xShutdownSema, vMBTCPPortShutdown);
-
-                                // Close client connection
-                                xMBTCPPortCloseConnection(pxClientInfo);
-
-                                // This client does not respond, then unregister it
-                                vMBTCPPortFreeClientInfo(pxClientInfo);
-                                xConfig.pxMbClientInfo[i] = NULL;
-                                xConfig.pxMbClientInfo[MB_TCP_PORT_MAX_CONN] = NULL;
-                                // If no any active connections, break
-                                if (!xConfig.usClientCount) {
-                                    xConfig.pxCurClientInfo = NULL;
-                                    break;
-                                }
-                            } else {
-                                pxClientInfo->xRecvTimeStamp = xMBTCPGetTimeStamp();
-
-                                // set current client info to active client from which we received request
-                                xConfig.pxCurClientInfo = pxClientInfo;
-
-                                // Complete frame received, inform state machine to process frame
-                                xMBPortEventPost(EV_FRAME_RECEIVED);
-
-                                ESP_LOGD(TAG, "Socket (#%d)(%s), get packet TID=0x%X, %d bytes.",
-                                                                    (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr,
-                                                                    (int)pxClientInfo->usTidCnt, (int)xErr);
-
-                                // Wait while response is not processed by stack by timeout
-                                UCHAR* pucSentBuffer = vxMBTCPPortRespQueueRecv(xConfig.xRespQueueHandle);
-                                if (pucSentBuffer == NULL) {
-                                    ESP_LOGD(TAG, "Response is ignored, time exceeds configured %d [ms].",
-                                                                        (unsigned)MB_TCP_RESP_TIMEOUT_MS);
-                                } else  {
-                                    USHORT usSentTid = MB_TCP_GET_FIELD(pucSentBuffer, MB_TCP_TID);
-                                    if (usSentTid != pxClientInfo->usTidCnt) {
-                                        ESP_LOGE(TAG, "Sent TID(%x) != Recv TID(%x), ignore packet.",
-                                                                            (int)usSentTid, (int)pxClientInfo->usTidCnt);
-                                    }
-                                }
-
-                                // Get time stamp of last data update
-                                pxClientInfo->xSendTimeStamp = xMBTCPGetTimeStamp();
-                                ESP_LOGD(TAG, "Client %d, Socket(#%d), processing time = %" PRIu64 "(us).",
-                                                            (int)pxClientInfo->xIndex, (int)pxClientInfo->xSockId,
-                                                            (uint64_t)(pxClientInfo->xSendTimeStamp - pxClientInfo->xRecvTimeStamp));
-                            }
-                        } else {
-                            if (pxClientInfo) {
-                                // client is not ready to be read
-                                int64_t xTime = xMBTCPGetTimeStamp() - pxClientInfo->xRecvTimeStamp;
-                                if (xTime > MB_TCP_DISCONNECT_TIMEOUT) {
-                                    ESP_LOGE(TAG, "Client %d, Socket(#%d) do not answer for %" PRIu64 " (us). Drop connection...",
-                                                                    (int)pxClientInfo->xIndex, (int)pxClientInfo->xSockId, (uint64_t)xTime);
-                                    xMBTCPPortCloseConnection(pxClientInfo);
-
-                                    // This client does not respond, then delete registered data
-                                    vMBTCPPortFreeClientInfo(pxClientInfo);
-                                    xConfig.pxMbClientInfo[i] = NULL;
-                                }
-                            } else {
-                                ESP_LOGE(TAG, "Client %d is disconnected.", (int)i);
-                            }
-                        }
-                    } // if ((pxClientInfo != NULL)
-                } // Handling client connection requests
+            // Check the timeouts of the clients once per sweep period only
+            int64_t xTimeStamp = xMBTCPGetTimeStamp();
+            if ((xTimeStamp - xSweepTimeStamp) >= (MB_TCP_IDLE_SWEEP_MS * 1000)) {
+                xSweepTimeStamp = xTimeStamp;
+                vMBTCPPortCheckIdleClients(xTimeStamp);
             }
         } // while(1) // Handle connection cycle
     } // Main connection cycle
@@ -667,7 +1518,11 @@ vMBTCPPortClose( )
 {
     // Try to exit the task gracefully, so select could release its internal callbacks
     // that were allocated on the stack of the task we're going to delete
+#if MB_STATIC_ALLOCATION_ENABLED
+    xShutdownSema = xSemaphoreCreateBinaryStatic(&xShutdownSemaBuf);
+#else
     xShutdownSema = xSemaphoreCreateBinary();
+#endif
     if (xShutdownSema == NULL || // if no semaphore (alloc issues) or couldn't acquire it, just delete the task
         xSemaphoreTake(xShutdownSema, 2 * pdMS_TO_TICKS(CONFIG_FMB_MASTER_TIMEOUT_MS_RESPOND)) != pdTRUE) {
         ESP_LOGE(TAG, "Task couldn't exit gracefully within timeout -> abruptly deleting the task");
@@ -677,12 +1532,17 @@ vMBTCPPortClose( )
     close(xListenSock);
     xListenSock = -1;
 
-    vMBTCPPortRespQueueDelete(xConfig.xRespQueueHandle);
     if (xShutdownSema) {
         vSemaphoreDelete(xShutdownSema);
         xShutdownSema = NULL;
     }
-    vMBPortEventClose();
+    // The event transport belongs to the serial stack in dual transport mode
+    if (!MB_TCP_IS_DIRECT()) {
+        vMBPortEventClose();
+    }
+#if MB_SLAVE_DUAL_TCP_ENABLED
+    xConfig.xDirectExec = FALSE;
+#endif
     ESP_LOGD(TAG,"Port is closed.");
 }
 
@@ -707,7 +1567,7 @@ xMBTCPPortGetRequest( UCHAR ** ppucMBTCPFrame, USHORT * usTCPLength )
 
         // Reset the buffer.
         xConfig.pxCurClientInfo->usTCPBufPos = 0;
-        xConfig.pxCurClientInfo->usTCPFrameBytesLeft = MB_TCP_FUNC;
+        xConfig.pxCurClientInfo->usTCPFrameBytesLeft = MB_TCP_FRAME_START();
         xRet = TRUE;
     }
     return xRet;
@@ -717,42 +1577,26 @@ BOOL
 xMBTCPPortSendResponse( UCHAR * pucMBTCPFrame, USHORT usTCPLength )
 {
     BOOL bFrameSent = FALSE;
-    fd_set xWriteSet;
-    fd_set xErrorSet;
     int xErr = -1;
-    struct timeval xTimeVal;
 
     if (xConfig.pxCurClientInfo) {
-        FD_ZERO(&xWriteSet);
-        FD_ZERO(&xErrorSet);
-        FD_SET(xConfig.pxCurClientInfo->xSockId, &xWriteSet);
-        FD_SET(xConfig.pxCurClientInfo->xSockId, &xErrorSet);
-        vxMBTCPPortMStoTimeVal(MB_TCP_SEND_TIMEOUT_MS, &xTimeVal);
-        // Check if socket writable
-        xErr = select(xConfig.pxCurClientInfo->xSockId + 1, NULL, &xWriteSet, &xErrorSet, &xTimeVal);
-        if ((xErr == -1) || FD_ISSET(xConfig.pxCurClientInfo->xSockId, &xErrorSet)) {
-            ESP_LOGE(TAG, "Socket(#%d) , send select() error = %u.",
-                            (int)xConfig.pxCurClientInfo->xSockId, (unsigned)errno);
-            return FALSE;
-        }
-
         // Apply TID field from request to the frame before send response
         pucMBTCPFrame[MB_TCP_TID] = (UCHAR)(xConfig.pxCurClientInfo->usTidCnt >> 8U);
         pucMBTCPFrame[MB_TCP_TID + 1] = (UCHAR)(xConfig.pxCurClientInfo->usTidCnt & 0xFF);
 
-        // Write message into socket and disable Nagle's algorithm
-        xErr = send(xConfig.pxCurClientInfo->xSockId, pucMBTCPFrame, usTCPLength, TCP_NODELAY);
+        // The response is built in place of the request, send it with one call
+        xErr = xMBTCPPortSend(xConfig.pxCurClientInfo, pucMBTCPFrame, usTCPLength);
         if (xErr < 0) {
             ESP_LOGE(TAG, "Socket(#%d), fail to send data, errno = %u",
                         (int)xConfig.pxCurClientInfo->xSockId, (unsigned)errno);
             xConfig.pxCurClientInfo->xError = xErr;
         } else {
             bFrameSent = TRUE;
-            vxMBTCPPortRespQueueSend(xConfig.xRespQueueHandle, (void*)pucMBTCPFrame);
         }
+        vMBTCPPortRespNotify(ulMBTCPPortRespTag(xConfig.pxCurClientInfo));
     } else {
         ESP_LOGD(TAG, "Port is not active. Release lock.");
-        vxMBTCPPortRespQueueSend(xConfig.xRespQueueHandle, (void*)pucMBTCPFrame);
+        vMBTCPPortRespNotify(UINT32_MAX);
     }
     return bFrameSent;
 }
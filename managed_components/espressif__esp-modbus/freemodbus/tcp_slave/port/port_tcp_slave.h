@@ -40,10 +40,13 @@
 
 /* ----------------------- Platform includes --------------------------------*/
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #include "lwip/opt.h"
 #include "lwip/sys.h"
 #include "port.h"
+#include "mbconfig.h"
 #include "esp_modbus_common.h"      // for common types for network options
 
 /* ----------------------- Defines ------------------------------------------*/
@@ -60,31 +63,110 @@
 PR_BEGIN_EXTERN_C
 #endif
 
+#define MB_TCP_CLIENT_ADDR_LEN  (48) /*!< Fits the IPv6 address string */
+
+/* The responses are sent from other tasks than the TCP port task (forward handler, read workers) */
+#define MB_TCP_ASYNC_SEND_ENABLED       ( MB_SLAVE_TCP_FORWARD_ENABLED || ( MB_SLAVE_TCP_READ_WORKERS > 0 ) )
+
+/* Mapping of the communication mode of the slave controller to the port options */
+#if MB_TCP_RTU_ENCAP_ENABLED
+#define MB_SLAVE_IP_MODE_RTU(mode)      (((mode) == MB_MODE_RTU_OVER_TCP) || ((mode) == MB_MODE_RTU_OVER_UDP))
+#else
+#define MB_SLAVE_IP_MODE_RTU(mode)      (0)
+#endif
+#define MB_SLAVE_IP_MODE_VALID(mode)    (((mode) == MB_MODE_TCP) || ((mode) == MB_MODE_UDP) \
+                                            || MB_SLAVE_IP_MODE_RTU(mode))
+#define MB_SLAVE_IP_MODE_PROTO(mode)    ((((mode) == MB_MODE_UDP) || ((mode) == MB_MODE_RTU_OVER_UDP)) \
+                                            ? MB_PROTO_UDP : MB_PROTO_TCP)
+
 /* ----------------------- Type definitions ---------------------------------*/
+#if MB_SLAVE_TCP_FORWARD_ENABLED
+/**
+ * Handler of the TCP request for another unit identifier, called from the TCP port task.
+ * The PDU (function code and data) is valid during the call only. Returns TRUE if the
+ * request is taken, then the response has to be sent with xMBTCPPortForwardDone(ulTag, ucUnitId, ...).
+ */
+typedef BOOL (*pxMBTCPForwardCB)(ULONG ulTag, UCHAR ucUnitId, const UCHAR* pucPdu, USHORT usLength, void* pvArg);
+#endif
+
+typedef struct {
+    ULONG ulTokens;                 /*!< Available requests in 1/1000 of request */
+    int64_t xTimeStamp;             /*!< Time of the last refill */
+} MbTokenBucket_t;
+
 typedef struct {
-    int xIndex;                     /*!< Modbus info index */
-    int xSockId;                    /*!< Socket id */
+    int xIndex;                     /*!< Modbus info index (slot in the client pool) */
+    int xSockId;                    /*!< Socket id, -1 if the slot is free */
     int xError;                     /*!< TCP/UDP sock error */
     const char* pcIpAddr;           /*!< TCP/UDP IP address (string) */
-    UCHAR* pucTCPBuf;               /*!< buffer pointer */
+    UCHAR* pucTCPBuf;               /*!< buffer pointer (pooled) */
     USHORT usTCPBufPos;             /*!< buffer active position */
     USHORT usTCPFrameBytesLeft;     /*!< buffer left bytes to receive transaction */
     int64_t xSendTimeStamp;         /*!< send request timestamp */
     int64_t xRecvTimeStamp;         /*!< receive response timestamp */
+    int64_t xConnTimeStamp;         /*!< connection accept timestamp */
+    int64_t xReqTimeStamp;          /*!< timestamp of the last complete request, 0 if none */
+    ULONG ulRequests;               /*!< number of the requests of the connection */
+    ULONG ulThrottled;              /*!< number of the requests rejected by the rate limit */
+    MbTokenBucket_t xBucket;        /*!< request rate limit of the connection */
     USHORT usTidCnt;                /*!< last TID counter from packet */
+    CHAR cIpAddr[MB_TCP_CLIENT_ADDR_LEN]; /*!< IP address storage of pcIpAddr */
+#if MB_TCP_ASYNC_SEND_ENABLED
+    UCHAR ucConnGen;                /*!< Connection counter of the slot, rejects late responses of other tasks */
+#endif
+#if MB_SLAVE_TCP_READ_WORKERS > 0
+    ULONG ulReadsPending;           /*!< Number of the read requests queued to the workers and not answered */
+#endif
 } MbClientInfo_t;
 
+typedef struct {
+    ULONG ulRequests;               /*!< Number of the received requests */
+    ULONG ulExceptions;             /*!< Number of the exception responses */
+    ULONG ulErrors;                 /*!< Number of the ignored requests and send failures */
+    ULONG ulConnects;               /*!< Number of the accepted connections */
+    ULONG ulForwarded;              /*!< Number of the requests passed to the forward handler */
+    ULONG ulEvictions;              /*!< Number of the clients disconnected to free a slot */
+    ULONG ulThrottled;              /*!< Number of the requests rejected by the rate limit */
+    ULONG ulWorkerReads;            /*!< Number of the read requests executed by the read workers */
+    USHORT usClients;               /*!< Number of the connected clients */
+} MbSlavePortStats_t;
+
+typedef struct {
+    CHAR cIpAddr[MB_TCP_CLIENT_ADDR_LEN]; /*!< IP address of the client (string) */
+    ULONG ulConnectedMs;            /*!< Time since the connection is accepted */
+    ULONG ulIdleMs;                 /*!< Time since the last received data */
+    ULONG ulLastRequestMs;          /*!< Time since the last complete request, UINT32_MAX if none */
+    ULONG ulRequests;               /*!< Number of the requests of the connection */
+    ULONG ulThrottled;              /*!< Number of the requests rejected by the rate limit */
+} MbSlavePortClientStats_t;
+
 typedef struct {
     TaskHandle_t xMbTcpTaskHandle;      /*!< Server task handle */
-    QueueHandle_t xRespQueueHandle;      /*!< Response queue handle */
     MbClientInfo_t* pxCurClientInfo;    /*!< Current client info */
-    MbClientInfo_t** pxMbClientInfo;    /*!< Pointers to information about connected clients */
+    MbClientInfo_t** pxMbClientInfo;    /*!< Connected clients, the first usClientCount entries are used */
+    MbClientInfo_t* pxClientPool;       /*!< Pre-allocated client slots */
+    UCHAR* pucClientBufPool;            /*!< Pre-allocated frame buffers of the client slots */
     USHORT usPort;                      /*!< TCP/UDP port number */
     CHAR* pcBindAddr;                   /*!< IP address to bind */
     eMBPortProto eMbProto;              /*!< Protocol type used by port */
     USHORT usClientCount;               /*!< Client connection count */
     void* pvNetIface;                   /*!< Network netif interface pointer for port */
     eMBPortIpVer xIpVer;                /*!< IP protocol version */
+#if MB_TCP_RTU_ENCAP_ENABLED
+    BOOL xRtuFrames;                    /*!< The socket carries RTU frames (address, PDU, CRC) instead of MBAP */
+#endif
+#if MB_SLAVE_DUAL_TCP_ENABLED
+    BOOL xDirectExec;                   /*!< The port task executes the requests (dual transport mode) */
+    UCHAR ucUnitId;                     /*!< Unit identifier of the slave (MB_TCP_UID_ENABLED) */
+    MbSlavePortStats_t xStats;          /*!< Request counters of the port */
+#endif
+#if MB_SLAVE_TCP_FORWARD_ENABLED
+    pxMBTCPForwardCB pxForwardCb;       /*!< Handler of the requests for other unit identifiers */
+    void* pvForwardArg;                 /*!< Argument of the forward handler */
+#endif
+#if MB_TCP_ASYNC_SEND_ENABLED
+    SemaphoreHandle_t xSendLock;        /*!< Serializes the sends and the connection close of the clients */
+#endif
 } MbSlavePortConfig_t;
 
 /* ----------------------- Function prototypes ------------------------------*/
@@ -101,6 +183,69 @@ typedef struct {
  */
 void vMBTCPPortSlaveSetNetOpt(void* pvNetIf, eMBPortIpVer xIpVersion, eMBPortProto xProto, CHAR* pcBindAddr);
 
+#if MB_TCP_RTU_ENCAP_ENABLED
+/**
+ * Select the framing of the port before it is started: the RTU frames with CRC of the
+ * serial tunnels or the MBAP frames
+ *
+ * @param xRtuFrames TRUE for the RTU frames
+ */
+void vMBTCPPortSlaveSetRtuFraming(BOOL xRtuFrames);
+#endif
+
+#if MB_SLAVE_DUAL_TCP_ENABLED
+/**
+ * Start the TCP port which executes the requests in its own task with eMBExecutePDU()
+ * next to the serial slave stack (dual transport mode)
+ *
+ * @param usTCPPort TCP port number
+ * @param ucUnitId unit identifier of the slave, used if MB_TCP_UID_ENABLED
+ *
+ * @return TRUE if the port task is started
+ */
+BOOL xMBTCPPortInitDirect(USHORT usTCPPort, UCHAR ucUnitId);
+
+/**
+ * Get the request counters of the TCP port in dual transport mode
+ *
+ * @param pxStats pointer to the counters
+ */
+void vMBTCPPortGetStats(MbSlavePortStats_t* pxStats);
+
+/**
+ * Get the timers and counters of the connected clients in dual transport mode
+ *
+ * @param usFirst number of the connected clients to skip
+ * @param pxClients array for the clients
+ * @param usMax size of the array
+ *
+ * @return number of the clients copied into the array
+ */
+USHORT usMBTCPPortGetClients(USHORT usFirst, MbSlavePortClientStats_t* pxClients, USHORT usMax);
+#endif
+
+#if MB_SLAVE_TCP_FORWARD_ENABLED
+/**
+ * Set the handler of the requests for other unit identifiers (dual transport mode)
+ *
+ * @param pxCb handler or NULL to ignore such requests
+ * @param pvArg argument of the handler
+ */
+void vMBTCPPortSetForward(pxMBTCPForwardCB pxCb, void* pvArg);
+
+/**
+ * Send the response of the forwarded request, can be called from any task
+ *
+ * @param ulTag tag of the request passed to the handler
+ * @param ucUnitId unit identifier of the request
+ * @param pucPdu response PDU (function code and data)
+ * @param usLength length of the PDU
+ *
+ * @return FALSE if the client is disconnected or the response can not be sent
+ */
+BOOL xMBTCPPortForwardDone(ULONG ulTag, UCHAR ucUnitId, const UCHAR* pucPdu, USHORT usLength);
+#endif
+
 #ifdef __cplusplus
 PR_END_EXTERN_C
 #endif
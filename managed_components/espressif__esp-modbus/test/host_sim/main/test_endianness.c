@@ -0,0 +1,183 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * The array converters of mb_endianness_utils.c against the value converters
+ * called for each element, for all byte orders, counts and alignments of the
+ * register and value buffers, and for the conversion in place.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "mb_endianness_utils.h"
+#include "test_endianness.h"
+
+#define TEST_COUNT_MAX      (9)     // Counts 0..9 cover the word loop and the tail
+#define TEST_OFFSET_MAX     (8)     // Byte offsets of the buffers, 0 is aligned
+
+static uint32_t (*const get_u32[])(val_32_arr *) = {
+    [MB_ORDER32_ABCD] = mb_get_uint32_abcd,
+    [MB_ORDER32_BADC] = mb_get_uint32_badc,
+    [MB_ORDER32_CDAB] = mb_get_uint32_cdab,
+    [MB_ORDER32_DCBA] = mb_get_uint32_dcba,
+};
+
+static uint32_t (*const set_u32[])(val_32_arr *, uint32_t) = {
+    [MB_ORDER32_ABCD] = mb_set_uint32_abcd,
+    [MB_ORDER32_BADC] = mb_set_uint32_badc,
+    [MB_ORDER32_CDAB] = mb_set_uint32_cdab,
+    [MB_ORDER32_DCBA] = mb_set_uint32_dcba,
+};
+
+static uint64_t (*const get_u64[])(val_64_arr *) = {
+    [MB_ORDER64_ABCDEFGH] = mb_get_uint64_abcdefgh,
+    [MB_ORDER64_BADCFEHG] = mb_get_uint64_badcfehg,
+    [MB_ORDER64_GHEFCDAB] = mb_get_uint64_ghefcdab,
+    [MB_ORDER64_HGFEDCBA] = mb_get_uint64_hgfedcba,
+};
+
+static uint64_t (*const set_u64[])(val_64_arr *, uint64_t) = {
+    [MB_ORDER64_ABCDEFGH] = mb_set_uint64_abcdefgh,
+    [MB_ORDER64_BADCFEHG] = mb_set_uint64_badcfehg,
+    [MB_ORDER64_GHEFCDAB] = mb_set_uint64_ghefcdab,
+    [MB_ORDER64_HGFEDCBA] = mb_set_uint64_hgfedcba,
+};
+
+// Distinct bytes, so a swapped or shifted byte changes the result
+static void fill_pattern(uint8_t *buf, size_t size, uint8_t seed)
+{
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t)(seed + i * 7);
+    }
+}
+
+static bool check_u32(mb_order32_t order, size_t count, size_t src_off, size_t dst_off)
+{
+    uint8_t regs[TEST_OFFSET_MAX + TEST_COUNT_MAX * 4];
+    uint8_t values[TEST_OFFSET_MAX + TEST_COUNT_MAX * 4];
+    uint8_t expected[TEST_COUNT_MAX * 4];
+    val_32_arr reg;
+
+    // Get: registers to values
+    fill_pattern(regs, sizeof(regs), (uint8_t)(order + count));
+    memset(values, 0xEE, sizeof(values));
+    for (size_t i = 0; i < count; i++) {
+        memcpy(reg, &regs[src_off + i * 4], sizeof(reg));
+        uint32_t value = get_u32[order](&reg);
+        memcpy(&expected[i * 4], &value, sizeof(value));
+    }
+    mb_get_uint32_array((uint32_t *)(void *)&values[dst_off], (const val_32_arr *)&regs[src_off], count, order);
+    if (memcmp(&values[dst_off], expected, count * 4) != 0) {
+        return false;
+    }
+
+    // Set: values to registers
+    fill_pattern(values, sizeof(values), (uint8_t)(0x80 + order + count));
+    memset(regs, 0xEE, sizeof(regs));
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value;
+        memcpy(&value, &values[src_off + i * 4], sizeof(value));
+        (void)set_u32[order](&reg, value);
+        memcpy(&expected[i * 4], reg, sizeof(reg));
+    }
+    mb_set_uint32_array((val_32_arr *)&regs[dst_off], (const uint32_t *)(void *)&values[src_off], count, order);
+    if (memcmp(&regs[dst_off], expected, count * 4) != 0) {
+        return false;
+    }
+
+    // Get in place, the registers are replaced by the values
+    fill_pattern(regs, sizeof(regs), (uint8_t)(0x40 + order + count));
+    for (size_t i = 0; i < count; i++) {
+        memcpy(reg, &regs[src_off + i * 4], sizeof(reg));
+        uint32_t value = get_u32[order](&reg);
+        memcpy(&expected[i * 4], &value, sizeof(value));
+    }
+    mb_get_uint32_array((uint32_t *)(void *)&regs[src_off], (const val_32_arr *)&regs[src_off], count, order);
+    return (memcmp(&regs[src_off], expected, count * 4) == 0);
+}
+
+static bool check_u64(mb_order64_t order, size_t count, size_t src_off, size_t dst_off)
+{
+    uint8_t regs[TEST_OFFSET_MAX + TEST_COUNT_MAX * 8];
+    uint8_t values[TEST_OFFSET_MAX + TEST_COUNT_MAX * 8];
+    uint8_t expected[TEST_COUNT_MAX * 8];
+    val_64_arr reg;
+
+    fill_pattern(regs, sizeof(regs), (uint8_t)(order + count));
+    memset(values, 0xEE, sizeof(values));
+    for (size_t i = 0; i < count; i++) {
+        memcpy(reg, &regs[src_off + i * 8], sizeof(reg));
+        uint64_t value = get_u64[order](&reg);
+        memcpy(&expected[i * 8], &value, sizeof(value));
+    }
+    mb_get_uint64_array((uint64_t *)(void *)&values[dst_off], (const val_64_arr *)&regs[src_off], count, order);
+    if (memcmp(&values[dst_off], expected, count * 8) != 0) {
+        return false;
+    }
+
+    fill_pattern(values, sizeof(values), (uint8_t)(0x80 + order + count));
+    memset(regs, 0xEE, sizeof(regs));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value;
+        memcpy(&value, &values[src_off + i * 8], sizeof(value));
+        (void)set_u64[order](&reg, value);
+        memcpy(&expected[i * 8], reg, sizeof(reg));
+    }
+    mb_set_uint64_array((val_64_arr *)&regs[dst_off], (const uint64_t *)(void *)&values[src_off], count, order);
+    if (memcmp(&regs[dst_off], expected, count * 8) != 0) {
+        return false;
+    }
+
+    fill_pattern(regs, sizeof(regs), (uint8_t)(0x40 + order + count));
+    for (size_t i = 0; i < count; i++) {
+        memcpy(reg, &regs[src_off + i * 8], sizeof(reg));
+        uint64_t value = get_u64[order](&reg);
+        memcpy(&expected[i * 8], &value, sizeof(value));
+    }
+    mb_get_uint64_array((uint64_t *)(void *)&regs[src_off], (const val_64_arr *)&regs[src_off], count, order);
+    return (memcmp(&regs[src_off], expected, count * 8) == 0);
+}
+
+int test_endianness(void)
+{
+    int failures = 0;
+
+    for (int order = MB_ORDER32_ABCD; order <= MB_ORDER32_DCBA; order++) {
+        bool ok = true;
+        for (size_t count = 0; ok && (count <= TEST_COUNT_MAX); count++) {
+            for (size_t src_off = 0; ok && (src_off < TEST_OFFSET_MAX); src_off++) {
+                for (size_t dst_off = 0; ok && (dst_off < TEST_OFFSET_MAX); dst_off++) {
+                    ok = check_u32((mb_order32_t)order, count, src_off, dst_off);
+                    if (!ok) {
+                        printf("FAIL uint32 array order %d: count %u, offsets %u/%u\n", order,
+                               (unsigned)count, (unsigned)src_off, (unsigned)dst_off);
+                    }
+                }
+            }
+        }
+        printf("%s uint32 array order %d\n", ok ? "PASS" : "FAIL", order);
+        failures += ok ? 0 : 1;
+    }
+    for (int order = MB_ORDER64_ABCDEFGH; order <= MB_ORDER64_HGFEDCBA; order++) {
+        bool ok = true;
+        for (size_t count = 0; ok && (count <= TEST_COUNT_MAX); count++) {
+            for (size_t src_off = 0; ok && (src_off < TEST_OFFSET_MAX); src_off++) {
+                for (size_t dst_off = 0; ok && (dst_off < TEST_OFFSET_MAX); dst_off++) {
+                    ok = check_u64((mb_order64_t)order, count, src_off, dst_off);
+                    if (!ok) {
+                        printf("FAIL uint64 array order %d: count %u, offsets %u/%u\n", order,
+                               (unsigned)count, (unsigned)src_off, (unsigned)dst_off);
+                    }
+                }
+            }
+        }
+        printf("%s uint64 array order %d\n", ok ? "PASS" : "FAIL", order);
+        failures += ok ? 0 : 1;
+    }
+    return failures;
+}
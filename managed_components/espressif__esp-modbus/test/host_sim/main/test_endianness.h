@@ -0,0 +1,12 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/**
+ * @brief Compare the array converters with the value converters, returns the number of failed checks
+ */
+int test_endianness(void);
@@ -0,0 +1,225 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Host test of the serial slave stack on the simulated port: RTU frames are
+ * passed through usMBPortSimTransaction(), which runs eMBPoll() for the
+ * request, and the responses are compared byte by byte.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "mb.h"
+#include "port_sim.h"
+#if CONFIG_FMB_EXT_TYPE_SUPPORT
+#include "test_endianness.h"
+#endif
+
+#define TEST_SLAVE_ADDR         (1)
+#define TEST_BAUD_RATE          (19200)
+#define TEST_HOLDING_COUNT      (128)
+#define TEST_FRAME_MAX          (256)
+
+static USHORT usHoldingRegs[TEST_HOLDING_COUNT];
+static int xFailures = 0;
+
+/* ----------------------- Register callbacks -------------------------------*/
+eMBErrorCode
+eMBRegHoldingCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs, eMBRegisterMode eMode )
+{
+    /* The stack passes the one based register address */
+    USHORT usIndex = usAddress - 1;
+
+    if( ( usAddress == 0 ) || ( ( usIndex + usNRegs ) > TEST_HOLDING_COUNT ) )
+    {
+        return MB_ENOREG;
+    }
+    for( USHORT i = 0; i < usNRegs; i++ )
+    {
+        if( eMode == MB_REG_READ )
+        {
+            *pucRegBuffer++ = ( UCHAR )( usHoldingRegs[usIndex + i] >> 8 );
+            *pucRegBuffer++ = ( UCHAR )( usHoldingRegs[usIndex + i] & 0xFF );
+        }
+        else
+        {
+            usHoldingRegs[usIndex + i] = ( USHORT )( ( pucRegBuffer[0] << 8 ) | pucRegBuffer[1] );
+            pucRegBuffer += 2;
+        }
+    }
+    return MB_ENOERR;
+}
+
+eMBErrorCode
+eMBRegInputCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNRegs )
+{
+    return MB_ENOREG;
+}
+
+eMBErrorCode
+eMBRegCoilsCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNCoils, eMBRegisterMode eMode )
+{
+    return MB_ENOREG;
+}
+
+eMBErrorCode
+eMBRegDiscreteCB( UCHAR * pucRegBuffer, USHORT usAddress, USHORT usNDiscrete )
+{
+    return MB_ENOREG;
+}
+
+/* ----------------------- Frame helpers ------------------------------------*/
+/* Bitwise CRC of the specification, independent of the table driven one of the stack */
+static USHORT
+usTestCRC16( const UCHAR * pucFrame, USHORT usLength )
+{
+    USHORT usCRC = 0xFFFF;
+
+    while( usLength-- )
+    {
+        usCRC ^= *pucFrame++;
+        for( int i = 0; i < 8; i++ )
+        {
+            usCRC = ( usCRC & 1 ) ? ( USHORT )( ( usCRC >> 1 ) ^ 0xA001 ) : ( USHORT )( usCRC >> 1 );
+        }
+    }
+    return usCRC;
+}
+
+/* Append the address and the CRC to the PDU */
+static USHORT
+usTestFrame( UCHAR * pucFrame, const UCHAR * pucPDU, USHORT usPDULength )
+{
+    pucFrame[0] = TEST_SLAVE_ADDR;
+    memcpy( &pucFrame[1], pucPDU, usPDULength );
+    USHORT usCRC = usTestCRC16( pucFrame, usPDULength + 1 );
+    pucFrame[usPDULength + 1] = ( UCHAR )( usCRC & 0xFF );
+    pucFrame[usPDULength + 2] = ( UCHAR )( usCRC >> 8 );
+    return usPDULength + 3;
+}
+
+/* Send the request PDU and compare the response PDU, an empty expected PDU means no response */
+static void
+vTestTransaction( const char * pcName, const UCHAR * pucRequest, USHORT usRequestLength,
+                  const UCHAR * pucExpected, USHORT usExpectedLength, BOOL xCorruptCRC )
+{
+    UCHAR ucRequest[TEST_FRAME_MAX];
+    UCHAR ucExpected[TEST_FRAME_MAX];
+    UCHAR ucResponse[TEST_FRAME_MAX];
+    USHORT usLength = usTestFrame( ucRequest, pucRequest, usRequestLength );
+    USHORT usExpected = ( usExpectedLength > 0 ) ? usTestFrame( ucExpected, pucExpected, usExpectedLength ) : 0;
+
+    if( xCorruptCRC )
+    {
+        ucRequest[usLength - 1] ^= 0x5A;
+    }
+    USHORT usResponse = usMBPortSimTransaction( ucRequest, usLength, ucResponse, sizeof( ucResponse ) );
+    if( ( usResponse != usExpected ) || ( memcmp( ucResponse, ucExpected, usExpected ) != 0 ) )
+    {
+        printf( "FAIL %s: response of %u bytes:", pcName, ( unsigned )usResponse );
+        for( USHORT i = 0; i < usResponse; i++ )
+        {
+            printf( " %02X", ucResponse[i] );
+        }
+        printf( "\n" );
+        xFailures++;
+        return;
+    }
+    printf( "PASS %s\n", pcName );
+}
+
+static void
+vTestCheck( const char * pcName, BOOL xCondition )
+{
+    printf( "%s %s\n", xCondition ? "PASS" : "FAIL", pcName );
+    xFailures += xCondition ? 0 : 1;
+}
+
+/* ----------------------- Tests --------------------------------------------*/
+static void
+vTestReadHolding( void )
+{
+    for( USHORT i = 0; i < TEST_HOLDING_COUNT; i++ )
+    {
+        usHoldingRegs[i] = ( USHORT )( 0x1000 + i );
+    }
+    const UCHAR ucRequest[] = { 0x03, 0x00, 0x02, 0x00, 0x03 };
+    const UCHAR ucExpected[] = { 0x03, 0x06, 0x10, 0x02, 0x10, 0x03, 0x10, 0x04 };
+    vTestTransaction( "FC03 read 3 registers", ucRequest, sizeof( ucRequest ),
+                      ucExpected, sizeof( ucExpected ), FALSE );
+
+    const UCHAR ucOutside[] = { 0x03, 0x00, 0x7F, 0x00, 0x02 };
+    const UCHAR ucException[] = { 0x83, 0x02 };
+    vTestTransaction( "FC03 illegal data address", ucOutside, sizeof( ucOutside ),
+                      ucException, sizeof( ucException ), FALSE );
+}
+
+static void
+vTestWriteSingle( void )
+{
+    const UCHAR ucRequest[] = { 0x06, 0x00, 0x05, 0xAB, 0xCD };
+    vTestTransaction( "FC06 write register", ucRequest, sizeof( ucRequest ),
+                      ucRequest, sizeof( ucRequest ), FALSE );
+    vTestCheck( "FC06 register value", usHoldingRegs[5] == 0xABCD );
+}
+
+static void
+vTestWriteMultiple( void )
+{
+    const UCHAR ucRequest[] = { 0x10, 0x00, 0x10, 0x00, 0x02, 0x04, 0x12, 0x34, 0x56, 0x78 };
+    const UCHAR ucExpected[] = { 0x10, 0x00, 0x10, 0x00, 0x02 };
+    vTestTransaction( "FC16 write 2 registers", ucRequest, sizeof( ucRequest ),
+                      ucExpected, sizeof( ucExpected ), FALSE );
+    vTestCheck( "FC16 register values", ( usHoldingRegs[16] == 0x1234 ) && ( usHoldingRegs[17] == 0x5678 ) );
+
+    /* 121 registers are above the limit of the slave, the frame still fits the buffer */
+    UCHAR ucLarge[6 + 121 * 2] = { 0x10, 0x00, 0x00, 0x00, 121, 121 * 2 };
+    const UCHAR ucException[] = { 0x90, 0x03 };
+    vTestTransaction( "FC16 121 registers rejected", ucLarge, sizeof( ucLarge ),
+                      ucException, sizeof( ucException ), FALSE );
+    vTestCheck( "FC16 rejected request not written", usHoldingRegs[0] == 0x1000 );
+}
+
+static void
+vTestCRCError( void )
+{
+    const UCHAR ucRequest[] = { 0x06, 0x00, 0x06, 0x55, 0xAA };
+    ULONG ulErrors = ulMBGetDiagCounter( MB_DIAG_BUS_COMM_ERRORS );
+    ULONG ulMessages = ulMBGetDiagCounter( MB_DIAG_BUS_MESSAGES );
+
+    vTestTransaction( "CRC error not answered", ucRequest, sizeof( ucRequest ), NULL, 0, TRUE );
+    vTestCheck( "CRC error not written", usHoldingRegs[6] == 0x1006 );
+    vTestCheck( "CRC error counted", ( ulMBGetDiagCounter( MB_DIAG_BUS_COMM_ERRORS ) == ulErrors + 1 )
+                && ( ulMBGetDiagCounter( MB_DIAG_BUS_MESSAGES ) == ulMessages + 1 ) );
+    vTestTransaction( "request after CRC error", ucRequest, sizeof( ucRequest ),
+                      ucRequest, sizeof( ucRequest ), FALSE );
+}
+
+void
+app_main( void )
+{
+    if( ( eMBInit( MB_RTU, TEST_SLAVE_ADDR, 0, TEST_BAUD_RATE, MB_PAR_NONE ) != MB_ENOERR )
+        || ( eMBEnable( ) != MB_ENOERR ) )
+    {
+        printf( "FAIL stack init\n" );
+        exit( 1 );
+    }
+    vTestReadHolding( );
+    vTestWriteSingle( );
+    vTestWriteMultiple( );
+    vTestCRCError( );
+    ( void )eMBDisable( );
+    ( void )eMBClose( );
+#if CONFIG_FMB_EXT_TYPE_SUPPORT
+    xFailures += test_endianness( );
+#endif
+
+    printf( xFailures ? "%d tests failed\n" : "All tests passed\n", xFailures );
+    exit( xFailures ? 1 : 0 );
+}
@@ -0,0 +1,12 @@
+# SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+
+import pytest
+from pytest_embedded import Dut
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+def test_mb_host_sim(dut: Dut) -> None:
+    # The test app prints PASS/FAIL per check and exits with the result
+    dut.expect_exact('All tests passed', timeout=60)
@@ -1,10 +1,18 @@
 #!/usr/bin/env python3
 """
 Simple Modbus RTU test script for ESP32-S3 slave
+
+With --bench the script runs a throughput and latency benchmark instead of the
+functional test, see "Benchmark" in README.md.
 """
 from pymodbus.client import ModbusSerialClient
+import argparse
+import csv
+import json
+import struct
 import sys
 import time
+import urllib.request
 
 def test_modbus(port='/dev/ttyUSB0', slave_id=1):
     """Test Modbus communication with ESP32 slave"""
@@ -115,9 +123,253 @@ def test_modbus(port='/dev/ttyUSB0', slave_id=1):
     print("=" * 50)
     return True
 
+# ---------------------------------------------------------------------------
+# Benchmark
+#
+# The benchmark talks RTU directly through pyserial (installed with pymodbus)
+# so every frame is timed from the first request byte to the last response
+# byte and a response with a bad CRC is counted instead of silently dropped.
+# ---------------------------------------------------------------------------
+
+# Largest quantity allowed by the Modbus specification per function code
+BENCH_MAX_QUANTITY = {1: 2000, 3: 125, 4: 125, 6: 1, 15: 1968, 16: 123}
+
+# Default start address per function code. The default register map has 12
+# holding registers at 0 (only register 0 is writable), retained holding
+# registers at 100 and the input register history at 1000, so large quantities
+# are answered with exceptions unless the addresses are moved with --address.
+BENCH_DEFAULT_ADDRESS = {1: 0, 3: 0, 4: 0, 6: 0, 15: 0, 16: 100}
+
+BENCH_FIELDS = ['baud', 'fc', 'quantity', 'rate', 'sent', 'ok', 'exceptions',
+                'timeouts', 'crc_errors', 'invalid', 'elapsed_s', 'req_per_s',
+                'p50_ms', 'p99_ms', 'p999_ms', 'max_ms']
+
+
+def crc16(data):
+    """Modbus RTU CRC16, returned as the two bytes of the frame trailer"""
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return struct.pack('<H', crc)
+
+
+def bench_request(slave_id, fc, address, quantity):
+    """Build the request frame and the expected normal response length"""
+    if fc in (1, 3, 4):
+        pdu = struct.pack('>BHH', fc, address, quantity)
+        data_len = (quantity + 7) // 8 if fc == 1 else quantity * 2
+        rsp_len = 5 + data_len
+    elif fc == 6:
+        pdu = struct.pack('>BHH', fc, address, 0x1234)
+        rsp_len = 8
+    elif fc == 15:
+        nbytes = (quantity + 7) // 8
+        pdu = struct.pack('>BHHB', fc, address, quantity, nbytes) + bytes([0x55] * nbytes)
+        rsp_len = 8
+    elif fc == 16:
+        pdu = struct.pack('>BHHB', fc, address, quantity, quantity * 2)
+        pdu += struct.pack('>%dH' % quantity, *range(quantity))
+        rsp_len = 8
+    else:
+        raise ValueError(f"Unsupported function code {fc}")
+    adu = bytes([slave_id]) + pdu
+    return adu + crc16(adu), rsp_len
+
+
+def bench_transaction(ser, request, rsp_len):
+    """Send one request, return (result, response time in seconds)
+
+    result is one of 'ok', 'exception', 'timeout', 'crc' or 'invalid'.
+    """
+    ser.reset_input_buffer()
+    start = time.perf_counter()
+    ser.write(request)
+    rsp = ser.read(5)
+    if len(rsp) == 5 and rsp[1] == (request[1] | 0x80):
+        elapsed = time.perf_counter() - start
+        return ('exception' if crc16(rsp[:3]) == rsp[3:5] else 'crc'), elapsed
+    if len(rsp) == 5:
+        rsp += ser.read(rsp_len - 5)
+    elapsed = time.perf_counter() - start
+    if len(rsp) < rsp_len:
+        return 'timeout', elapsed
+    if crc16(rsp[:-2]) != rsp[-2:]:
+        return 'crc', elapsed
+    if rsp[0] != request[0] or rsp[1] != request[1]:
+        return 'invalid', elapsed
+    return 'ok', elapsed
+
+
+def percentile(sorted_values, pct):
+    """Nearest-rank percentile of an already sorted list"""
+    if not sorted_values:
+        return 0.0
+    rank = max(0, min(len(sorted_values) - 1, int(round(pct / 100.0 * len(sorted_values) + 0.5)) - 1))
+    return sorted_values[rank]
+
+
+def bench_point(ser, slave_id, baud, fc, address, quantity, rate, count, duration):
+    """Run one point of the sweep and return its result row"""
+    request, rsp_len = bench_request(slave_id, fc, address, quantity)
+    counts = {'ok': 0, 'exception': 0, 'timeout': 0, 'crc': 0, 'invalid': 0}
+    times = []
+    interval = 1.0 / rate if rate > 0 else 0.0
+    start = time.perf_counter()
+    next_send = start
+    sent = 0
+    while (sent < count) if count else (time.perf_counter() - start < duration):
+        if interval:
+            delay = next_send - time.perf_counter()
+            if delay > 0:
+                time.sleep(delay)
+            next_send += interval
+        result, elapsed = bench_transaction(ser, request, rsp_len)
+        counts[result] += 1
+        sent += 1
+        if result in ('ok', 'exception'):
+            times.append(elapsed)
+        elif result == 'timeout':
+            # Let any late bytes arrive so they do not corrupt the next frame
+            time.sleep(0.05)
+    total = time.perf_counter() - start
+    times.sort()
+    ms = lambda v: round(v * 1000.0, 3)
+    return {
+        'baud': baud, 'fc': fc, 'quantity': quantity, 'rate': rate,
+        'sent': sent, 'ok': counts['ok'], 'exceptions': counts['exception'],
+        'timeouts': counts['timeout'], 'crc_errors': counts['crc'],
+        'invalid': counts['invalid'], 'elapsed_s': round(total, 3),
+        'req_per_s': round((counts['ok'] + counts['exception']) / total, 1) if total else 0.0,
+        'p50_ms': ms(percentile(times, 50)), 'p99_ms': ms(percentile(times, 99)),
+        'p999_ms': ms(percentile(times, 99.9)), 'max_ms': ms(times[-1]) if times else 0.0,
+    }
+
+
+def set_device_baud(config_url, slave_id, baud):
+    """Switch the slave baud rate through the web configuration API"""
+    url = f"{config_url.rstrip('/')}/api/config?slave_id={slave_id}&baud={baud}&parity=none"
+    with urllib.request.urlopen(urllib.request.Request(url, method='POST'), timeout=5) as rsp:
+        reply = json.loads(rsp.read().decode())
+    if not reply.get('success'):
+        raise RuntimeError(f"Device rejected baud {baud}: {reply.get('message')}")
+
+
+def bench_compare(rows, baseline_file, max_regression):
+    """Print the change against a baseline JSON file, return the number of regressions"""
+    with open(baseline_file) as f:
+        baseline = {(r['baud'], r['fc'], r['quantity'], r['rate']): r for r in json.load(f)['results']}
+    regressions = 0
+    print(f"\nComparison against {baseline_file}:")
+    for row in rows:
+        base = baseline.get((row['baud'], row['fc'], row['quantity'], row['rate']))
+        if base is None:
+            continue
+        d_rps = (row['req_per_s'] - base['req_per_s']) / base['req_per_s'] * 100.0 if base['req_per_s'] else 0.0
+        d_p99 = (row['p99_ms'] - base['p99_ms']) / base['p99_ms'] * 100.0 if base['p99_ms'] else 0.0
+        bad = max_regression is not None and (d_rps < -max_regression or d_p99 > max_regression)
+        regressions += bad
+        print(f"  {row['baud']:>7} FC{row['fc']:02d} q={row['quantity']:<4} rate={row['rate']:<5} "
+              f"req/s {d_rps:+6.1f}%  p99 {d_p99:+6.1f}%{'  REGRESSION' if bad else ''}")
+    return regressions
+
+
+def run_benchmark(args):
+    """Sweep baud rates, function codes, quantities and request rates"""
+    import serial
+
+    addresses = dict(BENCH_DEFAULT_ADDRESS)
+    for item in args.address:
+        fc, addr = item.split('=')
+        addresses[int(fc)] = int(addr, 0)
+
+    rows = []
+    current_baud = args.device_baud
+    try:
+        for baud in args.bauds:
+            if baud != current_baud:
+                if not args.config_url:
+                    print(f"Skipping {baud} baud: the device runs at {current_baud}, use --config-url to switch")
+                    continue
+                set_device_baud(args.config_url, args.slave_id, baud)
+                current_baud = baud
+                time.sleep(0.2)
+            # Response timeout: a few maximum size frames plus the USB latency
+            timeout = max(args.timeout, 3 * 256 * 11.0 / baud)
+            with serial.Serial(args.port, baudrate=baud, bytesize=8, parity='N',
+                               stopbits=1, timeout=timeout) as ser:
+                time.sleep(0.1)
+                for fc in args.fcs:
+                    quantities = sorted({min(q, BENCH_MAX_QUANTITY[fc]) for q in args.quantities})
+                    for quantity in quantities:
+                        for rate in args.rates:
+                            row = bench_point(ser, args.slave_id, baud, fc, addresses[fc], quantity,
+                                              rate, args.requests, args.duration)
+                            rows.append(row)
+                            print(f"{baud:>7} FC{fc:02d} q={quantity:<4} rate={rate:<5} "
+                                  f"{row['req_per_s']:8.1f} req/s  p50 {row['p50_ms']:7.2f} ms  "
+                                  f"p99 {row['p99_ms']:7.2f} ms  p999 {row['p999_ms']:7.2f} ms  "
+                                  f"exc {row['exceptions']}  to {row['timeouts']}  crc {row['crc_errors']}")
+    finally:
+        if args.config_url and current_baud != args.device_baud:
+            set_device_baud(args.config_url, args.slave_id, args.device_baud)
+
+    if args.csv:
+        with open(args.csv, 'w', newline='') as f:
+            writer = csv.DictWriter(f, fieldnames=BENCH_FIELDS)
+            writer.writeheader()
+            writer.writerows(rows)
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump({'port': args.port, 'slave_id': args.slave_id,
+                       'timestamp': time.strftime('%Y-%m-%dT%H:%M:%S'), 'results': rows}, f, indent=2)
+    if args.baseline:
+        return bench_compare(rows, args.baseline, args.max_regression) == 0
+    return True
+
+
+def int_list(text):
+    return [int(v) for v in text.split(',') if v]
+
+
 if __name__ == "__main__":
-    port = sys.argv[1] if len(sys.argv) > 1 else '/dev/ttyUSB0'
-    slave_id = int(sys.argv[2]) if len(sys.argv) > 2 else 1
+    parser = argparse.ArgumentParser(description="ESP32-S3 Modbus RTU slave tester and benchmark")
+    parser.add_argument('port', nargs='?', default='/dev/ttyUSB0')
+    parser.add_argument('slave_id', nargs='?', type=int, default=1)
+    parser.add_argument('--bench', action='store_true', help="run the throughput and latency benchmark")
+    parser.add_argument('--bauds', type=int_list, default=[9600],
+                        help="baud rates to sweep, e.g. 9600,115200,921600")
+    parser.add_argument('--fcs', type=int_list, default=[3, 4, 6, 16, 1, 15],
+                        help="function codes to sweep (1, 3, 4, 6, 15, 16)")
+    parser.add_argument('--quantities', type=int_list, default=[1, 10, 125],
+                        help="quantities to sweep, clipped to the limit of each function code")
+    parser.add_argument('--rates', type=int_list, default=[0],
+                        help="request rates in req/s, 0 sends back to back")
+    parser.add_argument('--requests', type=int, default=200, help="requests per point")
+    parser.add_argument('--duration', type=float, default=0.0,
+                        help="seconds per point, used instead of --requests when set")
+    parser.add_argument('--address', action='append', default=[], metavar='FC=ADDR',
+                        help="start address for a function code, e.g. 4=1000")
+    parser.add_argument('--timeout', type=float, default=0.1, help="minimum response timeout in seconds")
+    parser.add_argument('--device-baud', type=int, default=9600, help="baud rate the device runs at now")
+    parser.add_argument('--config-url', help="switch the device baud rate via its web API, e.g. http://192.168.4.1")
+    parser.add_argument('--csv', help="write the results to a CSV file")
+    parser.add_argument('--json', help="write the results to a JSON file, usable as --baseline")
+    parser.add_argument('--baseline', help="JSON file of an earlier run to compare against")
+    parser.add_argument('--max-regression', type=float,
+                        help="fail if req/s drops or p99 grows by more than this percentage")
+    args = parser.parse_args()
+
+    if args.bench:
+        if args.duration:
+            args.requests = 0
+        print("ESP32-S3 Modbus RTU Slave Benchmark")
+        print("=" * 50)
+        sys.exit(0 if run_benchmark(args) else 1)
+
+    port = args.port
+    slave_id = args.slave_id
     
     print("ESP32-S3 Modbus RTU Slave Tester")
     print("=" * 50)